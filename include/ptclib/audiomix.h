@@ -0,0 +1,271 @@
+/*
+ * audiomix.h
+ *
+ * Audio sample rate conversion and mixing.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_AUDIOMIX_H
+#define PTLIB_AUDIOMIX_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <vector>
+#include <map>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PAudioResampler
+
+/** Sample rate converter for 16 bit linear PCM.
+    This is a polyphase FIR filter, the ratio of the rates is reduced to
+    L/M, the input is notionally up sampled by L, low pass filtered and down
+    sampled by M, but only the L sets of coefficients ("phases") that are
+    actually needed for each output sample are ever computed. The filter is
+    a Kaiser windowed sinc, with a cut off just below the lower of the two
+    Nyquist frequencies, so down sampling does not alias.
+
+    The coefficients are 14 bit fixed point, so each output sample is a
+    single dot product of 16 bit integers, which is done eight at a time
+    with SSE2 or NEON where available.
+
+    The converter is stateful, samples are carried over between calls to
+    Process() so a stream may be converted in arbitrary sized pieces. Use a
+    separate instance for each stream.
+  */
+class PAudioResampler : public PObject
+{
+  PCLASSINFO(PAudioResampler, PObject);
+  public:
+    enum {
+      DefaultTaps = 32,   ///< Filter length, in input samples, when up sampling
+      MaxTaps = 512,      ///< Limit on filter length, in input samples
+      MaxPhases = 1024    ///< Limit on L of the reduced L/M ratio
+    };
+
+    PAudioResampler(
+      unsigned srcRate = 8000,        ///< Input samples per second
+      unsigned dstRate = 8000,        ///< Output samples per second
+      unsigned channels = 1,          ///< Number of interleaved channels
+      unsigned taps = DefaultTaps     ///< Filter length, larger is sharper and slower
+    );
+
+    /** Set the sample rates and channels.
+        This resets the converter if anything changes.
+
+        @return false if the rates are zero, or the ratio does not reduce to
+                a denominator of MaxPhases or less, e.g. 48000 to 44101.
+      */
+    bool SetRates(
+      unsigned srcRate,
+      unsigned dstRate,
+      unsigned channels = 1
+    );
+
+    /** Convert samples.
+        Input is consumed only as far as is needed to fill the output, so
+        the remainder should be passed to the next call. If all the input is
+        to be consumed, size the output with GetMaxOutput().
+
+        All counts are of individual 16 bit samples, not frames, and should
+        be a multiple of the number of channels.
+
+        @return Number of samples written to \p dst.
+      */
+    PINDEX Process(
+      const short * src,      ///< Input samples
+      PINDEX & srcSamples,    ///< In: number of input samples, Out: number consumed
+      short * dst,            ///< Output samples
+      PINDEX dstSamples       ///< Space for output samples
+    );
+
+    /// Get the largest number of output samples that the input could produce.
+    PINDEX GetMaxOutput(
+      PINDEX srcSamples
+    ) const;
+
+    /// Discard any samples carried over, e.g. after a seek.
+    void Reset();
+
+    /// Indicate the rates are the same, so Process() is a copy.
+    bool IsPassThrough() const { return m_up != 0 && m_up == m_down; }
+
+    unsigned GetSrcRate() const { return m_srcRate; }
+    unsigned GetDstRate() const { return m_dstRate; }
+    unsigned GetChannels() const { return m_channels; }
+
+    /// Get the filter length in input samples, including padding.
+    unsigned GetTaps() const { return m_taps; }
+
+    /// Compute the dot product of 16 bit samples, \p count must be a multiple of 8.
+    static int DotProduct(const short * samples, const short * coefficients, unsigned count);
+
+  protected:
+    void MakeFilter();
+
+    unsigned m_srcRate;
+    unsigned m_dstRate;
+    unsigned m_channels;
+    unsigned m_requestedTaps;
+    unsigned m_up;        // L
+    unsigned m_down;      // M
+    unsigned m_step;      // M/L
+    unsigned m_stepPhase; // M%L
+    unsigned m_taps;      // Per phase, multiple of 8
+    unsigned m_phase;     // Next output phase, 0 to L-1
+    PINDEX   m_position;  // Start of next output window in m_history
+
+    std::vector<short> m_coefficients;  // m_up phases of m_taps, reversed
+    std::vector< std::vector<short> > m_history; // Per channel
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PAudioMixer
+
+/** Mixer for any number of 16 bit linear PCM streams.
+    Each input has its own ring buffer, written with Write() at any rate, as
+    it is converted to the mixer rate with a PAudioResampler, from whatever
+    thread receives the audio. The mixer thread then calls Mix() or
+    MixFrame() every frame time to take a frame from each input.
+
+    An input that has too much audio buffered (e.g. its clock runs fast)
+    loses its oldest samples, an input with too little is padded with
+    silence, both are counted.
+
+    Gain is fixed point, where UnityGain is 1.0, and the sum is saturated to
+    16 bits. The contribution of each input is kept for the frame, so a
+    "mix minus" of everything but one input, which is what is sent back to
+    each conference participant, costs one pass over the frame per output
+    rather than a pass per input.
+  */
+class PAudioMixer : public PObject
+{
+  PCLASSINFO(PAudioMixer, PObject);
+  public:
+    enum {
+      GainShift = 12,
+      UnityGain = 1 << GainShift,   ///< Gain of 1.0
+      MaxGain = 32767               ///< Gain of almost 8.0
+    };
+
+    typedef unsigned InputID;   ///< Zero is never a valid input
+
+    PAudioMixer(
+      unsigned sampleRate = 8000, ///< Output samples per second
+      unsigned channels = 1,      ///< Number of interleaved channels, for all inputs
+      unsigned bufferMS = 200     ///< Maximum buffered per input
+    );
+    ~PAudioMixer();
+
+    /// Add an input, with audio at \p sampleRate, zero is the mixer rate
+    InputID AddInput(
+      unsigned sampleRate = 0,
+      unsigned gain = UnityGain
+    );
+
+    /// Remove an input
+    bool RemoveInput(
+      InputID id
+    );
+
+    /// Set the gain of an input
+    bool SetGain(
+      InputID id,
+      unsigned gain
+    );
+
+    /// Add audio to an input, count of samples, not bytes
+    bool Write(
+      InputID id,
+      const short * samples,
+      PINDEX count
+    );
+
+    /** Take \p count samples from each input and sum them.
+        The result is then obtained with GetMixed().
+      */
+    void MixFrame(
+      PINDEX count
+    );
+
+    /** Get the last mixed frame, less the input \p exclude, if non-zero.
+        \p output must have space for the count given to MixFrame().
+      */
+    bool GetMixed(
+      short * output,
+      InputID exclude = 0
+    ) const;
+
+    /// Mix a frame and get all of it.
+    void Mix(
+      short * output,
+      PINDEX count
+    );
+
+    unsigned GetSampleRate() const { return m_sampleRate; }
+    unsigned GetChannels() const { return m_channels; }
+    PINDEX GetInputCount() const;
+
+    /// Get the count of samples lost due to the buffer being full
+    PUInt64 GetOverruns(InputID id) const;
+
+    /// Get the count of samples of silence added as the buffer was empty
+    PUInt64 GetUnderruns(InputID id) const;
+
+  protected:
+    struct Input {
+      Input(PINDEX bufferSize, unsigned gain);
+
+      void Push(const short * samples, PINDEX count);
+      PINDEX Pop(short * samples, PINDEX count);
+
+      PAudioResampler    m_resampler;
+      std::vector<short> m_ring;
+      PINDEX             m_readPos;
+      PINDEX             m_count;
+      unsigned           m_gain;
+      std::vector<int>   m_contribution;
+      PUInt64            m_overruns;
+      PUInt64            m_underruns;
+    };
+    typedef std::map<InputID, Input *> InputMap;
+
+    unsigned            m_sampleRate;
+    unsigned            m_channels;
+    PINDEX              m_bufferSize;
+    InputID             m_nextID;
+    InputMap            m_inputs;
+    PINDEX              m_frameSize;
+    std::vector<int>    m_total;
+    std::vector<short>  m_frame;
+    std::vector<short>  m_converted;
+    PDECLARE_MUTEX(m_mutex);
+
+  private:
+    PAudioMixer(const PAudioMixer &);
+    void operator=(const PAudioMixer &);
+};
+
+
+#endif // PTLIB_AUDIOMIX_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -220,6 +220,7 @@ class PHTTP : public PInternetProtocol
 
     // Common MIME header tags
     static const PCaselessString & HostTag();
+    static const PCaselessString & AcceptEncodingTag();
     static const PCaselessString & AllowTag();
     static const PCaselessString & AuthorizationTag();
     static const PCaselessString & ContentEncodingTag();
@@ -236,6 +237,7 @@ class PHTTP : public PInternetProtocol
     static const PCaselessString & RefererTag();
     static const PCaselessString & ServerTag();
     static const PCaselessString & UserAgentTag();
+    static const PCaselessString & VaryTag();
     static const PCaselessString & WWWAuthenticateTag();
     static const PCaselessString & MIMEVersionTag();
     static const PCaselessString & ConnectionTag();
@@ -246,6 +248,7 @@ class PHTTP : public PInternetProtocol
     static const PCaselessString & WebSocketAcceptTag();
     static const PCaselessString & WebSocketProtocolTag();
     static const PCaselessString & WebSocketVersionTag();
+    static const PCaselessString & WebSocketExtensionsTag();
     static const PCaselessString & TransferEncodingTag();
     static const PCaselessString & ChunkedTag();
     static const PCaselessString & ProxyConnectionTag();
@@ -327,6 +330,8 @@ protected:
     virtual PINDEX ParseResponse(
       const PString & line    ///< Input response line to be parsed
     );
+
+  friend class PWebSocket;
 };
 
 
@@ -595,6 +600,13 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
       const PBYTEArray & dataBody,
       PMIMEInfo & replyMime
     );
+    StatusCode ExecuteCommand(
+      Commands cmd,
+      const PURL & url,
+      PMIMEInfo & outMIME,
+      const PBufferChain & dataBody,
+      PMIMEInfo & replyMime
+    );
     StatusCode ExecuteCommand(
       Commands cmd,
       const PURL & url,
@@ -639,6 +651,16 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
       PBYTEArray & body             ///< Received body as binary data
     );
 
+    /** Read the body of the HTTP command as a chain of buffers.
+        Unless the content must be decoded, the body is read straight into
+        the chain's blocks, with a scattered read of up to 256k at a time,
+        and is never copied.
+      */
+    bool ReadContentBody(
+      PMIMEInfo & replyMIME,        ///< Reply MIME from server
+      PBufferChain & body           ///< Received body
+    );
+
 
     /** Start getting the document specified by the URL.
         This does not return until completed, and continuously calls the
@@ -807,6 +829,20 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
       const PMIMEInfo & mime = PMIMEInfo()   ///< Extra MIME fields to be sent
     );
 
+    /** Put the document specified by the URL.
+        The request header and the whole body are sent with gathered writes,
+        without copying the body.
+
+       @return
+       true if document is being transferred.
+     */
+    bool PutDocument(
+      const PURL & url,             ///< Universal Resource Locator for document.
+      const PBufferChain & document,///< Body to write
+      const PString & contentType,  ///< Content-Type header to use
+      const PMIMEInfo & mime = PMIMEInfo()   ///< Extra MIME fields to be sent
+    );
+
     /** Put the document specified by the URL.
 
        @return
@@ -865,6 +901,30 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
     /// Get max redirects on operation
     unsigned GetMaxRedirects() const { return m_maxRedirects; }
 
+    /**Set automatic decoding of compressed content.
+       When enabled, and zlib is available, an Accept-Encoding header is sent
+       and a gzip or deflate body is decompressed as it is read, with the
+       Content-Encoding field removed from the reply MIME. Default is true.
+      */
+    void SetContentDecoding(
+      bool enable = true
+    ) { m_contentDecoding = enable; }
+
+    /// Get automatic decoding of compressed content.
+    bool GetContentDecoding() const { return m_contentDecoding; }
+
+    /**Set the limit on the size of decoded content. A compressed body that
+       expands beyond this fails with ContentProcessorError. Zero is no
+       limit. Defaults to DefaultMaxDecodedSize.
+      */
+    void SetMaxDecodedSize(
+      PUInt64 size
+    ) { m_maxDecodedSize = size; }
+    enum { DefaultMaxDecodedSize = 1000000000 }; // A gigabyte seems a lot
+
+    /// Get the limit on the size of decoded content.
+    PUInt64 GetMaxDecodedSize() const { return m_maxDecodedSize; }
+
 #if PTRACING
     static PINDEX MaxTraceContentSize;
 #endif
@@ -873,9 +933,14 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
     virtual bool HandleAuthorisation(bool isProxy, PMIMEInfo & replyMIME);
 
   protected:
+    bool InternalReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & processor);
+    bool InternalReadContentBody(PMIMEInfo & replyMIME, PBufferChain & body);
+
     PString  m_userAgentName;
     bool     m_persist;
     unsigned m_maxRedirects;
+    bool     m_contentDecoding;
+    PUInt64  m_maxDecodedSize;
     Proxies  m_proxies;
     struct {
       PString  m_userName;
@@ -889,8 +954,20 @@ class PHTTPClient : public PHTTP, public PSSLCertificateInfo
 //////////////////////////////////////////////////////////////////////////////
 // PClientPool
 
-/**A class for a pool of PHTTPClient instances/threads for efficient high
-   volume access. e.g. for REST API access.
+/**A class for a pool of HTTP client connections for efficient high volume
+   access. e.g. for REST API access.
+
+   Plain http connections are multiplexed on a small number of event threads
+   rather than having a thread each. Requests are queued per host, and up to
+   <code>maxParallel</code> connections are opened to each host, with no more
+   than <code>maxConnections</code> in total. Once a server has answered with
+   a persistent HTTP/1.1 response, idempotent requests (GET and HEAD) are
+   pipelined on the connection, up to the depth set by SetMaxPipeline().
+   With SetHTTP2(), plain http connections instead use HTTP/2 with prior
+   knowledge (h2c), and any request may be multiplexed on them.
+
+   Connections for https URLs, or all connections if SetEventThreads(0) is
+   used or on Windows, each get a PHTTPClient and thread of their own.
  */
 class PHTTPClientPool : public PObject, public PSSLCertificateInfo
 {
@@ -908,16 +985,68 @@ class PHTTPClientPool : public PObject, public PSSLCertificateInfo
       , m_timeToLive(timeToLive)
       , m_connectTimeout(connectTimeout)
       , m_readTimeout(readTimeout)
+      , m_maxPipeline(DefaultMaxPipeline)
+      , m_eventThreads(1)
+      , m_http2(false)
+      , m_contentDecoding(true)
+      , m_maxDecodedSize(PHTTPClient::DefaultMaxDecodedSize)
+      , m_maxBodySize(DefaultMaxBodySize)
+      , m_eventConnections(0)
     { }
     ~PHTTPClientPool() { ShutDown(); }
 
     void ShutDown();
 
+    enum { DefaultMaxPipeline = 8 };
+
+    /**Set the maximum number of requests outstanding on one connection.
+       A value of one disables pipelining. For HTTP/2 this is the number of
+       concurrent streams, further limited by the server's own setting.
+      */
+    void SetMaxPipeline(unsigned depth) { m_maxPipeline = depth > 0 ? depth : 1; }
+
+    /**Set the number of threads multiplexing the pooled connections. Zero
+       uses a thread per connection. This must be called before any requests
+       are queued.
+      */
+    void SetEventThreads(unsigned count) { m_eventThreads = count; }
+
+    /**Use HTTP/2 for http URLs on the event threads. The server must
+       support HTTP/2 with prior knowledge, as there is no fall back to
+       HTTP/1.1. This must be called before any requests are queued.
+      */
+    void SetHTTP2(bool enable) { m_http2 = enable; }
+
+    /**Set automatic decoding of gzip or deflate response bodies, see
+       PHTTPClient::SetContentDecoding(). This must be called before any
+       requests are queued.
+      */
+    void SetContentDecoding(bool enable) { m_contentDecoding = enable; }
+
+    /**Set the limit on the size of decoded response bodies, see
+       PHTTPClient::SetMaxDecodedSize(). This must be called before any
+       requests are queued.
+      */
+    void SetMaxDecodedSize(PUInt64 size) { m_maxDecodedSize = size; }
+
+    /**Set the limit on the size of response bodies as received, on the
+       event threads. A response with a larger Content-Length, or more data,
+       fails with PHTTP::BadResponse. This must be called before any requests
+       are queued.
+      */
+    void SetMaxBodySize(PUInt64 size) { m_maxBodySize = size; }
+    enum { DefaultMaxBodySize = 100000000 }; // Held in memory, so not too big
+
     struct Response
     {
+      Response() : m_code(PHTTP::BadResponse) { }
+
+      /// Get the body as binary data, this copies the data.
+      PBYTEArray GetBodyData() const { return PBYTEArray((const BYTE *)(const char *)m_body, m_body.GetLength()); }
+
       PHTTP::StatusCode m_code;
       PMIMEInfo         m_headers;
-      PString           m_body;
+      PString           m_body;   ///< Body as read from the connection, GetLength() is correct for binary data
     };
 
     typedef PNotifierTemplate<Response> Notifier;
@@ -959,11 +1088,19 @@ class PHTTPClientPool : public PObject, public PSSLCertificateInfo
     );
 
   protected:
+    void QueueThreadedRequest(const Request & request, const PString & hostPort);
+
     unsigned      m_maxConnections;
     unsigned      m_maxParallel;
     PTimeInterval m_timeToLive;
     PTimeInterval m_connectTimeout;
     PTimeInterval m_readTimeout;
+    unsigned      m_maxPipeline;
+    unsigned      m_eventThreads;
+    bool          m_http2;
+    bool          m_contentDecoding;
+    PUInt64       m_maxDecodedSize;
+    PUInt64       m_maxBodySize;
 
     PDECLARE_MUTEX(m_mutex);
 
@@ -982,6 +1119,11 @@ class PHTTPClientPool : public PObject, public PSSLCertificateInfo
     friend struct Connection;
     typedef std::multimap<PString, Connection *> ConnectionMap;
     ConnectionMap m_connections;
+
+    class EventThread;
+    friend class EventThread;
+    std::vector<EventThread *> m_eventThreadList;
+    atomic<unsigned>           m_eventConnections;
 };
 
 
@@ -996,6 +1138,8 @@ class PHTTPClientPool : public PObject, public PSSLCertificateInfo
     Note the WebSocket handshake is assumed to have already occurred.
 */
 
+class PZLib;
+
 class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
 {
     PCLASSINFO(PWebSocket, PIndirectChannel)
@@ -1003,6 +1147,9 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
     /// Create a new WebSocket channel.
     PWebSocket();
 
+    /// Destroy the WebSocket channel.
+    ~PWebSocket();
+
   // Overrides from PChannel
     /** Low level read from the channel.
 
@@ -1031,6 +1178,16 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
       PINDEX len        ///< Number of bytes to write.
     );
 
+    /** Write a chain of buffers as a single WebSocket message.
+        On the server side, without compression, the frame header and all of
+        the chain are written with gathered writes, the payload is not copied.
+        Otherwise, as the payload is masked or compressed, it is written as
+        for Write().
+      */
+    bool WriteMessage(
+      const PBufferChain & msg  ///< Message payload
+    );
+
 
     /** Connect to the WebSocket.
         This performs the HTTP handshake for the WebSocket establishment.
@@ -1047,6 +1204,29 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
       PBYTEArray & msg
     );
 
+    /** Read a complete WebSocket message into the callers buffer.
+        The payload is read directly into the buffer, without any intermediate
+        copies or allocations, unless it is compressed.
+
+        If the message does not fit, the WebSocket is closed with status 1009
+        and false is returned with a BufferTooSmall error.
+      */
+    virtual bool ReadMessage(
+      void * buffer,    ///< Buffer to receive the message
+      PINDEX size,      ///< Size of buffer
+      PINDEX & length   ///< Length of message read
+    );
+
+    /** Read a complete WebSocket message onto the end of a chain of buffers.
+        Each frame is read into blocks from the chain's pool, so a large or
+        fragmented message is never reallocated or copied as it grows. A
+        compressed message is inflated into one array, which is added to the
+        chain without copying.
+      */
+    virtual bool ReadMessage(
+      PBufferChain & msg
+    );
+
     // Read complete WebSocket text message
     virtual bool ReadText(
       PString & msg
@@ -1075,10 +1255,10 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
       bool txt = true
     ) { m_binaryWrite = !txt; }
 
-  ///  Set maximum possible frame size. Defaults to 1GB.
+  ///  Set maximum possible frame size, also the limit on a whole inflated compressed message. Defaults to 1GB.
     void SetMaxFrameSize(
       uint64_t maxFrameSize  ///< New maximum size.
-    ) { maxFrameSize = m_maxFrameSize; }
+    ) { m_maxFrameSize = maxFrameSize; }
 
     /**Set proxy for connections.
       */
@@ -1086,6 +1266,56 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
       const PHTTP::Proxies & proxies ///< Proxy in host:port form
     ) { m_proxies = proxies; }
 
+    /** Offer the RFC7692 permessage-deflate extension in Connect().
+        This requires zlib, and is ignored without it.
+      */
+    void SetPerMessageDeflate(
+      bool offer = true
+    ) { m_offerDeflate = offer; }
+
+    /** Set the extensions agreed in the handshake.
+        This is done by Connect() for a client. A server should pass
+        PHTTPConnectionInfo::GetWebSocketExtensions() after opening the
+        WebSocket on the PHTTPServer.
+
+        Compression contexts are kept between messages, unless the agreed
+        parameters say otherwise.
+
+        @return false if the extensions are not supported.
+      */
+    bool SetExtensions(
+      const PString & extensions
+    );
+
+    /// Indicate permessage-deflate is in use.
+    bool IsPerMessageDeflate() const { return m_deflater != NULL; }
+
+    /** Select the extensions a server accepts from the clients
+        Sec-WebSocket-Extensions offer. Only permessage-deflate is supported.
+        @return the value for the reply, empty if nothing is acceptable.
+      */
+    static PString NegotiateExtensions(
+      const PString & offers
+    );
+
+    typedef std::vector<PWebSocket *> List;
+
+    /** Send a message to many WebSockets.
+        The frame is built once and written to each server side WebSocket
+        with a single scatter/gather write. Client WebSockets, which need
+        their own mask, and those compressing with context takeover, are
+        framed individually. WebSockets in the middle of a fragmented write
+        are skipped.
+
+        @return number of WebSockets the message was written to.
+      */
+    static PINDEX Broadcast(
+      const List & webSockets,  ///< WebSockets to write to
+      const void * data,        ///< Message to send
+      PINDEX len,               ///< Length of message
+      bool binary = false       ///< Send as binary rather than text
+    );
+
   protected:
     enum OpCodes
     {
@@ -1111,25 +1341,62 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
       int64_t  masking
     );
 
+    enum { MaxHeaderSize = 14 };
+    static PINDEX EncodeHeader(
+      BYTE * header,
+      OpCodes opCode,
+      bool fragment,
+      bool compressed,
+      uint64_t payloadLength,
+      int64_t masking
+    );
+
     bool InternalRead(void * buf, PINDEX len);
+    bool ReadDataHeader();
+    bool ReadBuffered(void * buf, PINDEX len);
+    bool ReadAvailable(void * buf, PINDEX len);
     bool ReadMasked(void * buf, PINDEX len);
+    bool ReadInflated(void * buf, PINDEX len);
+    bool InflateMessage(PBYTEArray & output, PINDEX & outputLength);
+    bool InternalReadMessage(PBYTEArray * growing, PBufferChain * chain, BYTE * buffer, PINDEX size, PINDEX & length);
+    void CloseWithStatus(unsigned status);
 
     bool InternalWrite(OpCodes  opCode, bool fragmenting, const void * data, PINDEX len);
-    bool WriteMasked(const uint32_t * data, PINDEX len, uint32_t mask);
+    bool WriteFrame(OpCodes opCode, bool fragmenting, bool compressed, const void * data, PINDEX len);
+    bool WriteGathered(const void * header, PINDEX headerLen, const void * payload, PINDEX len);
+    bool Deflate(const void * data, PINDEX len, bool first, bool final);
 
     PHTTP::Proxies m_proxies;
 
-    bool     m_client;
-    bool     m_fragmentingWrite;
-    bool     m_binaryWrite;
-    uint64_t m_maxFrameSize;
+    bool       m_client;
+    bool       m_fragmentingWrite;
+    bool       m_binaryWrite;
+    bool       m_continuingWrite;
+    uint64_t   m_maxFrameSize;
     PDECLARE_MUTEX(m_writeMutex);
-
-    uint64_t m_remainingPayload;
-    int64_t  m_currentMask;
-    bool     m_fragmentedRead;
-
-    bool     m_recursiveRead;
+    PBYTEArray m_writeBuffer;
+
+    uint64_t   m_remainingPayload;
+    int64_t    m_currentMask;
+    bool       m_fragmentedRead;
+    bool       m_compressedRead;
+
+    bool       m_recursiveRead;
+
+    PBYTEArray m_readAhead;
+    PINDEX     m_readAheadOffset;
+    PINDEX     m_readAheadLength;
+
+    bool       m_offerDeflate;
+    bool       m_deflateNoContextTakeover;
+    PZLib    * m_deflater;
+    PZLib    * m_inflater;
+    PBYTEArray m_deflated;
+    PINDEX     m_deflatedLength;
+    PBYTEArray m_compressedInput;
+    PBYTEArray m_inflated;
+    PINDEX     m_inflatedOffset;
+    PINDEX     m_inflatedLength;
 };
 
 #endif // P_SSL
@@ -1139,6 +1406,7 @@ class PWebSocket : public PIndirectChannel, public PSSLCertificateInfo
 // PHTTPConnectionInfo
 
 class PHTTPServer;
+class PHTTP2ServerStream;
 
 /** This object describes the connectiono associated with a HyperText Transport
    Protocol request. This information is required by handler functions on
@@ -1202,6 +1470,12 @@ class PHTTPConnectionInfo : public PObject, PNonCopyable
     bool IsWebSocket() const { return m_isWebSocket; }
     void ClearWebSocket() { m_isWebSocket = false; }
 
+    /// Get the Sec-WebSocket-Extensions agreed in the WebSocket handshake.
+    const PString & GetWebSocketExtensions() const { return m_webSocketExtensions; }
+
+    /// Indicate the client asked to upgrade to HTTP/2 via "Upgrade: h2c"
+    bool IsHTTP2Upgrade() const { return m_isHTTP2Upgrade; }
+
   protected:
     PBoolean Initialise(PHTTPServer & server, PString & args);
     bool DecodeMultipartFormInfo() { return m_mimeInfo.DecodeMultiPartList(m_multipartFormInfo, m_entityBody); }
@@ -1214,6 +1488,8 @@ class PHTTPConnectionInfo : public PObject, PNonCopyable
     bool            m_wasPersistent;
     bool            m_isProxyConnection;
     bool            m_isWebSocket;
+    PString         m_webSocketExtensions;
+    bool            m_isHTTP2Upgrade;
     int             m_majorVersion;
     int             m_minorVersion;
     PString         m_entityBody;        // original entity body (POST only)
@@ -1229,6 +1505,7 @@ class PHTTPConnectionInfo : public PObject, PNonCopyable
     const PMultiPartList & multipartFormInfo;
 
   friend class PHTTPServer;
+  friend class PHTTP2Server;
 };
 
 
@@ -1388,6 +1665,17 @@ class PHTTPServer : public PHTTP
      */
     virtual PString ReadEntityBody();
 
+    /** Read the entity body associated with a HTTP request into a chain of
+       buffers, and close the socket if not a persistent connection. The
+       body is read with scattered reads directly into the chain's blocks.
+
+       @return
+       false if the body could not be read.
+     */
+    virtual bool ReadEntityBody(
+      PBufferChain & body   ///< Chain to append the body to
+    );
+
     /** Handle an unknown command.
 
        @return
@@ -1514,6 +1802,12 @@ class PHTTPServer : public PHTTP
       const PString & protocol
     );
 
+    /** Accept the permessage-deflate WebSocket extension, if the client
+        offers it. The agreed extension is in the connection info, see
+        PHTTPConnectionInfo::GetWebSocketExtensions(). Default is false.
+      */
+    void SetWebSocketDeflate(bool accept) { m_webSocketDeflate = accept; }
+
     /// Set start of service time
     void SetServiceStartTime(const PTime & startTime) { m_serviceStartTime = startTime; }
 
@@ -1523,6 +1817,22 @@ class PHTTPServer : public PHTTP
     /// Get time last command was read
     const PTime & GetLastCommandTime() const { return m_lastCommandTime; }
 
+    /**Allow ProcessCommand() to switch the connection to HTTP/2, either via
+       a h2c upgrade or the client sending the HTTP/2 connection preface. In
+       both cases ProcessCommand() returns false, and GetHTTP2Switch()
+       indicates the connection should be handed to PHTTP2Server.
+      */
+    void SetHTTP2Allowed(bool allowed) { m_http2Allowed = allowed; }
+
+    enum HTTP2Switch {
+      NoHTTP2Switch,
+      HTTP2Upgraded,     ///< Request in GetConnectionInfo() was upgraded with h2c
+      HTTP2PriorKnowledge///< Client started with the connection preface
+    };
+
+    /// Get indication that ProcessCommand() switched to HTTP/2
+    HTTP2Switch GetHTTP2Switch() const { return m_http2Switch; }
+
   protected:
     void Construct();
 #if P_SSL
@@ -1535,9 +1845,15 @@ class PHTTPServer : public PHTTP
     PHTTPConnectionInfo m_connectInfo;
     unsigned            m_transactionCount;
     PTimeInterval       m_nextTimeout;
+    bool                m_http2Allowed;
+    HTTP2Switch         m_http2Switch;
+    PHTTP2ServerStream * m_http2Stream;
 
     typedef std::map<std::string, WebSocketNotifier> WebSocketNotifierMap;
     WebSocketNotifierMap m_webSocketNotifiers;
+    bool                 m_webSocketDeflate;
+
+  friend class PHTTP2Server;
 
     P_REMOVE_VIRTUAL(PBoolean,OnGET(const PURL&,const PMIMEInfo&, const PHTTPConnectionInfo&),false);
     P_REMOVE_VIRTUAL(PBoolean,OnHEAD(const PURL&,const PMIMEInfo&,const PHTTPConnectionInfo&),false);
@@ -1601,6 +1917,16 @@ public:
     */
   virtual void OnHTTPEnded(PHTTPServer & server);
 
+  /** Enable HTTP/2 connections, the default. These may be negotiated via
+      ALPN if CreateChannelForHTTP() returns a PSSLChannel, via a h2c upgrade
+      or with prior knowledge. Requests on each stream are dispatched via the
+      stream thread pool.
+    */
+  void SetHTTP2Enabled(bool enabled) { m_http2Enabled = enabled; }
+
+  /// Indicate HTTP/2 connections are enabled.
+  bool IsHTTP2Enabled() const { return m_http2Enabled; }
+
   struct Worker
   {
     Worker(PHTTPListener & listener, PTCPSocket * socket);
@@ -1618,6 +1944,20 @@ public:
   const ThreadPool & GetThreadPool() const { return m_threadPool; }
         ThreadPool & GetThreadPool()       { return m_threadPool; }
 
+  /** Work for a single HTTP/2 stream. These are separate from the connection
+      workers, which are each tied up reading frames for their connection.
+    */
+  struct StreamWork
+  {
+    virtual ~StreamWork() { }
+    virtual void Work() = 0;
+  };
+  typedef PQueuedThreadPool<StreamWork> StreamThreadPool;
+
+  /// Get the thread pool in use for HTTP/2 streams.
+  const StreamThreadPool & GetStreamThreadPool() const { return m_streamThreadPool; }
+        StreamThreadPool & GetStreamThreadPool()       { return m_streamThreadPool; }
+
   /// Get the resource space for HTTP listener.
   const PHTTPSpace & GetSpace() const { return m_httpNameSpace; }
         PHTTPSpace & GetSpace()       { return m_httpNameSpace; }
@@ -1633,6 +1973,8 @@ protected:
   PList<PHTTPServer> m_httpServers;
   PDECLARE_MUTEX(    m_httpServersMutex);
   ThreadPool         m_threadPool;
+  bool               m_http2Enabled;
+  StreamThreadPool   m_streamThreadPool;
 };
 
 
@@ -2022,6 +2364,24 @@ class PHTTPResource : public PObject
     /// Clear the hit count for the resource.
     void ClearHitCount() { m_hitCount = 0; }
 
+    enum { DefaultMinCompressionSize = 1024 };
+
+    /** Allow the response body to be compressed, with gzip or deflate as the
+       client's Accept-Encoding permits. Bodies smaller than the minimum, or
+       of types that are already compressed, e.g. images, are sent as is.
+       Has no effect if PTLib was built without zlib.
+     */
+    void SetCompression(
+      bool enable,                                 ///< Allow compression
+      PINDEX minSize = DefaultMinCompressionSize   ///< Smallest body to compress
+    ) { m_compression = enable; m_minCompressionSize = minSize; }
+
+    /// Indicate compression is allowed for this resource.
+    bool IsCompressionEnabled() const { return m_compression; }
+
+    /// Get the smallest body that is compressed.
+    PINDEX GetMinCompressionSize() const { return m_minCompressionSize; }
+
     /**Indicate that the web socket protocol is supported by this resource.
       */
     virtual bool SupportsWebSocketProtocol(
@@ -2205,6 +2565,19 @@ class PHTTPResource : public PObject
       PHTTPRequest & request    ///< Information on this request.
     );
 
+    /** Get the whole body, compressed with the Content-Encoding given, from
+       a cache of static content. The default returns false, and the body is
+       compressed as it is sent.
+
+       @return
+       true if the compressed data was available.
+     */
+    virtual bool LoadCompressedData(
+      PHTTPRequest & request,          ///< Information on this request.
+      const PString & contentEncoding, ///< "gzip" or "deflate"
+      PBYTEArray & data                ///< Compressed body
+    );
+
     /** This is called after the text has been loaded and may be used to
        customise or otherwise mangle a loaded piece of text. Typically this is
        used with HTML responses.
@@ -2289,6 +2662,9 @@ class PHTTPResource : public PObject
     PHTTPAuthority * m_authority;   ///< Authorisation method for the resource
     PStringOptions   m_corsHeaders; ///< Cross-Origin Resource Sharing (CORS) headers
     atomic<unsigned> m_hitCount;    ///< Count of number of times resource was accessed. 
+    bool             m_compression;        ///< Response body may be compressed
+    PINDEX           m_minCompressionSize; ///< Smallest body to compress
+
 
     P_REMOVE_VIRTUAL(PBoolean,OnGET(PHTTPServer&,const PURL&,const PMIMEInfo&,const PHTTPConnectionInfo&),false);
     P_REMOVE_VIRTUAL(PBoolean,OnHEAD(PHTTPServer&,const PURL&,const PMIMEInfo&,const PHTTPConnectionInfo &),false);
@@ -2387,6 +2763,44 @@ class PHTTPString : public PHTTPResource
 };
 
 
+//////////////////////////////////////////////////////////////////////////////
+// PHTTPMetrics
+
+/** This object describes a HyperText Transport Protocol resource which
+   returns every registered PMetric, e.g. thread pool queue latencies and
+   socket byte counts, in the Prometheus text exposition format. It may be
+   added to the PHTTPSpace of any PHTTPListener, usually as "/metrics", for
+   a Prometheus server to scrape.
+ */
+class PHTTPMetrics : public PHTTPResource
+{
+  PCLASSINFO(PHTTPMetrics, PHTTPResource)
+
+  public:
+    /** Contruct a new metrics resource for the HTTP space.
+     */
+    PHTTPMetrics(
+      const PURL & url = "metrics"  // Name of the resource in URL space.
+    );
+    PHTTPMetrics(
+      const PURL & url,            // Name of the resource in URL space.
+      const PHTTPAuthority & auth  // Authorisation for the resource.
+    );
+
+  // Overrides from class PHTTPResource
+    virtual PBoolean LoadHeaders(
+      PHTTPRequest & request    // Information on this request.
+    );
+    virtual PString LoadText(
+      PHTTPRequest & request    // Information on this request.
+    );
+
+  // New functions for class.
+    /// Get the MIME type for the Prometheus text format
+    static const PString & ContentType();
+};
+
+
 //////////////////////////////////////////////////////////////////////////////
 // PHTTPFile
 
@@ -2479,6 +2893,23 @@ class PHTTPFile : public PHTTPResource
       PHTTPRequest & request    // Information on this request.
     );
 
+    /** Get the compressed file from the cache, compressing it and adding it
+       to the cache if needed. Large files are not cached.
+     */
+    virtual bool LoadCompressedData(
+      PHTTPRequest & request,
+      const PString & contentEncoding,
+      PBYTEArray & data
+    );
+
+    /** Set the total size of the compressed file cache, shared by all
+       PHTTPFile resources. Zero disables the cache.
+     */
+    static void SetCompressedCacheSize(
+      PINDEX totalSize,     ///< Total size of cached data
+      PINDEX maxFileSize    ///< Largest file, uncompressed, to cache
+    );
+
 
   protected:
     PHTTPFile(
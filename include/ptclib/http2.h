@@ -0,0 +1,564 @@
+/*
+ * http2.h
+ *
+ * HyperText Transport Protocol version 2 classes.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_HTTP2_H
+#define PTLIB_HTTP2_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <ptlib_config.h>
+
+#if P_HTTP
+
+#include <ptclib/http.h>
+#include <deque>
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHPACK
+
+/** Header compression for HTTP/2, as per RFC 7541.
+    The encoder and decoder each keep a dynamic table, which must track the
+    peer's table exactly, so a header block must be encoded, or decoded, in
+    the same order as the frames carrying it go on, or come off, the wire.
+  */
+class PHPACK : public PObject
+{
+    PCLASSINFO(PHPACK, PObject);
+  public:
+    struct Field
+    {
+      Field() { }
+      Field(const PString & name, const PString & value) : m_name(name), m_value(value) { }
+
+      PString m_name;
+      PString m_value;
+    };
+    typedef std::vector<Field> FieldList;
+
+    enum {
+      DefaultTableSize = 4096,
+      EntryOverhead = 32
+    };
+
+    PHPACK();
+
+    /// Get the current size of the dynamic table, as defined by RFC 7541
+    unsigned GetTableSize() const { return m_tableSize; }
+
+    /// Get the maximum size of the dynamic table.
+    unsigned GetMaxTableSize() const { return m_maxTableSize; }
+
+  protected:
+    void SetTableLimit(unsigned size);
+    void AddEntry(const PString & name, const PString & value);
+    const Field * GetEntry(unsigned index) const;
+
+    std::deque<Field> m_dynamicTable; // Newest entry first
+    unsigned          m_tableSize;
+    unsigned          m_maxTableSize;
+};
+
+
+/** Encoder for HPACK header blocks.
+  */
+class PHPACKEncoder : public PHPACK
+{
+    PCLASSINFO(PHPACKEncoder, PHPACK);
+  public:
+    PHPACKEncoder();
+
+    /**Set the maximum dynamic table size, as received from the peer in the
+       SETTINGS_HEADER_TABLE_SIZE parameter. The change is signalled to the
+       peer at the start of the next header block.
+      */
+    void SetMaxTableSize(unsigned size);
+
+    /**Encode the header fields, appending the block to the buffer.
+       Field names must already be in lower case.
+      */
+    void Encode(
+      const FieldList & fields,   ///< Fields to encode
+      PBYTEArray & block,         ///< Buffer to append to
+      PINDEX & length             ///< Length of valid data in buffer, updated
+    );
+
+  protected:
+    unsigned m_sizeUpdate;
+};
+
+
+/** Decoder for HPACK header blocks.
+  */
+class PHPACKDecoder : public PHPACK
+{
+    PCLASSINFO(PHPACKDecoder, PHPACK);
+  public:
+    PHPACKDecoder();
+
+    /**Set the limit on the dynamic table size, as we sent to the peer in the
+       SETTINGS_HEADER_TABLE_SIZE parameter.
+      */
+    void SetMaxTableSize(unsigned size);
+
+    /**Decode a complete header block, appending the fields to the list.
+       @return false if the block is malformed, which is a connection error.
+      */
+    bool Decode(
+      const BYTE * data,   ///< Header block
+      PINDEX length,       ///< Length of header block
+      FieldList & fields   ///< List to append decoded fields to
+    );
+
+  protected:
+    unsigned m_allowedTableSize;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHTTP2Connection
+
+/** The framing layer of a HTTP/2 connection, as per RFC 9113.
+    This does no I/O of its own. Data read from the transport is placed in the
+    buffer from GetReceiveBuffer() and handed to ProcessReceived(), which calls
+    the virtual functions for stream events. Frames to be sent are accumulated
+    in an output buffer which the owner writes to the transport, having got
+    it via GetOutput().
+
+    SETTINGS, PING and WINDOW_UPDATE frames are handled internally, received
+    data is considered consumed as soon as it is passed to OnData(), so the
+    flow control window is reopened automatically.
+
+    The object is not thread safe, if used from more than one thread the
+    owner must provide the mutual exclusion.
+  */
+class PHTTP2Connection : public PObject
+{
+    PCLASSINFO(PHTTP2Connection, PObject);
+  public:
+    enum FrameType {
+      DataFrame,
+      HeadersFrame,
+      PriorityFrame,
+      ResetStreamFrame,
+      SettingsFrame,
+      PushPromiseFrame,
+      PingFrame,
+      GoAwayFrame,
+      WindowUpdateFrame,
+      ContinuationFrame
+    };
+
+    enum FrameFlags {
+      EndStreamFlag  = 0x01,
+      AckFlag        = 0x01,
+      EndHeadersFlag = 0x04,
+      PaddedFlag     = 0x08,
+      PriorityFlag   = 0x20
+    };
+
+    enum ErrorCode {
+      NoError,
+      ProtocolError,
+      InternalError,
+      FlowControlError,
+      SettingsTimeout,
+      StreamClosed,
+      FrameSizeError,
+      RefusedStream,
+      Cancel,
+      CompressionError,
+      ConnectError,
+      EnhanceYourCalm,
+      InadequateSecurity,
+      HTTP_1_1_Required
+    };
+
+    enum SettingId {
+      HeaderTableSizeSetting = 1,
+      EnablePushSetting,
+      MaxConcurrentStreamsSetting,
+      InitialWindowSizeSetting,
+      MaxFrameSizeSetting,
+      MaxHeaderListSizeSetting
+    };
+
+    enum {
+      FrameHeaderSize = 9,
+      PrefaceSize = 24,
+      DefaultWindowSize = 65535,
+      DefaultMaxFrameSize = 16384,
+      MaxFrameSize = 16777215,
+      MaxWindowSize = 0x7fffffff,
+      DefaultMaxConcurrentStreams = 100,
+      DefaultReceiveWindow = 1024*1024,
+      MaxQueuedAcknowledgements = 16384 // Bytes of PING and SETTINGS ACK frames not yet taken by GetOutput()
+    };
+
+    /// The client connection preface, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+    static const char Preface[PrefaceSize+1];
+
+    /// Name of protocol in ALPN and in the HTTP/1.1 Upgrade header
+    static const char * const ALPN;
+    static const char * const UpgradeName;
+    static const PCaselessString & SettingsTag();
+
+    /// Indicate a HTTP/1.x header field which must not be sent in HTTP/2
+    static bool IsConnectionSpecific(const PCaselessString & name);
+
+    PHTTP2Connection(
+      bool isServer
+    );
+
+    /**Set the maximum number of streams the peer may open at once.
+       Must be called before Start().
+      */
+    void SetMaxConcurrentStreams(unsigned count) { m_localMaxConcurrentStreams = count; }
+
+    /**Set the flow control window we give the peer, for each stream and
+       for the connection as a whole. Must be called before Start().
+      */
+    void SetReceiveWindow(unsigned size) { m_localWindowSize = std::min(size, (unsigned)MaxWindowSize); }
+
+    /**Start the connection, queueing the preface for a client, and our
+       SETTINGS.
+      */
+    void Start();
+
+    /**For a h2c upgrade, apply the base64url encoded SETTINGS payload from
+       the HTTP2-Settings header, and create stream 1, which the upgraded
+       request implicitly opened. Must be called after Start().
+      */
+    bool StartUpgrade(
+      const PString & settings
+    );
+
+    /**Get a buffer to read data from the transport into.
+      */
+    BYTE * GetReceiveBuffer(
+      PINDEX & size   ///< Space available in buffer
+    );
+
+    /**Process data read from the transport into GetReceiveBuffer().
+       @return false if a connection error occurred, a GOAWAY is then queued
+               and the transport should be closed after it is sent.
+      */
+    bool ProcessReceived(
+      PINDEX size   ///< Number of bytes read into buffer.
+    );
+
+    /**Indicate there is output to be sent to the transport.
+      */
+    bool HasOutput() const { return m_outputLength > 0; }
+
+    /**Get the output to be sent to the transport. The output is swapped with
+       the supplied buffer, whose contents are discarded.
+      */
+    void GetOutput(
+      PBYTEArray & buffer,  ///< Buffer to receive data
+      PINDEX & length       ///< Length of data in buffer
+    );
+
+    /**Allocate a new stream, client only.
+       @return zero if the peer's concurrent stream limit has been reached, or
+               the connection is going away.
+      */
+    DWORD OpenStream();
+
+    /// Indicate OpenStream() would succeed
+    bool CanOpenStream() const;
+
+    /**Queue a HEADERS frame, and any CONTINUATION frames needed.
+       Field names must be in lower case, and have pseudo-header fields first.
+      */
+    bool SendHeaders(
+      DWORD streamId,
+      const PHPACK::FieldList & fields,
+      bool endStream
+    );
+
+    /**Queue DATA frames for as much of the data as flow control allows.
+       The endStream flag is only applied if all of the data is queued.
+       @return number of bytes queued, P_MAX_INDEX if the stream is not open
+      */
+    PINDEX SendData(
+      DWORD streamId,
+      const void * data,
+      PINDEX length,
+      bool endStream
+    );
+
+    /**Reset a stream, queueing a RST_STREAM frame.
+      */
+    void ResetStream(
+      DWORD streamId,
+      ErrorCode error
+    );
+
+    /**Start graceful shut down by queueing a GOAWAY frame.
+      */
+    void GoAway(
+      ErrorCode error = NoError
+    );
+
+    /// Get the number of bytes that may be sent on the stream now
+    PINDEX GetSendWindow(DWORD streamId) const;
+
+    /// Get the number of streams open
+    unsigned GetActiveStreams() const { return m_streams.size(); }
+
+    /// Get the number of streams the peer allows us to have open
+    unsigned GetPeerMaxConcurrentStreams() const { return m_peerMaxConcurrentStreams; }
+
+    /// Indicate a GOAWAY has been sent or received
+    bool IsGoingAway() const { return m_goingAway; }
+
+    /// Indicate a connection error has occurred
+    bool HasFailed() const { return m_failed; }
+
+    /// Get the highest stream identifier the peer opened
+    DWORD GetLastPeerStreamId() const { return m_lastPeerStreamId; }
+
+  protected:
+    /**Called when the HEADERS frame, and any CONTINUATION frames for a stream,
+       have been received and decoded. A request or response is a first block
+       with pseudo-headers, a subsequent block is a trailer.
+      */
+    virtual void OnHeaders(DWORD streamId, PHPACK::FieldList & fields, bool endStream) = 0;
+
+    /**Called when DATA is received on a stream. The data has been counted as
+       consumed for flow control.
+      */
+    virtual void OnData(DWORD streamId, const BYTE * data, PINDEX length, bool endStream) = 0;
+
+    /**Called when a stream is reset by the peer, or due to a stream error.
+      */
+    virtual void OnStreamReset(DWORD streamId, ErrorCode error);
+
+    /**Called when a GOAWAY is received, streams above lastStreamId were not
+       processed by the peer and may be retried.
+      */
+    virtual void OnGoAway(DWORD lastStreamId, ErrorCode error);
+
+    /**Called when the send window on a stream, or the whole connection if
+       streamId is zero, opens up.
+      */
+    virtual void OnSendWindow(DWORD streamId);
+
+    struct Stream
+    {
+      Stream(int sendWindow, int receiveWindow);
+
+      int  m_sendWindow;
+      int  m_receiveWindow;
+      int  m_receiveUnacknowledged;
+      bool m_localClosed;
+      bool m_remoteClosed;
+    };
+    typedef std::map<DWORD, Stream> StreamMap;
+
+    bool IsIdle(DWORD streamId) const;
+    bool ProcessFrame(BYTE type, BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length);
+    bool ProcessData(BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length);
+    bool ProcessHeaders(BYTE type, BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length);
+    bool ProcessHeaderBlock();
+    bool ProcessSettings(BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length);
+    bool ProcessWindowUpdate(DWORD streamId, const BYTE * payload, PINDEX length);
+    bool ApplySetting(unsigned id, DWORD value);
+    bool ConnectionError(ErrorCode error, const char * reason);
+    void StreamError(DWORD streamId, ErrorCode error);
+    bool QueueAcknowledgement(BYTE type, const BYTE * payload, PINDEX length);
+    void CloseStream(StreamMap::iterator it, bool local);
+    BYTE * AppendFrame(BYTE type, BYTE flags, DWORD streamId, PINDEX length);
+
+    bool m_isServer;
+    bool m_expectPreface;
+    bool m_expectSettings;
+    bool m_started;
+    bool m_failed;
+    bool m_goingAway;
+
+    unsigned m_localMaxConcurrentStreams;
+    unsigned m_localWindowSize;
+    unsigned m_peerMaxConcurrentStreams;
+    unsigned m_peerInitialWindowSize;
+    unsigned m_peerMaxFrameSize;
+
+    int  m_connectionSendWindow;
+    int  m_connectionReceiveWindow;
+    int  m_connectionReceiveUnacknowledged;
+
+    DWORD m_nextStreamId;
+    DWORD m_lastPeerStreamId;
+    StreamMap m_streams;
+
+    PHPACKEncoder m_encoder;
+    PHPACKDecoder m_decoder;
+
+    // Header block being accumulated from HEADERS and CONTINUATION frames
+    DWORD      m_headerStreamId;
+    bool       m_headerEndStream;
+    PBYTEArray m_headerBlock;
+    PINDEX     m_headerLength;
+
+    PBYTEArray m_input;
+    PINDEX     m_inputStart;
+    PINDEX     m_inputEnd;
+
+    PBYTEArray m_output;
+    PINDEX     m_outputLength;
+    PINDEX     m_acknowledgementLength;
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHTTP2Server
+
+class PHTTP2Server;
+
+/** Channel representing one HTTP/2 stream on a server.
+    A PHTTPServer object is opened on this channel for each request, so it can
+    be dispatched to the PHTTPSpace/PHTTPResource hierarchy as for HTTP/1.x.
+    Data written is sent as DATA frames, the response status and headers are
+    passed directly from PHTTPServer::StartResponse(), rather than written.
+  */
+class PHTTP2ServerStream : public PChannel
+{
+    PCLASSINFO(PHTTP2ServerStream, PChannel);
+  public:
+    PHTTP2ServerStream(PHTTP2Server & connection, DWORD streamId);
+
+    // Overrides from PChannel
+    virtual PString GetName() const;
+    virtual PBoolean Read(void * buf, PINDEX len);
+    virtual PBoolean Write(const void * buf, PINDEX len);
+    virtual PBoolean Close();
+    virtual PChannel * GetBaseReadChannel() const;
+    virtual PChannel * GetBaseWriteChannel() const;
+
+    /**Set the response status and headers. The HEADERS frame is not queued
+       until the first data is sent, so it can carry END_STREAM if there is
+       no entity body.
+      */
+    void StartResponse(
+      PHTTP::StatusCode code,
+      const PMIMEInfo & headers,
+      long bodySize
+    );
+
+    /**Send everything outstanding and end the stream.
+      */
+    bool Finish();
+
+    DWORD GetStreamId() const { return m_streamId; }
+
+  protected:
+    bool SendPending(bool endStream);
+
+    enum { WindowTimeout = 60 }; // Seconds to wait for the send window, if the transport has no write timeout
+
+    PHTTP2Server & m_connection;
+    DWORD          m_streamId;
+    PHPACK::FieldList m_responseHeaders;
+    bool           m_headersSent;
+    bool           m_finished;
+    PBYTEArray     m_buffer;
+    PINDEX         m_bufferLength;
+
+    // Request, as received
+    PHTTP::Commands m_command;
+    PString         m_method;
+    PURL            m_url;
+    PMIMEInfo       m_mime;
+    PString         m_body;
+    bool            m_requestComplete;
+    bool            m_reset;
+    PSyncPoint      m_windowOpen;
+    bool            m_waitingForWindow;
+
+  friend class PHTTP2Server;
+};
+
+
+/** Server side of a HTTP/2 connection.
+    Frames are read from the transport, the connection's PHTTPServer, by the
+    thread calling Main(). As each request completes it is passed to the
+    listener's stream thread pool, where a PHTTPServer from
+    PHTTPListener::CreateServerForHTTP() dispatches it as usual.
+  */
+class PHTTP2Server : public PHTTP2Connection
+{
+    PCLASSINFO(PHTTP2Server, PHTTP2Connection);
+  public:
+    PHTTP2Server(
+      PHTTPListener & listener,   ///< Listener that accepted the connection
+      PHTTPServer & transport     ///< HTTP/1.x server the connection arrived on
+    );
+    ~PHTTP2Server();
+
+    /**Run the connection until it is closed. If the connection was upgraded
+       from HTTP/1.1, the connection info is that of the request, which is
+       processed as stream 1.
+      */
+    void Main(
+      const PHTTPConnectionInfo * upgrade = NULL
+    );
+
+    PHTTPServer & GetTransport() const { return m_transport; }
+
+  protected:
+    virtual void OnHeaders(DWORD streamId, PHPACK::FieldList & fields, bool endStream);
+    virtual void OnData(DWORD streamId, const BYTE * data, PINDEX length, bool endStream);
+    virtual void OnStreamReset(DWORD streamId, ErrorCode error);
+    virtual void OnSendWindow(DWORD streamId);
+
+    bool ReadTransport();
+    bool WriteTransport();
+    void Dispatch(PHTTP2ServerStream * stream);
+    void ProcessStream(PHTTP2ServerStream * stream);
+    void EndStream(PHTTP2ServerStream * stream);
+
+    struct StreamWork;
+    friend struct StreamWork;
+    friend class PHTTP2ServerStream;
+
+    PHTTPListener & m_listener;
+    PHTTPServer   & m_transport;
+
+    PDECLARE_MUTEX(m_mutex);         // Protects protocol state and the stream map
+    PDECLARE_MUTEX(m_writeMutex);    // Serialises writes to the transport
+    std::map<DWORD, PHTTP2ServerStream *> m_activeStreams;
+    unsigned   m_dispatched;
+    bool       m_closing;
+    PSyncPoint m_allDone;
+    PBYTEArray m_writeBuffer;
+};
+
+
+#endif // P_HTTP
+
+#endif // PTLIB_HTTP2_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -97,6 +97,7 @@ class PHTTPServiceProcess : public PServiceProcess, public PHTTPListener
     static const PString & GetDefaultSection();
 
     class ClearLogPage;
+    class ProfilingPage;
 
     struct Params
     {
@@ -135,6 +136,10 @@ class PHTTPServiceProcess : public PServiceProcess, public PHTTPListener
       ClearLogPage  * m_clearLogPage;   // Output
       PHTTPTailFile * m_tailLogPage;    // Output
 
+      // Profiling capture, only used if built with P_PROFILING
+      const char    * m_profilingPageName;
+      ProfilingPage * m_profilingPage;  // Output
+
       // HTTP access
       const char *  m_httpPortKey;
       const char *  m_httpInterfacesKey;
@@ -503,6 +508,36 @@ class PHTTPServiceProcess::ClearLogPage : public PServiceHTTPString
 };
 
 
+/**Page to start and stop a capture window with PProfiling, and download it.
+   The query "?format=json" returns a Chrome Trace Event file, "?format=perfetto"
+   a Perfetto protobuf trace, and "?format=text" the PProfiling::Analyse() summary.
+  */
+class PHTTPServiceProcess::ProfilingPage : public PServiceHTTPString
+{
+    PCLASSINFO(ProfilingPage, PServiceHTTPString);
+  public:
+    ProfilingPage(PHTTPServiceProcess & process, const PURL & url, const PHTTPAuthority & auth);
+
+    virtual PBoolean LoadData(
+      PHTTPRequest & request,    // Information on this request.
+      PCharArray & data          // Data used in reply.
+    );
+
+    virtual PString LoadText(
+      PHTTPRequest & request    // Information on this request.
+      );
+
+    virtual PBoolean Post(
+      PHTTPRequest & request,
+      const PStringToString &,
+      PHTML & msg
+    );
+
+  protected:
+    PHTTPServiceProcess & m_process;
+};
+
+
 #endif // P_HTTPFORMS
 
 #endif // PTLIB_HTTPSVC_H
@@ -118,6 +118,26 @@ class PInternetProtocol : public PIndirectChannel
       PINDEX len        ///< Number of bytes to write.
     );
 
+    /** Low level scattered read from the channel.
+
+       Any characters put back with <A>UnRead()</A> are returned first, the
+       rest is read with a single scattered read on the underlying channel.
+     */
+    virtual bool Read(
+      Slice * slices,
+      size_t sliceCount
+    );
+
+    /** Low level gathered write to the channel.
+
+       If no byte stuffing is being done, this is a single gathered write on
+       the underlying channel, otherwise each slice is written in turn.
+     */
+    virtual bool Write(
+      const Slice * slices,
+      size_t sliceCount
+    );
+
      /** Set the maximum timeout between characters within a line. Default
         value is 10 seconds.
       */
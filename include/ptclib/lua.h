@@ -79,17 +79,27 @@ class PLua : public PScriptLanguage
     virtual bool IsInitialised() const;
 
     /**Load a Lua script from a file.
+       The compiled form is cached, so loading the file again, while it is
+       unchanged, does not need to parse it again.
       */
     virtual bool LoadFile(
       const PFilePath & filename  ///< Name of script file to load
     );
 
     /** Load a Lua script text.
+       The compiled form is cached, as for LoadFile().
       */
     virtual bool LoadText(
       const PString & text  ///< Script text to load.
     );
 
+    /**Set the number of compiled scripts cached, shared by all instances.
+       Zero disables the cache, the default is 100.
+      */
+    static void SetBytecodeCacheSize(
+      PINDEX entries  ///< Maximum scripts held
+    );
+
     /**Run the script.
        If \p script is NULL or empty then the currently laoded script is
        executed. If \p script is an existing file, then that will be loaded
@@ -154,6 +164,32 @@ class PLua : public PScriptLanguage
       const PVarType & var
     );
 
+    /**Compile a variable or function name.
+       The tables containing the variable are looked up on first use, and
+       then held in the Lua registry, so each access is a single lookup.
+       If the containing tables are replaced, other than by CreateTable(),
+       DeleteTable() or Run(), the handle continues to refer to the old one.
+
+       See class description for how \p name is parsed.
+      */
+    virtual Handle CompileName(
+      const PString & name  ///< Name of variable or function
+    );
+
+    /**Get a variable in the script using a compiled name.
+      */
+    virtual bool GetVar(
+      const Handle & handle,  ///< Handle from CompileName()
+      PVarType & var
+    );
+
+    /**Set a variable in the script using a compiled name.
+      */
+    virtual bool SetVar(
+      const Handle & handle,  ///< Handle from CompileName()
+      const PVarType & var
+    );
+
     /**Get a variable in the script as a string value.
        See class description for how \p name is parsed.
       */
@@ -258,6 +294,10 @@ class PLua : public PScriptLanguage
       const PString & name,       ///< Name of function to execute.
       Signature & signature ///< Signature of arguments following
     );
+    bool Call(
+      const Handle & handle,      ///< Handle from CompileName() of function
+      Signature & signature ///< Signature of arguments following
+    );
 
 
     #define PDECLARE_LuaFunctionNotifier(cls, fn) PDECLARE_NOTIFIER2(PLua, cls, fn, PScriptLanguage::Signature &)
@@ -277,12 +317,29 @@ class PLua : public PScriptLanguage
     virtual bool OnLuaError(int code, const PString & str = PString::Empty(), int pop = 0);
 
     bool ParseVariableName(const PString & name, PStringArray & vars);
+    int InternalLoad(const PString & source, bool isFile);
     bool InternalGetVariable(const PString & name);
     bool InternalSetVariable(const PString & name);
+    bool InternalPushCompiled(const Handle & handle);
+    bool InternalGetVariable(const Handle & handle);
+    bool InternalSetVariable(const Handle & handle);
+    void InternalInvalidateCompiled() { ++m_compiledGeneration; }
+    bool InternalPopVar(PVarType & var);
+    bool InternalPushVar(const PVarType & var);
+    bool InternalCall(const PString & name, Signature & signature);
     static int InternalCallback(lua_State * state);
     int InternalCallback();
 
     lua_State * m_lua;
+
+    struct CompiledName {
+      PStringArray m_tables;   // Tables to get to the variable, empty for a global
+      int          m_tableRef; // Registry reference to last table, LUA_NOREF until used
+      int          m_keyRef;   // Registry reference to variable name in that table
+      unsigned     m_generation; // m_compiledGeneration when m_tableRef was found
+    };
+    std::vector<CompiledName> m_compiled;
+    unsigned                  m_compiledGeneration; // Changed whenever Lua code may have replaced a table
 };
 
 
@@ -174,6 +174,173 @@ class PMemoryFile : public PFile
 };
 
 
+/**This class is a disk file that is accessed through a memory mapping,
+   rather than read() and write() calls. It is intended for large, read
+   mostly, files such as media clips, where the data may be used directly
+   from the mapping without copying, see GetSpan() and ReadSpan().
+
+   The whole file is mapped when opened. Writing past the end of the file
+   extends and re-maps it, which invalidates any spans obtained, so
+   appending is slow and should be done with PFile.
+ */
+class PMappedFile : public PFile
+{
+  PCLASSINFO(PMappedFile, PFile);
+  public:
+    /// How the file is expected to be accessed, used for read ahead.
+    enum Advice {
+      NormalAccess,     ///< No particular order
+      SequentialAccess, ///< From start to end, aggressive read ahead
+      RandomAccess,     ///< No read ahead
+      WillNeedAccess    ///< Read the whole file in to memory as soon as possible
+    };
+
+  /**@name Construction */
+  //@{
+    /**Create a new mapped file, not yet open.
+      */
+    PMappedFile(
+      Advice advice = SequentialAccess,  ///< Expected access
+      bool hugePages = false             ///< Align mapping for transparent huge pages
+    );
+
+    /**Create a mapped file and open it.
+      */
+    PMappedFile(
+      const PFilePath & name,            ///< Name of file to open.
+      OpenMode mode = ReadOnly,          ///< Mode in which to open the file.
+      OpenOptions opts = ModeDefault,    ///< <code>OpenOptions</code> enum# for open operation.
+      Advice advice = SequentialAccess   ///< Expected access
+    );
+
+    /**Destroy the mapped file
+      */
+    ~PMappedFile();
+  //@}
+
+
+  /**@name Overrides from class PChannel */
+  //@{
+    /** Close the file, removing the mapping.
+
+       @return true if the file successfully closed.
+     */
+    virtual PBoolean Close();
+
+    /**Read from the mapping. This copies the data, see ReadSpan() to avoid
+       that. The GetLastReadCount() function returns the actual number of
+       bytes read.
+
+       @return
+       true indicates that at least one byte was read.
+     */
+    virtual PBoolean Read(
+      void * buf,   ///< Pointer to a block of memory to receive the read bytes.
+      PINDEX len    ///< Maximum number of bytes to read into the buffer.
+    );
+
+    /**Write to the mapping, extending the file if needed. The file must
+       have been opened with write access.
+
+       @return true if at least len bytes were written to the channel.
+     */
+    virtual PBoolean Write(
+      const void * buf, ///< Pointer to a block of memory to write.
+      PINDEX len        ///< Number of bytes to write.
+    );
+  //@}
+
+
+  /**@name Overrides from class PFile */
+  //@{
+    /**Get the current size of the file.
+     */
+    virtual off_t GetLength() const;
+
+    /**Set the size of the file, re-mapping it.
+     */
+    virtual PBoolean SetLength(
+      off_t len   ///< New length of file.
+    );
+
+    /**Set the current active position in the file for the next read or
+       write operation.
+     */
+    virtual PBoolean SetPosition(
+      off_t pos,                         ///< New position to set.
+      FilePositionOrigin origin = Start  ///< Origin for position change.
+    );
+
+    /**Get the current active position in the file for the next read or
+       write operation.
+     */
+    virtual off_t GetPosition() const;
+  //@}
+
+
+  /**@name Mapping access */
+  //@{
+    /**Get a pointer to part of the file, without copying it. The pointer is
+       valid until the file is closed or its length changed.
+
+       @return
+       NULL if the range is not entirely within the file.
+     */
+    const BYTE * GetSpan(
+      off_t offset,   ///< Offset in file of data
+      PINDEX length   ///< Length of data required
+    ) const;
+
+    /**Read from the current position without copying. On return \p data
+       points in to the mapping, as for GetSpan(), and the position is
+       advanced. The GetLastReadCount() function returns the number of bytes
+       available at \p data, which may be less than \p length at the end of
+       the file.
+
+       @return
+       true indicates that at least one byte was read.
+     */
+    bool ReadSpan(
+      const BYTE * & data,  ///< Pointer to data in mapping
+      PINDEX length         ///< Maximum number of bytes to read
+    );
+
+    /**Give the operating system a hint on how the file is to be accessed.
+       This may be done at any time, for the whole file or part of it.
+     */
+    void SetAdvice(
+      Advice advice,      ///< Expected access
+      off_t offset = 0,   ///< Start of region
+      off_t length = 0    ///< Length of region, zero is to end of file
+    );
+
+    /// Indicate the file is mapped, i.e. open and not empty.
+    bool IsMapped() const { return m_data != NULL; }
+
+    /// Set alignment of the mapping for huge pages, used on next open.
+    void SetHugePages(bool hugePages) { m_hugePages = hugePages; }
+  //@}
+
+
+  protected:
+    virtual bool InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions);
+    bool Map();
+    void Unmap();
+
+    Advice m_advice;
+    bool   m_hugePages;
+    bool   m_writable;
+    BYTE * m_data;
+    off_t  m_length;
+    off_t  m_position;
+    void * m_mapBase;  // May be before m_data, if aligned for huge pages
+    size_t m_mapSize;
+#ifdef _WIN32
+    HANDLE m_mapHandle;
+#endif
+};
+
+
 #endif // PTLIB_PMEMFILE_H
 
 
@@ -38,6 +38,9 @@
    PODBC::Row         :  Record wrapper class for the PODBC::RecordSet (PArray of Fields)
    PODBC::Field       :  Database field information (Field structure & bound data)
    PODBC::Statement   :  Wrapper for ODBC "statement" (Internal)
+   PODBC::Prepared    :  Cached prepared statement with parameters, bulk fetch and insert
+   PODBC::RowBlock    :  Block of rows fetched column wise by PODBC::Prepared
+   PODBCPool          :  Thread safe pool of connections
 
   Example of Use
 
@@ -135,6 +138,8 @@ class PODBC  : public PObject
     class RecordSet;
     class Statement;  // Internal use
     struct FieldExtra;  // Internal use
+    struct ColumnArray; // Internal use
+    class Prepared;
 
 
     /** Class for Field Data
@@ -478,6 +483,115 @@ class PODBC  : public PObject
     typedef RecordSet Table; // For backward compatibility
 
 
+    /// Values for the parameter markers, '?', in an SQL statement, in order.
+    typedef std::vector<PVarType> Parameters;
+
+    /// Parameter values for many executions of an SQL statement.
+    typedef std::vector<Parameters> ParameterRows;
+
+
+    /** PODBC::RowBlock
+    A block of rows fetched in one go, held column wise, see
+    PODBC::Prepared::Fetch(). Integer columns are held as 64 bit integers,
+    floating point as double, and everything else as text. Text longer than
+    GetMaxChunkSize(), or 4096 if no chunking, is truncated, a RecordSet
+    should be used for large objects.
+    */
+    class RowBlock : public PObject, PNonCopyable
+    {
+        PCLASSINFO(RowBlock, PObject);
+      public:
+        /// Create a block for up to \p maxRows rows at a time.
+        RowBlock(PINDEX maxRows = 256);
+        ~RowBlock();
+
+        /// Get the maximum rows fetched at a time.
+        PINDEX GetMaxRows() const { return m_maxRows; }
+
+        /// Get the number of rows in the block from the last fetch.
+        PINDEX GetRowCount() const { return m_rowCount; }
+
+        /// Get the number of columns in the result.
+        PINDEX GetColumnCount() const { return m_columns.size(); }
+
+        /// Get the name of a column, index is 1 based as for RecordSet.
+        PString GetColumnName(PINDEX column) const;
+
+        /// Get the column index for the name, zero if not present.
+        PINDEX ColumnByName(const PCaselessString & name) const;
+
+        /**Get values, \p row is zero based within the block and \p column
+           is 1 based as for RecordSet.
+          */
+        bool    IsNULL(PINDEX row, PINDEX column) const;
+        int64_t AsInteger64(PINDEX row, PINDEX column) const;
+        double  AsFloat(PINDEX row, PINDEX column) const;
+        PString AsString(PINDEX row, PINDEX column) const;
+
+      protected:
+        PINDEX m_maxRows;
+        PINDEX m_rowCount;
+        std::vector<ColumnArray *> m_columns;
+
+      friend class Prepared;
+    };
+
+
+    /** PODBC::Prepared
+    An SQL statement prepared once, and executed many times with different
+    parameters. Statements are cached by the connection, keyed by the SQL
+    text, so constructing one of these for text used before costs only a
+    lookup. Only one thread may use the connection at a time, see PODBCPool.
+    */
+    class Prepared : public PObject, PNonCopyable
+    {
+        PCLASSINFO(Prepared, PObject);
+      public:
+        /** Get the prepared statement for the SQL text from the cache of the
+            connection, preparing it if not already there.
+          */
+        Prepared(PODBC & odbc, const PString & sql);
+
+        /// Return the statement to the cache.
+        ~Prepared();
+
+        /// Indicate the statement was prepared successfully.
+        bool IsValid() const;
+
+        /// Execute the statement with no parameters.
+        bool Execute() { return Execute(Parameters()); }
+
+        /** Execute the statement, binding the values to the parameter
+            markers. Any previous results are discarded.
+          */
+        bool Execute(const Parameters & params);
+
+        /** Execute the statement once for every row of values, in one call
+            to the driver using parameter arrays. The type of each parameter
+            is taken from the first row with a non-NULL value for it.
+          */
+        bool Execute(const ParameterRows & rows);
+
+        /** Fetch the next block of rows of the result.
+            @return false if there are no more rows, or an error.
+          */
+        bool Fetch(RowBlock & block);
+
+        /// Get the number of rows changed by the last Execute().
+        PINDEX GetChangedRowCount();
+
+      protected:
+        bool BindParameters(const Parameters * rows, PINDEX count);
+        bool BindColumns(RowBlock & block);
+
+        PODBC     & m_odbc;
+        Statement * m_statement;
+        bool        m_cached;
+        RowBlock  * m_boundBlock;
+        std::vector<ColumnArray *> m_parameters;
+    };
+
+
     /**@name DataSource Access */
     //@{
     /** Driver types that are supported by this implementation.
@@ -708,8 +822,26 @@ class PODBC  : public PObject
     */
     bool Execute(const PString & sql);
 
+    /** Execute an SQL statement with parameters, using the cache of
+        prepared statements, see PODBC::Prepared.
+      */
+    bool Execute(const PString & sql, const Parameters & params);
+
+    /** Execute an SQL statement, typically an INSERT, once for every row of
+        parameters, using parameter arrays, see PODBC::Prepared.
+      */
+    bool BulkExecute(const PString & sql, const ParameterRows & rows);
+
     // For backward compatibility
     __inline bool Query(const PString & sql) { return Execute(sql); }
+
+    /** Set the maximum number of prepared statements kept by the connection.
+        The least recently used is dropped when it is exceeded. Default 32.
+      */
+    void SetPreparedCacheSize(PINDEX size);
+
+    /// Get the maximum number of prepared statements kept by the connection.
+    PINDEX GetPreparedCacheSize() const { return m_preparedCacheSize; }
     //@}
 
 
@@ -777,10 +909,87 @@ class PODBC  : public PObject
     PTime::TimeFormat m_dateTimeFormat;
     bool              m_needChunking;
     PINDEX            m_maxChunkSize;
+    PINDEX            m_preparedCacheSize;
 
     P_REMOVE_VIRTUAL_VOID(OnSQLError(const PString &, const PString &));
 
   friend class Statement;
+  friend class Prepared;
+};
+
+
+/** Pool of connections to a data source, for use by many threads.
+    A PODBC instance may only be used by one thread at a time, so each thread
+    acquires a connection for the duration of its work. Connections keep their
+    cache of prepared statements while idle in the pool.
+  */
+class PODBCPool : public PObject, PNonCopyable
+{
+    PCLASSINFO(PODBCPool, PObject)
+  public:
+    /**Create a pool of connections to the data source.
+      */
+    PODBCPool(
+      const PODBC::ConnectData & connectData, ///< Data source to connect to
+      unsigned maxConnections = 16,           ///< Maximum connections in use at once
+      unsigned maxIdle = 8                    ///< Maximum connections kept when not in use
+    );
+
+    /// Destroy the pool, all connections must have been released.
+    ~PODBCPool();
+
+    /**Create connections now, rather than on first use.
+       @return false if a connection could not be made.
+      */
+    bool Preload(
+      unsigned count  ///< Number of idle connections to have
+    );
+
+    /**Get a connection for exclusive use, waiting for one to be released
+       if the maximum are in use.
+       @return NULL if timed out or a connection could not be made.
+      */
+    PODBC * Acquire(
+      const PTimeInterval & timeout = PMaxTimeInterval
+    );
+
+    /// Return a connection from Acquire().
+    void Release(
+      PODBC * odbc  ///< Connection to release
+    );
+
+    /// Acquire a connection for the life of this object.
+    class Connection
+    {
+      public:
+        Connection(PODBCPool & pool, const PTimeInterval & timeout = PMaxTimeInterval)
+          : m_pool(pool), m_odbc(pool.Acquire(timeout)) { }
+        ~Connection() { m_pool.Release(m_odbc); }
+
+        bool IsValid() const { return m_odbc != NULL; }
+        PODBC * operator->() const { return m_odbc; }
+        PODBC & operator*() const { return *m_odbc; }
+
+      private:
+        Connection(const Connection &);
+        void operator=(const Connection &);
+
+        PODBCPool & m_pool;
+        PODBC     * m_odbc;
+    };
+
+    /// Get the last error from making a connection.
+    PString GetLastErrorText() const;
+
+  protected:
+    virtual PODBC * CreateConnection();
+
+    PODBC::ConnectData   m_connectData;
+    unsigned             m_maxIdle;
+    PSemaphore           m_available;
+    std::vector<PODBC *> m_idle;
+    PString              m_lastErrorText;
+    PDECLARE_MUTEX(m_mutex);
 };
 
 
@@ -972,14 +972,24 @@ class PSSLContext : public PObject, PNonCopyable
       const char * extension
     );
 
+    /**Set the Application Layer Protocol Negotiation names, e.g. "h2".
+       For a client these are offered to the server in order of preference.
+       For a server, the first of these the client also offered is selected.
+      */
+    bool SetALPN(
+      const PStringArray & protocols  ///< Protocol names, most preferred first
+    );
+
     Method GetMethod() const { return m_method; }
 
   protected:
     void Construct(const void * sessionId, PINDEX idSize);
+    static int ALPNSelectCallback(ssl_st *, const unsigned char **, unsigned char *, const unsigned char *, unsigned, void *);
 
     Method       m_method;
     ssl_ctx_st * m_context;
     PSSLPasswordNotifier m_passwordNotifier;
+    PBYTEArray   m_alpnProtocols; // In wire format, length prefixed names
 };
 
 
@@ -1121,6 +1131,11 @@ class PSSLChannel : public PIndirectChannel
       const PString & name   ///< For client, this is the server we are conneting to
     );
 
+    /**Get the protocol selected by Application Layer Protocol Negotiation.
+       Returns empty string if none was negotiated.
+      */
+    PString GetALPN() const;
+
     /**Check the host name against the certificate.
        Note if SetVerifyMode() is set to VerifyNone, this always returns true.
       */
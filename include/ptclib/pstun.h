@@ -197,6 +197,7 @@ struct PSTUNAttribute
 
     FINGERPRINT         = 0x8028,   // RFC 5389
 
+    SOFTWARE            = 0x8022,   // RFC 5389
     ALTERNATE_SERVER    = 0x8023,   // RFC 5389
 
     RESPONSE_ORIGIN     = 0x802b,   // RFC 5389 (added in RFC 5780)
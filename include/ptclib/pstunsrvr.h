@@ -44,6 +44,7 @@ class PSTUNServer : public PObject, public PSTUN
   PCLASSINFO(PSTUNServer, PObject)
   public:
     PSTUNServer();
+    ~PSTUNServer();
     
     bool Open(WORD port = DefaultPort);
     bool Open(PUDPSocket * socket1, PUDPSocket * socket2 = NULL);
@@ -71,6 +72,45 @@ class PSTUNServer : public PObject, public PSTUN
 
     virtual bool Process();
 
+    /**Start multi-threaded operation.
+       This creates \p count worker threads, each with its own socket bound to
+       the same \p binding using SO_REUSEPORT, so the kernel distributes the
+       requests across them. Where the platform supports it, each worker
+       receives and sends in batches.
+
+       A plain RFC 5389 binding request is answered directly by the worker,
+       building the response, MESSAGE-INTEGRITY and FINGERPRINT in buffers
+       preallocated for that thread. Note that this bypasses
+       OnBindingResponse(), see SetWorkerFastPath(). All other messages are
+       passed to OnReceiveMessage(), serialised between the workers.
+
+       The credentials are captured when the workers are started.
+
+       Workers are not compatible with the alternate address/port sockets
+       created by Open(), so any CHANGE-REQUEST will get a 420 error.
+
+       @return false if no sockets could be bound.
+      */
+    bool StartWorkers(
+      const PIPSocketAddressAndPort & binding,  ///< Interface and port to listen on
+      unsigned count = 0                        ///< Number of workers, zero is one per processor
+    );
+
+    /// Stop all worker threads started by StartWorkers().
+    void StopWorkers();
+
+    /// Indicate worker threads are running.
+    bool HasWorkers() const { return !m_workers.empty(); }
+
+    /// Get total requests received by worker threads.
+    PUInt64 GetWorkerRequestCount() const;
+
+    /**Enable the worker threads answering binding requests directly.
+       This should be disabled if OnBindingResponse() is overridden.
+       Default is enabled.
+      */
+    void SetWorkerFastPath(bool enable) { m_workerFastPath = enable; }
+
     virtual bool OnReceiveMessage(
       const PSTUNMessage & message,
       const SocketInfo & socketInfo
@@ -104,10 +144,118 @@ class PSTUNServer : public PObject, public PSTUN
 
     bool m_autoDelete;
 
+    class Worker;
+    friend class Worker;
+    std::vector<Worker *> m_workers;
+    PDECLARE_MUTEX(m_workerMutex);
+    bool m_workerFastPath;
+
     PTRACE_THROTTLE(m_throttleReceivedPacket, 3, 30000, 5);
 };
 
 
+#if P_TURN
+
+/**TURN relay server, as per RFC 5766/RFC 8656.
+   This extends the STUN server with UDP allocations, permissions, channel
+   bindings and their refresh timers. Binding requests arriving on the TURN
+   port are handled as for PSTUNServer.
+
+   The server is run by StartRelay(), which creates one relay thread per
+   processor, each with its own SO_REUSEPORT socket for clients. As the kernel
+   hashes a client's address to the same socket every time, each allocation
+   belongs to a single relay thread and the data plane needs no locks. On
+   Linux, packets are received and sent in batches with recvmmsg() and
+   sendmmsg(), the relay sockets multiplexed with epoll. Allocations are
+   found from the client address in a hash table, relayed data is framed in
+   place in preallocated buffers, so nothing is allocated per packet.
+
+   Authentication uses the long term credential mechanism when a realm is
+   set via SetCredentials(), short term if only a password is set, and
+   nothing if neither is set. Only IPv4 is supported for clients and peers.
+  */
+class PTURNServer : public PSTUNServer
+{
+  PCLASSINFO(PTURNServer, PSTUNServer)
+  public:
+    PTURNServer();
+    ~PTURNServer();
+
+    enum {
+      DefaultLifetime = 600,            ///< Allocation lifetime in seconds
+      MaxLifetime = 3600,               ///< Maximum allocation lifetime in seconds
+      PermissionLifetime = 300,         ///< Permission lifetime in seconds
+      ChannelLifetime = 600,            ///< Channel binding lifetime in seconds
+      NonceLifetime = 3600              ///< Time in seconds after which a nonce becomes stale
+    };
+
+    /**Start the relay threads.
+       @return false if no sockets could be bound.
+      */
+    bool StartRelay(
+      const PIPSocketAddressAndPort & binding,  ///< Interface and port for clients
+      unsigned count = 0,                       ///< Number of relay threads, zero is one per processor
+      const PIPSocket::Address & relayInterface = PIPSocket::GetInvalidAddress() ///< Interface for relayed sockets, default is binding address
+    );
+
+    /// Stop the relay threads, and release all allocations.
+    void StopRelay();
+
+    /// Indicate relay threads are running.
+    bool IsRelaying() const { return !m_relays.empty(); }
+
+    /**Set the address returned to clients in XOR-RELAYED-ADDRESS.
+       This is for when the relay interface is behind a 1:1 NAT, only the
+       IP address is changed.
+      */
+    void SetRelayedAddress(const PIPSocket::Address & addr) { m_relayedAddress = addr; }
+
+    /// Set the maximum number of allocations for each relay thread.
+    void SetMaxAllocations(unsigned max) { m_maxAllocations = max; }
+
+    struct Statistics {
+      Statistics();
+      unsigned m_allocations;     ///< Current allocations
+      PUInt64  m_toPeers;         ///< Packets relayed from clients to peers
+      PUInt64  m_toClients;       ///< Packets relayed from peers to clients
+      PUInt64  m_dropped;         ///< Packets dropped for no allocation, permission or channel, or truncated
+    };
+
+    /// Get the statistics summed across all relay threads.
+    Statistics GetStatistics() const;
+
+    /**Get the key used for MESSAGE-INTEGRITY for the user.
+       The default returns the credentials from SetCredentials(), an override
+       may look up a user database. For the long term mechanism this is the
+       MD5 of "username:realm:password".
+
+       Note this may be called from several relay threads at once.
+      */
+    virtual bool GetCredentialKey(
+      const PString & userName,
+      PBYTEArray & key
+    ) const;
+
+    /**Indicate a peer is allowed by CreatePermission or ChannelBind.
+       The default allows all addresses. This may be called from several relay
+       threads at once.
+      */
+    virtual bool OnAllowPeer(
+      const PIPSocketAddressAndPort & client,
+      const PIPSocket::Address & peer
+    );
+
+  protected:
+    class Relay;
+    friend class Relay;
+    std::vector<Relay *> m_relays;
+    PIPSocket::Address   m_relayedAddress;
+    unsigned             m_maxAllocations;
+};
+
+#endif // P_TURN
+
+
 #endif // P_STUNSRVR
 
 #endif // PTLIB_PSTUNSRVR_H
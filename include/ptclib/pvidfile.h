@@ -40,6 +40,7 @@
 #if P_VIDFILE
 
 #include <ptlib/videoio.h>
+#include <ptclib/memfile.h>
 
 
 /**Abstract class for a file containing a sequence of video frames.
@@ -65,6 +66,27 @@ class PVideoFile : public PFile
     virtual PBoolean WriteFrame(const void * frame);
     virtual PBoolean ReadFrame(void * frame);
 
+    /**Read a frame without copying it, the pointer is in to the memory
+       mapping of the file, and is valid until the file is closed.
+       This is only available if SetMemoryMapped() was used.
+      */
+    virtual bool ReadFrameSpan(const BYTE * & frame);
+
+    /**Set the file to be read through a memory mapping, see PMappedFile.
+       This must be set before the file is opened, and is only used if it is
+       opened ReadOnly.
+      */
+    void SetMemoryMapped(
+      bool mapped = true,   ///< Use a memory mapping
+      bool hugePages = false ///< Align mapping for transparent huge pages
+    );
+
+    /// Indicate the file is being read through a memory mapping.
+    bool IsMemoryMapped() const { return m_mappedFile.IsOpen(); }
+
+    virtual PBoolean Read(void * buf, PINDEX len);
+    virtual PBoolean Close();
+
     virtual PBoolean SetFrameSize(
       unsigned width,   ///< New width of frame
       unsigned height   ///< New height of frame
@@ -88,12 +110,20 @@ class PVideoFile : public PFile
     PString GetColourFormat() const { return m_videoInfo.GetColourFormat(); }
 
   protected:
+    virtual bool InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions);
+
+    // Position in bytes, rather than frames, from the mapping if used
+    off_t GetBytePosition() const;
+    bool SetBytePosition(off_t pos, PFile::FilePositionOrigin origin = PFile::Start);
+
     bool   m_fixedFrameSize;
     bool   m_fixedFrameRate;
     PINDEX m_frameBytes;
     off_t  m_headerOffset;
     off_t  m_frameHeaderLen;
     PVideoFrameInfo m_videoInfo;
+    bool        m_memoryMapped;
+    PMappedFile m_mappedFile;
 };
 
 typedef PFactory<PVideoFile, PFilePathString> PVideoFileFactory;
@@ -110,9 +140,11 @@ class PYUVFile : public PVideoFile
 
     virtual PBoolean WriteFrame(const void * frame);
     virtual PBoolean ReadFrame(void * frame);
+    virtual bool ReadFrameSpan(const BYTE * & frame);
 
   protected:
     virtual bool InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions);
+    bool ReadFrameHeader();
 
     bool m_y4mMode;
 };
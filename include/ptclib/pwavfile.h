@@ -40,6 +40,7 @@
 #ifdef P_WAVFILE
 
 #include <ptlib/pfactory.h>
+#include <ptclib/audiomix.h>
 
 class PWAVFile;
 
@@ -414,6 +415,7 @@ public:
 
   // Internal stuff
   bool RawRead(void * buf, PINDEX len);
+  bool FillReadBuffer();
   bool RawWrite(const void * buf, PINDEX len);
 
   off_t RawGetPosition() const;
@@ -457,6 +459,8 @@ protected:
   PShortArray  m_readBuffer;
   PINDEX       m_readBufCount;
   PINDEX       m_readBufPos;
+  PAudioResampler m_resampler;
+  PShortArray  m_resampleBuffer;
 };
 
 #endif // P_WAVFILE
@@ -0,0 +1,164 @@
+/*
+ * pzlib.h
+ *
+ * zlib compression, as used for HTTP content encoding.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_PZLIB_H
+#define PTLIB_PZLIB_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <ptlib_config.h>
+
+#if P_ZLIB
+
+
+/** Compressor or decompressor using the zlib library.
+    Data may be given in pieces, as it arrives, so a large body never needs
+    to be held in memory. The output is appended to a buffer, which grows as
+    required, in the same way as PHPACKEncoder::Encode().
+  */
+class PZLib : public PObject
+{
+    PCLASSINFO(PZLib, PObject);
+  public:
+    enum Format {
+      Deflate,    ///< zlib wrapper, RFC 1950, which HTTP calls "deflate"
+      GZip,       ///< gzip wrapper, RFC 1952
+      RawDeflate, ///< No wrapper, RFC 1951
+      NumFormats
+    };
+
+    enum FlushMode {
+      NoFlush,    ///< Output only when it is efficient to do so
+      SyncFlush,  ///< Output everything so far, so the peer can decode it
+      Finish      ///< Output everything and end the stream
+    };
+
+    enum {
+      DefaultLevel = -1,
+      FastestLevel = 1,
+      BestLevel = 9
+    };
+
+    PZLib(
+      bool compress,              ///< Compress, rather than decompress
+      Format format = GZip,       ///< Wrapper around compressed data
+      int level = DefaultLevel    ///< Compression level
+    );
+    ~PZLib();
+
+    /**Process some data, appending the result to the output.
+       The flush mode is only used when compressing, when decompressing the
+       end of the stream is found from the data itself, see IsFinished().
+       @return false if the compressed data is corrupt.
+      */
+    bool Process(
+      const void * data,          ///< Data to process
+      PINDEX length,              ///< Length of data
+      PBYTEArray & output,        ///< Buffer to append to
+      PINDEX & outputLength,      ///< Length of valid data in buffer, updated
+      FlushMode flush = NoFlush   ///< How much output to force
+    );
+
+    /// Indicate the end of the stream has been written, or read.
+    bool IsFinished() const { return m_finished; }
+
+    /**Set the limit for GetTotalOut(), so a small amount of compressed data
+       cannot expand without bound. Process() fails once the output would
+       exceed it. Zero, the default, is no limit.
+      */
+    void SetMaxOutput(PUInt64 maxOutput) { m_maxOutput = maxOutput; }
+
+    /// Indicate Process() failed because of the SetMaxOutput() limit.
+    bool HasExceededMaxOutput() const { return m_exceededMaxOutput; }
+
+    /// Get the total bytes given to Process().
+    PUInt64 GetTotalIn() const;
+
+    /// Get the total bytes output by Process().
+    PUInt64 GetTotalOut() const;
+
+    /// Compress a whole block.
+    static bool Compress(
+      const void * data,
+      PINDEX length,
+      PBYTEArray & output,
+      Format format = GZip,
+      int level = DefaultLevel
+    );
+
+    /// Decompress a whole block.
+    static bool Decompress(
+      const void * data,
+      PINDEX length,
+      PBYTEArray & output,
+      Format format = GZip,
+      PUInt64 maxOutput = 0   ///< Limit on the output size, see SetMaxOutput()
+    );
+
+    /// Get the HTTP Content-Encoding token for the format.
+    static PString GetContentEncoding(
+      Format format
+    );
+
+    /**Get the format for a HTTP Content-Encoding token.
+       @return false if not a format we can decode.
+      */
+    static bool FromContentEncoding(
+      const PString & encoding,
+      Format & format
+    );
+
+    /**Select the format to use for a response, given a HTTP Accept-Encoding
+       header. Quality values are honoured, gzip is preferred if equal.
+       @return false if no format we can produce is acceptable.
+      */
+    static bool SelectContentEncoding(
+      const PString & acceptEncoding,
+      Format & format
+    );
+
+    /// The value we send in a HTTP Accept-Encoding header.
+    static const PString & GetAcceptEncoding();
+
+  protected:
+    bool Init();
+
+    bool   m_compress;
+    Format m_format;
+    int    m_level;
+    bool   m_finished;
+    bool   m_failed;
+    bool   m_started;
+    PUInt64 m_maxOutput;
+    bool   m_exceededMaxOutput;
+    void * m_stream;  // z_stream, so users do not need zlib.h
+};
+
+
+#endif // P_ZLIB
+
+#endif // PTLIB_PZLIB_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
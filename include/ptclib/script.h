@@ -219,6 +219,53 @@ class PScriptLanguage : public PObject
       const char * value    ///< New value
     );
 
+    /**Compiled form of a variable or function name, see CompileName().
+      */
+    class Handle
+    {
+      public:
+        Handle() : m_index(P_MAX_INDEX) { }
+        explicit Handle(PINDEX index) : m_index(index) { }
+
+        bool IsValid() const { return m_index != P_MAX_INDEX; }
+        PINDEX GetIndex() const { return m_index; }
+
+      protected:
+        PINDEX m_index;
+    };
+
+    /**Compile a variable or function name.
+       The name is parsed once, and the handle used thereafter, rather than
+       the name being parsed, and each table looked up, on every access.
+       Compiling the same name again returns the same handle.
+
+       See class description for how \p name is parsed.
+
+       @return Invalid handle if \p name is illegal.
+      */
+    virtual Handle CompileName(
+      const PString & name  ///< Name of variable or function
+    );
+
+    /// Get the name a handle was compiled from.
+    PString GetHandleName(
+      const Handle & handle  ///< Handle from CompileName()
+    ) const;
+
+    /**Get a variable in the script using a compiled name.
+      */
+    virtual bool GetVar(
+      const Handle & handle,  ///< Handle from CompileName()
+      PVarType & var
+    );
+
+    /**Set a variable in the script using a compiled name.
+      */
+    virtual bool SetVar(
+      const Handle & handle,  ///< Handle from CompileName()
+      const PVarType & var
+    );
+
     /**Release a variable name.
        Note the exact semantics is language dependant. It generally applies
        to global variables as most languages have automatic garbage collection
@@ -279,6 +326,10 @@ class PScriptLanguage : public PObject
       const PString & name,       ///< Name of function to execute.
       Signature & signature ///< Signature of arguments following
     ) = 0;
+    virtual bool Call(
+      const Handle & handle,      ///< Handle from CompileName() of function
+      Signature & signature ///< Signature of arguments following
+    );
 
     typedef PNotifierTemplate<Signature &>  FunctionNotifier;
     #define PDECLARE_ScriptFunctionNotifier(cls, fn) PDECLARE_NOTIFIER2(PScriptLanguage, cls, fn, PScriptLanguage::Signature &)
@@ -318,7 +369,96 @@ class PScriptLanguage : public PObject
     typedef map<PString, FunctionNotifier> FunctionMap;
     FunctionMap m_functions;
     PStringList m_scopeChain;
+    std::vector<PString> m_compiledNames;
+
+    PDECLARE_MUTEX(m_mutex);
+};
 
+
+/**A pool of script language instances, each with a script loaded and run.
+   Concurrent users each get their own instance, so do not contend for one
+   interpreter, nor pay for creating and loading one every time.
+
+   Note an instance is reused as it is left, so anything a user changes is
+   seen by the next, scripts should set what they rely on.
+ */
+class PScriptPool : public PObject
+{
+  PCLASSINFO(PScriptPool, PObject)
+  public:
+    typedef PNotifierTemplate<PScriptLanguage &> InitialiseNotifier;
+    #define PDECLARE_ScriptPoolNotifier(cls, fn) PDECLARE_NOTIFIER2(PScriptPool, cls, fn, PScriptLanguage &)
+
+    /**Create a pool of instances of the language.
+       The \p initialise notifier is called for each new instance before the
+       script is loaded and run, e.g. to SetFunction() callbacks.
+      */
+    PScriptPool(
+      const PString & language,   ///< Language name, e.g. "Lua"
+      const PString & script,     ///< File name or text of script, see PScriptLanguage::Load()
+      unsigned maxIdle = 8,       ///< Maximum instances kept when not in use
+      const InitialiseNotifier & initialise = InitialiseNotifier()
+    );
+
+    /// Destroy the pool, all instances must have been released.
+    ~PScriptPool();
+
+    /**Create instances now, rather than on first use.
+       @return false if an instance could not be created.
+      */
+    bool Preload(
+      unsigned count  ///< Number of idle instances to have
+    );
+
+    /**Compile a variable or function name, for every instance.
+       See PScriptLanguage::CompileName().
+      */
+    PScriptLanguage::Handle CompileName(
+      const PString & name  ///< Name of variable or function
+    );
+
+    /**Get an instance for exclusive use.
+       @return NULL if an instance could not be created.
+      */
+    PScriptLanguage * Acquire();
+
+    /// Return an instance from Acquire().
+    void Release(
+      PScriptLanguage * script  ///< Instance to release
+    );
+
+    /// Acquire an instance for the life of this object.
+    class Instance
+    {
+      public:
+        Instance(PScriptPool & pool) : m_pool(pool), m_script(pool.Acquire()) { }
+        ~Instance() { m_pool.Release(m_script); }
+
+        bool IsValid() const { return m_script != NULL; }
+        PScriptLanguage * operator->() const { return m_script; }
+        PScriptLanguage & operator*() const { return *m_script; }
+
+      private:
+        Instance(const Instance &);
+        void operator=(const Instance &);
+
+        PScriptPool     & m_pool;
+        PScriptLanguage * m_script;
+    };
+
+    /// Get the last error from creating an instance.
+    PString GetLastErrorText() const;
+
+  protected:
+    PScriptLanguage * CreateInstance();
+
+    PString              m_language;
+    PString              m_script;
+    unsigned             m_maxIdle;
+    InitialiseNotifier   m_initialise;
+    PStringArray         m_compiledNames;
+    std::vector<PScriptLanguage *> m_idle;
+    PString              m_lastErrorText;
     PDECLARE_MUTEX(m_mutex);
 };
 
@@ -38,6 +38,7 @@
 #include <ptlib.h>
 
 #include <ptlib/pdirect.h>
+#include <ptlib/dirwatch.h>
 #include <ptclib/guid.h>
 
 class PSpoolDirectory : PObject
@@ -71,6 +72,8 @@ class PSpoolDirectory : PObject
     virtual void SetNotifier(const PNotifier & func);
 
   protected:
+    PDECLARE_DirectoryWatcherNotifier(PSpoolDirectory, OnDirectoryChanged);
+
     PMutex m_mutex;
     PThread * m_thread;
 
@@ -85,6 +88,10 @@ class PSpoolDirectory : PObject
     int m_scanTimeout;
 
     PNotifier m_callback;
+
+    // Wakes the thread as soon as something is spooled, rather than at the next scan
+    PDirectoryWatcher m_watcher;
+    PSyncPoint        m_wakeUp;
 };
 
 
@@ -48,6 +48,33 @@ class PTextDataFormat : public PSmartObject
     const PStringArray & GetHeadings() const { return m_headings; }
     void SetHeadings(const PStringArray & headings) { m_headings = headings; }
 
+    /**Indicate the format implements ScanField() and FormatField(), so that
+       PTextDataFile can read and write in large blocks, rather than a
+       character at a time.
+      */
+    virtual bool SupportsBlocks() const { return false; }
+
+    /**Find the end of a field in a block of text.
+       On entry \p ptr is at the start of a field, on success it is moved to
+       just after the delimiter that ends it. If \p text is not NULL, the
+       field value, without quotes or escapes, is appended to it, otherwise
+       the field is skipped without copying anything.
+       @return 0 if another field follows, 1 if the end of the record, or -1
+               if the field is not complete within the block.
+      */
+    virtual int ScanField(const char * & ptr, const char * end, std::string * text, bool & quoted);
+
+    /**Output a field to a stream, without flushing it.
+       @return false if the field could not be written.
+      */
+    virtual bool FormatField(ostream & strm, const PVarType & field, bool endOfLine);
+
+    /// Output the headings using FormatField().
+    bool FormatHeadings(ostream & strm);
+
+    /// Output a record using FormatField().
+    bool FormatRecord(ostream & strm, const PVarData::Record & data);
+
   protected:
     virtual int ReadField(PChannel & channel, PVarType & field, bool autoDetect) = 0;
     virtual bool WriteField(PChannel & channel, const PVarType & field, bool endOfLine) = 0;
@@ -65,6 +92,10 @@ class PCommaSeparatedVariableFormat : public PTextDataFormat
     PCommaSeparatedVariableFormat();
     PCommaSeparatedVariableFormat(const PStringArray & headings);
 
+    virtual bool SupportsBlocks() const { return true; }
+    virtual int ScanField(const char * & ptr, const char * end, std::string * text, bool & quoted);
+    virtual bool FormatField(ostream & strm, const PVarType & field, bool endOfLine);
+
   protected:
     virtual int ReadField(PChannel & channel, PVarType & field, bool autoDetect);
     virtual bool WriteField(PChannel & channel, const PVarType & field, bool endOfLine);
@@ -78,6 +109,10 @@ class PTabDelimitedFormat : public PTextDataFormat
     PTabDelimitedFormat();
     PTabDelimitedFormat(const PStringArray & headings);
 
+    virtual bool SupportsBlocks() const { return true; }
+    virtual int ScanField(const char * & ptr, const char * end, std::string * text, bool & quoted);
+    virtual bool FormatField(ostream & strm, const PVarType & field, bool endOfLine);
+
   protected:
     virtual int ReadField(PChannel & channel, PVarType & field, bool autoDetect);
     virtual bool WriteField(PChannel & channel, const PVarType & field, bool endOfLine);
@@ -99,6 +134,13 @@ class PTabDelimitedFormat : public PTextDataFormat
 
     Also for reading, if the headings are preset in the format handler, then
     the headings line is not read.
+
+    If the format supports it, see PTextDataFormat::SupportsBlocks(), the file
+    is read in large blocks, in which the field delimiters are found many
+    bytes at a time, and written through a large buffer that is only flushed
+    when full or on Close(). ReadColumns() may then be used to get just some
+    of the fields, converted directly to the wanted type, with the rest
+    skipped over without being converted or copied.
  */
 class PTextDataFile : public PTextFile
 {
@@ -126,8 +168,14 @@ class PTextDataFile : public PTextFile
       OpenOptions opts = ModeDefault,    ///< <code>OpenOptions</code> enum# for open operation.
       PTextDataFormatPtr format = PTextDataFormatPtr()  ///< Format for the text data
     );
+
+    /// Close file, writing anything buffered.
+    ~PTextDataFile();
     //@}
 
+    /// Close the file, writing anything buffered.
+    virtual PBoolean Close();
+
     /** Set the format for the text data file.
         This will fail if the file is already open.
      */
@@ -150,8 +198,42 @@ class PTextDataFile : public PTextFile
     // Write the test data format object
     bool WriteObject(const PVarData::Object & obj);
 
+    /// Column to be read by ReadColumns()
+    struct Column
+    {
+      Column(
+        const PString & heading = PString::Empty(),
+        PVarType::BasicType type = PVarType::VarDynamicString
+      ) : m_heading(heading), m_type(type) { }
+
+      PString             m_heading;  ///< Heading of column in file
+      PVarType::BasicType m_type;     ///< Type value is converted to
+    };
+    typedef std::vector<Column> Columns;
+
+    /**Set the columns to be read by ReadColumns().
+       The file must be open, so the headings are known.
+       @return false if a heading is not in the file.
+      */
+    bool SetColumns(
+      const Columns & columns
+    );
+
+    /**Read just the columns set by SetColumns() from the next record.
+       The \p values are in the same order as the columns. Columns missing
+       from the record are set to zero or empty.
+      */
+    bool ReadColumns(
+      std::vector<PVarType> & values
+    );
+
 protected:
     virtual bool InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions);
+    bool ReadBufferedHeadings();
+    bool ReadBufferedRecord(PVarData::Record & data);
+    int ScanField(std::string * text, bool & quoted);
+    bool SkipLineEnds();
+    bool FillReadBuffer();
 
     PTextDataFormatPtr m_format;
     bool m_formatting;
@@ -159,6 +241,17 @@ protected:
 
     PMutex m_writeMutex;
 
+    // Block reading
+    PCharArray  m_readBuffer;
+    PINDEX      m_readPos;
+    PINDEX      m_readEnd;
+    bool        m_readEOF;
+    std::string m_fieldText;
+
+    // Column projection, field index to column index, -1 if not wanted
+    Columns          m_columns;
+    std::vector<int> m_columnMap;
+
   private:
     virtual PBoolean Read(void * buf, PINDEX len);
     virtual int ReadChar();
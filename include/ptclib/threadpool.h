@@ -38,6 +38,7 @@
 
 #include <ptlib/thread.h>
 #include <ptlib/safecoll.h>
+#include <ptlib/metrics.h>
 #include <map>
 #include <queue>
 
@@ -197,6 +198,16 @@ class PThreadPoolBase : public PObject
       unsigned count
     ) { m_maxWorkUnitCount = count; }
 
+    /// Metrics for all thread pools in the process
+    struct Metrics
+    {
+      Metrics();
+      PMetricGauge     m_queued;
+      PMetricCounter   m_work;
+      PMetricHistogram m_latency;
+    };
+    static Metrics & GetMetrics();
+
   protected:
     PThreadPoolBase(
       unsigned maxWorkerCount,
@@ -437,8 +448,8 @@ class PQueuedThreadPool : public PThreadPool<Work_T>
 
         void AddWork(Work_T * work, const string & group)
         {
-          if (PAssertNULL(work) != NULL)
-            this->m_queue.Enqueue(QueuedWork(work, group));
+          if (PAssertNULL(work) != NULL && this->m_queue.Enqueue(QueuedWork(work, group)))
+            PThreadPoolBase::GetMetrics().m_queued.Inc();
         }
 
         void RemoveWork(Work_T * work)
@@ -465,7 +476,12 @@ class PQueuedThreadPool : public PThreadPool<Work_T>
           PQueuedThreadPool & pool = dynamic_cast<PQueuedThreadPool &>(this->m_pool);
           PTimeInterval latency = item.m_time.GetElapsed();
 
+          PThreadPoolBase::Metrics & metrics = PThreadPoolBase::GetMetrics();
+          metrics.m_queued.Dec();
+          metrics.m_latency.Record(latency);
+
           item.m_work->Work();
+          ++metrics.m_work;
 
           if (!pool.RemoveWork(item.m_work))
             this->RemoveWork(item.m_work);
@@ -128,6 +128,14 @@ class PURL : public PObject
       const PString & str, ///< URL as a string to parse.
       const char * defaultScheme = NULL ///< Default scheme for URL
     ) { return InternalParse((const char *)str, defaultScheme); }
+    /**Parse the URL string into the fields in the object instance. The
+       schemes based on PURLLegacyScheme, e.g. http or sip, parse the view
+       in place, others are given a NUL terminated copy.
+     */
+    PBoolean Parse(
+      const PStringView & str, ///< URL as a string to parse.
+      const char * defaultScheme = NULL ///< Default scheme for URL
+    );
 
     /**Print/String output representation formats. */
     enum UrlFormat {
@@ -224,6 +232,7 @@ class PURL : public PObject
 
     /// Extract scheme as per RFC2396
     static PCaselessString ExtractScheme(const char * str);
+    static PCaselessString ExtractScheme(const PStringView & str);
 
     /// Get the scheme field of the URL.
     const PCaselessString & GetScheme() const { return m_scheme; }
@@ -411,6 +420,7 @@ class PURL : public PObject
   //@}
 
     bool LegacyParse(const char * str, const PURLLegacyScheme & schemeInfo);
+    bool LegacyParse(const PStringView & str, const PURLLegacyScheme & schemeInfo);
     PString LegacyAsString(PURL::UrlFormat fmt, const PURLLegacyScheme * schemeInfo) const;
 
   protected:
@@ -419,6 +429,10 @@ class PURL : public PObject
       const char * cstr,         ///< URL as a string to parse.
       const char * defaultScheme ///< Default scheme for URL
     );
+    PStringView ParseScheme(
+      const PStringView & str,   ///< URL as a string to parse.
+      const char * defaultScheme ///< Default scheme for URL
+    );
     void Recalculate();
 
     const PURLScheme * m_schemeInfo;
@@ -447,6 +461,7 @@ class PURLScheme : public PObject
   PCLASSINFO(PURLScheme, PObject);
   public:
     virtual bool Parse(const char * cstr, PURL & url) const = 0;
+    virtual bool Parse(const PStringView & str, PURL & url) const { return Parse(PStringView::CStr(str), url); }
     virtual PString AsString(PURL::UrlFormat fmt, const PURL & purl) const = 0;
     virtual WORD GetDefaultPort() const { return 0; }
 };
@@ -491,6 +506,11 @@ class PURLLegacyScheme : public PURLScheme
       return url.LegacyParse(cstr, *this);
     }
 
+    bool Parse(const PStringView & str, PURL & url) const
+    {
+      return url.LegacyParse(str, *this);
+    }
+
     PString AsString(PURL::UrlFormat fmt, const PURL & url) const
     {
       return url.LegacyAsString(fmt, this);
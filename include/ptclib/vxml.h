@@ -45,6 +45,8 @@
 #include <ptclib/script.h>
 
 #include <queue>
+#include <list>
+#include <vector>
 
 
 class PVXMLSession;
@@ -340,6 +342,7 @@ class PVXMLCache : public PSafeObject
       size_t        m_size;    // If zero then there is a cache miss, m_file must be written
       PTime         m_expires; // Expiry time of loaded resource for max stale
       PTime         m_date;    // Date of the loaded resource for max age
+      PString       m_etag;    // Entity tag of the loaded resource, if any
     };
     // Start cache operation, if return true, Finish must be called.
     virtual bool StartCache(Params & params);
@@ -348,11 +351,95 @@ class PVXMLCache : public PSafeObject
     void SetDirectory(const PDirectory & directory);
     const PDirectory & GetDirectory() const { return m_directory; }
 
+    /**Set the byte budget for the memory resident tier.
+       Fetched resources, pre-parsed VXML documents and decoded prompt audio
+       are kept in memory, shared read-only between all sessions using this
+       cache, with least recently used entries evicted when the budget is
+       exceeded. A value of zero disables the memory tier.
+      */
+    void SetMemoryLimit(PINDEX bytes);
+    PINDEX GetMemoryLimit() const { return m_memoryLimit; }
+
+    struct Statistics
+    {
+      Statistics();
+
+      PUInt64 m_hits;       // Found in memory tier
+      PUInt64 m_misses;     // Not in memory tier, went to disk or network
+      PUInt64 m_evictions;  // Entries removed to stay within the memory budget
+      PUInt64 m_coalesced;  // Fetches that waited on another session fetching the same resource
+      PINDEX  m_entries;
+      PINDEX  m_bytes;
+
+      friend ostream & operator<<(ostream & strm, const Statistics & stats);
+    };
+    Statistics GetStatistics() const;
+
+    /**Look up fetched resource in memory tier.
+       If this returns false, the caller has become the only fetcher of the
+       resource and EndMemoryFetch() must be called. Other callers for the
+       same key will block until then, and then share the result.
+      */
+    virtual bool BeginMemoryFetch(const Params & params, PBYTEArray & data);
+    virtual void EndMemoryFetch(const Params & params, const PBYTEArray & data, bool success);
+
+    /**Parse VXML document, using pre-parsed tree if available.
+       The key is the URL plus the ETag for the resource if known, otherwise
+       the document text is hashed. The \p xml is given a private copy of
+       the tree, so the session may modify it.
+      */
+    virtual bool LoadDocument(const PString & url, const PString & text, PXML & xml);
+
+    /**Get decoded PCM for a prompt file.
+       The \p key should indicate the format the audio was decoded to. The
+       file modification time and size are used to check the entry is still
+       valid. If not in memory, the \p decoder channel is read to the end.
+      */
+    virtual bool GetMediaData(const PFilePath & fn, const PString & key, PChannel & decoder, PBYTEArray & data);
+
   protected:
     virtual PFilePath CreateFilename(const Params & params);
 
     PDirectory m_directory;
 
+    struct MemoryEntry
+    {
+      MemoryEntry(const PString & key) : m_key(key), m_size(0), m_date(0), m_expires(0) { }
+
+      PString          m_key;
+      PString          m_validator; // ETag or file modification time and size
+      PBYTEArray       m_data;
+      PSharedPtr<PXML> m_document;
+      PINDEX           m_size;
+      PTime            m_date;
+      PTime            m_expires;
+    };
+    typedef std::list<MemoryEntry> MemoryList;
+    typedef std::map<PString, MemoryList::iterator> MemoryIndex;
+
+    struct InFlight
+    {
+      InFlight() : m_waiters(0), m_success(false) { }
+      unsigned   m_waiters;
+      bool       m_success;
+      PSemaphore m_done;
+    };
+    typedef std::map<PString, InFlight *> InFlightMap;
+
+    MemoryEntry * FindMemoryEntry(const PString & key);
+    MemoryEntry & AddMemoryEntry(const PString & key);
+    void AdjustMemoryUsage(MemoryEntry & entry, PINDEX newSize);
+    bool WaitInFlight(const PString & key);
+    void EndInFlight(const PString & key, bool success);
+
+    PDECLARE_MUTEX(m_memoryMutex);
+    atomic<PINDEX> m_memoryLimit; // Also read outside the lock, by LoadDocument() and GetMediaData()
+    PINDEX      m_memoryUsed;
+    MemoryList  m_memoryList; // Most recently used at front
+    MemoryIndex m_memoryIndex;
+    InFlightMap m_inFlight;
+    Statistics  m_statistics;
+
   P_REMOVE_VIRTUAL(bool, Get(const PString &, const PString &, const PString &, PFilePath &), false);
   P_REMOVE_VIRTUAL(bool, PutWithLock(const PString &, const PString &, const PString &, PFile &), false);
   P_REMOVE_VIRTUAL(PFilePath, CreateFilename(const PString &, const PString &, const PString &), "");
@@ -361,6 +448,7 @@ class PVXMLCache : public PSafeObject
 //////////////////////////////////////////////////////////////////
 
 class PVXMLChannel;
+class PVXMLMediaPump;
 
 class PVXMLSession : public PIndirectChannel, public PSSLCertificateInfo
 {
@@ -399,6 +487,7 @@ class PVXMLSession : public PIndirectChannel, public PSSLCertificateInfo
 
     PVXMLChannel * GetAndLockVXMLChannel();
     void UnLockVXMLChannel() { m_sessionMutex.Signal(); }
+    PVXMLMediaPump * GetMediaPump() const { return m_mediaPump; }
     PMutex & GetSessionMutex() { return m_sessionMutex; }
 
     virtual PBoolean PlayText(const PString & text, PTextToSpeech::TextType type = PTextToSpeech::Default, PINDEX repeat = 1, PINDEX delay = 0);
@@ -545,6 +634,11 @@ class PVXMLSession : public PIndirectChannel, public PSSLCertificateInfo
     virtual bool ProcessNode();
     virtual bool ProcessEvents();
     virtual bool NextNode(bool processChildren);
+    void InternalInitialiseDialog();
+    bool InternalIsAwaitingEvent();
+    bool InternalEventOccurred();
+    bool InternalPollEvents();
+    void InternalDialogStep();
     bool SelectMenuChoice(PXMLElement & choice);
     bool ExecuteCondition(PXMLElement & element);
     void ClearBargeIn();
@@ -613,6 +707,25 @@ class PVXMLSession : public PIndirectChannel, public PSSLCertificateInfo
     bool             m_closing;
     bool             m_abortVXML;
     PSyncPoint       m_waitForEvent;
+
+    // Execution on a PVXMLMediaPump rather than m_vxmlThread
+    PVXMLMediaPump * m_mediaPump;
+    PNotifierTemplate<PBYTEArray &> m_pumpNotifier;
+    enum {
+      e_DialogIdle,
+      e_DialogStart,
+      e_DialogNode,
+      e_DialogEvents,
+      e_DialogEndEvents,
+      e_DialogEnded
+    }                m_dialogStep;
+    bool             m_processChildren;
+    bool             m_awaitingEvent;
+    bool             m_pumping;         // Protected by PVXMLMediaPump::m_dialogMutex
+    bool             m_dialogQueued;    // Protected by PVXMLMediaPump::m_dialogMutex
+    PThreadIdentifier m_dialogThreadId; // Protected by PVXMLMediaPump::m_dialogMutex
+    PSyncPoint       m_dialogEnded;
+
     PURL             m_newURL;
     PAutoPtr<PXML>   m_newXML;
     PString          m_lastXMLError;
@@ -692,6 +805,7 @@ class PVXMLSession : public PIndirectChannel, public PSSLCertificateInfo
     void CompletedTransfer(PXMLElement & element);
 
     friend class PVXMLChannel;
+    friend class PVXMLMediaPump;
     friend class PVXMLMenuGrammar;
     friend class PVXMLGrammar;
     friend class PVXMLGrammarSRGS;
@@ -942,13 +1056,24 @@ class PVXMLChannel : public PDelayChannel
 
     PVXMLSession & GetSession() const { return *PAssertNULL(m_vxmlSession); }
 
+    /** Set the channel as driven by a PVXMLMediaPump.
+        The pump provides the real time pacing, so Read() and Write() do not
+        sleep for each frame.
+      */
+    void SetPumped(bool pumped) { m_pumped = pumped; }
+    bool IsPumped() const { return m_pumped; }
+
   protected:
+    // overrides from PDelayChannel
+    virtual void Wait(PINDEX count, PTimeInterval & nextTick);
+
     PVXMLSession * m_vxmlSession;
 
     PDECLARE_MUTEX(m_recordingMutex);
     PDECLARE_MUTEX(m_playQueueMutex);
     bool     m_closed;
     bool     m_paused;
+    bool     m_pumped;
     PINDEX   m_totalData;
 
     // Incoming audio variables
@@ -966,6 +1091,127 @@ class PVXMLChannel : public PDelayChannel
 };
 
 
+//////////////////////////////////////////////////////////////////
+
+/** Media pump for running a large number of PVXMLSession instances on a
+    small number of threads.
+
+    Normally each session has a thread executing the dialog, and the
+    application has a thread per session reading audio from it, which the
+    PVXMLChannel paces by sleeping for each frame. With thousands of
+    sessions that is thousands of threads, every one of them waking up every
+    frame time.
+
+    A session attached to a pump instead has its audio produced by one of a
+    few pump threads, by default one per processor, each of which reads a
+    frame from every session in its batch on a fixed schedule, and passes it
+    to the notifier given to Attach(). The dialog is executed on a shared
+    set of worker threads a step at a time, a step ending when the dialog
+    would otherwise wait for an event, e.g. the end of a prompt, so the
+    worker can go on to another session. Recordings are buffered and written
+    in large blocks by a single background thread, so a slow disk does not
+    hold up the frames.
+
+    Incoming audio is still passed to PVXMLSession::Write(), which does not
+    block in this mode.
+
+    Only linear PCM sessions may be pumped. Note that ProcessEvents() is not
+    used by the dialog steps, so an override of it is not called.
+  */
+class PVXMLMediaPump : public PObject
+{
+    PCLASSINFO(PVXMLMediaPump, PObject);
+  public:
+    typedef PNotifierTemplate<PBYTEArray &> FrameNotifier;
+    #define PDECLARE_VXMLFrameNotifier(cls, fn) PDECLARE_NOTIFIER2(PVXMLSession, cls, fn, PBYTEArray &)
+
+    PVXMLMediaPump(
+      unsigned frameTime = 20,      ///< Milliseconds of audio per frame
+      unsigned pumpThreads = 0,     ///< Threads producing frames, zero is one per processor
+      unsigned dialogThreads = 0    ///< Threads executing dialogs, zero is two per processor
+    );
+    ~PVXMLMediaPump();
+
+    /** Attach a session to the pump.
+        This must be done before the session is opened. While it is open the
+        notifier is called from a pump thread every frame time, with a frame
+        of audio from the session.
+      */
+    bool Attach(
+      PVXMLSession & session,
+      const FrameNotifier & notifier
+    );
+
+    /** Wrap a channel so writes are buffered and performed by the background
+        writer thread. The pump takes ownership of \p channel, which is closed
+        and deleted by the writer after the last of the data.
+      */
+    PChannel * CreateAsyncWriter(
+      PChannel * channel
+    );
+
+    unsigned GetFrameTime() const { return m_frameTime; }
+    PINDEX GetSessionCount() const;
+
+    struct Statistics {
+      Statistics();
+      PUInt64 m_frames;         ///< Frames passed to notifiers
+      PUInt64 m_lateFrames;     ///< Frame times where a batch took too long
+      PUInt64 m_dialogSteps;    ///< Dialog steps executed
+      PUInt64 m_writtenBytes;   ///< Bytes written by the background writer
+      unsigned m_threads;       ///< Threads used by the pump
+    };
+    void GetStatistics(Statistics & stats) const;
+
+  protected:
+    bool InternalOpen(PVXMLSession & session);
+    void InternalClose(PVXMLSession & session);
+    void QueueDialog(PVXMLSession & session);
+    void QueueWrite(PChannel * channel, const PBYTEArray & data, bool close);
+    void PumpMain(PINDEX index);
+    void DialogMain();
+    void WriterMain();
+
+    struct Entry {
+      Entry(PVXMLSession * session = NULL, PINDEX frameSize = 0) : m_session(session), m_frame(frameSize) { }
+      PVXMLSession * m_session;
+      PBYTEArray     m_frame;
+    };
+    struct Batch {
+      Batch() : m_thread(NULL), m_frames(0), m_lateFrames(0) { }
+      std::vector<Entry> m_entries;
+      PDECLARE_MUTEX(m_mutex);
+      PThread * m_thread;
+      PUInt64   m_frames;
+      PUInt64   m_lateFrames;
+    };
+    std::vector<Batch *> m_batches;
+
+    std::list<PVXMLSession *> m_dialogQueue;
+    PDECLARE_MUTEX(m_dialogMutex);
+    PSemaphore                m_dialogAvailable;
+    std::vector<PThread *>    m_dialogThreads;
+    atomic<PUInt64>           m_dialogSteps;
+
+    struct WriteItem {
+      WriteItem(PChannel * channel = NULL, const PBYTEArray & data = PBYTEArray(), bool close = false)
+        : m_channel(channel), m_data(data), m_close(close) { }
+      PChannel * m_channel;
+      PBYTEArray m_data;
+      bool       m_close;
+    };
+    PSyncQueue<WriteItem> m_writeQueue;
+    PThread *             m_writerThread;
+    atomic<PUInt64>       m_writtenBytes;
+
+    unsigned m_frameTime;
+    bool     m_shutdown;
+
+    friend class PVXMLSession;
+    friend class PVXMLAsyncWriter;
+};
+
+
 //////////////////////////////////////////////////////////////////
 
 class PVXMLNodeHandler : public PObject
@@ -223,8 +223,13 @@ class PAbstractArray : public PContainer
     );
   //@}
 
+    /// Indicate the array contents are stored inline in the container reference.
+    bool IsInline() const { return m_theArray != NULL && reference->inlineStorage &&
+                                   m_theArray == static_cast<PInlineContainerReference *>(reference)->inlineData.bytes; }
+
   protected:
     PBoolean InternalSetSize(PINDEX newSize, PBoolean force);
+    char * InternalAllocate(PContainerReference & ref, PINDEX sizeBytes);
 
     virtual void PrintElementOn(
       ostream & stream,
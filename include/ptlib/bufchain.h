@@ -0,0 +1,269 @@
+/*
+ * bufchain.h
+ *
+ * Reference counted chain of buffers, for I/O without copying.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_BUFCHAIN_H
+#define PTLIB_BUFCHAIN_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <ptlib/channel.h>
+#include <deque>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PBufferChain
+
+/** A sequence of bytes held as a chain of segments of reference counted
+    blocks, rather than as one contiguous array.
+
+    Copying a chain, appending one chain to another, splitting a chain in
+    two or discarding bytes from the front never copies any data, only the
+    block references. A PBYTEArray or PString may also be appended without
+    copying, the block simply holds a reference to the array.
+
+    Data read from a channel goes directly into blocks taken from a free
+    pool, see PChannel::ReadChain(), so large bodies are built up without
+    the reallocation and copying of a growing array. A chain is written
+    with a single gathered write, see PChannel::WriteChain(), so a header
+    and a body need not be concatenated first.
+
+    The blocks are immutable once they are part of more than one chain, so
+    a chain may be handed to another thread while the original is still in
+    use. An individual chain instance is not thread safe.
+  */
+class PBufferChain : public PObject
+{
+  PCLASSINFO(PBufferChain, PObject);
+  public:
+    enum {
+      BlockSize = 16384,        ///< Size of blocks in the pool
+      MaxPooledBlocks = 1024    ///< Limit on free blocks kept for reuse
+    };
+
+  /**@name Construction */
+  //@{
+    /// Create an empty chain.
+    PBufferChain();
+
+    /// Create a chain with a copy of the data.
+    PBufferChain(
+      const void * data,
+      PINDEX length
+    );
+
+    /// Create a chain referencing the array, no data is copied.
+    explicit PBufferChain(
+      const PBYTEArray & data
+    );
+
+    /// Create a chain referencing the same blocks, no data is copied.
+    PBufferChain(
+      const PBufferChain & other
+    );
+
+    /// Make this chain reference the same blocks, no data is copied.
+    PBufferChain & operator=(
+      const PBufferChain & other
+    );
+
+    /// Release all blocks.
+    ~PBufferChain();
+  //@}
+
+  /**@name Overrides from class PObject */
+  //@{
+    /// Output the bytes in the chain.
+    virtual void PrintOn(
+      ostream & strm
+    ) const;
+  //@}
+
+  /**@name Access */
+  //@{
+    /// Get the total number of bytes in the chain.
+    PINDEX GetLength() const { return m_length; }
+
+    /// Indicate there are no bytes in the chain.
+    bool IsEmpty() const { return m_length == 0; }
+
+    /// Get the number of contiguous segments.
+    PINDEX GetSegmentCount() const { return m_segments.size(); }
+
+    /// Get a contiguous segment.
+    const BYTE * GetSegment(
+      PINDEX index,     ///< Segment index, less than GetSegmentCount()
+      PINDEX & length   ///< Length of the segment
+    ) const;
+
+    /// Get the byte at the offset, this searches the segments, so is not fast.
+    BYTE operator[](
+      PINDEX offset
+    ) const;
+
+    /** Copy bytes out of the chain.
+        @return number of bytes copied.
+      */
+    PINDEX CopyTo(
+      void * buffer,        ///< Buffer to receive the bytes
+      PINDEX length,        ///< Maximum bytes to copy
+      PINDEX offset = 0     ///< Offset into the chain of the first byte
+    ) const;
+
+    /** Get the whole chain as a contiguous array.
+        If the chain is a single PBYTEArray appended to it, then that array
+        is returned without copying, otherwise the data is copied.
+      */
+    PBYTEArray AsBYTEArray() const;
+
+    /** Get the whole chain as a string.
+        If the chain is a single PString appended to it, then that string is
+        returned without copying, otherwise the data is copied.
+      */
+    PString AsString() const;
+
+    /** Get scatter/gather slices for the chain, as used by
+        PChannel::Write(const Slice *, size_t).
+        @return number of slices added to \p slices.
+      */
+    PINDEX GetSlices(
+      std::vector<PChannel::Slice> & slices,  ///< Slices are appended to this
+      PINDEX offset = 0,                      ///< Offset into the chain of the first byte
+      PINDEX maxSlices = P_MAX_INDEX          ///< Maximum slices to add
+    ) const;
+  //@}
+
+  /**@name Modification */
+  //@{
+    /// Append a copy of the data, filling the space at the end of the last block first.
+    void Append(
+      const void * data,
+      PINDEX length
+    );
+
+    /// Append a reference to the array, no data is copied.
+    void Append(
+      const PBYTEArray & data
+    );
+
+    /// Append a reference to the string, not including the '\0', no data is copied.
+    void Append(
+      const PString & str
+    );
+
+    /// Append references to the blocks of another chain, no data is copied.
+    void Append(
+      const PBufferChain & chain
+    );
+
+    /** Get space to write into at the end of the chain.
+        The bytes are not part of the chain until Commit() is called, and
+        only the most recently obtained space may be committed.
+
+        @return pointer to at least one and at most \p length bytes, the
+                actual number is returned in \p length.
+      */
+    BYTE * GetWritable(
+      PINDEX & length   ///< In: most bytes wanted, Out: bytes available
+    );
+
+    /** Get scattered space to write into at the end of the chain, e.g. for
+        PChannel::Read(Slice *, size_t). The bytes are not part of the chain
+        until Commit() is called.
+
+        @return number of slices set in \p slices.
+      */
+    PINDEX GetWritableSlices(
+      PINDEX length,              ///< Bytes of space wanted
+      PChannel::Slice * slices,   ///< Slices to set
+      PINDEX maxSlices            ///< Size of \p slices array
+    );
+
+    /// Add to the chain bytes written into space from GetWritable() or GetWritableSlices().
+    void Commit(
+      PINDEX length
+    );
+
+    /** Remove bytes from the front of the chain, returning them as a
+        separate chain. No data is copied.
+      */
+    PBufferChain Split(
+      PINDEX length
+    );
+
+    /// Discard bytes from the front of the chain.
+    void Discard(
+      PINDEX length
+    );
+
+    /// Remove everything from the chain.
+    void Clear();
+  //@}
+
+  /**@name Statistics */
+  //@{
+    /// Counts over all chains, since start up.
+    struct Statistics {
+      Statistics() : m_copiedBytes(0), m_pooledBlocks(0), m_allocatedBlocks(0), m_referencedArrays(0) { }
+
+      PUInt64 m_copiedBytes;      ///< Bytes copied into or out of chains
+      PUInt64 m_pooledBlocks;     ///< Blocks taken from the free pool
+      PUInt64 m_allocatedBlocks;  ///< Blocks allocated as the pool was empty
+      PUInt64 m_referencedArrays; ///< PBYTEArray and PString appended without copying
+    };
+
+    /// Get the statistics.
+    static void GetStatistics(
+      Statistics & stats
+    );
+  //@}
+
+  protected:
+    struct Block;
+    struct Segment {
+      Segment(Block * block, PINDEX offset, PINDEX length)
+        : m_block(block), m_offset(offset), m_length(length) { }
+
+      Block * m_block;
+      PINDEX  m_offset;
+      PINDEX  m_length;
+    };
+
+    void AddSegment(Block * block, PINDEX offset, PINDEX length);
+    Block * GetWritableTail() const;
+    static Block * TakeBlock();
+    static void ReleaseBlock(Block * block);
+
+    std::deque<Segment>  m_segments;
+    std::vector<Block *> m_spare;     // Exclusively owned, for GetWritable()
+    PINDEX               m_length;
+
+  friend class PBufferChainPool;
+};
+
+
+#endif // PTLIB_BUFCHAIN_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -37,11 +37,16 @@
 #include <ptlib/mutex.h>
 #include <ptlib/notifier.h>
 
+#if !defined(_WIN32) && P_HAS_RECVMSG
+#include <sys/uio.h>
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // I/O Channels
 
 class PChannel;
+class PBufferChain;
 
 /* Buffer class used in PChannel stream.
 This class is necessary for implementing the standard C++ iostream interface
@@ -481,6 +486,109 @@ class PChannel : public PObject, public std::iostream
     );
   //@}
 
+  /**@name Scattered read/write functions */
+  //@{
+    /** Structure that defines a "slice" of memory to be read to or written from
+     */
+    struct Slice
+#if _WIN32
+      : public WSABUF 
+    {
+      void SetBase(void * p)    { buf = (char *)p; }
+      void * GetBase() const    { return buf; }
+      void SetLength(size_t l)  { len = (ULONG)l; }
+      size_t GetLength() const  { return len; }
+#else // _WIN32
+#if P_HAS_RECVMSG
+      : public iovec
+    {
+#else
+    {
+      protected:
+        void * iov_base;
+        size_t iov_len;
+      public:
+#endif // P_HAS_RECVMSG
+      void SetBase(void * v)    { iov_base = v; }
+      void * GetBase() const    { return iov_base; }
+      void SetLength(size_t l)  { iov_len = l; }
+      size_t GetLength() const  { return iov_len; }
+#endif // _WIN32
+
+      Slice()
+      { SetBase(NULL); SetLength(0); }
+
+      Slice(void * p, size_t l)
+      { SetBase(p); SetLength(l); }
+
+      Slice(const void * p, size_t l)
+      { SetBase(const_cast<void *>(p)); SetLength(l); }
+    };
+
+
+    /** Low level scattered read from the channel. This is identical to Read except 
+        that the data will be read into a series of scattered memory slices. By default,
+        this call will default to calling Read multiple times, but this may be 
+        implemented by operating systems to do a real scattered read, as PSocket does.
+
+       @return
+       true indicates that at least one character was read from the channel.
+       false means no bytes were read due to timeout or some other I/O error.
+     */
+    virtual bool Read(
+      Slice * slices,    // slices to read to
+      size_t sliceCount
+    );
+
+    /** Low level scattered write to the channel. This is identical to Write except 
+        that the data will be written from a series of scattered memory slices. By default,
+        this call will default to calling Write multiple times, but this can be actually
+        implemented by operating systems to do a real scattered write, as PSocket does.
+
+       @return
+       true indicates that at least one character was written to the channel.
+       false means no bytes were written due to timeout or some other I/O error.
+     */
+    virtual bool Write(
+      const Slice * slices,  // slices to write from
+      size_t sliceCount
+    );
+
+    /** Read whatever is available, up to \p len bytes, onto the end of the
+        chain. The data is read with a single scattered Read() directly into
+        blocks from the chain's pool, there is no intermediate copy.
+
+       @return
+       true indicates that at least one character was read from the channel.
+     */
+    bool ReadChain(
+      PBufferChain & chain,   ///< Chain to append to
+      PINDEX len              ///< Maximum number of bytes to read
+    );
+
+    /** Read exactly \p len bytes onto the end of the chain. This function
+        uses ReadChain(), which uses Read(), so the remarks on ReadBlock()
+        also apply.
+
+       @return
+       true if the read of <code>len</code> bytes was sucessfull.
+     */
+    bool ReadBlock(
+      PBufferChain & chain,   ///< Chain to append to
+      PINDEX len              ///< Number of bytes to read
+    );
+
+    /** Write all of the chain, using gathered Write() calls, so a channel
+        that supports it, e.g. a PSocket, does one system call for the lot.
+
+       @return
+       true if the whole chain was written.
+     */
+    bool WriteChain(
+      const PBufferChain & chain  ///< Chain to write
+    );
+  //@}
+
   /**@name Asynchronous I/O functions */
   //@{
     class AsyncContext;
@@ -578,6 +686,31 @@ class PChannel : public PObject, public std::iostream
     virtual void OnWriteComplete(
       AsyncContext & context ///< Context for asynchronous operation
     );
+
+    /// Mechanisms used for asynchronous I/O.
+    enum AsyncEngines {
+      AsyncEngineDefault, ///< Best available, io_uring if possible
+      AsyncEngineAIO,     ///< POSIX AIO, or overlapped I/O on Windows
+      AsyncEngineIOURing, ///< Linux io_uring, completions on a small pool of threads
+      NumAsyncEngines
+    };
+
+    /** Set the mechanism used by subsequent ReadAsync() and WriteAsync()
+       calls, operations already started complete with the mechanism they
+       were started with. The initial value may also be set by the
+       PTLIB_ASYNC_ENGINE environment variable, "aio" or "io_uring".
+
+       @return
+       false if the mechanism is not available on this system.
+     */
+    static bool SetAsyncEngine(
+      AsyncEngines engine
+    );
+
+    /** Get the mechanism that ReadAsync() and WriteAsync() use.
+       This is never AsyncEngineDefault, it is resolved to what is available.
+     */
+    static AsyncEngines GetAsyncEngine();
   //@}
 
   /**@name Miscellaneous functions */
@@ -51,6 +51,7 @@ class PContainerReference : PNonCopyable
       , count(1)
       , deleteObjects(true)
       , constObject(isConst)
+      , inlineStorage(false)
     {
     }
 
@@ -59,6 +60,7 @@ class PContainerReference : PNonCopyable
       , count(1)
       , deleteObjects(ref.deleteObjects)
       , constObject(false)
+      , inlineStorage(false)
     {  
     }
 
@@ -66,11 +68,41 @@ class PContainerReference : PNonCopyable
     atomic<uint32_t> count;         // reference count to the container content - guaranteed to be atomic
     bool           deleteObjects; // Used by PCollection but put here for efficiency
     bool           constObject;   // Indicates object is constant/static, copy on write.
+    bool           inlineStorage; // Is really a PInlineContainerReference
 
     PDECLARE_POOL_ALLOCATOR(PContainerReference);
 };
 
 
+/* Reference for arrays of bytes, e.g. PString, with storage for short ones so
+   they do not need a separate heap allocation. Shared by every container using
+   this reference, exactly as a heap block would be. Other containers use the
+   plain PContainerReference, and do not pay for the buffer. */
+class PInlineContainerReference : public PContainerReference
+{
+  public:
+    __inline PInlineContainerReference(PINDEX initialSize)
+      : PContainerReference(initialSize)
+    {
+      inlineStorage = true;
+    }
+
+    __inline PInlineContainerReference(const PContainerReference & ref)
+      : PContainerReference(ref)
+    {
+      inlineStorage = true;
+    }
+
+    enum { InlineSize = 32 };
+    union {
+      char     bytes[InlineSize];
+      uint64_t alignment;
+    } inlineData;
+
+    PDECLARE_POOL_ALLOCATOR(PInlineContainerReference);
+};
+
+
 /** Abstract class to embody the base functionality of a <code>container</code>.
 
 Fundamentally, a container is an object that contains other objects. There
@@ -0,0 +1,339 @@
+/*
+ * dirwatch.h
+ *
+ * File system change notification, and a file information cache.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_DIRWATCH_H
+#define PTLIB_DIRWATCH_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <ptlib/pdirect.h>
+#include <ptlib/notifier.h>
+#include <map>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PDirectoryWatcher
+
+/** Watch directories for changes to the files in them.
+
+    Where the operating system supports it (inotify on Linux) the changes
+    are reported by the kernel as they happen, otherwise the directories are
+    scanned periodically and compared with the previous scan.
+
+    A recursive watch also watches every sub-directory, including those
+    created after the watch was started. Files already in a new directory by
+    the time its watch is set up are reported as created.
+
+    Changes are coalesced, all the changes to a path within the coalescing
+    interval are reported in a single notification with all the change bits
+    set, so a file written in many small pieces produces one notification.
+    Notifications are made from the watcher's own thread.
+
+    If the kernel queue overflows, changes have been lost, and a single
+    notification with the <code>Overflow</code> bit is made for each watched
+    directory, the application should assume anything in it has changed.
+  */
+class PDirectoryWatcher : public PObject
+{
+    PCLASSINFO(PDirectoryWatcher, PObject);
+  public:
+    /// Kinds of change.
+    P_DECLARE_STREAMABLE_BITWISE_ENUM(Changes, 5, (
+      NoChanges,
+      Created,      ///< Path was created, or moved into the directory
+      Removed,      ///< Path was deleted, or moved out of the directory
+      Modified,     ///< File contents were written
+      Attributes,   ///< Permissions, times etc changed
+      Overflow      ///< Changes were lost, path is the watched directory
+    ));
+
+    /// Notification of changes to a path.
+    struct Event {
+      Event() : m_changes(NoChanges), m_subDirectory(false) { }
+
+      PFilePath m_path;         ///< Path that changed
+      Changes   m_changes;      ///< Everything that happened to the path
+      bool      m_subDirectory; ///< Path is a directory
+    };
+
+    typedef PNotifierTemplate<const Event &> Notifier;
+    #define PDECLARE_DirectoryWatcherNotifier(cls, fn) PDECLARE_NOTIFIER2(PDirectoryWatcher, cls, fn, const PDirectoryWatcher::Event &)
+
+  /**@name Construction */
+  //@{
+    /// Create a watcher, no thread is started until a directory is added.
+    PDirectoryWatcher(
+      const Notifier & notifier = Notifier(),                 ///< Called for each change
+      const PTimeInterval & coalesce = PTimeInterval(100),    ///< Time over which changes to a path are combined
+      const PTimeInterval & pollInterval = PTimeInterval(0, 1) ///< Scan interval if not native
+    );
+
+    /// Stop watching.
+    ~PDirectoryWatcher();
+  //@}
+
+  /**@name Operations */
+  //@{
+    /// Set the function called for each change.
+    void SetNotifier(
+      const Notifier & notifier
+    );
+
+    /** Start watching a directory. Adding a directory already watched
+        only changes whether it is recursive.
+        @return false if the directory does not exist, or the system limit
+                on watches was reached.
+      */
+    bool Add(
+      const PDirectory & dir,   ///< Directory to watch
+      bool recursive = false    ///< Watch all sub-directories as well
+    );
+
+    /// Stop watching a directory previously added.
+    bool Remove(
+      const PDirectory & dir    ///< Directory to stop watching
+    );
+
+    /// Stop watching everything, and stop the thread.
+    void Close();
+
+    /** Indicate the directory is being watched, either added directly or
+        as a sub-directory of a recursive watch. The directory must be as a
+        PDirectory, with the trailing separator.
+      */
+    bool IsWatched(
+      const PString & dir
+    ) const;
+
+    /// Indicate changes are reported by the operating system, rather than by scanning.
+    static bool IsNative();
+  //@}
+
+  /**@name Statistics */
+  //@{
+    struct Statistics {
+      Statistics() : m_watches(0), m_changes(0), m_notifications(0), m_overflows(0) { }
+
+      unsigned m_watches;       ///< Directories currently watched
+      PUInt64  m_changes;       ///< Changes reported by the system, or found by scanning
+      PUInt64  m_notifications; ///< Notifications made, after coalescing
+      PUInt64  m_overflows;     ///< Times changes were lost
+    };
+
+    /// Get the statistics for this watcher.
+    void GetStatistics(
+      Statistics & stats
+    ) const;
+  //@}
+
+  protected:
+    void ThreadMain();
+    bool InternalAdd(const PDirectory & dir, bool recursive, bool reportExisting);
+    void InternalRemove(const PString & dir);
+    void ReadChanges(const PTimeInterval & timeout);
+    void AddChange(const PString & path, Changes changes, bool subDirectory);
+    void AddOverflow();
+
+    struct Snapshot {
+      PFileInfo::FileTypes m_type;
+      PUInt64              m_size;
+      time_t               m_modified;
+      time_t               m_changed;
+      unsigned             m_permissions;
+    };
+    typedef std::map<PString, Snapshot> Snapshots;
+    void TakeSnapshot(const PDirectory & dir, bool recursive, Snapshots & snapshots);
+    void CompareSnapshots(const Snapshots & snapshots);
+
+    Notifier      m_notifier;
+    PTimeInterval m_coalesce;
+    PTimeInterval m_pollInterval;
+
+    PDECLARE_MUTEX(m_mutex);
+    PThread *     m_thread;
+    atomic<bool>  m_running;
+
+    struct Watch {
+      Watch(int handle = -1, bool recursive = false) : m_handle(handle), m_recursive(recursive) { }
+      int  m_handle;
+      bool m_recursive;
+    };
+    typedef std::map<PString, Watch> WatchMap;
+    WatchMap               m_roots;     // Directories added
+    WatchMap               m_watched;   // All directories watched, including sub-directories
+    std::map<int, PString> m_handles;   // System handle to directory
+    Snapshots              m_snapshots; // Last scan, if not native
+    PTime                  m_lastScan;
+
+    typedef std::map<PString, Event> PendingMap;
+    PendingMap    m_pending;
+    PTime         m_firstPending;
+
+    int           m_fd;
+    int           m_wakeUp[2];
+    PSyncPoint    m_wakeUpSync;
+
+    Statistics    m_statistics;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PFileInfoCache
+
+/** Cache of file information for the directories added to it.
+
+    When directories are added, PFile::GetInfo(), PFile::Exists() and
+    PDirectory::Exists() on paths in them, and so PDirectory scans, are
+    answered from memory after the first call, without any system calls.
+    The cache uses a PDirectoryWatcher to remove entries as soon as the
+    system reports a change, and changes made through PFile and PDirectory
+    in this process remove the entry directly, so are seen immediately.
+
+    Writes to a file still open are seen when the system reports them, which
+    is normally well under a millisecond later. Symbolic links are never
+    cached, as the target may be outside the watched directories.
+
+    This is only available where the watcher is native, see
+    PDirectoryWatcher::IsNative(), as a scanning watcher would leave stale
+    entries for too long.
+  */
+class PFileInfoCache : public PObject
+{
+    PCLASSINFO(PFileInfoCache, PObject);
+  public:
+    enum {
+      DefaultMaxEntries = 1000000  ///< All entries are dropped if this is reached
+    };
+
+    /// Get the single cache.
+    static PFileInfoCache & GetInstance();
+
+    ~PFileInfoCache();
+
+    /** Start caching information in the directory.
+        @return false if the directory could not be watched.
+      */
+    bool Add(
+      const PDirectory & dir,   ///< Directory to cache
+      bool recursive = true     ///< Cache all sub-directories as well
+    );
+
+    /// Stop caching information in the directory, and drop the entries.
+    bool Remove(
+      const PDirectory & dir
+    );
+
+    /// Drop all entries, the directories remain watched.
+    void Clear();
+
+    /// Stop caching everything.
+    void Close();
+
+    /// Set the maximum number of entries.
+    void SetMaxEntries(
+      PINDEX max
+    );
+
+    /// Indicate any directory is being cached, this is very cheap.
+    static bool IsActive();
+
+    enum LookupResult {
+      NotCached,
+      Found,
+      NotFound
+    };
+
+    /** Look for cached information on the path.
+        If NotCached is returned, \p generation is set for passing to Store().
+      */
+    static LookupResult Lookup(
+      const PString & path,
+      PFileInfo & info,
+      unsigned & generation
+    );
+
+    /** Store information, or the fact the path does not exist if \p info
+        is NULL. Nothing is stored if the path is not in a watched directory
+        or anything was invalidated since the Lookup() that set \p generation.
+      */
+    static void Store(
+      const PString & path,
+      const PFileInfo * info,
+      unsigned generation
+    );
+
+    /// Drop the entry for the path, its directory, and anything below it.
+    static void Invalidate(
+      const PString & path
+    );
+
+    struct Statistics {
+      Statistics() : m_hits(0), m_misses(0), m_invalidations(0), m_entries(0) { }
+
+      PUInt64 m_hits;           ///< Lookups answered from the cache
+      PUInt64 m_misses;         ///< Lookups needing a system call
+      PUInt64 m_invalidations;  ///< Entries dropped due to changes
+      PINDEX  m_entries;        ///< Current number of entries
+    };
+
+    /// Get the statistics.
+    void GetStatistics(
+      Statistics & stats
+    ) const;
+
+  protected:
+    PFileInfoCache();
+    PDECLARE_DirectoryWatcherNotifier(PFileInfoCache, OnChange);
+    void InternalInvalidate(const PString & path, bool subTree);
+    void InternalClear();
+
+    /* A hash table rather than a std::map, as a lookup in a large tree is a
+       cache miss at every level, and a listing looks up in random order. */
+    struct Entry {
+      Entry(const PString & path, PUInt64 hash, const PFileInfo * info);
+
+      Entry *   m_next;
+      PUInt64   m_hash;
+      PString   m_path;
+      bool      m_exists;
+      PFileInfo m_info;
+    };
+    Entry ** FindEntry(const PString & path, PUInt64 hash);
+    void EraseEntry(Entry ** link);
+
+    PDirectoryWatcher    m_watcher;
+    PCriticalSection     m_mutex;        // Never held while taking another lock, and on every lookup
+    std::vector<Entry *> m_buckets;      // Size is always a power of two
+    PINDEX               m_entryCount;
+    std::map<PString, PINDEX> m_directories; // Count of entries in each directory, for sub-tree invalidation
+    unsigned             m_generation;
+    PINDEX               m_maxEntries;
+};
+
+
+#endif // PTLIB_DIRWATCH_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -326,18 +326,46 @@ class PEthSocket : public PSocket
         );
 
         const PTime & GetTimestamp() const { return m_timestamp; }
+        void SetTimestamp(const PTime & timestamp) { m_timestamp = timestamp; }
         bool IsFragmentated() const { return m_fragmentated; }
 
         PINDEX GetSize() const { return m_rawSize; }
+        const BYTE * GetData() const { return m_rawData; }
+
+        /** Set the raw frame, e.g. from a capture file.
+            Any previously decoded layers are discarded.
+          */
+        bool SetData(
+          const void * data,
+          PINDEX size,
+          const PTime & timestamp
+        );
 
-        void SetDataLinkType(unsigned dataLinkType) { m_dataLinkType = dataLinkType;  }
+        void SetDataLinkType(unsigned dataLinkType) { m_dataLinkType = dataLinkType; ResetLayers(); }
         unsigned GetDataLinkType() const { return m_dataLinkType;  }
 
       protected:
+        int DecodeDataLink();
+        void ResetLayers();
+
         PBYTEArray  m_rawData;
         PINDEX      m_rawSize;
         unsigned    m_dataLinkType;
 
+        /* Layers already decoded, so repeated calls to GetUDP() etc do not
+           parse the headers again. The offsets are into m_rawData. */
+        enum { NotDecoded = -2 };
+        int                m_dataLinkProto;
+        PINDEX             m_dataLinkOffset;
+        PINDEX             m_dataLinkLength;
+        Address            m_srcMAC;
+        Address            m_dstMAC;
+        int                m_ipProto;
+        PINDEX             m_ipOffset;
+        PINDEX             m_ipLength;
+        PIPSocket::Address m_srcIP;
+        PIPSocket::Address m_dstIP;
+
         PBYTEArray  m_fragments;
         bool        m_fragmentated;
         unsigned    m_fragmentProto;
@@ -377,6 +405,129 @@ class PEthSocket : public PSocket
 };
 
 
+/**This class reads and writes capture files, as used by tcpdump and
+   Wireshark, in the pcap or pcapng format.
+
+   The file is read, or written, in large blocks, and frames are taken from,
+   or put into, that buffer. This is much faster than a system call per
+   frame, which matters when replaying multi-gigabyte captures of RTP for
+   load testing.
+ */
+class PEthCaptureFile : public PObject
+{
+    PCLASSINFO(PEthCaptureFile, PObject);
+  public:
+    /// File formats
+    enum Formats {
+      FormatPcap,       ///< Classic pcap, microsecond timestamps
+      FormatPcapNano,   ///< Classic pcap, nanosecond timestamps
+      FormatPcapNG      ///< pcapng, one interface when writing
+    };
+
+    /**Create a capture file.
+     */
+    PEthCaptureFile(
+      PINDEX bufferSize = 1024*1024   ///< Size of blocks read or written
+    );
+
+    /// Close the file, writing anything buffered
+    ~PEthCaptureFile();
+
+    /**Open the capture file. When reading, the format is determined from the
+       file itself, and the format, data link type and snap length
+       parameters are ignored.
+
+       @return
+       true if the file was opened and the file header was valid.
+     */
+    bool Open(
+      const PFilePath & filename,                 ///< Name of file
+      PFile::OpenMode mode = PFile::ReadOnly,     ///< ReadOnly or WriteOnly
+      Formats format = FormatPcap,                ///< Format when writing
+      unsigned dataLinkType = 1,                  ///< Data link when writing, 1 is ethernet
+      unsigned snapLength = 65535                 ///< Snap length when writing
+    );
+
+    /// Indicate file is open
+    bool IsOpen() const { return m_file.IsOpen(); }
+
+    /// Close the file, writing anything buffered
+    bool Close();
+
+    /**Read the next frame from the file. The frame data link type and
+       timestamp are set from the file.
+
+       @return
+       false at end of file or on error.
+     */
+    bool ReadFrame(
+      PEthSocket::Frame & frame
+    );
+
+    /**Read up to count frames from the file.
+
+       @return
+       number of frames read, zero at end of file or on error.
+     */
+    PINDEX ReadFrames(
+      PEthSocket::Frame * frames,
+      PINDEX count
+    );
+    PINDEX ReadFrames(
+      std::vector<PEthSocket::Frame> & frames
+    ) { return frames.empty() ? 0 : ReadFrames(&frames[0], frames.size()); }
+
+    /**Write a frame to the file. The frame is buffered, use Flush() or
+       Close() to make sure it is written.
+     */
+    bool WriteFrame(
+      const PEthSocket::Frame & frame
+    );
+
+    /// Write anything buffered to the file.
+    bool Flush();
+
+    /// Get the format of the file.
+    Formats GetFormat() const { return m_format; }
+
+    /// Get the data link type of the first interface in the file.
+    unsigned GetDataLinkType() const { return m_interfaces.empty() ? 0 : m_interfaces[0].m_dataLinkType; }
+
+    /// Get the count of frames read or written.
+    PUInt64 GetFrameCount() const { return m_frameCount; }
+
+    /// Get the underlying file.
+    const PFile & GetFile() const { return m_file; }
+
+  protected:
+    bool ReadHeader();
+    bool WriteHeader(unsigned dataLinkType, unsigned snapLength);
+    bool Fill(PINDEX needed);
+    bool Append(const void * data, PINDEX size);
+    bool ReadBlock(PEthSocket::Frame & frame, bool & gotFrame);
+
+    DWORD GetDWORD(PINDEX offset) const;
+    WORD GetWORD(PINDEX offset) const;
+
+    struct Interface {
+      Interface(unsigned dataLinkType = 1, PUInt64 unitsPerSecond = 1000000)
+        : m_dataLinkType(dataLinkType), m_unitsPerSecond(unitsPerSecond) { }
+      unsigned m_dataLinkType;
+      PUInt64  m_unitsPerSecond;
+    };
+
+    PFile                  m_file;
+    Formats                m_format;
+    bool                   m_writing;
+    bool                   m_swapped;
+    std::vector<Interface> m_interfaces;
+    PBYTEArray             m_buffer;
+    PINDEX                 m_position;  // Next byte to read
+    PINDEX                 m_available; // End of data read, or written
+    PUInt64                m_frameCount;
+};
+
+
 class PEthSocketThread : public PObject
 {
     PCLASSINFO(PEthSocketThread, PObject);
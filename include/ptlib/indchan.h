@@ -360,6 +360,25 @@ class PIndirectChannel : public PChannel
      */
     virtual PBoolean OnOpen();
 
+    /**Scattered read directly from the <code>readChannel</code>.
+       The default Read(Slice *, size_t) for an indirect channel uses Read()
+       for each slice, as a descendant may be altering the data, e.g. SSL.
+       A descendant that does not may use this to pass the scattered read
+       through, so it ends up as a single system call.
+     */
+    bool ReadSlicesDirect(
+      Slice * slices,
+      size_t sliceCount
+    );
+
+    /**Gathered write directly to the <code>writeChannel</code>.
+       See ReadSlicesDirect().
+     */
+    bool WriteSlicesDirect(
+      const Slice * slices,
+      size_t sliceCount
+    );
+
 
   // Member variables
     /// Channel for read operations.
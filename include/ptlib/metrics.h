@@ -0,0 +1,272 @@
+/*
+ * metrics.h
+ *
+ * Run time metrics, counters, gauges and histograms.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef PTLIB_METRICS_H
+#define PTLIB_METRICS_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+
+class PTimeInterval;
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PMetric
+
+/** Base class for a run time metric.
+   All metrics register themselves, by name, on construction and remove
+   themselves on destruction, so it is usual for them to be static or long
+   lived objects. The whole set may be output at any time, for example via
+   the PHTTPMetrics resource, in the Prometheus text exposition format.
+
+   Several metrics may share a name, differing in the labels, e.g. the bytes
+   read and written on sockets are "ptlib_socket_bytes_total" with labels
+   of direction="read" and direction="write". All with the same name must
+   be of the same type and have the same help text.
+
+   Updating a metric never takes a lock. Counters and histograms are split
+   into cache line sized shards, with each thread updating the shard chosen
+   for it when it first touched a metric, so threads on different CPUs do
+   not contend for the same cache line. Reading sums the shards.
+  */
+class PMetric : public PObject
+{
+  PCLASSINFO(PMetric, PObject);
+  protected:
+    PMetric(
+      const char * name,    ///< Name, e.g. "ptlib_socket_bytes_total"
+      const char * help,    ///< Single line description
+      const char * labels   ///< Labels, e.g. "direction=\"read\"", may be NULL
+    );
+
+  public:
+    ~PMetric();
+
+    enum Types {
+      Counter,
+      Gauge,
+      Histogram
+    };
+
+    /// Get the type of the metric
+    virtual Types GetType() const = 0;
+
+    /// Get the name of the metric
+    const PString & GetName() const { return m_name; }
+
+    /// Get the help text of the metric
+    const PString & GetHelp() const { return m_help; }
+
+    /// Get the labels of the metric
+    const PString & GetLabels() const { return m_labels; }
+
+    /** Output the sample lines for this metric in Prometheus text format.
+        The "# HELP" and "# TYPE" lines are not included.
+      */
+    virtual void OutputPrometheus(
+      ostream & strm
+    ) const = 0;
+
+    /// Output every registered metric in Prometheus text format.
+    static void OutputAllPrometheus(
+      ostream & strm
+    );
+
+    /// Get the name of the type as used in Prometheus, e.g. "counter"
+    static const char * GetTypeName(Types type);
+
+  protected:
+    void OutputSampleName(ostream & strm, const char * suffix = NULL, const char * extraLabel = NULL) const;
+
+    /// Get the shard index for the calling thread, less than MaxShards.
+    static unsigned GetShardIndex();
+    enum { MaxShards = 16, CacheLineSize = 64 };
+
+    PString m_name;
+    PString m_help;
+    PString m_labels;
+
+  private:
+    PMetric(const PMetric &);
+    void operator=(const PMetric &);
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PMetricCounter
+
+/** A monotonically increasing count, e.g. the total bytes sent.
+  */
+class PMetricCounter : public PMetric
+{
+  PCLASSINFO(PMetricCounter, PMetric);
+  public:
+    PMetricCounter(
+      const char * name,
+      const char * help,
+      const char * labels = NULL
+    );
+
+    /// Add to the count
+    void Inc(
+      PUInt64 amount = 1
+    );
+    void operator++() { Inc(); }
+    void operator+=(PUInt64 amount) { Inc(amount); }
+
+    /// Get the total count over all shards
+    PUInt64 GetValue() const;
+
+    virtual Types GetType() const;
+    virtual void OutputPrometheus(ostream & strm) const;
+
+  protected:
+    struct Shard {
+      P_ALIGN_FIELD(atomic<PUInt64>, m_value, CacheLineSize);
+    };
+    Shard m_shards[MaxShards];
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PMetricGauge
+
+/** A value that can go up and down, e.g. the number of items in a queue.
+    As this may be set as well as incremented, it is not sharded.
+  */
+class PMetricGauge : public PMetric
+{
+  PCLASSINFO(PMetricGauge, PMetric);
+  public:
+    PMetricGauge(
+      const char * name,
+      const char * help,
+      const char * labels = NULL
+    );
+
+    /// Set the value
+    void Set(PInt64 value) { m_value.store(value); }
+
+    /// Add to the value
+    void Inc(PInt64 amount = 1) { m_value += amount; }
+
+    /// Subtract from the value
+    void Dec(PInt64 amount = 1) { m_value -= amount; }
+
+    /// Get the current value
+    PInt64 GetValue() const { return m_value.load(); }
+
+    virtual Types GetType() const;
+    virtual void OutputPrometheus(ostream & strm) const;
+
+  protected:
+    P_ALIGN_FIELD(atomic<PInt64>, m_value, CacheLineSize);
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// PMetricHistogram
+
+/** A distribution of values, e.g. latencies.
+    Values are recorded as unsigned integers into log-linear buckets, as in
+    an HDR histogram, each power of two is divided into eight sub-buckets, so
+    any value is held to within 12.5%, from 0 to 2^40. Larger values are
+    counted in the last bucket, the sum remains exact.
+
+    The Prometheus output uses a bucket boundary at each power of two from
+    2^firstExponent to 2^lastExponent, multiplied by the output scale, plus
+    the "+Inf" bucket. The defaults suit durations recorded in nanoseconds,
+    which are output in seconds, from about 1us to 17s.
+  */
+class PMetricHistogram : public PMetric
+{
+  PCLASSINFO(PMetricHistogram, PMetric);
+  public:
+    PMetricHistogram(
+      const char * name,
+      const char * help,
+      const char * labels = NULL,
+      double outputScale = 1e-9,
+      unsigned firstExponent = 10,
+      unsigned lastExponent = 34
+    );
+
+    /// Record a value
+    void Record(
+      PUInt64 value
+    );
+
+    /// Record a duration, in nanoseconds, negative durations are recorded as zero
+    void Record(
+      const PTimeInterval & duration
+    );
+
+    /// Get the number of values recorded
+    PUInt64 GetCount() const;
+
+    /// Get the sum of values recorded
+    PUInt64 GetSum() const;
+
+    /** Get the value at the percentile, e.g. 0.99 for the 99th percentile.
+        This is the highest value that would be in the bucket, not scaled.
+      */
+    PUInt64 GetPercentile(
+      double fraction
+    ) const;
+
+    virtual Types GetType() const;
+    virtual void OutputPrometheus(ostream & strm) const;
+
+    enum {
+      SubBucketBits = 3,
+      SubBuckets = 1 << SubBucketBits,
+      MaxExponent = 40,
+      NumBuckets = (MaxExponent - SubBucketBits + 1)*SubBuckets,
+      NumShards = 4
+    };
+
+    /// Get the bucket index for a value
+    static unsigned GetBucketIndex(PUInt64 value);
+
+    /// Get the lowest value that is counted in the bucket
+    static PUInt64 GetBucketLowest(unsigned index);
+
+  protected:
+    void GetBuckets(PUInt64 * buckets) const;
+
+    struct Shard {
+      P_ALIGN_FIELD(atomic<PUInt64>, m_sum, CacheLineSize);
+      atomic<PUInt64> m_buckets[NumBuckets];
+    };
+    Shard    m_shards[NumShards];
+    double   m_outputScale;
+    unsigned m_firstExponent;
+    unsigned m_lastExponent;
+};
+
+
+#endif // PTLIB_METRICS_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -90,7 +90,8 @@ typedef unsigned long PNotifierIdentifer;
 
     A notification target class must derive from PValidatedNotifierTarget, usually
     as a multiple inheritance, which will associate a unique ID with the
-    specific class instance. This is saved in a global table. When the object
+    specific class instance. This is saved in a global table, sharded by ID
+    so unrelated targets do not contend on a single lock. When the object
     is destoyed the ID is removed from that table so the caller knows if the
     target still exists or not.
 
@@ -167,12 +168,17 @@ class PValidatedNotifierFunction : public PNotifierFunctionTemplate<ParamType>
 
 struct PAsyncNotifierCallback
 {
+  PAsyncNotifierCallback() : m_nextCallback(NULL) { }
   virtual ~PAsyncNotifierCallback() { }
   virtual void Call() = 0;
 
   static void Queue(PNotifierIdentifer id, PAsyncNotifierCallback * callback);
+
+  PAsyncNotifierCallback * m_nextCallback; // Used by target queue
 };
 
+class PAsyncNotifierQueue;
+
 
 /** Asynchronous PNotifier class.
     This is a notification mechanism disconnects the caller from the target
@@ -181,7 +187,9 @@ struct PAsyncNotifierCallback
 
     A notification target class must derive from PAsyncNotifierTarget, usually
     as a multiple inheritance, which will associate a a queue with the
-    specific class instance. 
+    specific class instance. Each target has its own lock free queue, so
+    queuing a notification never waits on other targets, or on the target
+    thread waiting in AsyncNotifierExecute().
 
     As well as deriving from PAsyncNotifierTarget class, the notifier functions
     must be declared using the PDECLARE_ASYNC_NOTIFIER rather than the
@@ -203,6 +211,19 @@ class PAsyncNotifierTarget
       const PTimeInterval & wait = 0  ///< Time to wait for a notification
     );
 
+    /**Execute a batch of queued notifications.
+       This executes up to \p maxCount of the notifications queued, waiting
+       for up to \p wait for the first one to arrive. This is more efficient
+       than calling AsyncNotifierExecute() repeatedly when the target is
+       receiving notifications at a high rate.
+
+       @return number of notifications executed.
+      */
+    unsigned AsyncNotifierExecuteBatch(
+      unsigned maxCount,              ///< Maximum notifications to execute
+      const PTimeInterval & wait = 0  ///< Time to wait for a notification
+    );
+
     /**Signal the target that there are notifications pending.
        The infrastructure will call this virtual from a random thread to
        indicate that a notification has been queued. What happens is
@@ -214,7 +235,8 @@ class PAsyncNotifierTarget
     virtual void AsyncNotifierSignal();
 
   private:
-    PNotifierIdentifer m_asyncNotifierId;
+    PNotifierIdentifer    m_asyncNotifierId;
+    PAsyncNotifierQueue * m_asyncNotifierQueue;
 
   template <typename ParmType> friend class PAsyncNotifierFunction;
 };
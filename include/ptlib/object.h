@@ -1416,6 +1416,55 @@ namespace PProfiling
     void Dump(ostream & strm)
   );
 
+  /**What to do when the events for a thread fill its buffer.
+     The default may be set with the PTLIB_PROFILING_OVERFLOW environment
+     variable, to "overwrite" or "discard".
+    */
+  enum OverflowPolicy {
+    OverwriteOldest,  ///< Buffer is a ring, keeping the most recent events
+    DiscardNewest     ///< Stop recording for that thread, keeping the earliest events
+  };
+  PPROFILE_EXCLUDE(
+    void SetOverflowPolicy(OverflowPolicy policy)
+  );
+  PPROFILE_EXCLUDE(
+    OverflowPolicy GetOverflowPolicy()
+  );
+
+  /**Set the number of events held for each thread. This is rounded up to a
+     power of two, and only applies to threads that start recording after
+     it is set. The default may be set with the PTLIB_PROFILING_BUFFER_SIZE
+     environment variable.
+    */
+  PPROFILE_EXCLUDE(
+    void SetBufferSize(unsigned events)
+  );
+  PPROFILE_EXCLUDE(
+    unsigned GetBufferSize()
+  );
+
+  /// Get the number of events held, and the number lost to overflow, since Reset().
+  PPROFILE_EXCLUDE(
+    void GetEventCounts(uint64_t & held, uint64_t & overflowed)
+  );
+
+  enum TraceFormat {
+    ChromeTraceJSON,  ///< Chrome Trace Event JSON, for chrome://tracing or ui.perfetto.dev
+    PerfettoProtobuf  ///< Perfetto protobuf trace, for ui.perfetto.dev
+  };
+
+  /**Write all events held as a trace, with a track for each thread, named
+     from the PThread. This should be done after Enable(false), or the
+     most recent events may be missed.
+
+     The PTLIB_PROFILING_TRACE_FILENAME environment variable will have this
+     written at exit, as protobuf if the extension is ".pftrace" or
+     ".perfetto-trace", otherwise as JSON.
+    */
+  PPROFILE_EXCLUDE(
+    void ExportTrace(ostream & strm, TraceFormat format)
+  );
+
   PPROFILE_EXCLUDE(
     void OnThreadEnded(const PThread & thread, const PTimeInterval & realTime, const PTimeInterval & systemCPU, const PTimeInterval & userCPU)
   );
@@ -1444,7 +1493,7 @@ namespace PProfiling
       PDebugLocation m_location;
   };
 
-  #define PPROFILE_BLOCK(name) ::PProfiling::Block p_profile_block_instance(PDebugLocation(__FILE,__LINE__, name))
+  #define PPROFILE_BLOCK(name) ::PProfiling::Block p_profile_block_instance(PDebugLocation(__FILE__, __LINE__, name))
   #define PPROFILE_FUNCTION() PPROFILE_BLOCK(__PRETTY_FUNCTION__)
 
   #define PPROFILE_PRE_SYSTEM()  ::PProfiling::PreSystem()
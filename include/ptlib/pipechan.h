@@ -374,6 +374,50 @@ class PPipeChannel : public PChannel
       PBoolean wait = false   ///< Flag to indicate if function should block
     );
 
+    /// List of pipe channels used for Select() function.
+    class SelectList : public PList<PPipeChannel>
+    {
+      PCLASSINFO(SelectList, PList<PPipeChannel>)
+      public:
+        SelectList()
+          { DisallowDeleteObjects(); }
+        /** Add a channel to list .*/
+        void operator+=(PPipeChannel & chan /** Channel to add. */)
+          { Append(&chan); }
+        /** Remove a channel from list .*/
+        void operator-=(PPipeChannel & chan /** Channel to remove. */)
+          { Remove(&chan); }
+    };
+
+    /**Wait for output from any of a number of sub-processes.
+       This allows the output of many sub-processes to be handled by one
+       thread, rather than a thread blocked in <code>Read()</code> for each.
+
+       The \p output list is of channels whose standard output is to be
+       checked, and the \p errors list of channels, opened with
+       \p stderrSeparate, whose standard error is to be checked. The lists are
+       modified by the call so that only the channels with data available, or
+       which have reached end of file, remain. If the call timed out then both
+       lists are empty.
+
+       A subsequent <code>Read()</code>, or <code>ReadStandardError()</code>
+       with \p wait true, will then not block. A <code>Read()</code> returning
+       false with no error indicates the sub-process has closed its output.
+
+       @return
+       NoError if the call was successful, or timed out. NotOpen if any channel
+       in the lists does not have the pipe to be checked.
+     */
+    static Errors Select(
+      SelectList & output,  ///< Channels to check for standard output data
+      SelectList & errors,  ///< Channels to check for standard error data
+      const PTimeInterval & timeout = PMaxTimeInterval ///< Time to wait for data
+    );
+    static Errors Select(
+      SelectList & output,  ///< Channels to check for standard output data
+      const PTimeInterval & timeout = PMaxTimeInterval ///< Time to wait for data
+    );
+
     /**Run the command synchonously and return the output.
        Note it is expected that no output to the command is required, so stdin
        will be EOF immediately. It is also expected that the command will run
@@ -18,6 +18,7 @@
 
 #define P_PTLIB_PLUGIN_DIR_ENV_VAR  "PTLIBPLUGINDIR"
 #define P_PWLIB_PLUGIN_DIR_ENV_VAR  "PWLIBPLUGINDIR"
+#define P_PTLIB_PLUGIN_CACHE_ENV_VAR "PTLIBPLUGINCACHE"
 
 
 //////////////////////////////////////////////////////
@@ -51,6 +52,28 @@ class PPluginManager : public PObject
     /// Load the plugins in the directory.
     void LoadDirectory(const PDirectory & dir);
 
+    /**Set the plugin manifest cache file.
+       The manifest records the services provided by each plugin, keyed by
+       the plugins path, modification time and size. When a plugin in the
+       directories is found in the manifest, its services are registered
+       without loading the plugin, which is only loaded when one of those
+       services is actually used via this plugin manager.
+
+       Plugins that do not register any services, e.g. those used only by
+       a PPluginModuleManager, are always loaded.
+
+       The manifest is only used if this is called, or the environment
+       variable PTLIBPLUGINCACHE names the file. An empty file name disables
+       the manifest. Several applications may share a manifest, each only
+       removes the entries for plugins gone from its own directories.
+
+       This must be called before LoadDirectories().
+      */
+    void SetManifestFile(const PFilePath & file) { m_manifestFile = file; m_manifestFileSet = true; }
+
+    /// Get the plugin manifest cache file.
+    const PFilePath & GetManifestFile() const { return m_manifestFile; }
+
     // functions to load/unload a dynamic plugin 
     PBoolean LoadPlugin(const PString & fileName);
 
@@ -153,6 +176,45 @@ class PPluginManager : public PObject
 
     void CallNotifier(PDynaLink & dll, NotificationCode code);
 
+    bool LoadManifest();
+    bool SaveManifest();
+    bool LoadFromManifest(const PFilePath & fileName);
+    void AddToManifest(const PFilePath & fileName, const PPluginFactory::KeyList_T & previousKeys);
+    bool LoadDeferredPlugin(const PFilePath & fileName);
+    bool IsInDirectories(const PFilePath & fileName) const;
+
+    typedef std::vector<const PPluginServiceDescriptor *> Descriptors;
+    Descriptors GetServiceDescriptors(const PString & serviceType) const;
+
+    struct ManifestService {
+      ManifestService() : m_device(false) { }
+      std::string m_key;
+      PString     m_type;
+      PString     m_name;
+      PString     m_friendlyName;
+      bool        m_device;
+    };
+    typedef std::vector<ManifestService> ManifestServices;
+
+    struct ManifestEntry {
+      ManifestEntry() : m_modified(0), m_size(0), m_seen(false) { }
+      time_t           m_modified;
+      PUInt64          m_size;
+      bool             m_seen;
+      ManifestServices m_services;
+    };
+    typedef std::map<PFilePath, ManifestEntry> Manifest;
+
+    PFilePath  m_manifestFile;
+    bool       m_manifestFileSet;
+    Manifest   m_manifest;
+    bool       m_manifestDirty;
+    PStringSet m_deferredPlugins;
+    std::list<PPluginServiceDescriptor *> m_deferredServices;
+
+  friend class PPluginDeferredLoader;
+  friend class PluginLoaderStartup;
+
     PList<PDirectory> m_directories;
     PStringList       m_suffixes;
 
@@ -162,6 +224,7 @@ class PPluginManager : public PObject
     typedef std::multimap<PCaselessString, const PPluginServiceDescriptor *> ServiceMap;
     ServiceMap     m_services;
     PDECLARE_MUTEX(m_servicesMutex);
+    PDECLARE_MUTEX(m_loadingMutex);
 
     PDECLARE_MUTEX(  m_notifiersMutex);
     PList<PNotifier> m_notifiers;
@@ -73,6 +73,147 @@ typedef PBaseArray<wchar_t> PWCharArray;
 #endif
 
 
+/**A non-owning, read only, view of a sequence of characters.
+   This refers to characters held elsewhere, typically in a PString, without
+   taking a reference or allocating any memory. It is intended for parsing,
+   where a string is carved up into many small pieces which are examined and
+   then discarded, so that only the final results need be copied into a
+   PString.
+
+   Note the view is not necessarily NUL terminated, and it is up to the
+   caller to make sure the characters viewed outlive the PStringView.
+ */
+class PStringView
+{
+  public:
+    /// Construct an empty view.
+    PStringView()
+      : m_ptr("")
+      , m_length(0)
+    { }
+
+    /// Construct a view of a NUL terminated C string.
+    PStringView(
+      const char * cstr   ///< C string to view
+    ) : m_ptr(cstr != NULL ? cstr : "")
+      , m_length(cstr != NULL ? (PINDEX)strlen(cstr) : 0)
+    { }
+
+    /// Construct a view of a character buffer.
+    PStringView(
+      const char * ptr,   ///< Pointer to characters
+      PINDEX len          ///< Number of characters
+    ) : m_ptr(ptr != NULL ? ptr : "")
+      , m_length(ptr != NULL ? len : 0)
+    { }
+
+    /**Construct a view of the characters in a PString.
+       This is explicit as a view of a temporary, e.g. the PString returned
+       by a function, is left dangling as soon as the temporary is destroyed.
+       Passing a temporary as an argument is fine, as it outlives the call.
+     */
+    explicit PStringView(
+      const PString & str   ///< String to view
+    );
+
+    /// Construct a view of the characters in a std::string.
+    explicit PStringView(
+      const std::string & str   ///< String to view
+    ) : m_ptr(str.c_str())
+      , m_length((PINDEX)str.length())
+    { }
+
+    /// Get pointer to first character, note, may not be NUL terminated.
+    const char * GetPointer() const { return m_ptr; }
+
+    /// Get the number of characters in view.
+    PINDEX GetLength() const { return m_length; }
+
+    /// Determine if the view has no characters.
+    bool IsEmpty() const { return m_length == 0; }
+
+    /// Get character at index, returning '\\0' if beyond the end.
+    char operator[](PINDEX index) const { return index < m_length ? m_ptr[index] : '\0'; }
+
+    /// Create a PString copy of the characters in view.
+    PString AsString() const;
+
+    /**@name Sub-views, with the same semantics as their PString equivalents */
+    //@{
+    PStringView operator()(PINDEX start, PINDEX end) const;
+    PStringView Left(PINDEX len) const;
+    PStringView Right(PINDEX len) const;
+    PStringView Mid(PINDEX start, PINDEX len = P_MAX_INDEX) const;
+    PStringView LeftTrim() const;
+    PStringView RightTrim() const;
+    PStringView Trim() const;
+    //@}
+
+    /**@name Searching, with the same semantics as their PString equivalents */
+    //@{
+    PINDEX Find(char ch, PINDEX offset = 0) const;
+    PINDEX Find(const PStringView & str, PINDEX offset = 0) const;
+    PINDEX FindLast(char ch, PINDEX offset = P_MAX_INDEX) const;
+    PINDEX FindOneOf(const PStringView & set, PINDEX offset = 0) const;
+    PINDEX FindSpan(const PStringView & set, PINDEX offset = 0) const;
+
+    typedef std::vector<PStringView> Tokens;
+
+    /**Split the view into sub-views, see PString::Tokenise() for the rules
+       regarding <code>onePerSeparator</code>.
+     */
+    Tokens Tokenise(
+      const PStringView & separators,
+      bool onePerSeparator = true
+    ) const;
+    //@}
+
+    /**@name Comparison */
+    //@{
+    PObject::Comparison Compare(const PStringView & other) const;
+    bool operator==(const PStringView & other) const { return m_length == other.m_length && Compare(other) == PObject::EqualTo; }
+    bool operator!=(const PStringView & other) const { return !operator==(other); }
+    bool operator< (const PStringView & other) const { return Compare(other) == PObject::LessThan; }
+    bool operator> (const PStringView & other) const { return Compare(other) == PObject::GreaterThan; }
+
+    /// Compare ignoring case.
+    bool operator*=(const PStringView & other) const;
+
+    /// Compare the start of the view against the string.
+    bool StartsWith(const PStringView & str) const { return m_length >= str.m_length && Left(str.m_length) == str; }
+
+    /// Calculate the hash as PString::HashFunction() does for the same characters.
+    PINDEX HashFunction() const;
+    //@}
+
+    /**@name Conversion */
+    //@{
+    long AsInteger(unsigned base = 10) const;
+    DWORD AsUnsigned(unsigned base = 10) const;
+    //@}
+
+    friend ostream & operator<<(ostream & strm, const PStringView & view) { return strm.write(view.m_ptr, view.m_length); }
+
+    /**Make a temporary NUL terminated copy of the view, for passing to C
+       functions. Short strings are kept on the stack.
+     */
+    class CStr : PNonCopyable
+    {
+      public:
+        explicit CStr(const PStringView & view);
+        ~CStr();
+        operator const char *() const { return m_ptr; }
+      private:
+        char   m_buffer[64];
+        char * m_ptr;
+    };
+
+  protected:
+    const char * m_ptr;
+    PINDEX       m_length;
+};
+
+
 /**The character string class. It supports a wealth of additional functions
    for string processing and conversion. Operators are provided so that
    strings can virtually be treated as a basic type.
@@ -896,6 +1037,26 @@ class PString : public PCharArray
       const PString & str  ///< PString object to compare against.
     ) const;
 
+    /**Compare the string against the viewed characters, using the same
+       semantics as for PString, e.g. caseless for a PCaselessString.
+
+       @return
+       true if equal.
+     */
+    bool operator==(
+      const PStringView & str  ///< View of string to compare against.
+    ) const;
+
+    /**Compare the string against the viewed characters, using the same
+       semantics as for PString, e.g. caseless for a PCaselessString.
+
+       @return
+       true if not equal.
+     */
+    bool operator!=(
+      const PStringView & str  ///< View of string to compare against.
+    ) const { return !operator==(str); }
+
     /**Compare two strings using the <code>PObject::Compare()</code> function. This
        is identical to the <code>PObject</code> class function but is necessary due
        to other overloaded versions.
@@ -1177,6 +1338,14 @@ class PString : public PCharArray
       PINDEX count = P_MAX_INDEX, ///< Number of chacracters in str to compare
       PINDEX offset = 0           ///< Offset into string to compare
     ) const;
+
+    /**Compare a viewed string against a substring of the object, see above.
+     */
+    Comparison NumCompare(
+      const PStringView & str,    ///< View of string to compare against.
+      PINDEX count = P_MAX_INDEX, ///< Number of chacracters in str to compare
+      PINDEX offset = 0           ///< Offset into string to compare
+    ) const;
   //@}
 
 
@@ -1213,6 +1382,12 @@ class PString : public PCharArray
       PINDEX offset = 0     ///< Offset into string to begin search.
     ) const;
 
+    /** Locate the position within the string of the viewed substring. */
+    PINDEX Find(
+      const PStringView & str,  ///< View of string to search for in string.
+      PINDEX offset = 0         ///< Offset into string to begin search.
+    ) const;
+
     /** Locate the position of the last matching character. */
     PINDEX FindLast(
       char ch,                     ///< Character to search for in string.
@@ -1475,6 +1650,15 @@ class PString : public PCharArray
       PINDEX len = P_MAX_INDEX  ///< Number of characters to extract.
     ) const;
 
+    /**Get a view of a portion of the string. This is as for Mid(), however
+       no memory is allocated, the view refers directly to the characters of
+       this string. The view is only valid while this string is unchanged.
+     */
+    PStringView View(
+      PINDEX start = 0,         ///< Starting position of the substring.
+      PINDEX len = P_MAX_INDEX  ///< Number of characters to extract.
+    ) const;
+
     /** Return a string up to a maximum length, substituting "..." to too long.
       */
     PString Ellipsis(
@@ -1612,6 +1796,17 @@ class PString : public PCharArray
         ///< Flag for if there are empty tokens between consecutive separators.
     ) const;
 
+    /**Split the string into views of substrings, as for Tokenise(), without
+       allocating memory for each token. The views are only valid while this
+       string is unchanged.
+     */
+    PStringView::Tokens TokeniseView(
+      const PStringView & separators,
+        ///< A string for the set of separator characters that delimit tokens.
+      bool onePerSeparator = true
+        ///< Flag for if there are empty tokens between consecutive separators.
+    ) const;
+
     /**Split the string into individual lines. The line delimiters may be a
        carriage return ('\\r'), a line feed ('\\n') or a carriage return and
        line feed pair ("\\r\\n"). A line feed and carriage return pair ("\\n\\r")
@@ -1955,6 +2150,12 @@ class PString : public PCharArray
       PINDEX length,      // Number of characters to compare.
       const char * cstr   // C string to compare against.
     ) const;
+    PINDEX InternalFind(
+      const char * cstr,  // Characters to search for
+      PINDEX clen,        // Number of characters to search for
+      PINDEX offset       // Offset into string to begin search.
+    ) const;
+    virtual bool InternalIsCaseless() const;
     virtual int internal_strcmp(const char * s1, const char *s2) const;
     virtual int internal_strncmp(const char * s1, const char *s2, size_t n) const;
 
@@ -1984,6 +2185,13 @@ class PString : public PCharArray
 };
 
 
+inline PStringView::PStringView(const PString & str)
+  : m_ptr(str.GetPointer())
+  , m_length(str.GetLength())
+{
+}
+
+
 inline ostream & operator<<(ostream & stream, const PString & string)
 {
   string.PrintOn(stream);
@@ -2129,6 +2337,7 @@ class PCaselessString : public PString
 
   protected:
   // Overrides from class PString
+    virtual bool InternalIsCaseless() const;
     virtual int internal_strcmp(const char * s1, const char *s2) const;
     virtual int internal_strncmp(const char * s1, const char *s2, size_t n) const;
 
@@ -3290,6 +3499,7 @@ class PStringOptions : public PStringToString
     bool Contains(const PString         &   key   ) const { return PStringToString::Contains(PCaselessString(key)); }
     bool Contains(const PCaselessString &   key   ) const { return PStringToString::Contains(key); }
     bool Contains(const PCaselessString & (*key)()) const { return PStringToString::Contains(key()); }
+    bool Contains(const PStringView     &   key   ) const { return GetAt(key) != NULL; }
 
     // Overide default PStringToString::SetAt() to make sure the key is caseless
     PString * GetAt(const char *              key   ) const { PConstCaselessString k(key); return PStringToString::GetAt(k); }
@@ -3297,6 +3507,7 @@ class PStringOptions : public PStringToString
     PString * GetAt(const PString         &   key   ) const { return PStringToString::GetAt(PCaselessString(key)); }
     PString * GetAt(const PCaselessString &   key   ) const { return PStringToString::GetAt(key); }
     PString * GetAt(const PCaselessString & (*key)()) const { return PStringToString::GetAt(key()); }
+    PString * GetAt(const PStringView     &   key   ) const;
 
     // Overide default PStringToString::SetAt() to make sure the key is caseless
     PBoolean SetAt(const char *              key,    const PString & data) { PConstCaselessString k(key); return SetAt(k, data); }
@@ -3318,6 +3529,7 @@ class PStringOptions : public PStringToString
     PString GetString(const PString         &   key,    const char * dflt = NULL) const { return GetString(PCaselessString(key), dflt); }
     PString GetString(const PCaselessString &   key,    const char * dflt = NULL) const;
     PString GetString(const PCaselessString & (*key)(), const char * dflt = NULL) const { return GetString(key(), dflt); }
+    PString GetString(const PStringView     &   key,    const char * dflt = NULL) const;
 
     /// Set the option value.
     bool SetString(const char *              key,    const PString & value) { return SetAt(key, value); }
@@ -3401,6 +3613,7 @@ class PStringOptions : public PStringToString
     __inline bool Has(const PString         & key)      const { return Contains(key); }
     __inline bool Has(const PCaselessString & key)      const { return Contains(key); }
     __inline bool Has(const PCaselessString & (*key)()) const { return Contains(key); }
+    __inline bool Has(const PStringView     & key)      const { return Contains(key); }
 
     /// Get the option value.
     __inline PString Get(const char *              key,    const char * dflt = NULL) const { return GetString(key, dflt); }
@@ -3408,6 +3621,7 @@ class PStringOptions : public PStringToString
     __inline PString Get(const std::string     &   key,    const char * dflt = NULL) const { return GetString(key, dflt); }
     __inline PString Get(const PCaselessString &   key,    const char * dflt = NULL) const { return GetString(key, dflt); }
     __inline PString Get(const PCaselessString & (*key)(), const char * dflt = NULL) const { return GetString(key, dflt); }
+    __inline PString Get(const PStringView     &   key,    const char * dflt = NULL) const { return GetString(key, dflt); }
     __inline PString Get(const char *              key,    const std::string & dflt) const { return GetString(key, dflt.c_str()); }
     __inline PString Get(const std::string     &   key,    const std::string & dflt) const { return GetString(key, dflt.c_str()); }
     __inline PString Get(const PString         &   key,    const std::string & dflt) const { return GetString(key, dflt.c_str()); }
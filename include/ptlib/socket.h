@@ -84,7 +84,8 @@ class PSocket : public PChannel
     /// Flags to reuse of port numbers in Listen() function.
     enum Reusability {
       CanReuseAddress,
-      AddressIsExclusive
+      AddressIsExclusive,
+      CanReusePort      ///< As CanReuseAddress, plus SO_REUSEPORT where supported, so several sockets share the port
     };
 
     /**Listen on a socket for a remote host on the specified port number. This
@@ -405,48 +406,9 @@ class PSocket : public PChannel
 
   /**@name Scattered read/write functions */
   //@{
-    /** Structure that defines a "slice" of memory to be written to
-     */
-    struct Slice
-#if _WIN32
-      : public WSABUF 
-    {
-      void SetBase(void * p)    { buf = (char *)p; }
-      void * GetBase() const    { return buf; }
-      void SetLength(size_t l)  { len = (ULONG)l; }
-      size_t GetLength() const  { return len; }
-#else // _WIN32
-#if P_HAS_RECVMSG
-      : public iovec
-    {
-#else
-    {
-      protected:
-        void * iov_base;
-        size_t iov_len;
-      public:
-#endif // P_HAS_RECVMSG
-      void SetBase(void * v)    { iov_base = v; }
-      void * GetBase() const    { return iov_base; }
-      void SetLength(size_t l)  { iov_len = l; }
-      size_t GetLength() const  { return iov_len; }
-#endif // _WIN32
-
-      Slice()
-      { SetBase(NULL); SetLength(0); }
-
-      Slice(void * p, size_t l)
-      { SetBase(p); SetLength(l); }
-
-      Slice(const void * p, size_t l)
-      { SetBase(const_cast<void *>(p)); SetLength(l); }
-    };
-
-
-    /** Low level scattered read from the channel. This is identical to Read except 
-        that the data will be read into a series of scattered memory slices. By default,
-        this call will default to calling Read multiple times, but this may be 
-        implemented by operating systems to do a real scattered read
+    /** Low level scattered read from the socket. This is identical to Read except 
+        that the data will be read into a series of scattered memory slices with
+        a single system call.
 
        @return
        true indicates that at least one character was read from the channel.
@@ -457,10 +419,9 @@ class PSocket : public PChannel
       size_t sliceCount
     );
 
-    /** Low level scattered write to the channel. This is identical to Write except 
-        that the data will be written from a series of scattered memory slices. By default,
-        this call will default to calling Write multiple times, but this can be actually
-        implemented by operating systems to do a real scattered write
+    /** Low level scattered write to the socket. This is identical to Write except 
+        that the data will be written from a series of scattered memory slices with
+        a single system call.
 
        @return
        true indicates that at least one character was read from the channel.
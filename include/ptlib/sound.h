@@ -38,6 +38,7 @@
 #include <ptlib/plugin.h>
 #include <ptlib/pluginmgr.h>
 #include <ptclib/delaychan.h>
+#include <ptclib/audiomix.h>
 
 
 #define PSOUND_PCM16 "PCM-16"
@@ -261,7 +262,8 @@ class PSound : public PBYTEArray
    no longer block.
 
    Note that this sound channel is implicitly a linear PCM channel. No data
-   conversion is performed on data to/from the channel.
+   conversion is performed on data to/from the channel, other than of the
+   sample rate when the device does not support it, see SetAutoConvert().
 
  */
 class PSoundChannel : public PIndirectChannel
@@ -520,6 +522,21 @@ class PSoundChannel : public PIndirectChannel
       PINDEX & count    // Number of buffers
     );
 
+    /**Set automatic sample rate conversion.
+       If enabled, which is the default, and the device will not accept the
+       16 bit sample rate given to Open() or SetFormat(), the device is set
+       to a rate it does accept, e.g. 48000, and Read() and Write() convert
+       between the two with a PAudioResampler. GetSampleRate() and the buffer
+       sizes remain as the application asked for.
+      */
+    void SetAutoConvert(bool convert) { m_autoConvert = convert; }
+
+    /// Get the flag for automatic sample rate conversion.
+    bool GetAutoConvert() const { return m_autoConvert; }
+
+    /// Get the sample rate of the device, which differs from GetSampleRate() when converting.
+    unsigned GetDeviceSampleRate() const;
+
     enum {
       MaxVolume = 100
     };
@@ -568,6 +585,23 @@ class PSoundChannel : public PIndirectChannel
 
   //@}
 
+  /**@name Channel functions */
+  //@{
+    /**Read PCM data from the device, converting the sample rate if needed.
+      */
+    virtual PBoolean Read(
+      void * buf,   ///< Pointer to a block of memory to receive the read bytes.
+      PINDEX len    ///< Maximum number of bytes to read into the buffer.
+    );
+
+    /**Write PCM data to the device, converting the sample rate if needed.
+      */
+    virtual PBoolean Write(
+      const void * buf, ///< Pointer to a block of memory to write.
+      PINDEX len        ///< Number of bytes to write.
+    );
+  //@}
+
   /**@name Play functions */
   //@{
     /**Play a sound to the open device. If the <code>wait</code> parameter is
@@ -753,6 +787,16 @@ class PSoundChannel : public PIndirectChannel
        an assert happens. */
     Directions m_activeDirection;
 
+    // Sample rate conversion, when the device does not support the rate
+    bool StartConversion(unsigned numChannels, unsigned sampleRate, unsigned deviceRate);
+
+    bool            m_autoConvert;
+    unsigned        m_convertRate;    // Application sample rate, zero if not converting
+    PAudioResampler m_resampler;
+    PShortArray     m_convertBuffer;
+    PINDEX          m_convertPos;
+    PINDEX          m_convertCount;
+
     P_REMOVE_VIRTUAL(PBoolean, Open(const PString &,Directions,unsigned,unsigned,unsigned),false);
 };
 
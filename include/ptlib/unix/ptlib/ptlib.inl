@@ -84,14 +84,6 @@ PINLINE PString PFilePath::GetPath() const
 
 ///////////////////////////////////////////////////////////////////////////////
 
-PINLINE bool PFile::Remove(const PFilePath & name, bool)
-  { return unlink((char *)(const char *)name) == 0; }
-
-PINLINE bool PFile::Remove(const PString & name, bool)
-  { return unlink((char *)(const char *)name) == 0; }
-
-///////////////////////////////////////////////////////////////////////////////
-
 #if defined(P_PTHREADS)
 PINLINE PThreadIdentifier PThread::GetCurrentThreadId() { return ::pthread_self(); }
 #elif defined(VX_TASKS)
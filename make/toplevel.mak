@@ -222,6 +222,7 @@ endif # HAS_VIDEO
 ifeq ($(HAS_AUDIO),1)
 
   SOURCES += $(COMMON_SRC_DIR)/sound.cxx 
+  SOURCES += $(COMPONENT_SRC_DIR)/audiomix.cxx
 
   ifeq ($(target_os),mingw)
     SOURCES += $(PLATFORM_SRC_DIR)/sound_win32.cxx
@@ -265,6 +266,10 @@ ifeq ($(HAS_EXPAT),1)
   endif
 endif # HAS_EXPAT
 
+ifeq ($(HAS_ZLIB),1)
+  SOURCES += $(COMPONENT_SRC_DIR)/pzlib.cxx
+endif
+
 ifeq ($(HAS_LUA),1)
   SOURCES += $(COMPONENT_SRC_DIR)/lua.cxx
 endif
@@ -386,6 +391,7 @@ ifeq ($(HAS_HTTP),1)
   SOURCES += $(COMPONENT_SRC_DIR)/http.cxx \
              $(COMPONENT_SRC_DIR)/httpclnt.cxx \
              $(COMPONENT_SRC_DIR)/html.cxx \
+             $(COMPONENT_SRC_DIR)/http2.cxx \
              $(COMPONENT_SRC_DIR)/httpsrvr.cxx
 
   ifeq ($(HAS_SSDP),1)
@@ -496,6 +502,9 @@ SOURCES	+= \
 	$(COMPONENT_SRC_DIR)/random.cxx \
 	$(COMPONENT_SRC_DIR)/notifier_ext.cxx \
 	$(COMMON_SRC_DIR)/safecoll.cxx \
+	$(COMMON_SRC_DIR)/metrics.cxx \
+	$(COMMON_SRC_DIR)/bufchain.cxx \
+	$(COMMON_SRC_DIR)/dirwatch.cxx \
 	$(COMMON_SRC_DIR)/ptime.cxx \
 	$(GETDATE_SOURCE) \
 	$(COMMON_SRC_DIR)/osutils.cxx \
@@ -31,12 +31,22 @@
 #include <ptlib.h>
 #include <ptlib/pprocess.h>
 #include <ptclib/podbc.h>
+#include <ptclib/random.h>
 
 class ODBCtest : public PProcess
 {
   PCLASSINFO(ODBCtest, PProcess)
 public:
   void Main();
+
+#if P_ODBC
+protected:
+  void Benchmark(PODBC & link, const PODBC::ConnectData & data, unsigned rows, unsigned threads);
+  void PoolThread(PODBCPool & pool, unsigned rows);
+
+  unsigned         m_tableRows;
+  atomic<unsigned> m_totalQueries;
+#endif
 };
 
 PCREATE_PROCESS(ODBCtest)
@@ -54,6 +64,9 @@ void ODBCtest::Main()
              "P-port:"
              "u-username:"
              "p-password:"
+             "c-connect:"
+             "b-benchmark:"
+             "j-threads:"
 #if PTRACING
              "o-output:"
              "t-trace."
@@ -69,6 +82,9 @@ void ODBCtest::Main()
          << "  -P --port X        : Port number\n"
          << "  -u --username X    : User name\n"
          << "  -p --password X    : Password\n"
+         << "  -c --connect X     : ODBC connection string, used instead of <driver>\n"
+         << "  -b --benchmark N   : Run benchmark with N rows, e.g. -c \"DRIVER=SQLite3;Database=bench.db\" -b 100000\n"
+         << "  -j --threads N     : Threads using connection pool in benchmark, default 4\n"
 #if PTRACING
          << "  -t --trace         : Enable trace, use multiple times for more detail\n"
          << "  -o --output        : File for trace output, default is stderr\n"
@@ -110,7 +126,9 @@ void ODBCtest::Main()
 
   PODBC::ConnectData data;
 
-  if (args.GetCount() == 0)
+  if (args.HasOption('c'))
+    data.m_driver = PODBC::ConnectionString;
+  else if (args.GetCount() == 0)
     data.m_driver = PODBC::MSAccess;
   else {
     for (data.m_driver = PODBC::BeginDriverType; data.m_driver < PODBC::EndDriverType; ++data.m_driver) {
@@ -123,7 +141,7 @@ void ODBCtest::Main()
     }
   }
 
-  data.m_database = args.GetOptionString('d', "test.mdb");
+  data.m_database = args.HasOption('c') ? args.GetOptionString('c') : args.GetOptionString('d', "test.mdb");
   data.m_host = args.GetOptionString('H');
   data.m_port = args.GetOptionString('P', "0").AsUnsigned();
   data.m_username = args.GetOptionString('u');
@@ -136,6 +154,11 @@ void ODBCtest::Main()
     return;
   }
 
+  if (args.HasOption('b')) {
+    Benchmark(link, data, std::max(args.GetOptionString('b').AsUnsigned(), 1U), args.GetOptionString('j', "4").AsUnsigned());
+    return;
+  }
+
   cout << "Connected Access Database\n" << endl;
 
   /// Settings
@@ -337,6 +360,139 @@ void ODBCtest::Main()
   }
 }
 
+
+static void Report(const char * phase, unsigned count, const PTime & start)
+{
+  PInt64 ms = std::max((PInt64)1, (PTime() - start).GetMilliSeconds());
+  cout << "  " << left << setw(20) << phase << right << setw(8) << count << " rows "
+       << setw(10) << (PUInt64)count*1000/ms << " rows/s" << endl;
+}
+
+
+void ODBCtest::Benchmark(PODBC & link, const PODBC::ConnectData & data, unsigned rows, unsigned threads)
+{
+  static const unsigned BatchSize = 1000;
+  static const char Insert[] = "INSERT INTO bench VALUES (?,?,?)";
+  static const char Select[] = "SELECT id, name, value FROM bench";
+
+  link.Execute("DROP TABLE bench");
+  if (!link.Execute(PSTRSTRM("CREATE TABLE bench ("
+                             "id " << PODBC::GetFieldType(data.m_driver, PVarType::VarInt32) << " primary key, "
+                             "name " << PODBC::GetFieldType(data.m_driver, PVarType::VarStaticString, 40) << ", "
+                             "value " << PODBC::GetFieldType(data.m_driver, PVarType::VarFloatDouble) << ')'))) {
+    cout << "Could not create benchmark table: " << link.GetLastErrorText() << endl;
+    return;
+  }
+
+  cout << "Benchmark with " << rows << " rows per phase" << endl;
+  threads = std::max(threads, 1U);
+
+  // Each insert phase uses its own range of ids
+  {
+    PTime start;
+    for (unsigned i = 0; i < rows; ++i)
+      link.Execute(PSTRSTRM("INSERT INTO bench VALUES (" << i << ",'name" << i << "'," << i*0.5 << ')'));
+    Report("Direct insert", rows, start);
+  }
+
+  {
+    PTime start;
+    PODBC::Prepared insert(link, Insert);
+    PODBC::Parameters params(3);
+    for (unsigned i = rows; i < rows*2; ++i) {
+      params[0] = (int32_t)i;
+      params[1] = PSTRSTRM("name" << i);
+      params[2] = i*0.5;
+      insert.Execute(params);
+    }
+    Report("Prepared insert", rows, start);
+  }
+
+  {
+    PTime start;
+    PODBC::ParameterRows batch;
+    for (unsigned i = rows*2; i < rows*3; ++i) {
+      PODBC::Parameters params(3);
+      params[0] = (int32_t)i;
+      params[1] = PSTRSTRM("name" << i);
+      params[2] = i*0.5;
+      batch.push_back(params);
+      if (batch.size() >= BatchSize || i == rows*3-1) {
+        if (!link.BulkExecute(Insert, batch))
+          cout << "Bulk insert failed: " << link.GetLastErrorText() << endl;
+        batch.clear();
+      }
+    }
+    Report("Bulk insert", rows, start);
+  }
+
+  {
+    PTime start;
+    unsigned count = 0;
+    PODBC::RecordSet table(link, Select);
+    if (table.Columns() == 3 && table.First()) {
+      do {
+        table.Column(1).AsInteger();
+        table.Column(2).AsString();
+        table.Column(3).AsFloat();
+        ++count;
+      } while (table.Next());
+    }
+    Report("RecordSet fetch", count, start);
+  }
+
+  {
+    PTime start;
+    unsigned count = 0;
+    PODBC::Prepared select(link, Select);
+    PODBC::RowBlock block(256);
+    if (select.Execute()) {
+      while (select.Fetch(block)) {
+        for (PINDEX row = 0; row < block.GetRowCount(); ++row) {
+          block.AsInteger64(row, 1);
+          block.AsString(row, 2);
+          block.AsFloat(row, 3);
+          ++count;
+        }
+      }
+    }
+    Report("Block fetch", count, start);
+  }
+
+  {
+    PODBCPool pool(data, threads, threads);
+    m_tableRows = rows*3;
+    m_totalQueries = 0;
+    PTime start;
+    std::vector<PThread *> workers(threads);
+    for (unsigned i = 0; i < threads; ++i)
+      workers[i] = new PThreadObj2Arg<ODBCtest, PODBCPool &, unsigned>(*this, pool, rows/threads, &ODBCtest::PoolThread, false, "Pool");
+    for (unsigned i = 0; i < threads; ++i)
+      PThread::WaitAndDelete(workers[i]);
+    cout << "  Pool of " << threads << " threads:" << endl;
+    Report("Prepared lookup", m_totalQueries, start);
+  }
+}
+
+
+void ODBCtest::PoolThread(PODBCPool & pool, unsigned rows)
+{
+  // Acquire per query, as a server would per request, the statement stays prepared
+  PODBC::Parameters params(1);
+  PODBC::RowBlock block(1);
+  for (unsigned i = 0; i < rows; ++i) {
+    PODBCPool::Connection odbc(pool);
+    if (!odbc.IsValid())
+      break;
+
+    PODBC::Prepared lookup(*odbc, "SELECT name FROM bench WHERE id=?");
+    params[0] = (int32_t)(PRandom::Number() % m_tableRows);
+    if (lookup.Execute(params) && lookup.Fetch(block))
+      ++m_totalQueries;
+  }
+}
+
+
 #else
 
 #pragma message("Cannot compile test program without ODBC support!")
@@ -37,6 +37,8 @@ class AsyncTest : public PProcess
     PCLASSINFO(AsyncTest, PProcess)
   public:
     void Main();
+    void RunEcho(Modes senderMode, Modes receiverMode, WORD port);
+    void RunCopy(unsigned megabytes);
 
     unsigned m_numTests;
     unsigned m_concurrent;
@@ -62,6 +64,14 @@ class AsyncTest : public PProcess
       {
       }
 
+      // Buffer must be our own storage, not the original's
+      MyContext(const MyContext & other)
+        : PChannel::AsyncContext(m_storage, sizeof(m_storage), other.m_notifier)
+        , m_index(other.m_index)
+        , m_port(other.m_port)
+      {
+      }
+
       int  m_index;
       BYTE m_storage[1000];
       WORD m_port;
@@ -69,6 +79,23 @@ class AsyncTest : public PProcess
 
     vector<MyContext> m_readContexts;
     PDECLARE_AsyncNotifier(AsyncTest, Received);
+
+    // Each block of the copy is read, then written at the same offset
+    class CopyContext : public PChannel::AsyncContext
+    {
+    public:
+      CopyContext() : m_offset(0), m_writing(false) { }
+      PBYTEArray m_data;
+      off_t      m_offset;
+      bool       m_writing;
+    };
+
+    PFile          m_copySource;
+    PFile          m_copyDestination;
+    off_t          m_copyStride;
+    PAtomicInteger m_copiesRunning;
+    PSyncPoint     m_copyFinished;
+    PDECLARE_AsyncNotifier(AsyncTest, Copied);
 };
 
 PCREATE_PROCESS(AsyncTest)
@@ -104,6 +131,8 @@ void AsyncTest::Main()
              "n-num-tests:"
              "i-interface:"
              "p-port:"
+             "e-engine:"
+             "F-file-copy:"
 #if PTRACING
              "o-output:"
              "t-trace."
@@ -116,7 +145,7 @@ void AsyncTest::Main()
          PTrace::Blocks | PTrace::Timestamp | PTrace::Thread | PTrace::FileAndLine);
 #endif
 
-  if (args.HasOption('h') || args.GetCount() < 2) {
+  if (args.HasOption('h') || (args.GetCount() < 2 && !args.HasOption('F'))) {
     PError << "usage: " << GetFile().GetTitle() << "[options] <sender-mode> <receiver-mode>\n"
               "\n"
               "   <X-mode> is one of \"none\", \"sync\" or \"async\".\n"
@@ -127,6 +156,8 @@ void AsyncTest::Main()
               "   -n --num-tests n      : total number of tests (default 100000).\n"
               "   -i --interface if     : interface to use (default 127.0.0.1).\n"
               "   -p --port n           : port base to use (default random).\n"
+              "   -e --engine name      : async engine, \"aio\", \"io_uring\" or \"both\" to compare.\n"
+              "   -F --file-copy n      : also time an async copy of an n megabyte file.\n"
 #if PTRACING
               "   -o or --output file   : file name for output of log messages\n"       
               "   -t or --trace         : degree of verbosity in log (more times for more detail)\n"     
@@ -135,14 +166,48 @@ void AsyncTest::Main()
     return;
   }
 
-  Modes senderMode = GetMode(args[0]);
-  Modes receiverMode = GetMode(args[1]);
+  Modes senderMode = args.GetCount() > 1 ? GetMode(args[0]) : DisabledMode;
+  Modes receiverMode = args.GetCount() > 1 ? GetMode(args[1]) : DisabledMode;
 
   m_concurrent = args.GetOptionString('c', "100").AsUnsigned();
-  unsigned concurrent;
-
   m_binding = args.GetOptionString('i', "127.0.0.1");
   WORD port = (WORD)args.GetOptionString('p', "0").AsUnsigned();
+  unsigned totalTests = args.GetOptionString('n', "100000").AsInteger();
+  m_numTests = (totalTests+m_concurrent-1)/m_concurrent;
+
+  std::vector<PChannel::AsyncEngines> engines;
+  PCaselessString engine = args.GetOptionString('e');
+  if (engine == "aio" || engine == "both")
+    engines.push_back(PChannel::AsyncEngineAIO);
+  if (engine == "io_uring" || engine == "both")
+    engines.push_back(PChannel::AsyncEngineIOURing);
+  if (engines.empty())
+    engines.push_back(PChannel::AsyncEngineDefault);
+
+  for (size_t i = 0; i < engines.size(); ++i) {
+    if (!PChannel::SetAsyncEngine(engines[i])) {
+      cerr << "Async engine " << engines[i] << " not available" << endl;
+      continue;
+    }
+    cout << "Async engine: " << (PChannel::GetAsyncEngine() == PChannel::AsyncEngineIOURing ? "io_uring" : "aio") << endl;
+
+    // Copy first, AIO can leave its threads blocked on the closed echo sockets
+    if (args.HasOption('F'))
+      RunCopy(args.GetOptionString('F').AsUnsigned());
+    if (args.GetCount() > 1)
+      RunEcho(senderMode, receiverMode, port);
+  }
+}
+
+
+void AsyncTest::RunEcho(Modes senderMode, Modes receiverMode, WORD port)
+{
+  unsigned concurrent;
+
+  m_readSockets.RemoveAll();
+  m_writeSockets.RemoveAll();
+  m_readContexts.clear();
+  m_testsExecuted = 0;
 
   if (receiverMode != DisabledMode) {
     for (concurrent = 0; concurrent < m_concurrent; ++concurrent) {
@@ -168,12 +233,10 @@ void AsyncTest::Main()
     }
   }
 
-  unsigned totalTests = args.GetOptionString('n', "100000").AsInteger();
-  m_numTests = (totalTests+m_concurrent-1)/m_concurrent;
-
   m_testersRunning = m_concurrent;
 
   if (receiverMode == AsyncMode) {
+    m_readContexts.reserve(m_concurrent);
     for (concurrent = 0; concurrent < m_concurrent; ++concurrent)
       m_readContexts.push_back(MyContext(concurrent,
                                          PCREATE_AsyncNotifier(Received),
@@ -219,7 +282,90 @@ void AsyncTest::Main()
 
   PTimeInterval taken = PTime() - start;
   cout << "Completed: " << taken << " seconds, "
-       << (m_numTests*1000/taken.GetMilliSeconds()) << " ops/sec/thread" << endl;
+       << (m_numTests*1000/std::max((PInt64)1, taken.GetMilliSeconds())) << " ops/sec/thread" << endl;
+
+  // Let the last async reads see their sockets closed
+  PThread::Sleep(100);
+}
+
+
+void AsyncTest::RunCopy(unsigned megabytes)
+{
+  static const PINDEX BlockSize = 256*1024;
+  static const unsigned Depth = 8;
+
+  PFilePath sourcePath = PFilePath("asynctest", NULL);
+  PFilePath destinationPath = sourcePath + ".copy";
+
+  // Written, and so in the page cache, so it is I/O submission that is timed, not the disk
+  {
+    PFile source(sourcePath, PFile::WriteOnly);
+    PBYTEArray data(BlockSize);
+    for (PINDEX i = 0; i < BlockSize; ++i)
+      data[i] = (BYTE)(i*7);
+    for (PUInt64 total = 0; total < (PUInt64)megabytes*1000000; total += BlockSize)
+      source.Write(data, BlockSize);
+  }
+
+  if (!m_copySource.Open(sourcePath, PFile::ReadOnly) ||
+      !m_copyDestination.Open(destinationPath, PFile::WriteOnly)) {
+    cerr << "Could not open files for copy" << endl;
+    return;
+  }
+
+  std::vector<CopyContext> contexts(Depth);
+  m_copyStride = Depth*BlockSize;
+  m_copiesRunning = Depth;
+
+  PTime start;
+  for (unsigned i = 0; i < Depth; ++i) {
+    CopyContext & context = contexts[i];
+    context.m_data.SetSize(BlockSize);
+    context.m_offset = i*BlockSize;
+    context.m_notifier = PCREATE_AsyncNotifier(Copied);
+    context.m_buffer = context.m_data.GetPointer();
+    context.m_length = BlockSize;
+    context.SetOffset(context.m_offset);
+    if (!m_copySource.ReadAsync(context) && --m_copiesRunning == 0)
+      m_copyFinished.Signal();
+  }
+  m_copyFinished.Wait();
+  PTimeInterval taken = PTime() - start;
+
+  PInt64 size = m_copyDestination.GetLength();
+  m_copySource.Close();
+  m_copyDestination.Close();
+
+  cout << "File copy: " << size << " bytes in " << taken << " seconds, "
+       << size/1000/std::max((PInt64)1, taken.GetMilliSeconds()) << " MB/s" << endl;
+
+  PFile::Remove(sourcePath);
+  PFile::Remove(destinationPath);
+}
+
+
+void AsyncTest::Copied(PChannel &, PChannel::AsyncContext & asyncContext)
+{
+  CopyContext & context = static_cast<CopyContext &>(asyncContext);
+
+  bool ok;
+  if (context.m_writing) {
+    // Next block this context is responsible for
+    context.m_writing = false;
+    context.m_offset += m_copyStride;
+    context.m_length = context.m_data.GetSize();
+    context.SetOffset(context.m_offset);
+    ok = context.m_errorCode == PChannel::NoError && m_copySource.ReadAsync(context);
+  }
+  else {
+    // End of file when nothing read, write what was, to the same offset
+    context.m_writing = true;
+    context.SetOffset(context.m_offset);
+    ok = context.m_errorCode == PChannel::NoError && context.m_length > 0 && m_copyDestination.WriteAsync(context);
+  }
+
+  if (!ok && --m_copiesRunning == 0)
+    m_copyFinished.Signal();
 }
 
 
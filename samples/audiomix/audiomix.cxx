@@ -0,0 +1,207 @@
+/*
+ * audiomix.cxx
+ *
+ * Benchmark for PAudioMixer mixing many streams, and PAudioResampler
+ * conversion between common rates.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/audiomix.h>
+
+#include <algorithm>
+#include <math.h>
+
+
+class AudioMix : public PProcess
+{
+  PCLASSINFO(AudioMix, PProcess)
+  public:
+    AudioMix();
+    virtual void Main();
+
+  protected:
+    void Mix(unsigned streams, unsigned inputRate, unsigned mixRate, unsigned frames, bool mixMinus);
+    void Resample(unsigned srcRate, unsigned dstRate, unsigned seconds);
+    void Quality(unsigned srcRate, unsigned dstRate);
+};
+
+PCREATE_PROCESS(AudioMix);
+
+
+AudioMix::AudioMix()
+  : PProcess("PTLib", "audiomix")
+{
+}
+
+
+void AudioMix::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("s-streams: Number of streams to mix, default 256\n"
+             "f-frames: Number of 20ms frames to mix, default 500\n"
+             "S-seconds: Seconds of audio to resample, default 60\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned streams = std::max(1U, args.GetOptionString('s', "256").AsUnsigned());
+  unsigned frames = std::max(1U, args.GetOptionString('f', "500").AsUnsigned());
+  unsigned seconds = std::max(1U, args.GetOptionString('S', "60").AsUnsigned());
+
+  Mix(streams, 48000, 48000, frames, false);
+  Mix(streams, 48000, 48000, frames, true);
+  Mix(streams, 16000, 16000, frames, true);
+  Mix(streams, 16000, 48000, frames, true);
+
+  static const unsigned Rates[][2] = {
+    {  8000, 48000 },
+    { 16000, 48000 },
+    { 44100, 48000 },
+    { 48000,  8000 },
+    { 48000, 16000 }
+  };
+  for (PINDEX i = 0; i < PARRAYSIZE(Rates); ++i)
+    Resample(Rates[i][0], Rates[i][1], seconds);
+
+  for (PINDEX i = 0; i < PARRAYSIZE(Rates); ++i)
+    Quality(Rates[i][0], Rates[i][1]);
+}
+
+
+static void MakeTone(std::vector<short> & samples, unsigned rate, double frequency, double amplitude, PINDEX offset = 0)
+{
+  for (PINDEX i = 0; i < (PINDEX)samples.size(); ++i)
+    samples[i] = (short)(amplitude*sin(2*M_PI*frequency*(i + offset)/rate));
+}
+
+
+void AudioMix::Mix(unsigned streams, unsigned inputRate, unsigned mixRate, unsigned frames, bool mixMinus)
+{
+  PAudioMixer mixer(mixRate);
+  std::vector<PAudioMixer::InputID> ids(streams);
+  for (unsigned i = 0; i < streams; ++i)
+    ids[i] = mixer.AddInput(inputRate, i%2 == 0 ? PAudioMixer::UnityGain : PAudioMixer::UnityGain/2);
+
+  PINDEX inputFrame = inputRate/50;
+  PINDEX mixFrame = mixRate/50;
+  std::vector<short> input(inputFrame), output(mixFrame);
+  MakeTone(input, inputRate, 440, 1000);
+
+  PTimeInterval writeTime, mixTime;
+  unsigned checksum = 0;
+  for (unsigned f = 0; f < frames; ++f) {
+    PTime start;
+    for (unsigned i = 0; i < streams; ++i)
+      mixer.Write(ids[i], &input[0], inputFrame);
+    PTime mixStart;
+    writeTime += mixStart - start;
+
+    mixer.MixFrame(mixFrame);
+    mixer.GetMixed(&output[0]);
+    checksum += output[mixFrame/2];
+    if (mixMinus) {
+      // What every participant in a conference hears
+      for (unsigned i = 0; i < streams; ++i) {
+        mixer.GetMixed(&output[0], ids[i]);
+        checksum += output[i%mixFrame];
+      }
+    }
+    mixTime += PTime() - mixStart;
+  }
+
+  PInt64 writeNs = writeTime.GetNanoSeconds()/frames;
+  PInt64 mixNs = std::max((PInt64)1, mixTime.GetNanoSeconds()/frames);
+  cout << streams << " streams " << setw(5) << inputRate << "->" << setw(5) << mixRate
+       << (mixMinus ? " with mix-minus" : "              ")
+       << ", per 20ms frame: write " << setw(7) << writeNs/1000 << "us"
+          " mix " << setw(7) << mixNs/1000 << "us"
+          " (" << setw(5) << 20000000/(writeNs + mixNs) << "x realtime)"
+          "  checksum=" << checksum << endl;
+}
+
+
+void AudioMix::Resample(unsigned srcRate, unsigned dstRate, unsigned seconds)
+{
+  PAudioResampler resampler(srcRate, dstRate);
+
+  // Converted in 20ms pieces, as it would be in a media stream
+  PINDEX srcFrame = srcRate/50;
+  std::vector<short> input(srcFrame), output(resampler.GetMaxOutput(srcFrame));
+  MakeTone(input, srcRate, 1000, 10000);
+
+  PUInt64 produced = 0;
+  PTime start;
+  for (unsigned f = 0; f < seconds*50; ++f) {
+    PINDEX count = srcFrame;
+    produced += resampler.Process(&input[0], count, &output[0], output.size());
+  }
+  PInt64 us = std::max((PInt64)1, (PTime() - start).GetMicroSeconds());
+
+  cout << "Resample " << setw(5) << srcRate << "->" << setw(5) << dstRate
+       << ", " << setw(3) << resampler.GetTaps() << " taps: "
+       << setw(6) << produced/us << "M samples/s output, "
+       << setw(6) << (PInt64)seconds*1000000/us << "x realtime" << endl;
+}
+
+
+void AudioMix::Quality(unsigned srcRate, unsigned dstRate)
+{
+  // A tone well inside both pass bands, compared to the ideal after the filter delay
+  static const double Frequency = 1000;
+  static const double Amplitude = 10000;
+
+  PAudioResampler resampler(srcRate, dstRate);
+  std::vector<short> input(srcRate), output(resampler.GetMaxOutput(srcRate));
+  MakeTone(input, srcRate, Frequency, Amplitude);
+
+  PINDEX count = input.size();
+  PINDEX produced = resampler.Process(&input[0], count, &output[0], output.size());
+
+  // Find the delay, it is about half the filter length
+  double delay = (resampler.GetTaps() - 1)/2.0*dstRate/srcRate;
+  double bestError = 1e300;
+  double bestDelay = delay;
+  for (double d = delay - 4; d <= delay + 4; d += 0.05) {
+    double error = 0;
+    for (PINDEX i = produced/4; i < produced*3/4; ++i) {
+      double e = output[i] - Amplitude*sin(2*M_PI*Frequency*(i - d)/dstRate);
+      error += e*e;
+    }
+    if (error < bestError) {
+      bestError = error;
+      bestDelay = d;
+    }
+  }
+
+  double signal = Amplitude*Amplitude/2*(produced*3/4 - produced/4);
+  cout << "Quality  " << setw(5) << srcRate << "->" << setw(5) << dstRate
+       << ", 1kHz tone SNR " << std::fixed << std::setprecision(1) << 10*log10(signal/bestError) << "dB"
+          " delay " << bestDelay << " samples" << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,252 @@
+/*
+ * chainbench.cxx
+ *
+ * Benchmark for large HTTP bodies sent and received as contiguous arrays,
+ * or as PBufferChain with scattered/gathered I/O.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/sockets.h>
+#include <ptlib/bufchain.h>
+#include <ptlib/metrics.h>
+#include <ptclib/http.h>
+
+#include <algorithm>
+#include <sys/resource.h>
+
+
+class ChainBench : public PProcess
+{
+  PCLASSINFO(ChainBench, PProcess)
+  public:
+    ChainBench();
+    virtual void Main();
+
+    void ServerMain();
+    void Run(bool post, bool chains, unsigned requests);
+
+    PTCPSocket   m_listener;
+    PBYTEArray   m_arrayBody;
+    PBufferChain m_chainBody;
+    bool         m_chains;
+    atomic<PUInt64> m_received;
+};
+
+PCREATE_PROCESS(ChainBench);
+
+
+class BenchServer : public PHTTPServer
+{
+    PCLASSINFO(BenchServer, PHTTPServer)
+  public:
+    BenchServer(ChainBench & bench)
+      : m_bench(bench)
+    {
+    }
+
+    virtual PString ReadEntityBody()
+    {
+      if (!m_bench.m_chains)
+        return PHTTPServer::ReadEntityBody();
+
+      PBufferChain body;
+      PHTTPServer::ReadEntityBody(body);
+      m_bench.m_received += body.GetLength();
+      return PString::Empty();
+    }
+
+    virtual bool OnPOST(const PHTTPConnectionInfo & conInfo)
+    {
+      if (!m_bench.m_chains)
+        m_bench.m_received += conInfo.GetEntityBody().GetLength();
+      return SendResponse(RequestOK);
+    }
+
+    virtual bool OnGET(const PHTTPConnectionInfo &)
+    {
+      PMIMEInfo mime;
+      mime.SetAt(ContentTypeTag(), "application/octet-stream");
+      if (m_bench.m_chains) {
+        StartResponse(RequestOK, mime, m_bench.m_chainBody.GetLength());
+        return WriteChain(m_bench.m_chainBody);
+      }
+
+      StartResponse(RequestOK, mime, m_bench.m_arrayBody.GetSize());
+      return Write(m_bench.m_arrayBody, m_bench.m_arrayBody.GetSize());
+    }
+
+  protected:
+    ChainBench & m_bench;
+};
+
+
+ChainBench::ChainBench()
+  : PProcess("PTLib", "chainbench")
+  , m_chains(false)
+  , m_received(0)
+{
+}
+
+
+void ChainBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("s-size: Megabytes in each body, default 16\n"
+             "n-requests: Number of requests in each direction, default 50\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  PINDEX size = std::max(1U, args.GetOptionString('s', "16").AsUnsigned())*1024*1024;
+  unsigned requests = std::max(1U, args.GetOptionString('n', "50").AsUnsigned());
+
+  m_arrayBody.SetSize(size);
+  for (PINDEX i = 0; i < size; ++i)
+    m_arrayBody[i] = (BYTE)i;
+  m_chainBody.Append(m_arrayBody.GetPointer(), size); // Into pool blocks, as if it had been read
+
+  if (!m_listener.Listen(PIPSocket::Address::GetLoopback(), 5)) {
+    cerr << "Could not listen: " << m_listener.GetErrorText() << endl;
+    return;
+  }
+
+  PThread * server = new PThreadObj<ChainBench>(*this, &ChainBench::ServerMain, false, "Server");
+
+  Run(true,  false, requests);
+  Run(true,  true,  requests);
+  Run(false, false, requests);
+  Run(false, true,  requests);
+
+  m_listener.Close();
+  PThread::WaitAndDelete(server);
+}
+
+
+void ChainBench::ServerMain()
+{
+  while (m_listener.IsOpen()) {
+    PTCPSocket * socket = new PTCPSocket;
+    if (!socket->Accept(m_listener)) {
+      delete socket;
+      break;
+    }
+
+    BenchServer server(*this);
+    if (server.Open(socket))
+      while (server.ProcessCommand())
+        ;
+  }
+}
+
+
+static PUInt64 GetSocketCalls()
+{
+  PStringStream metrics;
+  PMetric::OutputAllPrometheus(metrics);
+  PStringArray lines = metrics.Lines();
+  PUInt64 total = 0;
+  for (PINDEX i = 0; i < lines.GetSize(); ++i) {
+    if (lines[i].NumCompare("ptlib_socket_packets_total{") == PObject::EqualTo)
+      total += lines[i].Mid(lines[i].Find('}') + 1).Trim().AsUnsigned64();
+  }
+  return total;
+}
+
+
+void ChainBench::Run(bool post, bool chains, unsigned requests)
+{
+  m_chains = chains;
+  PURL url(PSTRSTRM("http://127.0.0.1:" << m_listener.GetPort() << "/body"));
+
+  PHTTPClient client;
+  PBufferChain::Statistics before, after;
+  PBufferChain::GetStatistics(before);
+  PUInt64 callsBefore = GetSocketCalls();
+  struct rusage usageBefore, usageAfter;
+  getrusage(RUSAGE_SELF, &usageBefore);
+  m_received = 0;
+  PUInt64 downloaded = 0;
+  PTime start;
+
+  for (unsigned i = 0; i < requests; ++i) {
+    PMIMEInfo outMIME, replyMIME;
+    if (post) {
+      outMIME.SetAt(PHTTP::ContentTypeTag(), "application/octet-stream");
+      PHTTP::StatusCode status = chains ? client.ExecuteCommand(PHTTP::POST, url, outMIME, m_chainBody, replyMIME)
+                                        : client.ExecuteCommand(PHTTP::POST, url, outMIME, m_arrayBody, replyMIME);
+      if (status/100 != 2 || !client.ReadContentBody(replyMIME)) {
+        cerr << "POST failed: " << client.GetLastResponseInfo() << endl;
+        return;
+      }
+    }
+    else {
+      bool ok = client.GetDocument(url, outMIME, replyMIME);
+      if (ok) {
+        if (chains) {
+          PBufferChain body;
+          ok = client.ReadContentBody(replyMIME, body);
+          downloaded += body.GetLength();
+        }
+        else {
+          PBYTEArray body;
+          ok = client.ReadContentBody(replyMIME, body);
+          downloaded += body.GetSize();
+        }
+      }
+      if (!ok) {
+        cerr << "GET failed: " << client.GetLastResponseInfo() << endl;
+        return;
+      }
+    }
+  }
+
+  PInt64 us = std::max((PInt64)1, (PTime() - start).GetMicroSeconds());
+  getrusage(RUSAGE_SELF, &usageAfter);
+  PUInt64 calls = GetSocketCalls() - callsBefore;
+  PBufferChain::GetStatistics(after);
+
+  PInt64 cpuUs = (usageAfter.ru_utime.tv_sec - usageBefore.ru_utime.tv_sec)*1000000LL + (usageAfter.ru_utime.tv_usec - usageBefore.ru_utime.tv_usec)
+               + (usageAfter.ru_stime.tv_sec - usageBefore.ru_stime.tv_sec)*1000000LL + (usageAfter.ru_stime.tv_usec - usageBefore.ru_stime.tv_usec);
+  PInt64 userUs = (usageAfter.ru_utime.tv_sec - usageBefore.ru_utime.tv_sec)*1000000LL + (usageAfter.ru_utime.tv_usec - usageBefore.ru_utime.tv_usec);
+
+  PUInt64 bytes = post ? (PUInt64)m_received : downloaded;
+  if (bytes != (PUInt64)m_arrayBody.GetSize()*requests)
+    cerr << "Expected " << (PUInt64)m_arrayBody.GetSize()*requests << " bytes, got " << bytes << endl;
+
+  cout << (post ? "POST " : "GET  ") << (chains ? "PBufferChain" : "PBYTEArray  ")
+       << ' ' << m_arrayBody.GetSize()/1024/1024 << "MB x " << requests << ": "
+       << setw(5) << bytes/us << " MB/s,"
+          " per request: CPU " << setw(6) << cpuUs/requests << "us"
+          " (user " << setw(6) << userUs/requests << "us),"
+          " socket calls " << setw(5) << calls/requests << ","
+          " chain copied " << setw(8) << (after.m_copiedBytes - before.m_copiedBytes)/requests << " bytes,"
+          " blocks " << setw(5) << ((after.m_pooledBlocks + after.m_allocatedBlocks) - (before.m_pooledBlocks + before.m_allocatedBlocks))/requests
+       << " (" << (after.m_allocatedBlocks - before.m_allocatedBlocks) << " from heap)" << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
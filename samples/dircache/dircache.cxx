@@ -0,0 +1,183 @@
+/*
+ * dircache.cxx
+ *
+ * Benchmark for directory listings and file information lookups, with and
+ * without the PFileInfoCache.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/dirwatch.h>
+
+#include <algorithm>
+#include <sys/resource.h>
+
+
+class DirCache : public PProcess
+{
+  PCLASSINFO(DirCache, PProcess)
+  public:
+    DirCache();
+    virtual void Main();
+
+    void Run(const char * name, bool listing, unsigned passes);
+    bool CheckExternalChange();
+
+    PDirectory              m_directory;
+    std::vector<PFilePath>  m_files;
+    std::vector<PFilePath>  m_missing;
+};
+
+PCREATE_PROCESS(DirCache);
+
+
+DirCache::DirCache()
+  : PProcess("PTLib", "dircache")
+{
+}
+
+
+void DirCache::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("n-files: Number of files in the directory, default 100000\n"
+             "p-passes: Number of passes over the directory, default 5\n"
+             "d-directory: Directory to create the files in, default system temporary\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned count = std::max(1U, args.GetOptionString('n', "100000").AsUnsigned());
+  unsigned passes = std::max(1U, args.GetOptionString('p', "5").AsUnsigned());
+
+  m_directory = PDirectory(args.GetOptionString('d', PDirectory::GetTemporary())) + PSTRSTRM("dircache." << GetProcessID());
+  if (!m_directory.Create(PFileInfo::DefaultDirPerms, true)) {
+    cerr << "Could not create " << m_directory << endl;
+    return;
+  }
+
+  cout << "Creating " << count << " files in " << m_directory << endl;
+  for (unsigned i = 0; i < count; ++i) {
+    PString name = PSTRSTRM("file" << setfill('0') << setw(7) << i);
+    m_files.push_back(m_directory + name + ".txt");
+    m_missing.push_back(m_directory + name + ".missing");
+    PFile file(m_files.back(), PFile::WriteOnly);
+    file.Write("x", 1);
+  }
+
+  Run("listing, no cache", true, passes);
+  Run("lookups, no cache", false, passes);
+
+  if (!PFileInfoCache::GetInstance().Add(m_directory))
+    cout << "File information cache not available on this system" << endl;
+  else {
+    Run("listing, cached  ", true, passes);
+    Run("lookups, cached  ", false, passes);
+    cout << "External change " << (CheckExternalChange() ? "seen" : "NOT seen") << endl;
+    PFileInfoCache::GetInstance().Remove(m_directory);
+  }
+
+  PDirectory::RemoveTree(m_directory, true);
+}
+
+
+static PInt64 ToMicroSeconds(const struct timeval & tv)
+{
+  return tv.tv_sec*1000000LL + tv.tv_usec;
+}
+
+
+void DirCache::Run(const char * name, bool listing, unsigned passes)
+{
+  PFileInfoCache::Statistics before, after;
+  PFileInfoCache::GetInstance().GetStatistics(before);
+  struct rusage usageBefore, usageAfter;
+  getrusage(RUSAGE_SELF, &usageBefore);
+  PUInt64 operations = 0;
+  PTime start;
+
+  for (unsigned pass = 0; pass < passes; ++pass) {
+    if (listing) {
+      // As PHTTPDirectory does for a directory listing
+      PFileInfo info;
+      PFile::GetInfo(m_directory, info);
+      PDirectory::Entries entries;
+      m_directory.GetEntries(entries, PDirectory::SortByName);
+      if (entries.size() != m_files.size())
+        cerr << "Expected " << m_files.size() << " entries, got " << entries.size() << endl;
+      operations += entries.size();
+    }
+    else {
+      for (size_t i = 0; i < m_files.size(); ++i) {
+        PFileInfo info;
+        if (!PFile::Exists(m_files[i]) || !PFile::GetInfo(m_files[i], info) || info.size != 1)
+          cerr << "Lookup failed for " << m_files[i] << endl;
+        if (PFile::Exists(m_missing[i]))
+          cerr << "Unexpected file " << m_missing[i] << endl;
+      }
+      operations += m_files.size()*3;
+    }
+  }
+
+  PInt64 us = std::max((PInt64)1, (PTime() - start).GetMicroSeconds());
+  getrusage(RUSAGE_SELF, &usageAfter);
+  PFileInfoCache::GetInstance().GetStatistics(after);
+
+  PInt64 userUs = ToMicroSeconds(usageAfter.ru_utime) - ToMicroSeconds(usageBefore.ru_utime);
+  PInt64 systemUs = ToMicroSeconds(usageAfter.ru_stime) - ToMicroSeconds(usageBefore.ru_stime);
+
+  cout << name << ": " << setw(7) << us/passes/1000 << " ms per pass,"
+          " " << setw(6) << setprecision(3) << (double)us*1000/operations << " ns per file,"
+          " user " << setw(6) << userUs/1000 << "ms,"
+          " system " << setw(6) << systemUs/1000 << "ms,"
+          " cache hits " << setw(8) << (after.m_hits - before.m_hits) <<
+          " misses " << setw(8) << (after.m_misses - before.m_misses) << endl;
+}
+
+
+bool DirCache::CheckExternalChange()
+{
+  // Change a file behind PTLib's back, the watcher must drop the entry
+  const PFilePath & path = m_files[0];
+  PFileInfo info;
+  PFile::GetInfo(path, info);
+
+  FILE * fp = fopen(path, "a");
+  if (fp == NULL)
+    return false;
+  fputs("more", fp);
+  fclose(fp);
+
+  for (int retry = 0; retry < 100; ++retry) {
+    if (PFile::GetInfo(path, info) && info.size == 5)
+      return true;
+    PThread::Sleep(1);
+  }
+  return false;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
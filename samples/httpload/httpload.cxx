@@ -0,0 +1,278 @@
+/*
+ * httpload.cxx
+ *
+ * Load generator for PHTTPClientPool.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/http.h>
+#include <ptclib/pzlib.h>
+
+#include <algorithm>
+
+
+/* Resource that answers with the query string of the request, followed by
+   some padding, so the client can match each response to its request.
+ */
+class EchoResource : public PHTTPString
+{
+  PCLASSINFO(EchoResource, PHTTPString)
+  public:
+    EchoResource(PINDEX padding, bool compress)
+      : PHTTPString("echo", PString::Empty(), "text/plain")
+    {
+      memset(m_padding.GetPointerAndSetLength(padding), 'x', padding);
+      SetCompression(compress, 0);
+    }
+
+    virtual PBoolean LoadHeaders(PHTTPRequest & request)
+    {
+      request.contentSize = request.GetURL().GetQuery().GetLength() + m_padding.GetLength();
+      return true;
+    }
+
+    virtual PString LoadText(PHTTPRequest & request)
+    {
+      return request.GetURL().GetQuery() + m_padding;
+    }
+
+  protected:
+    PString m_padding;
+};
+
+
+/* Listener that lets us set how many transactions the server allows on a
+   persistent connection, the default of ten defeats pipelining.
+ */
+class LoadListener : public PHTTPListener
+{
+  public:
+    LoadListener(unsigned workers, unsigned maxTransactions)
+      : PHTTPListener(workers)
+      , m_maxTransactions(maxTransactions)
+    {
+    }
+
+    virtual void OnHTTPStarted(PHTTPServer & server)
+    {
+      server.GetConnectionInfo().SetPersistenceMaximumTransations(m_maxTransactions);
+    }
+
+  protected:
+    unsigned m_maxTransactions;
+};
+
+
+class HttpLoad : public PProcess
+{
+  PCLASSINFO(HttpLoad, PProcess)
+  public:
+    HttpLoad();
+    virtual void Main();
+
+  protected:
+    void SendRequest();
+    void ReportCompression();
+    PDECLARE_HttpPoolNotifier(HttpLoad, OnResponse);
+
+    PHTTPClientPool * m_pool;
+    PURL              m_url;
+    PINDEX            m_padding;
+    PInt64            m_endTime;
+    atomic<unsigned>  m_sequence;
+    atomic<unsigned>  m_outstanding;
+    atomic<unsigned>  m_received;
+    atomic<unsigned>  m_bad;
+    PDECLARE_MUTEX(   m_mutex);
+    std::vector<unsigned> m_latencies; // microseconds
+    PSyncPoint        m_finished;
+};
+
+PCREATE_PROCESS(HttpLoad);
+
+
+HttpLoad::HttpLoad()
+  : PProcess("PTLib", "httpload")
+  , m_pool(NULL)
+  , m_padding(0)
+  , m_endTime(0)
+  , m_sequence(0)
+  , m_outstanding(0)
+  , m_received(0)
+  , m_bad(0)
+{
+}
+
+
+void HttpLoad::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("c-concurrency: Requests outstanding at once, default 64\n"
+             "n-connections: Maximum pool connections, default 128\n"
+             "P-parallel: Maximum connections per host, default 4\n"
+             "p-pipeline: Maximum requests pipelined per connection, default 8\n"
+             "e-event-threads: Event threads, zero for a thread per connection, default 1\n"
+             "2-http2. Use HTTP/2 with prior knowledge, the pipeline depth is then streams per connection\n"
+             "d-duration: Test duration in seconds, default 10\n"
+             "b-body: Padding added to each response body, default 100\n"
+             "W-workers: Local server worker threads, default 16\n"
+             "m-max-transactions: Local server transactions per connection, default 0 for no limit\n"
+             "S-serve-only. Only run the local server, for the test duration, for use by other clients\n"
+             "z-compress. Local server compresses responses with gzip, if the client accepts it\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <echo-url> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned concurrency = std::max(1U, args.GetOptionString('c', "64").AsUnsigned());
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+  m_padding = args.GetOptionString('b', "100").AsUnsigned();
+
+  // Without a URL, run our own server to talk to
+  LoadListener listener(args.GetOptionString('W', "16").AsUnsigned(), args.GetOptionString('m', "0").AsUnsigned());
+  if (args.GetCount() > 0)
+    m_url = args[0];
+  else {
+    listener.GetSpace().AddResource(new EchoResource(m_padding, args.HasOption('z')));
+    if (!listener.ListenForHTTP("127.0.0.1", 0, PSocket::CanReuseAddress, 100)) {
+      cerr << "Could not start HTTP listener" << endl;
+      return;
+    }
+    m_url = PSTRSTRM("http://127.0.0.1:" << listener.GetPort() << "/echo");
+
+    if (args.HasOption('S')) {
+      cout << "Serving " << m_url << " for " << duration << 's' << endl;
+      PThread::Sleep(duration);
+      return;
+    }
+  }
+
+  PHTTPClientPool pool(args.GetOptionString('n', "128").AsUnsigned(),
+                       args.GetOptionString('P', "4").AsUnsigned());
+  pool.SetMaxPipeline(args.GetOptionString('p', "8").AsUnsigned());
+  pool.SetEventThreads(args.GetOptionString('e', "1").AsUnsigned());
+  pool.SetHTTP2(args.HasOption('2'));
+  m_pool = &pool;
+
+  cout << "Sending " << (args.HasOption('2') ? "HTTP/2" : "HTTP/1.1") << " requests to " << m_url
+       << " with " << concurrency << " outstanding for " << duration << 's' << endl;
+
+  PTime startTime;
+  m_endTime = PTimer::Tick().GetMilliSeconds() + duration.GetMilliSeconds();
+  for (unsigned i = 0; i < concurrency; ++i)
+    SendRequest();
+
+  if (!m_finished.Wait(duration + PTimeInterval(0, 30)))
+    cerr << "Timed out waiting for " << m_outstanding << " outstanding requests" << endl;
+  PTimeInterval elapsed = PTime() - startTime;
+
+  pool.ShutDown();
+  m_pool = NULL;
+
+  std::sort(m_latencies.begin(), m_latencies.end());
+
+  cout << "Sent " << m_sequence << ", received " << m_received << ", bad " << m_bad << '\n'
+       << "Throughput: " << (PUInt64)m_received*1000/std::max((PInt64)1, elapsed.GetMilliSeconds()) << " requests/s\n";
+  if (!m_latencies.empty()) {
+    size_t count = m_latencies.size();
+    cout << "Latency: p50=" << m_latencies[count/2] << "us"
+            " p99=" << m_latencies[count*99/100] << "us"
+            " max=" << m_latencies.back() << "us\n";
+  }
+
+  if (args.HasOption('z'))
+    ReportCompression();
+
+  cout << endl;
+}
+
+
+void HttpLoad::ReportCompression()
+{
+#if P_ZLIB
+  // Cost of what each request did at each end, on a typical body
+  PString body = PSTRSTRM(m_sequence << '-' << PTime().GetTimestamp() << setw(m_padding) << setfill('x') << "");
+  static const unsigned Iterations = 1000;
+
+  PBYTEArray compressed;
+  PTime startCompress;
+  for (unsigned i = 0; i < Iterations; ++i)
+    PZLib::Compress((const char *)body, body.GetLength(), compressed);
+  PTimeInterval compressTime = PTime() - startCompress;
+
+  PBYTEArray decompressed;
+  PTime startDecompress;
+  for (unsigned i = 0; i < Iterations; ++i)
+    PZLib::Decompress(compressed, compressed.GetSize(), decompressed);
+  PTimeInterval decompressTime = PTime() - startDecompress;
+
+  cout << "Compression: " << body.GetLength() << " -> " << compressed.GetSize() << " bytes"
+          " (" << (compressed.GetSize()*100/std::max(body.GetLength(), (PINDEX)1)) << "%),"
+          " compress=" << compressTime.GetMicroSeconds()/Iterations << "us"
+          " decompress=" << decompressTime.GetMicroSeconds()/Iterations << "us\n";
+#else
+  cout << "Compression not available, zlib not present\n";
+#endif
+}
+
+
+void HttpLoad::SendRequest()
+{
+  // The query has the send time, which the echo server returns to us
+  PURL url = m_url;
+  url.SetQuery(PSTRSTRM(++m_sequence << '-' << PTime().GetTimestamp()));
+  ++m_outstanding;
+  m_pool->QueueRequest(PHTTPClientPool::Request(PHTTP::GET, url, PCREATE_NOTIFIER(OnResponse)));
+}
+
+
+void HttpLoad::OnResponse(PHTTPClientPool &, PHTTPClientPool::Response response)
+{
+  PInt64 receiveTime = PTime().GetTimestamp();
+
+  const char * body = response.m_body;
+  PINDEX length = response.m_body.GetLength();
+  const char * dash = (const char *)memchr(body, '-', length);
+  if (response.m_code != PHTTP::RequestOK || dash == NULL || length < m_padding) {
+    PTRACE(2, "Bad response: code=" << response.m_code << " size=" << length);
+    ++m_bad;
+  }
+  else {
+    PInt64 sendTime = PString(dash+1, length - m_padding - (dash+1-body)).AsInt64();
+    PWaitAndSignal lock(m_mutex);
+    m_latencies.push_back((unsigned)(receiveTime - sendTime));
+    ++m_received;
+  }
+
+  if (PTimer::Tick().GetMilliSeconds() < m_endTime)
+    SendRequest();
+
+  if (--m_outstanding == 0)
+    m_finished.Signal();
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
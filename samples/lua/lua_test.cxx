@@ -37,6 +37,13 @@ class MyProcess : public PProcess
     void Main();
 #if P_LUA
     PDECLARE_ScriptFunctionNotifier(MyProcess, TestFunction);
+    void TestCompiledAfterCall();
+    void Benchmark(unsigned iterations, unsigned threads);
+    void BenchmarkThread(unsigned iterations);
+
+    PLua        * m_benchShared;
+    PScriptPool * m_benchPool;
+    PScriptLanguage::Handle m_benchId, m_benchRoute, m_benchResult;
 #endif
 };
 
@@ -88,6 +95,8 @@ void MyProcess::Main()
 
   PArgList & args = GetArguments();
   args.Parse("T-test:"
+             "b-benchmark:"
+             "j-threads:"
 #if PTRACING
              "o-output:"
              "t-trace."
@@ -100,6 +109,11 @@ void MyProcess::Main()
          PTrace::Blocks | PTrace::Timestamp | PTrace::Thread | PTrace::FileAndLine);
 #endif
 
+  if (args.HasOption('b')) {
+    Benchmark(args.GetOptionString('b').AsUnsigned(), std::max(1U, args.GetOptionString('j', "4").AsUnsigned()));
+    return;
+  }
+
   PLua lua;
   if (!lua.SetFunction(LUA_TO_C_FUNCTION, PCREATE_NOTIFIER(TestFunction))) {
     cerr << lua.GetLastErrorText() << endl;
@@ -150,6 +164,8 @@ void MyProcess::Main()
     }
     else
       cerr << lua.GetLastErrorText() << " executing script" << endl;
+
+    TestCompiledAfterCall();
   }
   else {
     for (PINDEX arg = 0; arg < args.GetCount(); ++arg) {
@@ -162,6 +178,177 @@ void MyProcess::Main()
 }
 
 
+/* A function may replace the table a compiled name is in, the handle must
+   then use the new table, not the one it found before the call. */
+const char ReassignScript[] =
+  "call = { id = 1 }\n"
+  "function new_call(id)\n"
+  "  call = { id = id }\n"
+  "end\n";
+
+
+void MyProcess::TestCompiledAfterCall()
+{
+  PLua lua;
+  if (!lua.Run(ReassignScript)) {
+    cerr << lua.GetLastErrorText() << " executing reassign script" << endl;
+    return;
+  }
+
+  PScriptLanguage::Handle id = lua.CompileName("call.id");
+  PScriptLanguage::Handle newCall = lua.CompileName("new_call");
+
+  PVarType value;
+  if (!lua.GetVar(id, value) || value.AsInteger() != 1) {
+    cerr << "Compiled name call.id is " << value << ", expected 1" << endl;
+    return;
+  }
+
+  PScriptLanguage::Signature sig;
+  sig.m_arguments.push_back(PVarType(2));
+  if (!lua.Call(newCall, sig) || !lua.GetVar(id, value) || value.AsInteger() != 2) {
+    cerr << "Compiled name call.id is " << value << " after call by handle, expected 2" << endl;
+    return;
+  }
+
+  if (!lua.Call("new_call", "i", 3) || !lua.GetVar(id, value) || value.AsInteger() != 3) {
+    cerr << "Compiled name call.id is " << value << " after call by name, expected 3" << endl;
+    return;
+  }
+
+  if (!lua.SetVar(id, PVarType(4)) || lua.GetInteger("call.id") != 4) {
+    cerr << "Setting compiled name call.id did not change the current table" << endl;
+    return;
+  }
+
+  cout << "Compiled names follow tables replaced by functions" << endl;
+}
+
+
+/* What a per-call routing script typically does: set some information about
+   the call, run a function, and get the result back. */
+const char BenchScript[] =
+  "call = { id = 0, route = '' }\n"
+  "function route(prefix)\n"
+  "  call.route = prefix .. call.id .. '@example.com'\n"
+  "  return call.route\n"
+  "end\n";
+
+
+static bool BenchByName(PScriptLanguage & script, unsigned id)
+{
+  PScriptLanguage::Signature sig;
+  sig.m_arguments.push_back(PVarType("sip:"));
+  return script.SetInteger("call.id", id) && script.Call("route", sig) && !script.GetString("call.route").IsEmpty();
+}
+
+
+static bool BenchByHandle(PScriptLanguage & script, unsigned id,
+                          const PScriptLanguage::Handle & idHandle,
+                          const PScriptLanguage::Handle & routeHandle,
+                          const PScriptLanguage::Handle & resultHandle)
+{
+  PScriptLanguage::Signature sig;
+  sig.m_arguments.push_back(PVarType("sip:"));
+  PVarType result;
+  return script.SetVar(idHandle, PVarType(id)) && script.Call(routeHandle, sig) &&
+         script.GetVar(resultHandle, result) && !result.AsString().IsEmpty();
+}
+
+
+static void BenchReport(const char * test, unsigned calls, const PTime & start)
+{
+  PInt64 ms = std::max((PInt64)1, (PTime() - start).GetMilliSeconds());
+  cout << setw(40) << left << test << right << setw(10) << (PUInt64)calls*1000/ms << " calls/s" << endl;
+}
+
+
+void MyProcess::Benchmark(unsigned iterations, unsigned threads)
+{
+  cout << "Benchmarking " << iterations << " calls, " << threads << " threads" << endl;
+
+  {
+    PLua lua;
+    if (!lua.Run(BenchScript)) {
+      cerr << lua.GetLastErrorText() << endl;
+      return;
+    }
+
+    PTime start;
+    for (unsigned i = 0; i < iterations; ++i) {
+      if (!BenchByName(lua, i)) {
+        cerr << lua.GetLastErrorText() << endl;
+        return;
+      }
+    }
+    BenchReport("Variables by name", iterations, start);
+
+    PScriptLanguage::Handle id = lua.CompileName("call.id");
+    PScriptLanguage::Handle route = lua.CompileName("route");
+    PScriptLanguage::Handle result = lua.CompileName("call.route");
+    start.SetCurrentTime();
+    for (unsigned i = 0; i < iterations; ++i) {
+      if (!BenchByHandle(lua, i, id, route, result)) {
+        cerr << lua.GetLastErrorText() << endl;
+        return;
+      }
+    }
+    BenchReport("Variables by handle", iterations, start);
+  }
+
+  // An interpreter created for every call, which needs the script loading
+  unsigned creations = std::max(1U, iterations/100);
+  for (int cached = 0; cached < 2; ++cached) {
+    PLua::SetBytecodeCacheSize(cached ? 100 : 0);
+    PTime start;
+    for (unsigned i = 0; i < creations; ++i) {
+      PLua lua;
+      if (!lua.Run(BenchScript) || !BenchByName(lua, i)) {
+        cerr << lua.GetLastErrorText() << endl;
+        return;
+      }
+    }
+    BenchReport(cached ? "New interpreter, bytecode cached" : "New interpreter, script parsed", creations, start);
+  }
+
+  // Concurrent calls, all on one interpreter, or each from a pool
+  PLua shared;
+  shared.Run(BenchScript);
+  PScriptPool pool(PLua::LanguageName(), BenchScript, threads);
+  pool.Preload(threads);
+  m_benchId = pool.CompileName("call.id");
+  m_benchRoute = pool.CompileName("route");
+  m_benchResult = pool.CompileName("call.route");
+
+  for (int pooled = 0; pooled < 2; ++pooled) {
+    m_benchShared = pooled ? NULL : &shared;
+    m_benchPool = pooled ? &pool : NULL;
+
+    std::vector<PThread *> workers(threads);
+    PTime start;
+    for (unsigned t = 0; t < threads; ++t)
+      workers[t] = new PThreadObj1Arg<MyProcess, unsigned>(*this, iterations/threads, &MyProcess::BenchmarkThread, false, "Bench");
+    for (unsigned t = 0; t < threads; ++t)
+      PThread::WaitAndDelete(workers[t]);
+    BenchReport(pooled ? "Threads with pooled interpreters" : "Threads sharing one interpreter", iterations/threads*threads, start);
+  }
+}
+
+
+void MyProcess::BenchmarkThread(unsigned iterations)
+{
+  for (unsigned i = 0; i < iterations; ++i) {
+    if (m_benchShared != NULL)
+      BenchByName(*m_benchShared, i);
+    else {
+      PScriptPool::Instance script(*m_benchPool);
+      if (script.IsValid())
+        BenchByHandle(*script, i, m_benchId, m_benchRoute, m_benchResult);
+    }
+  }
+}
+
+
 static void TestOutput(const PLua::Signature & sig)
 {
   cout << " nargs=" << sig.m_arguments.size() << ", ";
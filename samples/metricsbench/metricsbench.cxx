@@ -0,0 +1,165 @@
+/*
+ * metricsbench.cxx
+ *
+ * Benchmark for the cost of updating PMetric counters, gauges and histograms.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/metrics.h>
+#include <ptclib/http.h>
+
+#include <algorithm>
+
+
+static PMetricCounter   s_counter  ("metricsbench_counter_total", "Counter incremented by the benchmark");
+static PMetricGauge     s_gauge    ("metricsbench_gauge", "Gauge incremented by the benchmark");
+static PMetricHistogram s_histogram("metricsbench_values", "Values recorded by the benchmark", NULL, 1, 0, 20);
+static atomic<PUInt64>  s_shared(0);
+
+
+class MetricsBench : public PProcess
+{
+  PCLASSINFO(MetricsBench, PProcess)
+  public:
+    MetricsBench();
+    virtual void Main();
+
+  protected:
+    enum Tests { SharedAtomic, Counter, Gauge, Histogram, NumTests };
+    void Run(Tests test);
+    void ThreadMain(Tests test);
+    void Scrape();
+
+    unsigned m_threads;
+    unsigned m_iterations;
+};
+
+PCREATE_PROCESS(MetricsBench);
+
+
+MetricsBench::MetricsBench()
+  : PProcess("PTLib", "metricsbench")
+  , m_threads(4)
+  , m_iterations(10000000)
+{
+}
+
+
+void MetricsBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("T-threads: Number of threads updating, default 4\n"
+             "n-iterations: Updates per thread, default 10000000\n"
+             "s-scrape. Fetch the metrics via HTTP afterwards and output them\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_threads = std::max(1U, args.GetOptionString('T', "4").AsUnsigned());
+  m_iterations = std::max(1U, args.GetOptionString('n', "10000000").AsUnsigned());
+
+  cout << "Updating with " << m_threads << " threads, " << m_iterations << " times each" << endl;
+  for (int test = 0; test < NumTests; ++test)
+    Run((Tests)test);
+
+  if (args.HasOption('s'))
+    Scrape();
+}
+
+
+void MetricsBench::Run(Tests test)
+{
+  static const char * const Names[NumTests] = { "shared atomic  ", "counter        ", "gauge          ", "histogram      " };
+
+  std::vector<PThread *> threads(m_threads);
+  PTime startTime;
+  for (unsigned i = 0; i < m_threads; ++i)
+    threads[i] = new PThreadObj1Arg<MetricsBench, Tests>(*this, test, &MetricsBench::ThreadMain, false, "Update");
+  for (unsigned i = 0; i < m_threads; ++i)
+    PThread::WaitAndDelete(threads[i]);
+  PInt64 ns = (PTime() - startTime).GetNanoSeconds();
+
+  /* CPU time per update, so it is the same as one thread if they do not
+     contend, allowing for there being fewer CPUs than threads. */
+  unsigned cpus = std::min(m_threads, PThread::GetNumProcessors());
+  cout << Names[test] << setw(8) << std::fixed << std::setprecision(2)
+       << (double)ns*cpus/m_threads/m_iterations << " ns/update" << endl;
+}
+
+
+void MetricsBench::ThreadMain(Tests test)
+{
+  switch (test) {
+    case SharedAtomic :
+      for (unsigned i = 0; i < m_iterations; ++i)
+        ++s_shared;
+      break;
+
+    case Counter :
+      for (unsigned i = 0; i < m_iterations; ++i)
+        s_counter.Inc();
+      break;
+
+    case Gauge :
+      for (unsigned i = 0; i < m_iterations; ++i)
+        s_gauge.Inc();
+      break;
+
+    case Histogram :
+      for (unsigned i = 0; i < m_iterations; ++i)
+        s_histogram.Record(i & 0xfffff);
+      break;
+
+    default :
+      break;
+  }
+}
+
+
+void MetricsBench::Scrape()
+{
+  PHTTPListener listener;
+  listener.GetSpace().AddResource(new PHTTPMetrics);
+  if (!listener.ListenForHTTP("127.0.0.1", 0)) {
+    cerr << "Could not start HTTP listener" << endl;
+    return;
+  }
+
+  PHTTPClient client;
+  PString text;
+  if (client.GetTextDocument(PSTRSTRM("http://127.0.0.1:" << listener.GetPort() << "/metrics"), text))
+    cout << text << endl;
+  else
+    cerr << "Could not get metrics: " << client.GetErrorText() << endl;
+
+  cout << "Counter=" << s_counter.GetValue()
+       << " histogram count=" << s_histogram.GetCount()
+       << " median=" << s_histogram.GetPercentile(0.5)
+       << " 99%=" << s_histogram.GetPercentile(0.99) << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
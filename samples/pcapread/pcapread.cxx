@@ -0,0 +1,164 @@
+/*
+ * pcapread.cxx
+ *
+ * Benchmark for reading capture files with PEthCaptureFile and decoding
+ * the frames to UDP payloads.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/ethsock.h>
+
+#include <algorithm>
+
+
+class PCAPRead : public PProcess
+{
+  PCLASSINFO(PCAPRead, PProcess)
+  public:
+    PCAPRead();
+    virtual void Main();
+
+  protected:
+    bool Generate(const PFilePath & filename, PEthCaptureFile::Formats format, unsigned megabytes);
+    void Run(const PFilePath & filename, const char * name, PINDEX batch, unsigned decodes);
+};
+
+PCREATE_PROCESS(PCAPRead);
+
+
+PCAPRead::PCAPRead()
+  : PProcess("PTLib", "pcapread")
+{
+}
+
+
+void PCAPRead::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("m-megabytes: Size of capture file to generate, default 256\n"
+             "n-pcapng. Generate pcapng format rather than pcap\n"
+             "k-keep. Use existing file, do not generate it\n"
+             "b-batch: Frames per batch read, default 64\n"
+             "r-repeat: Number of passes of each read method, default 3\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <file.pcap> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  PFilePath filename = args.GetCount() > 0 ? args[0] : PString(args.HasOption('n') ? "pcapread.pcapng" : "pcapread.pcap");
+  if (!args.HasOption('k') && !Generate(filename,
+                                        args.HasOption('n') ? PEthCaptureFile::FormatPcapNG : PEthCaptureFile::FormatPcap,
+                                        std::max(1U, args.GetOptionString('m', "256").AsUnsigned())))
+    return;
+
+  PINDEX batch = std::max(1U, args.GetOptionString('b', "64").AsUnsigned());
+  unsigned repeat = std::max(1U, args.GetOptionString('r', "3").AsUnsigned());
+  for (unsigned i = 0; i < repeat; ++i) {
+    Run(filename, "single, decode once ", 1,     1);
+    Run(filename, "batch, decode once  ", batch, 1);
+    Run(filename, "batch, decode twice ", batch, 2);
+  }
+
+  if (!args.HasOption('k'))
+    PFile::Remove(filename);
+}
+
+
+bool PCAPRead::Generate(const PFilePath & filename, PEthCaptureFile::Formats format, unsigned megabytes)
+{
+  PEthCaptureFile file;
+  if (!file.Open(filename, PFile::WriteOnly, format)) {
+    cerr << "Could not create " << filename << ": " << file.GetFile().GetErrorText() << endl;
+    return false;
+  }
+
+  // RTP sized packets, G.711 20ms at 50 packets per second
+  static const PINDEX PayloadSize = 172;
+  PIPSocketAddressAndPort src("192.168.1.1:5000"), dst("192.168.1.2:6000");
+  PEthSocket::Frame frame;
+  PTime timestamp;
+
+  PUInt64 bytes = (PUInt64)megabytes*1000000;
+  PUInt64 written = 0;
+  while (written < bytes) {
+    BYTE * payload = frame.CreateUDP(src, dst, PayloadSize);
+    for (PINDEX i = 0; i < PayloadSize; ++i)
+      payload[i] = (BYTE)(i + file.GetFrameCount());
+
+    timestamp += 20;
+    frame.SetTimestamp(timestamp);
+    if (!file.WriteFrame(frame)) {
+      cerr << "Could not write " << filename << ": " << file.GetFile().GetErrorText() << endl;
+      return false;
+    }
+    written += frame.GetSize() + 16;
+  }
+
+  cout << "Generated " << filename << ", " << file.GetFrameCount() << " frames" << endl;
+  return file.Close();
+}
+
+
+void PCAPRead::Run(const PFilePath & filename, const char * name, PINDEX batch, unsigned decodes)
+{
+  PEthCaptureFile file;
+  if (!file.Open(filename)) {
+    cerr << "Could not open " << filename << ": " << file.GetFile().GetErrorText() << endl;
+    return;
+  }
+
+  std::vector<PEthSocket::Frame> frames(batch);
+  PBYTEArray payload;
+  PIPSocketAddressAndPort src, dst;
+  PUInt64 count = 0;
+  PUInt64 bytes = 0;
+  unsigned checksum = 0;
+
+  PTime startTime;
+  PINDEX got;
+  while ((got = file.ReadFrames(&frames[0], batch)) > 0) {
+    for (PINDEX i = 0; i < got; ++i) {
+      /* A dissector will often ask for the IP layer to filter on address,
+         then for the UDP layer, which then does not decode the IP again. */
+      for (unsigned d = 0; d < decodes; ++d) {
+        if (frames[i].GetUDP(payload, src, dst)) {
+          checksum += payload[0];
+          bytes += payload.GetSize();
+        }
+      }
+      ++count;
+    }
+  }
+  PInt64 us = std::max((PInt64)1, (PTime() - startTime).GetMicroSeconds());
+
+  cout << name << setw(9) << count << " frames "
+       << setw(9) << count*1000000/us << " frames/s "
+       << setw(5) << bytes/us << " MB/s payload"
+          "  checksum=" << checksum << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,176 @@
+/*
+ * plugincache.cxx
+ *
+ * Test for plugins deferred by the plugin manifest.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/pluginmgr.h>
+#include <ptclib/pnat.h>
+
+
+#define TEST_NAT_NAME     "TestNat"
+#define TEST_NAT_FRIENDLY "Test NAT from manifest"
+
+
+/* The NAT method the fake plugin would provide. It is registered with the
+   factory at run time, as the shared object itself would when loaded, static
+   registration would make the manager find it at start up instead. */
+class PNatMethod_TestNat : public PNatMethod_Fixed
+{
+  PCLASSINFO(PNatMethod_TestNat, PNatMethod_Fixed);
+  public:
+    virtual PCaselessString GetMethodName() const { return TEST_NAT_NAME; }
+};
+
+
+class TestNatDescriptor : public PPlugin_PNatMethod
+{
+  public:
+    virtual const char * GetServiceName() const { return TEST_NAT_NAME; }
+    virtual const char * GetFriendlyName() const { return "Test NAT from plugin"; }
+    virtual PObject * CreateInstance(P_INT_PTR) const { return new PNatMethod_TestNat; }
+};
+
+
+class PluginCache : public PProcess
+{
+  PCLASSINFO(PluginCache, PProcess)
+  public:
+    PluginCache();
+    virtual void Main();
+
+    void Check(bool ok, const char * what);
+    void CreateConcurrently();
+
+    unsigned m_failures;
+    PAtomicInteger m_created;
+};
+
+PCREATE_PROCESS(PluginCache);
+
+
+PluginCache::PluginCache()
+  : PProcess("PTLib", "plugincache")
+  , m_failures(0)
+{
+}
+
+
+void PluginCache::Check(bool ok, const char * what)
+{
+  cout << (ok ? "ok   " : "FAIL ") << what << endl;
+  if (!ok)
+    ++m_failures;
+}
+
+
+void PluginCache::CreateConcurrently()
+{
+  PNatMethod * method = PNatMethod::Create(TEST_NAT_NAME);
+  if (method != NULL)
+    ++m_created;
+  delete method;
+}
+
+
+void PluginCache::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse(PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  PDirectory directory = PDirectory::GetTemporary() + PSTRSTRM("plugincache." << GetProcessID());
+  if (!directory.Create(PFileInfo::DefaultDirPerms, true)) {
+    cerr << "Could not create " << directory << endl;
+    return;
+  }
+
+  // Not a real shared object, loading it fails and the factory entry registered below stands in
+  PFilePath pluginFile = directory + "testnat_ptplugin" + PDynaLink::GetExtension();
+  PFile(pluginFile, PFile::WriteOnly).WriteString("not a plugin");
+  PFileInfo info;
+  PFile::GetInfo(pluginFile, info);
+
+  PFilePath goneFile = directory + "gone_ptplugin" + PDynaLink::GetExtension();
+  PFilePath otherFile = "/nonexistent/other_ptplugin" + PDynaLink::GetExtension();
+
+  PFilePath manifestFile = directory + "manifest";
+  {
+    PTextFile manifest(manifestFile, PFile::WriteOnly);
+    manifest << "PTLib plugin manifest 1\n"
+                "plugin\t" << pluginFile << '\t' << info.modified.GetTimeInSeconds() << '\t' << info.size << "\n"
+                "service\tPNatMethod" TEST_NAT_NAME "\tPNatMethod\t" TEST_NAT_NAME "\t" TEST_NAT_FRIENDLY "\t0\n"
+                "plugin\t" << goneFile << "\t1\t1\n"
+                "service\tPNatMethodGone\tPNatMethod\tGone\tGone\t0\n"
+                "plugin\t" << otherFile << "\t1\t1\n"
+                "service\tPNatMethodOther\tPNatMethod\tOther\tOther\t0\n";
+  }
+
+  PPluginManager & manager = PPluginManager::GetPluginManager();
+  manager.SetManifestFile(manifestFile);
+  manager.SetDirectories(directory);
+  manager.LoadDirectories();
+
+  PTextFile manifest(manifestFile, PFile::ReadOnly);
+  PString content = manifest.ReadString(P_MAX_INDEX);
+  Check(content.Find(pluginFile) != P_MAX_INDEX, "plugin kept in manifest");
+  Check(content.Find(goneFile) == P_MAX_INDEX, "missing plugin in searched directory pruned from manifest");
+  Check(content.Find(otherFile) != P_MAX_INDEX, "plugin in another directory kept in manifest");
+
+  Check(PPluginFactory::CreateInstance("PNatMethod" TEST_NAT_NAME) == NULL, "plugin not loaded at start up");
+  Check(manager.GetPluginsProviding(PPlugin_PNatMethod::ServiceType(), false).GetValuesIndex(PString(TEST_NAT_NAME)) != P_MAX_INDEX, "deferred method listed");
+
+  const PPluginServiceDescriptor * descriptor = manager.GetServiceDescriptor(TEST_NAT_NAME, PPlugin_PNatMethod::ServiceType());
+  Check(descriptor != NULL && PString(descriptor->GetFriendlyName()) == TEST_NAT_FRIENDLY, "friendly name from manifest");
+
+  // What the plugin would register when it is loaded
+  PPluginFactory::Register("PNatMethod" TEST_NAT_NAME, new TestNatDescriptor);
+
+  PThread * threads[4];
+  for (PINDEX i = 0; i < PARRAYSIZE(threads); ++i)
+    threads[i] = new PThreadObj<PluginCache>(*this, &PluginCache::CreateConcurrently, false);
+  for (PINDEX i = 0; i < PARRAYSIZE(threads); ++i) {
+    threads[i]->WaitForTermination();
+    delete threads[i];
+  }
+  Check(m_created == (int)PARRAYSIZE(threads), "concurrent creation loads deferred plugin once for all");
+
+  PNatMethod * method = PNatMethod::Create(TEST_NAT_NAME);
+  Check(dynamic_cast<PNatMethod_TestNat *>(method) != NULL, "deferred method created");
+  Check(method != NULL && method->GetFriendlyName() == TEST_NAT_FRIENDLY, "friendly name of instance via plugin manager");
+  delete method;
+
+  PDirectory::RemoveTree(directory, true);
+
+  cout << (m_failures == 0 ? "All tests passed" : "Tests FAILED") << endl;
+  SetTerminationValue(m_failures == 0 ? 0 : 1);
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,180 @@
+/*
+ * spawnbench.cxx
+ *
+ * Benchmark for starting sub-processes with PPipeChannel from a large
+ * process, and reading the output of many of them from one thread.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/pipechan.h>
+
+#include <algorithm>
+#include <sys/wait.h>
+
+
+class SpawnBench : public PProcess
+{
+  PCLASSINFO(SpawnBench, PProcess)
+  public:
+    SpawnBench();
+    virtual void Main();
+
+  protected:
+    void Latency(unsigned count, bool usefork);
+    void Throughput(unsigned children, unsigned megabytes);
+};
+
+PCREATE_PROCESS(SpawnBench);
+
+
+SpawnBench::SpawnBench()
+  : PProcess("PTLib", "spawnbench")
+{
+}
+
+
+void SpawnBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("m-megabytes: Resident memory to touch before starting children, default 4096\n"
+             "n-count: Number of children started for latency, default 200\n"
+             "c-children: Number of concurrent children for throughput, default 100\n"
+             "s-size: Megabytes output by each concurrent child, default 20\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  /* Make this a large process, a fork() has to copy the page tables for all
+     of this, which is what makes it slow. */
+  size_t bytes = (size_t)args.GetOptionString('m', "4096").AsUnsigned()*1024*1024;
+  char * memory = (char *)malloc(bytes);
+  if (memory == NULL) {
+    cerr << "Could not allocate " << bytes << " bytes" << endl;
+    return;
+  }
+  for (size_t i = 0; i < bytes; i += 4096)
+    memory[i] = (char)i;
+  cout << "Resident memory " << bytes/1024/1024 << "MB" << endl;
+
+  unsigned count = std::max(1U, args.GetOptionString('n', "200").AsUnsigned());
+  Latency(count, false);
+  Latency(count, true);
+
+  Throughput(std::max(1U, args.GetOptionString('c', "100").AsUnsigned()),
+             std::max(1U, args.GetOptionString('s', "20").AsUnsigned()));
+
+  free(memory);
+}
+
+
+void SpawnBench::Latency(unsigned count, bool usefork)
+{
+  PTimeInterval total, longest;
+  for (unsigned i = 0; i < count; ++i) {
+    PTime start;
+    if (usefork) {
+      // What PPipeChannel would be doing without posix_spawn() or vfork()
+      pid_t pid = fork();
+      if (pid == 0) {
+        execl("/bin/true", "true", (char *)NULL);
+        _exit(1);
+      }
+      PTimeInterval elapsed = PTime() - start;
+      total += elapsed;
+      longest = std::max(longest, elapsed);
+      int status;
+      waitpid(pid, &status, 0);
+    }
+    else {
+      PPipeChannel pipe;
+      if (!pipe.Open("/bin/true", PPipeChannel::ReadOnly, false)) {
+        cerr << "Could not start /bin/true: " << pipe.GetErrorText() << endl;
+        return;
+      }
+      PTimeInterval elapsed = PTime() - start;
+      total += elapsed;
+      longest = std::max(longest, elapsed);
+      pipe.WaitForTermination();
+    }
+  }
+
+  cout << (usefork ? "fork()+exec  " : "PPipeChannel ")
+       << " start average " << setw(7) << total.GetMicroSeconds()/count << "us"
+          " longest " << setw(7) << longest.GetMicroSeconds() << "us" << endl;
+}
+
+
+void SpawnBench::Throughput(unsigned children, unsigned megabytes)
+{
+  PString command = PSTRSTRM("head -c " << megabytes << "M /dev/zero");
+
+  std::vector<PPipeChannel *> pipes(children);
+  PPipeChannel::SelectList running;
+  PTime start;
+  for (unsigned i = 0; i < children; ++i) {
+    pipes[i] = new PPipeChannel;
+    if (!pipes[i]->Open(command, PPipeChannel::ReadOnly)) {
+      cerr << "Could not start " << command << ": " << pipes[i]->GetErrorText() << endl;
+      return;
+    }
+    pipes[i]->SetReadTimeout(0);
+    running += *pipes[i];
+  }
+
+  // All the output is read by this one thread
+  PBYTEArray buffer(65536);
+  PUInt64 total = 0;
+  while (!running.IsEmpty()) {
+    PPipeChannel::SelectList ready;
+    for (PPipeChannel::SelectList::iterator it = running.begin(); it != running.end(); ++it)
+      ready += *it;
+    if (PPipeChannel::Select(ready, 1000) != PChannel::NoError) {
+      cerr << "Select failed" << endl;
+      break;
+    }
+
+    for (PPipeChannel::SelectList::iterator it = ready.begin(); it != ready.end(); ++it) {
+      if (it->Read(buffer.GetPointer(), buffer.GetSize()))
+        total += it->GetLastReadCount();
+      else if (it->GetErrorCode(PChannel::LastReadError) != PChannel::Timeout)
+        running -= *it; // End of file, or error
+    }
+  }
+  PInt64 us = std::max((PInt64)1, (PTime() - start).GetMicroSeconds());
+
+  for (unsigned i = 0; i < children; ++i) {
+    pipes[i]->WaitForTermination();
+    delete pipes[i];
+  }
+
+  cout << children << " children, one reader thread: "
+       << total/1000000 << "MB in " << us/1000 << "ms, "
+       << total/us << " MB/s" << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,249 @@
+/*
+ * stunload.cxx
+ *
+ * Load generator for STUN servers.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/pstunsrvr.h>
+
+#include <algorithm>
+
+
+class StunLoad : public PProcess
+{
+  PCLASSINFO(StunLoad, PProcess)
+  public:
+    StunLoad();
+    virtual void Main();
+
+  protected:
+    struct Client {
+      Client() : m_sent(0), m_received(0), m_lost(0), m_bad(0) { }
+      std::vector<unsigned> m_latencies; // microseconds
+      unsigned m_sent;
+      unsigned m_received;
+      unsigned m_lost;
+      unsigned m_bad;
+    };
+    void ClientMain(Client & client, unsigned index);
+
+    PIPSocketAddressAndPort m_server;
+    PString    m_userName;
+    PBYTEArray m_password;
+    unsigned   m_window;
+    PTime      m_endTime;
+};
+
+PCREATE_PROCESS(StunLoad);
+
+
+StunLoad::StunLoad()
+  : PProcess("PTLib", "stunload")
+  , m_window(8)
+{
+}
+
+
+void StunLoad::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("c-clients: Number of client threads, default 2\n"
+             "w-window: Outstanding requests per client, default 8\n"
+             "d-duration: Test duration in seconds, default 10\n"
+             "s-server: Also run an in process server with this many workers\n"
+             "S-slow. Disable the in process server fast path\n"
+             "u-username: Short term credentials user name\n"
+             "p-password: Short term credentials password\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <stun-server> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned clientCount = args.GetOptionString('c', "2").AsUnsigned();
+  m_window = std::max(1U, args.GetOptionString('w', "8").AsUnsigned());
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+  m_userName = args.GetOptionString('u');
+  if (args.HasOption('p')) {
+    PString password = args.GetOptionString('p');
+    m_password = PBYTEArray((const BYTE *)(const char *)password, password.GetLength());
+  }
+
+  m_server = PIPSocketAddressAndPort(PIPSocket::Address::GetLoopback(4), PSTUNServer::DefaultPort);
+  if (args.GetCount() > 0)
+    m_server.Parse(args[0], PSTUNServer::DefaultPort);
+
+  PSTUNServer server;
+  if (args.HasOption('s')) {
+    server.SetCredentials(m_userName, args.GetOptionString('p'), PString::Empty());
+    server.SetWorkerFastPath(!args.HasOption('S'));
+    if (!server.StartWorkers(m_server, args.GetOptionString('s').AsUnsigned())) {
+      cerr << "Could not start server workers on " << m_server << endl;
+      return;
+    }
+  }
+
+  cout << "Sending binding requests to " << m_server << " from "
+       << clientCount << " clients with " << m_window << " outstanding each for " << duration << 's' << endl;
+
+  std::vector<Client> clients(clientCount);
+  std::vector<PThread *> threads(clientCount);
+
+  PTime startTime;
+  m_endTime = startTime + duration;
+  for (unsigned i = 0; i < clientCount; ++i)
+    threads[i] = new PThreadObj2Arg<StunLoad, Client &, unsigned>(*this, clients[i], i, &StunLoad::ClientMain, false, "Client");
+  for (unsigned i = 0; i < clientCount; ++i)
+    PThread::WaitAndDelete(threads[i]);
+  PTimeInterval elapsed = PTime() - startTime;
+
+  Client total;
+  for (unsigned i = 0; i < clientCount; ++i) {
+    total.m_sent += clients[i].m_sent;
+    total.m_received += clients[i].m_received;
+    total.m_lost += clients[i].m_lost;
+    total.m_bad += clients[i].m_bad;
+    total.m_latencies.insert(total.m_latencies.end(), clients[i].m_latencies.begin(), clients[i].m_latencies.end());
+  }
+  std::sort(total.m_latencies.begin(), total.m_latencies.end());
+
+  cout << "Sent " << total.m_sent << ", received " << total.m_received
+       << ", lost " << total.m_lost << ", bad " << total.m_bad << '\n'
+       << "Throughput: " << (PUInt64)total.m_received*1000/std::max((PInt64)1, elapsed.GetMilliSeconds()) << " requests/s\n";
+
+  if (!total.m_latencies.empty()) {
+    size_t count = total.m_latencies.size();
+    cout << "Latency: p50=" << total.m_latencies[count/2] << "us"
+            " p99=" << total.m_latencies[count*99/100] << "us"
+            " max=" << total.m_latencies.back() << "us\n";
+  }
+  cout << endl;
+
+  if (server.HasWorkers())
+    cout << "Server received " << server.GetWorkerRequestCount() << " requests" << endl;
+}
+
+
+void StunLoad::ClientMain(Client & client, unsigned index)
+{
+  PUDPSocket socket;
+  if (!socket.Listen(m_server.GetAddress().IsLoopback() ? m_server.GetAddress() : PIPSocket::GetDefaultIpAny())) {
+    cerr << "Client " << index << " could not open socket" << endl;
+    return;
+  }
+  socket.SetSendAddress(m_server);
+  socket.SetReadTimeout(1000);
+
+  /* Each slot in the window has its own request, the transaction ID being
+     the client index, the slot and a sequence number for the slot. */
+  std::vector<PSTUNMessage> requests;
+  std::vector<PInt64> sendTimes(m_window);
+  std::vector<DWORD> sequence(m_window);
+  client.m_latencies.reserve(100000);
+
+  PIPSocketAddressAndPort localAddress;
+  socket.GetLocalAddress(localAddress);
+
+  for (unsigned slot = 0; slot < m_window; ++slot) {
+    PSTUNMessage request(PSTUNMessage::BindingRequest);
+    if (!m_userName.IsEmpty())
+      request.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::USERNAME, m_userName));
+    requests.push_back(request);
+    requests.back().MakeUnique();
+  }
+
+  unsigned outstanding = 0;
+  for (unsigned slot = 0; slot < m_window; ++slot) {
+    BYTE * id = (BYTE *)requests[slot]->transactionId;
+    *(PUInt32b *)(id+4) = index;
+    *(PUInt32b *)(id+8) = slot;
+    *(PUInt32b *)(id+12) = sequence[slot];
+#if P_SSL
+    requests[slot].AddMessageIntegrity(m_password);
+#endif
+    requests[slot].AddFingerprint();
+    sendTimes[slot] = PTime().GetTimestamp();
+    if (requests[slot].Write(socket)) {
+      ++client.m_sent;
+      ++outstanding;
+    }
+  }
+
+  PSTUNMessage response;
+  while (outstanding > 0) {
+    if (!response.Read(socket)) {
+      // Timed out, everything still outstanding is lost
+      client.m_lost += outstanding;
+      break;
+    }
+
+    PInt64 receiveTime = PTime().GetTimestamp();
+
+    const BYTE * id = response->transactionId;
+    unsigned slot = *(const PUInt32b *)(id+8);
+    if (*(const PUInt32b *)(id+4) != index || slot >= m_window || *(const PUInt32b *)(id+12) != sequence[slot]) {
+      ++client.m_bad;
+      continue;
+    }
+
+    PSTUNAddressAttribute * mapped = response.FindAttributeAs<PSTUNAddressAttribute>(PSTUNAttribute::XOR_MAPPED_ADDRESS);
+    PIPSocketAddressAndPort mappedAddress;
+    if (mapped != NULL)
+      mappedAddress = PIPSocketAddressAndPort(mapped->GetIP(), mapped->GetPort());
+    if (response.GetType() != PSTUNMessage::BindingResponse ||
+        !response.CheckFingerprint(true) ||
+#if P_SSL
+        response.CheckMessageIntegrity(m_password) != 0 ||
+#endif
+        mapped == NULL ||
+        mappedAddress != localAddress)
+      ++client.m_bad;
+    else {
+      ++client.m_received;
+      client.m_latencies.push_back((unsigned)(receiveTime - sendTimes[slot]));
+    }
+    --outstanding;
+
+    if (receiveTime > m_endTime.GetTimestamp())
+      continue;
+
+    // Refill the slot with the next request
+    ++sequence[slot];
+    *(PUInt32b *)((BYTE *)requests[slot]->transactionId + 12) = sequence[slot];
+#if P_SSL
+    requests[slot].AddMessageIntegrity(m_password);
+#endif
+    requests[slot].AddFingerprint();
+    sendTimes[slot] = receiveTime;
+    if (requests[slot].Write(socket)) {
+      ++client.m_sent;
+      ++outstanding;
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
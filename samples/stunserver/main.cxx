@@ -30,6 +30,28 @@
 
 PCREATE_PROCESS(StunServer);
 
+
+class MyStunServer : public PSTUNServer
+{
+  public:
+    PIPSocketAddressAndPort m_turnServer;
+
+    virtual bool OnUnknownRequest(const PSTUNMessage & request, const SocketInfo & socketInfo)
+    {
+      if (request.GetType() != PSTUNMessage::Allocate || !m_turnServer.IsValid())
+        return PSTUNServer::OnUnknownRequest(request, socketInfo);
+
+      cerr << "TURN allocate request received on " << socketInfo.m_socketAddress << " - redirecting to " << m_turnServer << endl;
+      PSTUNMessage response;
+      response.SetType((PSTUNMessage::MsgType)(request.GetType() | 0x110), request.GetTransactionID());
+      response.AddAttribute(PSTUNErrorCode(300, "TURN available on alternate server"));
+      response.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::ALTERNATE_SERVER, m_turnServer));
+      response.AddFingerprint();
+      return response.Write(*socketInfo.m_socket, request.GetSourceAddressAndPort());
+    }
+};
+
+
 StunServer::StunServer()
   : PProcess("Post Increment", "stunserver")
 {
@@ -41,6 +63,12 @@ void StunServer::Main()
   PArgList & args = GetArguments();
   args.Parse(
             "-turnserver:"
+            "w-workers:"
+            "i-interface:"
+            "u-username:"
+            "p-password:"
+            "r-relay:"
+            "-realm:"
 #if PTRACING
             "t-trace."       "-no-trace."
             "o-output:"      "-no-output."
@@ -57,48 +85,71 @@ void StunServer::Main()
   WORD port = PSTUNServer::DefaultPort;
 
   if (args.GetCount() > 0)
-    port = (WORD)args[1].AsUnsigned();
+    port = (WORD)args[0].AsUnsigned();
+
+  MyStunServer server;
+  server.m_turnServer = PIPSocketAddressAndPort(args.GetOptionString("turnserver"));
+  if (args.HasOption('p'))
+    server.SetCredentials(args.GetOptionString('u'), args.GetOptionString('p'), PString::Empty());
+
+#if P_TURN
+  if (args.HasOption('r')) {
+    // Each allocation needs a socket, so allow lots of them
+    SetMaxHandles(100000);
+
+    PTURNServer turn;
+    if (args.HasOption('p'))
+      turn.SetCredentials(args.GetOptionString('u'), args.GetOptionString('p'), args.GetOptionString("realm"));
+
+    PIPSocketAddressAndPort binding(args.GetOptionString('i', "0.0.0.0"), port);
+    if (!turn.StartRelay(binding, args.GetOptionString('r').AsUnsigned())) {
+      PError << "error: cannot start TURN relay on " << binding << endl;
+      return;
+    }
+
+    cout << "TURN server running on " << binding << endl;
+    PTime lastTime;
+    PTURNServer::Statistics last = turn.GetStatistics();
+    for (;;) {
+      PThread::Sleep(5000);
+      PTime now;
+      PTURNServer::Statistics stats = turn.GetStatistics();
+      cout << stats.m_allocations << " allocations, "
+           << (stats.m_toPeers + stats.m_toClients - last.m_toPeers - last.m_toClients)*1000/std::max((PInt64)1, (now - lastTime).GetMilliSeconds())
+           << " packets/s relayed, " << (stats.m_dropped - last.m_dropped) << " dropped" << endl;
+      lastTime = now;
+      last = stats;
+    }
+  }
+#endif
+
+  if (args.HasOption('w')) {
+    PIPSocketAddressAndPort binding(args.GetOptionString('i', "0.0.0.0"), port);
+    if (!server.StartWorkers(binding, args.GetOptionString('w').AsUnsigned())) {
+      PError << "error: cannot start STUN server workers on " << binding << endl;
+      return;
+    }
+
+    cout << "STUN server running on " << binding << endl;
+    PTime lastTime;
+    PUInt64 lastCount = 0;
+    for (;;) {
+      PThread::Sleep(5000);
+      PTime now;
+      PUInt64 count = server.GetWorkerRequestCount();
+      cout << (count - lastCount)*1000/std::max((PInt64)1, (now - lastTime).GetMilliSeconds()) << " requests/s" << endl;
+      lastTime = now;
+      lastCount = count;
+    }
+  }
 
-  PSTUNServer server;
   if (!server.Open(port)) {
     PError << "error: cannot create STUN server on port " << (int)port << endl;
     return;
   }
 
-  PIPSocketAddressAndPort turnServer(args.GetOptionString("turnserver"));
-
-  while (server.IsOpen()) {
-    PSTUNServer::SocketInfo info;
-    PSTUNMessage message;
-    if (!server.Read(message, info)) 
-      cerr << "error: read failed" << endl;
-    else if (message.GetSize() > 0) {
-      if (!message.Validate())
-        cerr << "error: invalid message received" << endl;
-      else if (message.GetType() != PSTUNMessage::Allocate)
-        server.Process(message, info);
-      else if (turnServer.IsValid()) {
-        cerr << "TURN allocate response received from " << info.m_socketAddress << " - redirecting to " << turnServer << endl;
-        PSTUNMessage response;
-        response.SetType((PSTUNMessage::MsgType)(message.GetType() | 0x110), message.GetTransactionID());
-        {
-          PSTUNErrorCode attr;
-          attr.Initialise();
-          attr.SetErrorCode(300, "TURN available on alternate server");
-          response.AddAttribute(attr);
-        }
-        {
-          PSTUNAddressAttribute attr;
-          attr.InitAddrAttr(PSTUNAttribute::ALTERNATE_SERVER);
-          attr.SetIPAndPort(turnServer);
-          response.AddAttribute(attr);
-          server.WriteTo(response, *info.m_socket, message.GetSourceAddressAndPort());
-        }
-      }
-      else
-        cerr << "Unknown command " << hex << message.GetType() << dec << " from " << message.GetSourceAddressAndPort() << endl;
-    }
-  }
+  while (server.IsOpen())
+    server.Process();
 }
 
 // End of File ///////////////////////////////////////////////////////////////
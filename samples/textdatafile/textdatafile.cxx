@@ -12,6 +12,7 @@ class TextDataTest : public PProcess
    void ReadTest(const PString & arg);
    void WriteTestFixed(const PString & arg);
    void WriteTestVariable(const PArgList & args);
+   void Benchmark(const PString & filename, unsigned megabytes);
 };
 
 PCREATE_PROCESS(TextDataTest);
@@ -26,12 +27,15 @@ void TextDataTest::Main()
 {
   PArgList & args = GetArguments();
   if (!args.Parse("w-write.  Write file\n"
-                  "f-fields: Heading name(s)")) {
+                  "f-fields: Heading name(s)\n"
+                  "b-benchmark: Generate a CSV file of this many megabytes, then time reading and writing it")) {
     cerr << args.Usage() << endl;
     return;
   }
 
-  if (args.HasOption('f'))
+  if (args.HasOption('b'))
+    Benchmark(args.GetCount() > 0 ? args[0] : PString("benchmark.csv"), args.GetOptionString('b').AsUnsigned());
+  else if (args.HasOption('f'))
     WriteTestVariable(args);
   else if (args.HasOption('w')) {
     for (PINDEX i = 0; i < args.GetCount(); ++i)
@@ -111,3 +115,122 @@ void TextDataTest::WriteTestFixed(const PString & arg)
 void TextDataTest::WriteTestVariable(const PArgList &)
 {
 }
+
+
+static void ReportRate(const char * name, unsigned rows, const PTime & start)
+{
+  PInt64 ms = std::max((PInt64)1, (PTime() - start).GetMilliSeconds());
+  cout << setw(24) << name << ": " << setw(8) << rows << " rows in " << setw(6) << ms << "ms, "
+       << setw(9) << (PUInt64)rows*1000/ms << " rows/s" << endl;
+}
+
+
+void TextDataTest::Benchmark(const PString & filename, unsigned megabytes)
+{
+  // Something like a call detail record, with a quoted field containing a comma
+  PTextDataFile::Columns columns;
+  columns.push_back(PTextDataFile::Column("Id", PVarType::VarUInt32));
+  columns.push_back(PTextDataFile::Column("Duration", PVarType::VarFloatDouble));
+
+  unsigned rows = 0;
+  PTime start;
+  {
+    PTextFile file;
+    if (!file.Open(filename, PFile::WriteOnly)) {
+      cout << "Could not open " << filename << endl;
+      return;
+    }
+    file << "Id,Start,Caller,Called,Duration,Reason\n";
+    PUInt64 limit = (PUInt64)megabytes*1000000;
+    while ((PUInt64)file.GetPosition() < limit) {
+      ++rows;
+      file << rows << ",2024-01-01 12:" << setfill('0') << setw(2) << rows%60 << ':' << setw(2) << rows%59
+           << setfill(' ') << ",sip:" << rows*7 << "@example.com,+1555" << rows%10000000
+           << ',' << rows%3600 << '.' << rows%10 << ",\"Normal, call cleared\"\n";
+    }
+  }
+  ReportRate("Generate", rows, start);
+
+  // The previous stream based parsing, one character at a time, as PTextDataFile::ReadRecord() did
+  {
+    PTextFile file(filename, PFile::ReadOnly);
+    PCommaSeparatedVariableFormat format;
+    PVarData::Record data;
+    unsigned count = 0;
+    start.SetCurrentTime();
+    if (format.ReadHeadings(file)) {
+      while (format.ReadRecord(file, data)) {
+        data.RemoveAll();
+        ++count;
+      }
+    }
+    ReportRate("Stream ReadRecord", count, start);
+    if (count != rows)
+      cout << "Expected " << rows << " rows, got " << count << endl;
+  }
+
+  PVarData::Record first;
+  {
+    PTextDataFile file(filename, PFile::ReadOnly);
+    PVarData::Record data;
+    unsigned count = 0;
+    start.SetCurrentTime();
+    while (file.ReadRecord(data)) {
+      if (count++ == 0) {
+        first = data;
+        first.MakeUnique();
+      }
+    }
+    ReportRate("Block ReadRecord", count, start);
+    if (count != rows || first["Reason"].AsString() != "Normal, call cleared")
+      cout << "Expected " << rows << " rows, got " << count << " first=" << first["Reason"] << endl;
+  }
+
+  {
+    PTextDataFile file(filename, PFile::ReadOnly);
+    std::vector<PVarType> values;
+    unsigned count = 0;
+    double total = 0;
+    start.SetCurrentTime();
+    if (file.SetColumns(columns)) {
+      while (file.ReadColumns(values)) {
+        total += values[1].AsFloat();
+        ++count;
+      }
+    }
+    ReportRate("Block ReadColumns", count, start);
+    if (count != rows || values[0].AsUnsigned() != rows)
+      cout << "Expected " << rows << " rows, got " << count << endl;
+    PTRACE(3, "Total duration " << total);
+  }
+
+  PFilePath output = filename + ".out";
+  {
+    PTextFile file(output, PFile::WriteOnly);
+    PCommaSeparatedVariableFormat format;
+    format.SetHeadings(first.GetKeys());
+    format.WriteHeadings(file);
+    start.SetCurrentTime();
+    for (unsigned i = 0; i < rows; ++i)
+      format.WriteRecord(file, first);
+    ReportRate("Stream WriteRecord", rows, start);
+  }
+
+  {
+    PTextDataFile file(output, PFile::WriteOnly, PFile::ModeDefault, new PCommaSeparatedVariableFormat);
+    if (!file.IsOpen()) {
+      cout << "Could not open " << output << endl;
+      return;
+    }
+    start.SetCurrentTime();
+    for (unsigned i = 0; i < rows; ++i)
+      file.WriteRecord(first);
+    file.Close();
+    ReportRate("Block WriteRecord", rows, start);
+  }
+
+  PFile::Remove(output);
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
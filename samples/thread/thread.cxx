@@ -33,6 +33,7 @@
 
 #include <ptlib.h>
 #include <ptlib/pprocess.h>
+#include <ptlib/notifier_ext.h>
 
 /*
  * Thread #1 displays the number 1 every 10ms.
@@ -132,6 +133,89 @@ void LockBthenA(PMutex & a, PMutex & b)
 }
 
 
+/*
+ * Asynchronous notifier throughput. A number of producer threads queue
+ * notifications round robin to many targets, each of which has a thread
+ * draining its queue in batches.
+ */
+class NotifierTarget : public PObject, public PAsyncNotifierTarget
+{
+  PCLASSINFO(NotifierTarget, PObject)
+  public:
+    NotifierTarget(unsigned expected)
+      : m_expected(expected)
+      , m_received(0)
+      , m_thread(PThread::Create(PCREATE_NOTIFIER(ConsumerMain), "Consumer"))
+    {
+    }
+
+    ~NotifierTarget()
+    {
+      PThread::WaitAndDelete(m_thread);
+    }
+
+    PDECLARE_NOTIFIER(PThread, NotifierTarget, ConsumerMain);
+    PDECLARE_ASYNC_NOTIFIER(PObject, NotifierTarget, OnNotify);
+
+    unsigned  m_expected;
+    unsigned  m_received;
+    PThread * m_thread;
+};
+
+
+void NotifierTarget::ConsumerMain(PThread &, P_INT_PTR)
+{
+  while (m_received < m_expected)
+    AsyncNotifierExecuteBatch(64, 1000);
+}
+
+
+void NotifierTarget::OnNotify(PObject &, P_INT_PTR)
+{
+  ++m_received;
+}
+
+
+static void NotifierProducer(const std::vector<PNotifier> & notifiers, unsigned count)
+{
+  PString dummy;
+  for (unsigned i = 0; i < count; ++i) {
+    for (size_t t = 0; t < notifiers.size(); ++t)
+      notifiers[t](dummy, i);
+  }
+}
+
+
+static void TestAsyncNotifiers(unsigned numTargets, unsigned numProducers, unsigned count)
+{
+  cout << "Testing asynchronous notifiers: " << numTargets << " targets, "
+       << numProducers << " producers, " << count << " notifications per producer per target" << endl;
+
+  PList<NotifierTarget> targets;
+  std::vector<PNotifier> notifiers;
+  for (unsigned t = 0; t < numTargets; ++t) {
+    NotifierTarget * target = new NotifierTarget(numProducers*count);
+    targets.Append(target);
+    notifiers.push_back(PCREATE_NOTIFIER_EXT(target, NotifierTarget, OnNotify));
+  }
+
+  PTime start;
+
+  std::vector<PThread *> producers;
+  for (unsigned p = 0; p < numProducers; ++p)
+    producers.push_back(new PThread2Arg<const std::vector<PNotifier> &, unsigned>(notifiers, count, NotifierProducer, false, "Producer"));
+  for (unsigned p = 0; p < numProducers; ++p)
+    PThread::WaitAndDelete(producers[p]);
+
+  targets.RemoveAll();
+
+  PTimeInterval duration = PTime() - start;
+  PUInt64 total = (PUInt64)numTargets*numProducers*count;
+  cout << "Delivered " << total << " notifications in " << duration << " seconds, "
+       << (total*1000/std::max(duration.GetMilliSeconds(), (PInt64)1)) << " per second" << endl;
+}
+
+
 /*
  * The main program class
  */
@@ -150,7 +234,17 @@ void ThreadTest::Main()
   cout << "Thread Test Program" << endl;
 
   PArgList & args = GetArguments();
-  args.Parse("d-deadlock. Test deadlock detection");
+  args.Parse("d-deadlock. Test deadlock detection\n"
+             "n-notifiers: Test asynchronous notifiers with this many targets\n"
+             "p-producers: Number of threads producing notifications, default 4\n"
+             "c-count: Notifications from each producer to each target, default 10000");
+
+  if (args.HasOption('n')) {
+    TestAsyncNotifiers(args.GetOptionString('n').AsUnsigned(),
+                       args.GetOptionString('p', "4").AsUnsigned(),
+                       args.GetOptionString('c', "10000").AsUnsigned());
+    return;
+  }
 
   if (args.HasOption('d')) {
     cout << "Testing deadlock detection." << endl;
@@ -122,6 +122,36 @@ void TimingTest::Main()
   TEST_TIME("12:34:56");
   TEST_TIME("10 minutes ago");
   TEST_TIME("2 weeks");
+  TEST_TIME("2001-02-03T12:34:56.789Z");
+  TEST_TIME("Sat, 03 Feb 2001 12:34:56 GMT");
+  TEST_TIME("3 Feb 2001 12:34:56 -0800");
+
+  static const unsigned RateCount = 100000;
+  cout << "\nTesting time format and parse rates" << endl;
+  PTimeInterval rateStart = PTimer::Tick();
+  for (unsigned i = 0; i < RateCount; ++i)
+    PTime().AsString(PTime::LoggingFormat);
+  cout << "Logging format: " << RateCount*1000/(PTimer::Tick() - rateStart + 1).GetMilliSeconds() << " per second" << endl;
+
+  rateStart = PTimer::Tick();
+  for (unsigned i = 0; i < RateCount; ++i)
+    PTime().AsString(PTime::RFC1123, PTime::GMT);
+  cout << "RFC1123 format: " << RateCount*1000/(PTimer::Tick() - rateStart + 1).GetMilliSeconds() << " per second" << endl;
+
+  rateStart = PTimer::Tick();
+  for (unsigned i = 0; i < RateCount; ++i)
+    PTime("Sat, 03 Feb 2001 12:34:56 GMT");
+  cout << "RFC1123 parse:  " << RateCount*1000/(PTimer::Tick() - rateStart + 1).GetMilliSeconds() << " per second" << endl;
+
+  rateStart = PTimer::Tick();
+  for (unsigned i = 0; i < RateCount; ++i)
+    PTime("2001-02-03T12:34:56.789+09:30");
+  cout << "ISO8601 parse:  " << RateCount*1000/(PTimer::Tick() - rateStart + 1).GetMilliSeconds() << " per second" << endl;
+
+  rateStart = PTimer::Tick();
+  for (unsigned i = 0; i < RateCount; ++i)
+    PTime("5/03/1999 12:34:56");
+  cout << "General parse:  " << RateCount*1000/(PTimer::Tick() - rateStart + 1).GetMilliSeconds() << " per second" << endl;
 
   cout << "\nTesting time interval string conversion" << endl;
   TEST_TIME_INTERVAL("123.45");
@@ -0,0 +1,358 @@
+/*
+ * turnload.cxx
+ *
+ * Load generator for TURN relay servers.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/pstunsrvr.h>
+
+#include <poll.h>
+
+
+/* Creates allocations from lots of client sockets, binding each to one of a
+   few echoing peers. Each client then keeps a window of packets in flight,
+   so every packet is relayed twice by the server, out to the peer and back.
+   The hot loops use the raw socket handles, so that with many thousands of
+   sockets the generator is not the bottleneck.
+ */
+class TurnLoad : public PProcess
+{
+  PCLASSINFO(TurnLoad, PProcess)
+  public:
+    TurnLoad();
+    virtual void Main();
+
+  protected:
+    bool Transact(PUDPSocket & socket, PSTUNMessage & request, PSTUNMessage & response);
+    void EchoMain(PUDPSocket & peer);
+
+    PString    m_userName;
+    PString    m_realm;
+    PString    m_nonce;
+    PBYTEArray m_key;
+    bool       m_running;
+};
+
+PCREATE_PROCESS(TurnLoad);
+
+
+enum {
+  PayloadSize = 160,
+  ChannelNumber = 0x4000
+};
+
+
+TurnLoad::TurnLoad()
+  : PProcess("PTLib", "turnload")
+  , m_running(true)
+{
+}
+
+
+void TurnLoad::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("n-allocations: Number of allocations, default 10000\n"
+             "w-window: Packets in flight per allocation, default 1\n"
+             "d-duration: Test duration in seconds, default 10\n"
+             "P-peers: Number of echoing peer sockets, default 2\n"
+             "i-indications. Use Send/Data indications rather than channels\n"
+             "s-server: Also run an in process server with this many relay threads\n"
+             "u-username: User name for authentication\n"
+             "p-password: Password for authentication\n"
+             "r-realm: Realm for long term credentials\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <turn-server> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned allocationCount = args.GetOptionString('n', "10000").AsUnsigned();
+  unsigned window = std::max(1U, args.GetOptionString('w', "1").AsUnsigned());
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+  unsigned peerCount = std::max(1U, args.GetOptionString('P', "2").AsUnsigned());
+  bool indications = args.HasOption('i');
+
+  m_userName = args.GetOptionString('u');
+  m_realm = args.GetOptionString('r');
+  if (args.HasOption('p')) {
+    PString password = args.GetOptionString('p');
+    if (m_realm.IsEmpty())
+      m_key = PBYTEArray((const BYTE *)(const char *)password, password.GetLength());
+    else {
+      PMessageDigest5::Result hash;
+      PMessageDigest5::Encode(m_userName + ':' + m_realm + ':' + password, hash);
+      m_key = hash;
+    }
+  }
+
+  PIPSocket::Address loopback = PIPSocket::Address::GetLoopback(4);
+  PIPSocketAddressAndPort serverAddress(loopback, PSTUN::DefaultPort);
+  if (args.GetCount() > 0)
+    serverAddress.Parse(args[0], PSTUN::DefaultPort);
+
+  // Client, relay and peer sockets, plus some spare
+  unsigned handlesNeeded = allocationCount*(args.HasOption('s') ? 2 : 1) + peerCount + 100;
+  if (GetMaxHandles() < (int)handlesNeeded && !SetMaxHandles(handlesNeeded)) {
+    allocationCount = (GetMaxHandles() - peerCount - 100)/(args.HasOption('s') ? 2 : 1);
+    cerr << "Handle limit is " << GetMaxHandles() << ", reduced to " << allocationCount << " allocations" << endl;
+  }
+
+  PTURNServer server;
+  if (args.HasOption('s')) {
+    server.SetCredentials(m_userName, args.GetOptionString('p'), m_realm);
+    if (!server.StartRelay(serverAddress, args.GetOptionString('s').AsUnsigned())) {
+      cerr << "Could not start relay on " << serverAddress << endl;
+      return;
+    }
+  }
+
+  // Echoing peers
+  std::vector<PUDPSocket *> peers(peerCount);
+  for (unsigned i = 0; i < peerCount; ++i) {
+    peers[i] = new PUDPSocket;
+    if (!peers[i]->Listen(loopback)) {
+      cerr << "Could not open peer socket" << endl;
+      return;
+    }
+  }
+
+  // Packets to send, a ChannelData or a Send indication per peer
+  std::vector<PBYTEArray> packets(peerCount);
+  for (unsigned i = 0; i < peerCount; ++i) {
+    if (indications) {
+      PSTUNMessage send(PSTUNMessage::Send);
+      send.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::XOR_PEER_ADDRESS, PIPSocketAddressAndPort(loopback, peers[i]->GetPort())));
+      PSTUNAttribute data(PSTUNAttribute::DATA, 0);
+      send.AddAttribute(data);
+      PINDEX offset = send.GetSize();
+      ((PSTUNMessageHeader *)send.GetPointer())->msgLength = (WORD)(send->msgLength + PayloadSize);
+      ((PSTUNAttribute *)(send.GetPointer() + offset - sizeof(PSTUNAttribute)))->length = PayloadSize;
+      memset(send.GetPointer(offset + PayloadSize) + offset, 0x55, PayloadSize);
+      packets[i] = send;
+    }
+    else {
+      BYTE * ptr = packets[i].GetPointer(sizeof(PTURNChannelHeader) + PayloadSize);
+      ((PTURNChannelHeader *)ptr)->m_channelNumber = ChannelNumber;
+      ((PTURNChannelHeader *)ptr)->m_length = PayloadSize;
+      memset(ptr + sizeof(PTURNChannelHeader), 0x55, PayloadSize);
+    }
+  }
+
+  // Create the allocations
+  cout << "Creating " << allocationCount << " allocations on " << serverAddress << " ..." << flush;
+  PTime setupStart;
+  std::vector<PUDPSocket *> clients;
+  for (unsigned i = 0; i < allocationCount; ++i) {
+    PUDPSocket * client = new PUDPSocket;
+    if (!client->Listen(loopback)) {
+      delete client;
+      cerr << "\nCould not open client socket " << i << endl;
+      break;
+    }
+    client->SetSendAddress(serverAddress);
+    client->SetReadTimeout(500);
+
+    PSTUNMessage request(PSTUNMessage::Allocate);
+    request.AddAttribute(PTURNRequestedTransport());
+    PSTUNMessage response;
+    if (!Transact(*client, request, response)) {
+      delete client;
+      cerr << "\nAllocation " << i << " failed" << endl;
+      break;
+    }
+
+    PIPSocketAddressAndPort peerAddress(loopback, peers[i % peerCount]->GetPort());
+    if (indications) {
+      request.SetType(PSTUNMessage::CreatePermission);
+      request.SetSize(sizeof(PSTUNMessageHeader));
+      ((PSTUNMessageHeader *)request.GetPointer())->msgLength = 0;
+      request.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::XOR_PEER_ADDRESS, peerAddress));
+    }
+    else {
+      request.SetType(PSTUNMessage::ChannelBind);
+      request.SetSize(sizeof(PSTUNMessageHeader));
+      ((PSTUNMessageHeader *)request.GetPointer())->msgLength = 0;
+      PSTUNChannelNumber channel;
+      channel.m_channelNumber = ChannelNumber;
+      request.AddAttribute(channel);
+      request.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::XOR_PEER_ADDRESS, peerAddress));
+    }
+    if (!Transact(*client, request, response)) {
+      delete client;
+      cerr << "\nPermission/channel " << i << " failed" << endl;
+      break;
+    }
+
+    clients.push_back(client);
+  }
+  cout << ' ' << clients.size() << " in " << (PTime() - setupStart) << 's' << endl;
+
+  if (clients.empty())
+    return;
+
+  sockaddr_in serverSockAddr;
+  memset(&serverSockAddr, 0, sizeof(serverSockAddr));
+  serverSockAddr.sin_family = AF_INET;
+  serverSockAddr.sin_addr = serverAddress.GetAddress();
+  serverSockAddr.sin_port = htons(serverAddress.GetPort());
+
+  std::vector<struct pollfd> handles(clients.size());
+  for (size_t i = 0; i < clients.size(); ++i) {
+    handles[i].fd = clients[i]->GetHandle();
+    handles[i].events = POLLIN;
+  }
+
+  std::vector<PThread *> peerThreads(peerCount);
+  for (unsigned i = 0; i < peerCount; ++i)
+    peerThreads[i] = new PThreadObj1Arg<TurnLoad, PUDPSocket &>(*this, *peers[i], &TurnLoad::EchoMain, false, "Peer");
+
+  PTURNServer::Statistics startStats = server.GetStatistics();
+
+  // Fill the window for every allocation, then send a new packet for every one received
+  PUInt64 sent = 0, received = 0, bad = 0;
+  for (size_t i = 0; i < clients.size(); ++i) {
+    const PBYTEArray & packet = packets[i % peerCount];
+    for (unsigned w = 0; w < window; ++w) {
+      if (::sendto(handles[i].fd, (const char *)(const BYTE *)packet, packet.GetSize(), 0, (sockaddr *)&serverSockAddr, sizeof(serverSockAddr)) > 0)
+        ++sent;
+    }
+  }
+
+  PTime startTime;
+  PTime endTime = startTime + duration;
+  BYTE buffer[2048];
+  while (PTime() < endTime) {
+    if (::poll(&handles[0], handles.size(), 200) <= 0)
+      continue;
+
+    for (size_t i = 0; i < handles.size(); ++i) {
+      if (handles[i].revents == 0)
+        continue;
+
+      ssize_t len;
+      while ((len = ::recv(handles[i].fd, (char *)buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        bool ok = indications ? (len >= 20 && buffer[0] == 0x00 && buffer[1] == 0x17)
+                              : (len == (ssize_t)(sizeof(PTURNChannelHeader) + PayloadSize) && buffer[0] == 0x40 && buffer[1] == 0x00);
+        if (ok)
+          ++received;
+        else
+          ++bad;
+
+        const PBYTEArray & packet = packets[i % peerCount];
+        if (::sendto(handles[i].fd, (const char *)(const BYTE *)packet, packet.GetSize(), 0, (sockaddr *)&serverSockAddr, sizeof(serverSockAddr)) > 0)
+          ++sent;
+      }
+    }
+  }
+  PTimeInterval elapsed = PTime() - startTime;
+  PTURNServer::Statistics endStats = server.GetStatistics();
+
+  m_running = false;
+  for (unsigned i = 0; i < peerCount; ++i)
+    PThread::WaitAndDelete(peerThreads[i]);
+
+  PInt64 ms = std::max((PInt64)1, elapsed.GetMilliSeconds());
+  cout << "Allocations: " << clients.size() << ", " << (indications ? "indications" : "channels") << ", window " << window << "\n"
+          "Client sent " << sent << ", received " << received << ", bad " << bad << "\n"
+          "Round trips: " << received*1000/ms << "/s\n"
+          "Relayed packets: " << 2*received*1000/ms << "/s\n";
+  if (server.IsRelaying())
+    cout << "Server relayed " << (endStats.m_toPeers - startStats.m_toPeers) << " to peers, "
+         << (endStats.m_toClients - startStats.m_toClients) << " to clients, "
+         << (endStats.m_toPeers + endStats.m_toClients - startStats.m_toPeers - startStats.m_toClients)*1000/ms << "/s, "
+         << (endStats.m_dropped - startStats.m_dropped) << " dropped\n";
+  cout << endl;
+
+  for (size_t i = 0; i < clients.size(); ++i)
+    delete clients[i];
+  for (unsigned i = 0; i < peerCount; ++i)
+    delete peers[i];
+}
+
+
+bool TurnLoad::Transact(PUDPSocket & socket, PSTUNMessage & request, PSTUNMessage & response)
+{
+  WORD unauthenticatedLength = request->msgLength;
+
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    ((PSTUNMessageHeader *)request.GetPointer())->msgLength = unauthenticatedLength;
+    // Long term credentials need a nonce from the server before they can be used
+    if (!m_key.IsEmpty() && (m_realm.IsEmpty() || !m_nonce.IsEmpty())) {
+      request.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::USERNAME, m_userName));
+      if (!m_realm.IsEmpty()) {
+        request.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::REALM, m_realm));
+        request.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::NONCE, m_nonce));
+      }
+#if P_SSL
+      request.AddMessageIntegrity(m_key);
+#endif
+    }
+
+    if (!response.Poll(socket, request, 3))
+      return false;
+
+    if (response.IsSuccessResponse())
+      return true;
+
+    PSTUNErrorCode * error = response.FindAttributeAs<PSTUNErrorCode>(PSTUNAttribute::ERROR_CODE);
+    PString nonce = response.FindAttributeString(PSTUNAttribute::NONCE);
+    if (error == NULL || (error->GetErrorCode() != 401 && error->GetErrorCode() != 438) || nonce.IsEmpty()) {
+      PTRACE(2, "Request failed: " << response);
+      return false;
+    }
+
+    // Each relay thread has its own nonce, try again with this one
+    m_nonce = nonce;
+  }
+
+  return false;
+}
+
+
+void TurnLoad::EchoMain(PUDPSocket & peer)
+{
+  struct pollfd pfd;
+  pfd.fd = peer.GetHandle();
+  pfd.events = POLLIN;
+
+  BYTE buffer[2048];
+  while (m_running) {
+    if (::poll(&pfd, 1, 200) <= 0)
+      continue;
+
+    sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+    ssize_t len;
+    while ((len = ::recvfrom(pfd.fd, (char *)buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr *)&from, &fromLen)) > 0) {
+      ::sendto(pfd.fd, (const char *)buffer, len, 0, (sockaddr *)&from, fromLen);
+      fromLen = sizeof(from);
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,215 @@
+/*
+ * vxmlpump.cxx
+ *
+ * Benchmark for running many PVXMLSession instances, each with its own
+ * threads, or all on a PVXMLMediaPump.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/vxml.h>
+
+#include <algorithm>
+#include <sys/resource.h>
+
+
+/* A prompt every second, forever, like an IVR waiting for a caller to do
+   something, or recording what the caller says in three second pieces. */
+static PString MakeScript(const PDirectory & recordDir, unsigned index)
+{
+  PStringStream script;
+  script << "<?xml version=\"1.0\"?>"
+            "<vxml version=\"2.0\">"
+              "<form id=\"main\">";
+  if (recordDir.IsEmpty())
+    script << "<block>"
+                "<break time=\"1s\"/>"
+                "<goto next=\"#main\"/>"
+              "</block>";
+  else
+    script << "<record name=\"msg\" maxtime=\"3s\" finalsilence=\"10s\""
+                     " dest=\"" << PURL(PFilePath(PSTRSTRM(recordDir << "session" << index << ".wav"))) << "\"/>"
+              "<block>"
+                "<goto next=\"#main\"/>"
+              "</block>";
+  script <<   "</form>"
+            "</vxml>";
+  return script;
+}
+
+
+class VXMLPump : public PProcess
+{
+  PCLASSINFO(VXMLPump, PProcess)
+  public:
+    VXMLPump();
+    virtual void Main();
+
+  protected:
+    void Run(unsigned count, unsigned seconds, bool pumped, unsigned pumpThreads, unsigned dialogThreads, const PDirectory & recordDir);
+    void ReaderMain(PVXMLSession & session);
+    PDECLARE_VXMLFrameNotifier(VXMLPump, OnFrame);
+
+    atomic<PUInt64> m_frames;
+};
+
+PCREATE_PROCESS(VXMLPump);
+
+
+VXMLPump::VXMLPump()
+  : PProcess("PTLib", "vxmlpump")
+  , m_frames(0)
+{
+}
+
+
+void VXMLPump::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("s-sessions: Number of sessions, default 1000\n"
+             "d-duration: Seconds to measure, default 10\n"
+             "p-pump-threads: Media pump threads, default one per processor\n"
+             "w-dialog-threads: Media pump dialog threads, default two per processor\n"
+             "r-record: Record incoming audio to files in this directory\n"
+             "T-thread-only. Only run with a thread per session\n"
+             "P-pump-only. Only run with the media pump\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned count = std::max(1U, args.GetOptionString('s', "1000").AsUnsigned());
+  unsigned seconds = std::max(1U, args.GetOptionString('d', "10").AsUnsigned());
+  unsigned pumpThreads = args.GetOptionString('p').AsUnsigned();
+  unsigned dialogThreads = args.GetOptionString('w').AsUnsigned();
+
+  PDirectory recordDir;
+  if (args.HasOption('r')) {
+    recordDir = args.GetOptionString('r');
+    if (!recordDir.Create()) {
+      cerr << "Could not create " << recordDir << endl;
+      return;
+    }
+  }
+
+  if (!args.HasOption('P'))
+    Run(count, seconds, false, pumpThreads, dialogThreads, recordDir);
+  if (!args.HasOption('T'))
+    Run(count, seconds, true, pumpThreads, dialogThreads, recordDir);
+}
+
+
+static unsigned GetThreadCount()
+{
+  PTextFile status("/proc/self/status", PFile::ReadOnly);
+  PString line;
+  while (status.ReadLine(line)) {
+    if (line.NumCompare("Threads:") == PObject::EqualTo)
+      return line.Mid(8).AsUnsigned();
+  }
+  return 0;
+}
+
+
+void VXMLPump::ReaderMain(PVXMLSession & session)
+{
+  // What the application does for each session without the pump, the audio is looped back as incoming
+  BYTE frame[320];
+  while (session.Read(frame, sizeof(frame))) {
+    ++m_frames;
+    session.Write(frame, sizeof(frame));
+  }
+}
+
+
+void VXMLPump::OnFrame(PVXMLSession & session, PBYTEArray & frame)
+{
+  ++m_frames;
+  session.Write(frame, frame.GetSize());
+}
+
+
+void VXMLPump::Run(unsigned count, unsigned seconds, bool pumped, unsigned pumpThreads, unsigned dialogThreads, const PDirectory & recordDir)
+{
+  PVXMLMediaPump * pump = pumped ? new PVXMLMediaPump(20, pumpThreads, dialogThreads) : NULL;
+
+  std::vector<PVXMLSession *> sessions(count);
+  std::vector<PThread *> readers;
+  for (unsigned i = 0; i < count; ++i) {
+    sessions[i] = new PVXMLSession;
+    if (pump != NULL)
+      pump->Attach(*sessions[i], PCREATE_NOTIFIER2(OnFrame, PBYTEArray &));
+    if (!sessions[i]->LoadVXML(MakeScript(recordDir, i)) || !sessions[i]->Open(VXML_PCM16)) {
+      cerr << "Could not start session " << i << endl;
+      return;
+    }
+    if (pump == NULL)
+      readers.push_back(new PThreadObj1Arg<VXMLPump, PVXMLSession &>(*this, *sessions[i], &VXMLPump::ReaderMain, false, "Reader"));
+  }
+
+  // Let everything get going
+  PThread::Sleep(1000);
+
+  unsigned threads = GetThreadCount();
+  struct rusage before, after;
+  getrusage(RUSAGE_SELF, &before);
+  PUInt64 startFrames = m_frames;
+  PTime start;
+
+  PThread::Sleep(seconds*1000);
+
+  getrusage(RUSAGE_SELF, &after);
+  PInt64 elapsed = std::max((PInt64)1, (PTime() - start).GetMilliSeconds());
+  PUInt64 frames = m_frames - startFrames;
+
+  PUInt64 switches = (after.ru_nvcsw + after.ru_nivcsw) - (before.ru_nvcsw + before.ru_nivcsw);
+  PInt64 cpuUs = (after.ru_utime.tv_sec - before.ru_utime.tv_sec)*1000000LL + (after.ru_utime.tv_usec - before.ru_utime.tv_usec)
+               + (after.ru_stime.tv_sec - before.ru_stime.tv_sec)*1000000LL + (after.ru_stime.tv_usec - before.ru_stime.tv_usec);
+
+  PVXMLMediaPump::Statistics stats;
+  if (pump != NULL)
+    pump->GetStatistics(stats);
+
+  for (unsigned i = 0; i < count; ++i)
+    sessions[i]->Close();
+  for (size_t i = 0; i < readers.size(); ++i)
+    PThread::WaitAndDelete(readers[i]);
+  for (unsigned i = 0; i < count; ++i)
+    delete sessions[i];
+  delete pump;
+
+  cout << (pumped ? "Media pump       " : "Thread per session")
+       << ' ' << count << " sessions, " << threads << " threads:"
+          " frames " << setw(6) << frames*1000/elapsed << "/s"
+          " (" << setw(5) << std::fixed << std::setprecision(1) << frames*1000.0/elapsed/count << " per session),"
+          " per 1k sessions: context switches " << setw(7) << switches*1000*1000/elapsed/count << "/s,"
+          " CPU " << setw(5) << cpuUs*100.0/1000/elapsed*1000/count << '%';
+  if (pumped)
+    cout << ", late " << stats.m_lateFrames << ", dialog steps " << stats.m_dialogSteps << ", recorded " << stats.m_writtenBytes/1024 << "kB";
+  cout << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -58,6 +58,7 @@ void VxmlTest::Main()
                   "S-sr: Speech recognition method\n"
                   "c-cache: Text to speech cache directory\n"
                   "-clear-cache. Clear the cache on execution\n"
+                  "-cache-memory: Byte budget for in memory cache, 0 disables\n"
                   "r-property: Set default property value: name=value\n"
 #if P_VXML_VIDEO
                   "V-video. Enabled video support\n"
@@ -120,6 +121,7 @@ void VxmlTest::Main()
   cli.SetCommand("set", PCREATE_NOTIFIER(SetVar), "Set variable for VXML instance (1..n)", "<var> <value> [ <n> ]");
   cli.SetCommand("get", PCREATE_NOTIFIER(GetVar), "Get variable for VXML instance (1..n)", "<var> [ <n> ]");
   cli.SetCommand("disconnect", PCREATE_NOTIFIER(Disconnect), "Disconnect VXML instance (1..n)", "[ <n> ]");
+  cli.SetCommand("cache", PCREATE_NOTIFIER(CacheStatistics), "Show VXML resource cache statistics");
   cli.Start(false);
   m_tests.clear();
 }
@@ -214,6 +216,15 @@ void VxmlTest::Disconnect(PCLI::Arguments & args, P_INT_PTR)
 }
 
 
+void VxmlTest::CacheStatistics(PCLI::Arguments & args, P_INT_PTR)
+{
+  if (m_tests.empty())
+    args.WriteError("No instances");
+  else
+    args.GetContext() << m_tests[0]->GetCache().GetStatistics() << endl;
+}
+
+
 TestInstance::TestInstance()
   : m_instance(0)
   , m_player(NULL)
@@ -382,6 +393,8 @@ bool TestInstance::Initialise(unsigned instance, const PArgList & args)
     GetCache().SetDirectory(args.GetOptionString("cache"));
   if (args.HasOption("clear-cache"))
     PDirectory::RemoveTree(GetCache().GetDirectory());
+  if (args.HasOption("cache-memory"))
+    GetCache().SetMemoryLimit(args.GetOptionString("cache-memory").AsUnsigned());
 
   if (!Open(VXML_PCM16, audioParams.m_sampleRate, audioParams.m_channels)) {
     cerr << "Instance " << m_instance << " error: cannot open VXML device in PCM mode" << endl;
@@ -68,6 +68,7 @@ class VxmlTest : public PProcess
     PDECLARE_NOTIFIER(PCLI::Arguments, VxmlTest, SetVar);
     PDECLARE_NOTIFIER(PCLI::Arguments, VxmlTest, GetVar);
     PDECLARE_NOTIFIER(PCLI::Arguments, VxmlTest, Disconnect);
+    PDECLARE_NOTIFIER(PCLI::Arguments, VxmlTest, CacheStatistics);
     std::vector< PSharedPtr<TestInstance> > m_tests;
 };
 
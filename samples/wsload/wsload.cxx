@@ -0,0 +1,275 @@
+/*
+ * wsload.cxx
+ *
+ * Load generator for PWebSocket.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/http.h>
+
+#include <algorithm>
+
+
+static const char EchoProtocol[] = "echo";
+static const char BroadcastMarker = '*';
+
+
+/* Listener that answers WebSocket connections for the echo protocol, each
+   message received is sent straight back.
+ */
+class EchoListener : public PHTTPListener
+{
+  public:
+    EchoListener(unsigned workers, bool deflate)
+      : PHTTPListener(workers)
+      , m_deflate(deflate)
+    {
+    }
+
+    ~EchoListener()
+    {
+      // Connections use our members, so must end before they go
+      ShutdownListeners();
+    }
+
+    virtual void OnHTTPStarted(PHTTPServer & server)
+    {
+      server.SetWebSocketNotifier(EchoProtocol, PCREATE_NOTIFIER(OnEcho));
+      server.SetWebSocketDeflate(m_deflate);
+    }
+
+    void Broadcast(const void * data, PINDEX len)
+    {
+      PWaitAndSignal lock(m_mutex);
+      PWebSocket::Broadcast(m_webSockets, data, len, true);
+    }
+
+  protected:
+    PDECLARE_NOTIFIER_EXT(PHTTPServer, server, EchoListener, OnEcho, PHTTPConnectionInfo, connectInfo)
+    {
+      PWebSocket webSocket;
+      if (!webSocket.Open(&server, false) || !webSocket.SetExtensions(connectInfo.GetWebSocketExtensions()))
+        return;
+      webSocket.SetBinaryMode();
+
+      {
+        PWaitAndSignal lock(m_mutex);
+        m_webSockets.push_back(&webSocket);
+      }
+
+      // Reuse the one buffer, so the server side allocates nothing per message
+      PBYTEArray buffer(2*1024*1024);
+      PINDEX length;
+      while (webSocket.ReadMessage(buffer.GetPointer(), buffer.GetSize(), length)) {
+        // A message starting with a '*' asks for the rest to be broadcast to everyone
+        if (length > 0 && buffer[0] == BroadcastMarker)
+          Broadcast((const BYTE *)buffer + 1, length - 1);
+        else if (!webSocket.Write(buffer, length))
+          break;
+      }
+
+      PWaitAndSignal lock(m_mutex);
+      m_webSockets.erase(std::find(m_webSockets.begin(), m_webSockets.end(), &webSocket));
+    }
+
+    bool             m_deflate;
+    PDECLARE_MUTEX(  m_mutex);
+    PWebSocket::List m_webSockets;
+};
+
+
+class WsLoad : public PProcess
+{
+  PCLASSINFO(WsLoad, PProcess)
+  public:
+    WsLoad();
+    virtual void Main();
+
+  protected:
+    struct Client {
+      Client() : m_messages(0), m_bad(0) { }
+      PWebSocket m_webSocket;
+      PBYTEArray m_buffer;
+      unsigned   m_messages;
+      unsigned   m_bad;
+    };
+    void ClientMain(Client & client, unsigned index);
+    bool Check(Client & client, PINDEX length);
+
+    PBYTEArray m_message;
+    PBYTEArray m_trigger;
+    PTime      m_endTime;
+    bool       m_broadcast;
+};
+
+PCREATE_PROCESS(WsLoad);
+
+
+WsLoad::WsLoad()
+  : PProcess("PTLib", "wsload")
+  , m_broadcast(false)
+{
+}
+
+
+void WsLoad::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("c-clients: Number of client connections, default 4\n"
+             "d-duration: Test duration in seconds for each size, default 3\n"
+             "s-sizes: Comma separated message sizes, default 64,1024,16384,65536,1048576\n"
+             "z-deflate. Use the permessage-deflate extension\n"
+             "B-broadcast. Server sends each message to every client with one framing\n"
+             "W-workers: Local server worker threads, default 16\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <ws-url> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned clientCount = std::max(1U, args.GetOptionString('c', "4").AsUnsigned());
+  PTimeInterval duration(0, args.GetOptionString('d', "3").AsUnsigned());
+  PStringArray sizes = args.GetOptionString('s', "64,1024,16384,65536,1048576").Tokenise(',', false);
+  m_broadcast = args.HasOption('B');
+
+  // Without a URL, run our own server to talk to
+  EchoListener listener(args.GetOptionString('W', "16").AsUnsigned(), args.HasOption('z'));
+  PURL url;
+  if (args.GetCount() > 0)
+    url = args[0];
+  else {
+    if (!listener.ListenForHTTP("127.0.0.1", 0, PSocket::CanReuseAddress, 100)) {
+      cerr << "Could not start HTTP listener" << endl;
+      return;
+    }
+    url = PSTRSTRM("ws://127.0.0.1:" << listener.GetPort() << '/');
+  }
+
+  std::vector<Client *> clients(clientCount);
+  for (unsigned i = 0; i < clientCount; ++i) {
+    clients[i] = new Client;
+    Client & client = *clients[i];
+    client.m_webSocket.SetPerMessageDeflate(args.HasOption('z'));
+    client.m_webSocket.SetReadTimeout(10000);
+    if (!client.m_webSocket.Connect(url, EchoProtocol)) {
+      cerr << "Could not connect to " << url << ": " << client.m_webSocket.GetErrorText() << endl;
+      return;
+    }
+    client.m_webSocket.SetBinaryMode();
+  }
+
+  cout << (m_broadcast ? "Broadcasting" : "Echoing") << " messages with " << url << " using " << clientCount << " clients"
+       << (clients[0]->m_webSocket.IsPerMessageDeflate() ? " with permessage-deflate" : "") << endl;
+
+  for (PINDEX s = 0; s < sizes.GetSize(); ++s) {
+    // Text that compresses about as well as typical JSON does
+    PINDEX size = sizes[s].AsUnsigned();
+    m_message.SetSize(size);
+    for (PINDEX i = 0; i < size; ++i)
+      m_message[i] = "{\"id\":0123456789,\"name\":\"abcdefghijklmnopqrstuvwxyz\"}"[(i*7 + i/53) % 52];
+    m_trigger.SetSize(size + 1);
+    m_trigger[0] = BroadcastMarker;
+    memcpy(m_trigger.GetPointer() + 1, m_message, size);
+
+    std::vector<PThread *> threads(clientCount);
+    PTime startTime;
+    m_endTime = startTime + duration;
+    for (unsigned i = 0; i < clientCount; ++i) {
+      clients[i]->m_messages = clients[i]->m_bad = 0;
+      threads[i] = new PThreadObj2Arg<WsLoad, Client &, unsigned>(*this, *clients[i], i, &WsLoad::ClientMain, false, "Client");
+    }
+    for (unsigned i = 0; i < clientCount; ++i)
+      PThread::WaitAndDelete(threads[i]);
+    PTimeInterval elapsed = PTime() - startTime;
+
+    unsigned total = 0, bad = 0;
+    for (unsigned i = 0; i < clientCount; ++i) {
+      total += clients[i]->m_messages;
+      bad += clients[i]->m_bad;
+    }
+
+    PInt64 ms = std::max((PInt64)1, elapsed.GetMilliSeconds());
+    cout << setw(8) << size << " bytes: " << setw(8) << (PUInt64)total*1000/ms << " messages/s "
+         << setw(8) << (PUInt64)total*size/1000/ms << " MB/s, bad " << bad << endl;
+  }
+
+  for (unsigned i = 0; i < clientCount; ++i)
+    delete clients[i];
+}
+
+
+void WsLoad::ClientMain(Client & client, unsigned index)
+{
+  PINDEX size = m_message.GetSize();
+  client.m_buffer.SetSize(size + 1);
+  PINDEX length;
+
+  if (!m_broadcast) {
+    // Each client waits for the echo of its own message
+    while (PTime() < m_endTime) {
+      if (!client.m_webSocket.Write(m_message, size) ||
+          !client.m_webSocket.ReadMessage(client.m_buffer.GetPointer(), client.m_buffer.GetSize(), length))
+        break;
+      Check(client, length);
+    }
+    return;
+  }
+
+  /* The first client triggers each broadcast, with the message after a
+     marker byte, and every client counts what arrives. A one byte message
+     ends it. */
+  if (index > 0) {
+    while (client.m_webSocket.ReadMessage(client.m_buffer.GetPointer(), client.m_buffer.GetSize(), length) && length != 1)
+      Check(client, length);
+    return;
+  }
+
+  bool more = true;
+  do {
+    more = PTime() < m_endTime;
+    if (!client.m_webSocket.Write(m_trigger, more ? size + 1 : 2))
+      break;
+    if (!client.m_webSocket.ReadMessage(client.m_buffer.GetPointer(), client.m_buffer.GetSize(), length))
+      break;
+    if (more)
+      Check(client, length);
+  } while (more);
+}
+
+
+bool WsLoad::Check(Client & client, PINDEX length)
+{
+  if (length == m_message.GetSize() && memcmp(client.m_buffer, m_message, length) == 0) {
+    ++client.m_messages;
+    return true;
+  }
+
+  PTRACE(2, "Bad message: length=" << length);
+  ++client.m_bad;
+  return false;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,161 @@
+/*
+ * yuvread.cxx
+ *
+ * Benchmark for reading raw video files with PYUVFile.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/pvidfile.h>
+
+#include <algorithm>
+
+
+class YUVRead : public PProcess
+{
+  PCLASSINFO(YUVRead, PProcess)
+  public:
+    YUVRead();
+    virtual void Main();
+
+  protected:
+    bool Generate(const PFilePath & filename, unsigned megabytes);
+    void Run(const PFilePath & filename, const char * name, bool mapped, bool span, bool hugePages);
+
+    unsigned m_width;
+    unsigned m_height;
+};
+
+PCREATE_PROCESS(YUVRead);
+
+
+YUVRead::YUVRead()
+  : PProcess("PTLib", "yuvread")
+  , m_width(1280)
+  , m_height(720)
+{
+}
+
+
+void YUVRead::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("m-megabytes: Size of y4m file to generate, default 256\n"
+             "k-keep. Use existing file, do not generate it\n"
+             "H-huge-pages. Align mapping for transparent huge pages\n"
+             "r-repeat: Number of passes of each read method, default 3\n"
+             PTRACE_ARGLIST
+             "h-help. Output this help\n");
+
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ <options> ... ] [ <file.y4m> ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  PFilePath filename = args.GetCount() > 0 ? args[0] : PString("yuvread_1280x720.y4m");
+  if (!args.HasOption('k') && !Generate(filename, std::max(1U, args.GetOptionString('m', "256").AsUnsigned())))
+    return;
+
+  /* The file was just written, or a previous pass read it, so it is in the
+     page cache, and this measures the cost of getting it from there. */
+  unsigned repeat = std::max(1U, args.GetOptionString('r', "3").AsUnsigned());
+  for (unsigned i = 0; i < repeat; ++i) {
+    Run(filename, "read()      ", false, false, false);
+    Run(filename, "mapped copy ", true,  false, args.HasOption('H'));
+    Run(filename, "mapped span ", true,  true,  args.HasOption('H'));
+  }
+
+  if (!args.HasOption('k'))
+    PFile::Remove(filename);
+}
+
+
+bool YUVRead::Generate(const PFilePath & filename, unsigned megabytes)
+{
+  PFile file;
+  if (!file.Open(filename, PFile::WriteOnly)) {
+    cerr << "Could not create " << filename << ": " << file.GetErrorText() << endl;
+    return false;
+  }
+
+  PString header = PSTRSTRM("YUV4MPEG2 W" << m_width << " H" << m_height << " F30:1 Ip C420\n");
+  file.Write((const char *)header, header.GetLength());
+
+  PBYTEArray frame(m_width*m_height*3/2);
+  unsigned frames = (unsigned)(megabytes*1000000ULL/frame.GetSize());
+  for (unsigned f = 0; f < frames; ++f) {
+    for (PINDEX i = 0; i < frame.GetSize(); ++i)
+      frame[i] = (BYTE)(i + f);
+    if (!file.Write("FRAME\n", 6) || !file.Write(frame, frame.GetSize())) {
+      cerr << "Could not write " << filename << ": " << file.GetErrorText() << endl;
+      return false;
+    }
+  }
+
+  cout << "Generated " << filename << ", " << frames << " frames of " << m_width << 'x' << m_height << endl;
+  return true;
+}
+
+
+void YUVRead::Run(const PFilePath & filename, const char * name, bool mapped, bool span, bool hugePages)
+{
+  PYUVFile file;
+  if (mapped)
+    file.SetMemoryMapped(true, hugePages);
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    cerr << "Could not open " << filename << ": " << file.GetErrorText() << endl;
+    return;
+  }
+
+  PINDEX frameBytes = file.GetFrameBytes();
+  PBYTEArray buffer(frameBytes);
+  unsigned frames = 0;
+  unsigned checksum = 0;
+
+  PTime startTime;
+  for (;;) {
+    const BYTE * frame;
+    if (span) {
+      if (!file.ReadFrameSpan(frame))
+        break;
+    }
+    else {
+      if (!file.ReadFrame(buffer.GetPointer()))
+        break;
+      frame = buffer;
+    }
+
+    // Touch every cache line, as an encoder would
+    for (PINDEX i = 0; i < frameBytes; i += 64)
+      checksum += frame[i];
+    ++frames;
+  }
+  PInt64 us = std::max((PInt64)1, (PTime() - startTime).GetMicroSeconds());
+
+  cout << name << setw(6) << frames << " frames "
+       << setw(8) << (PUInt64)frames*1000000/us << " frames/s "
+       << setw(6) << (PUInt64)frames*frameBytes/us << " MB/s"
+          "  checksum=" << checksum << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
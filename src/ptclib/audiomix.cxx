@@ -0,0 +1,622 @@
+/*
+ * audiomix.cxx
+ *
+ * Audio sample rate conversion and mixing.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifdef __GNUC__
+#pragma implementation "audiomix.h"
+#endif
+
+#include <ptlib.h>
+#include <ptclib/audiomix.h>
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define P_AUDIO_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define P_AUDIO_SSE2 0
+#endif
+
+#if !P_AUDIO_SSE2 && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+  #define P_AUDIO_NEON 1
+  #include <arm_neon.h>
+#else
+  #define P_AUDIO_NEON 0
+#endif
+
+
+#define new PNEW
+#define PTraceModule() "AudioMix"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const unsigned CoefficientShift = 14;
+
+static unsigned GreatestCommonDivisor(unsigned a, unsigned b)
+{
+  while (b != 0) {
+    unsigned t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+
+// Modified Bessel function of the first kind, order zero, for the Kaiser window
+static double BesselI0(double x)
+{
+  double sum = 1, term = 1;
+  for (unsigned k = 1; k < 50; ++k) {
+    double t = x/(2*k);
+    term *= t*t;
+    sum += term;
+    if (term < sum*1e-12)
+      break;
+  }
+  return sum;
+}
+
+
+static __inline short Saturate(int value)
+{
+  return (short)(value > 32767 ? 32767 : value < -32768 ? -32768 : value);
+}
+
+
+PAudioResampler::PAudioResampler(unsigned srcRate, unsigned dstRate, unsigned channels, unsigned taps)
+  : m_srcRate(0)
+  , m_dstRate(0)
+  , m_channels(0)
+  , m_requestedTaps(std::max(taps, 4U))
+  , m_up(0)
+  , m_down(0)
+  , m_step(0)
+  , m_stepPhase(0)
+  , m_taps(0)
+  , m_phase(0)
+  , m_position(0)
+{
+  SetRates(srcRate, dstRate, channels);
+}
+
+
+bool PAudioResampler::SetRates(unsigned srcRate, unsigned dstRate, unsigned channels)
+{
+  if (srcRate == m_srcRate && dstRate == m_dstRate && channels == m_channels && m_up != 0)
+    return true;
+
+  m_srcRate = srcRate;
+  m_dstRate = dstRate;
+  m_channels = channels;
+  m_up = m_down = 0;
+
+  if (srcRate == 0 || dstRate == 0 || channels == 0) {
+    PTRACE(2, "Illegal rates " << srcRate << "->" << dstRate << ", channels=" << channels);
+    return false;
+  }
+
+  unsigned gcd = GreatestCommonDivisor(srcRate, dstRate);
+  if (dstRate/gcd > MaxPhases) {
+    PTRACE(2, "Rates " << srcRate << "->" << dstRate << " have too many phases: " << dstRate/gcd);
+    return false;
+  }
+
+  m_up = dstRate/gcd;
+  m_down = srcRate/gcd;
+  m_step = m_down/m_up;
+  m_stepPhase = m_down%m_up;
+
+  MakeFilter();
+  Reset();
+
+  PTRACE(4, "Resampling " << srcRate << "->" << dstRate << "Hz, ratio " << m_up << '/' << m_down
+         << ", " << m_taps << " taps, channels=" << channels);
+  return true;
+}
+
+
+void PAudioResampler::MakeFilter()
+{
+  m_coefficients.clear();
+  if (IsPassThrough()) {
+    m_taps = 0;
+    return;
+  }
+
+  /* When down sampling, the filter is stretched to the output rate, so it
+     covers the same time, and takes proportionally more input samples. */
+  unsigned taps = std::min(m_requestedTaps*((m_down + m_up - 1)/m_up), (unsigned)MaxTaps);
+  m_taps = (taps + 7) & ~7U;
+  unsigned padding = m_taps - taps;
+
+  // Cut off in cycles per input sample, just below the lower Nyquist frequency
+  double cutoff = 0.45*std::min(1.0, (double)m_up/m_down);
+  static const double Beta = 8.0;
+  double i0beta = BesselI0(Beta);
+  unsigned length = m_up*taps;
+  double centre = (length - 1)/2.0;
+
+  std::vector<double> prototype(length);
+  for (unsigned n = 0; n < length; ++n) {
+    double x = (n - centre)/m_up;
+    double sinc = x == 0 ? 2*cutoff : sin(2*M_PI*cutoff*x)/(M_PI*x);
+    double r = (n - centre)/(length/2.0);
+    prototype[n] = sinc*BesselI0(Beta*sqrt(std::max(0.0, 1 - r*r)))/i0beta;
+  }
+
+  /* Each phase is normalised to a gain of exactly one, and reversed so the
+     dot product runs forward through the history. Output i of a phase is
+     sum(h[phase + j*L] * x[i - j]), so the oldest sample pairs with the
+     largest j, and padding goes on the oldest end. */
+  m_coefficients.resize(m_up*m_taps);
+  for (unsigned phase = 0; phase < m_up; ++phase) {
+    double sum = 0;
+    for (unsigned j = 0; j < taps; ++j)
+      sum += prototype[phase + j*m_up];
+
+    short * coefficients = &m_coefficients[phase*m_taps];
+    for (unsigned k = 0; k < m_taps; ++k) {
+      if (k < padding)
+        coefficients[k] = 0;
+      else {
+        double value = prototype[phase + (m_taps - 1 - k)*m_up]/sum;
+        coefficients[k] = (short)floor(value*(1 << CoefficientShift) + 0.5);
+      }
+    }
+  }
+}
+
+
+void PAudioResampler::Reset()
+{
+  m_phase = 0;
+  m_position = 0;
+  m_history.resize(m_channels);
+  for (unsigned ch = 0; ch < m_channels; ++ch)
+    m_history[ch].assign(m_taps > 0 ? m_taps - 1 : 0, 0);
+}
+
+
+PINDEX PAudioResampler::GetMaxOutput(PINDEX srcSamples) const
+{
+  if (m_up == 0)
+    return 0;
+  if (IsPassThrough())
+    return srcSamples;
+  PUInt64 frames = srcSamples/m_channels + m_taps;
+  return (PINDEX)((frames*m_up/m_down + 1)*m_channels);
+}
+
+
+int PAudioResampler::DotProduct(const short * samples, const short * coefficients, unsigned count)
+{
+#if P_AUDIO_SSE2
+  __m128i acc = _mm_setzero_si128();
+  for (unsigned i = 0; i < count; i += 8)
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(samples + i)),
+                                            _mm_loadu_si128((const __m128i *)(coefficients + i))));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(acc);
+#elif P_AUDIO_NEON
+  int32x4_t acc = vdupq_n_s32(0);
+  for (unsigned i = 0; i < count; i += 8) {
+    int16x8_t s = vld1q_s16(samples + i);
+    int16x8_t c = vld1q_s16(coefficients + i);
+    acc = vmlal_s16(acc, vget_low_s16(s), vget_low_s16(c));
+    acc = vmlal_s16(acc, vget_high_s16(s), vget_high_s16(c));
+  }
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+  int acc = 0;
+  for (unsigned i = 0; i < count; ++i)
+    acc += samples[i]*coefficients[i];
+  return acc;
+#endif
+}
+
+
+PINDEX PAudioResampler::Process(const short * src, PINDEX & srcSamples, short * dst, PINDEX dstSamples)
+{
+  if (m_up == 0) {
+    srcSamples = 0;
+    return 0;
+  }
+
+  PINDEX srcFrames = srcSamples/m_channels;
+  PINDEX dstFrames = dstSamples/m_channels;
+
+  if (IsPassThrough()) {
+    srcSamples = std::min(srcFrames, dstFrames)*m_channels;
+    if (src != dst)
+      memmove(dst, src, srcSamples*sizeof(short));
+    return srcSamples;
+  }
+
+  // Take only as much input as the output space needs
+  PINDEX have = m_history[0].size();
+  PINDEX consumed = 0;
+  if (dstFrames > 0) {
+    PUInt64 end = m_position + ((PUInt64)m_phase + (PUInt64)(dstFrames - 1)*m_down)/m_up + m_taps;
+    if (end > (PUInt64)have)
+      consumed = (PINDEX)std::min((PUInt64)srcFrames, end - have);
+  }
+  srcSamples = consumed*m_channels;
+
+  PINDEX size = have + consumed;
+  for (unsigned ch = 0; ch < m_channels; ++ch) {
+    std::vector<short> & history = m_history[ch];
+    history.resize(size);
+    if (m_channels == 1)
+      memcpy(&history[have], src, consumed*sizeof(short));
+    else {
+      for (PINDEX i = 0; i < consumed; ++i)
+        history[have + i] = src[i*m_channels + ch];
+    }
+  }
+
+  PINDEX produced = 0;
+  unsigned phase = m_phase;
+  PINDEX position = m_position;
+  for (unsigned ch = 0; ch < m_channels; ++ch) {
+    const short * history = &m_history[ch][0];
+    short * out = dst + ch;
+    phase = m_phase;
+    position = m_position;
+    produced = 0;
+    while (produced < dstFrames && position + m_taps <= size) {
+      int acc = DotProduct(history + position, &m_coefficients[phase*m_taps], m_taps);
+      *out = Saturate((acc + (1 << (CoefficientShift - 1))) >> CoefficientShift);
+      out += m_channels;
+      ++produced;
+
+      position += m_step;
+      phase += m_stepPhase;
+      if (phase >= m_up) {
+        phase -= m_up;
+        ++position;
+      }
+    }
+  }
+  m_phase = phase;
+  m_position = position;
+
+  // Drop history before the next window
+  PINDEX drop = std::min(m_position, size);
+  if (drop > 0) {
+    for (unsigned ch = 0; ch < m_channels; ++ch)
+      m_history[ch].erase(m_history[ch].begin(), m_history[ch].begin() + drop);
+    m_position -= drop;
+  }
+
+  return produced*m_channels;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PAudioMixer::Input::Input(PINDEX bufferSize, unsigned gain)
+  : m_ring(bufferSize)
+  , m_readPos(0)
+  , m_count(0)
+  , m_gain(gain)
+  , m_overruns(0)
+  , m_underruns(0)
+{
+}
+
+
+void PAudioMixer::Input::Push(const short * samples, PINDEX count)
+{
+  PINDEX size = m_ring.size();
+  if (count >= size) {
+    m_overruns += m_count + count - size;
+    memcpy(&m_ring[0], samples + count - size, size*sizeof(short));
+    m_readPos = 0;
+    m_count = size;
+    return;
+  }
+
+  // Lose the oldest to make room
+  if (m_count + count > size) {
+    PINDEX excess = m_count + count - size;
+    m_overruns += excess;
+    m_readPos = (m_readPos + excess)%size;
+    m_count -= excess;
+  }
+
+  PINDEX writePos = (m_readPos + m_count)%size;
+  PINDEX first = std::min(count, size - writePos);
+  memcpy(&m_ring[writePos], samples, first*sizeof(short));
+  memcpy(&m_ring[0], samples + first, (count - first)*sizeof(short));
+  m_count += count;
+}
+
+
+PINDEX PAudioMixer::Input::Pop(short * samples, PINDEX count)
+{
+  PINDEX size = m_ring.size();
+  count = std::min(count, m_count);
+  PINDEX first = std::min(count, size - m_readPos);
+  memcpy(samples, &m_ring[m_readPos], first*sizeof(short));
+  memcpy(samples + first, &m_ring[0], (count - first)*sizeof(short));
+  m_readPos = (m_readPos + count)%size;
+  m_count -= count;
+  return count;
+}
+
+
+PAudioMixer::PAudioMixer(unsigned sampleRate, unsigned channels, unsigned bufferMS)
+  : m_sampleRate(sampleRate)
+  , m_channels(std::max(channels, 1U))
+  , m_bufferSize(std::max((PINDEX)(sampleRate*bufferMS/1000), (PINDEX)1)*m_channels)
+  , m_nextID(0)
+  , m_frameSize(0)
+{
+}
+
+
+PAudioMixer::~PAudioMixer()
+{
+  for (InputMap::iterator it = m_inputs.begin(); it != m_inputs.end(); ++it)
+    delete it->second;
+}
+
+
+PAudioMixer::InputID PAudioMixer::AddInput(unsigned sampleRate, unsigned gain)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  Input * input = new Input(m_bufferSize, std::min(gain, (unsigned)MaxGain));
+  if (!input->m_resampler.SetRates(sampleRate != 0 ? sampleRate : m_sampleRate, m_sampleRate, m_channels)) {
+    delete input;
+    return 0;
+  }
+
+  do {
+    ++m_nextID;
+  } while (m_nextID == 0 || m_inputs.find(m_nextID) != m_inputs.end());
+
+  m_inputs[m_nextID] = input;
+  PTRACE(4, "Added input " << m_nextID << " at " << input->m_resampler.GetSrcRate() << "Hz, total " << m_inputs.size());
+  return m_nextID;
+}
+
+
+bool PAudioMixer::RemoveInput(InputID id)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  InputMap::iterator it = m_inputs.find(id);
+  if (it == m_inputs.end())
+    return false;
+
+  /* Take it out of the last mixed frame too, so a GetMixed() for the
+     remaining inputs is still correct. */
+  Input & input = *it->second;
+  for (PINDEX i = 0; i < (PINDEX)input.m_contribution.size() && i < m_frameSize; ++i)
+    m_total[i] -= input.m_contribution[i];
+
+  delete it->second;
+  m_inputs.erase(it);
+  PTRACE(4, "Removed input " << id << ", total " << m_inputs.size());
+  return true;
+}
+
+
+bool PAudioMixer::SetGain(InputID id, unsigned gain)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  InputMap::iterator it = m_inputs.find(id);
+  if (it == m_inputs.end())
+    return false;
+
+  it->second->m_gain = std::min(gain, (unsigned)MaxGain);
+  return true;
+}
+
+
+bool PAudioMixer::Write(InputID id, const short * samples, PINDEX count)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  InputMap::iterator it = m_inputs.find(id);
+  if (it == m_inputs.end())
+    return false;
+
+  Input & input = *it->second;
+  if (input.m_resampler.IsPassThrough()) {
+    input.Push(samples, count - count%m_channels);
+    return true;
+  }
+
+  m_converted.resize(input.m_resampler.GetMaxOutput(count));
+  PINDEX consumed = count;
+  input.Push(&m_converted[0], input.m_resampler.Process(samples, consumed, &m_converted[0], m_converted.size()));
+  return true;
+}
+
+
+/* Apply the gain to a frame, keeping the result as this input's
+   contribution and adding it to the total. With unity gain the samples are
+   just widened to 32 bits. */
+static void AddContribution(const short * samples, PINDEX count, unsigned gain, int * contribution, int * total)
+{
+  PINDEX i = 0;
+
+#if P_AUDIO_SSE2
+  if (gain == PAudioMixer::UnityGain) {
+    for (; i + 8 <= count; i += 8) {
+      __m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+      _mm_storeu_si128((__m128i *)(contribution + i),     lo);
+      _mm_storeu_si128((__m128i *)(contribution + i + 4), hi);
+      _mm_storeu_si128((__m128i *)(total + i),     _mm_add_epi32(_mm_loadu_si128((const __m128i *)(total + i)),     lo));
+      _mm_storeu_si128((__m128i *)(total + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(total + i + 4)), hi));
+    }
+  }
+  else {
+    __m128i g = _mm_set1_epi16((short)gain);
+    for (; i + 8 <= count; i += 8) {
+      __m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+      __m128i productLo = _mm_mullo_epi16(s, g);
+      __m128i productHi = _mm_mulhi_epi16(s, g);
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(productLo, productHi), PAudioMixer::GainShift);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(productLo, productHi), PAudioMixer::GainShift);
+      _mm_storeu_si128((__m128i *)(contribution + i),     lo);
+      _mm_storeu_si128((__m128i *)(contribution + i + 4), hi);
+      _mm_storeu_si128((__m128i *)(total + i),     _mm_add_epi32(_mm_loadu_si128((const __m128i *)(total + i)),     lo));
+      _mm_storeu_si128((__m128i *)(total + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(total + i + 4)), hi));
+    }
+  }
+#elif P_AUDIO_NEON
+  for (; i + 8 <= count; i += 8) {
+    int16x8_t s = vld1q_s16(samples + i);
+    int32x4_t lo, hi;
+    if (gain == PAudioMixer::UnityGain) {
+      lo = vmovl_s16(vget_low_s16(s));
+      hi = vmovl_s16(vget_high_s16(s));
+    }
+    else {
+      lo = vshrq_n_s32(vmull_n_s16(vget_low_s16(s),  (int16_t)gain), PAudioMixer::GainShift);
+      hi = vshrq_n_s32(vmull_n_s16(vget_high_s16(s), (int16_t)gain), PAudioMixer::GainShift);
+    }
+    vst1q_s32(contribution + i,     lo);
+    vst1q_s32(contribution + i + 4, hi);
+    vst1q_s32(total + i,     vaddq_s32(vld1q_s32(total + i),     lo));
+    vst1q_s32(total + i + 4, vaddq_s32(vld1q_s32(total + i + 4), hi));
+  }
+#endif
+
+  for (; i < count; ++i) {
+    int value = gain == PAudioMixer::UnityGain ? samples[i] : (samples[i]*(int)gain) >> PAudioMixer::GainShift;
+    contribution[i] = value;
+    total[i] += value;
+  }
+}
+
+
+void PAudioMixer::MixFrame(PINDEX count)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  count -= count%m_channels;
+  m_frameSize = count;
+  m_total.assign(count, 0);
+  m_frame.resize(count);
+  if (count == 0)
+    return;
+
+  for (InputMap::iterator it = m_inputs.begin(); it != m_inputs.end(); ++it) {
+    Input & input = *it->second;
+    PINDEX got = input.Pop(&m_frame[0], count);
+    if (got < count) {
+      memset(&m_frame[got], 0, (count - got)*sizeof(short));
+      input.m_underruns += count - got;
+    }
+    input.m_contribution.resize(count);
+    AddContribution(&m_frame[0], count, input.m_gain, &input.m_contribution[0], &m_total[0]);
+  }
+}
+
+
+bool PAudioMixer::GetMixed(short * output, InputID exclude) const
+{
+  PWaitAndSignal lock(m_mutex);
+
+  const int * total = m_frameSize > 0 ? &m_total[0] : NULL;
+  const int * subtract = NULL;
+  if (exclude != 0) {
+    InputMap::const_iterator it = m_inputs.find(exclude);
+    if (it == m_inputs.end())
+      return false;
+    if (m_frameSize > 0)
+      subtract = &it->second->m_contribution[0];
+  }
+
+  PINDEX i = 0;
+#if P_AUDIO_SSE2
+  for (; i + 8 <= m_frameSize; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(total + i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(total + i + 4));
+    if (subtract != NULL) {
+      lo = _mm_sub_epi32(lo, _mm_loadu_si128((const __m128i *)(subtract + i)));
+      hi = _mm_sub_epi32(hi, _mm_loadu_si128((const __m128i *)(subtract + i + 4)));
+    }
+    _mm_storeu_si128((__m128i *)(output + i), _mm_packs_epi32(lo, hi));
+  }
+#elif P_AUDIO_NEON
+  for (; i + 8 <= m_frameSize; i += 8) {
+    int32x4_t lo = vld1q_s32(total + i);
+    int32x4_t hi = vld1q_s32(total + i + 4);
+    if (subtract != NULL) {
+      lo = vsubq_s32(lo, vld1q_s32(subtract + i));
+      hi = vsubq_s32(hi, vld1q_s32(subtract + i + 4));
+    }
+    vst1q_s16(output + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+#endif
+
+  for (; i < m_frameSize; ++i)
+    output[i] = Saturate(subtract != NULL ? total[i] - subtract[i] : total[i]);
+
+  return true;
+}
+
+
+void PAudioMixer::Mix(short * output, PINDEX count)
+{
+  PWaitAndSignal lock(m_mutex);
+  MixFrame(count);
+  GetMixed(output);
+}
+
+
+PINDEX PAudioMixer::GetInputCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_inputs.size();
+}
+
+
+PUInt64 PAudioMixer::GetOverruns(InputID id) const
+{
+  PWaitAndSignal lock(m_mutex);
+  InputMap::const_iterator it = m_inputs.find(id);
+  return it != m_inputs.end() ? it->second->m_overruns : 0;
+}
+
+
+PUInt64 PAudioMixer::GetUnderruns(InputID id) const
+{
+  PWaitAndSignal lock(m_mutex);
+  InputMap::const_iterator it = m_inputs.find(id);
+  return it != m_inputs.end() ? it->second->m_underruns : 0;
+}
+
+
+// End Of File ///////////////////////////////////////////////////////////////
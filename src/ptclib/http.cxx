@@ -53,6 +53,7 @@ static char const * const HTTPCommands[PHTTP::NumCommands] = {
 
 
 const PCaselessString & PHTTP::HostTag             () { static const PConstCaselessString s("Host"); return s; }
+const PCaselessString & PHTTP::AcceptEncodingTag   () { static const PConstCaselessString s("Accept-Encoding"); return s; }
 const PCaselessString & PHTTP::AllowTag            () { static const PConstCaselessString s("Allow"); return s; }
 const PCaselessString & PHTTP::AuthorizationTag    () { static const PConstCaselessString s("Authorization"); return s; }
 const PCaselessString & PHTTP::ContentEncodingTag  () { static const PConstCaselessString s("Content-Encoding"); return s; }
@@ -68,6 +69,7 @@ const PCaselessString & PHTTP::PragmaNoCacheTag    () { static const PConstCasel
 const PCaselessString & PHTTP::RefererTag          () { static const PConstCaselessString s("Referer"); return s; }
 const PCaselessString & PHTTP::ServerTag           () { static const PConstCaselessString s("Server"); return s; }
 const PCaselessString & PHTTP::UserAgentTag        () { static const PConstCaselessString s("User-Agent"); return s; }
+const PCaselessString & PHTTP::VaryTag             () { static const PConstCaselessString s("Vary"); return s; }
 const PCaselessString & PHTTP::WWWAuthenticateTag  () { static const PConstCaselessString s("WWW-Authenticate"); return s; }
 const PCaselessString & PHTTP::MIMEVersionTag      () { static const PConstCaselessString s("MIME-Version"); return s; }
 const PCaselessString & PHTTP::ConnectionTag       () { static const PConstCaselessString s("Connection"); return s; }
@@ -78,6 +80,7 @@ const PCaselessString & PHTTP::WebSocketKeyTag     () { static const PConstCasel
 const PCaselessString & PHTTP::WebSocketAcceptTag  () { static const PConstCaselessString s("Sec-WebSocket-Accept"); return s; }
 const PCaselessString & PHTTP::WebSocketProtocolTag() { static const PConstCaselessString s("Sec-WebSocket-Protocol"); return s; }
 const PCaselessString & PHTTP::WebSocketVersionTag () { static const PConstCaselessString s("Sec-WebSocket-Version"); return s; }
+const PCaselessString & PHTTP::WebSocketExtensionsTag() { static const PConstCaselessString s("Sec-WebSocket-Extensions"); return s; }
 const PCaselessString & PHTTP::TransferEncodingTag () { static const PConstCaselessString s("Transfer-Encoding"); return s; }
 const PCaselessString & PHTTP::ChunkedTag          () { static const PConstCaselessString s("chunked"); return s; }
 const PCaselessString & PHTTP::ProxyConnectionTag  () { static const PConstCaselessString s("Proxy-Connection"); return s; }
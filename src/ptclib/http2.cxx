@@ -0,0 +1,1952 @@
+/*
+ * http2.cxx
+ *
+ * HyperText Transport Protocol version 2 classes.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#if P_HTTP
+
+#include <ptlib/sockets.h>
+#include <ptclib/http2.h>
+#include <ptclib/cypher.h>
+
+#define new PNEW
+#define PTraceModule() "HTTP2"
+
+
+//////////////////////////////////////////////////////////////////////////////
+// HPACK tables, RFC 7541 appendices A and B
+
+static const struct {
+  const char * m_name;
+  const char * m_value;
+} HPACKStaticTable[] = {
+  { ":authority", "" },
+  { ":method", "GET" },
+  { ":method", "POST" },
+  { ":path", "/" },
+  { ":path", "/index.html" },
+  { ":scheme", "http" },
+  { ":scheme", "https" },
+  { ":status", "200" },
+  { ":status", "204" },
+  { ":status", "206" },
+  { ":status", "304" },
+  { ":status", "400" },
+  { ":status", "404" },
+  { ":status", "500" },
+  { "accept-charset", "" },
+  { "accept-encoding", "gzip, deflate" },
+  { "accept-language", "" },
+  { "accept-ranges", "" },
+  { "accept", "" },
+  { "access-control-allow-origin", "" },
+  { "age", "" },
+  { "allow", "" },
+  { "authorization", "" },
+  { "cache-control", "" },
+  { "content-disposition", "" },
+  { "content-encoding", "" },
+  { "content-language", "" },
+  { "content-length", "" },
+  { "content-location", "" },
+  { "content-range", "" },
+  { "content-type", "" },
+  { "cookie", "" },
+  { "date", "" },
+  { "etag", "" },
+  { "expect", "" },
+  { "expires", "" },
+  { "from", "" },
+  { "host", "" },
+  { "if-match", "" },
+  { "if-modified-since", "" },
+  { "if-none-match", "" },
+  { "if-range", "" },
+  { "if-unmodified-since", "" },
+  { "last-modified", "" },
+  { "link", "" },
+  { "location", "" },
+  { "max-forwards", "" },
+  { "proxy-authenticate", "" },
+  { "proxy-authorization", "" },
+  { "range", "" },
+  { "referer", "" },
+  { "refresh", "" },
+  { "retry-after", "" },
+  { "server", "" },
+  { "set-cookie", "" },
+  { "strict-transport-security", "" },
+  { "transfer-encoding", "" },
+  { "user-agent", "" },
+  { "vary", "" },
+  { "via", "" },
+  { "www-authenticate", "" }
+};
+
+static const unsigned HPACKStaticTableSize = PARRAYSIZE(HPACKStaticTable);
+
+
+static const struct {
+  DWORD    m_code;
+  unsigned m_length;
+} HuffmanCodes[256] = {
+  { 0x00001ff8, 13 }, { 0x007fffd8, 23 }, { 0x0fffffe2, 28 }, { 0x0fffffe3, 28 },
+  { 0x0fffffe4, 28 }, { 0x0fffffe5, 28 }, { 0x0fffffe6, 28 }, { 0x0fffffe7, 28 },
+  { 0x0fffffe8, 28 }, { 0x00ffffea, 24 }, { 0x3ffffffc, 30 }, { 0x0fffffe9, 28 },
+  { 0x0fffffea, 28 }, { 0x3ffffffd, 30 }, { 0x0fffffeb, 28 }, { 0x0fffffec, 28 },
+  { 0x0fffffed, 28 }, { 0x0fffffee, 28 }, { 0x0fffffef, 28 }, { 0x0ffffff0, 28 },
+  { 0x0ffffff1, 28 }, { 0x0ffffff2, 28 }, { 0x3ffffffe, 30 }, { 0x0ffffff3, 28 },
+  { 0x0ffffff4, 28 }, { 0x0ffffff5, 28 }, { 0x0ffffff6, 28 }, { 0x0ffffff7, 28 },
+  { 0x0ffffff8, 28 }, { 0x0ffffff9, 28 }, { 0x0ffffffa, 28 }, { 0x0ffffffb, 28 },
+  { 0x00000014,  6 }, { 0x000003f8, 10 }, { 0x000003f9, 10 }, { 0x00000ffa, 12 },
+  { 0x00001ff9, 13 }, { 0x00000015,  6 }, { 0x000000f8,  8 }, { 0x000007fa, 11 },
+  { 0x000003fa, 10 }, { 0x000003fb, 10 }, { 0x000000f9,  8 }, { 0x000007fb, 11 },
+  { 0x000000fa,  8 }, { 0x00000016,  6 }, { 0x00000017,  6 }, { 0x00000018,  6 },
+  { 0x00000000,  5 }, { 0x00000001,  5 }, { 0x00000002,  5 }, { 0x00000019,  6 },
+  { 0x0000001a,  6 }, { 0x0000001b,  6 }, { 0x0000001c,  6 }, { 0x0000001d,  6 },
+  { 0x0000001e,  6 }, { 0x0000001f,  6 }, { 0x0000005c,  7 }, { 0x000000fb,  8 },
+  { 0x00007ffc, 15 }, { 0x00000020,  6 }, { 0x00000ffb, 12 }, { 0x000003fc, 10 },
+  { 0x00001ffa, 13 }, { 0x00000021,  6 }, { 0x0000005d,  7 }, { 0x0000005e,  7 },
+  { 0x0000005f,  7 }, { 0x00000060,  7 }, { 0x00000061,  7 }, { 0x00000062,  7 },
+  { 0x00000063,  7 }, { 0x00000064,  7 }, { 0x00000065,  7 }, { 0x00000066,  7 },
+  { 0x00000067,  7 }, { 0x00000068,  7 }, { 0x00000069,  7 }, { 0x0000006a,  7 },
+  { 0x0000006b,  7 }, { 0x0000006c,  7 }, { 0x0000006d,  7 }, { 0x0000006e,  7 },
+  { 0x0000006f,  7 }, { 0x00000070,  7 }, { 0x00000071,  7 }, { 0x00000072,  7 },
+  { 0x000000fc,  8 }, { 0x00000073,  7 }, { 0x000000fd,  8 }, { 0x00001ffb, 13 },
+  { 0x0007fff0, 19 }, { 0x00001ffc, 13 }, { 0x00003ffc, 14 }, { 0x00000022,  6 },
+  { 0x00007ffd, 15 }, { 0x00000003,  5 }, { 0x00000023,  6 }, { 0x00000004,  5 },
+  { 0x00000024,  6 }, { 0x00000005,  5 }, { 0x00000025,  6 }, { 0x00000026,  6 },
+  { 0x00000027,  6 }, { 0x00000006,  5 }, { 0x00000074,  7 }, { 0x00000075,  7 },
+  { 0x00000028,  6 }, { 0x00000029,  6 }, { 0x0000002a,  6 }, { 0x00000007,  5 },
+  { 0x0000002b,  6 }, { 0x00000076,  7 }, { 0x0000002c,  6 }, { 0x00000008,  5 },
+  { 0x00000009,  5 }, { 0x0000002d,  6 }, { 0x00000077,  7 }, { 0x00000078,  7 },
+  { 0x00000079,  7 }, { 0x0000007a,  7 }, { 0x0000007b,  7 }, { 0x00007ffe, 15 },
+  { 0x000007fc, 11 }, { 0x00003ffd, 14 }, { 0x00001ffd, 13 }, { 0x0ffffffc, 28 },
+  { 0x000fffe6, 20 }, { 0x003fffd2, 22 }, { 0x000fffe7, 20 }, { 0x000fffe8, 20 },
+  { 0x003fffd3, 22 }, { 0x003fffd4, 22 }, { 0x003fffd5, 22 }, { 0x007fffd9, 23 },
+  { 0x003fffd6, 22 }, { 0x007fffda, 23 }, { 0x007fffdb, 23 }, { 0x007fffdc, 23 },
+  { 0x007fffdd, 23 }, { 0x007fffde, 23 }, { 0x00ffffeb, 24 }, { 0x007fffdf, 23 },
+  { 0x00ffffec, 24 }, { 0x00ffffed, 24 }, { 0x003fffd7, 22 }, { 0x007fffe0, 23 },
+  { 0x00ffffee, 24 }, { 0x007fffe1, 23 }, { 0x007fffe2, 23 }, { 0x007fffe3, 23 },
+  { 0x007fffe4, 23 }, { 0x001fffdc, 21 }, { 0x003fffd8, 22 }, { 0x007fffe5, 23 },
+  { 0x003fffd9, 22 }, { 0x007fffe6, 23 }, { 0x007fffe7, 23 }, { 0x00ffffef, 24 },
+  { 0x003fffda, 22 }, { 0x001fffdd, 21 }, { 0x000fffe9, 20 }, { 0x003fffdb, 22 },
+  { 0x003fffdc, 22 }, { 0x007fffe8, 23 }, { 0x007fffe9, 23 }, { 0x001fffde, 21 },
+  { 0x007fffea, 23 }, { 0x003fffdd, 22 }, { 0x003fffde, 22 }, { 0x00fffff0, 24 },
+  { 0x001fffdf, 21 }, { 0x003fffdf, 22 }, { 0x007fffeb, 23 }, { 0x007fffec, 23 },
+  { 0x001fffe0, 21 }, { 0x001fffe1, 21 }, { 0x003fffe0, 22 }, { 0x001fffe2, 21 },
+  { 0x007fffed, 23 }, { 0x003fffe1, 22 }, { 0x007fffee, 23 }, { 0x007fffef, 23 },
+  { 0x000fffea, 20 }, { 0x003fffe2, 22 }, { 0x003fffe3, 22 }, { 0x003fffe4, 22 },
+  { 0x007ffff0, 23 }, { 0x003fffe5, 22 }, { 0x003fffe6, 22 }, { 0x007ffff1, 23 },
+  { 0x03ffffe0, 26 }, { 0x03ffffe1, 26 }, { 0x000fffeb, 20 }, { 0x0007fff1, 19 },
+  { 0x003fffe7, 22 }, { 0x007ffff2, 23 }, { 0x003fffe8, 22 }, { 0x01ffffec, 25 },
+  { 0x03ffffe2, 26 }, { 0x03ffffe3, 26 }, { 0x03ffffe4, 26 }, { 0x07ffffde, 27 },
+  { 0x07ffffdf, 27 }, { 0x03ffffe5, 26 }, { 0x00fffff1, 24 }, { 0x01ffffed, 25 },
+  { 0x0007fff2, 19 }, { 0x001fffe3, 21 }, { 0x03ffffe6, 26 }, { 0x07ffffe0, 27 },
+  { 0x07ffffe1, 27 }, { 0x03ffffe7, 26 }, { 0x07ffffe2, 27 }, { 0x00fffff2, 24 },
+  { 0x001fffe4, 21 }, { 0x001fffe5, 21 }, { 0x03ffffe8, 26 }, { 0x03ffffe9, 26 },
+  { 0x0ffffffd, 28 }, { 0x07ffffe3, 27 }, { 0x07ffffe4, 27 }, { 0x07ffffe5, 27 },
+  { 0x000fffec, 20 }, { 0x00fffff3, 24 }, { 0x000fffed, 20 }, { 0x001fffe6, 21 },
+  { 0x003fffe9, 22 }, { 0x001fffe7, 21 }, { 0x001fffe8, 21 }, { 0x007ffff3, 23 },
+  { 0x003fffea, 22 }, { 0x003fffeb, 22 }, { 0x01ffffee, 25 }, { 0x01ffffef, 25 },
+  { 0x00fffff4, 24 }, { 0x00fffff5, 24 }, { 0x03ffffea, 26 }, { 0x007ffff4, 23 },
+  { 0x03ffffeb, 26 }, { 0x07ffffe6, 27 }, { 0x03ffffec, 26 }, { 0x03ffffed, 26 },
+  { 0x07ffffe7, 27 }, { 0x07ffffe8, 27 }, { 0x07ffffe9, 27 }, { 0x07ffffea, 27 },
+  { 0x07ffffeb, 27 }, { 0x0ffffffe, 28 }, { 0x07ffffec, 27 }, { 0x07ffffed, 27 },
+  { 0x07ffffee, 27 }, { 0x07ffffef, 27 }, { 0x07fffff0, 27 }, { 0x03ffffee, 26 }
+};
+
+
+static const PHPACK::Field * GetStaticEntry(unsigned index)
+{
+  static struct Table : std::vector<PHPACK::Field> {
+    Table()
+    {
+      for (unsigned i = 0; i < HPACKStaticTableSize; ++i)
+        push_back(PHPACK::Field(HPACKStaticTable[i].m_name, HPACKStaticTable[i].m_value));
+    }
+  } const table;
+  return &table[index-1];
+}
+
+
+/* Decoding tree for the Huffman code, eight bits at a time. An entry with
+   children is an interior node, otherwise it is the symbol for the bits
+   which index it, where only m_bits of the eight bits were part of its code.
+ */
+struct HuffmanNode
+{
+  HuffmanNode() : m_children(NULL), m_symbol(0), m_bits(0) { }
+  ~HuffmanNode() { delete [] m_children; }
+
+  HuffmanNode * m_children;
+  BYTE          m_symbol;
+  BYTE          m_bits;
+};
+
+
+static const HuffmanNode & GetHuffmanTree()
+{
+  static struct Tree : HuffmanNode {
+    Tree()
+    {
+      m_children = new HuffmanNode[256];
+      for (unsigned symbol = 0; symbol < 256; ++symbol) {
+        DWORD code = HuffmanCodes[symbol].m_code;
+        unsigned length = HuffmanCodes[symbol].m_length;
+
+        HuffmanNode * node = this;
+        while (length > 8) {
+          length -= 8;
+          HuffmanNode & child = node->m_children[(code >> length) & 0xff];
+          if (child.m_children == NULL)
+            child.m_children = new HuffmanNode[256];
+          node = &child;
+        }
+
+        unsigned shift = 8 - length;
+        unsigned start = (code << shift) & 0xff;
+        for (unsigned i = 0; i < (1U << shift); ++i) {
+          HuffmanNode & leaf = node->m_children[start + i];
+          leaf.m_symbol = (BYTE)symbol;
+          leaf.m_bits = (BYTE)length;
+        }
+      }
+    }
+  } const tree;
+  return tree;
+}
+
+
+static PINDEX HuffmanLength(const BYTE * data, PINDEX length)
+{
+  PUInt64 bits = 0;
+  for (PINDEX i = 0; i < length; ++i)
+    bits += HuffmanCodes[data[i]].m_length;
+  return (PINDEX)((bits + 7) / 8);
+}
+
+
+static void HuffmanEncode(const BYTE * data, PINDEX length, BYTE * output)
+{
+  PUInt64 bits = 0;
+  unsigned count = 0;
+  for (PINDEX i = 0; i < length; ++i) {
+    bits = (bits << HuffmanCodes[data[i]].m_length) | HuffmanCodes[data[i]].m_code;
+    count += HuffmanCodes[data[i]].m_length;
+    while (count >= 8) {
+      count -= 8;
+      *output++ = (BYTE)(bits >> count);
+    }
+  }
+
+  // Pad with the most significant bits of EOS, which are all ones
+  if (count > 0)
+    *output = (BYTE)((bits << (8 - count)) | (0xff >> count));
+}
+
+
+static bool HuffmanDecode(const BYTE * data, PINDEX length, PString & str)
+{
+  const HuffmanNode & root = GetHuffmanTree();
+
+  // Shortest code is five bits
+  char * output = str.GetPointerAndSetLength(length*8/5 + 1);
+  char * ptr = output;
+
+  const HuffmanNode * node = &root;
+  DWORD current = 0;
+  unsigned currentBits = 0;
+  unsigned symbolBits = 0;
+  for (PINDEX i = 0; i < length; ++i) {
+    current = (current << 8) | data[i];
+    currentBits += 8;
+    symbolBits += 8;
+    while (currentBits >= 8) {
+      const HuffmanNode & next = node->m_children[(current >> (currentBits - 8)) & 0xff];
+      if (next.m_children != NULL) {
+        node = &next;
+        currentBits -= 8;
+      }
+      else {
+        if (next.m_bits == 0)
+          return false; // EOS, or invalid code
+        *ptr++ = next.m_symbol;
+        currentBits -= next.m_bits;
+        node = &root;
+        symbolBits = currentBits;
+      }
+    }
+  }
+
+  while (currentBits > 0) {
+    const HuffmanNode & next = node->m_children[(current << (8 - currentBits)) & 0xff];
+    if (next.m_children != NULL || next.m_bits == 0 || next.m_bits > currentBits)
+      break;
+    *ptr++ = next.m_symbol;
+    currentBits -= next.m_bits;
+    node = &root;
+    symbolBits = currentBits;
+  }
+
+  // Padding must be less than eight bits, and be ones
+  if (symbolBits > 7)
+    return false;
+  DWORD mask = (1 << currentBits) - 1;
+  if ((current & mask) != mask)
+    return false;
+
+  *ptr = '\0';
+  str.MakeMinimumSize(ptr - output);
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHPACK
+
+PHPACK::PHPACK()
+  : m_tableSize(0)
+  , m_maxTableSize(DefaultTableSize)
+{
+}
+
+
+void PHPACK::SetTableLimit(unsigned size)
+{
+  m_maxTableSize = size;
+  while (m_tableSize > m_maxTableSize) {
+    const Field & oldest = m_dynamicTable.back();
+    m_tableSize -= oldest.m_name.GetLength() + oldest.m_value.GetLength() + EntryOverhead;
+    m_dynamicTable.pop_back();
+  }
+}
+
+
+void PHPACK::AddEntry(const PString & name, const PString & value)
+{
+  unsigned size = name.GetLength() + value.GetLength() + EntryOverhead;
+
+  // An entry larger than the table empties it, and is not added
+  if (size > m_maxTableSize) {
+    m_dynamicTable.clear();
+    m_tableSize = 0;
+    return;
+  }
+
+  while (m_tableSize + size > m_maxTableSize) {
+    const Field & oldest = m_dynamicTable.back();
+    m_tableSize -= oldest.m_name.GetLength() + oldest.m_value.GetLength() + EntryOverhead;
+    m_dynamicTable.pop_back();
+  }
+
+  m_dynamicTable.push_front(Field(name, value));
+  m_tableSize += size;
+}
+
+
+const PHPACK::Field * PHPACK::GetEntry(unsigned index) const
+{
+  if (index == 0)
+    return NULL;
+
+  if (index <= HPACKStaticTableSize)
+    return GetStaticEntry(index);
+
+  index -= HPACKStaticTableSize + 1;
+  return index < m_dynamicTable.size() ? &m_dynamicTable[index] : NULL;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHPACKEncoder
+
+namespace {
+  struct BlockWriter
+  {
+    BlockWriter(PBYTEArray & block, PINDEX & length)
+      : m_block(block)
+      , m_length(length)
+    {
+    }
+
+    BYTE * Reserve(PINDEX size)
+    {
+      if (m_length + size > m_block.GetSize())
+        m_block.SetSize(std::max(m_length + size, m_block.GetSize()*2));
+      BYTE * ptr = m_block.GetPointer() + m_length;
+      m_length += size;
+      return ptr;
+    }
+
+    void Integer(BYTE flags, unsigned prefixBits, unsigned value)
+    {
+      unsigned prefixMax = (1 << prefixBits) - 1;
+      if (value < prefixMax) {
+        *Reserve(1) = (BYTE)(flags | value);
+        return;
+      }
+
+      *Reserve(1) = (BYTE)(flags | prefixMax);
+      value -= prefixMax;
+      while (value >= 0x80) {
+        *Reserve(1) = (BYTE)((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      *Reserve(1) = (BYTE)value;
+    }
+
+    void String(const PString & str)
+    {
+      const BYTE * data = (const BYTE *)(const char *)str;
+      PINDEX length = str.GetLength();
+      PINDEX huffmanLength = HuffmanLength(data, length);
+      if (huffmanLength < length) {
+        Integer(0x80, 7, huffmanLength);
+        HuffmanEncode(data, length, Reserve(huffmanLength));
+      }
+      else {
+        Integer(0, 7, length);
+        memcpy(Reserve(length), data, length);
+      }
+    }
+
+    PBYTEArray & m_block;
+    PINDEX     & m_length;
+  };
+
+  enum Indexing {
+    IncrementalIndexing = 0x40,
+    WithoutIndexing     = 0x00,
+    NeverIndexed        = 0x10
+  };
+
+  Indexing GetIndexing(const PString & name, const PString & value)
+  {
+    // Credentials are not put where a compression oracle could find them
+    if (name == "authorization" || name == "proxy-authorization" || (name == "cookie" && value.GetLength() < 20))
+      return NeverIndexed;
+
+    // Unlikely to be repeated, so would just push useful entries out
+    if (value.GetLength() > PHPACK::DefaultTableSize/4 ||
+        name == ":path" ||
+        name == "content-length" ||
+        name == "date" ||
+        name == "etag" ||
+        name == "last-modified" ||
+        name == "if-modified-since" ||
+        name == "if-none-match" ||
+        name == "location" ||
+        name == "set-cookie")
+      return WithoutIndexing;
+
+    return IncrementalIndexing;
+  }
+}
+
+
+PHPACKEncoder::PHPACKEncoder()
+  : m_sizeUpdate(UINT_MAX)
+{
+}
+
+
+void PHPACKEncoder::SetMaxTableSize(unsigned size)
+{
+  // We never use more than the default, whatever the peer allows
+  size = std::min(size, (unsigned)DefaultTableSize);
+  if (size == m_maxTableSize)
+    return;
+
+  // If it shrinks then grows before the next block, the smallest must be signalled
+  m_sizeUpdate = std::min(m_sizeUpdate, size);
+  SetTableLimit(size);
+}
+
+
+void PHPACKEncoder::Encode(const FieldList & fields, PBYTEArray & block, PINDEX & length)
+{
+  BlockWriter writer(block, length);
+
+  if (m_sizeUpdate != UINT_MAX) {
+    writer.Integer(0x20, 5, m_sizeUpdate);
+    if (m_sizeUpdate != m_maxTableSize)
+      writer.Integer(0x20, 5, m_maxTableSize);
+    m_sizeUpdate = UINT_MAX;
+  }
+
+  for (FieldList::const_iterator field = fields.begin(); field != fields.end(); ++field) {
+    const PString & name = field->m_name;
+    const PString & value = field->m_value;
+
+    unsigned nameIndex = 0;
+    unsigned index = 0;
+    for (unsigned i = 0; i < HPACKStaticTableSize; ++i) {
+      if (name == HPACKStaticTable[i].m_name) {
+        if (nameIndex == 0)
+          nameIndex = i+1;
+        if (value == HPACKStaticTable[i].m_value) {
+          index = i+1;
+          break;
+        }
+      }
+    }
+
+    if (index == 0) {
+      for (unsigned i = 0; i < m_dynamicTable.size(); ++i) {
+        const Field & entry = m_dynamicTable[i];
+        if (name == entry.m_name) {
+          if (nameIndex == 0)
+            nameIndex = HPACKStaticTableSize + 1 + i;
+          if (value == entry.m_value) {
+            index = HPACKStaticTableSize + 1 + i;
+            break;
+          }
+        }
+      }
+    }
+
+    if (index != 0) {
+      writer.Integer(0x80, 7, index);
+      continue;
+    }
+
+    Indexing indexing = GetIndexing(name, value);
+    if (indexing == IncrementalIndexing)
+      writer.Integer(IncrementalIndexing, 6, nameIndex);
+    else
+      writer.Integer((BYTE)indexing, 4, nameIndex);
+
+    if (nameIndex == 0)
+      writer.String(name);
+    writer.String(value);
+
+    if (indexing == IncrementalIndexing)
+      AddEntry(name, value);
+  }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHPACKDecoder
+
+static bool DecodeInteger(const BYTE * & ptr, const BYTE * end, unsigned prefixBits, unsigned & value)
+{
+  if (ptr >= end)
+    return false;
+
+  unsigned prefixMax = (1 << prefixBits) - 1;
+  value = *ptr++ & prefixMax;
+  if (value < prefixMax)
+    return true;
+
+  for (unsigned shift = 0; shift < 28; shift += 7) {
+    if (ptr >= end)
+      return false;
+    BYTE octet = *ptr++;
+    value += (octet & 0x7f) << shift;
+    if ((octet & 0x80) == 0)
+      return true;
+  }
+
+  return false; // Unreasonably large
+}
+
+
+static bool DecodeString(const BYTE * & ptr, const BYTE * end, PString & str)
+{
+  if (ptr >= end)
+    return false;
+
+  bool huffman = (*ptr & 0x80) != 0;
+  unsigned length;
+  if (!DecodeInteger(ptr, end, 7, length) || length > (unsigned)(end - ptr))
+    return false;
+
+  if (huffman) {
+    if (!HuffmanDecode(ptr, length, str))
+      return false;
+  }
+  else
+    str = PString((const char *)ptr, length);
+
+  ptr += length;
+  return true;
+}
+
+
+PHPACKDecoder::PHPACKDecoder()
+  : m_allowedTableSize(DefaultTableSize)
+{
+}
+
+
+void PHPACKDecoder::SetMaxTableSize(unsigned size)
+{
+  m_allowedTableSize = size;
+}
+
+
+bool PHPACKDecoder::Decode(const BYTE * data, PINDEX length, FieldList & fields)
+{
+  const BYTE * ptr = data;
+  const BYTE * end = data + length;
+  bool sizeUpdateAllowed = true;
+
+  while (ptr < end) {
+    BYTE first = *ptr;
+
+    if ((first & 0xe0) == 0x20) {
+      // Dynamic table size update, only at the start of a block
+      unsigned size;
+      if (!sizeUpdateAllowed || !DecodeInteger(ptr, end, 5, size) || size > m_allowedTableSize) {
+        PTRACE(2, "Invalid dynamic table size update");
+        return false;
+      }
+      SetTableLimit(size);
+      continue;
+    }
+
+    sizeUpdateAllowed = false;
+
+    if ((first & 0x80) != 0) {
+      // Indexed header field
+      unsigned index;
+      const Field * entry;
+      if (!DecodeInteger(ptr, end, 7, index) || (entry = GetEntry(index)) == NULL) {
+        PTRACE(2, "Invalid header field index");
+        return false;
+      }
+      fields.push_back(*entry);
+      continue;
+    }
+
+    // Literal header field, with, without or never indexed
+    bool incremental = (first & 0x40) != 0;
+    unsigned nameIndex;
+    if (!DecodeInteger(ptr, end, incremental ? 6 : 4, nameIndex))
+      return false;
+
+    Field field;
+    if (nameIndex == 0) {
+      if (!DecodeString(ptr, end, field.m_name))
+        return false;
+    }
+    else {
+      const Field * entry = GetEntry(nameIndex);
+      if (entry == NULL) {
+        PTRACE(2, "Invalid header name index");
+        return false;
+      }
+      field.m_name = entry->m_name;
+    }
+
+    if (!DecodeString(ptr, end, field.m_value))
+      return false;
+
+    if (incremental)
+      AddEntry(field.m_name, field.m_value);
+    fields.push_back(field);
+  }
+
+  return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHTTP2Connection
+
+const char PHTTP2Connection::Preface[PHTTP2Connection::PrefaceSize+1] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const char * const PHTTP2Connection::ALPN = "h2";
+const char * const PHTTP2Connection::UpgradeName = "h2c";
+const PCaselessString & PHTTP2Connection::SettingsTag() { static const PConstCaselessString s("HTTP2-Settings"); return s; }
+
+// Largest header block we will accumulate from CONTINUATION frames
+static const PINDEX MaxHeaderBlockSize = 256*1024;
+
+static DWORD Get16(const BYTE * ptr) { return (ptr[0] << 8) | ptr[1]; }
+static DWORD Get31(const BYTE * ptr) { return ((ptr[0] & 0x7f) << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3]; }
+static DWORD Get32(const BYTE * ptr) { return ((DWORD)ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3]; }
+
+static void Put16(BYTE * ptr, DWORD value) { ptr[0] = (BYTE)(value >> 8); ptr[1] = (BYTE)value; }
+static void Put32(BYTE * ptr, DWORD value) { ptr[0] = (BYTE)(value >> 24); ptr[1] = (BYTE)(value >> 16); ptr[2] = (BYTE)(value >> 8); ptr[3] = (BYTE)value; }
+
+static void SetFrameHeader(BYTE * ptr, PINDEX length, BYTE type, BYTE flags, DWORD streamId)
+{
+  ptr[0] = (BYTE)(length >> 16);
+  ptr[1] = (BYTE)(length >> 8);
+  ptr[2] = (BYTE)length;
+  ptr[3] = type;
+  ptr[4] = flags;
+  Put32(ptr+5, streamId);
+}
+
+
+PHTTP2Connection::Stream::Stream(int sendWindow, int receiveWindow)
+  : m_sendWindow(sendWindow)
+  , m_receiveWindow(receiveWindow)
+  , m_receiveUnacknowledged(0)
+  , m_localClosed(false)
+  , m_remoteClosed(false)
+{
+}
+
+
+PHTTP2Connection::PHTTP2Connection(bool isServer)
+  : m_isServer(isServer)
+  , m_expectPreface(isServer)
+  , m_expectSettings(true)
+  , m_started(false)
+  , m_failed(false)
+  , m_goingAway(false)
+  , m_localMaxConcurrentStreams(DefaultMaxConcurrentStreams)
+  , m_localWindowSize(DefaultReceiveWindow)
+  , m_peerMaxConcurrentStreams(DefaultMaxConcurrentStreams)
+  , m_peerInitialWindowSize(DefaultWindowSize)
+  , m_peerMaxFrameSize(DefaultMaxFrameSize)
+  , m_connectionSendWindow(DefaultWindowSize)
+  , m_connectionReceiveWindow(DefaultWindowSize)
+  , m_connectionReceiveUnacknowledged(0)
+  , m_nextStreamId(isServer ? 2 : 1)
+  , m_lastPeerStreamId(0)
+  , m_headerStreamId(0)
+  , m_headerEndStream(false)
+  , m_headerLength(0)
+  , m_inputStart(0)
+  , m_inputEnd(0)
+  , m_outputLength(0)
+  , m_acknowledgementLength(0)
+{
+}
+
+
+void PHTTP2Connection::Start()
+{
+  if (m_started)
+    return;
+  m_started = true;
+
+  if (!m_isServer) {
+    memcpy(m_output.GetPointer(m_outputLength + PrefaceSize) + m_outputLength, Preface, PrefaceSize);
+    m_outputLength += PrefaceSize;
+  }
+
+  unsigned count = 2;
+  if (m_localWindowSize != DefaultWindowSize)
+    ++count;
+
+  BYTE * settings = AppendFrame(SettingsFrame, 0, 0, count*6);
+  Put16(settings, EnablePushSetting);
+  Put32(settings+2, 0);
+  Put16(settings+6, MaxConcurrentStreamsSetting);
+  Put32(settings+8, m_localMaxConcurrentStreams);
+  if (m_localWindowSize != DefaultWindowSize) {
+    Put16(settings+12, InitialWindowSizeSetting);
+    Put32(settings+14, m_localWindowSize);
+  }
+
+  // The connection window can only be changed by WINDOW_UPDATE
+  if (m_localWindowSize > DefaultWindowSize) {
+    Put32(AppendFrame(WindowUpdateFrame, 0, 0, 4), m_localWindowSize - DefaultWindowSize);
+    m_connectionReceiveWindow = m_localWindowSize;
+  }
+
+  PTRACE(4, (m_isServer ? "Server" : "Client") << " started:"
+            " maxStreams=" << m_localMaxConcurrentStreams << ","
+            " window=" << m_localWindowSize);
+}
+
+
+bool PHTTP2Connection::StartUpgrade(const PString & settings)
+{
+  PBYTEArray data;
+  if (!PBase64::Decode(settings, data) || data.GetSize() % 6 != 0)
+    return ConnectionError(ProtocolError, "Invalid HTTP2-Settings header");
+
+  for (PINDEX i = 0; i < data.GetSize(); i += 6) {
+    if (!ApplySetting(Get16(&data[i]), Get32(&data[i+2])))
+      return false;
+  }
+
+  // Stream 1 is the upgraded request, half closed in the direction it was sent
+  Stream & stream = m_streams.insert(StreamMap::value_type(1, Stream(m_peerInitialWindowSize, m_localWindowSize))).first->second;
+  if (m_isServer) {
+    stream.m_remoteClosed = true;
+    m_lastPeerStreamId = 1;
+  }
+  else {
+    stream.m_localClosed = true;
+    m_nextStreamId = 3;
+  }
+  return true;
+}
+
+
+BYTE * PHTTP2Connection::GetReceiveBuffer(PINDEX & size)
+{
+  static const PINDEX Wanted = DefaultMaxFrameSize + FrameHeaderSize;
+
+  if (m_inputStart == m_inputEnd)
+    m_inputStart = m_inputEnd = 0;
+
+  if (m_input.GetSize() - m_inputEnd < Wanted) {
+    // Move partial frame to the start, and grow if still not room for a whole frame
+    if (m_inputStart > 0) {
+      memmove(m_input.GetPointer(), m_input.GetPointer() + m_inputStart, m_inputEnd - m_inputStart);
+      m_inputEnd -= m_inputStart;
+      m_inputStart = 0;
+    }
+    if (m_input.GetSize() - m_inputEnd < Wanted)
+      m_input.SetSize(m_inputEnd + Wanted*2);
+  }
+
+  size = m_input.GetSize() - m_inputEnd;
+  return m_input.GetPointer() + m_inputEnd;
+}
+
+
+bool PHTTP2Connection::ProcessReceived(PINDEX size)
+{
+  m_inputEnd += size;
+
+  if (m_failed)
+    return false;
+
+  if (m_expectPreface) {
+    PINDEX available = std::min(m_inputEnd - m_inputStart, (PINDEX)PrefaceSize);
+    if (memcmp(m_input.GetPointer() + m_inputStart, Preface, available) != 0)
+      return ConnectionError(ProtocolError, "Invalid connection preface");
+    if (available < PrefaceSize)
+      return true;
+    m_inputStart += PrefaceSize;
+    m_expectPreface = false;
+  }
+
+  while (m_inputEnd - m_inputStart >= FrameHeaderSize) {
+    const BYTE * header = m_input.GetPointer() + m_inputStart;
+    PINDEX length = (header[0] << 16) | (header[1] << 8) | header[2];
+    if (length > DefaultMaxFrameSize)
+      return ConnectionError(FrameSizeError, "Frame larger than SETTINGS_MAX_FRAME_SIZE");
+    if (m_inputEnd - m_inputStart < FrameHeaderSize + length)
+      break;
+
+    m_inputStart += FrameHeaderSize + length;
+    if (!ProcessFrame(header[3], header[4], Get31(header+5), header + FrameHeaderSize, length))
+      return false;
+  }
+
+  return true;
+}
+
+
+void PHTTP2Connection::GetOutput(PBYTEArray & buffer, PINDEX & length)
+{
+  PBYTEArray previous = buffer;
+  buffer = m_output;
+  m_output = previous;
+  length = m_outputLength;
+  m_outputLength = 0;
+  m_acknowledgementLength = 0;
+}
+
+
+bool PHTTP2Connection::IsConnectionSpecific(const PCaselessString & name)
+{
+  return name == PHTTP::ConnectionTag() ||
+         name == PHTTP::KeepAliveTag() ||
+         name == PHTTP::ProxyConnectionTag() ||
+         name == PHTTP::TransferEncodingTag() ||
+         name == PHTTP::UpgradeTag();
+}
+
+
+bool PHTTP2Connection::CanOpenStream() const
+{
+  return !m_isServer && !m_goingAway && !m_failed &&
+         m_streams.size() < m_peerMaxConcurrentStreams &&
+         m_nextStreamId <= MaxWindowSize;
+}
+
+
+DWORD PHTTP2Connection::OpenStream()
+{
+  if (!CanOpenStream())
+    return 0;
+
+  DWORD streamId = m_nextStreamId;
+  m_nextStreamId += 2;
+  m_streams.insert(StreamMap::value_type(streamId, Stream(m_peerInitialWindowSize, m_localWindowSize)));
+  return streamId;
+}
+
+
+bool PHTTP2Connection::SendHeaders(DWORD streamId, const PHPACK::FieldList & fields, bool endStream)
+{
+  StreamMap::iterator it = m_streams.find(streamId);
+  if (it == m_streams.end() || it->second.m_localClosed || m_failed)
+    return false;
+
+  // Encode straight into the output, after room for the frame header
+  PINDEX frameStart = m_outputLength;
+  AppendFrame(HeadersFrame, 0, streamId, 0);
+  m_encoder.Encode(fields, m_output, m_outputLength);
+
+  BYTE flags = (BYTE)(endStream ? EndStreamFlag : 0);
+  PINDEX blockLength = m_outputLength - frameStart - FrameHeaderSize;
+  if (blockLength <= (PINDEX)m_peerMaxFrameSize)
+    SetFrameHeader(m_output.GetPointer() + frameStart, blockLength, HeadersFrame, flags | EndHeadersFlag, streamId);
+  else {
+    // Too big for one frame, so split into HEADERS and CONTINUATION frames
+    PBYTEArray block(m_output.GetPointer() + frameStart + FrameHeaderSize, blockLength);
+    m_outputLength = frameStart;
+    BYTE type = HeadersFrame;
+    for (PINDEX offset = 0; offset < blockLength; offset += m_peerMaxFrameSize) {
+      PINDEX length = std::min(blockLength - offset, (PINDEX)m_peerMaxFrameSize);
+      if (offset + length == blockLength)
+        flags |= EndHeadersFlag;
+      memcpy(AppendFrame(type, flags, streamId, length), block + offset, length);
+      type = ContinuationFrame;
+      flags = 0;
+    }
+  }
+
+  if (endStream)
+    CloseStream(it, true);
+  return true;
+}
+
+
+PINDEX PHTTP2Connection::SendData(DWORD streamId, const void * data, PINDEX length, bool endStream)
+{
+  StreamMap::iterator it = m_streams.find(streamId);
+  if (it == m_streams.end() || it->second.m_localClosed || m_failed)
+    return P_MAX_INDEX;
+
+  Stream & stream = it->second;
+  PINDEX sent = 0;
+  do {
+    int window = std::min(stream.m_sendWindow, m_connectionSendWindow);
+    PINDEX chunk = std::min(length - sent, (PINDEX)m_peerMaxFrameSize);
+    if (window <= 0)
+      chunk = 0;
+    else if (chunk > (PINDEX)window)
+      chunk = window;
+    if (chunk == 0 && sent < length)
+      break;
+
+    bool last = endStream && sent + chunk == length;
+    memcpy(AppendFrame(DataFrame, (BYTE)(last ? EndStreamFlag : 0), streamId, chunk), (const BYTE *)data + sent, chunk);
+    sent += chunk;
+    stream.m_sendWindow -= chunk;
+    m_connectionSendWindow -= chunk;
+  } while (sent < length);
+
+  if (endStream && sent == length)
+    CloseStream(it, true);
+  return sent;
+}
+
+
+void PHTTP2Connection::ResetStream(DWORD streamId, ErrorCode error)
+{
+  PTRACE(4, "Resetting stream " << streamId << ", error=" << error);
+  Put32(AppendFrame(ResetStreamFrame, 0, streamId, 4), error);
+  m_streams.erase(streamId);
+}
+
+
+void PHTTP2Connection::GoAway(ErrorCode error)
+{
+  if (m_goingAway)
+    return;
+
+  PTRACE(4, "Going away, last stream " << m_lastPeerStreamId << ", error=" << error);
+  BYTE * payload = AppendFrame(GoAwayFrame, 0, 0, 8);
+  Put32(payload, m_lastPeerStreamId);
+  Put32(payload+4, error);
+  m_goingAway = true;
+}
+
+
+PINDEX PHTTP2Connection::GetSendWindow(DWORD streamId) const
+{
+  StreamMap::const_iterator it = m_streams.find(streamId);
+  if (it == m_streams.end())
+    return 0;
+  int window = std::min(it->second.m_sendWindow, m_connectionSendWindow);
+  return window > 0 ? window : 0;
+}
+
+
+void PHTTP2Connection::OnStreamReset(DWORD PTRACE_PARAM(streamId), ErrorCode PTRACE_PARAM(error))
+{
+  PTRACE(4, "Stream " << streamId << " reset, error=" << error);
+}
+
+
+void PHTTP2Connection::OnGoAway(DWORD PTRACE_PARAM(lastStreamId), ErrorCode PTRACE_PARAM(error))
+{
+  PTRACE(4, "Peer going away, last stream " << lastStreamId << ", error=" << error);
+}
+
+
+void PHTTP2Connection::OnSendWindow(DWORD)
+{
+}
+
+
+bool PHTTP2Connection::IsIdle(DWORD streamId) const
+{
+  if ((streamId & 1) == (m_isServer ? 0U : 1U))
+    return streamId >= m_nextStreamId;
+  return streamId > m_lastPeerStreamId;
+}
+
+
+bool PHTTP2Connection::ProcessFrame(BYTE type, BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length)
+{
+  PTRACE(6, "Received frame: type=" << (unsigned)type << ", flags=0x" << hex << (unsigned)flags << dec
+         << ", stream=" << streamId << ", length=" << length);
+
+  if (m_expectSettings && type != SettingsFrame)
+    return ConnectionError(ProtocolError, "First frame not SETTINGS");
+
+  if (m_headerStreamId != 0 && type != ContinuationFrame)
+    return ConnectionError(ProtocolError, "Expected CONTINUATION frame");
+
+  switch (type) {
+    case DataFrame :
+      return ProcessData(flags, streamId, payload, length);
+
+    case HeadersFrame :
+    case ContinuationFrame :
+      return ProcessHeaders(type, flags, streamId, payload, length);
+
+    case PriorityFrame :
+      if (streamId == 0)
+        return ConnectionError(ProtocolError, "PRIORITY on stream zero");
+      if (length != 5)
+        StreamError(streamId, FrameSizeError);
+      return true; // Deprecated by RFC 9113, so ignored
+
+    case ResetStreamFrame :
+      if (streamId == 0)
+        return ConnectionError(ProtocolError, "RST_STREAM on stream zero");
+      if (length != 4)
+        return ConnectionError(FrameSizeError, "RST_STREAM wrong size");
+      if (IsIdle(streamId))
+        return ConnectionError(ProtocolError, "RST_STREAM on idle stream");
+      if (m_streams.erase(streamId) > 0)
+        OnStreamReset(streamId, (ErrorCode)Get32(payload));
+      return true;
+
+    case SettingsFrame :
+      return ProcessSettings(flags, streamId, payload, length);
+
+    case PushPromiseFrame :
+      return ConnectionError(ProtocolError, "PUSH_PROMISE not enabled");
+
+    case PingFrame :
+      if (streamId != 0)
+        return ConnectionError(ProtocolError, "PING not on stream zero");
+      if (length != 8)
+        return ConnectionError(FrameSizeError, "PING wrong size");
+      return (flags & AckFlag) != 0 || QueueAcknowledgement(PingFrame, payload, 8);
+
+    case GoAwayFrame :
+      if (streamId != 0)
+        return ConnectionError(ProtocolError, "GOAWAY not on stream zero");
+      if (length < 8)
+        return ConnectionError(FrameSizeError, "GOAWAY too small");
+      m_goingAway = true;
+      OnGoAway(Get31(payload), (ErrorCode)Get32(payload+4));
+      return true;
+
+    case WindowUpdateFrame :
+      return ProcessWindowUpdate(streamId, payload, length);
+
+    default :
+      return true; // Unknown frame types must be ignored
+  }
+}
+
+
+bool PHTTP2Connection::ProcessData(BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length)
+{
+  if (streamId == 0)
+    return ConnectionError(ProtocolError, "DATA on stream zero");
+
+  const BYTE * data = payload;
+  PINDEX dataLength = length;
+  if ((flags & PaddedFlag) != 0) {
+    if (length < 1 || payload[0] >= length)
+      return ConnectionError(ProtocolError, "DATA padding too large");
+    data = payload + 1;
+    dataLength = length - 1 - payload[0];
+  }
+
+  // The whole frame, padding included, counts against flow control
+  m_connectionReceiveWindow -= length;
+  if (m_connectionReceiveWindow < 0)
+    return ConnectionError(FlowControlError, "Connection receive window exceeded");
+  m_connectionReceiveUnacknowledged += length;
+  if (m_connectionReceiveUnacknowledged >= (int)m_localWindowSize/2) {
+    Put32(AppendFrame(WindowUpdateFrame, 0, 0, 4), m_connectionReceiveUnacknowledged);
+    m_connectionReceiveWindow += m_connectionReceiveUnacknowledged;
+    m_connectionReceiveUnacknowledged = 0;
+  }
+
+  StreamMap::iterator it = m_streams.find(streamId);
+  if (it == m_streams.end() || it->second.m_remoteClosed) {
+    if (IsIdle(streamId))
+      return ConnectionError(ProtocolError, "DATA on idle stream");
+    if (it != m_streams.end())
+      StreamError(streamId, StreamClosed);
+    // Otherwise we reset it, and this was in flight, so is ignored
+    return true;
+  }
+
+  Stream & stream = it->second;
+  stream.m_receiveWindow -= length;
+  if (stream.m_receiveWindow < 0) {
+    StreamError(streamId, FlowControlError);
+    return true;
+  }
+
+  bool endStream = (flags & EndStreamFlag) != 0;
+  if (endStream)
+    CloseStream(it, false);
+  else {
+    stream.m_receiveUnacknowledged += length;
+    if (stream.m_receiveUnacknowledged >= (int)m_localWindowSize/2) {
+      Put32(AppendFrame(WindowUpdateFrame, 0, streamId, 4), stream.m_receiveUnacknowledged);
+      stream.m_receiveWindow += stream.m_receiveUnacknowledged;
+      stream.m_receiveUnacknowledged = 0;
+    }
+  }
+
+  OnData(streamId, data, dataLength, endStream);
+  return true;
+}
+
+
+bool PHTTP2Connection::ProcessHeaders(BYTE type, BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length)
+{
+  const BYTE * block = payload;
+  PINDEX blockLength = length;
+
+  if (type == HeadersFrame) {
+    if (streamId == 0)
+      return ConnectionError(ProtocolError, "HEADERS on stream zero");
+
+    if ((flags & PaddedFlag) != 0) {
+      if (length < 1 || payload[0] >= length)
+        return ConnectionError(ProtocolError, "HEADERS padding too large");
+      ++block;
+      blockLength -= 1 + payload[0];
+    }
+
+    if ((flags & PriorityFlag) != 0) {
+      if (blockLength < 5)
+        return ConnectionError(FrameSizeError, "HEADERS too small for priority");
+      block += 5;
+      blockLength -= 5;
+    }
+
+    m_headerStreamId = streamId;
+    m_headerEndStream = (flags & EndStreamFlag) != 0;
+    m_headerLength = 0;
+  }
+  else if (streamId != m_headerStreamId)
+    return ConnectionError(ProtocolError, "Unexpected CONTINUATION frame");
+
+  if (m_headerLength + blockLength > MaxHeaderBlockSize)
+    return ConnectionError(EnhanceYourCalm, "Header block too large");
+
+  memcpy(m_headerBlock.GetPointer(m_headerLength + blockLength) + m_headerLength, block, blockLength);
+  m_headerLength += blockLength;
+
+  return (flags & EndHeadersFlag) == 0 || ProcessHeaderBlock();
+}
+
+
+bool PHTTP2Connection::ProcessHeaderBlock()
+{
+  DWORD streamId = m_headerStreamId;
+  bool endStream = m_headerEndStream;
+  m_headerStreamId = 0;
+
+  // Must always decode, to keep the dynamic table in step, even if the stream is refused
+  PHPACK::FieldList fields;
+  if (!m_decoder.Decode(m_headerBlock, m_headerLength, fields))
+    return ConnectionError(CompressionError, "Could not decode header block");
+
+  StreamMap::iterator it = m_streams.find(streamId);
+  if (it == m_streams.end()) {
+    if (!m_isServer || (streamId & 1) == 0) {
+      if (IsIdle(streamId))
+        return ConnectionError(ProtocolError, "HEADERS on idle stream");
+      return true; // We reset it, and this was in flight
+    }
+
+    if (streamId <= m_lastPeerStreamId) {
+      Put32(AppendFrame(ResetStreamFrame, 0, streamId, 4), StreamClosed);
+      return true;
+    }
+
+    m_lastPeerStreamId = streamId;
+
+    if (m_goingAway || m_streams.size() >= m_localMaxConcurrentStreams) {
+      PTRACE(3, "Refusing stream " << streamId << ", active=" << m_streams.size());
+      Put32(AppendFrame(ResetStreamFrame, 0, streamId, 4), RefusedStream);
+      return true;
+    }
+
+    it = m_streams.insert(StreamMap::value_type(streamId, Stream(m_peerInitialWindowSize, m_localWindowSize))).first;
+  }
+  else if (it->second.m_remoteClosed) {
+    StreamError(streamId, StreamClosed);
+    return true;
+  }
+
+  if (endStream)
+    CloseStream(it, false);
+
+  OnHeaders(streamId, fields, endStream);
+  return true;
+}
+
+
+bool PHTTP2Connection::ProcessSettings(BYTE flags, DWORD streamId, const BYTE * payload, PINDEX length)
+{
+  if (streamId != 0)
+    return ConnectionError(ProtocolError, "SETTINGS not on stream zero");
+
+  if ((flags & AckFlag) != 0) {
+    if (length != 0)
+      return ConnectionError(FrameSizeError, "SETTINGS acknowledgement not empty");
+    return true;
+  }
+
+  if (length % 6 != 0)
+    return ConnectionError(FrameSizeError, "SETTINGS wrong size");
+
+  m_expectSettings = false;
+
+  for (PINDEX i = 0; i < length; i += 6) {
+    if (!ApplySetting(Get16(payload+i), Get32(payload+i+2)))
+      return false;
+  }
+
+  return QueueAcknowledgement(SettingsFrame, NULL, 0);
+}
+
+
+bool PHTTP2Connection::QueueAcknowledgement(BYTE type, const BYTE * payload, PINDEX length)
+{
+  /* A peer that keeps sending PING or SETTINGS, but does not read our
+     answers, would otherwise grow the output without limit. */
+  m_acknowledgementLength += FrameHeaderSize + length;
+  if (m_acknowledgementLength > MaxQueuedAcknowledgements)
+    return ConnectionError(EnhanceYourCalm, "Too many unread acknowledgements");
+
+  BYTE * frame = AppendFrame(type, AckFlag, 0, length);
+  if (length > 0)
+    memcpy(frame, payload, length);
+  return true;
+}
+
+
+bool PHTTP2Connection::ApplySetting(unsigned id, DWORD value)
+{
+  PTRACE(5, "Peer setting " << id << '=' << value);
+
+  switch (id) {
+    case HeaderTableSizeSetting :
+      m_encoder.SetMaxTableSize(value);
+      break;
+
+    case EnablePushSetting :
+      if (value > 1)
+        return ConnectionError(ProtocolError, "Invalid SETTINGS_ENABLE_PUSH");
+      break; // We never push anyway
+
+    case MaxConcurrentStreamsSetting :
+      m_peerMaxConcurrentStreams = value;
+      break;
+
+    case InitialWindowSizeSetting :
+    {
+      if (value > MaxWindowSize)
+        return ConnectionError(FlowControlError, "Invalid SETTINGS_INITIAL_WINDOW_SIZE");
+
+      // Applies to all open streams, retrospectively
+      int delta = (int)value - (int)m_peerInitialWindowSize;
+      m_peerInitialWindowSize = value;
+      for (StreamMap::iterator it = m_streams.begin(); it != m_streams.end(); ++it) {
+        if (delta > 0 && it->second.m_sendWindow > MaxWindowSize - delta)
+          return ConnectionError(FlowControlError, "Stream window overflow");
+        it->second.m_sendWindow += delta;
+      }
+      if (delta > 0)
+        OnSendWindow(0);
+      break;
+    }
+
+    case MaxFrameSizeSetting :
+      if (value < DefaultMaxFrameSize || value > MaxFrameSize)
+        return ConnectionError(ProtocolError, "Invalid SETTINGS_MAX_FRAME_SIZE");
+      m_peerMaxFrameSize = value;
+      break;
+
+    default :
+      break; // Unknown, or advisory, settings are ignored
+  }
+
+  return true;
+}
+
+
+bool PHTTP2Connection::ProcessWindowUpdate(DWORD streamId, const BYTE * payload, PINDEX length)
+{
+  if (length != 4)
+    return ConnectionError(FrameSizeError, "WINDOW_UPDATE wrong size");
+
+  int increment = Get31(payload);
+
+  if (streamId == 0) {
+    if (increment == 0)
+      return ConnectionError(ProtocolError, "WINDOW_UPDATE of zero");
+    if (m_connectionSendWindow > MaxWindowSize - increment)
+      return ConnectionError(FlowControlError, "Connection window overflow");
+    m_connectionSendWindow += increment;
+    OnSendWindow(0);
+    return true;
+  }
+
+  StreamMap::iterator it = m_streams.find(streamId);
+  if (it == m_streams.end()) {
+    if (IsIdle(streamId))
+      return ConnectionError(ProtocolError, "WINDOW_UPDATE on idle stream");
+    return true;
+  }
+
+  if (increment == 0)
+    StreamError(streamId, ProtocolError);
+  else if (it->second.m_sendWindow > MaxWindowSize - increment)
+    StreamError(streamId, FlowControlError);
+  else {
+    it->second.m_sendWindow += increment;
+    OnSendWindow(streamId);
+  }
+  return true;
+}
+
+
+bool PHTTP2Connection::ConnectionError(ErrorCode error, const char * PTRACE_PARAM(reason))
+{
+  PTRACE(2, "Connection error " << error << ": " << reason);
+  if (!m_failed) {
+    m_goingAway = false;
+    GoAway(error);
+    m_failed = true;
+  }
+  return false;
+}
+
+
+void PHTTP2Connection::StreamError(DWORD streamId, ErrorCode error)
+{
+  PTRACE(3, "Stream " << streamId << " error " << error);
+  ResetStream(streamId, error);
+  OnStreamReset(streamId, error);
+}
+
+
+void PHTTP2Connection::CloseStream(StreamMap::iterator it, bool local)
+{
+  if (local)
+    it->second.m_localClosed = true;
+  else
+    it->second.m_remoteClosed = true;
+
+  if (it->second.m_localClosed && it->second.m_remoteClosed)
+    m_streams.erase(it);
+}
+
+
+BYTE * PHTTP2Connection::AppendFrame(BYTE type, BYTE flags, DWORD streamId, PINDEX length)
+{
+  PINDEX needed = m_outputLength + FrameHeaderSize + length;
+  if (needed > m_output.GetSize())
+    m_output.SetSize(std::max(needed, m_output.GetSize()*2));
+
+  BYTE * frame = m_output.GetPointer() + m_outputLength;
+  SetFrameHeader(frame, length, type, flags, streamId);
+  m_outputLength = needed;
+  return frame + FrameHeaderSize;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHTTP2ServerStream
+
+PHTTP2ServerStream::PHTTP2ServerStream(PHTTP2Server & connection, DWORD streamId)
+  : m_connection(connection)
+  , m_streamId(streamId)
+  , m_headersSent(false)
+  , m_finished(false)
+  , m_bufferLength(0)
+  , m_command(PHTTP::NumCommands)
+  , m_requestComplete(false)
+  , m_reset(false)
+  , m_waitingForWindow(false)
+{
+  os_handle = 1; // Always open, until closed
+}
+
+
+PString PHTTP2ServerStream::GetName() const
+{
+  return PSTRSTRM(m_connection.GetTransport().GetName() << '#' << m_streamId);
+}
+
+
+PBoolean PHTTP2ServerStream::Read(void *, PINDEX)
+{
+  // Entity body was collected from DATA frames before dispatch
+  SetLastReadCount(0);
+  return SetErrorValues(Timeout, ETIMEDOUT, LastReadError);
+}
+
+
+PBoolean PHTTP2ServerStream::Write(const void * buf, PINDEX len)
+{
+  SetLastWriteCount(0);
+
+  if (m_finished || m_reset)
+    return SetErrorValues(NotOpen, EBADF, LastWriteError);
+
+  // Collect small writes, so status, headers and body can go in one write
+  memcpy(m_buffer.GetPointer(m_bufferLength + len) + m_bufferLength, buf, len);
+  m_bufferLength += len;
+
+  if (m_bufferLength >= PHTTP2Connection::DefaultMaxFrameSize && !SendPending(false))
+    return SetErrorValues(NotOpen, EBADF, LastWriteError);
+
+  SetLastWriteCount(len);
+  return true;
+}
+
+
+PBoolean PHTTP2ServerStream::Close()
+{
+  os_handle = -1;
+  return true;
+}
+
+
+PChannel * PHTTP2ServerStream::GetBaseReadChannel() const
+{
+  return m_connection.GetTransport().GetBaseReadChannel();
+}
+
+
+PChannel * PHTTP2ServerStream::GetBaseWriteChannel() const
+{
+  return m_connection.GetTransport().GetBaseWriteChannel();
+}
+
+
+void PHTTP2ServerStream::StartResponse(PHTTP::StatusCode code, const PMIMEInfo & headers, long bodySize)
+{
+  m_responseHeaders.clear();
+  m_responseHeaders.push_back(PHPACK::Field(":status", PString(PString::Unsigned, code)));
+
+  for (PMIMEInfo::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+    if (PHTTP2Connection::IsConnectionSpecific(it->first))
+      continue;
+
+    // Multiple values are separate fields
+    PString name = it->first.ToLower();
+    PStringArray values = it->second.Lines();
+    for (PINDEX i = 0; i < values.GetSize(); ++i)
+      m_responseHeaders.push_back(PHPACK::Field(name, values[i]));
+  }
+
+  if (!headers.Contains(PHTTP::ContentLengthTag()) && bodySize >= 0 && (PINDEX)bodySize != P_MAX_INDEX)
+    m_responseHeaders.push_back(PHPACK::Field("content-length", PString(PString::Unsigned, bodySize)));
+}
+
+
+bool PHTTP2ServerStream::Finish()
+{
+  if (m_finished)
+    return true;
+  m_finished = true;
+
+  if (m_reset)
+    return false;
+
+  if (m_responseHeaders.empty()) {
+    PTRACE(2, "No response for stream " << m_streamId);
+    m_responseHeaders.push_back(PHPACK::Field(":status", PString(PString::Unsigned, PHTTP::InternalServerError)));
+  }
+
+  return SendPending(true);
+}
+
+
+bool PHTTP2ServerStream::SendPending(bool endStream)
+{
+  PINDEX sent = 0;
+  for (;;) {
+    {
+      PWaitAndSignal lock(m_connection.m_mutex);
+      m_waitingForWindow = false;
+
+      if (m_reset || m_connection.m_closing || m_connection.HasFailed())
+        return false;
+
+      if (!m_headersSent) {
+        m_headersSent = true;
+        if (!m_connection.SendHeaders(m_streamId, m_responseHeaders, endStream && m_bufferLength == 0))
+          return false;
+        if (endStream && m_bufferLength == 0)
+          break;
+      }
+
+      if (sent < m_bufferLength || endStream) {
+        PINDEX count = m_connection.SendData(m_streamId, m_buffer.GetPointer() + sent, m_bufferLength - sent, endStream);
+        if (count == P_MAX_INDEX)
+          return false;
+        sent += count;
+      }
+
+      if (sent >= m_bufferLength)
+        break;
+
+      m_waitingForWindow = true;
+    }
+
+    // Send what we have, then wait for peer to open the window
+    m_connection.WriteTransport();
+    PTRACE(5, "Stream " << m_streamId << " waiting for send window, " << m_bufferLength - sent << " bytes outstanding");
+
+    /* A peer that never opens the window would otherwise hold this thread,
+       which is one of the listener's shared pool, for ever. */
+    PTimeInterval timeout = m_connection.GetTransport().GetWriteTimeout();
+    if (timeout == PMaxTimeInterval)
+      timeout.SetInterval(0, WindowTimeout);
+    if (!m_windowOpen.Wait(timeout)) {
+      {
+        PWaitAndSignal lock(m_connection.m_mutex);
+        m_waitingForWindow = false;
+        PTRACE(2, "Stream " << m_streamId << " send window not opened in " << timeout << ", resetting");
+        if (!m_reset && !m_connection.m_closing) {
+          m_reset = true;
+          m_connection.ResetStream(m_streamId, PHTTP2Connection::Cancel);
+        }
+      }
+      m_connection.WriteTransport();
+      return false;
+    }
+  }
+
+  m_bufferLength = 0;
+  return m_connection.WriteTransport();
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// PHTTP2Server
+
+struct PHTTP2Server::StreamWork : PHTTPListener::StreamWork
+{
+  StreamWork(PHTTP2Server & server, PHTTP2ServerStream * stream)
+    : m_server(server)
+    , m_stream(stream)
+  {
+  }
+
+  virtual void Work()
+  {
+    m_server.ProcessStream(m_stream);
+  }
+
+  PHTTP2Server       & m_server;
+  PHTTP2ServerStream * m_stream;
+};
+
+
+PHTTP2Server::PHTTP2Server(PHTTPListener & listener, PHTTPServer & transport)
+  : PHTTP2Connection(true)
+  , m_listener(listener)
+  , m_transport(transport)
+  , m_dispatched(0)
+  , m_closing(false)
+{
+}
+
+
+PHTTP2Server::~PHTTP2Server()
+{
+  for (std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.begin(); it != m_activeStreams.end(); ++it)
+    delete it->second;
+}
+
+
+void PHTTP2Server::Main(const PHTTPConnectionInfo * upgrade)
+{
+  m_mutex.Wait();
+
+  Start();
+
+  PHTTP2ServerStream * upgraded = NULL;
+  if (upgrade != NULL && StartUpgrade(upgrade->GetMIME()(SettingsTag()))) {
+    // The request that was upgraded is implicitly stream 1
+    upgraded = new PHTTP2ServerStream(*this, 1);
+    upgraded->m_command = upgrade->GetCommandCode();
+    upgraded->m_method = m_transport.GetNameFromCommand(upgraded->m_command);
+    upgraded->m_url = upgrade->GetURL();
+    upgraded->m_body = upgrade->GetEntityBody();
+    for (PMIMEInfo::const_iterator it = upgrade->GetMIME().begin(); it != upgrade->GetMIME().end(); ++it) {
+      if (!IsConnectionSpecific(it->first) && it->first != SettingsTag())
+        upgraded->m_mime.SetAt(it->first, it->second);
+    }
+    upgraded->m_requestComplete = true;
+    m_activeStreams[1] = upgraded;
+  }
+
+  m_mutex.Signal();
+
+  m_transport.SetReadTimeout(m_transport.GetConnectionInfo().GetPersistenceTimeout());
+
+  bool running = WriteTransport();
+
+  /* Some clients cannot take much of a response in the same read as the 101,
+     so wait for their preface before processing the upgraded request. */
+  while (running && upgraded != NULL && m_expectSettings)
+    running = ReadTransport() && WriteTransport();
+  if (running && upgraded != NULL) {
+    PWaitAndSignal lock(m_mutex);
+    Dispatch(upgraded);
+  }
+
+  while (running)
+    running = ReadTransport() && WriteTransport();
+
+  m_mutex.Wait();
+
+  m_closing = true;
+
+  // Wake up anything waiting to send, and drop requests not yet complete
+  for (std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.begin(); it != m_activeStreams.end(); ) {
+    PHTTP2ServerStream * stream = it->second;
+    if (stream->m_requestComplete) {
+      stream->m_windowOpen.Signal();
+      ++it;
+    }
+    else {
+      delete stream;
+      m_activeStreams.erase(it++);
+    }
+  }
+
+  bool wait = m_dispatched > 0;
+
+  m_mutex.Signal();
+
+  if (wait) {
+    PTRACE(4, "Waiting for streams to finish");
+    m_allDone.Wait();
+  }
+
+  // Make sure a final GOAWAY, if any, is sent
+  WriteTransport();
+  PTRACE(4, "Connection ended, last stream " << GetLastPeerStreamId());
+}
+
+
+bool PHTTP2Server::ReadTransport()
+{
+  PINDEX size;
+  BYTE * buffer = GetReceiveBuffer(size);
+
+  // Anything already read ahead while looking at the first line comes first
+  bool ok;
+  if (m_transport.unReadCount > 0)
+    ok = m_transport.Read(buffer, std::min(size, m_transport.unReadCount));
+  else
+    ok = m_transport.PIndirectChannel::Read(buffer, size);
+
+  if (!ok) {
+    if (m_transport.GetErrorCode(PChannel::LastReadError) != PChannel::Timeout) {
+      PTRACE(4, "Read error: " << m_transport.GetErrorText(PChannel::LastReadError));
+      return false;
+    }
+
+    PWaitAndSignal lock(m_mutex);
+    if (!m_activeStreams.empty())
+      return true;
+
+    PTRACE(4, "Idle timeout");
+    GoAway(NoError);
+    return false;
+  }
+
+  PWaitAndSignal lock(m_mutex);
+  return ProcessReceived(m_transport.GetLastReadCount()) || HasOutput(); // Write GOAWAY before stopping
+}
+
+
+bool PHTTP2Server::WriteTransport()
+{
+  /* Whoever queued output may find someone else already writing. That writer
+     checks again after letting go, so the output is never left behind. */
+  for (;;) {
+    if (!m_writeMutex.Try())
+      return true;
+
+    bool ok = true;
+    for (;;) {
+      PINDEX length;
+      {
+        PWaitAndSignal lock(m_mutex);
+        if (!HasOutput())
+          break;
+        GetOutput(m_writeBuffer, length);
+      }
+
+      if (!m_transport.PIndirectChannel::Write(m_writeBuffer, length)) {
+        PTRACE(4, "Write error: " << m_transport.GetErrorText(PChannel::LastWriteError));
+        PWaitAndSignal lock(m_mutex);
+        m_failed = true;
+        ok = false;
+        break;
+      }
+    }
+
+    m_writeMutex.Signal();
+
+    PWaitAndSignal lock(m_mutex);
+    if (!ok || m_failed)
+      return false;
+    if (!HasOutput())
+      return true;
+  }
+}
+
+
+void PHTTP2Server::OnHeaders(DWORD streamId, PHPACK::FieldList & fields, bool endStream)
+{
+  std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.find(streamId);
+  if (it != m_activeStreams.end()) {
+    // Trailers, which we do not use, but they end the request
+    if (!endStream)
+      StreamError(streamId, ProtocolError);
+    else if (!it->second->m_requestComplete) {
+      it->second->m_requestComplete = true;
+      Dispatch(it->second);
+    }
+    return;
+  }
+
+  if (m_closing) {
+    ResetStream(streamId, RefusedStream);
+    return;
+  }
+
+  PHTTP2ServerStream * stream = new PHTTP2ServerStream(*this, streamId);
+
+  PString scheme, authority, path;
+  bool valid = true;
+  bool regular = false;
+  for (PHPACK::FieldList::iterator field = fields.begin(); field != fields.end(); ++field) {
+    const PString & name = field->m_name;
+    if (name[0] == ':') {
+      if (regular)
+        valid = false; // Pseudo-headers must come first
+      else if (name == ":method")
+        stream->m_method = field->m_value;
+      else if (name == ":scheme")
+        scheme = field->m_value;
+      else if (name == ":authority")
+        authority = field->m_value;
+      else if (name == ":path")
+        path = field->m_value;
+      else
+        valid = false;
+    }
+    else {
+      regular = true;
+      if (IsConnectionSpecific(name))
+        valid = false;
+      else if (name == "cookie" && stream->m_mime.Contains(PHTTP::CookieTag()))
+        stream->m_mime.SetAt(PHTTP::CookieTag(), stream->m_mime[PHTTP::CookieTag()] + "; " + field->m_value);
+      else
+        stream->m_mime.AddMIME(name, field->m_value);
+    }
+  }
+
+  if (!valid || stream->m_method.IsEmpty() || scheme.IsEmpty() || path.IsEmpty()) {
+    PTRACE(2, "Malformed request on stream " << streamId);
+    delete stream;
+    StreamError(streamId, ProtocolError);
+    return;
+  }
+
+  // Resources expect a Host header, as for HTTP/1.1
+  if (authority.IsEmpty())
+    authority = stream->m_mime(PHTTP::HostTag());
+  else
+    stream->m_mime.SetAt(PHTTP::HostTag(), authority);
+  if (authority.IsEmpty()) {
+    PIPSocket * socket = m_transport.GetSocket();
+    authority = socket != NULL ? socket->GetLocalAddress() : PString("localhost");
+  }
+
+  PINDEX cmd = m_transport.GetCommandFromName(stream->m_method);
+  stream->m_command = cmd < PHTTP::NumCommands ? (PHTTP::Commands)cmd : PHTTP::NumCommands;
+  stream->m_url.Parse(scheme + "://" + authority + path);
+
+  m_activeStreams[streamId] = stream;
+
+  if (endStream) {
+    stream->m_requestComplete = true;
+    Dispatch(stream);
+  }
+}
+
+
+void PHTTP2Server::OnData(DWORD streamId, const BYTE * data, PINDEX length, bool endStream)
+{
+  std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.find(streamId);
+  if (it == m_activeStreams.end() || it->second->m_requestComplete)
+    return;
+
+  PHTTP2ServerStream & stream = *it->second;
+  if (length > 0) {
+    PINDEX previous = stream.m_body.GetLength();
+    memcpy(stream.m_body.GetPointerAndSetLength(previous + length) + previous, data, length);
+  }
+
+  if (endStream) {
+    stream.m_requestComplete = true;
+    Dispatch(&stream);
+  }
+}
+
+
+void PHTTP2Server::OnStreamReset(DWORD streamId, ErrorCode error)
+{
+  PHTTP2Connection::OnStreamReset(streamId, error);
+
+  std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.find(streamId);
+  if (it == m_activeStreams.end())
+    return;
+
+  PHTTP2ServerStream * stream = it->second;
+  if (stream->m_requestComplete) {
+    // Being processed, it cleans up when done
+    stream->m_reset = true;
+    stream->m_windowOpen.Signal();
+  }
+  else {
+    delete stream;
+    m_activeStreams.erase(it);
+  }
+}
+
+
+void PHTTP2Server::OnSendWindow(DWORD streamId)
+{
+  if (streamId != 0) {
+    std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.find(streamId);
+    if (it != m_activeStreams.end() && it->second->m_waitingForWindow)
+      it->second->m_windowOpen.Signal();
+    return;
+  }
+
+  for (std::map<DWORD, PHTTP2ServerStream *>::iterator it = m_activeStreams.begin(); it != m_activeStreams.end(); ++it) {
+    if (it->second->m_waitingForWindow)
+      it->second->m_windowOpen.Signal();
+  }
+}
+
+
+void PHTTP2Server::Dispatch(PHTTP2ServerStream * stream)
+{
+  PTRACE(5, "Dispatching stream " << stream->m_streamId << ": " << stream->m_method << ' ' << stream->m_url);
+  ++m_dispatched;
+  m_listener.GetStreamThreadPool().AddWork(new StreamWork(*this, stream));
+}
+
+
+void PHTTP2Server::ProcessStream(PHTTP2ServerStream * stream)
+{
+  PHTTPServer * server = m_listener.CreateServerForHTTP();
+  if (server != NULL && server->Open(stream, false)) {
+    server->m_http2Stream = stream;
+    server->SetServiceStartTime(m_transport.GetLastCommandTime());
+
+    PHTTPConnectionInfo & info = server->m_connectInfo;
+    info.m_commandCode = stream->m_command;
+    info.m_commandName = stream->m_method;
+    info.m_url = stream->m_url;
+    info.m_mimeInfo = stream->m_mime;
+    info.m_majorVersion = 2;
+    info.m_minorVersion = 0;
+    info.m_isPersistent = true;
+    info.m_entityBody = stream->m_body;
+    info.m_entityBodyLength = stream->m_body.GetLength();
+
+    server->OnCommand(stream->m_command, info.m_url, info.m_url.AsString(PURL::RelativeOnly) & "HTTP/2.0", info);
+    server->flush();
+  }
+  else {
+    PTRACE(2, "Could not create server for stream " << stream->m_streamId);
+  }
+
+  stream->Finish();
+  delete server;
+
+  EndStream(stream);
+}
+
+
+void PHTTP2Server::EndStream(PHTTP2ServerStream * stream)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  m_activeStreams.erase(stream->m_streamId);
+  delete stream;
+
+  if (--m_dispatched == 0 && m_closing)
+    m_allDone.Signal();
+}
+
+
+#endif // P_HTTP
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -29,8 +29,11 @@
 #if P_HTTP
 
 #include <ptlib/sockets.h>
+#include <ptlib/bufchain.h>
 #include <ptclib/http.h>
+#include <ptclib/http2.h>
 #include <ptclib/guid.h>
+#include <ptclib/pzlib.h>
 
 #if P_SSL
 #include <ptclib/pssl.h>
@@ -38,6 +41,11 @@
 
 #include <ctype.h>
 
+#ifndef _WIN32
+#include <poll.h>
+#include <fcntl.h>
+#endif
+
 
 #define PTraceModule() "HTTP"
 
@@ -146,7 +154,7 @@ struct PHTTPClient_StringWriter : public PHTTPContentProcessor
 
     m_written = true;
     size = m_body.GetLength();
-    return m_body.GetPointerAndSetLength(size);
+    return const_cast<char *>((const char *)m_body); // Not GetPointer(), which copies a shared body
   }
 
   virtual void Reset()
@@ -194,7 +202,7 @@ struct PHTTPClient_BinaryWriter : public PHTTPContentProcessor
 
     m_written = true;
     size = m_body.GetLength();
-    return m_body.GetPointer();
+    return const_cast<BYTE *>((const BYTE *)m_body); // Not GetPointer(), which copies a shared body
   }
 
   virtual void Reset()
@@ -204,6 +212,59 @@ struct PHTTPClient_BinaryWriter : public PHTTPContentProcessor
 };
 
 
+struct PHTTPClient_ChainReader : public PHTTPContentProcessor
+{
+  PBufferChain & m_body;
+
+  PHTTPClient_ChainReader(PBufferChain & body)
+    : PHTTPContentProcessor(true)
+    , m_body(body)
+  {
+  }
+
+  virtual void * GetBuffer(PINDEX & size)
+  {
+    if (size <= 0)
+      size = PBufferChain::BlockSize;
+    return m_body.GetWritable(size);
+  }
+
+  virtual bool Process(const void * /*data*/, PINDEX length)
+  {
+    m_body.Commit(length);
+    return true;
+  }
+};
+
+
+/* WriteCommand() sends this with gathered writes, directly from the chain,
+   the GetBuffer() interface is only used for content length and such. */
+struct PHTTPClient_ChainWriter : public PHTTPContentProcessor
+{
+  const PBufferChain & m_body;
+  PINDEX               m_segment;
+
+  PHTTPClient_ChainWriter(const PBufferChain & body)
+    : PHTTPContentProcessor(false)
+    , m_body(body)
+    , m_segment(0)
+  {
+  }
+
+  virtual void * GetBuffer(PINDEX & size)
+  {
+    if (m_segment >= m_body.GetSegmentCount())
+      return NULL;
+    return const_cast<BYTE *>(m_body.GetSegment(m_segment++, size));
+  }
+
+  virtual void Reset()
+  {
+    m_segment = 0;
+  }
+};
+
+
 struct PHTTPClient_FileWriter : public PHTTPContentProcessor
 {
   PFile   m_file;
@@ -235,6 +296,58 @@ struct PHTTPClient_FileWriter : public PHTTPContentProcessor
 };
 
 
+#if P_ZLIB
+/* Decompresses the body as it arrives, handing the result on to the real
+   processor in whatever size pieces it offers buffers for.
+ */
+struct PHTTPClient_Decoder : public PHTTPContentProcessor
+{
+  PHTTPContentProcessor & m_target;
+  PZLib                   m_zlib;
+  BYTE                    m_input[16384];
+  PBYTEArray              m_output;
+
+  PHTTPClient_Decoder(PHTTPContentProcessor & target, PZLib::Format format, PUInt64 maxOutput)
+    : PHTTPContentProcessor(true)
+    , m_target(target)
+    , m_zlib(false, format)
+  {
+    m_zlib.SetMaxOutput(maxOutput);
+  }
+
+  virtual void * GetBuffer(PINDEX & size)
+  {
+    if (size <= 0 || size > (PINDEX)sizeof(m_input))
+      size = sizeof(m_input);
+    return m_input;
+  }
+
+  virtual bool Process(const void * data, PINDEX length)
+  {
+    PINDEX outputLength = 0;
+    if (!m_zlib.Process(data, length, m_output, outputLength))
+      return false;
+
+    const BYTE * ptr = m_output;
+    while (outputLength > 0) {
+      PINDEX size = outputLength;
+      void * buffer = m_target.GetBuffer(size);
+      if (buffer == NULL)
+        return false;
+      if (size > outputLength)
+        size = outputLength;
+      memcpy(buffer, ptr, size);
+      if (!m_target.Process(buffer, size))
+        return false;
+      ptr += size;
+      outputLength -= size;
+    }
+    return true;
+  }
+};
+#endif // P_ZLIB
+
+
 //////////////////////////////////////////////////////////////////////////////
 // PHTTPClient
 
@@ -242,6 +355,8 @@ PHTTPClient::PHTTPClient(const PString & userAgent)
   : m_userAgentName(userAgent)
   , m_persist(true)
   , m_maxRedirects(10)
+  , m_contentDecoding(true)
+  , m_maxDecodedSize(DefaultMaxDecodedSize)
   , m_authentication(NULL)
   , m_commandUrlFormat(PURL::RelativeOnly)
 {
@@ -276,6 +391,17 @@ PHTTP::StatusCode PHTTPClient::ExecuteCommand(Commands cmd,
 }
 
 
+PHTTP::StatusCode PHTTPClient::ExecuteCommand(Commands cmd,
+                                              const PURL & url,
+                                              PMIMEInfo & outMIME,
+                                              const PBufferChain & dataBody,
+                                              PMIMEInfo & replyMIME)
+{
+  PHTTPClient_ChainWriter processor(dataBody);
+  return ExecuteCommand(cmd, url, outMIME, processor, replyMIME);
+}
+
+
 PHTTP::StatusCode PHTTPClient::ExecuteCommand(Commands cmd,
                                               const PURL & url,
                                               PMIMEInfo & outMIME,
@@ -291,6 +417,11 @@ PHTTP::StatusCode PHTTPClient::ExecuteCommand(Commands cmd,
   if (m_persist && !outMIME.Contains(ConnectionTag()))
     outMIME.SetAt(ConnectionTag(), KeepAliveTag());
 
+#if P_ZLIB
+  if (m_contentDecoding && cmd != CONNECT && !outMIME.Contains(AcceptEncodingTag()))
+    outMIME.SetAt(AcceptEncodingTag(), PZLib::GetAcceptEncoding());
+#endif
+
   unsigned redirectCount = m_maxRedirects;
   bool needAuthentication = true;
   bool forceReopen = !m_persist;
@@ -444,6 +575,34 @@ bool PHTTPClient::WriteCommand(Commands cmd,
   }
 #endif
 
+  PHTTPClient_ChainWriter * chainWriter = dynamic_cast<PHTTPClient_ChainWriter *>(&processor);
+  if (chainWriter != NULL) {
+    // Header and body go in as few system calls as possible, body not copied
+    PStringStream header;
+    header << cmdName << ' ' << (url.IsEmpty() ? "/" : (const char*)url) << " HTTP/1.1\r\n"
+           << setfill('\r') << outMIME;
+
+    PBufferChain request;
+    request.Append(header);
+    request.Append(chainWriter->m_body);
+
+#if PTRACING
+    if (trace != NULL) {
+      for (PINDEX i = 0; i < chainWriter->m_body.GetSegmentCount(); ++i) {
+        PINDEX len;
+        const BYTE * data = chainWriter->m_body.GetSegment(i, len);
+        *trace << PHTTPClient_OutputBody(data, len);
+      }
+      *trace << PTrace::End;
+    }
+#endif
+
+    flush();
+    if (!WriteChain(request))
+      return SetLastResponse(TransportWriteError, PString::Empty(), LastWriteError);
+    return true;
+  }
+
   *this << cmdName << ' ' << (url.IsEmpty() ? "/" : (const char*)url) << " HTTP/1.1\r\n"
         << setfill('\r') << outMIME;
 
@@ -551,7 +710,48 @@ bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, PBYTEArray & body)
 }
 
 
+bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, PBufferChain & body)
+{
+#if P_ZLIB
+  PZLib::Format format;
+  if (m_contentDecoding && PZLib::FromContentEncoding(replyMIME(ContentEncodingTag()), format)) {
+    PHTTPClient_ChainReader processor(body);
+    return ReadContentBody(replyMIME, processor);
+  }
+#endif
+
+  return InternalReadContentBody(replyMIME, body);
+}
+
+
 bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & processor)
+{
+#if P_ZLIB
+  PZLib::Format format;
+  if (m_contentDecoding && PZLib::FromContentEncoding(replyMIME(ContentEncodingTag()), format)) {
+    PHTTPClient_Decoder decoder(processor, format, m_maxDecodedSize);
+    if (!InternalReadContentBody(replyMIME, decoder)) {
+      if (decoder.m_zlib.HasExceededMaxOutput())
+        return SetLastResponse(ContentProcessorError, "Decoded content too large");
+      return false;
+    }
+    if (!decoder.m_zlib.IsFinished())
+      return SetLastResponse(ContentProcessorError, "Compressed content incomplete");
+
+    PTRACE(4, "Decoded " << replyMIME(ContentEncodingTag()) << " content: "
+           << decoder.m_zlib.GetTotalIn() << " -> " << decoder.m_zlib.GetTotalOut() << " bytes");
+    replyMIME.RemoveAt(ContentEncodingTag());
+    if (replyMIME.Contains(ContentLengthTag()))
+      replyMIME.SetVar(ContentLengthTag(), decoder.m_zlib.GetTotalOut());
+    return true;
+  }
+#endif
+
+  return InternalReadContentBody(replyMIME, processor);
+}
+
+
+bool PHTTPClient::InternalReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & processor)
 {
   PCaselessString encoding = replyMIME(TransferEncodingTag());
 
@@ -564,8 +764,11 @@ bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & proc
       if (ptr == NULL)
         return SetLastResponse(ContentProcessorError, "No buffer from HTTP content processor");
 
-      if (length == size)
-        return ReadBlock(ptr, length);
+      if (length == size) {
+        if (!ReadBlock(ptr, length))
+          return false;
+        return processor.Process(ptr, length) || SetLastResponse(ContentProcessorError, "Content processing error");
+      }
 
       while (length > 0 && Read(ptr, PMIN(length, size))) {
         if (!processor.Process(ptr, GetLastReadCount()))
@@ -612,6 +815,8 @@ bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & proc
     if (chunkLength == size) {
       if (!ReadBlock(ptr, chunkLength))
         return false;
+      if (!processor.Process(ptr, chunkLength))
+        return SetLastResponse(ContentProcessorError, "Content processing error");
     }
     else {
       // Read the chunk
@@ -638,6 +843,57 @@ bool PHTTPClient::ReadContentBody(PMIMEInfo & replyMIME, ContentProcessor & proc
 }
 
 
+bool PHTTPClient::InternalReadContentBody(PMIMEInfo & replyMIME, PBufferChain & body)
+{
+  static const PINDEX MaxRead = 64*PBufferChain::BlockSize;
+
+  PCaselessString encoding = replyMIME(TransferEncodingTag());
+
+  if (encoding != ChunkedTag()) {
+    if (replyMIME.Contains(ContentLengthTag()))
+      return ReadBlock(body, replyMIME.GetInteger(ContentLengthTag()));
+
+    if (!(encoding.IsEmpty()))
+      return SetLastResponse(UnknownTransferEncoding, "Unknown Transfer-Encoding extension");
+
+    // Must be raw, read to end file variety
+    while (ReadChain(body, MaxRead))
+      ;
+
+    return GetErrorCode(LastReadError) == NoError;
+  }
+
+  // HTTP1.1 chunked format
+  for (;;) {
+    // Read chunk length line
+    PString chunkLengthLine;
+    if (!ReadLine(chunkLengthLine))
+      return false;
+
+    // A zero length chunk is end of output
+    PINDEX chunkLength = chunkLengthLine.AsUnsigned(16);
+    if (chunkLength == 0)
+      break;
+
+    if (!ReadBlock(body, chunkLength))
+      return false;
+
+    // Read the trailing CRLF
+    if (!ReadLine(chunkLengthLine))
+      return false;
+  }
+
+  // Read the footer
+  PString footer;
+  do {
+    if (!ReadLine(footer))
+      return false;
+  } while (replyMIME.AddMIME(footer));
+
+  return true;
+}
+
+
 static bool CheckContentType(const PMIMEInfo & replyMIME, const PString & requiredContentType)
 {
   PCaselessString actualContentType = replyMIME(PHTTPClient::ContentTypeTag());
@@ -812,6 +1068,14 @@ bool PHTTPClient::PutDocument(const PURL & url, const PBYTEArray & data, const P
 }
 
 
+bool PHTTPClient::PutDocument(const PURL & url, const PBufferChain & data, const PString & contentType, const PMIMEInfo & mime)
+{
+  PMIMEInfo outMIME(mime), replyMIME;
+  outMIME.SetAt(ContentTypeTag(), contentType);
+  return IsOK(ExecuteCommand(PUT, url, outMIME, data, replyMIME));
+}
+
+
 bool PHTTPClient::PutDocument(const PURL & url, const PFilePath & path, const PString & contentType, const PMIMEInfo & mime)
 {
   PMIMEInfo outMIME(mime), replyMIME;
@@ -1332,72 +1596,1450 @@ PString PHTTPClientAuthenticator::GetMethod()
 
 ////////////////////////////////////////////////////////////////////////////////////
 
-void PHTTPClientPool::ShutDown()
+#ifndef _WIN32
+
+/* All the state for event driven connections belongs to one EventThread, so
+   only that thread ever touches it. Other threads just add to the incoming
+   list, under the mutex, and wake the thread via a pipe. Requests are then
+   queued per host and handed to connections as they become free, or are
+   pipelined on them when the server has shown it supports persistence. */
+
+class PHTTPClientPool::EventThread : public PObject
 {
-  PWaitAndSignal lock(m_mutex);
+    PCLASSINFO(EventThread, PObject);
+  public:
+    EventThread(PHTTPClientPool & pool, unsigned index);
+    ~EventThread();
 
-  for (ConnectionMap::iterator it = m_connections.begin(); it != m_connections.end(); ++it)
-    delete it->second;
-  m_connections.clear();
+    void Queue(const Request & request, const PString & hostPort);
+
+  protected:
+    enum {
+      MaxAttempts = 3,
+      MaxHeaderSize = 65536,
+      InputBufferSize = 16384
+    };
+
+    struct Pending
+    {
+      Pending(const Request & request) : m_request(request), m_attempts(0), m_outputStart(0), m_streamId(0), m_bodySent(0) { }
+      bool IsIdempotent() const { return m_request.m_command == PHTTP::GET || m_request.m_command == PHTTP::HEAD; }
+
+      Request  m_request;
+      unsigned m_attempts;
+      PUInt64  m_outputStart; // Link's byte count written when the request's first byte is
+      DWORD    m_streamId;  // HTTP/2 only
+      PINDEX   m_bodySent;  // HTTP/2 only, as flow control allows
+    };
+    typedef std::deque<Pending> PendingQueue;
+
+    struct Host;
+    struct Link;
+
+    // Passes the stream events of a HTTP/2 connection back to the thread
+    class HTTP2 : public PHTTP2Connection
+    {
+        PCLASSINFO(HTTP2, PHTTP2Connection);
+      public:
+        HTTP2(EventThread & thread, Link & link)
+          : PHTTP2Connection(false)
+          , m_thread(thread)
+          , m_link(link)
+        { }
+
+      protected:
+        virtual void OnHeaders(DWORD streamId, PHPACK::FieldList & fields, bool endStream)
+          { m_thread.OnHTTP2Headers(m_link, streamId, fields, endStream); }
+        virtual void OnData(DWORD streamId, const BYTE * data, PINDEX length, bool endStream)
+          { m_thread.OnHTTP2Data(m_link, streamId, data, length, endStream); }
+        virtual void OnStreamReset(DWORD streamId, ErrorCode error)
+          { PHTTP2Connection::OnStreamReset(streamId, error); m_thread.OnHTTP2Reset(m_link, streamId, error); }
+        virtual void OnGoAway(DWORD lastStreamId, ErrorCode error)
+          { PHTTP2Connection::OnGoAway(lastStreamId, error); m_thread.OnHTTP2GoAway(m_link, lastStreamId); }
+        virtual void OnSendWindow(DWORD streamId)
+          { m_thread.OnHTTP2Window(m_link, streamId); }
+
+        EventThread & m_thread;
+        Link        & m_link;
+    };
+
+    struct StreamResponse
+    {
+      StreamResponse() : m_bodyLength(0) { }
+
+      Response m_response;
+      PINDEX   m_bodyLength;
+    };
+    typedef std::map<DWORD, StreamResponse> StreamResponseMap;
+
+    struct Link
+    {
+      Link(Host & host, int handle, PInt64 now);
+      ~Link() { delete m_http2; }
+
+      enum State {
+        Connecting,
+        Open,
+        Closed
+      };
+      enum Parse {
+        ReadHeader,
+        ReadBody,
+        ReadChunkSize,
+        ReadChunkData,
+        ReadChunkEnd,
+        ReadTrailer,
+        ReadUntilClose
+      };
+
+      bool IsIdle() const { return m_state == Open && m_inFlight.empty(); }
+
+      Host       & m_host;
+      int          m_handle;
+      State        m_state;
+      bool         m_canPipeline;  // Server has answered with a persistent HTTP/1.1 response
+      bool         m_closeAfter;   // Server will close after the current response
+      unsigned     m_unsafeInFlight;
+      unsigned     m_completed;
+      PendingQueue m_inFlight;
+
+      PBYTEArray   m_output;
+      PINDEX       m_outputLength;
+      PINDEX       m_outputSent;
+      PUInt64      m_written;      // Total sent, to tell if a request got to the server at all
+
+      PBYTEArray   m_input;
+      PINDEX       m_inputStart;
+      PINDEX       m_inputEnd;
+
+      Parse        m_parse;
+      Response     m_response;
+      PINDEX       m_bodyLength;
+      PINDEX       m_bodyRemaining;
+      bool         m_responseStarted;
+
+      PInt64       m_deadline;
+      PInt64       m_lastUse;
+
+      HTTP2           * m_http2;      // Non-NULL when using HTTP/2, m_inFlight is then in no particular order
+      StreamResponseMap m_responses;  // HTTP/2 responses being received
+    };
+
+    struct Host
+    {
+      Host(const PString & hostPort) : m_hostPort(hostPort) { }
+
+      PString                 m_hostPort;
+      PIPSocketAddressAndPort m_address;
+      PendingQueue            m_pending;
+      std::list<Link *>       m_links;
+    };
+    typedef std::map<PString, Host *> HostMap;
+
+    void Main();
+    void AcceptIncoming();
+    void Schedule(Host & host);
+    Link * OpenLink(Host & host);
+    bool CloseIdleLink(const Host & except);
+    void AddToOutput(Link & link, const Pending & pending);
+    void Flush(Link & link);
+    void OnConnected(Link & link);
+    void OnReadable(Link & link);
+    bool ParseInput(Link & link);
+    bool ParseHeader(Link & link, const char * header, PINDEX length);
+    bool AppendBody(Link & link, const BYTE * data, PINDEX length);
+    void OnResponse(Link & link);
+    void Fail(Link & link, PHTTP::StatusCode code);
+    void Close(Link & link);
+    void Complete(const Request & request, const Response & response);
+
+    void AddToHTTP2(Link & link, const Pending & pending);
+    void SendHTTP2Body(Link & link, Pending & pending);
+    void FlushHTTP2(Link & link);
+    void OnReadableHTTP2(Link & link);
+    void OnHTTP2Headers(Link & link, DWORD streamId, PHPACK::FieldList & fields, bool endStream);
+    void OnHTTP2Data(Link & link, DWORD streamId, const BYTE * data, PINDEX length, bool endStream);
+    void OnHTTP2Reset(Link & link, DWORD streamId, PHTTP2Connection::ErrorCode error);
+    void OnHTTP2GoAway(Link & link, DWORD lastStreamId);
+    void OnHTTP2Window(Link & link, DWORD streamId);
+    void CompleteHTTP2(Link & link, DWORD streamId, const Response & response);
+    PendingQueue::iterator FindStream(Link & link, DWORD streamId);
+
+    PHTTPClientPool & m_pool;
+    unsigned          m_index;
+    int               m_wakeUp[2];
+    PThread         * m_thread;
+    atomic<bool>      m_running;
+    PInt64            m_now;
+
+    PDECLARE_MUTEX(m_mutex);
+    std::vector< std::pair<PString, Request> > m_incoming;
+
+    HostMap            m_hosts;
+    std::list<Link *>  m_links;
+    std::vector<struct pollfd> m_pollFds;
+    std::vector<Link *>        m_pollLinks;
+    std::vector< std::pair<Notifier, Response> > m_completions;
+};
+
+
+PHTTPClientPool::EventThread::Link::Link(Host & host, int handle, PInt64 now)
+  : m_host(host)
+  , m_handle(handle)
+  , m_state(Connecting)
+  , m_canPipeline(false)
+  , m_closeAfter(false)
+  , m_unsafeInFlight(0)
+  , m_completed(0)
+  , m_outputLength(0)
+  , m_outputSent(0)
+  , m_written(0)
+  , m_input(InputBufferSize)
+  , m_inputStart(0)
+  , m_inputEnd(0)
+  , m_parse(ReadHeader)
+  , m_bodyLength(0)
+  , m_bodyRemaining(0)
+  , m_responseStarted(false)
+  , m_deadline(0)
+  , m_lastUse(now)
+  , m_http2(NULL)
+{
 }
 
 
-void PHTTPClientPool::QueueRequest(const Request & request)
+PHTTPClientPool::EventThread::EventThread(PHTTPClientPool & pool, unsigned index)
+  : m_pool(pool)
+  , m_index(index)
+  , m_thread(NULL)
+  , m_running(true)
+  , m_now(PTimer::Tick().GetMilliSeconds())
 {
-  PString hostPort = request.m_url.GetHostPort();
-  if (hostPort.IsEmpty() || (unsigned)request.m_command >= PHTTP::NumCommands) {
-    PAssertAlways(PInvalidParameter);
+  if (::pipe(m_wakeUp) < 0) {
+    PTRACE(1, "Could not create pipe for HTTP event thread: " << strerror(errno));
+    m_wakeUp[0] = m_wakeUp[1] = -1;
     return;
   }
 
-  PWaitAndSignal lock(m_mutex);
+  for (int i = 0; i < 2; ++i) {
+    ::fcntl(m_wakeUp[i], F_SETFL, O_NONBLOCK);
+    ::fcntl(m_wakeUp[i], F_SETFD, FD_CLOEXEC);
+  }
 
-  for (;;) {
-    for (ConnectionMap::iterator it = m_connections.begin(); it != m_connections.end(); ) {
-      if (it->second->m_lastUse.GetElapsed() < m_timeToLive)
-        ++it;
-      else {
-        delete it->second;
-        m_connections.erase(it++);
-      }
-    }
+  m_thread = new PThreadObj<EventThread>(*this, &EventThread::Main, false, PSTRSTRM("HTTP-Pool:" << index));
+}
 
-    if (m_connections.size() < m_maxConnections)
-      break;
 
-    m_mutex.Signal();
-    PThread::Sleep(100);
-    m_mutex.Wait();
+PHTTPClientPool::EventThread::~EventThread()
+{
+  if (m_thread != NULL) {
+    m_running = false;
+    static const char wake = 0;
+    PAssertOS(::write(m_wakeUp[1], &wake, 1) >= 0 || errno == EAGAIN);
+    PThread::WaitAndDelete(m_thread);
   }
 
-  std::pair<ConnectionMap::iterator, ConnectionMap::iterator> range = m_connections.equal_range(hostPort);
-  if (range.first == m_connections.end() || std::distance(range.first, range.second) < (ptrdiff_t)m_maxParallel)
-    m_connections.insert(std::make_pair(hostPort, new Connection(*this, request)));
-  else {
-    ConnectionMap::iterator shortestQueue = range.first;
-    for (ConnectionMap::iterator it = range.first; it != range.second; ++it) {
-      if (it->second->m_requests.size() < shortestQueue->second->m_requests.size())
-        shortestQueue = it;
+  for (std::list<Link *>::iterator it = m_links.begin(); it != m_links.end(); ++it) {
+    if ((*it)->m_handle >= 0) {
+      ::close((*it)->m_handle);
+      --m_pool.m_eventConnections;
     }
-    shortestQueue->second->m_requests.Enqueue(request);
+    delete *it;
+  }
+
+  for (HostMap::iterator it = m_hosts.begin(); it != m_hosts.end(); ++it)
+    delete it->second;
+
+  if (m_wakeUp[0] >= 0) {
+    ::close(m_wakeUp[0]);
+    ::close(m_wakeUp[1]);
   }
 }
 
 
-void PHTTPClientPool::Get(const PURL & url, const Notifier & notifier, const PString & body, const PString & contentType)
+void PHTTPClientPool::EventThread::Queue(const Request & request, const PString & hostPort)
 {
-  Request request(PHTTP::GET, url, notifier, body);
-  if (!contentType.IsEmpty())
-    request.m_headers.Set(PMIMEInfo::ContentTypeTag, contentType);
-  QueueRequest(request);
+  bool wasEmpty;
+  {
+    PWaitAndSignal lock(m_mutex);
+    wasEmpty = m_incoming.empty();
+    m_incoming.push_back(std::make_pair(hostPort, request));
+  }
+
+  // Only need to wake the thread once per batch of incoming requests
+  static const char wake = 0;
+  if (wasEmpty)
+    PAssertOS(::write(m_wakeUp[1], &wake, 1) >= 0 || errno == EAGAIN);
 }
 
 
-PHTTPClientPool::Connection::Connection(PHTTPClientPool & owner, const Request & request)
-  : m_owner(owner)
+void PHTTPClientPool::EventThread::Main()
+{
+  PTRACE(4, "Started HTTP pool event thread " << m_index);
+
+  while (m_running) {
+    // Build the poll list, and work out how long we can wait for
+    m_pollFds.resize(1);
+    m_pollFds[0].fd = m_wakeUp[0];
+    m_pollFds[0].events = POLLIN;
+    m_pollLinks.resize(1);
+
+    PInt64 nextDeadline = m_now + 1000;
+    for (std::list<Link *>::iterator it = m_links.begin(); it != m_links.end(); ++it) {
+      Link & link = **it;
+      struct pollfd pfd;
+      pfd.fd = link.m_handle;
+      pfd.events = POLLIN;
+      if (link.m_state == Link::Connecting || link.m_outputSent < link.m_outputLength)
+        pfd.events |= POLLOUT;
+      pfd.revents = 0;
+      m_pollFds.push_back(pfd);
+      m_pollLinks.push_back(&link);
+
+      PInt64 deadline = link.m_inFlight.empty() ? link.m_lastUse + m_pool.m_timeToLive.GetMilliSeconds() : link.m_deadline;
+      if (deadline < nextDeadline)
+        nextDeadline = deadline;
+    }
+
+    int timeout = (int)std::max((PInt64)0, nextDeadline - m_now);
+    int count = ::poll(&m_pollFds[0], m_pollFds.size(), timeout);
+    m_now = PTimer::Tick().GetMilliSeconds();
+    if (count < 0 && errno != EINTR) {
+      PTRACE(1, "HTTP pool event thread poll failed: " << strerror(errno));
+      break;
+    }
+
+    if (count > 0) {
+      if (m_pollFds[0].revents != 0) {
+        char buffer[64];
+        while (::read(m_wakeUp[0], buffer, sizeof(buffer)) > 0)
+          ;
+        AcceptIncoming();
+      }
+
+      for (size_t i = 1; i < m_pollFds.size(); ++i) {
+        short revents = m_pollFds[i].revents;
+        if (revents == 0)
+          continue;
+
+        Link & link = *m_pollLinks[i];
+        if (link.m_state == Link::Closed)
+          continue;
+
+        if (link.m_state == Link::Connecting) {
+          if (revents & (POLLOUT|POLLERR|POLLHUP))
+            OnConnected(link);
+          continue;
+        }
+
+        if (revents & POLLOUT)
+          Flush(link);
+
+        if (revents & (POLLIN|POLLERR|POLLHUP))
+          OnReadable(link);
+      }
+    }
+
+    // Time outs, both for responses and idle connections
+    for (std::list<Link *>::iterator it = m_links.begin(); it != m_links.end(); ++it) {
+      Link & link = **it;
+      if (link.m_state == Link::Closed)
+        continue;
+      if (!link.m_inFlight.empty()) {
+        if (link.m_deadline <= m_now) {
+          PTRACE(3, "Timeout " << (link.m_state == Link::Connecting ? "connecting" : "reading") << " on " << link.m_host.m_address);
+          Fail(link, link.m_state == Link::Connecting ? PHTTP::TransportConnectError : PHTTP::TransportReadError);
+        }
+      }
+      else if (link.m_lastUse + m_pool.m_timeToLive.GetMilliSeconds() <= m_now)
+        Close(link);
+    }
+
+    // Hand out requests to connections, then clean up the dead ones
+    for (HostMap::iterator it = m_hosts.begin(); it != m_hosts.end(); ++it) {
+      if (!it->second->m_pending.empty())
+        Schedule(*it->second);
+    }
+
+    for (std::list<Link *>::iterator it = m_links.begin(); it != m_links.end(); ) {
+      if ((*it)->m_state != Link::Closed)
+        ++it;
+      else {
+        (*it)->m_host.m_links.remove(*it);
+        delete *it;
+        m_links.erase(it++);
+      }
+    }
+
+    // Tell the application, done last as it may well queue more requests
+    for (size_t i = 0; i < m_completions.size(); ++i)
+      m_completions[i].first(m_pool, m_completions[i].second);
+    m_completions.clear();
+  }
+
+  PTRACE(4, "Ended HTTP pool event thread " << m_index);
+}
+
+
+void PHTTPClientPool::EventThread::AcceptIncoming()
 {
-  m_http.SetReadTimeout(owner.m_connectTimeout);
-  m_http.SetReadLineTimeout(owner.m_readTimeout);
+  std::vector< std::pair<PString, Request> > incoming;
+  {
+    PWaitAndSignal lock(m_mutex);
+    incoming.swap(m_incoming);
+  }
+
+  for (size_t i = 0; i < incoming.size(); ++i) {
+    HostMap::iterator it = m_hosts.find(incoming[i].first);
+    if (it == m_hosts.end())
+      it = m_hosts.insert(HostMap::value_type(incoming[i].first, new Host(incoming[i].first))).first;
+    it->second->m_pending.push_back(Pending(incoming[i].second));
+  }
+}
+
+
+void PHTTPClientPool::EventThread::Schedule(Host & host)
+{
+  while (!host.m_pending.empty()) {
+    Pending & next = host.m_pending.front();
+    bool idempotent = next.IsIdempotent();
+
+    // An idle connection is best, otherwise the shortest pipeline we are allowed to use
+    Link * best = NULL;
+    for (std::list<Link *>::iterator it = host.m_links.begin(); it != host.m_links.end(); ++it) {
+      Link & link = **it;
+      if (link.m_state == Link::Closed || link.m_closeAfter)
+        continue;
+      if (link.m_http2 != NULL) {
+        // Any request can share a HTTP/2 connection, so use the least busy
+        if (link.m_http2->CanOpenStream() &&
+            link.m_inFlight.size() < m_pool.m_maxPipeline &&
+            (best == NULL || link.m_inFlight.size() < best->m_inFlight.size()))
+          best = &link;
+        continue;
+      }
+      if (link.IsIdle()) {
+        best = &link;
+        break;
+      }
+      if (idempotent &&
+          link.m_canPipeline &&
+          link.m_unsafeInFlight == 0 &&
+          link.m_inFlight.size() < m_pool.m_maxPipeline &&
+          (best == NULL || link.m_inFlight.size() < best->m_inFlight.size()))
+        best = &link;
+    }
+
+    if ((best == NULL || (best->m_http2 == NULL && !best->IsIdle())) &&
+         host.m_links.size() < m_pool.m_maxParallel &&
+        (m_pool.m_eventConnections < m_pool.m_maxConnections || CloseIdleLink(host))) {
+      Link * link = OpenLink(host);
+      if (link == NULL)
+        continue; // Failed the request, or all of them, so next is gone
+      best = link;
+    }
+
+    if (best == NULL)
+      return; // Have to wait for a connection to become free
+
+    // Remove from queue first, as a failure sending puts requests back on it
+    Pending pending = host.m_pending.front();
+    host.m_pending.pop_front();
+    AddToOutput(*best, pending);
+  }
+}
+
+
+PHTTPClientPool::EventThread::Link * PHTTPClientPool::EventThread::OpenLink(Host & host)
+{
+  PHTTP::StatusCode error = PHTTP::TransportConnectError;
+
+  if (!host.m_address.IsValid()) {
+    PURL url(host.m_pending.front().m_request.m_url);
+    PIPSocket::Address ip;
+    if (PIPSocket::GetHostAddress(url.GetHostName(), ip))
+      host.m_address = PIPSocketAddressAndPort(ip, url.GetPort());
+    else {
+      PTRACE(2, "Could not resolve " << url.GetHostName());
+      // Everything queued for this host will fail
+      while (!host.m_pending.empty()) {
+        Response response;
+        response.m_code = error;
+        Complete(host.m_pending.front().m_request, response);
+        host.m_pending.pop_front();
+      }
+      return NULL;
+    }
+  }
+
+  PIPSocket::Address ip = host.m_address.GetAddress();
+  sockaddr_storage sa;
+  socklen_t saLen;
+  memset(&sa, 0, sizeof(sa));
+#if P_HAS_IPV6
+  if (ip.GetVersion() == 6) {
+    sockaddr_in6 * sa6 = (sockaddr_in6 *)&sa;
+    sa6->sin6_family = AF_INET6;
+    sa6->sin6_addr = ip;
+    sa6->sin6_port = htons(host.m_address.GetPort());
+    saLen = sizeof(sockaddr_in6);
+  }
+  else
+#endif
+  {
+    sockaddr_in * sa4 = (sockaddr_in *)&sa;
+    sa4->sin_family = AF_INET;
+    sa4->sin_addr = ip;
+    sa4->sin_port = htons(host.m_address.GetPort());
+    saLen = sizeof(sockaddr_in);
+  }
+
+  int handle = ::socket(sa.ss_family, SOCK_STREAM, 0);
+  if (handle >= 0) {
+    ::fcntl(handle, F_SETFL, O_NONBLOCK);
+    ::fcntl(handle, F_SETFD, FD_CLOEXEC);
+    int on = 1;
+    ::setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (char *)&on, sizeof(on));
+#ifdef SO_NOSIGPIPE
+    ::setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, (char *)&on, sizeof(on));
+#endif
+
+    if (::connect(handle, (sockaddr *)&sa, saLen) == 0 || errno == EINPROGRESS) {
+      Link * link = new Link(host, handle, m_now);
+      link->m_deadline = m_now + m_pool.m_connectTimeout.GetMilliSeconds();
+      host.m_links.push_back(link);
+      m_links.push_back(link);
+      ++m_pool.m_eventConnections;
+      PTRACE(4, "Connecting to " << host.m_address << " for " << host.m_hostPort);
+
+      if (m_pool.m_http2) {
+        // Preface and SETTINGS go as soon as we are connected
+        link->m_http2 = new HTTP2(*this, *link);
+        link->m_http2->SetReceiveWindow(PHTTP2Connection::DefaultReceiveWindow);
+        link->m_http2->Start();
+        FlushHTTP2(*link);
+      }
+      return link;
+    }
+
+    ::close(handle);
+  }
+
+  PTRACE(2, "Could not connect to " << host.m_address << ": " << strerror(errno));
+  Response response;
+  response.m_code = error;
+  Complete(host.m_pending.front().m_request, response);
+  host.m_pending.pop_front();
+  return NULL;
+}
+
+
+bool PHTTPClientPool::EventThread::CloseIdleLink(const Host & except)
+{
+  for (std::list<Link *>::iterator it = m_links.begin(); it != m_links.end(); ++it) {
+    if (&(*it)->m_host != &except && (*it)->IsIdle()) {
+      Close(**it);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void PHTTPClientPool::EventThread::AddToOutput(Link & link, const Pending & pending)
+{
+  if (link.m_http2 != NULL) {
+    AddToHTTP2(link, pending);
+    return;
+  }
+
+  const Request & request = pending.m_request;
+
+  PStringStream strm;
+  strm << PHTTPClient().GetNameFromCommand(request.m_command) << ' ' << request.m_url.AsString(PURL::RelativeOnly) << " HTTP/1.1\r\n";
+  if (!request.m_headers.Contains(PHTTP::HostTag()))
+    strm << PHTTP::HostTag() << ": " << request.m_url.GetHostPort(true) << "\r\n";
+  if (!request.m_headers.Contains(PHTTP::ConnectionTag()))
+    strm << PHTTP::ConnectionTag() << ": " << PHTTP::KeepAliveTag() << "\r\n";
+#if P_ZLIB
+  if (m_pool.m_contentDecoding && !request.m_headers.Contains(PHTTP::AcceptEncodingTag()))
+    strm << PHTTP::AcceptEncodingTag() << ": " << PZLib::GetAcceptEncoding() << "\r\n";
+#endif
+  if (!request.m_headers.Contains(PHTTP::ContentLengthTag()) &&
+      (!request.m_body.IsEmpty() || request.m_command == PHTTP::POST || request.m_command == PHTTP::PUT))
+    strm << PHTTP::ContentLengthTag() << ": " << request.m_body.GetLength() << "\r\n";
+  strm << setfill('\r') << request.m_headers;
+
+  PUInt64 outputStart = link.m_written + link.m_outputLength - link.m_outputSent;
+  PINDEX needed = link.m_outputLength + strm.GetLength() + request.m_body.GetLength();
+  if (needed > link.m_output.GetSize())
+    link.m_output.SetSize(std::max(needed, link.m_output.GetSize()*2));
+  memcpy(link.m_output.GetPointer() + link.m_outputLength, (const char *)strm, strm.GetLength());
+  link.m_outputLength += strm.GetLength();
+  memcpy(link.m_output.GetPointer() + link.m_outputLength, (const char *)request.m_body, request.m_body.GetLength());
+  link.m_outputLength += request.m_body.GetLength();
+
+  if (link.m_inFlight.empty())
+    link.m_deadline = m_now + (link.m_state == Link::Connecting ? m_pool.m_connectTimeout : m_pool.m_readTimeout).GetMilliSeconds();
+  link.m_inFlight.push_back(pending);
+  link.m_inFlight.back().m_outputStart = outputStart;
+  if (!pending.IsIdempotent())
+    ++link.m_unsafeInFlight;
+
+  PTRACE(4, "Queued " << request.m_url << " on " << link.m_host.m_address
+         << ", " << link.m_inFlight.size() << " in flight");
+
+  if (link.m_state == Link::Open)
+    Flush(link);
+}
+
+
+void PHTTPClientPool::EventThread::Flush(Link & link)
+{
+  while (link.m_outputSent < link.m_outputLength) {
+    ssize_t sent = ::send(link.m_handle, link.m_output.GetPointer() + link.m_outputSent,
+                          link.m_outputLength - link.m_outputSent, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      if (errno == EINTR)
+        continue;
+      /* The server has probably closed on us, but may still have responses
+         on the way, so read those before retrying whatever is left over. */
+      PTRACE(3, "Write error on " << link.m_host.m_address << ": " << strerror(errno));
+      link.m_closeAfter = true;
+      break;
+    }
+    link.m_outputSent += sent;
+    link.m_written += sent;
+  }
+
+  link.m_outputSent = link.m_outputLength = 0;
+}
+
+
+void PHTTPClientPool::EventThread::OnConnected(Link & link)
+{
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (::getsockopt(link.m_handle, SOL_SOCKET, SO_ERROR, (char *)&error, &len) < 0)
+    error = errno;
+  if (error != 0) {
+    PTRACE(2, "Could not connect to " << link.m_host.m_address << ": " << strerror(error));
+    Fail(link, PHTTP::TransportConnectError);
+    return;
+  }
+
+  PTRACE(4, "Connected to " << link.m_host.m_address);
+  link.m_state = Link::Open;
+  link.m_deadline = m_now + m_pool.m_readTimeout.GetMilliSeconds();
+  Flush(link);
+}
+
+
+void PHTTPClientPool::EventThread::OnReadable(Link & link)
+{
+  if (link.m_http2 != NULL) {
+    OnReadableHTTP2(link);
+    return;
+  }
+
+  while (link.m_state == Link::Open) {
+    BYTE * buffer;
+    PINDEX size;
+    bool direct = link.m_parse == Link::ReadBody && link.m_inputStart == link.m_inputEnd;
+    if (direct) {
+      // Read straight into the response body
+      buffer = (BYTE *)link.m_response.m_body.GetPointerAndSetLength(link.m_bodyLength + link.m_bodyRemaining) + link.m_bodyLength;
+      size = link.m_bodyRemaining;
+    }
+    else {
+      if (link.m_inputStart == link.m_inputEnd)
+        link.m_inputStart = link.m_inputEnd = 0;
+      else if (link.m_inputEnd == link.m_input.GetSize()) {
+        if (link.m_inputStart > 0) {
+          memmove(link.m_input.GetPointer(), link.m_input.GetPointer() + link.m_inputStart, link.m_inputEnd - link.m_inputStart);
+          link.m_inputEnd -= link.m_inputStart;
+          link.m_inputStart = 0;
+        }
+        else
+          link.m_input.SetSize(link.m_input.GetSize()*2);
+      }
+      buffer = link.m_input.GetPointer() + link.m_inputEnd;
+      size = link.m_input.GetSize() - link.m_inputEnd;
+    }
+
+    ssize_t received = ::recv(link.m_handle, buffer, size, 0);
+    if (received < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      PTRACE(2, "Read error on " << link.m_host.m_address << ": " << strerror(errno));
+      Fail(link, PHTTP::TransportReadError);
+      return;
+    }
+
+    if (received == 0) {
+      if (link.m_parse == Link::ReadUntilClose && !link.m_inFlight.empty())
+        OnResponse(link);
+      PTRACE_IF(4, link.m_inFlight.empty(), "Connection closed by " << link.m_host.m_address);
+      Fail(link, PHTTP::TransportReadError);
+      return;
+    }
+
+    link.m_deadline = m_now + m_pool.m_readTimeout.GetMilliSeconds();
+
+    if (direct) {
+      link.m_bodyLength += received;
+      link.m_bodyRemaining -= received;
+      if (link.m_bodyRemaining == 0)
+        OnResponse(link);
+    }
+    else {
+      link.m_inputEnd += received;
+      if (!ParseInput(link))
+        return;
+    }
+
+    // A short read means we have probably drained the socket, let poll() say otherwise
+    if (received < (ssize_t)size)
+      return;
+  }
+}
+
+
+bool PHTTPClientPool::EventThread::ParseInput(Link & link)
+{
+  while (link.m_state == Link::Open && link.m_inputStart < link.m_inputEnd) {
+    const char * data = (const char *)(link.m_input.GetPointer() + link.m_inputStart);
+    PINDEX available = link.m_inputEnd - link.m_inputStart;
+
+    if (link.m_inFlight.empty()) {
+      PTRACE(2, "Unsolicited data from " << link.m_host.m_address);
+      Fail(link, PHTTP::BadResponse);
+      return false;
+    }
+
+    link.m_responseStarted = true;
+
+    switch (link.m_parse) {
+      case Link::ReadHeader :
+      case Link::ReadChunkSize :
+      case Link::ReadTrailer :
+      {
+        // Need a complete line, or for headers a blank line
+        const char * end = NULL;
+        for (PINDEX i = 0; i+1 < available; ++i) {
+          if (data[i] == '\r' && data[i+1] == '\n') {
+            if (link.m_parse != Link::ReadHeader || (i+3 < available && data[i+2] == '\r' && data[i+3] == '\n')) {
+              end = data + i;
+              break;
+            }
+          }
+        }
+        if (end == NULL) {
+          if (available > MaxHeaderSize) {
+            PTRACE(2, "Header too large from " << link.m_host.m_address);
+            Fail(link, PHTTP::BadResponse);
+            return false;
+          }
+          return true;
+        }
+
+        PINDEX length = end - data;
+        if (link.m_parse == Link::ReadHeader) {
+          link.m_inputStart += length + 4;
+          if (!ParseHeader(link, data, length))
+            return false;
+        }
+        else {
+          link.m_inputStart += length + 2;
+          if (link.m_parse == Link::ReadTrailer) {
+            if (length == 0)
+              OnResponse(link);
+          }
+          else {
+            char * next;
+            unsigned long chunkSize = strtoul(data, &next, 16);
+            if (next == data) {
+              PTRACE(2, "Bad chunk size from " << link.m_host.m_address);
+              Fail(link, PHTTP::BadResponse);
+              return false;
+            }
+            if (chunkSize == 0)
+              link.m_parse = Link::ReadTrailer;
+            else if (link.m_bodyLength + (PUInt64)chunkSize > m_pool.m_maxBodySize) {
+              PTRACE(2, "Chunked body too large from " << link.m_host.m_address);
+              Fail(link, PHTTP::BadResponse);
+              return false;
+            }
+            else {
+              link.m_bodyRemaining = chunkSize;
+              link.m_parse = Link::ReadChunkData;
+            }
+          }
+        }
+        break;
+      }
+
+      case Link::ReadBody :
+      case Link::ReadChunkData :
+      {
+        PINDEX length = std::min(available, link.m_bodyRemaining);
+        if (!AppendBody(link, (const BYTE *)data, length))
+          return false;
+        link.m_inputStart += length;
+        link.m_bodyRemaining -= length;
+        if (link.m_bodyRemaining == 0) {
+          if (link.m_parse == Link::ReadBody)
+            OnResponse(link);
+          else
+            link.m_parse = Link::ReadChunkEnd;
+        }
+        break;
+      }
+
+      case Link::ReadChunkEnd :
+        if (available < 2)
+          return true;
+        link.m_inputStart += 2;
+        link.m_parse = Link::ReadChunkSize;
+        break;
+
+      case Link::ReadUntilClose :
+        if (!AppendBody(link, (const BYTE *)data, available))
+          return false;
+        link.m_inputStart += available;
+        break;
+    }
+  }
+
+  return link.m_state == Link::Open;
+}
+
+
+bool PHTTPClientPool::EventThread::ParseHeader(Link & link, const char * header, PINDEX length)
+{
+  PString lines(header, length);
+  PINDEX lineEnd = lines.Find("\r\n");
+  PString statusLine = lines.Left(lineEnd);
+
+  // "HTTP/1.1 200 OK"
+  if (statusLine.NumCompare("HTTP/1.") != PObject::EqualTo || statusLine.GetLength() < 12) {
+    PTRACE(2, "Bad status line from " << link.m_host.m_address << ": " << statusLine);
+    Fail(link, PHTTP::BadResponse);
+    return false;
+  }
+
+  bool http11 = statusLine[7] != '0';
+  int code = statusLine.Mid(9, 3).AsInteger();
+
+  Response & response = link.m_response;
+  response.m_headers.RemoveAll();
+  response.m_code = (PHTTP::StatusCode)code;
+
+  PString previous;
+  while (lineEnd != P_MAX_INDEX) {
+    PINDEX start = lineEnd + 2;
+    lineEnd = lines.Find("\r\n", start);
+    PString line = lines(start, lineEnd-1);
+    if (line.IsEmpty())
+      continue;
+    if (isspace(line[0]) && !previous.IsEmpty())
+      response.m_headers.SetAt(previous, response.m_headers.Get(previous) + ' ' + line.Trim());
+    else {
+      PINDEX colon = line.Find(':');
+      if (colon != P_MAX_INDEX) {
+        previous = line.Left(colon).Trim();
+        response.m_headers.AddMIME(previous, line.Mid(colon+1).Trim());
+      }
+    }
+  }
+
+  // Interim responses are skipped, the real one follows
+  if (code >= 100 && code < 200 && code != PHTTP::SwitchingProtocols) {
+    link.m_responseStarted = false;
+    return true;
+  }
+
+  PCaselessString connection = response.m_headers.Get(PHTTP::ConnectionTag());
+  if (http11 ? (connection.Find("close") != P_MAX_INDEX) : (connection.Find("keep-alive") == P_MAX_INDEX))
+    link.m_closeAfter = true;
+  else if (http11)
+    link.m_canPipeline = true;
+
+  link.m_bodyLength = 0;
+  response.m_body.MakeEmpty();
+
+  if (link.m_inFlight.front().m_request.m_command == PHTTP::HEAD ||
+      code == PHTTP::NoContent || code == PHTTP::NotModified || code < 200) {
+    OnResponse(link);
+    return true;
+  }
+
+  if (PCaselessString(response.m_headers.Get(PHTTP::TransferEncodingTag())).Find(PHTTP::ChunkedTag()) != P_MAX_INDEX) {
+    link.m_parse = Link::ReadChunkSize;
+    return true;
+  }
+
+  if (response.m_headers.Contains(PHTTP::ContentLengthTag())) {
+    // Only digits, no sign, nothing that could wrap, and not more than we are prepared to hold
+    PString lengthStr = response.m_headers.Get(PHTTP::ContentLengthTag()).Trim();
+    PUInt64 contentLength = lengthStr.AsUnsigned64(10);
+    if (lengthStr.IsEmpty() || lengthStr.FindSpan("0123456789") != P_MAX_INDEX || lengthStr.GetLength() > 19) {
+      PTRACE(2, "Bad Content-Length from " << link.m_host.m_address << ": " << lengthStr);
+      Fail(link, PHTTP::BadResponse);
+      return false;
+    }
+    if (contentLength > m_pool.m_maxBodySize) {
+      PTRACE(2, "Content-Length " << contentLength << " too large from " << link.m_host.m_address);
+      Fail(link, PHTTP::BadResponse);
+      return false;
+    }
+
+    link.m_bodyRemaining = (PINDEX)contentLength;
+    if (link.m_bodyRemaining == 0)
+      OnResponse(link);
+    else {
+      response.m_body.SetSize(link.m_bodyRemaining+1);
+      link.m_parse = Link::ReadBody;
+    }
+    return true;
+  }
+
+  link.m_closeAfter = true;
+  link.m_parse = Link::ReadUntilClose;
+  return true;
+}
+
+
+bool PHTTPClientPool::EventThread::AppendBody(Link & link, const BYTE * data, PINDEX length)
+{
+  if (link.m_bodyLength + (PUInt64)length > m_pool.m_maxBodySize) {
+    PTRACE(2, "Body too large from " << link.m_host.m_address);
+    Fail(link, PHTTP::BadResponse);
+    return false;
+  }
+
+  PString & body = link.m_response.m_body;
+  if (link.m_parse != Link::ReadBody && link.m_bodyLength + length >= body.GetSize())
+    body.SetSize(std::max(link.m_bodyLength + length + 1, body.GetSize()*2));
+  memcpy(body.GetPointerAndSetLength(link.m_bodyLength + length) + link.m_bodyLength, data, length);
+  link.m_bodyLength += length;
+  return true;
+}
+
+
+void PHTTPClientPool::EventThread::OnResponse(Link & link)
+{
+  // The body was read into the buffer directly, so set its length now
+  link.m_response.m_body.GetPointerAndSetLength(link.m_bodyLength);
+
+  Pending & pending = link.m_inFlight.front();
+  PTRACE(4, "Response " << link.m_response.m_code << " for " << pending.m_request.m_url
+         << ", " << link.m_response.m_body.GetLength() << " bytes");
+
+  Complete(pending.m_request, link.m_response);
+  if (!pending.IsIdempotent())
+    --link.m_unsafeInFlight;
+  link.m_inFlight.pop_front();
+
+  link.m_response = Response();
+  link.m_parse = Link::ReadHeader;
+  link.m_responseStarted = false;
+  link.m_lastUse = m_now;
+  ++link.m_completed;
+
+  if (link.m_closeAfter) {
+    // Anything pipelined behind this response will not get answered, so try again elsewhere
+    Fail(link, PHTTP::TransportReadError);
+  }
+}
+
+
+void PHTTPClientPool::EventThread::Fail(Link & link, PHTTP::StatusCode code)
+{
+  /* Retry requests the server never started on, in their original order. A
+     connection that has already answered something was closed by the server
+     at its own request limit, which does not count against the retries. A
+     request that is not idempotent may have been acted on if any of it was
+     written, so is never retried automatically (RFC 7230 section 6.3.1). */
+  bool first = true;
+  PendingQueue retry;
+  while (!link.m_inFlight.empty()) {
+    Pending & pending = link.m_inFlight.front();
+    bool started = link.m_http2 != NULL ? link.m_responses.find(pending.m_streamId) != link.m_responses.end()
+                                        : (first && link.m_responseStarted);
+    bool written = link.m_written > pending.m_outputStart;
+    if (started ||
+        (written && !pending.IsIdempotent()) ||
+        (link.m_completed == 0 && ++pending.m_attempts >= MaxAttempts)) {
+      Response response;
+      response.m_code = code;
+      Complete(pending.m_request, response);
+    }
+    else
+      retry.push_back(pending);
+    link.m_inFlight.pop_front();
+    first = false;
+  }
+
+  link.m_host.m_pending.insert(link.m_host.m_pending.begin(), retry.begin(), retry.end());
+  Close(link);
+}
+
+
+void PHTTPClientPool::EventThread::Close(Link & link)
+{
+  if (link.m_state == Link::Closed)
+    return;
+
+  PTRACE(4, "Closing connection to " << link.m_host.m_address << " after " << link.m_completed << " responses");
+
+  // Let a HTTP/2 server know, if we can without blocking
+  if (link.m_http2 != NULL && link.m_state == Link::Open && !link.m_http2->HasFailed()) {
+    link.m_http2->GoAway();
+    FlushHTTP2(link);
+  }
+
+  link.m_state = Link::Closed;
+  ::close(link.m_handle);
+  link.m_handle = -1;
+  --m_pool.m_eventConnections;
+}
+
+
+void PHTTPClientPool::EventThread::Complete(const Request & request, const Response & response)
+{
+  if (request.m_notifier.IsNULL())
+    return;
+
+  m_completions.push_back(std::make_pair(request.m_notifier, response));
+
+#if P_ZLIB
+  // The body is already all in memory, so decode it in one go
+  PZLib::Format format;
+  Response & decoded = m_completions.back().second;
+  if (m_pool.m_contentDecoding && PZLib::FromContentEncoding(decoded.m_headers.Get(PHTTP::ContentEncodingTag()), format)) {
+    PBYTEArray body;
+    if (PZLib::Decompress((const char *)decoded.m_body, decoded.m_body.GetLength(), body, format, m_pool.m_maxDecodedSize)) {
+      decoded.m_body = PString((const char *)(const BYTE *)body, body.GetSize());
+      decoded.m_headers.RemoveAt(PHTTP::ContentEncodingTag());
+      if (decoded.m_headers.Contains(PHTTP::ContentLengthTag()))
+        decoded.m_headers.SetVar(PHTTP::ContentLengthTag(), body.GetSize());
+    }
+    else {
+      PTRACE(2, "Could not decode " << decoded.m_headers.Get(PHTTP::ContentEncodingTag()) << " body for " << request.m_url);
+      decoded.m_code = PHTTP::ContentProcessorError;
+    }
+  }
+#endif
+}
+
+
+void PHTTPClientPool::EventThread::AddToHTTP2(Link & link, const Pending & pending)
+{
+  const Request & request = pending.m_request;
+
+  DWORD streamId = link.m_http2->OpenStream();
+  if (!PAssert(streamId != 0, PLogicError)) {
+    link.m_host.m_pending.push_front(pending);
+    return;
+  }
+
+  PHPACK::FieldList fields;
+  fields.push_back(PHPACK::Field(":method", PHTTPClient().GetNameFromCommand(request.m_command)));
+  fields.push_back(PHPACK::Field(":scheme", request.m_url.GetScheme()));
+  fields.push_back(PHPACK::Field(":authority", request.m_headers.Get(PHTTP::HostTag(), request.m_url.GetHostPort(true))));
+  PString path = request.m_url.AsString(PURL::RelativeOnly);
+  fields.push_back(PHPACK::Field(":path", path.IsEmpty() ? PString('/') : path));
+
+  for (PMIMEInfo::const_iterator it = request.m_headers.begin(); it != request.m_headers.end(); ++it) {
+    if (it->first == PHTTP::HostTag() || PHTTP2Connection::IsConnectionSpecific(it->first))
+      continue;
+    PString name = it->first.ToLower();
+    PStringArray values = it->second.Lines();
+    for (PINDEX i = 0; i < values.GetSize(); ++i)
+      fields.push_back(PHPACK::Field(name, values[i]));
+  }
+
+#if P_ZLIB
+  if (m_pool.m_contentDecoding && !request.m_headers.Contains(PHTTP::AcceptEncodingTag()))
+    fields.push_back(PHPACK::Field("accept-encoding", PZLib::GetAcceptEncoding()));
+#endif
+
+  if (!request.m_headers.Contains(PHTTP::ContentLengthTag()) &&
+      (!request.m_body.IsEmpty() || request.m_command == PHTTP::POST || request.m_command == PHTTP::PUT))
+    fields.push_back(PHPACK::Field("content-length", PString(PString::Unsigned, request.m_body.GetLength())));
+
+  // Anything the framing has not handed over yet is ahead of this, so it might be later
+  PUInt64 outputStart = link.m_written + link.m_outputLength - link.m_outputSent;
+  link.m_http2->SendHeaders(streamId, fields, request.m_body.IsEmpty());
+
+  if (link.m_inFlight.empty())
+    link.m_deadline = m_now + (link.m_state == Link::Connecting ? m_pool.m_connectTimeout : m_pool.m_readTimeout).GetMilliSeconds();
+  link.m_inFlight.push_back(pending);
+  link.m_inFlight.back().m_streamId = streamId;
+  link.m_inFlight.back().m_outputStart = outputStart;
+  link.m_inFlight.back().m_bodySent = 0;
+  SendHTTP2Body(link, link.m_inFlight.back());
+
+  PTRACE(4, "Queued " << request.m_url << " on " << link.m_host.m_address
+         << " stream " << streamId << ", " << link.m_inFlight.size() << " in flight");
+
+  FlushHTTP2(link);
+}
+
+
+void PHTTPClientPool::EventThread::SendHTTP2Body(Link & link, Pending & pending)
+{
+  const PString & body = pending.m_request.m_body;
+  if (pending.m_bodySent >= body.GetLength())
+    return;
+
+  PINDEX sent = link.m_http2->SendData(pending.m_streamId,
+                                       (const char *)body + pending.m_bodySent,
+                                       body.GetLength() - pending.m_bodySent,
+                                       true);
+  if (sent == P_MAX_INDEX)
+    pending.m_bodySent = body.GetLength(); // Stream was reset
+  else
+    pending.m_bodySent += sent;
+}
+
+
+void PHTTPClientPool::EventThread::FlushHTTP2(Link & link)
+{
+  if (!link.m_http2->HasOutput())
+    return;
+
+  if (link.m_outputLength == 0) {
+    link.m_http2->GetOutput(link.m_output, link.m_outputLength);
+    link.m_outputSent = 0;
+  }
+  else {
+    // Still sending the last lot, so add to the end of it
+    PBYTEArray output;
+    PINDEX length;
+    link.m_http2->GetOutput(output, length);
+    PINDEX needed = link.m_outputLength + length;
+    if (needed > link.m_output.GetSize())
+      link.m_output.SetSize(std::max(needed, link.m_output.GetSize()*2));
+    memcpy(link.m_output.GetPointer() + link.m_outputLength, output, length);
+    link.m_outputLength = needed;
+  }
+
+  if (link.m_state == Link::Open)
+    Flush(link);
+}
+
+
+void PHTTPClientPool::EventThread::OnReadableHTTP2(Link & link)
+{
+  while (link.m_state == Link::Open) {
+    PINDEX size;
+    BYTE * buffer = link.m_http2->GetReceiveBuffer(size);
+    ssize_t received = ::recv(link.m_handle, buffer, size, 0);
+    if (received < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      PTRACE(2, "Read error on " << link.m_host.m_address << ": " << strerror(errno));
+      Fail(link, PHTTP::TransportReadError);
+      return;
+    }
+
+    if (received == 0) {
+      PTRACE_IF(4, link.m_inFlight.empty(), "Connection closed by " << link.m_host.m_address);
+      Fail(link, PHTTP::TransportReadError);
+      return;
+    }
+
+    link.m_deadline = m_now + m_pool.m_readTimeout.GetMilliSeconds();
+
+    // Stream events are called from in here, then send anything they, or the framing, queued
+    bool ok = link.m_http2->ProcessReceived(received);
+    FlushHTTP2(link);
+    if (!ok) {
+      PTRACE(2, "HTTP/2 connection error with " << link.m_host.m_address);
+      Fail(link, PHTTP::BadResponse);
+      return;
+    }
+
+    if (received < (ssize_t)size)
+      return;
+  }
+}
+
+
+PHTTPClientPool::EventThread::PendingQueue::iterator PHTTPClientPool::EventThread::FindStream(Link & link, DWORD streamId)
+{
+  PendingQueue::iterator it = link.m_inFlight.begin();
+  while (it != link.m_inFlight.end() && it->m_streamId != streamId)
+    ++it;
+  return it;
+}
+
+
+void PHTTPClientPool::EventThread::OnHTTP2Headers(Link & link, DWORD streamId, PHPACK::FieldList & fields, bool endStream)
+{
+  StreamResponseMap::iterator it = link.m_responses.find(streamId);
+  if (it == link.m_responses.end()) {
+    // First header block has the status, interim responses are skipped
+    int code = 0;
+    for (size_t i = 0; i < fields.size(); ++i) {
+      if (fields[i].m_name == ":status")
+        code = fields[i].m_value.AsInteger();
+    }
+
+    if (code < 100 || code > 999 || (code < 200 && endStream)) {
+      PTRACE(2, "Bad status " << code << " on stream " << streamId << " from " << link.m_host.m_address);
+      link.m_http2->ResetStream(streamId, PHTTP2Connection::ProtocolError);
+      OnHTTP2Reset(link, streamId, PHTTP2Connection::ProtocolError);
+      return;
+    }
+
+    if (code < 200)
+      return;
+
+    it = link.m_responses.insert(StreamResponseMap::value_type(streamId, StreamResponse())).first;
+    it->second.m_response.m_code = (PHTTP::StatusCode)code;
+  }
+
+  // Trailers are simply added to the headers
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (fields[i].m_name[0] != ':')
+      it->second.m_response.m_headers.AddMIME(fields[i].m_name, fields[i].m_value);
+  }
+
+  if (endStream)
+    CompleteHTTP2(link, streamId, it->second.m_response);
+}
+
+
+void PHTTPClientPool::EventThread::OnHTTP2Data(Link & link, DWORD streamId, const BYTE * data, PINDEX length, bool endStream)
+{
+  StreamResponseMap::iterator it = link.m_responses.find(streamId);
+  if (it == link.m_responses.end()) {
+    PTRACE(2, "DATA before HEADERS on stream " << streamId << " from " << link.m_host.m_address);
+    link.m_http2->ResetStream(streamId, PHTTP2Connection::ProtocolError);
+    OnHTTP2Reset(link, streamId, PHTTP2Connection::ProtocolError);
+    return;
+  }
+
+  PString & body = it->second.m_response.m_body;
+  PINDEX & bodyLength = it->second.m_bodyLength;
+  if (bodyLength + (PUInt64)length > m_pool.m_maxBodySize) {
+    PTRACE(2, "Body too large on stream " << streamId << " from " << link.m_host.m_address);
+    link.m_http2->ResetStream(streamId, PHTTP2Connection::Cancel);
+    OnHTTP2Reset(link, streamId, PHTTP2Connection::Cancel);
+    return;
+  }
+
+  if (bodyLength + length >= body.GetSize()) {
+    PINDEX size = std::max(bodyLength + length + 1, body.GetSize()*2);
+    if (bodyLength == 0) {
+      // Only a hint, so the limit is all we check, less is fine
+      PUInt64 contentLength = it->second.m_response.m_headers.Get(PHTTP::ContentLengthTag()).AsUnsigned64(10);
+      if (contentLength < m_pool.m_maxBodySize)
+        size = std::max(size, (PINDEX)contentLength+1);
+    }
+    body.SetSize(size);
+  }
+  memcpy(body.GetPointerAndSetLength(bodyLength + length) + bodyLength, data, length);
+  bodyLength += length;
+
+  if (endStream) {
+    body.GetPointerAndSetLength(bodyLength);
+    CompleteHTTP2(link, streamId, it->second.m_response);
+  }
+}
+
+
+void PHTTPClientPool::EventThread::OnHTTP2Reset(Link & link, DWORD streamId, PHTTP2Connection::ErrorCode error)
+{
+  PendingQueue::iterator it = FindStream(link, streamId);
+  if (it == link.m_inFlight.end())
+    return;
+
+  // A refused stream was never looked at by the server, so is always safe to retry
+  if (error == PHTTP2Connection::RefusedStream && ++it->m_attempts < MaxAttempts) {
+    link.m_host.m_pending.push_front(*it);
+    link.m_inFlight.erase(it);
+    link.m_responses.erase(streamId);
+    return;
+  }
+
+  it->m_bodySent = it->m_request.m_body.GetLength(); // Nothing more can be sent
+  Response response;
+  response.m_code = PHTTP::TransportReadError;
+  CompleteHTTP2(link, streamId, response);
+}
+
+
+void PHTTPClientPool::EventThread::OnHTTP2GoAway(Link & link, DWORD lastStreamId)
+{
+  // Streams the server did not get to go elsewhere, in their original order
+  link.m_closeAfter = true;
+
+  PendingQueue retry;
+  for (PendingQueue::iterator it = link.m_inFlight.begin(); it != link.m_inFlight.end(); ) {
+    if (it->m_streamId <= lastStreamId)
+      ++it;
+    else {
+      retry.push_back(*it);
+      link.m_responses.erase(it->m_streamId);
+      it = link.m_inFlight.erase(it);
+    }
+  }
+  link.m_host.m_pending.insert(link.m_host.m_pending.begin(), retry.begin(), retry.end());
+
+  if (link.m_inFlight.empty())
+    Close(link);
+}
+
+
+void PHTTPClientPool::EventThread::OnHTTP2Window(Link & link, DWORD streamId)
+{
+  for (PendingQueue::iterator it = link.m_inFlight.begin(); it != link.m_inFlight.end(); ++it) {
+    if (streamId == 0 || it->m_streamId == streamId)
+      SendHTTP2Body(link, *it);
+  }
+}
+
+
+void PHTTPClientPool::EventThread::CompleteHTTP2(Link & link, DWORD streamId, const Response & response)
+{
+  PendingQueue::iterator it = FindStream(link, streamId);
+  if (it != link.m_inFlight.end()) {
+    PTRACE(4, "Response " << response.m_code << " for " << it->m_request.m_url
+           << " on stream " << streamId << ", " << response.m_body.GetLength() << " bytes");
+    Complete(it->m_request, response);
+
+    // Server answered before we finished sending, we can stop now
+    bool bodyUnsent = it->m_bodySent < it->m_request.m_body.GetLength();
+    link.m_inFlight.erase(it);
+    if (bodyUnsent)
+      link.m_http2->ResetStream(streamId, PHTTP2Connection::NoError);
+  }
+
+  link.m_responses.erase(streamId);
+  link.m_lastUse = m_now;
+  ++link.m_completed;
+
+  if (link.m_closeAfter && link.m_inFlight.empty())
+    Close(link);
+}
+
+#endif // _WIN32
+
+
+void PHTTPClientPool::ShutDown()
+{
+  PWaitAndSignal lock(m_mutex);
+
+  for (ConnectionMap::iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+    delete it->second;
+  m_connections.clear();
+
+#ifndef _WIN32
+  for (size_t i = 0; i < m_eventThreadList.size(); ++i)
+    delete m_eventThreadList[i];
+  m_eventThreadList.clear();
+#endif
+}
+
+
+void PHTTPClientPool::QueueRequest(const Request & request)
+{
+  PString hostPort = request.m_url.GetHostPort();
+  if (hostPort.IsEmpty() || (unsigned)request.m_command >= PHTTP::NumCommands) {
+    PAssertAlways(PInvalidParameter);
+    return;
+  }
+
+#ifndef _WIN32
+  if (m_eventThreads > 0 && request.m_url.GetScheme() == "http") {
+    EventThread * thread;
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_eventThreadList.empty()) {
+        for (unsigned i = 0; i < m_eventThreads; ++i)
+          m_eventThreadList.push_back(new EventThread(*this, i));
+      }
+
+      // All requests for a host go to the same thread
+      unsigned hash = 0;
+      for (const char * ptr = hostPort; *ptr != '\0'; ++ptr)
+        hash = hash*31 + (BYTE)*ptr;
+      thread = m_eventThreadList[hash % m_eventThreadList.size()];
+    }
+    thread->Queue(request, hostPort);
+    return;
+  }
+#endif
+
+  QueueThreadedRequest(request, hostPort);
+}
+
+
+void PHTTPClientPool::QueueThreadedRequest(const Request & request, const PString & hostPort)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  for (;;) {
+    for (ConnectionMap::iterator it = m_connections.begin(); it != m_connections.end(); ) {
+      if (it->second->m_lastUse.GetElapsed() < m_timeToLive)
+        ++it;
+      else {
+        delete it->second;
+        m_connections.erase(it++);
+      }
+    }
+
+    if (m_connections.size() + m_eventConnections < m_maxConnections)
+      break;
+
+    m_mutex.Signal();
+    PThread::Sleep(100);
+    m_mutex.Wait();
+  }
+
+  std::pair<ConnectionMap::iterator, ConnectionMap::iterator> range = m_connections.equal_range(hostPort);
+  if (range.first == m_connections.end() || std::distance(range.first, range.second) < (ptrdiff_t)m_maxParallel)
+    m_connections.insert(std::make_pair(hostPort, new Connection(*this, request)));
+  else {
+    ConnectionMap::iterator shortestQueue = range.first;
+    for (ConnectionMap::iterator it = range.first; it != range.second; ++it) {
+      if (it->second->m_requests.size() < shortestQueue->second->m_requests.size())
+        shortestQueue = it;
+    }
+    shortestQueue->second->m_requests.Enqueue(request);
+  }
+}
+
+
+void PHTTPClientPool::Get(const PURL & url, const Notifier & notifier, const PString & body, const PString & contentType)
+{
+  Request request(PHTTP::GET, url, notifier, body);
+  if (!contentType.IsEmpty())
+    request.m_headers.Set(PMIMEInfo::ContentTypeTag, contentType);
+  QueueRequest(request);
+}
+
+
+PHTTPClientPool::Connection::Connection(PHTTPClientPool & owner, const Request & request)
+  : m_owner(owner)
+{
+  m_http.SetReadTimeout(owner.m_connectTimeout);
+  m_http.SetReadLineTimeout(owner.m_readTimeout);
+  m_http.SetContentDecoding(owner.m_contentDecoding);
+  m_http.SetMaxDecodedSize(owner.m_maxDecodedSize);
+#if P_SSL
+  m_http.SetSSLCredentials(owner);
+#endif
   m_requests.Enqueue(request);
   m_thread = new PThreadObj<Connection>(*this, &Connection::Main, false, "PHTTPClient");
 }
@@ -1416,9 +3058,10 @@ void PHTTPClientPool::Connection::Main()
   Request request;
   while (m_requests.Dequeue(request)) {
     Response response;
-    response.m_code = m_http.ExecuteCommand(request.m_command, request.m_url, request.m_headers, response.m_body, response.m_headers);
+    response.m_code = m_http.ExecuteCommand(request.m_command, request.m_url, request.m_headers, request.m_body, response.m_headers);
     if (response.m_code >= 200)
       m_http.ReadContentBody(response.m_headers, response.m_body);
+    m_lastUse.SetCurrentTime();
     if (!request.m_notifier.IsNULL())
       request.m_notifier(m_owner, response);
   }
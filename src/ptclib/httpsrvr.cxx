@@ -29,8 +29,12 @@
 #ifdef P_HTTP
 
 #include <ptlib/sockets.h>
+#include <ptlib/bufchain.h>
 #include <ptclib/http.h>
+#include <ptclib/http2.h>
+#include <ptclib/pzlib.h>
 #include <ptclib/random.h>
+#include <ptlib/metrics.h>
 #include <ctype.h>
 
 #define new PNEW
@@ -52,6 +56,8 @@ static const char * accessFilename = "_access";
 
 static const PConstString WebSocketGUID("258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
 
+static PMetricHistogram s_requestDuration("ptlib_http_request_duration_seconds", "Time for PHTTPServer to read and answer a request");
+
 
 //////////////////////////////////////////////////////////////////////////////
 // PHTTPSpace
@@ -227,6 +233,10 @@ PHTTPServer::PHTTPServer(const PHTTPSpace & space)
 void PHTTPServer::Construct()
 {
   m_transactionCount = 0;
+  m_http2Allowed = false;
+  m_webSocketDeflate = false;
+  m_http2Switch = NoHTTP2Switch;
+  m_http2Stream = NULL;
   SetReadLineTimeout(ReadLineTimeout);
 }
 
@@ -251,6 +261,14 @@ PBoolean PHTTPServer::ProcessCommand()
 
   m_connectInfo.m_commandCode = (Commands)cmd;
   if (cmd >= NumCommands) {
+    if (m_http2Allowed && m_transactionCount == 0 && args == "PRI * HTTP/2.0") {
+      // Put back what we read of the preface, PHTTP2Server checks the lot
+      PTRACE(4, "Switching to HTTP/2 with prior knowledge");
+      UnRead(PHTTP2Connection::Preface, 16);
+      m_http2Switch = HTTP2PriorKnowledge;
+      return false;
+    }
+
     PTRACE(4, "Unknown command.");
     OnError(BadRequest, args.ToLiteral(), m_connectInfo);
     return false;
@@ -271,6 +289,11 @@ PBoolean PHTTPServer::ProcessCommand()
   m_transactionCount++;
   m_nextTimeout = m_connectInfo.GetPersistenceTimeout();
 
+  // Tell the client this is the last transaction, rather than just closing on it
+  unsigned maxTransactions = m_connectInfo.GetPersistenceMaximumTransations();
+  if (maxTransactions > 0 && m_transactionCount >= maxTransactions)
+    m_connectInfo.DisablePersistence();
+
   PIPSocket * socket = GetSocket();
   WORD myPort = (WORD)(socket != NULL ? socket->GetPort() : 80);
 
@@ -296,6 +319,22 @@ PBoolean PHTTPServer::ProcessCommand()
             " proxy=" << m_connectInfo.IsProxyConnection() << ","
             " websocket=" << m_connectInfo.IsWebSocket());
 
+  if (m_http2Allowed && m_connectInfo.IsHTTP2Upgrade() && cmd != CONNECT) {
+    // Any entity body comes before the switch, the response is on stream 1
+    long contentLength = m_connectInfo.m_mimeInfo.GetInteger(ContentLengthTag, 0);
+    if (contentLength > 0)
+      m_connectInfo.m_entityBody = ReadString((PINDEX)contentLength);
+
+    PTRACE(4, "Switching to HTTP/2 via upgrade");
+    PMIMEInfo reply;
+    reply.SetAt(ConnectionTag(), UpgradeTag());
+    reply.SetAt(UpgradeTag(), PHTTP2Connection::UpgradeName);
+    StartResponse(SwitchingProtocols, reply, -1);
+    flush();
+    m_http2Switch = HTTP2Upgraded;
+    return false;
+  }
+
   if (m_connectInfo.IsWebSocket()) {
     if (!OnWebSocket(m_connectInfo))
       return false;
@@ -321,6 +360,10 @@ PBoolean PHTTPServer::ProcessCommand()
 
   flush();
 
+  // WebSocket connections last until closed, so are not a request duration
+  if (!m_connectInfo.IsWebSocket())
+    s_requestDuration.Record(PTime() - now);
+
   // if the function just indicated that the connection is to persist,
   // and so did the client, then return true. Note that all of the OnXXXX
   // routines above must make sure that their return value is false if
@@ -443,6 +486,12 @@ void PHTTPServer::SwitchToWebSocket(const PString & protocol, const PString & ke
   reply.SetAt(WebSocketProtocolTag(), protocol);
   reply.SetAt(WebSocketAcceptTag(), PMessageDigestSHA1::Encode(key + WebSocketGUID));
 
+  if (m_webSocketDeflate) {
+    m_connectInfo.m_webSocketExtensions = PWebSocket::NegotiateExtensions(m_connectInfo.GetMIME()(WebSocketExtensionsTag()));
+    if (!m_connectInfo.m_webSocketExtensions.IsEmpty())
+      reply.SetAt(WebSocketExtensionsTag(), m_connectInfo.m_webSocketExtensions);
+  }
+
   StartResponse(SwitchingProtocols, reply, -1);
   flush();
 }
@@ -483,8 +532,13 @@ PString PHTTPServer::ReadEntityBody()
     entityBody = ReadString((PINDEX)contentLength);
   else if (contentLength == -2)
     ReadLine(entityBody, false);
-  else if (contentLength < 0)
-    entityBody = ReadString(P_MAX_INDEX);
+  else if (contentLength < 0) {
+    // Appending to a string until EOF reallocates, and copies, all the way
+    PBufferChain chain;
+    while (ReadChain(chain, 64*PBufferChain::BlockSize))
+      ;
+    entityBody = chain.AsString();
+  }
 
   // close the connection, if not persistent
   if (!m_connectInfo.IsPersistent()) {
@@ -497,6 +551,37 @@ PString PHTTPServer::ReadEntityBody()
 }
 
 
+bool PHTTPServer::ReadEntityBody(PBufferChain & body)
+{
+  if (m_connectInfo.GetMajorVersion() < 1)
+    return true;
+
+  bool ok = true;
+  long contentLength = m_connectInfo.GetEntityBodyLength();
+  if (contentLength > 0)
+    ok = ReadBlock(body, (PINDEX)contentLength);
+  else if (contentLength == -2) {
+    PString line;
+    ok = ReadLine(line, false);
+    body.Append(line);
+  }
+  else if (contentLength < 0) {
+    while (ReadChain(body, 64*PBufferChain::BlockSize))
+      ;
+    ok = GetErrorCode(LastReadError) == NoError;
+  }
+
+  // close the connection, if not persistent
+  if (!m_connectInfo.IsPersistent()) {
+    PIPSocket * socket = GetSocket();
+    if (socket != NULL)
+      socket->Shutdown(PIPSocket::ShutdownRead);
+  }
+
+  return ok;
+}
+
+
 PString PHTTPServer::GetServerName() const
 {
   return "PWLib-HTTP-Server/1.0 PWLib/1.0";
@@ -639,6 +724,12 @@ bool PHTTPServer::StartResponse(StatusCode code,
 {
   if (m_connectInfo.m_majorVersion < 1) 
     return false;
+
+  // HTTP/2 sends the status and headers as a frame, and never uses chunking
+  if (m_http2Stream != NULL) {
+    m_http2Stream->StartResponse(code, headers, bodySize);
+    return false;
+  }
   
   httpStatusCodeStruct dummyInfo;
   const httpStatusCodeStruct * statusInfo;
@@ -659,8 +750,9 @@ bool PHTTPServer::StartResponse(StatusCode code,
 
   PBoolean chunked = false;
 
-  // If do not have user set content length, decide if we should add one
-  if (!headers.Contains(ContentLengthTag())) {
+  // If do not have user set content length, decide if we should add one,
+  // but never on an informational response, e.g. switching protocols
+  if (code >= RequestOK && !headers.Contains(ContentLengthTag())) {
     if (m_connectInfo.m_minorVersion < 1) {
       // v1.0 client, don't put in ContentLength if the bodySize is zero because
       // that can be confused by some browsers as meaning there is no body length.
@@ -726,6 +818,8 @@ void PHTTPServer::SetDefaultMIMEInfo(PMIMEInfo & info, const PHTTPConnectionInfo
       info.SetAt(ConnectionTag, KeepAliveTag());
     }
   }
+  else if (!connectInfo.IsProxyConnection() && !info.Contains(ConnectionTag))
+    info.SetAt(ConnectionTag, "close");
 }
 
 
@@ -792,6 +886,8 @@ PHTTPListener::PHTTPListener(unsigned maxWorkers)
   : m_listenerPort(80)
   , m_listenerThread(NULL)
   , m_threadPool(maxWorkers, 0, "HTTP-Service")
+  , m_http2Enabled(true)
+  , m_streamThreadPool(maxWorkers, 0, "HTTP2-Stream")
 {
 }
 
@@ -873,6 +969,7 @@ void PHTTPListener::ShutdownListeners()
   m_httpServersMutex.Signal();
 
   m_threadPool.Shutdown();
+  m_streamThreadPool.Shutdown(); // After connections, which wait for their streams
 
   m_httpListeningSockets.RemoveAll();
 }
@@ -891,6 +988,8 @@ void PHTTPListener::ListenMain()
       for (PSocket::SelectList::iterator it = listeners.begin(); it != listeners.end(); ++it) {
         PTCPSocket * socket = new PTCPSocket;
         if (socket->Accept(*it)) {
+          // Headers and body are often written separately, don't let Nagle hold the body back
+          socket->SetOption(TCP_NODELAY, 1, IPPROTO_TCP);
           PTRACE(5, "Queuing thread pool work for: local=" << socket->GetLocalAddress() << ", peer=" << socket->GetPeerAddress());
           m_threadPool.AddWork(new Worker(*this, socket));
         }
@@ -994,9 +1093,26 @@ void PHTTPListener::Worker::Work()
   PTRACE(5, "Started" << socketInfo);
   m_listener.OnHTTPStarted(*m_httpServer);
 
-  // process requests
-  while (m_httpServer->ProcessCommand()) {
-    PTRACE(5, "Processed" << socketInfo << ", duration=" << m_httpServer->GetLastCommandTime().GetElapsed());
+  // If TLS negotiated HTTP/2, we go straight to it
+  bool http2 = false;
+#if P_SSL
+  PSSLChannel * ssl = dynamic_cast<PSSLChannel *>(channel);
+  http2 = ssl != NULL && ssl->GetALPN() == PHTTP2Connection::ALPN;
+#endif
+
+  if (!http2) {
+    // process requests
+    m_httpServer->SetHTTP2Allowed(m_listener.IsHTTP2Enabled());
+    while (m_httpServer->ProcessCommand()) {
+      PTRACE(5, "Processed" << socketInfo << ", duration=" << m_httpServer->GetLastCommandTime().GetElapsed());
+    }
+    http2 = m_httpServer->GetHTTP2Switch() != PHTTPServer::NoHTTP2Switch;
+  }
+
+  if (http2) {
+    PTRACE(4, "Processing HTTP/2" << socketInfo);
+    PHTTP2Server connection(m_listener, *m_httpServer);
+    connection.Main(m_httpServer->GetHTTP2Switch() == PHTTPServer::HTTP2Upgraded ? &m_httpServer->GetConnectionInfo() : NULL);
   }
 
   m_listener.OnHTTPEnded(*m_httpServer);
@@ -1186,16 +1302,102 @@ bool PHTTPRequest::SendResponse(const PString & body, bool html)
 
 #if P_SSL
 
+// The mask is applied with the widest operations available, it is XOR of a
+// repeating four byte pattern so the width makes no difference to the result.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define P_WEBSOCKET_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define P_WEBSOCKET_SSE2 0
+#endif
+
+/* Apply the RFC6455/5.3 masking key to len bytes of src, writing to dst,
+   which may be the same. Returns the key rotated so the next byte of the
+   payload continues the pattern.
+ */
+static uint32_t ApplyWebSocketMask(BYTE * dst, const BYTE * src, PINDEX len, uint32_t mask)
+{
+  PINDEX i = 0;
+
+#if P_WEBSOCKET_SSE2
+  if (len >= 16) {
+    __m128i mask128 = _mm_set1_epi32((int)mask);
+    for (; i + 64 <= len; i += 64) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(src+i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src+i+16));
+      __m128i c = _mm_loadu_si128((const __m128i *)(src+i+32));
+      __m128i d = _mm_loadu_si128((const __m128i *)(src+i+48));
+      _mm_storeu_si128((__m128i *)(dst+i),    _mm_xor_si128(a, mask128));
+      _mm_storeu_si128((__m128i *)(dst+i+16), _mm_xor_si128(b, mask128));
+      _mm_storeu_si128((__m128i *)(dst+i+32), _mm_xor_si128(c, mask128));
+      _mm_storeu_si128((__m128i *)(dst+i+48), _mm_xor_si128(d, mask128));
+    }
+    for (; i + 16 <= len; i += 16)
+      _mm_storeu_si128((__m128i *)(dst+i), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src+i)), mask128));
+  }
+#endif
+
+  uint64_t mask64 = ((uint64_t)mask << 32) | mask;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t value;
+    memcpy(&value, src+i, 8);
+    value ^= mask64;
+    memcpy(dst+i, &value, 8);
+  }
+
+  // Everything above was a multiple of four, so the key is still in step
+  BYTE key[4];
+  memcpy(key, &mask, 4);
+  for (; i < len; ++i)
+    dst[i] = src[i] ^ key[i&3];
+
+  BYTE rotated[4];
+  for (PINDEX k = 0; k < 4; ++k)
+    rotated[k] = key[(len+k)&3];
+  memcpy(&mask, rotated, 4);
+  return mask;
+}
+
+
+static const PINDEX WebSocketReadAheadSize = 16384;
+static const PINDEX WebSocketMaskChunkSize = 65536;
+static const PINDEX WebSocketCoalesceSize = 4096;
+static const BYTE WebSocketDeflateTail[4] = { 0x00, 0x00, 0xff, 0xff };
+static const char WebSocketDeflateName[] = "permessage-deflate";
+
+
 PWebSocket::PWebSocket()
   : m_client(false)
   , m_fragmentingWrite(false)
   , m_binaryWrite(false)
+  , m_continuingWrite(false)
   , m_maxFrameSize(1000000000) // A gigabyte seems a lot
   , m_remainingPayload(0)
   , m_currentMask(-1)
   , m_fragmentedRead(false)
+  , m_compressedRead(false)
   , m_recursiveRead(false)
+  , m_readAheadOffset(0)
+  , m_readAheadLength(0)
+  , m_offerDeflate(false)
+  , m_deflateNoContextTakeover(false)
+  , m_deflater(NULL)
+  , m_inflater(NULL)
+  , m_deflatedLength(0)
+  , m_inflatedOffset(0)
+  , m_inflatedLength(0)
+{
+}
+
+
+PWebSocket::~PWebSocket()
 {
+  Close();
+#if P_ZLIB
+  delete m_deflater;
+  delete m_inflater;
+#endif
 }
 
 
@@ -1220,28 +1422,49 @@ PBoolean PWebSocket::Read(void * buf, PINDEX len)
 
 bool PWebSocket::InternalRead(void * buf, PINDEX len)
 {
+  if (m_inflatedOffset < m_inflatedLength)
+    return ReadInflated(buf, len);
+
   if (m_remainingPayload > 0)
     return ReadMasked(buf, len);
 
+  if (!ReadDataHeader())
+    return false;
+
+  if (!m_compressedRead)
+    return ReadMasked(buf, len);
+
+  // Compressed messages are inflated whole, then returned a piece at a time
+  m_inflatedOffset = 0;
+  return InflateMessage(m_inflated, m_inflatedLength) && ReadInflated(buf, len);
+}
+
+
+bool PWebSocket::ReadDataHeader()
+{
   for (;;) {
     OpCodes opCode;
     if (!ReadHeader(opCode, m_fragmentedRead, m_remainingPayload, m_currentMask))
       return false;
 
-    PBYTEArray payload;
-
     if (m_remainingPayload > m_maxFrameSize) {
       PTRACE(3, "Closing due to excessive frame size: " << m_remainingPayload << " > " << m_maxFrameSize);
-      InternalWrite(ConnectionClose, false, payload, payload.GetSize());
-      CloseBaseReadChannel();
+      CloseWithStatus(1009);
+      return false;
+    }
+
+    if (m_compressedRead && (m_inflater == NULL || opCode == Continuation || opCode >= ConnectionClose)) {
+      PTRACE(2, "WebSocket received unexpected compressed frame, op-code: " << opCode);
+      CloseWithStatus(1002);
       return false;
     }
 
+    PBYTEArray payload;
     switch (opCode) {
       case Continuation :
       case TextFrame :
       case BinaryFrame :
-        return ReadMasked(buf, len);
+        return true;
 
       case Ping :
         // RFC6455/5.5.2 echo ping payload
@@ -1276,66 +1499,265 @@ bool PWebSocket::InternalRead(void * buf, PINDEX len)
 }
 
 
+bool PWebSocket::ReadBuffered(void * buf, PINDEX len)
+{
+  BYTE * ptr = (BYTE *)buf;
+  while (len > 0) {
+    if (m_readAheadOffset < m_readAheadLength) {
+      PINDEX count = std::min(len, m_readAheadLength - m_readAheadOffset);
+      memcpy(ptr, m_readAhead.GetPointer() + m_readAheadOffset, count);
+      m_readAheadOffset += count;
+      ptr += count;
+      len -= count;
+      continue;
+    }
+
+    /* Large payloads go straight into the callers buffer, anything smaller
+       fills our buffer, so a small message and the header of the next one
+       need one system call, not four. */
+    if (len >= WebSocketReadAheadSize) {
+      if (!ReadAvailable(ptr, len) || GetLastReadCount() == 0)
+        return false;
+      ptr += GetLastReadCount();
+      len -= GetLastReadCount();
+    }
+    else {
+      if (!ReadAvailable(m_readAhead.GetPointer(WebSocketReadAheadSize), WebSocketReadAheadSize) || GetLastReadCount() == 0)
+        return false;
+      m_readAheadOffset = 0;
+      m_readAheadLength = GetLastReadCount();
+    }
+  }
+
+  return true;
+}
+
+
+bool PWebSocket::ReadAvailable(void * buf, PINDEX len)
+{
+  {
+    PReadWaitAndSignal mutex(channelPointerMutex);
+
+    /* PHTTP waits to fill the whole buffer once its own read ahead is used
+       up, so go past it, after taking anything it read beyond the upgrade. */
+    PHTTP * http = dynamic_cast<PHTTP *>(readChannel);
+    if (http != NULL) {
+      http->SetReadTimeout(readTimeout);
+      bool ok = http->unReadCount > 0 ? http->Read(buf, std::min(len, http->unReadCount))
+                                      : http->PIndirectChannel::Read(buf, len);
+      SetErrorValues(http->GetErrorCode(LastReadError), http->GetErrorNumber(LastReadError), LastReadError);
+      SetLastReadCount(http->GetLastReadCount());
+      return ok;
+    }
+  }
+
+  return PIndirectChannel::Read(buf, len);
+}
+
+
 bool PWebSocket::ReadMasked(void * buf, PINDEX len)
 {
   // Don't read any more than what's remaining in payload
   if (len > (PINDEX)m_remainingPayload)
     len = (PINDEX)m_remainingPayload;
 
-  if (!ReadBlock(buf, len))
+  if (!ReadBuffered(buf, len))
     return false;
 
   // Only get here if exactly len bytes were read to buf
   m_remainingPayload -= len;
 
-  if (m_currentMask < 0)
-    return true;
+  if (m_currentMask >= 0)
+    m_currentMask = ApplyWebSocketMask((BYTE *)buf, (const BYTE *)buf, len, (uint32_t)m_currentMask);
 
-  BYTE * ptr = (BYTE *)buf;
-  while (len >= 4) {
-    *(uint32_t *)ptr ^= m_currentMask;
-    len -= 4;
-    ptr += 4;
-  }
+  SetLastReadCount(len);
+  return true;
+}
 
-  switch (len) {
-    case 1:
-      *(BYTE *)ptr ^= m_currentMask;
-      m_currentMask = uint32_t(m_currentMask << 24) | (m_currentMask >> 8);
-      break;
 
-    case 2:
-      *(uint16_t *)ptr ^= m_currentMask;
-      m_currentMask = uint32_t(m_currentMask << 16) | (m_currentMask >> 16);
-      break;
+bool PWebSocket::ReadInflated(void * buf, PINDEX len)
+{
+  PINDEX count = std::min(len, m_inflatedLength - m_inflatedOffset);
+  memcpy(buf, m_inflated.GetPointer() + m_inflatedOffset, count);
+  m_inflatedOffset += count;
+  SetLastReadCount(count);
+  return true;
+}
+
+
+bool PWebSocket::InflateMessage(PBYTEArray & output, PINDEX & outputLength)
+{
+  outputLength = 0;
+
+  PINDEX compressedLength = 0;
+  for (;;) {
+    PINDEX frameLength = (PINDEX)m_remainingPayload;
+    if (compressedLength + m_remainingPayload > m_maxFrameSize) {
+      PTRACE(3, "Closing due to excessive message size: " << compressedLength + m_remainingPayload);
+      CloseWithStatus(1009);
+      return false;
+    }
+
+    BYTE * ptr = m_compressedInput.GetPointer(compressedLength + frameLength + sizeof(WebSocketDeflateTail)) + compressedLength;
+    if (!ReadMasked(ptr, frameLength))
+      return false;
+    compressedLength += frameLength;
 
-    case 3:
-      *(uint16_t *)ptr ^= m_currentMask;
-      *(BYTE *)(ptr+2) ^= m_currentMask>>16;
-      m_currentMask = uint32_t(m_currentMask << 8) | (m_currentMask >> 24);
+    if (!m_fragmentedRead)
       break;
+
+    if (!ReadDataHeader())
+      return false;
   }
 
-  return true;
+  // RFC7692/7.2.2 put back the tail the sender removed
+  memcpy(m_compressedInput.GetPointer() + compressedLength, WebSocketDeflateTail, sizeof(WebSocketDeflateTail));
+  compressedLength += sizeof(WebSocketDeflateTail);
+
+#if P_ZLIB
+  // The inflater is kept between messages, so its limit is relative to what it has output so far
+  m_inflater->SetMaxOutput(m_inflater->GetTotalOut() + m_maxFrameSize);
+  if (m_inflater->Process(m_compressedInput, compressedLength, output, outputLength))
+    return true;
+
+  if (m_inflater->HasExceededMaxOutput()) {
+    PTRACE(3, "Closing due to excessive inflated message size, limit " << m_maxFrameSize);
+    CloseWithStatus(1009);
+    return false;
+  }
+#endif
+
+  PTRACE(2, "WebSocket could not inflate message");
+  CloseWithStatus(1007);
+  return false;
 }
 
 
 bool PWebSocket::ReadMessage(PBYTEArray & msg)
 {
-  if (!PAssert(m_remainingPayload == 0, "Cannot call ReadMessage when have partial frames unread."))
+  PINDEX length;
+  if (!InternalReadMessage(&msg, NULL, NULL, 0, length))
     return false;
 
-  PINDEX totalSize = 0;
-  do {
-    static const PINDEX chunkSize = 10000;
-    if (!Read(msg.GetPointer(totalSize + chunkSize) + totalSize, chunkSize))
-      return false;
-    totalSize += GetLastReadCount();
-  } while (!IsMessageComplete());
+  msg.SetSize(length);
+  return true;
+}
 
-  msg.SetSize(totalSize);
 
-  return true;
+bool PWebSocket::ReadMessage(void * buffer, PINDEX size, PINDEX & length)
+{
+  return InternalReadMessage(NULL, NULL, (BYTE *)buffer, size, length);
+}
+
+
+bool PWebSocket::ReadMessage(PBufferChain & msg)
+{
+  PINDEX length;
+  return InternalReadMessage(NULL, &msg, NULL, 0, length);
+}
+
+
+bool PWebSocket::InternalReadMessage(PBYTEArray * growing, PBufferChain * chain, BYTE * buffer, PINDEX size, PINDEX & length)
+{
+  length = 0;
+
+  if (CheckNotOpen())
+    return false;
+
+  if (!PAssert(IsMessageComplete(), "Cannot call ReadMessage when have partial frames unread."))
+    return false;
+
+  bool ok = false;
+  bool tooBig = false;
+  m_recursiveRead = true;
+
+  if (!ReadDataHeader())
+    goto done;
+
+  if (m_compressedRead) {
+    if (growing != NULL)
+      ok = InflateMessage(*growing, length);
+    else if (chain != NULL) {
+      PBYTEArray inflated;
+      if (InflateMessage(inflated, length)) {
+        inflated.SetSize(length);
+        chain->Append(inflated);
+        ok = true;
+      }
+    }
+    else if (InflateMessage(m_inflated, m_inflatedLength)) {
+      if (m_inflatedLength <= size) {
+        memcpy(buffer, m_inflated, m_inflatedLength);
+        length = m_inflatedLength;
+        ok = true;
+      }
+      else
+        tooBig = true;
+      m_inflatedLength = 0;
+    }
+  }
+  else {
+    // Each frame is read straight into its final place
+    for (;;) {
+      PINDEX frameLength = (PINDEX)m_remainingPayload;
+      if (chain != NULL) {
+        if (length + m_remainingPayload > m_maxFrameSize) {
+          tooBig = true;
+          break;
+        }
+
+        // Block by block, the chain is never reallocated
+        PINDEX remaining = frameLength;
+        while (remaining > 0) {
+          PINDEX count = remaining;
+          BYTE * ptr = chain->GetWritable(count);
+          if (!ReadMasked(ptr, count))
+            goto done;
+          chain->Commit(count);
+          remaining -= count;
+        }
+      }
+      else {
+        BYTE * ptr;
+        if (growing == NULL) {
+          if (frameLength > size - length) {
+            tooBig = true;
+            break;
+          }
+          ptr = buffer + length;
+        }
+        else {
+          if (length + m_remainingPayload > m_maxFrameSize) {
+            tooBig = true;
+            break;
+          }
+          ptr = growing->GetPointer(length + frameLength) + length;
+        }
+
+        if (!ReadMasked(ptr, frameLength))
+          goto done;
+      }
+      length += frameLength;
+
+      if (!m_fragmentedRead) {
+        ok = true;
+        break;
+      }
+
+      if (!ReadDataHeader())
+        goto done;
+    }
+  }
+
+  if (tooBig) {
+    PTRACE(3, "Closing due to message too large: " << length + m_remainingPayload);
+    CloseWithStatus(1009);
+    SetErrorValues(BufferTooSmall, EMSGSIZE, LastReadError);
+  }
+
+done:
+  m_recursiveRead = false;
+  return ok;
 }
 
 
@@ -1352,7 +1774,15 @@ bool PWebSocket::ReadText(PString & msg)
 
 bool PWebSocket::IsMessageComplete() const
 {
-  return !m_fragmentedRead && m_remainingPayload == 0;
+  return !m_fragmentedRead && m_remainingPayload == 0 && m_inflatedOffset >= m_inflatedLength;
+}
+
+
+void PWebSocket::CloseWithStatus(unsigned status)
+{
+  PUInt16b code((WORD)status);
+  InternalWrite(ConnectionClose, false, &code, sizeof(code));
+  CloseBaseReadChannel();
 }
 
 
@@ -1361,42 +1791,327 @@ PBoolean PWebSocket::Write(const void * buf, PINDEX len)
   if (CheckNotOpen())
     return false;
 
-  return InternalWrite(m_binaryWrite ? BinaryFrame : TextFrame, m_fragmentingWrite, buf, len);
+  PWaitAndSignal lock(m_writeMutex);
+
+  OpCodes opCode = m_continuingWrite ? Continuation : (m_binaryWrite ? BinaryFrame : TextFrame);
+  m_continuingWrite = m_fragmentingWrite;
+  if (!InternalWrite(opCode, m_fragmentingWrite, buf, len))
+    return false;
+
+  SetLastWriteCount(len);
+  return true;
+}
+
+
+bool PWebSocket::WriteMessage(const PBufferChain & msg)
+{
+  if (CheckNotOpen())
+    return false;
+
+  PWaitAndSignal lock(m_writeMutex);
+
+  // Masking and compression need it contiguous anyway
+  if (m_client || m_deflater != NULL || m_fragmentingWrite || m_continuingWrite) {
+    PBYTEArray data = msg.AsBYTEArray();
+    return Write(data, data.GetSize());
+  }
+
+  BYTE header[MaxHeaderSize];
+  PINDEX headerLen = EncodeHeader(header, m_binaryWrite ? BinaryFrame : TextFrame, false, false, msg.GetLength(), -1);
+  PBufferChain frame(header, headerLen);
+  frame.Append(msg);
+
+  PReadWaitAndSignal mutex(channelPointerMutex);
+
+  if (writeChannel == NULL)
+    return SetErrorValues(NotOpen, EBADF, LastWriteError);
+
+  // Protocol layers such as PHTTPServer pass the gathered write through
+  writeChannel->SetWriteTimeout(writeTimeout);
+  if (!writeChannel->WriteChain(frame)) {
+    SetErrorValues(writeChannel->GetErrorCode(LastWriteError), writeChannel->GetErrorNumber(LastWriteError), LastWriteError);
+    return false;
+  }
+
+  SetLastWriteCount(msg.GetLength());
+  return true;
 }
 
 
 bool PWebSocket::InternalWrite(OpCodes opCode, bool fragmenting, const void * buf, PINDEX len)
 {
-  // Make sure WriteHeader and WriteMasked/Write of body are atomic
+  // Make sure the header and body of the frame are atomic
   PWaitAndSignal lock(m_writeMutex);
 
-  if (!m_client)
-    return WriteHeader(opCode, fragmenting, len, -1) && PIndirectChannel::Write(buf, len);
+  if (m_deflater == NULL || opCode >= ConnectionClose)
+    return WriteFrame(opCode, fragmenting, false, buf, len);
+
+  // RFC7692/6 the first frame of the message says it is compressed
+  bool first = opCode != Continuation;
+  return Deflate(buf, len, first, !fragmenting) && WriteFrame(opCode, fragmenting, first, m_deflated, m_deflatedLength);
+}
+
+
+#if P_ZLIB
+static bool DeflateWebSocketMessage(PZLib & deflater, const void * data, PINDEX len, PBYTEArray & output, PINDEX & outputLength, bool final)
+{
+  outputLength = 0;
+  if (!deflater.Process(data, len, output, outputLength, PZLib::SyncFlush))
+    return false;
+
+  if (!final)
+    return true;
+
+  // RFC7692/7.2.1 remove the tail every flush ends with
+  if (outputLength >= (PINDEX)sizeof(WebSocketDeflateTail) &&
+      memcmp(output.GetPointer() + outputLength - sizeof(WebSocketDeflateTail), WebSocketDeflateTail, sizeof(WebSocketDeflateTail)) == 0)
+    outputLength -= sizeof(WebSocketDeflateTail);
+
+  /* With nothing to flush zlib outputs nothing, but the receiver always
+     puts the tail back, so send the empty block of RFC7692/7.2.3.6 */
+  if (outputLength == 0) {
+    output.GetPointer(1)[0] = 0;
+    outputLength = 1;
+  }
+
+  return true;
+}
+#endif
+
+
+bool PWebSocket::Deflate(const void * data, PINDEX len, bool first, bool final)
+{
+#if P_ZLIB
+  if (first && m_deflateNoContextTakeover) {
+    delete m_deflater;
+    m_deflater = new PZLib(true, PZLib::RawDeflate);
+  }
+
+  if (DeflateWebSocketMessage(*m_deflater, data, len, m_deflated, m_deflatedLength, final))
+    return true;
+#endif
+
+  return SetErrorValues(Miscellaneous, EINVAL, LastWriteError);
+}
 
+
+bool PWebSocket::WriteFrame(OpCodes opCode, bool fragmenting, bool compressed, const void * buf, PINDEX len)
+{
+  if (!m_client) {
+    BYTE header[MaxHeaderSize];
+    PINDEX headerLen = EncodeHeader(header, opCode, fragmenting, compressed, len, -1);
+    return WriteGathered(header, headerLen, buf, len);
+  }
+
+  /* Client frames must be masked, which is done into our own buffer, just
+     after the header, so the first, or only, piece goes in one write. */
   uint32_t mask = PRandom::Number();
-  if (!WriteHeader(opCode, fragmenting, len, mask))
+  BYTE * frame = m_writeBuffer.GetPointer(MaxHeaderSize + WebSocketMaskChunkSize);
+  PINDEX headerLen = EncodeHeader(frame, opCode, fragmenting, compressed, len, mask);
+
+  const BYTE * ptr = (const BYTE *)buf;
+  PINDEX chunk = std::min(len, WebSocketMaskChunkSize);
+  mask = ApplyWebSocketMask(frame + headerLen, ptr, chunk, mask);
+  if (!PIndirectChannel::Write(frame, headerLen + chunk))
     return false;
 
-  const uint32_t * ptr = (const uint32_t *)buf;
-  while (len > 65536) {
-    if (!WriteMasked(ptr, 65536, mask))
+  while ((len -= chunk) > 0) {
+    ptr += chunk;
+    chunk = std::min(len, WebSocketMaskChunkSize);
+    mask = ApplyWebSocketMask(frame, ptr, chunk, mask);
+    if (!PIndirectChannel::Write(frame, chunk))
       return false;
-    ptr += 16384;
-    len -= 65536;
   }
 
-  return WriteMasked(ptr, len, mask);
+  return true;
+}
+
+
+bool PWebSocket::WriteGathered(const void * header, PINDEX headerLen, const void * payload, PINDEX len)
+{
+  {
+    PReadWaitAndSignal mutex(channelPointerMutex);
+
+    // Protocol layers such as PHTTPServer pass writes through unchanged
+    PChannel * channel = writeChannel;
+    PHTTP * http;
+    while ((http = dynamic_cast<PHTTP *>(channel)) != NULL) {
+      http->flush();
+      channel = http->GetWriteChannel();
+    }
+
+    PSocket * socket = dynamic_cast<PSocket *>(channel);
+    if (socket != NULL) {
+      socket->SetWriteTimeout(writeTimeout);
+
+      PSocket::Slice slices[2];
+      slices[0] = PSocket::Slice(header, headerLen);
+      slices[1] = PSocket::Slice(payload, len);
+
+      size_t first = 0;
+      for (;;) {
+        while (first < PARRAYSIZE(slices) && slices[first].GetLength() == 0)
+          ++first;
+        if (first >= PARRAYSIZE(slices))
+          return true;
+
+        if (!socket->Write(&slices[first], PARRAYSIZE(slices) - first)) {
+          SetErrorValues(socket->GetErrorCode(LastWriteError), socket->GetErrorNumber(LastWriteError), LastWriteError);
+          return false;
+        }
+
+        // Partial writes are possible, so move on past what went
+        size_t written = socket->GetLastWriteCount();
+        while (written > 0) {
+          size_t sliceLen = slices[first].GetLength();
+          if (written < sliceLen) {
+            slices[first].SetBase((BYTE *)slices[first].GetBase() + written);
+            slices[first].SetLength(sliceLen - written);
+            break;
+          }
+          written -= sliceLen;
+          slices[first++].SetLength(0);
+        }
+      }
+    }
+  }
+
+  // Some other channel, e.g. SSL, small frames are copied so are still written in one go
+  if (len <= WebSocketCoalesceSize) {
+    BYTE frame[MaxHeaderSize + WebSocketCoalesceSize];
+    memcpy(frame, header, headerLen);
+    memcpy(frame + headerLen, payload, len);
+    return PIndirectChannel::Write(frame, headerLen + len);
+  }
+
+  return PIndirectChannel::Write(header, headerLen) && PIndirectChannel::Write(payload, len);
+}
+
+
+PINDEX PWebSocket::Broadcast(const List & webSockets, const void * data, PINDEX len, bool binary)
+{
+  OpCodes opCode = binary ? BinaryFrame : TextFrame;
+
+  BYTE header[MaxHeaderSize];
+  PINDEX headerLen = EncodeHeader(header, opCode, false, false, len, -1);
+
+#if P_ZLIB
+  // Without context takeover, every WebSocket would produce the same bytes
+  PBYTEArray compressed;
+  PINDEX compressedLength = 0;
+  BYTE compressedHeader[MaxHeaderSize];
+  PINDEX compressedHeaderLen = 0;
+#endif
+
+  PINDEX count = 0;
+  for (List::const_iterator it = webSockets.begin(); it != webSockets.end(); ++it) {
+    PWebSocket & webSocket = **it;
+    if (!webSocket.IsOpen())
+      continue;
+
+    PWaitAndSignal lock(webSocket.m_writeMutex);
+
+    if (webSocket.m_continuingWrite) {
+      PTRACE(3, &webSocket, "Broadcast skipped WebSocket in the middle of a fragmented write");
+      continue;
+    }
+
+    bool ok;
+    if (webSocket.m_client || (webSocket.m_deflater != NULL && !webSocket.m_deflateNoContextTakeover))
+      ok = webSocket.InternalWrite(opCode, false, data, len);
+#if P_ZLIB
+    else if (webSocket.m_deflater != NULL) {
+      if (compressedHeaderLen == 0) {
+        PZLib zlib(true, PZLib::RawDeflate);
+        DeflateWebSocketMessage(zlib, data, len, compressed, compressedLength, true);
+        compressedHeaderLen = EncodeHeader(compressedHeader, opCode, false, true, compressedLength, -1);
+      }
+      ok = webSocket.WriteGathered(compressedHeader, compressedHeaderLen, compressed, compressedLength);
+    }
+#endif
+    else
+      ok = webSocket.WriteGathered(header, headerLen, data, len);
+
+    if (ok)
+      ++count;
+  }
+
+  return count;
+}
+
+
+bool PWebSocket::SetExtensions(const PString & extensions)
+{
+#if P_ZLIB
+  delete m_deflater;
+  m_deflater = NULL;
+  delete m_inflater;
+  m_inflater = NULL;
+#endif
+
+  if (extensions.IsEmpty())
+    return true;
+
+#if P_ZLIB
+  PStringArray params = extensions.Tokenise(';', false);
+  if ((params[0].Trim() *= WebSocketDeflateName) && extensions.Find(',') == P_MAX_INDEX) {
+    // Window sizes only matter to the compressor, and we never ask for a smaller one
+    m_deflateNoContextTakeover = false;
+    for (PINDEX i = 1; i < params.GetSize(); ++i) {
+      if (params[i].Trim() *= (m_client ? "client_no_context_takeover" : "server_no_context_takeover"))
+        m_deflateNoContextTakeover = true;
+    }
+
+    m_deflater = new PZLib(true, PZLib::RawDeflate);
+    m_inflater = new PZLib(false, PZLib::RawDeflate);
+    PTRACE(4, "WebSocket using " << WebSocketDeflateName << (m_deflateNoContextTakeover ? " without" : " with") << " context takeover");
+    return true;
+  }
+#endif
+
+  PTRACE(2, "WebSocket extensions not supported: " << extensions);
+  return false;
 }
 
 
-bool PWebSocket::WriteMasked(const uint32_t * data, PINDEX len, uint32_t mask)
+PString PWebSocket::NegotiateExtensions(const PString & offers)
 {
-  uint32_t buffer[16384];
-  PINDEX i = (len+3) / 4;
-  while (i-- > 0)
-    buffer[i] = data[i] ^ mask;
+#if P_ZLIB
+  PStringArray offerList = offers.Tokenise(',', false);
+  for (PINDEX i = 0; i < offerList.GetSize(); ++i) {
+    PStringArray params = offerList[i].Tokenise(';', false);
+    if (params.IsEmpty() || !(params[0].Trim() *= WebSocketDeflateName))
+      continue;
+
+    // RFC7692/7.1 decline offers with parameters we cannot honour
+    PStringStream reply;
+    reply << WebSocketDeflateName;
+    bool acceptable = true;
+    for (PINDEX p = 1; acceptable && p < params.GetSize(); ++p) {
+      PString param = params[p].Trim();
+      PString value;
+      PINDEX equal = param.Find('=');
+      if (equal != P_MAX_INDEX) {
+        value = param.Mid(equal+1).Trim();
+        param = param.Left(equal).Trim();
+      }
+
+      if ((param *= "server_no_context_takeover") || (param *= "client_no_context_takeover"))
+        reply << "; " << param;
+      else if (param *= "server_max_window_bits")
+        acceptable = value.AsUnsigned() == 15;
+      else if (!(param *= "client_max_window_bits"))
+        acceptable = false;
+    }
+
+    if (acceptable)
+      return reply;
+  }
+#else
+  PTRACE(4, "WebSocket", "Ignoring extension offer, no zlib: " << offers);
+#endif
 
-  return PIndirectChannel::Write(buffer, len);
+  return PString::Empty();
 }
 
 
@@ -1431,6 +2146,10 @@ bool PWebSocket::Connect(const PURL & url, const PStringArray & protocols, PStri
   if (!protocols.empty())
     outMIME.SetAt(PHTTP::WebSocketProtocolTag(), PSTRSTRM(std::setfill(',') << protocols));
   outMIME.SetAt(PHTTP::WebSocketKeyTag(), key);
+#if P_ZLIB
+  if (m_offerDeflate)
+    outMIME.SetAt(PHTTP::WebSocketExtensionsTag(), WebSocketDeflateName);
+#endif
 
   int result = http->ExecuteCommand(PHTTP::GET, url, outMIME, PString::Empty(), replyMIME);
   if (result < 100 || result >= 300) {
@@ -1449,18 +2168,23 @@ bool PWebSocket::Connect(const PURL & url, const PStringArray & protocols, PStri
     return false;
   }
 
-  PString protocol = outMIME(PHTTP::WebSocketProtocolTag());
+  PString protocol = replyMIME(PHTTP::WebSocketProtocolTag());
   if (!protocols.empty() && protocols.GetValuesIndex(protocol) == P_MAX_INDEX) {
     PTRACE(2, "WebSocket selected a protocol we did not offer.");
     SetErrorValues(ProtocolFailure, EPROTO);
     return false;
   }
 
+  m_client = true;
+  if (!SetExtensions(replyMIME(PHTTP::WebSocketExtensionsTag()))) {
+    SetErrorValues(ProtocolFailure, EPROTO);
+    return false;
+  }
+
   if (selectedProtocol != NULL)
     *selectedProtocol = protocol;
 
   PTRACE(3, "WebSocket started for protocol: " << protocol);
-  m_client = true;
   return true;
 }
 
@@ -1471,10 +2195,11 @@ bool PWebSocket::ReadHeader(OpCodes  & opCode,
                             int64_t  & masking)
 {
   BYTE header1;
-  if (!Read(&header1, 1))
+  if (!ReadBuffered(&header1, 1))
     return false;
 
   fragment = (header1 & 0x80) == 0;
+  m_compressedRead = (header1 & 0x40) != 0;
   opCode = (OpCodes)(header1 & 0xf);
 
   PTimeInterval oldTimeout = GetReadTimeout();
@@ -1482,14 +2207,14 @@ bool PWebSocket::ReadHeader(OpCodes  & opCode,
   bool ok = false;
 
   BYTE header2;
-  if (!Read(&header2, 1))
+  if (!ReadBuffered(&header2, 1))
     goto badHeader;
 
   switch (header2 & 0x7f) {
     case 126 :
     {
       PUInt16b len16;
-      if (!ReadBlock(&len16, 2))
+      if (!ReadBuffered(&len16, 2))
         goto badHeader;
       payloadLength = len16;
       break;
@@ -1498,7 +2223,7 @@ bool PWebSocket::ReadHeader(OpCodes  & opCode,
     case 127 :
     {
       PUInt64b len64;
-      if (!ReadBlock(&len64, 8))
+      if (!ReadBuffered(&len64, 8))
         goto badHeader;
       payloadLength = len64;
       break;
@@ -1512,7 +2237,7 @@ bool PWebSocket::ReadHeader(OpCodes  & opCode,
     masking = -1;
   else {
     uint32_t mask32;
-    if (!ReadBlock(&mask32, 4))
+    if (!ReadBuffered(&mask32, 4))
       goto badHeader;
 
     masking = mask32;
@@ -1531,34 +2256,49 @@ bool PWebSocket::WriteHeader(OpCodes  opCode,
                              uint64_t payloadLength,
                              int64_t  masking)
 {
-  BYTE header[14];
-  PUInt64b * pLen = (PUInt64b *)&header[2];
+  BYTE header[MaxHeaderSize];
+  return PIndirectChannel::Write(header, EncodeHeader(header, opCode, fragment, false, payloadLength, masking));
+}
+
+
+PINDEX PWebSocket::EncodeHeader(BYTE   * header,
+                                OpCodes  opCode,
+                                bool     fragment,
+                                bool     compressed,
+                                uint64_t payloadLength,
+                                int64_t  masking)
+{
   PINDEX len = 2;
 
   header[0] = (BYTE)opCode;
   if (!fragment)
     header[0] |= 0x80;
+  if (compressed)
+    header[0] |= 0x40;
 
   if (payloadLength < 126)
     header[1] = (BYTE)payloadLength;
   else if (payloadLength < 65536) {
     header[1] = 126;
-    *(PUInt16b *)pLen = (uint16_t)payloadLength;
+    PUInt16b len16 = (uint16_t)payloadLength;
+    memcpy(&header[len], &len16, sizeof(len16));
     len += 2;
   }
   else {
     header[1] = 127;
-    *pLen = payloadLength;
+    PUInt64b len64 = payloadLength;
+    memcpy(&header[len], &len64, sizeof(len64));
     len += 8;
   }
 
   if (masking >= 0) {
     header[1] |= 0x80;
-    *(uint32_t *)&header[len] = (uint32_t)masking;
+    uint32_t mask32 = (uint32_t)masking;
+    memcpy(&header[len], &mask32, sizeof(mask32));
     len += 4;
   }
 
-  return PIndirectChannel::Write(header, len);
+  return len;
 }
 
 #endif //P_SSL
@@ -1573,6 +2313,7 @@ PHTTPConnectionInfo::PHTTPConnectionInfo()
   , m_wasPersistent(false)
   , m_isProxyConnection(false)
   , m_isWebSocket(false)
+  , m_isHTTP2Upgrade(false)
   , m_majorVersion(0)
   , m_minorVersion(9)
   , m_entityBodyLength(-1)
@@ -1594,6 +2335,8 @@ PHTTPConnectionInfo::PHTTPConnectionInfo(const PHTTPConnectionInfo & other)
   , m_wasPersistent(other.m_wasPersistent)
   , m_isProxyConnection(other.m_isProxyConnection)
   , m_isWebSocket(other.m_isWebSocket)
+  , m_webSocketExtensions(other.m_webSocketExtensions)
+  , m_isHTTP2Upgrade(other.m_isHTTP2Upgrade)
   , m_majorVersion(other.m_majorVersion)
   , m_minorVersion(other.m_minorVersion)
   , m_entityBody(other.m_entityBody)
@@ -1643,6 +2386,8 @@ PBoolean PHTTPConnectionInfo::Initialise(PHTTPServer & server, PString & args)
 
   m_wasPersistent = m_isPersistent;
   m_isPersistent = false;
+  m_isHTTP2Upgrade = false;
+  m_webSocketExtensions.MakeEmpty();
 
   // check for Proxy-Connection and Connection strings
   PString str = m_mimeInfo(PHTTP::ProxyConnectionTag());
@@ -1659,6 +2404,12 @@ PBoolean PHTTPConnectionInfo::Initialise(PHTTPServer & server, PString & args)
         m_isPersistent = true;
       else if (token == PHTTP::UpgradeTag()) {
         PCaselessString protocol = m_mimeInfo(PHTTP::UpgradeTag());
+        if (protocol == PHTTP2Connection::UpgradeName) {
+          // Server may ignore this, and continue with HTTP/1.1
+          m_isHTTP2Upgrade = m_majorVersion == 1 && m_minorVersion >= 1 && m_mimeInfo.Contains(PHTTP2Connection::SettingsTag());
+          continue;
+        }
+
         if (protocol != PHTTP::WebSocketTag()) {
           PTRACE(4, "Cannot upgrade to protocol \"" << protocol << '"');
           return server.OnError(PHTTP::MethodNotAllowed, "Can only upgrade to \"websocket\" protocol", *this);
@@ -1726,6 +2477,8 @@ PHTTPResource::PHTTPResource(const PURL & url)
   : m_baseURL(url)
   , m_authority(NULL)
   , m_hitCount(0)
+  , m_compression(false)
+  , m_minCompressionSize(DefaultMinCompressionSize)
 {
 }
 
@@ -1734,6 +2487,8 @@ PHTTPResource::PHTTPResource(const PURL & url, const PHTTPAuthority & auth)
   : m_baseURL(url)
   , m_authority(auth.CloneAs<PHTTPAuthority>())
   , m_hitCount(0)
+  , m_compression(false)
+  , m_minCompressionSize(DefaultMinCompressionSize)
 {
 }
 
@@ -1743,6 +2498,8 @@ PHTTPResource::PHTTPResource(const PURL & url, const PString & type)
   , m_contentType(type)
   , m_authority(NULL)
   , m_hitCount(0)
+  , m_compression(false)
+  , m_minCompressionSize(DefaultMinCompressionSize)
 {
 }
 
@@ -1754,6 +2511,8 @@ PHTTPResource::PHTTPResource(const PURL & url,
   , m_contentType(type)
   , m_authority(auth.CloneAs<PHTTPAuthority>())
   , m_hitCount(0)
+  , m_compression(false)
+  , m_minCompressionSize(DefaultMinCompressionSize)
 {
 }
 
@@ -1765,6 +2524,8 @@ PHTTPResource::PHTTPResource(const PURL & url,
   , m_contentType(type)
   , m_authority(auth.CloneAs<PHTTPAuthority>())
   , m_hitCount(0)
+  , m_compression(false)
+  , m_minCompressionSize(DefaultMinCompressionSize)
 {
   SetAllowedOrigins(allowedOrigins);
 }
@@ -2003,11 +2764,119 @@ PBoolean PHTTPResource::LoadHeaders(PHTTPRequest & request)
 }
 
 
+#if P_ZLIB
+
+static bool IsCompressibleType(const PCaselessString & contentType)
+{
+  if (contentType.NumCompare("text/") == PObject::EqualTo)
+    return true;
+
+  PCaselessString type = contentType.Left(contentType.Find(';'));
+  return type.Find("json") != P_MAX_INDEX ||
+         type.Find("xml") != P_MAX_INDEX ||
+         type.Find("javascript") != P_MAX_INDEX ||
+         type == "application/x-www-form-urlencoded";
+}
+
+
+static void WriteCompressedData(PHTTPServer & server, bool chunked, const PBYTEArray & data, PINDEX & length)
+{
+  if (length == 0)
+    return;
+
+  if (chunked)
+    server << hex << length << dec << "\r\n";
+  server.Write(data, length);
+  if (chunked)
+    server << "\r\n";
+  length = 0;
+}
+
+
+/* Compress as the data is loaded, flushing at each block, so a resource that
+   produces its data over time, e.g. PHTTPTailFile, still works. If all the
+   data arrives in one go, the compressed length is known, so chunking is not
+   needed. */
+static void SendCompressedData(PHTTPResource & resource, PHTTPRequest & request, PZLib::Format format)
+{
+  PString encoding = PZLib::GetContentEncoding(format);
+
+  PBYTEArray compressed;
+  if (resource.LoadCompressedData(request, encoding, compressed)) {
+    request.outMIME.SetAt(PHTTP::ContentEncodingTag(), encoding);
+    request.contentSize = compressed.GetSize();
+    resource.StartResponse(request);
+    request.server.Write(compressed, compressed.GetSize());
+    return;
+  }
+
+  PCharArray data;
+  bool more = resource.LoadData(request, data);
+  if (!more && data.GetSize() < resource.GetMinCompressionSize()) {
+    request.contentSize = data.GetSize();
+    resource.StartResponse(request);
+    request.server.Write(data, data.GetSize());
+    return;
+  }
+
+  request.outMIME.SetAt(PHTTP::ContentEncodingTag(), encoding);
+
+  PZLib zlib(true, format);
+  PINDEX length = 0;
+
+  if (!more) {
+    zlib.Process(data, data.GetSize(), compressed, length, PZLib::Finish);
+    request.contentSize = length;
+    resource.StartResponse(request);
+    request.server.Write(compressed, length);
+  }
+  else {
+    request.contentSize = P_MAX_INDEX;
+    bool chunked = resource.StartResponse(request);
+    for (;;) {
+      zlib.Process(data, data.GetSize(), compressed, length, more ? PZLib::SyncFlush : PZLib::Finish);
+      WriteCompressedData(request.server, chunked, compressed, length);
+      if (!more)
+        break;
+      data.SetSize(0);
+      more = resource.LoadData(request, data);
+    }
+
+    if (chunked) {
+      request.outMIME.RemoveAll();
+      request.server << "0\r\n" << request.outMIME;
+    }
+  }
+
+  PTRACE(4, &resource, "Sent " << encoding << " body for " << request.url
+         << ", " << zlib.GetTotalIn() << " bytes compressed to " << zlib.GetTotalOut());
+}
+
+#endif // P_ZLIB
+
+
 void PHTTPResource::SendData(PHTTPRequest & request)
 {
   if (!request.outMIME.Contains(PHTTP::ContentTypeTag) && !m_contentType.IsEmpty())
     request.outMIME.SetAt(PHTTP::ContentTypeTag, m_contentType);
 
+#if P_ZLIB
+  if (m_compression) {
+    // Caches must know the response depends on what the client accepts
+    PString vary = request.outMIME.Get(PHTTP::VaryTag());
+    request.outMIME.SetAt(PHTTP::VaryTag(), vary.IsEmpty() ? PString("Accept-Encoding") : (vary + ", Accept-Encoding"));
+
+    PZLib::Format format;
+    if (!request.outMIME.Contains(PHTTP::ContentEncodingTag()) &&
+        (request.contentSize == P_MAX_INDEX || request.contentSize >= m_minCompressionSize) &&
+        IsCompressibleType(request.outMIME.Get(PHTTP::ContentTypeTag())) &&
+        PZLib::SelectContentEncoding(request.GetMIME().Get(PHTTP::AcceptEncodingTag()), format)) {
+      SendCompressedData(*this, request, format);
+      return;
+    }
+  }
+#endif // P_ZLIB
+
   PCharArray data;
   if (LoadData(request, data)) {
     if (StartResponse(request)) {
@@ -2045,6 +2914,12 @@ PBoolean PHTTPResource::LoadData(PHTTPRequest & request, PCharArray & data)
 }
 
 
+bool PHTTPResource::LoadCompressedData(PHTTPRequest &, const PString &, PBYTEArray &)
+{
+  return false;
+}
+
+
 PString PHTTPResource::LoadText(PHTTPRequest &)
 {
   PAssertAlways(PUnimplementedFunction);
@@ -2156,6 +3031,42 @@ PString PHTTPString::LoadText(PHTTPRequest &)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// PHTTPMetrics
+
+PHTTPMetrics::PHTTPMetrics(const PURL & url)
+  : PHTTPResource(url, ContentType())
+{
+}
+
+
+PHTTPMetrics::PHTTPMetrics(const PURL & url, const PHTTPAuthority & auth)
+  : PHTTPResource(url, ContentType(), auth)
+{
+}
+
+
+const PString & PHTTPMetrics::ContentType()
+{
+  static PConstString const type("text/plain; version=0.0.4; charset=utf-8");
+  return type;
+}
+
+
+PBoolean PHTTPMetrics::LoadHeaders(PHTTPRequest &)
+{
+  return true; // Length not known till the text is generated, so chunked
+}
+
+
+PString PHTTPMetrics::LoadText(PHTTPRequest &)
+{
+  PStringStream strm;
+  PMetric::OutputAllPrometheus(strm);
+  return strm;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // PHTTPFile
 
@@ -2283,6 +3194,142 @@ PString PHTTPFile::LoadText(PHTTPRequest & request)
 }
 
 
+#if P_ZLIB
+
+/* Compressed files, so each is only compressed once, at the best level, no
+   matter how often it is asked for. An entry is replaced if the file changes,
+   and the oldest entries are dropped when the cache is full. */
+class PHTTPCompressedFileCache
+{
+  public:
+    PHTTPCompressedFileCache()
+      : m_totalSize(16*1024*1024)
+      , m_maxFileSize(1024*1024)
+      , m_usedSize(0)
+    { }
+
+    static PHTTPCompressedFileCache & GetInstance()
+    {
+      static PHTTPCompressedFileCache cache;
+      return cache;
+    }
+
+    void SetSize(PINDEX totalSize, PINDEX maxFileSize)
+    {
+      PWaitAndSignal lock(m_mutex);
+      m_totalSize = totalSize;
+      m_maxFileSize = maxFileSize;
+      Trim(0);
+    }
+
+    bool Load(PFile & file, PZLib::Format format, PBYTEArray & data)
+    {
+      PFileInfo info;
+      if (!file.GetInfo(info))
+        return false;
+
+      PString key = PZLib::GetContentEncoding(format) + ':' + file.GetFilePath();
+      {
+        PWaitAndSignal lock(m_mutex);
+        if (info.size > (PUInt64)m_maxFileSize || info.size > (PUInt64)m_totalSize)
+          return false;
+
+        EntryMap::iterator it = m_entries.find(key);
+        if (it != m_entries.end() && it->second.m_modified == info.modified && it->second.m_size == info.size) {
+          data = it->second.m_data;
+          return true;
+        }
+      }
+
+      // Compress outside the lock, if two threads do this at once, no harm done
+      PBYTEArray contents;
+      if (!file.SetPosition(0) || !file.Read(contents.GetPointer((PINDEX)info.size), (PINDEX)info.size) ||
+          file.GetLastReadCount() != (PINDEX)info.size)
+        return false;
+      if (!PZLib::Compress(contents, contents.GetSize(), data, format, PZLib::BestLevel))
+        return false;
+
+      PTRACE(4, "HTTPServer", "Caching " << key << ", " << info.size << " bytes compressed to " << data.GetSize());
+
+      PWaitAndSignal lock(m_mutex);
+      Remove(key);
+      Trim(data.GetSize());
+      Entry & entry = m_entries[key];
+      entry.m_modified = info.modified;
+      entry.m_size = info.size;
+      entry.m_data = data;
+      m_order.push_back(key);
+      m_usedSize += data.GetSize();
+      return true;
+    }
+
+  protected:
+    void Remove(const PString & key)
+    {
+      EntryMap::iterator it = m_entries.find(key);
+      if (it != m_entries.end()) {
+        m_usedSize -= it->second.m_data.GetSize();
+        m_entries.erase(it);
+        m_order.remove(key);
+      }
+    }
+
+    void Trim(PINDEX needed)
+    {
+      while (!m_order.empty() && m_usedSize + needed > m_totalSize) {
+        PString oldest = m_order.front();
+        Remove(oldest);
+      }
+    }
+
+    struct Entry
+    {
+      PTime      m_modified;
+      PUInt64    m_size;
+      PBYTEArray m_data;
+    };
+    typedef std::map<PString, Entry> EntryMap;
+
+    PDECLARE_MUTEX(m_mutex);
+    PINDEX             m_totalSize;
+    PINDEX             m_maxFileSize;
+    PINDEX             m_usedSize;
+    EntryMap           m_entries;
+    std::list<PString> m_order;  // Oldest first
+};
+
+
+
+bool PHTTPFile::LoadCompressedData(PHTTPRequest & request, const PString & contentEncoding, PBYTEArray & data)
+{
+  PFile & file = ((PHTTPFileRequest&)request).m_file;
+  PZLib::Format format;
+  return file.IsOpen() &&
+         PZLib::FromContentEncoding(contentEncoding, format) &&
+         PHTTPCompressedFileCache::GetInstance().Load(file, format, data);
+}
+
+
+void PHTTPFile::SetCompressedCacheSize(PINDEX totalSize, PINDEX maxFileSize)
+{
+  PHTTPCompressedFileCache::GetInstance().SetSize(totalSize, maxFileSize);
+}
+
+#else // P_ZLIB
+
+bool PHTTPFile::LoadCompressedData(PHTTPRequest &, const PString &, PBYTEArray &)
+{
+  return false;
+}
+
+
+void PHTTPFile::SetCompressedCacheSize(PINDEX, PINDEX)
+{
+}
+
+#endif // P_ZLIB
+
+
 //////////////////////////////////////////////////////////////////////////////
 // PHTTPTailFile
 
@@ -2349,7 +3396,7 @@ PBoolean PHTTPTailFile::LoadData(PHTTPRequest & request, PCharArray & data)
     file.SetPosition(file.GetLength()-request.url.GetQueryVars()("offset", "10000").AsUnsigned());
 
   while (file.GetPosition() >= file.GetLength()) {
-    if (!request.server.Write(NULL, 0))
+    if (!request.server.Write((const void *)NULL, 0))
       return false;
     PThread::Sleep(200);
   }
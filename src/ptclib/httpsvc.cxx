@@ -187,6 +187,12 @@ PHTTPServiceProcess::Params::Params(const char * configPageName, const char * se
   , m_fullLogPage(NULL)
   , m_clearLogPage(NULL)
   , m_tailLogPage(NULL)
+#if P_PROFILING
+  , m_profilingPageName("Profiling")
+#else
+  , m_profilingPageName(NULL)
+#endif
+  , m_profilingPage(NULL)
   , m_httpPortKey("HTTP Port")
   , m_httpInterfacesKey("HTTP Interfaces")
   , m_httpPort(0)
@@ -316,6 +322,11 @@ bool PHTTPServiceProcess::InitialiseBase(Params & params)
     }
   }
 
+  if (params.m_profilingPageName != NULL) {
+    params.m_profilingPage = new ProfilingPage(*this, params.m_profilingPageName, params.m_authority);
+    m_httpNameSpace.AddResource(params.m_profilingPage, PHTTPSpace::Overwrite);
+  }
+
   return true;
 }
 
@@ -391,6 +402,118 @@ PBoolean PHTTPServiceProcess::ClearLogPage::Post(PHTTPRequest & request, const P
 }
 
 
+PHTTPServiceProcess::ProfilingPage::ProfilingPage(PHTTPServiceProcess & process, const PURL & url, const PHTTPAuthority & auth)
+  : PServiceHTTPString(url, auth)
+  , m_process(process)
+{
+}
+
+
+static PConstString const StartCaptureStr("Start Capture");
+static PConstString const StopCaptureStr("Stop Capture");
+
+PBoolean PHTTPServiceProcess::ProfilingPage::LoadData(PHTTPRequest & request, PCharArray & data)
+{
+#if P_PROFILING
+  PCaselessString format = request.url.GetQueryVars()("format");
+  if (!format.IsEmpty()) {
+    std::ostringstream strm;
+    if (PProfiling::IsEnabled()) {
+      // Threads are still writing their buffers, so the events would be inconsistent
+      request.code = PHTTP::Conflict;
+      strm << "Stop the capture before exporting it\n";
+      request.outMIME.SetAt(PHTTP::ContentTypeTag(), PMIMEInfo::TextPlain());
+    }
+    else if (format == "json") {
+      PProfiling::ExportTrace(strm, PProfiling::ChromeTraceJSON);
+      request.outMIME.SetAt(PHTTP::ContentTypeTag(), "application/json");
+    }
+    else if (format == "perfetto") {
+      PProfiling::ExportTrace(strm, PProfiling::PerfettoProtobuf);
+      request.outMIME.SetAt(PHTTP::ContentTypeTag(), "application/octet-stream");
+      request.outMIME.SetAt(PMIMEInfo::ContentDispositionTag(), "attachment; filename=\"" + m_process.GetName() + ".pftrace\"");
+    }
+    else {
+      PProfiling::Analyse(strm, false);
+      request.outMIME.SetAt(PHTTP::ContentTypeTag(), PMIMEInfo::TextPlain());
+    }
+
+    std::string trace = strm.str();
+    if (data.SetSize(trace.length()))
+      memcpy(data.GetPointer(), trace.data(), trace.length());
+    return false;
+  }
+#endif // P_PROFILING
+
+  return PServiceHTTPString::LoadData(request, data);
+}
+
+
+PString PHTTPServiceProcess::ProfilingPage::LoadText(PHTTPRequest & request)
+{
+  PHTML html;
+  html << PHTML::Title(m_process.GetName() & "Profiling")
+       << PHTML::Body()
+       << m_process.GetPageGraphic()
+       << PHTML::Paragraph() << "<center>";
+
+#if P_PROFILING
+  uint64_t held, overflowed;
+  PProfiling::GetEventCounts(held, overflowed);
+  html << (PProfiling::IsEnabled() ? "Capturing" : "Not capturing")
+       << ", " << held << " events held, " << overflowed << " lost to overflow"
+       << PHTML::Form("POST")
+       << PHTML::Paragraph() << "<center>"
+       << PHTML::SubmitButton(PProfiling::IsEnabled() ? StopCaptureStr : StartCaptureStr)
+       << PHTML::Form()
+       << PHTML::Paragraph() << "<center>"
+       << PHTML::HotLink("?format=json") << "Chrome trace" << PHTML::HotLink() << " | "
+       << PHTML::HotLink("?format=perfetto") << "Perfetto trace" << PHTML::HotLink() << " | "
+       << PHTML::HotLink("?format=text") << "Summary" << PHTML::HotLink();
+#else
+  html << "Profiling not available in this build";
+#endif // P_PROFILING
+
+  html << PHTML::HRule()
+       << m_process.GetCopyrightText()
+       << PHTML::Body();
+
+  m_string = html;
+
+  return PServiceHTTPString::LoadText(request);
+}
+
+
+PBoolean PHTTPServiceProcess::ProfilingPage::Post(PHTTPRequest & request, const PStringToString & data, PHTML & msg)
+{
+  msg << PHTML::Title() << "Profiling" << PHTML::Body()
+      << PHTML::Heading(1) << "Profiling" << PHTML::Heading(1);
+
+#if P_PROFILING
+  if (data("submit") == StartCaptureStr) {
+    PProfiling::Reset();
+    PProfiling::Enable(true);
+    msg << "Started capture";
+  }
+  else if (data("submit") == StopCaptureStr) {
+    PProfiling::Enable(false);
+    msg << "Stopped capture";
+  }
+#else
+  msg << "Profiling not available in this build";
+#endif // P_PROFILING
+
+  msg << PHTML::Paragraph()
+      << PHTML::HotLink(request.url.AsString(PURL::PathOnly)) << "Profiling" << PHTML::HotLink()
+      << PHTML::Paragraph()
+      << PHTML::HotLink("/") << "Home page" << PHTML::HotLink();
+
+  PServiceHTML::ProcessMacros(request, msg, "html/status.html",
+                              PServiceHTML::LoadFromFile | PServiceHTML::NoSignatureForFile);
+  return true;
+}
+
+
 void PHTTPServiceProcess::BeginRestartSystem()
 {
   if (m_restartThread.exchange(PThread::Current()) == NULL)
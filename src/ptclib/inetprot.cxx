@@ -177,6 +177,44 @@ PBoolean PInternetProtocol::Write(const void * buf, PINDEX len)
 }
 
 
+bool PInternetProtocol::Read(Slice * slices, size_t sliceCount)
+{
+  PINDEX total = 0;
+  size_t slice = 0;
+  PINDEX offset = 0;
+  while (unReadCount > 0 && slice < sliceCount) {
+    char * ptr = (char *)slices[slice].GetBase();
+    PINDEX len = slices[slice].GetLength();
+    const char * unReadPtr = ((const char *)unReadBuffer)+unReadCount;
+    while (unReadCount > 0 && offset < len) {
+      ptr[offset++] = *--unReadPtr;
+      unReadCount--;
+      total++;
+    }
+    if (offset >= len) {
+      ++slice;
+      offset = 0;
+    }
+  }
+
+  // Only wait for more if nothing was put back
+  if (total == 0)
+    return ReadSlicesDirect(slices, sliceCount);
+
+  SetLastReadCount(total);
+  return true;
+}
+
+
+bool PInternetProtocol::Write(const Slice * slices, size_t sliceCount)
+{
+  if (stuffingState == DontStuff)
+    return WriteSlicesDirect(slices, sliceCount);
+
+  return PIndirectChannel::Write(slices, sliceCount);
+}
+
+
 PBoolean PInternetProtocol::AttachSocket(PIPSocket * socket)
 {
   if (socket->IsOpen()) {
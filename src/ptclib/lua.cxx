@@ -50,6 +50,10 @@ extern "C" {
   #define lua_objlen lua_rawlen
 #endif
 
+#if LUA_VERSION_NUM <= 501 && !defined(lua_pushglobaltable)
+  #define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+#endif
+
 #define PTraceModule() "Lua"
 
 static PConstString const LuaName("Lua");
@@ -86,10 +90,41 @@ static int TraceFunction(lua_State * lua)
 }
 #endif
 
+
+/* Compiled scripts, shared by all instances, so each new interpreter, e.g.
+   one per call, does not parse the same script again. */
+struct PLuaBytecodeCache
+{
+  PLuaBytecodeCache() : m_maxSize(100) { }
+
+  PDECLARE_MUTEX(m_mutex);
+  PINDEX m_maxSize;
+  typedef std::map<PString, PBYTEArray> Chunks;
+  Chunks m_chunks;
+  std::list<PString> m_order; // Oldest first, for discarding
+};
+
+static PLuaBytecodeCache & GetBytecodeCache()
+{
+  static PLuaBytecodeCache cache;
+  return cache;
+}
+
+
+static int BytecodeWriter(lua_State *, const void * data, size_t size, void * user)
+{
+  PBYTEArray & bytecode = *static_cast<PBYTEArray *>(user);
+  PINDEX length = bytecode.GetSize();
+  memcpy(bytecode.GetPointer(length + size) + length, data, size);
+  return 0;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 PLua::PLua()
   : m_lua(luaL_newstate())
+  , m_compiledGeneration(0)
 {
   luaL_openlibs(m_lua);
 
@@ -128,7 +163,7 @@ bool PLua::LoadFile(const PFilePath & filename)
 {
   PWaitAndSignal mutex(m_mutex);
 
-  int err = luaL_loadfile(m_lua, filename);
+  int err = InternalLoad(filename, true);
   m_loaded = err == 0;
   if (m_loaded)
     return true;
@@ -144,18 +179,91 @@ bool PLua::LoadText(const PString & text)
 {
   PWaitAndSignal mutex(m_mutex);
 
-  m_loaded = OnLuaError(luaL_loadstring(m_lua, text));
+  m_loaded = OnLuaError(InternalLoad(text, false));
   return m_loaded;
 }
 
 
+void PLua::SetBytecodeCacheSize(PINDEX entries)
+{
+  PLuaBytecodeCache & cache = GetBytecodeCache();
+  PWaitAndSignal lock(cache.m_mutex);
+
+  cache.m_maxSize = entries;
+  while (cache.m_order.size() > (size_t)entries) {
+    cache.m_chunks.erase(cache.m_order.front());
+    cache.m_order.pop_front();
+  }
+}
+
+
+int PLua::InternalLoad(const PString & source, bool isFile)
+{
+  PLuaBytecodeCache & cache = GetBytecodeCache();
+
+  // A file is only the same script while it is unchanged
+  PString key;
+  if (!isFile)
+    key = 'T' + source;
+  else {
+    PFileInfo info;
+    if (PFile::GetInfo(source, info))
+      key = PSTRSTRM('F' << source << '\n' << info.modified.GetTimestamp() << '\n' << info.size);
+  }
+
+  PBYTEArray bytecode;
+  if (!key.IsEmpty()) {
+    PWaitAndSignal lock(cache.m_mutex);
+    PLuaBytecodeCache::Chunks::iterator it = cache.m_chunks.find(key);
+    if (it != cache.m_chunks.end())
+      bytecode = it->second;
+  }
+
+  PString chunkName = isFile ? '@' + source : source;
+  if (!bytecode.IsEmpty())
+    return luaL_loadbuffer(m_lua, (const char *)(const BYTE *)bytecode, bytecode.GetSize(), chunkName);
+
+  int err = isFile ? luaL_loadfile(m_lua, source) : luaL_loadstring(m_lua, source);
+  if (err != 0 || key.IsEmpty())
+    return err;
+
+  // Compiled function is on top of the stack, and stays there for Run()
+#if LUA_VERSION_NUM >= 503
+  int dumpErr = lua_dump(m_lua, BytecodeWriter, &bytecode, 0);
+#else
+  int dumpErr = lua_dump(m_lua, BytecodeWriter, &bytecode);
+#endif
+  if (dumpErr != 0 || bytecode.IsEmpty())
+    return 0;
+
+  PWaitAndSignal lock(cache.m_mutex);
+  if (cache.m_maxSize == 0 || cache.m_chunks.find(key) != cache.m_chunks.end())
+    return 0;
+
+  while (cache.m_order.size() >= (size_t)cache.m_maxSize) {
+    cache.m_chunks.erase(cache.m_order.front());
+    cache.m_order.pop_front();
+  }
+
+  cache.m_chunks[key] = bytecode;
+  cache.m_order.push_back(key);
+  PTRACE(4, "Cached " << bytecode.GetSize() << " bytes of bytecode for " << (isFile ? source : PString("script text")));
+  return 0;
+}
+
+
 bool PLua::Run(const char * script)
 {
   if (script != NULL && !LoadText(script))
     return false;
 
-  if (IsLoaded())
-    return OnLuaError(lua_pcall(m_lua, 0, 0, 0));
+  if (IsLoaded()) {
+    PWaitAndSignal mutex(m_mutex);
+    int result = lua_pcall(m_lua, 0, 0, 0);
+    // The script may replace any table, so find them again on next use
+    InternalInvalidateCompiled();
+    return OnLuaError(result);
+  }
 
   return OnLuaError(LUA_ERRRUN, "Script not loaded");
 }
@@ -189,6 +297,7 @@ bool PLua::CreateTable(const PString & name, const PString & metatable)
     lua_setmetatable(m_lua, -2);
   }
 
+  InternalInvalidateCompiled();
   return InternalSetVariable(name);
 }
 
@@ -214,6 +323,7 @@ bool PLua::DeleteTable(const PString & name, bool metaTable)
 
     case LUA_TTABLE :
       InternalRemoveFunction(name);
+      InternalInvalidateCompiled();
       lua_pushnil(m_lua);
       return InternalSetVariable(name);
 
@@ -282,10 +392,59 @@ PScriptLanguage::VarTypes PLua::GetVarType(const PString & name)
 bool PLua::GetVar(const PString & name, PVarType & var)
 {
   PWaitAndSignal mutex(m_mutex);
+  return InternalGetVariable(name) && InternalPopVar(var);
+}
 
-  if (!InternalGetVariable(name))
-    return false;
 
+bool PLua::SetVar(const PString & name, const PVarType & var)
+{
+  PWaitAndSignal mutex(m_mutex);
+  return InternalPushVar(var) && InternalSetVariable(name);
+}
+
+
+PScriptLanguage::Handle PLua::CompileName(const PString & name)
+{
+  PWaitAndSignal mutex(m_mutex);
+
+  std::vector<PString>::iterator it = std::find(m_compiledNames.begin(), m_compiledNames.end(), name);
+  if (it != m_compiledNames.end())
+    return Handle(it - m_compiledNames.begin());
+
+  PStringArray elements;
+  if (!ParseVariableName(name, elements))
+    return Handle();
+
+  Handle handle = PScriptLanguage::CompileName(name);
+
+  CompiledName compiled;
+  lua_pushstring(m_lua, elements[elements.GetSize()-1]);
+  compiled.m_keyRef = luaL_ref(m_lua, LUA_REGISTRYINDEX);
+  compiled.m_tableRef = LUA_NOREF;
+  compiled.m_generation = m_compiledGeneration;
+  elements.SetSize(elements.GetSize()-1);
+  compiled.m_tables = elements;
+  m_compiled.push_back(compiled);
+  return handle;
+}
+
+
+bool PLua::GetVar(const Handle & handle, PVarType & var)
+{
+  PWaitAndSignal mutex(m_mutex);
+  return InternalGetVariable(handle) && InternalPopVar(var);
+}
+
+
+bool PLua::SetVar(const Handle & handle, const PVarType & var)
+{
+  PWaitAndSignal mutex(m_mutex);
+  return InternalPushVar(var) && InternalSetVariable(handle);
+}
+
+
+bool PLua::InternalPopVar(PVarType & var)
+{
   bool result = true;
   switch (lua_type(m_lua, -1)) {
     case LUA_TNONE:
@@ -320,10 +479,8 @@ bool PLua::GetVar(const PString & name, PVarType & var)
 }
 
 
-bool PLua::SetVar(const PString & name, const PVarType & var)
+bool PLua::InternalPushVar(const PVarType & var)
 {
-  PWaitAndSignal mutex(m_mutex);
-
   switch (var.GetType()) {
     case PVarType::VarNULL:
       lua_pushnil(m_lua);
@@ -364,7 +521,7 @@ bool PLua::SetVar(const PString & name, const PVarType & var)
     default:
       return false;
   }
-  return InternalSetVariable(name);
+  return true;
 }
 
 
@@ -544,7 +701,9 @@ bool PLua::Call(const PString & name, const char * signature, ...)
     }
   }
 
-  if (!OnLuaError(lua_pcall(m_lua, nargs, nresults, 0)))
+  int error = lua_pcall(m_lua, nargs, nresults, 0);
+  InternalInvalidateCompiled(); // The function may replace any table
+  if (!OnLuaError(error))
     return false;
 
   if (resultSignature != NULL) {
@@ -589,16 +748,27 @@ bool PLua::Call(const PString & name, const char * signature, ...)
 bool PLua::Call(const PString & name, Signature & signature)
 {
   PWaitAndSignal mutex(m_mutex);
+  return InternalGetVariable(name) && InternalCall(name, signature);
+}
+
+
+bool PLua::Call(const Handle & handle, Signature & signature)
+{
+  PWaitAndSignal mutex(m_mutex);
+  return InternalGetVariable(handle) && InternalCall(m_compiledNames[handle.GetIndex()], signature);
+}
 
-  if (!InternalGetVariable(name))
-    return false;
 
+bool PLua::InternalCall(const PString & name, Signature & signature)
+{
   if (!lua_isfunction(m_lua, -1))
     return OnLuaError(LUA_ERRRUN, PSTRSTRM("No such function as \"" << name << '"'), 1);
 
   signature.m_arguments.Push(m_lua);
 
-  if (!OnLuaError(lua_pcall(m_lua, signature.m_arguments.size(), LUA_MULTRET, 0)))
+  int error = lua_pcall(m_lua, signature.m_arguments.size(), LUA_MULTRET, 0);
+  InternalInvalidateCompiled(); // The function may replace any table
+  if (!OnLuaError(error))
     return false;
 
   signature.m_results.Pop(m_lua);
@@ -620,6 +790,9 @@ int PLua::InternalCallback()
   if (func == NULL || func->IsNULL())
     return 0;
 
+  // Lua code has been running, so compiled names must be found again
+  InternalInvalidateCompiled();
+
   PLua::Signature signature;
 
   signature.m_arguments.Pop(m_lua);
@@ -795,6 +968,64 @@ bool PLua::InternalSetVariable(const PString & name)
 }
 
 
+bool PLua::InternalPushCompiled(const Handle & handle)
+{
+  if (handle.GetIndex() >= m_compiled.size())
+    return OnLuaError(LUA_ERRSYNTAX, "Invalid variable handle");
+
+  CompiledName & compiled = m_compiled[handle.GetIndex()];
+
+  // Any Lua code run since the table was found may have replaced it
+  if (compiled.m_tableRef != LUA_NOREF && compiled.m_generation != m_compiledGeneration) {
+    luaL_unref(m_lua, LUA_REGISTRYINDEX, compiled.m_tableRef);
+    compiled.m_tableRef = LUA_NOREF;
+  }
+
+  if (compiled.m_tableRef == LUA_NOREF) {
+    lua_pushglobaltable(m_lua);
+    for (PINDEX i = 0; i < compiled.m_tables.GetSize(); ++i) {
+      lua_getfield(m_lua, -1, compiled.m_tables[i]);
+      lua_remove(m_lua, -2); // Remove the table from underneath
+
+      int type = lua_type(m_lua, -1);
+      if (type != LUA_TTABLE)
+        return OnLuaError(LUA_ERRSYNTAX, PSTRSTRM("No such table as \"" << compiled.m_tables[i] << "\", is " << lua_typename(m_lua, type)), 1);
+    }
+    compiled.m_tableRef = luaL_ref(m_lua, LUA_REGISTRYINDEX);
+    compiled.m_generation = m_compiledGeneration;
+  }
+
+  lua_rawgeti(m_lua, LUA_REGISTRYINDEX, compiled.m_tableRef);
+  lua_rawgeti(m_lua, LUA_REGISTRYINDEX, compiled.m_keyRef);
+  return true;
+}
+
+
+bool PLua::InternalGetVariable(const Handle & handle)
+{
+  if (!InternalPushCompiled(handle))
+    return false;
+
+  lua_gettable(m_lua, -2);  // Replaces key with value
+  lua_remove(m_lua, -2);    // Remove the table from underneath
+  return true;
+}
+
+
+bool PLua::InternalSetVariable(const Handle & handle)
+{
+  if (!InternalPushCompiled(handle)) {
+    lua_pop(m_lua, 1);
+    return false;
+  }
+
+  lua_pushvalue(m_lua, -3); // Copy value to top, above table and key
+  lua_settable(m_lua, -3);  // Set table key to value
+  lua_pop(m_lua, 2);        // Pop the table and original value
+  return true;
+}
+
+
 void PLua::ParamVector::Push(void * data)
 {
   lua_State * lua = static_cast<lua_State *>(data);
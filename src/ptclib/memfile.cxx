@@ -32,6 +32,10 @@
 
 #include <ptclib/memfile.h>
 
+#ifndef _WIN32
+  #include <sys/mman.h>
+#endif
+
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -157,5 +161,301 @@ off_t PMemoryFile::GetPosition() const
 }
 
 
+
+//////////////////////////////////////////////////////////////////////////////
+
+#define PTraceModule() "MappedFile"
+
+PMappedFile::PMappedFile(Advice advice, bool hugePages)
+  : m_advice(advice)
+  , m_hugePages(hugePages)
+  , m_writable(false)
+  , m_data(NULL)
+  , m_length(0)
+  , m_position(0)
+  , m_mapBase(NULL)
+  , m_mapSize(0)
+#ifdef _WIN32
+  , m_mapHandle(NULL)
+#endif
+{
+}
+
+
+PMappedFile::PMappedFile(const PFilePath & name, OpenMode mode, OpenOptions opts, Advice advice)
+  : m_advice(advice)
+  , m_hugePages(false)
+  , m_writable(false)
+  , m_data(NULL)
+  , m_length(0)
+  , m_position(0)
+  , m_mapBase(NULL)
+  , m_mapSize(0)
+#ifdef _WIN32
+  , m_mapHandle(NULL)
+#endif
+{
+  Open(name, mode, opts);
+}
+
+
+PMappedFile::~PMappedFile()
+{
+  Close();
+}
+
+
+bool PMappedFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions)
+{
+  // Cannot map a file that cannot be read
+  if (mode == WriteOnly) {
+    mode = ReadWrite;
+    if (opts == ModeDefault)
+      opts = Create|Truncate;
+  }
+
+  if (!PFile::InternalOpen(mode, opts, permissions))
+    return false;
+
+  m_writable = mode != ReadOnly;
+  m_position = 0;
+  m_length = PFile::GetLength();
+  if (Map())
+    return true;
+
+  PFile::Close();
+  return false;
+}
+
+
+PBoolean PMappedFile::Close()
+{
+  Unmap();
+  m_length = m_position = 0;
+  return PFile::Close();
+}
+
+
+bool PMappedFile::Map()
+{
+  if (m_length == 0)
+    return true; // Cannot map nothing, but is valid
+
+  if ((PUInt64)m_length > (PUInt64)std::numeric_limits<size_t>::max())
+    return SetErrorValues(Miscellaneous, EFBIG);
+
+#ifdef _WIN32
+  HANDLE file = (HANDLE)_get_osfhandle(os_handle);
+  m_mapHandle = CreateFileMapping(file, NULL, m_writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+  if (m_mapHandle == NULL)
+    return ConvertOSError(-2);
+
+  m_mapBase = MapViewOfFile(m_mapHandle, m_writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+  if (m_mapBase == NULL) {
+    ConvertOSError(-2);
+    CloseHandle(m_mapHandle);
+    m_mapHandle = NULL;
+    return false;
+  }
+  m_mapSize = (size_t)m_length;
+  m_data = (BYTE *)m_mapBase;
+#else
+  m_mapSize = (size_t)m_length;
+  int prot = m_writable ? (PROT_READ|PROT_WRITE) : PROT_READ;
+
+#if defined(MADV_HUGEPAGE)
+  /* Transparent huge pages for files need the mapping on a huge page
+     boundary, so reserve enough address space to find one, then put the
+     file there. */
+  static const size_t HugePageSize = 2*1024*1024;
+  if (m_hugePages && m_mapSize >= HugePageSize) {
+    size_t reserveSize = m_mapSize + HugePageSize;
+    void * reserve = mmap(NULL, reserveSize, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (reserve != MAP_FAILED) {
+      uintptr_t aligned = ((uintptr_t)reserve + HugePageSize - 1) & ~(uintptr_t)(HugePageSize - 1);
+      void * data = mmap((void *)aligned, m_mapSize, prot, MAP_SHARED|MAP_FIXED, os_handle, 0);
+      if (data != MAP_FAILED) {
+        // Release the unused reservation either side
+        if (aligned > (uintptr_t)reserve)
+          munmap(reserve, aligned - (uintptr_t)reserve);
+        size_t tail = (uintptr_t)reserve + reserveSize - (aligned + m_mapSize);
+        if (tail > 0)
+          munmap((void *)(aligned + m_mapSize), tail);
+        m_mapBase = data;
+        madvise(data, m_mapSize, MADV_HUGEPAGE);
+      }
+      else
+        munmap(reserve, reserveSize);
+    }
+    PTRACE_IF(3, m_mapBase == NULL, "Could not align mapping for huge pages: " << GetFilePath());
+  }
+#endif // MADV_HUGEPAGE
+
+  if (m_mapBase == NULL) {
+    void * data = mmap(NULL, m_mapSize, prot, MAP_SHARED, os_handle, 0);
+    if (data == MAP_FAILED)
+      return ConvertOSError(-1);
+    m_mapBase = data;
+  }
+
+  m_data = (BYTE *)m_mapBase;
+#endif // _WIN32
+
+  SetAdvice(m_advice);
+  PTRACE(5, "Mapped " << m_length << " bytes of " << GetFilePath());
+  return true;
+}
+
+
+void PMappedFile::Unmap()
+{
+  if (m_mapBase != NULL) {
+#ifdef _WIN32
+    UnmapViewOfFile(m_mapBase);
+    CloseHandle(m_mapHandle);
+    m_mapHandle = NULL;
+#else
+    munmap(m_mapBase, m_mapSize);
+#endif
+  }
+
+  m_mapBase = NULL;
+  m_mapSize = 0;
+  m_data = NULL;
+}
+
+
+void PMappedFile::SetAdvice(Advice advice, off_t offset, off_t length)
+{
+  m_advice = advice;
+
+#ifndef _WIN32
+  if (m_data == NULL || offset >= m_length)
+    return;
+
+  // madvise wants a page aligned start
+  static const off_t PageSize = sysconf(_SC_PAGESIZE);
+  off_t start = offset - offset%PageSize;
+  if (length == 0 || offset + (off_t)length > m_length)
+    length = m_length - offset;
+  length += offset - start;
+
+  static const int Advices[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+  if (madvise(m_data + start, (size_t)length, Advices[advice]) < 0)
+    PTRACE(3, "madvise failed: " << strerror(errno));
+#endif
+}
+
+
+const BYTE * PMappedFile::GetSpan(off_t offset, PINDEX length) const
+{
+  if (m_data == NULL || offset < 0 || offset + (off_t)length > m_length)
+    return NULL;
+  return m_data + offset;
+}
+
+
+bool PMappedFile::ReadSpan(const BYTE * & data, PINDEX length)
+{
+  SetLastReadCount(0);
+  if (CheckNotOpen())
+    return false;
+
+  off_t available = m_length - m_position;
+  if (available <= 0) {
+    data = NULL;
+    return ConvertOSError(0, LastReadError) && false; // End of file
+  }
+
+  if ((off_t)length > available)
+    length = (PINDEX)available;
+
+  data = m_data + m_position;
+  m_position += length;
+  return ConvertOSError(0, LastReadError) && SetLastReadCount(length) > 0;
+}
+
+
+PBoolean PMappedFile::Read(void * buf, PINDEX len)
+{
+  const BYTE * data;
+  if (!ReadSpan(data, len))
+    return false;
+
+  memcpy(buf, data, GetLastReadCount());
+  return true;
+}
+
+
+PBoolean PMappedFile::Write(const void * buf, PINDEX len)
+{
+  SetLastWriteCount(0);
+  if (CheckNotOpen())
+    return false;
+
+  if (!m_writable)
+    return SetErrorValues(AccessDenied, EACCES, LastWriteError);
+
+  if (m_position + (off_t)len > m_length && !SetLength(m_position + len))
+    return false;
+
+  memcpy(m_data + m_position, buf, len);
+  m_position += len;
+  return ConvertOSError(0, LastWriteError) && SetLastWriteCount(len) >= len;
+}
+
+
+off_t PMappedFile::GetLength() const
+{
+  return m_length;
+}
+
+
+PBoolean PMappedFile::SetLength(off_t len)
+{
+  if (CheckNotOpen())
+    return false;
+
+  if (len == m_length)
+    return true;
+
+  // Windows will not change the size of a mapped file, so always re-map
+  Unmap();
+  bool ok = PFile::SetLength(len);
+  m_length = PFile::GetLength();
+  if (m_position > m_length)
+    m_position = m_length;
+  return Map() && ok;
+}
+
+
+PBoolean PMappedFile::SetPosition(off_t pos, FilePositionOrigin origin)
+{
+  switch (origin) {
+    case Current :
+      pos += m_position;
+      break;
+    case End :
+      pos += m_length;
+      break;
+    default :
+      break;
+  }
+
+  // Like lseek(), past the end is allowed, writing there extends the file
+  if (pos < 0)
+    return SetErrorValues(BadParameter, EINVAL);
+
+  m_position = pos;
+  return true;
+}
+
+
+off_t PMappedFile::GetPosition() const
+{
+  return m_position;
+}
+
+
 // End of File ///////////////////////////////////////////////////////////////
 
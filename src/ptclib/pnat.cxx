@@ -182,7 +182,8 @@ PNatMethod * PNatMethod::Create(const PString & name, PPluginManager * pluginMgr
 
 PString PNatMethod::GetFriendlyName() const
 {
-  PPluginServiceDescriptor * descriptor = PPluginFactory::CreateInstance("PNatMethod" + GetMethodName());
+  // Via the plugin manager, so a plugin deferred by its manifest is found
+  const PPluginServiceDescriptor * descriptor = PPluginManager::GetPluginManager().GetServiceDescriptor(GetMethodName(), PPlugin_PNatMethod::ServiceType());
   return PAssertNULL(descriptor)->GetFriendlyName();
 }
 
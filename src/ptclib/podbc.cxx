@@ -70,7 +70,10 @@ class PODBC::Statement : public PObject, PNonCopyable
     /** Constructor PODBC (Datasources call) or thro' DSNConnection (Connection call). 
     In General this class is constructed within the PODBC::RecordSet Class.
     */
-    Statement(PODBC & odbc);
+    Statement(
+      PODBC & odbc,
+      bool scrollable = true  ///< Scrollable, updatable cursor, else forward only for PODBC::Prepared
+    );
 
     /** Deconstructor. This Class should be available for the duration of which
     a specific query/table is required and be deconstructed at the time of
@@ -97,6 +100,14 @@ class PODBC::Statement : public PObject, PNonCopyable
     */
     bool Execute(const PString & sql);
 
+    /** Prepare the SQL statement for later execution, with parameters bound
+        to the parameter markers.
+      */
+    bool Prepare(const PString & sql) { return SQL_OK(SQLPrepare(m_hStmt, (SQLCHAR *)sql.GetPointer(), sql.GetLength())); }
+
+    /// Close cursor, remove column and parameter bindings, and go back to single rows.
+    void Reset();
+
     // Close cursor, remove all bindings.
     bool CloseCursor() { return SQL_OK(SQLCloseCursor(m_hStmt)); }
     //@}
@@ -169,6 +180,11 @@ class PODBC::Statement : public PObject, PNonCopyable
     PODBC   & m_odbc;
     HSTMT     m_hStmt;
     SQLRETURN m_lastResult;
+
+    // Used when in the prepared statement cache
+    SQLULEN   m_rowsFetched;
+    bool      m_inUse;
+    unsigned  m_lastUsed;
 };
 
 
@@ -189,10 +205,42 @@ struct PODBC::FieldExtra
 };
 
 
+// Values for a column of results, or a parameter, for many rows at once
+struct PODBC::ColumnArray
+{
+  PString             m_name;
+  SQLSMALLINT         m_cType;
+  SQLSMALLINT         m_sqlType;
+  SQLLEN              m_width;
+  PBYTEArray          m_data;
+  std::vector<SQLLEN> m_lenOrInd;
+
+  ColumnArray(const PString & name, SQLSMALLINT cType, SQLSMALLINT sqlType, SQLLEN width, PINDEX rows)
+    : m_name(name)
+    , m_cType(cType)
+    , m_sqlType(sqlType)
+    , m_width(width)
+    , m_data(width*rows)
+    , m_lenOrInd(rows, SQL_NULL_DATA)
+  {
+  }
+
+  BYTE * GetPointer(PINDEX row) { return m_data.GetPointer() + row*m_width; }
+  const BYTE * GetPointer(PINDEX row) const { return (const BYTE *)m_data + row*m_width; }
+
+  void SetValue(PINDEX row, const PVarType & value);
+};
+
+
 struct PODBC::Link
 {
   HENV m_hEnv; // Handle to environment
   HDBC m_hDBC; // Handle to database connection
+
+  // Prepared statements, keyed by SQL text
+  typedef std::map<PString, Statement *> PreparedMap;
+  PreparedMap m_prepared;
+  unsigned    m_preparedSequence;
 };
 
 
@@ -249,8 +297,10 @@ PODBC::PODBC()
   , m_dateTimeFormat(PTime::MediumDateTime)
   , m_needChunking(false)
   , m_maxChunkSize(32768)
+  , m_preparedCacheSize(32)
 {
   m_link->m_hDBC = NULL;
+  m_link->m_preparedSequence = 0;
   if (!SQL_SUCCEEDED(SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &m_link->m_hEnv)))
     m_lastErrorText = "Unable to allocated ODBC environment";
   else
@@ -450,6 +500,11 @@ bool PODBC::IsConnected() const
 
 void PODBC::Disconnect()
 {
+  // Any PODBC::Prepared instances must have been destroyed by now
+  for (Link::PreparedMap::iterator it = m_link->m_prepared.begin(); it != m_link->m_prepared.end(); ++it)
+    delete it->second;
+  m_link->m_prepared.clear();
+
   if (m_link->m_hDBC != NULL) {
     SQLFailed(*this, SQL_HANDLE_DBC, m_link->m_hDBC, SQLDisconnect(m_link->m_hDBC));
     SQLFailed(*this, SQL_HANDLE_DBC, m_link->m_hDBC, SQLFreeHandle(SQL_HANDLE_DBC, m_link->m_hDBC));
@@ -684,6 +739,37 @@ bool PODBC::Execute(const PString & query)
 }
 
 
+bool PODBC::Execute(const PString & sql, const Parameters & params)
+{
+  Prepared stmt(*this, sql);
+  return stmt.Execute(params);
+}
+
+
+bool PODBC::BulkExecute(const PString & sql, const ParameterRows & rows)
+{
+  Prepared stmt(*this, sql);
+  return stmt.Execute(rows);
+}
+
+
+void PODBC::SetPreparedCacheSize(PINDEX size)
+{
+  m_preparedCacheSize = size;
+
+  Link::PreparedMap & cache = m_link->m_prepared;
+  Link::PreparedMap::iterator it = cache.begin();
+  while (cache.size() > (size_t)size && it != cache.end()) {
+    if (it->second->m_inUse)
+      ++it;
+    else {
+      delete it->second;
+      cache.erase(it++);
+    }
+  }
+}
+
+
 void PODBC::SetPrecision(unsigned precision)
 {
   m_precision = precision;
@@ -825,17 +911,28 @@ PString PODBC::GetFieldType(DriverType driver, PVarType::BasicType type, unsigne
 /////////////////////////////////////////////////////////////////////////////
 // PODBC::Statement
 
-PODBC::Statement::Statement(PODBC & odbc)
+PODBC::Statement::Statement(PODBC & odbc, bool scrollable)
   : m_odbc(odbc)
   , m_lastResult(SQL_SUCCESS)
+  , m_rowsFetched(0)
+  , m_inUse(false)
+  , m_lastUsed(0)
 {
   if (SQLFailed(odbc, SQL_HANDLE_DBC, odbc.m_link->m_hDBC, SQLAllocHandle(SQL_HANDLE_STMT, odbc.m_link->m_hDBC, &m_hStmt))) {
     m_hStmt = SQL_NULL_HSTMT;
     return;
   }
 
-  SQLSetStmtAttr(m_hStmt, SQL_ATTR_CONCURRENCY,    (SQLPOINTER) SQL_CONCUR_ROWVER, 0);
-  SQLSetStmtAttr(m_hStmt, SQL_ATTR_CURSOR_TYPE,    (SQLPOINTER)SQL_CURSOR_KEYSET_DRIVEN, 0);
+  if (scrollable) {
+    SQLSetStmtAttr(m_hStmt, SQL_ATTR_CONCURRENCY, (SQLPOINTER) SQL_CONCUR_ROWVER, 0);
+    SQLSetStmtAttr(m_hStmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER)SQL_CURSOR_KEYSET_DRIVEN, 0);
+  }
+  else {
+    // Cheapest cursor there is, for going through a result once in blocks
+    SQLSetStmtAttr(m_hStmt, SQL_ATTR_CONCURRENCY, (SQLPOINTER) SQL_CONCUR_READ_ONLY, 0);
+    SQLSetStmtAttr(m_hStmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER)SQL_CURSOR_FORWARD_ONLY, 0);
+    SQLSetStmtAttr(m_hStmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)SQL_PARAM_BIND_BY_COLUMN, 0);
+  }
   SQLSetStmtAttr(m_hStmt, SQL_ATTR_ROW_BIND_TYPE,  (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
   SQLSetStmtAttr(m_hStmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
   SQLSetStmtAttr(m_hStmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
@@ -865,6 +962,18 @@ bool PODBC::Statement::Execute(const PString & sql)
 }
 
 
+void PODBC::Statement::Reset()
+{
+  // Unlike SQLCloseCursor(), not an error if no cursor open
+  SQLFreeStmt(m_hStmt, SQL_CLOSE);
+  SQLFreeStmt(m_hStmt, SQL_UNBIND);
+  SQLFreeStmt(m_hStmt, SQL_RESET_PARAMS);
+  SQLSetStmtAttr(m_hStmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)1, 0);
+  SQLSetStmtAttr(m_hStmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+  SQLSetStmtAttr(m_hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+}
+
+
 bool PODBC::Statement::Commit(unsigned operation)
 {
   SQLRETURN nRet = operation == SQL_ADD ? SQLBulkOperations(m_hStmt, SQL_ADD)
@@ -1644,4 +1753,600 @@ PODBC::Field & PODBC::RecordSet::operator()(RowIndex row, PINDEX col)
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+// PODBC::ColumnArray
+
+void PODBC::ColumnArray::SetValue(PINDEX row, const PVarType & value)
+{
+  if (value.GetType() == PVarType::VarNULL) {
+    m_lenOrInd[row] = SQL_NULL_DATA;
+    return;
+  }
+
+  BYTE * ptr = GetPointer(row);
+  switch (m_cType) {
+    case SQL_C_BIT :
+      *ptr = value.AsBoolean();
+      m_lenOrInd[row] = 1;
+      break;
+
+    case SQL_C_SBIGINT :
+    {
+      SQLBIGINT integer = value.AsInteger64();
+      memcpy(ptr, &integer, sizeof(integer));
+      m_lenOrInd[row] = sizeof(integer);
+      break;
+    }
+
+    case SQL_C_DOUBLE :
+    {
+      SQLDOUBLE real = value.AsFloat();
+      memcpy(ptr, &real, sizeof(real));
+      m_lenOrInd[row] = sizeof(real);
+      break;
+    }
+
+    case SQL_C_TYPE_TIMESTAMP :
+    {
+      PTime time = value.AsTime();
+      TIMESTAMP_STRUCT timestamp;
+      timestamp.year = time.GetYear();
+      timestamp.month = time.GetMonth();
+      timestamp.day = time.GetDay();
+      timestamp.hour = time.GetHour();
+      timestamp.minute = time.GetMinute();
+      timestamp.second = time.GetSecond();
+      timestamp.fraction = time.GetMicrosecond()*1000;
+      memcpy(ptr, &timestamp, sizeof(timestamp));
+      m_lenOrInd[row] = sizeof(timestamp);
+      break;
+    }
+
+    case SQL_C_BINARY :
+    {
+      PINDEX size = std::min(value.GetSize(), (PINDEX)m_width);
+      memcpy(ptr, value.GetPointer(), size);
+      m_lenOrInd[row] = size;
+      break;
+    }
+
+    default :
+    {
+      PString str = value.AsString();
+      PINDEX len = std::min(str.GetLength(), (PINDEX)m_width-1);
+      memcpy(ptr, (const char *)str, len);
+      ptr[len] = '\0';
+      m_lenOrInd[row] = len;
+    }
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PODBC::RowBlock
+
+PODBC::RowBlock::RowBlock(PINDEX maxRows)
+  : m_maxRows(std::max(maxRows, (PINDEX)1))
+  , m_rowCount(0)
+{
+}
+
+
+PODBC::RowBlock::~RowBlock()
+{
+  for (std::vector<ColumnArray *>::iterator it = m_columns.begin(); it != m_columns.end(); ++it)
+    delete *it;
+}
+
+
+PString PODBC::RowBlock::GetColumnName(PINDEX column) const
+{
+  return PAssert(column > 0 && column <= GetColumnCount(), PInvalidParameter) ? m_columns[column-1]->m_name : PString::Empty();
+}
+
+
+PINDEX PODBC::RowBlock::ColumnByName(const PCaselessString & name) const
+{
+  for (PINDEX i = 0; i < GetColumnCount(); ++i) {
+    if (name == m_columns[i]->m_name)
+      return i+1;
+  }
+  return 0;
+}
+
+
+bool PODBC::RowBlock::IsNULL(PINDEX row, PINDEX column) const
+{
+  if (!PAssert(row < m_rowCount && column > 0 && column <= GetColumnCount(), PInvalidParameter))
+    return true;
+
+  return m_columns[column-1]->m_lenOrInd[row] == SQL_NULL_DATA;
+}
+
+
+int64_t PODBC::RowBlock::AsInteger64(PINDEX row, PINDEX column) const
+{
+  if (IsNULL(row, column))
+    return 0;
+
+  const ColumnArray & array = *m_columns[column-1];
+  switch (array.m_cType) {
+    case SQL_C_SBIGINT :
+    {
+      SQLBIGINT integer;
+      memcpy(&integer, array.GetPointer(row), sizeof(integer));
+      return integer;
+    }
+
+    case SQL_C_DOUBLE :
+      return (int64_t)AsFloat(row, column);
+
+    default :
+      return AsString(row, column).AsInt64();
+  }
+}
+
+
+double PODBC::RowBlock::AsFloat(PINDEX row, PINDEX column) const
+{
+  if (IsNULL(row, column))
+    return 0;
+
+  const ColumnArray & array = *m_columns[column-1];
+  switch (array.m_cType) {
+    case SQL_C_SBIGINT :
+      return (double)AsInteger64(row, column);
+
+    case SQL_C_DOUBLE :
+    {
+      SQLDOUBLE real;
+      memcpy(&real, array.GetPointer(row), sizeof(real));
+      return real;
+    }
+
+    default :
+      return AsString(row, column).AsReal();
+  }
+}
+
+
+PString PODBC::RowBlock::AsString(PINDEX row, PINDEX column) const
+{
+  if (IsNULL(row, column))
+    return PString::Empty();
+
+  const ColumnArray & array = *m_columns[column-1];
+  switch (array.m_cType) {
+    case SQL_C_SBIGINT :
+      return PString(AsInteger64(row, column));
+
+    case SQL_C_DOUBLE :
+      return PSTRSTRM(AsFloat(row, column));
+
+    default :
+      // Length is of the whole value, which may have been truncated
+      SQLLEN len = array.m_lenOrInd[row];
+      if (len == SQL_NO_TOTAL || len >= array.m_width)
+        len = array.m_width - 1;
+      return PString((const char *)array.GetPointer(row), len);
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PODBC::Prepared
+
+PODBC::Prepared::Prepared(PODBC & odbc, const PString & sql)
+  : m_odbc(odbc)
+  , m_statement(NULL)
+  , m_cached(false)
+  , m_boundBlock(NULL)
+{
+  if (odbc.m_link->m_hDBC == NULL)
+    return;
+
+  Link::PreparedMap & cache = odbc.m_link->m_prepared;
+  Link::PreparedMap::iterator it = cache.find(sql);
+  if (it != cache.end() && !it->second->m_inUse) {
+    m_statement = it->second;
+    m_cached = true;
+  }
+  else {
+    m_statement = new Statement(odbc, false);
+    if (!m_statement->IsValid() || !m_statement->Prepare(sql)) {
+      PTRACE(2, "ODBC\tCould not prepare \"" << sql << '"');
+      delete m_statement;
+      m_statement = NULL;
+      return;
+    }
+
+    // If in cache, but being used by someone else, this one is just temporary
+    if (it == cache.end() && odbc.m_preparedCacheSize > 0) {
+      if (cache.size() >= (size_t)odbc.m_preparedCacheSize) {
+        Link::PreparedMap::iterator oldest = cache.end();
+        for (it = cache.begin(); it != cache.end(); ++it) {
+          if (!it->second->m_inUse && (oldest == cache.end() || it->second->m_lastUsed < oldest->second->m_lastUsed))
+            oldest = it;
+        }
+        if (oldest != cache.end()) {
+          delete oldest->second;
+          cache.erase(oldest);
+        }
+      }
+      cache[sql] = m_statement;
+      m_cached = true;
+    }
+  }
+
+  m_statement->m_inUse = true;
+  m_statement->m_lastUsed = ++odbc.m_link->m_preparedSequence;
+}
+
+
+PODBC::Prepared::~Prepared()
+{
+  if (m_statement == NULL)
+    return;
+
+  // Unbind before the parameter buffers go
+  m_statement->Reset();
+
+  for (std::vector<ColumnArray *>::iterator it = m_parameters.begin(); it != m_parameters.end(); ++it)
+    delete *it;
+
+  if (m_cached)
+    m_statement->m_inUse = false;
+  else
+    delete m_statement;
+}
+
+
+bool PODBC::Prepared::IsValid() const
+{
+  return m_statement != NULL;
+}
+
+
+bool PODBC::Prepared::Execute(const Parameters & params)
+{
+  if (m_statement == NULL || !BindParameters(&params, 1))
+    return false;
+
+  // An UPDATE or DELETE that matches nothing is not an error
+  return m_statement->SQL_OK(SQLExecute(m_statement->m_hStmt)) || m_statement->m_lastResult == SQL_NO_DATA;
+}
+
+
+bool PODBC::Prepared::Execute(const ParameterRows & rows)
+{
+  if (m_statement == NULL)
+    return false;
+
+  if (rows.empty())
+    return true;
+
+  PINDEX count = rows.size();
+  if (count > 1 && !SQL_SUCCEEDED(SQLSetStmtAttr(m_statement->m_hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)count, 0))) {
+    // Driver cannot do parameter arrays, so do it the slow way
+    PTRACE(4, "ODBC\tDriver does not support parameter arrays, executing " << count << " times");
+    for (PINDEX row = 0; row < count; ++row) {
+      if (!Execute(rows[row]))
+        return false;
+    }
+    return true;
+  }
+
+  bool ok = BindParameters(&rows[0], count) &&
+            (m_statement->SQL_OK(SQLExecute(m_statement->m_hStmt)) || m_statement->m_lastResult == SQL_NO_DATA);
+
+  SQLSetStmtAttr(m_statement->m_hStmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+  return ok;
+}
+
+
+bool PODBC::Prepared::BindParameters(const Parameters * rows, PINDEX count)
+{
+  m_boundBlock = NULL;
+  SQLFreeStmt(m_statement->m_hStmt, SQL_CLOSE);
+  SQLFreeStmt(m_statement->m_hStmt, SQL_RESET_PARAMS);
+
+  for (std::vector<ColumnArray *>::iterator it = m_parameters.begin(); it != m_parameters.end(); ++it)
+    delete *it;
+  m_parameters.clear();
+
+  PINDEX paramCount = rows[0].size();
+  for (PINDEX param = 0; param < paramCount; ++param) {
+    // Type from the first non-NULL value, width from the biggest
+    PVarType::BasicType type = PVarType::VarNULL;
+    SQLLEN width = 1;
+    for (PINDEX row = 0; row < count; ++row) {
+      if (!PAssert(rows[row].size() == (size_t)paramCount, "Different number of parameters in rows"))
+        return false;
+
+      const PVarType & value = rows[row][param];
+      if (type == PVarType::VarNULL)
+        type = value.GetType();
+
+      switch (value.GetType()) {
+        case PVarType::VarStaticBinary :
+        case PVarType::VarDynamicBinary :
+          width = std::max(width, (SQLLEN)value.GetSize());
+          break;
+        case PVarType::VarStaticString :
+        case PVarType::VarFixedString :
+        case PVarType::VarDynamicString :
+          width = std::max(width, (SQLLEN)value.GetSize()+1);
+          break;
+        case PVarType::VarGUID :
+          width = std::max(width, (SQLLEN)value.AsString().GetLength()+1);
+          break;
+        default :
+          break;
+      }
+    }
+
+    SQLSMALLINT cType, sqlType;
+    switch (type) {
+      case PVarType::VarBoolean :
+        cType = SQL_C_BIT;
+        sqlType = SQL_BIT;
+        width = 1;
+        break;
+
+      case PVarType::VarInt8 :
+      case PVarType::VarInt16 :
+      case PVarType::VarInt32 :
+      case PVarType::VarInt64 :
+      case PVarType::VarUInt8 :
+      case PVarType::VarUInt16 :
+      case PVarType::VarUInt32 :
+      case PVarType::VarUInt64 :
+        cType = SQL_C_SBIGINT;
+        sqlType = SQL_BIGINT;
+        width = sizeof(SQLBIGINT);
+        break;
+
+      case PVarType::VarFloatSingle :
+      case PVarType::VarFloatDouble :
+      case PVarType::VarFloatExtended :
+        cType = SQL_C_DOUBLE;
+        sqlType = SQL_DOUBLE;
+        width = sizeof(SQLDOUBLE);
+        break;
+
+      case PVarType::VarTime :
+        cType = SQL_C_TYPE_TIMESTAMP;
+        sqlType = SQL_TYPE_TIMESTAMP;
+        width = sizeof(TIMESTAMP_STRUCT);
+        break;
+
+      case PVarType::VarStaticBinary :
+      case PVarType::VarDynamicBinary :
+        cType = SQL_C_BINARY;
+        sqlType = SQL_VARBINARY;
+        break;
+
+      default :
+        cType = SQL_C_CHAR;
+        sqlType = SQL_VARCHAR;
+        width = std::max(width, (SQLLEN)2);
+    }
+
+    ColumnArray * array = new ColumnArray(PString::Empty(), cType, sqlType, width, count);
+    m_parameters.push_back(array);
+
+    for (PINDEX row = 0; row < count; ++row)
+      array->SetValue(row, rows[row][param]);
+
+    SQLULEN columnSize = cType == SQL_C_CHAR ? width-1 : width;
+    if (!m_statement->SQL_OK(SQLBindParameter(m_statement->m_hStmt,
+                                              (SQLUSMALLINT)(param+1),
+                                              SQL_PARAM_INPUT,
+                                              cType,
+                                              sqlType,
+                                              columnSize,
+                                              0,
+                                              array->GetPointer(0),
+                                              width,
+                                              &array->m_lenOrInd[0])))
+      return false;
+  }
+
+  return true;
+}
+
+
+bool PODBC::Prepared::Fetch(RowBlock & block)
+{
+  block.m_rowCount = 0;
+
+  if (m_statement == NULL)
+    return false;
+
+  if ((m_boundBlock != &block || block.m_columns.empty()) && !BindColumns(block))
+    return false;
+
+  if (!m_statement->SQL_OK(SQLFetch(m_statement->m_hStmt)))
+    return false;
+
+  block.m_rowCount = (PINDEX)m_statement->m_rowsFetched;
+  return block.m_rowCount > 0;
+}
+
+
+bool PODBC::Prepared::BindColumns(RowBlock & block)
+{
+  SQLFreeStmt(m_statement->m_hStmt, SQL_UNBIND);
+  m_boundBlock = NULL;
+
+  for (std::vector<ColumnArray *>::iterator it = block.m_columns.begin(); it != block.m_columns.end(); ++it)
+    delete *it;
+  block.m_columns.clear();
+
+  SQLSMALLINT numColumns = 0;
+  if (!m_statement->NumResultCols(&numColumns) || numColumns == 0)
+    return false;
+
+  PINDEX chunkSize = m_odbc.GetMaxChunkSize();
+  SQLLEN maxText = chunkSize != P_MAX_INDEX ? (SQLLEN)chunkSize : 4096;
+
+  for (SQLUSMALLINT column = 1; column <= numColumns; ++column) {
+    SQLCHAR nameBuf[256];
+    SQLSMALLINT nameLen = 0, dataType = 0, scale = 0, nullable = 0;
+    SQLULEN columnSize = 0;
+    if (!m_statement->DescribeCol(column, nameBuf, sizeof(nameBuf), &nameLen, &dataType, &columnSize, &scale, &nullable))
+      return false;
+
+    SQLSMALLINT cType;
+    SQLLEN width;
+    switch (dataType) {
+      case SQL_BIT :
+      case SQL_TINYINT :
+      case SQL_SMALLINT :
+      case SQL_INTEGER :
+      case SQL_BIGINT :
+        cType = SQL_C_SBIGINT;
+        width = sizeof(SQLBIGINT);
+        break;
+
+      case SQL_NUMERIC :
+      case SQL_DECIMAL :
+      case SQL_FLOAT :
+      case SQL_REAL :
+      case SQL_DOUBLE :
+        cType = SQL_C_DOUBLE;
+        width = sizeof(SQLDOUBLE);
+        break;
+
+      default :
+        // Everything else as text, long objects are truncated
+        cType = SQL_C_CHAR;
+        width = columnSize > 0 && (SQLLEN)columnSize < maxText ? (SQLLEN)columnSize+1 : maxText;
+        // Allow for dates and numbers converted to text being longer than the "size"
+        width = std::max(width, (SQLLEN)SQL_TIMESTAMP_LEN+8);
+    }
+
+    ColumnArray * array = new ColumnArray(PString((const char *)nameBuf, nameLen), cType, dataType, width, block.m_maxRows);
+    block.m_columns.push_back(array);
+
+    if (!m_statement->BindCol(column, cType, array->GetPointer(0), width, &array->m_lenOrInd[0]))
+      return false;
+  }
+
+  if (!m_statement->SQL_OK(SQLSetStmtAttr(m_statement->m_hStmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)(SQLULEN)block.m_maxRows, 0)) ||
+      !m_statement->SQL_OK(SQLSetStmtAttr(m_statement->m_hStmt, SQL_ATTR_ROWS_FETCHED_PTR, &m_statement->m_rowsFetched, 0)))
+    return false;
+
+  m_boundBlock = &block;
+  return true;
+}
+
+
+PINDEX PODBC::Prepared::GetChangedRowCount()
+{
+  return m_statement != NULL ? (PINDEX)m_statement->GetChangedRowCount() : 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// PODBCPool
+
+PODBCPool::PODBCPool(const PODBC::ConnectData & connectData, unsigned maxConnections, unsigned maxIdle)
+  : m_connectData(connectData)
+  , m_maxIdle(maxIdle)
+  , m_available(maxConnections, maxConnections)
+{
+}
+
+
+PODBCPool::~PODBCPool()
+{
+  for (std::vector<PODBC *>::iterator it = m_idle.begin(); it != m_idle.end(); ++it)
+    delete *it;
+}
+
+
+bool PODBCPool::Preload(unsigned count)
+{
+  for (;;) {
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_idle.size() >= count)
+        return true;
+    }
+
+    PODBC * odbc = CreateConnection();
+    if (odbc == NULL)
+      return false;
+
+    PWaitAndSignal lock(m_mutex);
+    m_idle.push_back(odbc);
+  }
+}
+
+
+PODBC * PODBCPool::Acquire(const PTimeInterval & timeout)
+{
+  if (!m_available.Wait(timeout)) {
+    PTRACE(2, "ODBC\tTimed out waiting for a connection from pool");
+    return NULL;
+  }
+
+  {
+    PWaitAndSignal lock(m_mutex);
+    if (!m_idle.empty()) {
+      PODBC * odbc = m_idle.back();
+      m_idle.pop_back();
+      return odbc;
+    }
+  }
+
+  // Connect outside the lock, so slow servers do not hold up other users
+  PODBC * odbc = CreateConnection();
+  if (odbc == NULL)
+    m_available.Signal();
+  return odbc;
+}
+
+
+void PODBCPool::Release(PODBC * odbc)
+{
+  if (odbc == NULL)
+    return;
+
+  bool keep;
+  {
+    PWaitAndSignal lock(m_mutex);
+    keep = odbc->IsConnected() && m_idle.size() < m_maxIdle;
+    if (keep)
+      m_idle.push_back(odbc);
+  }
+
+  if (!keep)
+    delete odbc;
+  m_available.Signal();
+}
+
+
+PString PODBCPool::GetLastErrorText() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_lastErrorText;
+}
+
+
+PODBC * PODBCPool::CreateConnection()
+{
+  PODBC * odbc = new PODBC;
+  if (odbc->Connect(m_connectData))
+    return odbc;
+
+  PWaitAndSignal lock(m_mutex);
+  m_lastErrorText = odbc->GetLastErrorText();
+  PTRACE(2, "ODBC\tCould not connect pool connection: " << m_lastErrorText);
+  delete odbc;
+  return NULL;
+}
+
+
 #endif // P_ODBC
@@ -2560,6 +2560,55 @@ bool PSSLContext::SetExtension(const char * extension)
 }
 
 
+bool PSSLContext::SetALPN(const PStringArray & protocols)
+{
+  if (PAssertNULL(m_context) == NULL)
+    return false;
+
+  PINDEX length = 0;
+  for (PINDEX i = 0; i < protocols.GetSize(); ++i) {
+    PINDEX len = protocols[i].GetLength();
+    if (len == 0 || len > 255) {
+      PTRACE(2, "Invalid ALPN protocol name \"" << protocols[i] << '"');
+      return false;
+    }
+    length += len + 1;
+  }
+
+  m_alpnProtocols.SetSize(length);
+  BYTE * ptr = m_alpnProtocols.GetPointer();
+  for (PINDEX i = 0; i < protocols.GetSize(); ++i) {
+    *ptr++ = (BYTE)protocols[i].GetLength();
+    memcpy(ptr, (const char *)protocols[i], protocols[i].GetLength());
+    ptr += protocols[i].GetLength();
+  }
+
+  // Client offers the list, server chooses from it
+  if (SSL_CTX_set_alpn_protos(m_context, m_alpnProtocols, length) != 0)
+    return false;
+  SSL_CTX_set_alpn_select_cb(m_context, length > 0 ? ALPNSelectCallback : NULL, this);
+  return true;
+}
+
+
+int PSSLContext::ALPNSelectCallback(ssl_st *,
+                                    const unsigned char ** out,
+                                    unsigned char * outlen,
+                                    const unsigned char * in,
+                                    unsigned inlen,
+                                    void * arg)
+{
+  PSSLContext * context = reinterpret_cast<PSSLContext *>(arg);
+  if (SSL_select_next_proto((unsigned char **)out, outlen,
+                            context->m_alpnProtocols, context->m_alpnProtocols.GetSize(),
+                            in, inlen) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK; // Carry on without ALPN
+
+  PTRACE(4, context, "ALPN selected \"" << PString((const char *)*out, *outlen) << '"');
+  return SSL_TLSEXT_ERR_OK;
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 //
 //  SSLChannel
@@ -3034,6 +3083,18 @@ bool PSSLChannel::SetServerNameIndication(const PString & name)
 }
 
 
+PString PSSLChannel::GetALPN() const
+{
+  if (m_ssl == NULL)
+    return PString::Empty();
+
+  const unsigned char * protocol = NULL;
+  unsigned length = 0;
+  SSL_get0_alpn_selected(m_ssl, &protocol, &length);
+  return length > 0 ? PString((const char *)protocol, length) : PString::Empty();
+}
+
+
 bool PSSLChannel::CheckHostName(const PString & hostname, PSSLCertificate::CheckHostFlags flags)
 {
   if (SSL_get_verify_mode(m_ssl) == 0)
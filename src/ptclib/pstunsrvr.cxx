@@ -14,10 +14,23 @@
 #include <ptlib/pluginmgr.h>
 
 #include <ptclib/pstunsrvr.h>
+#include <ptclib/cypher.h>
+
+#if P_SSL
+  #define OPENSSL_SUPPRESS_DEPRECATED 1
+  #include <openssl/sha.h>
+#endif
+
+#ifdef P_LINUX
+  #include <sys/socket.h>
+  #include <poll.h>
+#endif
 
 #define new PNEW
 #define PTraceModule() "STUNSrvr"
 
+#define RFC5389_MAGIC_COOKIE  0x2112A442
+
 
 //////////////////////////////////////////////////
 
@@ -47,7 +60,14 @@ ostream & operator<<(ostream & strm, const PSTUNServer::SocketInfo & info)
 
 PSTUNServer::PSTUNServer()
   : m_autoDelete(true)
+  , m_workerFastPath(true)
+{
+}
+
+
+PSTUNServer::~PSTUNServer()
 {
+  StopWorkers();
 }
 
 bool PSTUNServer::Open(WORD port)
@@ -199,11 +219,13 @@ PSTUNServer::SocketInfo * PSTUNServer::CreateAndAddSocket(const PIPSocket::Addre
 
 bool PSTUNServer::IsOpen() const 
 { 
-  return m_sockets.GetSize() > 0; 
+  return m_sockets.GetSize() > 0 || !m_workers.empty(); 
 }
 
 bool PSTUNServer::Close()
 {
+  StopWorkers();
+
   m_sockets.AllowDeleteObjects(m_autoDelete);
   m_sockets.SetSize(0);
   m_selectList.SetSize(0);
@@ -452,4 +474,1791 @@ void PSTUNServer::OnBindingResponse(const PSTUNMessage &, PSTUNMessage &)
 }
 
 
+//////////////////////////////////////////////////
+
+class PSTUNServer::Worker : public PObject
+{
+    PCLASSINFO(Worker, PObject);
+  public:
+    enum {
+      BatchSize = 32,
+      MaxPacketSize = 1500,
+      MaxResponseSize = 80  // XOR-MAPPED-ADDRESS, MESSAGE-INTEGRITY and FINGERPRINT
+    };
+
+    Worker(PSTUNServer & server, unsigned index);
+    ~Worker();
+
+    bool Listen(PIPSocketAddressAndPort & binding);
+    void Start();
+    void Stop();
+
+    PUInt64 GetRequestCount() const { return m_requestCount; }
+
+  protected:
+    void Main();
+
+    enum Disposition {
+      Respond,
+      Drop,
+      Fallback
+    };
+    Disposition OnFastBindingRequest(const BYTE * request, PINDEX length,
+                                     const PIPSocket::Address & ip, WORD port,
+                                     BYTE * response, PINDEX & responseLength);
+    void OnFallback(const BYTE * request, PINDEX length, const PIPSocketAddressAndPort & source);
+
+#if P_SSL
+    void CalculateMessageIntegrity(const BYTE * message, const BYTE * mi, BYTE * hmac) const;
+    SHA_CTX m_innerPad;
+    SHA_CTX m_outerPad;
+#endif
+
+    PSTUNServer & m_server;
+    unsigned      m_index;
+    PUDPSocket    m_socket;
+    SocketInfo    m_socketInfo;
+    PThread     * m_thread;
+    atomic<bool>  m_running;
+    atomic<PUInt64> m_requestCount;
+    PString       m_userName;
+    bool          m_hasPassword;
+    bool          m_fastPath;
+
+    // Preallocated so nothing is allocated per request
+    BYTE m_requestBuffers[BatchSize][MaxPacketSize];
+    BYTE m_responseBuffers[BatchSize][MaxResponseSize];
+#ifdef P_LINUX
+    struct mmsghdr   m_rxMessages[BatchSize];
+    struct iovec     m_rxVectors[BatchSize];
+    sockaddr_storage m_rxAddresses[BatchSize];
+    struct mmsghdr   m_txMessages[BatchSize];
+    struct iovec     m_txVectors[BatchSize];
+#endif
+};
+
+
+PSTUNServer::Worker::Worker(PSTUNServer & server, unsigned index)
+  : m_server(server)
+  , m_index(index)
+  , m_thread(NULL)
+  , m_running(false)
+  , m_requestCount(0)
+  , m_userName(server.m_userName)
+  , m_hasPassword(!server.m_password.IsEmpty())
+  , m_fastPath(server.m_workerFastPath)
+{
+#if P_SSL
+  // Precompute the HMAC-SHA1 pads, so each integrity check is just two digests
+  BYTE key[SHA_CBLOCK];
+  memset(key, 0, sizeof(key));
+  if (server.m_password.GetSize() <= (PINDEX)sizeof(key))
+    memcpy(key, server.m_password, server.m_password.GetSize());
+  else
+    SHA1(server.m_password, server.m_password.GetSize(), key);
+
+  BYTE pad[SHA_CBLOCK];
+  for (PINDEX i = 0; i < (PINDEX)sizeof(pad); ++i)
+    pad[i] = key[i] ^ 0x36;
+  SHA1_Init(&m_innerPad);
+  SHA1_Update(&m_innerPad, pad, sizeof(pad));
+
+  for (PINDEX i = 0; i < (PINDEX)sizeof(pad); ++i)
+    pad[i] = key[i] ^ 0x5c;
+  SHA1_Init(&m_outerPad);
+  SHA1_Update(&m_outerPad, pad, sizeof(pad));
+#endif // P_SSL
+
+#ifdef P_LINUX
+  memset(m_rxMessages, 0, sizeof(m_rxMessages));
+  memset(m_txMessages, 0, sizeof(m_txMessages));
+  for (PINDEX i = 0; i < BatchSize; ++i) {
+    m_rxVectors[i].iov_base = m_requestBuffers[i];
+    m_rxVectors[i].iov_len = MaxPacketSize;
+    m_rxMessages[i].msg_hdr.msg_iov = &m_rxVectors[i];
+    m_rxMessages[i].msg_hdr.msg_iovlen = 1;
+    m_rxMessages[i].msg_hdr.msg_name = &m_rxAddresses[i];
+    m_txMessages[i].msg_hdr.msg_iov = &m_txVectors[i];
+    m_txMessages[i].msg_hdr.msg_iovlen = 1;
+  }
+#endif
+}
+
+
+PSTUNServer::Worker::~Worker()
+{
+  Stop();
+}
+
+
+bool PSTUNServer::Worker::Listen(PIPSocketAddressAndPort & binding)
+{
+  if (!m_socket.Listen(binding.GetAddress(), 5, binding.GetPort(), PSocket::CanReusePort)) {
+    PTRACE(2, "Worker " << m_index << " could not listen on " << binding << " - " << m_socket.GetErrorText());
+    return false;
+  }
+
+  // If port was zero, all subsequent workers must share the one we got
+  if (binding.GetPort() == 0)
+    binding.SetPort(m_socket.GetPort());
+
+  m_socketInfo = SocketInfo(&m_socket);
+  return true;
+}
+
+
+void PSTUNServer::Worker::Start()
+{
+  m_running = true;
+  m_thread = new PThreadObj<Worker>(*this, &Worker::Main, false, PSTRSTRM("STUN:" << m_index));
+}
+
+
+void PSTUNServer::Worker::Stop()
+{
+  if (m_thread == NULL)
+    return;
+
+  m_running = false;
+  PThread::WaitAndDelete(m_thread);
+}
+
+
+void PSTUNServer::Worker::Main()
+{
+  PTRACE(3, "Worker " << m_index << " started on " << m_socketInfo);
+
+#ifdef P_LINUX
+  struct pollfd pfd;
+  pfd.fd = m_socket.GetHandle();
+  pfd.events = POLLIN;
+
+  while (m_running) {
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 200) <= 0)
+      continue;
+
+    for (PINDEX i = 0; i < BatchSize; ++i) {
+      m_rxMessages[i].msg_hdr.msg_namelen = sizeof(m_rxAddresses[i]);
+      m_rxMessages[i].msg_hdr.msg_flags = 0;
+    }
+
+    int received = recvmmsg(pfd.fd, m_rxMessages, BatchSize, MSG_DONTWAIT, NULL);
+    if (received <= 0)
+      continue; // Probably ICMP connection refused from a symmetric NAT
+
+    int responses = 0;
+    for (int i = 0; i < received; ++i) {
+      ++m_requestCount;
+
+      const sockaddr * sa = (const sockaddr *)&m_rxAddresses[i];
+      PIPSocket::Address ip;
+      WORD port;
+      switch (sa->sa_family) {
+        case AF_INET :
+          ip = ((const sockaddr_in *)sa)->sin_addr;
+          port = ntohs(((const sockaddr_in *)sa)->sin_port);
+          break;
+#if P_HAS_IPV6
+        case AF_INET6 :
+          ip = ((const sockaddr_in6 *)sa)->sin6_addr;
+          port = ntohs(((const sockaddr_in6 *)sa)->sin6_port);
+          break;
+#endif
+        default :
+          continue;
+      }
+
+      PINDEX length = m_rxMessages[i].msg_len;
+      PINDEX responseLength;
+      switch (OnFastBindingRequest(m_requestBuffers[i], length, ip, port, m_responseBuffers[responses], responseLength)) {
+        case Respond :
+          m_txVectors[responses].iov_base = m_responseBuffers[responses];
+          m_txVectors[responses].iov_len = responseLength;
+          m_txMessages[responses].msg_hdr.msg_name = &m_rxAddresses[i];
+          m_txMessages[responses].msg_hdr.msg_namelen = m_rxMessages[i].msg_hdr.msg_namelen;
+          ++responses;
+          break;
+
+        case Fallback :
+          OnFallback(m_requestBuffers[i], length, PIPSocketAddressAndPort(ip, port));
+          break;
+
+        default :
+          break;
+      }
+    }
+
+    int sent = 0;
+    while (sent < responses) {
+      int count = sendmmsg(pfd.fd, &m_txMessages[sent], responses - sent, 0);
+      if (count <= 0) {
+        PTRACE(2, "Worker " << m_index << " sendmmsg failed: " << strerror(errno));
+        break;
+      }
+      sent += count;
+    }
+  }
+#else
+  m_socket.SetReadTimeout(200);
+
+  while (m_running) {
+    PIPSocket::Address ip;
+    WORD port;
+    if (!m_socket.ReadFrom(m_requestBuffers[0], MaxPacketSize, ip, port))
+      continue;
+
+    ++m_requestCount;
+
+    PINDEX length = m_socket.GetLastReadCount();
+    PINDEX responseLength;
+    switch (OnFastBindingRequest(m_requestBuffers[0], length, ip, port, m_responseBuffers[0], responseLength)) {
+      case Respond :
+        m_socket.WriteTo(m_responseBuffers[0], responseLength, ip, port);
+        break;
+
+      case Fallback :
+        OnFallback(m_requestBuffers[0], length, PIPSocketAddressAndPort(ip, port));
+        break;
+
+      default :
+        break;
+    }
+  }
+#endif
+
+  PTRACE(3, "Worker " << m_index << " stopped after " << m_requestCount << " requests");
+}
+
+
+static __inline WORD GetWord(const BYTE * ptr) { return (WORD)((ptr[0] << 8) | ptr[1]); }
+static __inline void SetWord(BYTE * ptr, WORD value) { ptr[0] = (BYTE)(value >> 8); ptr[1] = (BYTE)value; }
+
+
+PSTUNServer::Worker::Disposition
+PSTUNServer::Worker::OnFastBindingRequest(const BYTE * request, PINDEX length,
+                                          const PIPSocket::Address & ip, WORD port,
+                                          BYTE * response, PINDEX & responseLength)
+{
+  const PINDEX HeaderSize = sizeof(PSTUNMessageHeader);
+  const PINDEX AttrHeaderSize = sizeof(PSTUNAttribute);
+
+  if (length < HeaderSize)
+    return Drop;
+
+  const PSTUNMessageHeader * header = (const PSTUNMessageHeader *)request;
+  if (!m_fastPath ||
+      header->msgType != PSTUNMessage::BindingRequest ||
+      *(const PUInt32b *)header->transactionId != RFC5389_MAGIC_COOKIE ||
+      ip.GetVersion() != 4)
+    return Fallback;
+
+  PINDEX msgLength = header->msgLength;
+  if (HeaderSize + msgLength > length)
+    return Fallback;
+
+  // Scan attributes, anything we don't simply ignore goes the slow way
+  const BYTE * userName = NULL;
+  PINDEX userNameLength = 0;
+  const BYTE * integrity = NULL;
+  const BYTE * fingerprint = NULL;
+
+  const BYTE * attr = request + HeaderSize;
+  const BYTE * end = attr + msgLength;
+  while (attr < end) {
+    if (attr + AttrHeaderSize > end || fingerprint != NULL)
+      return Fallback;
+
+    WORD type = GetWord(attr);
+    PINDEX attrLength = GetWord(attr+2);
+    const BYTE * next = attr + AttrHeaderSize + ((attrLength + 3) & ~3);
+    if (next > end)
+      return Fallback;
+
+    if (integrity != NULL && type != PSTUNAttribute::FINGERPRINT)
+      return Fallback;
+
+    switch (type) {
+      case PSTUNAttribute::USERNAME :
+        userName = attr + AttrHeaderSize;
+        userNameLength = attrLength;
+        break;
+
+      case PSTUNAttribute::MESSAGE_INTEGRITY :
+        if (attrLength != sizeof(PSTUNMessageIntegrity) - AttrHeaderSize)
+          return Fallback;
+        integrity = attr;
+        break;
+
+      case PSTUNAttribute::FINGERPRINT :
+        if (attrLength != sizeof(PSTUNFingerprint) - AttrHeaderSize)
+          return Fallback;
+        fingerprint = attr;
+        break;
+
+      case PSTUNAttribute::ICE_CONTROLLED :
+      case PSTUNAttribute::ICE_CONTROLLING :
+        if (m_server.m_iceRole != NoIceRole)
+          return Fallback;
+        break;
+
+      case PSTUNAttribute::PRIORITY :
+      case PSTUNAttribute::USE_CANDIDATE :
+      case PSTUNAttribute::SOFTWARE :
+      case PSTUNAttribute::ICE_NETWORK_COST :
+        break;
+
+      default :
+        return Fallback;
+    }
+
+    attr = next;
+  }
+
+  // RFC5389/7.3 silently discard if FINGERPRINT is wrong
+  if (fingerprint != NULL &&
+        (PCRC32::Calculate(request, fingerprint - request) ^ 0x5354554e) != *(const PUInt32b *)(fingerprint + AttrHeaderSize))
+    return Drop;
+
+  // Error responses are rare enough to let the slow path produce them
+  if (m_hasPassword) {
+    if (userName == NULL ||
+        userNameLength != m_userName.GetLength() ||
+        memcmp(userName, m_userName.GetPointer(), userNameLength) != 0)
+      return Fallback;
+
+#if P_SSL
+    if (integrity == NULL)
+      return Fallback;
+
+    BYTE hmac[SHA_DIGEST_LENGTH];
+    CalculateMessageIntegrity(request, integrity, hmac);
+    if (memcmp(hmac, integrity + AttrHeaderSize, sizeof(hmac)) != 0)
+      return Fallback;
+#endif
+  }
+
+  // Build response
+  BYTE * ptr = response;
+  SetWord(ptr, PSTUNMessage::BindingResponse);
+  memcpy(ptr + 4, header->transactionId, sizeof(header->transactionId));
+  ptr += HeaderSize;
+
+  SetWord(ptr, PSTUNAttribute::XOR_MAPPED_ADDRESS);
+  SetWord(ptr+2, 8);
+  ptr[4] = 0;
+  ptr[5] = 1; // IPv4
+  SetWord(ptr+6, (WORD)(port ^ (RFC5389_MAGIC_COOKIE >> 16)));
+  for (PINDEX i = 0; i < 4; ++i)
+    ptr[8+i] = (BYTE)(ip[i] ^ (RFC5389_MAGIC_COOKIE >> (24 - 8*i)));
+  ptr += 12;
+
+#if P_SSL
+  if (m_hasPassword) {
+    SetWord(ptr, PSTUNAttribute::MESSAGE_INTEGRITY);
+    SetWord(ptr+2, SHA_DIGEST_LENGTH);
+    CalculateMessageIntegrity(response, ptr, ptr + AttrHeaderSize);
+    ptr += sizeof(PSTUNMessageIntegrity);
+  }
+#endif
+
+  SetWord(ptr, PSTUNAttribute::FINGERPRINT);
+  SetWord(ptr+2, 4);
+  SetWord(response+2, (WORD)(ptr + sizeof(PSTUNFingerprint) - response - HeaderSize));
+  *(PUInt32b *)(ptr + AttrHeaderSize) = PCRC32::Calculate(response, ptr - response) ^ 0x5354554e;
+  ptr += sizeof(PSTUNFingerprint);
+
+  responseLength = ptr - response;
+  return Respond;
+}
+
+
+#if P_SSL
+void PSTUNServer::Worker::CalculateMessageIntegrity(const BYTE * message, const BYTE * mi, BYTE * hmac) const
+{
+  // As for PSTUNMessage::CalculateMessageIntegrity(), but with the length
+  // changed in a copy of the header so the packet stays const.
+  PSTUNMessageHeader header = *(const PSTUNMessageHeader *)message;
+  header.msgLength = (WORD)(mi - message - sizeof(header) + sizeof(PSTUNMessageIntegrity));
+
+  BYTE inner[SHA_DIGEST_LENGTH];
+  SHA_CTX ctx = m_innerPad;
+  SHA1_Update(&ctx, &header, sizeof(header));
+  SHA1_Update(&ctx, message + sizeof(header), mi - message - sizeof(header));
+  SHA1_Final(inner, &ctx);
+
+  ctx = m_outerPad;
+  SHA1_Update(&ctx, inner, sizeof(inner));
+  SHA1_Final(hmac, &ctx);
+}
+#endif // P_SSL
+
+
+void PSTUNServer::Worker::OnFallback(const BYTE * request, PINDEX length, const PIPSocketAddressAndPort & source)
+{
+  PSTUNMessage message(request, length, source);
+  PWaitAndSignal lock(m_server.m_workerMutex);
+  m_server.OnReceiveMessage(message, m_socketInfo);
+}
+
+
+//////////////////////////////////////////////////
+
+bool PSTUNServer::StartWorkers(const PIPSocketAddressAndPort & binding, unsigned count)
+{
+  StopWorkers();
+
+  if (count == 0)
+    count = PThread::GetNumProcessors();
+
+  PIPSocketAddressAndPort actualBinding = binding;
+  for (unsigned i = 0; i < count; ++i) {
+    Worker * worker = new Worker(*this, i);
+    if (!worker->Listen(actualBinding)) {
+      delete worker;
+      break;
+    }
+    m_workers.push_back(worker);
+  }
+
+  if (m_workers.empty())
+    return false;
+
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    m_workers[i]->Start();
+
+  PTRACE(3, "Started " << m_workers.size() << " workers on " << actualBinding);
+  return true;
+}
+
+
+void PSTUNServer::StopWorkers()
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    delete m_workers[i];
+  m_workers.clear();
+}
+
+
+PUInt64 PSTUNServer::GetWorkerRequestCount() const
+{
+  PUInt64 total = 0;
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    total += m_workers[i]->GetRequestCount();
+  return total;
+}
+
+
+//////////////////////////////////////////////////
+
+#if P_TURN
+
+#ifndef _WIN32
+
+#include <ptclib/random.h>
+
+#ifdef P_LINUX
+  #include <sys/epoll.h>
+#else
+  #include <sys/socket.h>
+  #include <poll.h>
+
+  // Emulate the Linux batch calls, one system call per packet
+  struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned      msg_len;
+  };
+
+  static int recvmmsg(int fd, struct mmsghdr * msgs, unsigned count, int flags, void *)
+  {
+    unsigned i;
+    for (i = 0; i < count; ++i) {
+      ssize_t len = recvmsg(fd, &msgs[i].msg_hdr, flags|MSG_DONTWAIT);
+      if (len < 0)
+        break;
+      msgs[i].msg_len = (unsigned)len;
+    }
+    return i > 0 ? (int)i : -1;
+  }
+
+  static int sendmmsg(int fd, struct mmsghdr * msgs, unsigned count, int flags)
+  {
+    unsigned i;
+    for (i = 0; i < count; ++i) {
+      if (sendmsg(fd, &msgs[i].msg_hdr, flags) < 0)
+        break;
+    }
+    return i > 0 ? (int)i : -1;
+  }
+#endif
+
+
+struct PTURNPermission
+{
+  in_addr_t m_address;
+  PInt64    m_expiry;
+};
+
+
+struct PTURNChannel
+{
+  WORD        m_number;
+  sockaddr_in m_peer;
+  PInt64      m_expiry;
+};
+
+
+struct PTURNAllocation
+{
+  PTURNAllocation(const sockaddr_in & client)
+    : m_key(MakeKey(client))
+    , m_client(client)
+    , m_clientAddress(PIPSocket::Address(client.sin_addr), ntohs(client.sin_port))
+    , m_handle(-1)
+    , m_expiry(0)
+    , m_dead(false)
+  {
+    memset(m_transactionId, 0, sizeof(m_transactionId));
+  }
+
+  static PUInt64 MakeKey(const sockaddr_in & addr)
+  {
+    return ((PUInt64)addr.sin_addr.s_addr << 16) | addr.sin_port;
+  }
+
+  bool HasPermission(in_addr_t address, PInt64 now) const
+  {
+    for (size_t i = 0; i < m_permissions.size(); ++i) {
+      if (m_permissions[i].m_address == address)
+        return m_permissions[i].m_expiry > now;
+    }
+    return false;
+  }
+
+  PTURNChannel * FindChannel(WORD number, PInt64 now)
+  {
+    for (size_t i = 0; i < m_channels.size(); ++i) {
+      if (m_channels[i].m_number == number)
+        return m_channels[i].m_expiry > now ? &m_channels[i] : NULL;
+    }
+    return NULL;
+  }
+
+  PTURNChannel * FindChannel(const sockaddr_in & peer, PInt64 now)
+  {
+    for (size_t i = 0; i < m_channels.size(); ++i) {
+      if (m_channels[i].m_peer.sin_addr.s_addr == peer.sin_addr.s_addr && m_channels[i].m_peer.sin_port == peer.sin_port)
+        return m_channels[i].m_expiry > now ? &m_channels[i] : NULL;
+    }
+    return NULL;
+  }
+
+  void AddPermission(in_addr_t address, PInt64 expiry)
+  {
+    for (size_t i = 0; i < m_permissions.size(); ++i) {
+      if (m_permissions[i].m_address == address) {
+        m_permissions[i].m_expiry = expiry;
+        return;
+      }
+    }
+    PTURNPermission permission;
+    permission.m_address = address;
+    permission.m_expiry = expiry;
+    m_permissions.push_back(permission);
+  }
+
+  void Expire(PInt64 now)
+  {
+    for (size_t i = 0; i < m_permissions.size(); ) {
+      if (m_permissions[i].m_expiry > now)
+        ++i;
+      else {
+        m_permissions[i] = m_permissions.back();
+        m_permissions.pop_back();
+      }
+    }
+    for (size_t i = 0; i < m_channels.size(); ) {
+      if (m_channels[i].m_expiry > now)
+        ++i;
+      else {
+        m_channels[i] = m_channels.back();
+        m_channels.pop_back();
+      }
+    }
+  }
+
+  PUInt64                      m_key;
+  sockaddr_in                  m_client;
+  PIPSocketAddressAndPort      m_clientAddress;
+  PUDPSocket                   m_socket;
+  int                          m_handle;
+  PIPSocketAddressAndPort      m_relayedAddress;
+  PString                      m_userName;
+  BYTE                         m_transactionId[16];
+  PInt64                       m_expiry;
+  bool                         m_dead;
+  std::vector<PTURNPermission> m_permissions;
+  std::vector<PTURNChannel>    m_channels;
+};
+
+
+/* Open addressing hash table, keyed on the client address and port, so
+   finding the allocation for a packet is O(1) and allocation free. */
+class PTURNAllocationTable
+{
+  public:
+    PTURNAllocationTable()
+      : m_slots(1024)
+      , m_count(0)
+    {
+    }
+
+    size_t GetSize() const { return m_count; }
+    size_t GetCapacity() const { return m_slots.size(); }
+    PTURNAllocation * GetAt(size_t index) const { return m_slots[index]; }
+
+    PTURNAllocation * Find(PUInt64 key) const
+    {
+      size_t mask = m_slots.size() - 1;
+      for (size_t i = Hash(key) & mask; m_slots[i] != NULL; i = (i + 1) & mask) {
+        if (m_slots[i]->m_key == key)
+          return m_slots[i];
+      }
+      return NULL;
+    }
+
+    void Insert(PTURNAllocation * allocation)
+    {
+      if ((m_count + 1) * 2 > m_slots.size()) {
+        std::vector<PTURNAllocation *> old(m_slots.size() * 2);
+        old.swap(m_slots);
+        for (size_t i = 0; i < old.size(); ++i) {
+          if (old[i] != NULL)
+            InternalInsert(old[i]);
+        }
+      }
+      InternalInsert(allocation);
+      ++m_count;
+    }
+
+    void Remove(PTURNAllocation * allocation)
+    {
+      size_t mask = m_slots.size() - 1;
+      size_t i = Hash(allocation->m_key) & mask;
+      while (m_slots[i] != allocation) {
+        if (m_slots[i] == NULL)
+          return;
+        i = (i + 1) & mask;
+      }
+
+      // Backward shift deletion, so no tombstones are needed
+      size_t hole = i;
+      for (;;) {
+        i = (i + 1) & mask;
+        if (m_slots[i] == NULL)
+          break;
+        size_t home = Hash(m_slots[i]->m_key) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+          m_slots[hole] = m_slots[i];
+          hole = i;
+        }
+      }
+      m_slots[hole] = NULL;
+      --m_count;
+    }
+
+  protected:
+    static size_t Hash(PUInt64 key)
+    {
+      key ^= key >> 33;
+      key *= 0xff51afd7ed558ccdULL;
+      key ^= key >> 33;
+      return (size_t)key;
+    }
+
+    void InternalInsert(PTURNAllocation * allocation)
+    {
+      size_t mask = m_slots.size() - 1;
+      size_t i = Hash(allocation->m_key) & mask;
+      while (m_slots[i] != NULL)
+        i = (i + 1) & mask;
+      m_slots[i] = allocation;
+    }
+
+    std::vector<PTURNAllocation *> m_slots;
+    size_t m_count;
+};
+
+
+class PTURNServer::Relay : public PObject
+{
+    PCLASSINFO(Relay, PObject);
+  public:
+    enum {
+      BatchSize = 64,
+      MaxPacketSize = 2048,
+      Headroom = 36    // Header, XOR-PEER-ADDRESS and DATA of a Data indication
+    };
+
+    Relay(PTURNServer & server, unsigned index, const PIPSocket::Address & relayInterface);
+    ~Relay();
+
+    bool Listen(PIPSocketAddressAndPort & binding);
+    void Start();
+    void Stop();
+
+    atomic<unsigned> m_allocationCount;
+    atomic<PUInt64>  m_toPeers;
+    atomic<PUInt64>  m_toClients;
+    atomic<PUInt64>  m_dropped;
+
+  protected:
+    void Main();
+
+    // Data plane
+    void ReadFromClients();
+    void OnChannelData(const sockaddr_in & from, BYTE * data, PINDEX length);
+    void OnSendIndication(const sockaddr_in & from, BYTE * data, PINDEX length);
+    void QueueToPeer(PTURNAllocation & allocation, const sockaddr_in & peer, BYTE * data, PINDEX length);
+    void FlushToPeers();
+    void ReadFromPeers(PTURNAllocation & allocation);
+    void FlushToClients();
+
+    // Control plane
+    void OnControlMessage(const sockaddr_storage & from, const BYTE * data, PINDEX length);
+    bool Authenticate(const PSTUNMessage & request, PString & userName, PBYTEArray & key);
+    void SendResponse(PSTUNMessage & response, const PSTUNMessage & request, const PBYTEArray & key);
+    void SendError(const PSTUNMessage & request, int code, const char * reason, const PBYTEArray & key, bool challenge = false);
+    PTURNAllocation * FindAllocation(const PSTUNMessage & request, const PString & userName, const PBYTEArray & key);
+    void OnAllocate(const PSTUNMessage & request, const sockaddr_in & from);
+    void OnRefresh(const PSTUNMessage & request);
+    void OnCreatePermission(const PSTUNMessage & request);
+    void OnChannelBind(const PSTUNMessage & request);
+    void Sweep();
+    void Deallocate(PTURNAllocation * allocation);
+
+    // Poller
+    bool AddHandle(int handle, PTURNAllocation * allocation);
+    void RemoveHandle(int handle);
+
+    PTURNServer & m_server;
+    unsigned      m_index;
+    PUDPSocket    m_socket;
+    int           m_handle;
+    SocketInfo    m_socketInfo;
+    PIPSocket::Address m_relayInterface;
+    PThread     * m_thread;
+    atomic<bool>  m_running;
+    PInt64        m_now;
+    PInt64        m_lastSweep;
+
+    PString       m_realm;
+    bool          m_authenticate;
+    PString       m_nonce;
+    PString       m_previousNonce;
+    PInt64        m_nonceTime;
+    DWORD         m_indicationId[3];
+
+    PTURNAllocationTable           m_allocations;
+    std::vector<PTURNAllocation *> m_deadAllocations;
+
+#ifdef P_LINUX
+    int m_epoll;
+    struct epoll_event m_events[BatchSize];
+#else
+    std::vector<struct pollfd>     m_pollHandles;
+    std::vector<PTURNAllocation *> m_pollAllocations;
+#endif
+
+    // Preallocated so nothing is allocated per packet
+    struct Slot {
+      BYTE m_data[Headroom + MaxPacketSize + 4];
+    };
+
+    Slot             m_clientSlots[BatchSize];
+    struct mmsghdr   m_clientRx[BatchSize];
+    struct iovec     m_clientRxVectors[BatchSize];
+    sockaddr_storage m_clientRxAddresses[BatchSize];
+
+    struct mmsghdr   m_peerTx[BatchSize];
+    struct iovec     m_peerTxVectors[BatchSize];
+    sockaddr_in      m_peerTxAddresses[BatchSize];
+    int              m_peerTxHandles[BatchSize];
+    unsigned         m_peerTxCount;
+
+    Slot             m_peerSlots[BatchSize];
+    struct mmsghdr   m_peerRx[BatchSize];
+    struct iovec     m_peerRxVectors[BatchSize];
+    sockaddr_in      m_peerRxAddresses[BatchSize];
+    unsigned         m_peerRxUsed;
+
+    struct mmsghdr   m_clientTx[BatchSize];
+    struct iovec     m_clientTxVectors[BatchSize];
+    unsigned         m_clientTxCount;
+};
+
+
+PTURNServer::Relay::Relay(PTURNServer & server, unsigned index, const PIPSocket::Address & relayInterface)
+  : m_allocationCount(0)
+  , m_toPeers(0)
+  , m_toClients(0)
+  , m_dropped(0)
+  , m_server(server)
+  , m_index(index)
+  , m_handle(-1)
+  , m_relayInterface(relayInterface)
+  , m_thread(NULL)
+  , m_running(false)
+  , m_now(PTimer::Tick().GetMilliSeconds())
+  , m_lastSweep(m_now)
+  , m_realm(server.m_realm)
+  , m_authenticate(!server.m_realm.IsEmpty() || !server.m_password.IsEmpty())
+  , m_nonce(PRandom::String(24))
+  , m_nonceTime(m_now)
+  , m_peerTxCount(0)
+  , m_peerRxUsed(0)
+  , m_clientTxCount(0)
+{
+  PRandom::Octets((BYTE *)m_indicationId, sizeof(m_indicationId));
+
+#ifdef P_LINUX
+  m_epoll = epoll_create1(EPOLL_CLOEXEC);
+#endif
+
+  memset(m_clientRx, 0, sizeof(m_clientRx));
+  memset(m_peerTx, 0, sizeof(m_peerTx));
+  memset(m_peerRx, 0, sizeof(m_peerRx));
+  memset(m_clientTx, 0, sizeof(m_clientTx));
+  for (PINDEX i = 0; i < BatchSize; ++i) {
+    m_clientRxVectors[i].iov_base = m_clientSlots[i].m_data + Headroom;
+    m_clientRxVectors[i].iov_len = MaxPacketSize;
+    m_clientRx[i].msg_hdr.msg_iov = &m_clientRxVectors[i];
+    m_clientRx[i].msg_hdr.msg_iovlen = 1;
+    m_clientRx[i].msg_hdr.msg_name = &m_clientRxAddresses[i];
+
+    m_peerTx[i].msg_hdr.msg_iov = &m_peerTxVectors[i];
+    m_peerTx[i].msg_hdr.msg_iovlen = 1;
+    m_peerTx[i].msg_hdr.msg_name = &m_peerTxAddresses[i];
+    m_peerTx[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+
+    m_peerRxVectors[i].iov_base = m_peerSlots[i].m_data + Headroom;
+    m_peerRxVectors[i].iov_len = MaxPacketSize;
+    m_peerRx[i].msg_hdr.msg_iov = &m_peerRxVectors[i];
+    m_peerRx[i].msg_hdr.msg_iovlen = 1;
+    m_peerRx[i].msg_hdr.msg_name = &m_peerRxAddresses[i];
+
+    m_clientTx[i].msg_hdr.msg_iov = &m_clientTxVectors[i];
+    m_clientTx[i].msg_hdr.msg_iovlen = 1;
+    m_clientTx[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+  }
+}
+
+
+PTURNServer::Relay::~Relay()
+{
+  Stop();
+
+  for (size_t i = 0; i < m_allocations.GetCapacity(); ++i)
+    delete m_allocations.GetAt(i);
+
+#ifdef P_LINUX
+  if (m_epoll >= 0)
+    ::close(m_epoll);
+#endif
+}
+
+
+bool PTURNServer::Relay::Listen(PIPSocketAddressAndPort & binding)
+{
+  if (!m_socket.Listen(binding.GetAddress(), 5, binding.GetPort(), PSocket::CanReusePort)) {
+    PTRACE(2, "Relay " << m_index << " could not listen on " << binding << " - " << m_socket.GetErrorText());
+    return false;
+  }
+
+  if (binding.GetPort() == 0)
+    binding.SetPort(m_socket.GetPort());
+
+  m_handle = m_socket.GetHandle();
+  m_socketInfo = SocketInfo(&m_socket);
+  if (!m_relayInterface.IsValid())
+    m_relayInterface = binding.GetAddress();
+
+  return AddHandle(m_handle, NULL);
+}
+
+
+void PTURNServer::Relay::Start()
+{
+  m_running = true;
+  m_thread = new PThreadObj<Relay>(*this, &Relay::Main, false, PSTRSTRM("TURN:" << m_index));
+}
+
+
+void PTURNServer::Relay::Stop()
+{
+  if (m_thread == NULL)
+    return;
+
+  m_running = false;
+  PThread::WaitAndDelete(m_thread);
+}
+
+
+bool PTURNServer::Relay::AddHandle(int handle, PTURNAllocation * allocation)
+{
+#ifdef P_LINUX
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = allocation;
+  if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, handle, &event) == 0)
+    return true;
+
+  PTRACE(2, "Relay " << m_index << " could not add handle " << handle << " to epoll: " << strerror(errno));
+  return false;
+#else
+  struct pollfd pfd;
+  pfd.fd = handle;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  m_pollHandles.push_back(pfd);
+  m_pollAllocations.push_back(allocation);
+  return true;
+#endif
+}
+
+
+void PTURNServer::Relay::RemoveHandle(int handle)
+{
+#ifdef P_LINUX
+  struct epoll_event event;
+  epoll_ctl(m_epoll, EPOLL_CTL_DEL, handle, &event);
+#else
+  for (size_t i = 0; i < m_pollHandles.size(); ++i) {
+    if (m_pollHandles[i].fd == handle) {
+      m_pollHandles[i] = m_pollHandles.back();
+      m_pollHandles.pop_back();
+      m_pollAllocations[i] = m_pollAllocations.back();
+      m_pollAllocations.pop_back();
+      break;
+    }
+  }
+#endif
+}
+
+
+void PTURNServer::Relay::Main()
+{
+  PTRACE(3, "Relay " << m_index << " started on " << m_socketInfo << ", relaying via " << m_relayInterface);
+
+  while (m_running) {
+#ifdef P_LINUX
+    int count = epoll_wait(m_epoll, m_events, BatchSize, 200);
+    m_now = PTimer::Tick().GetMilliSeconds();
+
+    for (int i = 0; i < count; ++i) {
+      PTURNAllocation * allocation = (PTURNAllocation *)m_events[i].data.ptr;
+      if (allocation == NULL)
+        ReadFromClients();
+      else if (!allocation->m_dead)
+        ReadFromPeers(*allocation);
+    }
+#else
+    int count = ::poll(&m_pollHandles[0], m_pollHandles.size(), 200);
+    m_now = PTimer::Tick().GetMilliSeconds();
+
+    for (size_t i = 0; count > 0 && i < m_pollHandles.size(); ++i) {
+      if (m_pollHandles[i].revents == 0)
+        continue;
+      --count;
+      PTURNAllocation * allocation = m_pollAllocations[i];
+      if (allocation == NULL)
+        ReadFromClients();
+      else if (!allocation->m_dead)
+        ReadFromPeers(*allocation);
+    }
+#endif
+
+    FlushToClients();
+
+    if (m_now - m_lastSweep >= 1000)
+      Sweep();
+
+    // Only delete once nothing in the batches can refer to them
+    for (size_t i = 0; i < m_deadAllocations.size(); ++i)
+      Deallocate(m_deadAllocations[i]);
+    m_deadAllocations.clear();
+  }
+
+  PTRACE(3, "Relay " << m_index << " stopped with " << m_allocations.GetSize() << " allocations,"
+            " relayed " << m_toPeers << " to peers, " << m_toClients << " to clients, dropped " << m_dropped);
+}
+
+
+void PTURNServer::Relay::ReadFromClients()
+{
+  for (PINDEX i = 0; i < BatchSize; ++i) {
+    m_clientRx[i].msg_hdr.msg_namelen = sizeof(m_clientRxAddresses[i]);
+    m_clientRx[i].msg_hdr.msg_flags = 0;
+  }
+
+  int count = recvmmsg(m_handle, m_clientRx, BatchSize, MSG_DONTWAIT, NULL);
+  for (int i = 0; i < count; ++i) {
+    BYTE * data = m_clientSlots[i].m_data + Headroom;
+    PINDEX length = m_clientRx[i].msg_len;
+    const sockaddr_in & from = *(const sockaddr_in *)&m_clientRxAddresses[i];
+
+    if ((m_clientRx[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+      ++m_dropped;
+      continue;
+    }
+
+    if (length >= 4 && (data[0] & 0xc0) == 0x40) {
+      if (from.sin_family == AF_INET)
+        OnChannelData(from, data, length);
+    }
+    else if (length >= (PINDEX)sizeof(PSTUNMessageHeader) &&
+             GetWord(data) == PSTUNMessage::Send &&
+             from.sin_family == AF_INET)
+      OnSendIndication(from, data, length);
+    else
+      OnControlMessage(m_clientRxAddresses[i], data, length);
+  }
+
+  FlushToPeers();
+}
+
+
+void PTURNServer::Relay::OnChannelData(const sockaddr_in & from, BYTE * data, PINDEX length)
+{
+  PINDEX dataLength = GetWord(data+2);
+  PTURNAllocation * allocation = m_allocations.Find(PTURNAllocation::MakeKey(from));
+  PTURNChannel * channel;
+  if (dataLength + 4 > length ||
+      allocation == NULL ||
+      (channel = allocation->FindChannel(GetWord(data), m_now)) == NULL ||
+      !allocation->HasPermission(channel->m_peer.sin_addr.s_addr, m_now)) {
+    ++m_dropped;
+    return;
+  }
+
+  QueueToPeer(*allocation, channel->m_peer, data + 4, dataLength);
+}
+
+
+void PTURNServer::Relay::OnSendIndication(const sockaddr_in & from, BYTE * data, PINDEX length)
+{
+  PTURNAllocation * allocation = m_allocations.Find(PTURNAllocation::MakeKey(from));
+  if (allocation == NULL) {
+    ++m_dropped;
+    return;
+  }
+
+  sockaddr_in peer;
+  peer.sin_family = AF_UNSPEC;
+  BYTE * payload = NULL;
+  PINDEX payloadLength = 0;
+
+  const BYTE * end = data + std::min(length, (PINDEX)(sizeof(PSTUNMessageHeader) + GetWord(data+2)));
+  BYTE * attr = data + sizeof(PSTUNMessageHeader);
+  while (attr + sizeof(PSTUNAttribute) <= end) {
+    WORD attrLength = GetWord(attr+2);
+    BYTE * value = attr + sizeof(PSTUNAttribute);
+    if (value + attrLength > end)
+      break;
+
+    switch (GetWord(attr)) {
+      case PSTUNAttribute::XOR_PEER_ADDRESS :
+        if (attrLength == 8 && value[1] == 1) {
+          memset(&peer, 0, sizeof(peer));
+          peer.sin_family = AF_INET;
+          SetWord((BYTE *)&peer.sin_port, (WORD)(GetWord(value+2) ^ (RFC5389_MAGIC_COOKIE >> 16)));
+          BYTE * ip = (BYTE *)&peer.sin_addr;
+          for (PINDEX i = 0; i < 4; ++i)
+            ip[i] = (BYTE)(value[4+i] ^ (RFC5389_MAGIC_COOKIE >> (24 - 8*i)));
+        }
+        break;
+
+      case PSTUNAttribute::DATA :
+        payload = value;
+        payloadLength = attrLength;
+        break;
+    }
+
+    attr = value + ((attrLength + 3) & ~3);
+  }
+
+  if (peer.sin_family != AF_INET || payload == NULL || !allocation->HasPermission(peer.sin_addr.s_addr, m_now)) {
+    ++m_dropped;
+    return;
+  }
+
+  QueueToPeer(*allocation, peer, payload, payloadLength);
+}
+
+
+void PTURNServer::Relay::QueueToPeer(PTURNAllocation & allocation, const sockaddr_in & peer, BYTE * data, PINDEX length)
+{
+  if (m_peerTxCount >= BatchSize)
+    FlushToPeers();
+
+  m_peerTxVectors[m_peerTxCount].iov_base = data;
+  m_peerTxVectors[m_peerTxCount].iov_len = length;
+  m_peerTxAddresses[m_peerTxCount] = peer;
+  m_peerTxHandles[m_peerTxCount] = allocation.m_handle;
+  ++m_peerTxCount;
+}
+
+
+void PTURNServer::Relay::FlushToPeers()
+{
+  // Each allocation has its own socket, so send runs for the same socket together
+  unsigned start = 0;
+  while (start < m_peerTxCount) {
+    unsigned end = start + 1;
+    while (end < m_peerTxCount && m_peerTxHandles[end] == m_peerTxHandles[start])
+      ++end;
+
+    while (start < end) {
+      int sent = sendmmsg(m_peerTxHandles[start], &m_peerTx[start], end - start, MSG_DONTWAIT);
+      if (sent <= 0) {
+        m_dropped += end - start;
+        break;
+      }
+      m_toPeers += sent;
+      start += sent;
+    }
+    start = end;
+  }
+
+  m_peerTxCount = 0;
+}
+
+
+void PTURNServer::Relay::ReadFromPeers(PTURNAllocation & allocation)
+{
+  if (m_peerRxUsed >= BatchSize)
+    FlushToClients();
+
+  unsigned first = m_peerRxUsed;
+  for (unsigned i = first; i < BatchSize; ++i) {
+    m_peerRx[i].msg_hdr.msg_namelen = sizeof(m_peerRxAddresses[i]);
+    m_peerRx[i].msg_hdr.msg_flags = 0;
+  }
+
+  int count = recvmmsg(allocation.m_handle, &m_peerRx[first], BatchSize - first, MSG_DONTWAIT, NULL);
+  if (count <= 0)
+    return;
+
+  m_peerRxUsed += count;
+
+  for (unsigned i = first; i < m_peerRxUsed; ++i) {
+    // A truncated datagram would be relayed as if it were complete
+    const sockaddr_in & from = m_peerRxAddresses[i];
+    if (from.sin_family != AF_INET ||
+        (m_peerRx[i].msg_hdr.msg_flags & MSG_TRUNC) != 0 ||
+        !allocation.HasPermission(from.sin_addr.s_addr, m_now)) {
+      ++m_dropped;
+      continue;
+    }
+
+    // Frame in place, in the headroom in front of the received data
+    BYTE * payload = m_peerSlots[i].m_data + Headroom;
+    PINDEX length = m_peerRx[i].msg_len;
+    BYTE * frame;
+    PINDEX frameLength;
+
+    PTURNChannel * channel = allocation.FindChannel(from, m_now);
+    if (channel != NULL) {
+      frame = payload - 4;
+      SetWord(frame, channel->m_number);
+      SetWord(frame+2, (WORD)length);
+      frameLength = length + 4;
+    }
+    else {
+      PINDEX padding = (4 - (length & 3)) & 3;
+      memset(payload + length, 0, padding);
+
+      frame = payload - Headroom;
+      SetWord(frame, PSTUNMessage::Data);
+      SetWord(frame+2, (WORD)(Headroom - sizeof(PSTUNMessageHeader) + length + padding));
+      *(PUInt32b *)(frame+4) = RFC5389_MAGIC_COOKIE;
+      ++m_indicationId[2];
+      memcpy(frame+8, m_indicationId, sizeof(m_indicationId));
+
+      BYTE * attr = frame + sizeof(PSTUNMessageHeader);
+      SetWord(attr, PSTUNAttribute::XOR_PEER_ADDRESS);
+      SetWord(attr+2, 8);
+      attr[4] = 0;
+      attr[5] = 1;
+      SetWord(attr+6, (WORD)(ntohs(from.sin_port) ^ (RFC5389_MAGIC_COOKIE >> 16)));
+      const BYTE * ip = (const BYTE *)&from.sin_addr;
+      for (PINDEX b = 0; b < 4; ++b)
+        attr[8+b] = (BYTE)(ip[b] ^ (RFC5389_MAGIC_COOKIE >> (24 - 8*b)));
+
+      attr += 12;
+      SetWord(attr, PSTUNAttribute::DATA);
+      SetWord(attr+2, (WORD)length);
+      frameLength = Headroom + length + padding;
+    }
+
+    m_clientTxVectors[m_clientTxCount].iov_base = frame;
+    m_clientTxVectors[m_clientTxCount].iov_len = frameLength;
+    m_clientTx[m_clientTxCount].msg_hdr.msg_name = &allocation.m_client;
+    ++m_clientTxCount;
+  }
+}
+
+
+void PTURNServer::Relay::FlushToClients()
+{
+  unsigned sent = 0;
+  while (sent < m_clientTxCount) {
+    int count = sendmmsg(m_handle, &m_clientTx[sent], m_clientTxCount - sent, MSG_DONTWAIT);
+    if (count <= 0) {
+      m_dropped += m_clientTxCount - sent;
+      break;
+    }
+    sent += count;
+  }
+
+  m_toClients += sent;
+  m_clientTxCount = 0;
+  m_peerRxUsed = 0;
+}
+
+
+void PTURNServer::Relay::OnControlMessage(const sockaddr_storage & from, const BYTE * data, PINDEX length)
+{
+  PIPSocket::Address ip;
+  WORD port;
+  switch (from.ss_family) {
+    case AF_INET :
+      ip = ((const sockaddr_in &)from).sin_addr;
+      port = ntohs(((const sockaddr_in &)from).sin_port);
+      break;
+#if P_HAS_IPV6
+    case AF_INET6 :
+      ip = ((const sockaddr_in6 &)from).sin6_addr;
+      port = ntohs(((const sockaddr_in6 &)from).sin6_port);
+      break;
+#endif
+    default :
+      return;
+  }
+
+  PSTUNMessage message(data, length, PIPSocketAddressAndPort(ip, port));
+  if (!message.IsValid()) {
+    PTRACE(4, "Relay " << m_index << " received invalid packet from " << message.GetSourceAddressAndPort());
+    ++m_dropped;
+    return;
+  }
+
+  switch (message.GetType()) {
+    case PSTUNMessage::Allocate :
+    case PSTUNMessage::Refresh :
+    case PSTUNMessage::CreatePermission :
+    case PSTUNMessage::ChannelBind :
+      if (from.ss_family != AF_INET) {
+        PSTUNMessage response;
+        response.SetType((PSTUNMessage::MsgType)(message.GetType() | 0x0110), message->transactionId);
+        response.AddAttribute(PSTUNErrorCode(440, "Address Family not Supported"));
+        SendResponse(response, message, PBYTEArray());
+        return;
+      }
+      break;
+
+    default :
+      PWaitAndSignal lock(m_server.m_workerMutex);
+      m_server.OnReceiveMessage(message, m_socketInfo);
+      return;
+  }
+
+  PTRACE(4, "Relay " << m_index << " received " << message);
+
+  switch (message.GetType()) {
+    case PSTUNMessage::Allocate :
+      OnAllocate(message, (const sockaddr_in &)from);
+      break;
+    case PSTUNMessage::Refresh :
+      OnRefresh(message);
+      break;
+    case PSTUNMessage::CreatePermission :
+      OnCreatePermission(message);
+      break;
+    default :
+      OnChannelBind(message);
+  }
+}
+
+
+bool PTURNServer::Relay::Authenticate(const PSTUNMessage & request, PString & userName, PBYTEArray & key)
+{
+  if (!m_authenticate)
+    return true;
+
+  bool hasIntegrity = request.FindAttribute(PSTUNAttribute::MESSAGE_INTEGRITY) != NULL;
+  userName = request.FindAttributeString(PSTUNAttribute::USERNAME);
+
+  if (m_realm.IsEmpty()) {
+    // Short term credentials, RFC5389/10.1.2
+    if (!hasIntegrity || userName.IsEmpty()) {
+      SendError(request, 400, "Bad Request", key);
+      return false;
+    }
+  }
+  else {
+    // Long term credentials, RFC5389/10.2.2
+    if (!hasIntegrity) {
+      SendError(request, 401, "Unauthorized", key, true);
+      return false;
+    }
+
+    PString nonce = request.FindAttributeString(PSTUNAttribute::NONCE);
+    if (userName.IsEmpty() || nonce.IsEmpty() || request.FindAttribute(PSTUNAttribute::REALM) == NULL) {
+      SendError(request, 400, "Bad Request", key);
+      return false;
+    }
+
+    if (nonce != m_nonce && nonce != m_previousNonce) {
+      SendError(request, 438, "Stale Nonce", key, true);
+      return false;
+    }
+  }
+
+  if (!m_server.GetCredentialKey(userName, key)) {
+    PTRACE(2, "Relay " << m_index << " unknown user \"" << userName << "\" from " << request.GetSourceAddressAndPort());
+    key.SetSize(0);
+    SendError(request, 401, "Unauthorized", key, !m_realm.IsEmpty());
+    return false;
+  }
+
+#if P_SSL
+  if (request.CheckMessageIntegrity(key) != 0) {
+    PTRACE(2, "Relay " << m_index << " integrity check failed for user \"" << userName << "\" from " << request.GetSourceAddressAndPort());
+    key.SetSize(0);
+    SendError(request, 401, "Unauthorized", key, !m_realm.IsEmpty());
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+
+void PTURNServer::Relay::SendResponse(PSTUNMessage & response, const PSTUNMessage & request, const PBYTEArray & key)
+{
+#if P_SSL
+  response.AddMessageIntegrity(key);
+#endif
+  response.AddFingerprint();
+  response.Write(m_socket, request.GetSourceAddressAndPort());
+}
+
+
+void PTURNServer::Relay::SendError(const PSTUNMessage & request, int code, const char * reason, const PBYTEArray & key, bool challenge)
+{
+  PTRACE(3, "Relay " << m_index << " sending error " << code << " for " << request);
+
+  PSTUNMessage response;
+  response.SetType((PSTUNMessage::MsgType)(request.GetType() | 0x0110), request->transactionId);
+  response.AddAttribute(PSTUNErrorCode(code, reason));
+  if (challenge) {
+    response.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::REALM, m_realm));
+    response.AddAttribute(PSTUNStringAttribute(PSTUNAttribute::NONCE, m_nonce));
+  }
+  SendResponse(response, request, key);
+}
+
+
+PTURNAllocation * PTURNServer::Relay::FindAllocation(const PSTUNMessage & request, const PString & userName, const PBYTEArray & key)
+{
+  sockaddr_in client;
+  memset(&client, 0, sizeof(client));
+  client.sin_family = AF_INET;
+  client.sin_addr = request.GetSourceAddressAndPort().GetAddress();
+  client.sin_port = htons(request.GetSourceAddressAndPort().GetPort());
+
+  PTURNAllocation * allocation = m_allocations.Find(PTURNAllocation::MakeKey(client));
+  if (allocation == NULL || allocation->m_dead) {
+    SendError(request, 437, "Allocation Mismatch", key);
+    return NULL;
+  }
+
+  if (allocation->m_userName != userName) {
+    SendError(request, 441, "Wrong Credentials", key);
+    return NULL;
+  }
+
+  return allocation;
+}
+
+
+void PTURNServer::Relay::OnAllocate(const PSTUNMessage & request, const sockaddr_in & from)
+{
+  PString userName;
+  PBYTEArray key;
+  if (!Authenticate(request, userName, key))
+    return;
+
+  PTURNAllocation * allocation = m_allocations.Find(PTURNAllocation::MakeKey(from));
+  if (allocation != NULL && !allocation->m_dead) {
+    // A retransmission gets the same answer, anything else is a mismatch
+    if (memcmp(allocation->m_transactionId, request->transactionId, sizeof(allocation->m_transactionId)) != 0) {
+      SendError(request, 437, "Allocation Mismatch", key);
+      return;
+    }
+  }
+  else {
+    PTURNRequestedTransport * transport = request.FindAttributeAs<PTURNRequestedTransport>(PSTUNAttribute::REQUESTED_TRANSPORT);
+    if (transport == NULL) {
+      SendError(request, 400, "Bad Request", key);
+      return;
+    }
+    if (transport->m_protocol != PTURNRequestedTransport::ProtocolUDP) {
+      SendError(request, 442, "Unsupported Transport Protocol", key);
+      return;
+    }
+
+    if (m_server.m_maxAllocations > 0 && m_allocations.GetSize() >= m_server.m_maxAllocations) {
+      SendError(request, 508, "Insufficient Capacity", key);
+      return;
+    }
+
+    allocation = new PTURNAllocation(from);
+    if (!allocation->m_socket.Listen(m_relayInterface, 0, 0) ||
+        !AddHandle(allocation->m_handle = allocation->m_socket.GetHandle(), allocation)) {
+      PTRACE(2, "Relay " << m_index << " could not open relay socket on " << m_relayInterface);
+      delete allocation;
+      SendError(request, 508, "Insufficient Capacity", key);
+      return;
+    }
+
+    allocation->m_socket.GetLocalAddress(allocation->m_relayedAddress);
+    if (m_server.m_relayedAddress.IsValid())
+      allocation->m_relayedAddress.SetAddress(m_server.m_relayedAddress);
+    allocation->m_userName = userName;
+    memcpy(allocation->m_transactionId, request->transactionId, sizeof(allocation->m_transactionId));
+
+    DWORD lifetime = DefaultLifetime;
+    PTURNLifetime * lifetimeAttr = request.FindAttributeAs<PTURNLifetime>(PSTUNAttribute::LIFETIME);
+    if (lifetimeAttr != NULL)
+      lifetime = std::min((DWORD)MaxLifetime, std::max((DWORD)DefaultLifetime, lifetimeAttr->GetLifetime()));
+    allocation->m_expiry = m_now + lifetime*1000;
+
+    m_allocations.Insert(allocation);
+    ++m_allocationCount;
+
+    PTRACE(3, "Relay " << m_index << " allocated " << allocation->m_relayedAddress
+           << " for " << allocation->m_clientAddress << ", lifetime " << lifetime << 's');
+  }
+
+  PSTUNMessage response;
+  response.SetType(PSTUNMessage::AllocateResponse, request->transactionId);
+  response.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::XOR_RELAYED_ADDRESS, allocation->m_relayedAddress));
+  response.AddAttribute(PTURNLifetime((DWORD)((allocation->m_expiry - m_now + 999)/1000)));
+  response.AddAttribute(PSTUNAddressAttribute(PSTUNAttribute::XOR_MAPPED_ADDRESS, allocation->m_clientAddress));
+  SendResponse(response, request, key);
+}
+
+
+void PTURNServer::Relay::OnRefresh(const PSTUNMessage & request)
+{
+  PString userName;
+  PBYTEArray key;
+  if (!Authenticate(request, userName, key))
+    return;
+
+  PTURNAllocation * allocation = FindAllocation(request, userName, key);
+  if (allocation == NULL)
+    return;
+
+  DWORD lifetime = DefaultLifetime;
+  PTURNLifetime * lifetimeAttr = request.FindAttributeAs<PTURNLifetime>(PSTUNAttribute::LIFETIME);
+  if (lifetimeAttr != NULL) {
+    lifetime = lifetimeAttr->GetLifetime();
+    if (lifetime != 0)
+      lifetime = std::min((DWORD)MaxLifetime, std::max((DWORD)DefaultLifetime, lifetime));
+  }
+
+  if (lifetime == 0) {
+    PTRACE(3, "Relay " << m_index << " released " << allocation->m_relayedAddress << " for " << allocation->m_clientAddress);
+    allocation->m_dead = true;
+    m_deadAllocations.push_back(allocation);
+  }
+  else
+    allocation->m_expiry = m_now + lifetime*1000;
+
+  PSTUNMessage response;
+  response.SetType(PSTUNMessage::RefreshResponse, request->transactionId);
+  response.AddAttribute(PTURNLifetime(lifetime));
+  SendResponse(response, request, key);
+}
+
+
+static void FindPeerAddresses(const PSTUNMessage & message, std::vector<PIPSocketAddressAndPort> & peers)
+{
+  const BYTE * ptr = message.GetPointer() + sizeof(PSTUNMessageHeader);
+  const BYTE * end = ptr + message->msgLength;
+  while (ptr + sizeof(PSTUNAttribute) <= end) {
+    const PSTUNAttribute * attr = (const PSTUNAttribute *)ptr;
+    if (attr->type == PSTUNAttribute::MESSAGE_INTEGRITY)
+      break;
+    if (attr->type == PSTUNAttribute::XOR_PEER_ADDRESS && attr->length == 8) {
+      PIPSocketAddressAndPort peer;
+      ((PSTUNAddressAttribute *)attr)->GetIPAndPort(peer);
+      peers.push_back(peer);
+    }
+    ptr = (const BYTE *)attr->GetNext();
+  }
+}
+
+
+void PTURNServer::Relay::OnCreatePermission(const PSTUNMessage & request)
+{
+  PString userName;
+  PBYTEArray key;
+  if (!Authenticate(request, userName, key))
+    return;
+
+  PTURNAllocation * allocation = FindAllocation(request, userName, key);
+  if (allocation == NULL)
+    return;
+
+  std::vector<PIPSocketAddressAndPort> peers;
+  FindPeerAddresses(request, peers);
+  if (peers.empty()) {
+    SendError(request, 400, "Bad Request", key);
+    return;
+  }
+
+  // All or nothing, RFC5766/9.2
+  for (size_t i = 0; i < peers.size(); ++i) {
+    if (!m_server.OnAllowPeer(allocation->m_clientAddress, peers[i].GetAddress())) {
+      SendError(request, 403, "Forbidden", key);
+      return;
+    }
+  }
+
+  for (size_t i = 0; i < peers.size(); ++i) {
+    in_addr addr = peers[i].GetAddress();
+    allocation->AddPermission(addr.s_addr, m_now + PermissionLifetime*1000);
+    PTRACE(4, "Relay " << m_index << " permitted " << peers[i].GetAddress() << " for " << allocation->m_clientAddress);
+  }
+
+  PSTUNMessage response;
+  response.SetType(PSTUNMessage::CreatePermResponse, request->transactionId);
+  SendResponse(response, request, key);
+}
+
+
+void PTURNServer::Relay::OnChannelBind(const PSTUNMessage & request)
+{
+  PString userName;
+  PBYTEArray key;
+  if (!Authenticate(request, userName, key))
+    return;
+
+  PTURNAllocation * allocation = FindAllocation(request, userName, key);
+  if (allocation == NULL)
+    return;
+
+  PSTUNChannelNumber * channelAttr = request.FindAttributeAs<PSTUNChannelNumber>(PSTUNAttribute::CHANNEL_NUMBER);
+  PSTUNAddressAttribute * peerAttr = request.FindAttributeAs<PSTUNAddressAttribute>(PSTUNAttribute::XOR_PEER_ADDRESS);
+  if (channelAttr == NULL || peerAttr == NULL ||
+      channelAttr->m_channelNumber < MinChannelNumber || channelAttr->m_channelNumber > MaxChannelNumber) {
+    SendError(request, 400, "Bad Request", key);
+    return;
+  }
+
+  WORD number = channelAttr->m_channelNumber;
+  PIPSocketAddressAndPort peerAddress;
+  peerAttr->GetIPAndPort(peerAddress);
+
+  if (!m_server.OnAllowPeer(allocation->m_clientAddress, peerAddress.GetAddress())) {
+    SendError(request, 403, "Forbidden", key);
+    return;
+  }
+
+  sockaddr_in peer;
+  memset(&peer, 0, sizeof(peer));
+  peer.sin_family = AF_INET;
+  peer.sin_addr = peerAddress.GetAddress();
+  peer.sin_port = htons(peerAddress.GetPort());
+
+  // Channel must not be bound to another peer, nor the peer to another channel, RFC5766/11.2
+  PTURNChannel * channel = NULL;
+  for (size_t i = 0; i < allocation->m_channels.size(); ++i) {
+    PTURNChannel & existing = allocation->m_channels[i];
+    bool samePeer = existing.m_peer.sin_addr.s_addr == peer.sin_addr.s_addr && existing.m_peer.sin_port == peer.sin_port;
+    if ((existing.m_number == number) != samePeer) {
+      SendError(request, 400, "Bad Request", key);
+      return;
+    }
+    if (samePeer)
+      channel = &existing;
+  }
+
+  if (channel == NULL) {
+    PTURNChannel newChannel;
+    newChannel.m_number = number;
+    newChannel.m_peer = peer;
+    allocation->m_channels.push_back(newChannel);
+    channel = &allocation->m_channels.back();
+    PTRACE(4, "Relay " << m_index << " bound channel 0x" << hex << number << dec
+           << " to " << peerAddress << " for " << allocation->m_clientAddress);
+  }
+
+  channel->m_expiry = m_now + ChannelLifetime*1000;
+  allocation->AddPermission(peer.sin_addr.s_addr, m_now + PermissionLifetime*1000);
+
+  PSTUNMessage response;
+  response.SetType(PSTUNMessage::ChannelBindResponse, request->transactionId);
+  SendResponse(response, request, key);
+}
+
+
+void PTURNServer::Relay::Sweep()
+{
+  m_lastSweep = m_now;
+
+  for (size_t i = 0; i < m_allocations.GetCapacity(); ++i) {
+    PTURNAllocation * allocation = m_allocations.GetAt(i);
+    if (allocation == NULL || allocation->m_dead)
+      continue;
+
+    if (allocation->m_expiry <= m_now) {
+      PTRACE(3, "Relay " << m_index << " expired " << allocation->m_relayedAddress << " for " << allocation->m_clientAddress);
+      allocation->m_dead = true;
+      m_deadAllocations.push_back(allocation);
+    }
+    else
+      allocation->Expire(m_now);
+  }
+
+  if (m_now - m_nonceTime >= NonceLifetime*1000) {
+    m_previousNonce = m_nonce;
+    m_nonce = PRandom::String(24);
+    m_nonceTime = m_now;
+  }
+}
+
+
+void PTURNServer::Relay::Deallocate(PTURNAllocation * allocation)
+{
+  RemoveHandle(allocation->m_handle);
+  m_allocations.Remove(allocation);
+  delete allocation;
+  --m_allocationCount;
+}
+
+
+#endif // _WIN32
+
+
+//////////////////////////////////////////////////
+
+PTURNServer::Statistics::Statistics()
+  : m_allocations(0)
+  , m_toPeers(0)
+  , m_toClients(0)
+  , m_dropped(0)
+{
+}
+
+
+PTURNServer::PTURNServer()
+  : m_relayedAddress(PIPSocket::GetInvalidAddress())
+  , m_maxAllocations(0)
+{
+}
+
+
+PTURNServer::~PTURNServer()
+{
+  StopRelay();
+}
+
+
+bool PTURNServer::StartRelay(const PIPSocketAddressAndPort & binding, unsigned count, const PIPSocket::Address & relayInterface)
+{
+  StopRelay();
+
+#ifdef _WIN32
+  PTRACE(1, "TURN relay not supported on this platform");
+  return false;
+#else
+  if (binding.GetAddress().GetVersion() != 4) {
+    PTRACE(2, "TURN relay only supports IPv4, cannot use " << binding);
+    return false;
+  }
+
+  if (count == 0)
+    count = PThread::GetNumProcessors();
+
+  PIPSocketAddressAndPort actualBinding = binding;
+  for (unsigned i = 0; i < count; ++i) {
+    Relay * relay = new Relay(*this, i, relayInterface);
+    if (!relay->Listen(actualBinding)) {
+      delete relay;
+      break;
+    }
+    m_relays.push_back(relay);
+  }
+
+  if (m_relays.empty())
+    return false;
+
+  for (size_t i = 0; i < m_relays.size(); ++i)
+    m_relays[i]->Start();
+
+  PTRACE(3, "Started " << m_relays.size() << " relay threads on " << actualBinding);
+  return true;
+#endif
+}
+
+
+void PTURNServer::StopRelay()
+{
+#ifndef _WIN32
+  for (size_t i = 0; i < m_relays.size(); ++i)
+    delete m_relays[i];
+#endif
+  m_relays.clear();
+}
+
+
+PTURNServer::Statistics PTURNServer::GetStatistics() const
+{
+  Statistics stats;
+#ifndef _WIN32
+  for (size_t i = 0; i < m_relays.size(); ++i) {
+    stats.m_allocations += m_relays[i]->m_allocationCount;
+    stats.m_toPeers += m_relays[i]->m_toPeers;
+    stats.m_toClients += m_relays[i]->m_toClients;
+    stats.m_dropped += m_relays[i]->m_dropped;
+  }
+#endif
+  return stats;
+}
+
+
+bool PTURNServer::GetCredentialKey(const PString & userName, PBYTEArray & key) const
+{
+  if (userName != m_userName)
+    return false;
+
+  key = m_password;
+  return true;
+}
+
+
+bool PTURNServer::OnAllowPeer(const PIPSocketAddressAndPort &, const PIPSocket::Address &)
+{
+  return true;
+}
+
+
+#endif // P_TURN
+
+
 #endif // P_STUNSRVR
@@ -61,11 +61,65 @@ PVideoFile::PVideoFile()
   , m_fixedFrameRate(false)
   , m_headerOffset(0)
   , m_frameHeaderLen(0)
+  , m_memoryMapped(false)
 {
   m_frameBytes = m_videoInfo.CalculateFrameBytes();
 }
 
 
+void PVideoFile::SetMemoryMapped(bool mapped, bool hugePages)
+{
+  m_memoryMapped = mapped;
+  m_mappedFile.SetHugePages(hugePages);
+}
+
+
+bool PVideoFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions)
+{
+  if (!PFile::InternalOpen(mode, opts, permissions))
+    return false;
+
+  // Our own handle is kept for GetLength() etc, all reads are from the mapping
+  if (m_memoryMapped && mode == ReadOnly && !m_mappedFile.Open(GetFilePath(), ReadOnly, opts)) {
+    PTRACE(2, "Could not map file \"" << GetFilePath() << "\" - " << m_mappedFile.GetErrorText());
+    PFile::Close();
+    return false;
+  }
+
+  return true;
+}
+
+
+PBoolean PVideoFile::Close()
+{
+  m_mappedFile.Close();
+  return PFile::Close();
+}
+
+
+PBoolean PVideoFile::Read(void * buf, PINDEX len)
+{
+  if (!m_mappedFile.IsOpen())
+    return PFile::Read(buf, len);
+
+  bool ok = m_mappedFile.Read(buf, len);
+  SetLastReadCount(m_mappedFile.GetLastReadCount());
+  return ok;
+}
+
+
+off_t PVideoFile::GetBytePosition() const
+{
+  return m_mappedFile.IsOpen() ? m_mappedFile.GetPosition() : PFile::GetPosition();
+}
+
+
+bool PVideoFile::SetBytePosition(off_t pos, PFile::FilePositionOrigin origin)
+{
+  return m_mappedFile.IsOpen() ? m_mappedFile.SetPosition(pos, origin) : PFile::SetPosition(pos, origin);
+}
+
+
 bool PVideoFile::SetFrameSizeFromFilename(const PString & fn)
 {
   static PRegularExpression res("_(sqcif|qcif|cif|cif4|cif16|HD[0-9]+|[0-9]+p|[0-9]+x[0-9]+)[^a-z0-9]",
@@ -115,6 +169,19 @@ PBoolean PVideoFile::ReadFrame(void * frame)
 }
 
 
+bool PVideoFile::ReadFrameSpan(const BYTE * & frame)
+{
+  if (!m_mappedFile.IsOpen())
+    return SetErrorValues(Miscellaneous, EINVAL, LastReadError);
+
+  if (m_mappedFile.ReadSpan(frame, m_frameBytes) && m_mappedFile.GetLastReadCount() == m_frameBytes)
+    return true;
+
+  PTRACE(4, "End of file \"" << GetFilePath() << '"');
+  return false;
+}
+
+
 off_t PVideoFile::GetLength() const
 {
   off_t len = PFile::GetLength();
@@ -130,7 +197,7 @@ PBoolean PVideoFile::SetLength(off_t len)
 
 off_t PVideoFile::GetPosition() const
 {
-  off_t pos = PFile::GetPosition();
+  off_t pos = GetBytePosition();
   return pos < m_headerOffset ? 0 : ((pos - m_headerOffset)/(m_frameBytes+m_frameHeaderLen));
 }
 
@@ -141,7 +208,7 @@ PBoolean PVideoFile::SetPosition(off_t pos, PFile::FilePositionOrigin origin)
   if (origin == PFile::Start)
     pos += m_headerOffset;
 
-  return PFile::SetPosition(pos, origin);
+  return SetBytePosition(pos, origin);
 }
 
 
@@ -265,7 +332,7 @@ bool PYUVFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissi
     }
 
     PTRACE(4, "y4m \"" << info << '"');
-    m_headerOffset = PFile::GetPosition();
+    m_headerOffset = GetBytePosition();
     m_videoInfo.SetFrameSize(frameWidth, frameHeight);
     m_videoInfo.SetFrameRate(frameRate);
     m_videoInfo.SetFrameSar(sarWidth, sarHeight);
@@ -279,7 +346,7 @@ bool PYUVFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissi
 PBoolean PYUVFile::WriteFrame(const void * frame)
 {
   if (m_y4mMode) {
-    if (PFile::GetPosition() > 0)
+    if (GetBytePosition() > 0)
       WriteString("FRAME\n");
     else {
       *this << "YUV4MPEG2 W" << m_videoInfo.GetFrameWidth() << " H" << m_videoInfo.GetFrameHeight() << " F" << m_videoInfo.GetFrameRate() << ":1 Ip";
@@ -288,7 +355,7 @@ PBoolean PYUVFile::WriteFrame(const void * frame)
       if (m_videoInfo.GetColourFormat() == "YUV422P")
         *this << " C422";
       *this << endl;
-      m_headerOffset = PFile::GetPosition();
+      m_headerOffset = GetBytePosition();
     }
   }
 
@@ -296,20 +363,32 @@ PBoolean PYUVFile::WriteFrame(const void * frame)
 }
 
 
-PBoolean PYUVFile::ReadFrame(void * frame)
+bool PYUVFile::ReadFrameHeader()
 {
-  if (m_y4mMode) {
-    PString info = ReadPrintable(*this);
-    if (m_frameHeaderLen == 0)
-      m_frameHeaderLen = PFile::GetPosition() - m_headerOffset;
-    if (info.NumCompare("FRAME") != EqualTo) {
-      PTRACE(2, "Invalid frame header in y4m file");
-      return false;
-    }
-    PTRACE(6, "y4m \"" << info << '"');
+  if (!m_y4mMode)
+    return true;
+
+  PString info = ReadPrintable(*this);
+  if (m_frameHeaderLen == 0)
+    m_frameHeaderLen = GetBytePosition() - m_headerOffset;
+  if (info.NumCompare("FRAME") != EqualTo) {
+    PTRACE(2, "Invalid frame header in y4m file");
+    return false;
   }
+  PTRACE(6, "y4m \"" << info << '"');
+  return true;
+}
 
-  return PVideoFile::ReadFrame(frame);
+
+PBoolean PYUVFile::ReadFrame(void * frame)
+{
+  return ReadFrameHeader() && PVideoFile::ReadFrame(frame);
+}
+
+
+bool PYUVFile::ReadFrameSpan(const BYTE * & frame)
+{
+  return ReadFrameHeader() && PVideoFile::ReadFrameSpan(frame);
 }
 
 
@@ -517,7 +596,7 @@ class PBMPFile : public PStillImageVideoFile
 
       if (!Read(&bitmapHeader.m_Size, sizeof(bitmapHeader.m_Size)))
         return false;
-      if (!PFile::SetPosition(sizeof(fileHeader)))
+      if (!SetBytePosition(sizeof(fileHeader)))
         return false;
       if (!Read(&bitmapHeader, std::min((uint32_t)bitmapHeader.m_Size, (uint32_t)sizeof(bitmapHeader))))
         return false;
@@ -529,7 +608,7 @@ class PBMPFile : public PStillImageVideoFile
         return false;
 
       m_headerOffset =bitmapHeader.m_Size + sizeof(fileHeader);
-      if (!PFile::SetPosition(m_headerOffset))
+      if (!SetBytePosition(m_headerOffset))
         return false;
 
       m_videoInfo.SetFrameSize(bitmapHeader.m_Width, std::abs(bitmapHeader.m_Height));
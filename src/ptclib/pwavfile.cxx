@@ -232,27 +232,72 @@ PBoolean PWAVFile::Read(void * buf, PINDEX len)
     return false;
   }
 
-  if (m_readBufPos >= m_readBufCount) {
-    static const PINDEX seconds = 10; // 10 seconds worth
-    if (!m_readBuffer.SetSize(seconds*m_wavFmtChunk.sampleRate*m_wavFmtChunk.numChannels))
+  unsigned srcChannels = m_wavFmtChunk.numChannels;
+  if (m_wavFmtChunk.sampleRate == m_readSampleRate) {
+    // Only the channels differ
+    if (!FillReadBuffer())
       return false;
-    void * ptr = m_readBuffer.GetPointer();
-    PINDEX sz = m_readBuffer.GetSize()*sizeof(short);
-    if (!(m_autoConverter != NULL ? m_autoConverter->Read(*this, ptr, sz) : RawRead(ptr, sz)))
+
+    PINDEX srcSize = (m_readBufCount - m_readBufPos)*sizeof(short);
+    PSound::ConvertPCM(&m_readBuffer[m_readBufPos], srcSize, m_wavFmtChunk.sampleRate, srcChannels,
+                       (short *)buf, len, m_readSampleRate, m_readChannels);
+    SetLastReadCount(len);
+    m_readBufPos += srcSize / sizeof(short);
+    return true;
+  }
+
+  if (!m_resampler.SetRates(m_wavFmtChunk.sampleRate, m_readSampleRate, srcChannels))
+    return false;
+
+  // Resample with the file's channels, then convert those if needed
+  short * dst = (short *)buf;
+  PINDEX dstCount = len/sizeof(short)/m_readChannels*srcChannels;
+  if (srcChannels != m_readChannels) {
+    if (!m_resampleBuffer.SetMinSize(dstCount))
       return false;
-    m_readBufCount = GetLastReadCount()/sizeof(short);
-    m_readBufPos = 0;
+    dst = m_resampleBuffer.GetPointer();
   }
 
-  PINDEX srcSize = (m_readBufCount - m_readBufPos)*sizeof(short);
-  PSound::ConvertPCM(&m_readBuffer[m_readBufPos], srcSize, m_wavFmtChunk.sampleRate, m_wavFmtChunk.numChannels,
-                     (short *)buf, len, m_readSampleRate, m_readChannels);
-  SetLastReadCount(len);
-  m_readBufPos += srcSize / sizeof(short);
+  PINDEX produced = 0;
+  while (produced < dstCount && FillReadBuffer()) {
+    PINDEX srcCount = m_readBufCount - m_readBufPos;
+    produced += m_resampler.Process(&m_readBuffer[m_readBufPos], srcCount, dst + produced, dstCount - produced);
+    m_readBufPos += srcCount;
+  }
+
+  if (produced == 0)
+    return false;
+
+  if (srcChannels == m_readChannels)
+    SetLastReadCount(produced*sizeof(short));
+  else {
+    PINDEX srcSize = produced*sizeof(short);
+    PSound::ConvertPCM(dst, srcSize, m_readSampleRate, srcChannels,
+                       (short *)buf, len, m_readSampleRate, m_readChannels);
+    SetLastReadCount(len);
+  }
   return true;
 }
 
 
+bool PWAVFile::FillReadBuffer()
+{
+  if (m_readBufPos < m_readBufCount)
+    return true;
+
+  static const PINDEX seconds = 10; // 10 seconds worth
+  if (!m_readBuffer.SetSize(seconds*m_wavFmtChunk.sampleRate*m_wavFmtChunk.numChannels))
+    return false;
+  void * ptr = m_readBuffer.GetPointer();
+  PINDEX sz = m_readBuffer.GetSize()*sizeof(short);
+  if (!(m_autoConverter != NULL ? m_autoConverter->Read(*this, ptr, sz) : RawRead(ptr, sz)))
+    return false;
+  m_readBufCount = GetLastReadCount()/sizeof(short);
+  m_readBufPos = 0;
+  return m_readBufCount > 0;
+}
+
+
 bool PWAVFile::RawRead(void * buf, PINDEX len)
 {
   // Some wav files have extra data after the sound samples in a LIST chunk.
@@ -335,6 +380,10 @@ PBoolean PWAVFile::SetLength(off_t)
 
 PBoolean PWAVFile::SetPosition(off_t pos, FilePositionOrigin origin)
 {
+  // Discard anything buffered for rate/channel conversion
+  m_readBufCount = m_readBufPos = 0;
+  m_resampler.Reset();
+
   if (m_autoConverter != NULL)
     return m_autoConverter->SetPosition(*this, pos, origin);
 
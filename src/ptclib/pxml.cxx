@@ -1265,9 +1265,14 @@ PXMLElement::PXMLElement(const char * name, const char * data)
 PXMLElement::PXMLElement(const PXMLElement & copy)
   : m_name(copy.m_name)
   , m_attributes(copy.m_attributes)
+  , m_nameSpaces(copy.m_nameSpaces)
+  , m_defaultNamespace(copy.m_defaultNamespace)
 {
   m_attributes.MakeUnique();
+  m_nameSpaces.MakeUnique();
   m_dirty = copy.m_dirty;
+  m_lineNumber = copy.m_lineNumber;
+  m_column = copy.m_column;
 
   for (PINDEX idx = 0; idx < copy.m_subObjects.GetSize(); idx++)
     AddSubObject(copy.m_subObjects[idx].Clone(), false);
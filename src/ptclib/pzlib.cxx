@@ -0,0 +1,296 @@
+/*
+ * pzlib.cxx
+ *
+ * zlib compression, as used for HTTP content encoding.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "pzlib.h"
+#endif
+
+#include <ptclib/pzlib.h>
+
+#if P_ZLIB
+
+#include <zlib.h>
+
+#define new PNEW
+#define PTraceModule() "ZLib"
+
+
+#define STREAM (*(z_stream *)m_stream)
+
+PZLib::PZLib(bool compress, Format format, int level)
+  : m_compress(compress)
+  , m_format(format)
+  , m_level(level)
+  , m_finished(false)
+  , m_failed(false)
+  , m_started(false)
+  , m_maxOutput(0)
+  , m_exceededMaxOutput(false)
+  , m_stream(new z_stream)
+{
+  m_failed = !Init();
+}
+
+
+PZLib::~PZLib()
+{
+  if (m_compress)
+    deflateEnd(&STREAM);
+  else
+    inflateEnd(&STREAM);
+  delete (z_stream *)m_stream;
+}
+
+
+bool PZLib::Init()
+{
+  memset(m_stream, 0, sizeof(z_stream));
+
+  int windowBits;
+  switch (m_format) {
+    case RawDeflate :
+      windowBits = -MAX_WBITS;
+      break;
+    case GZip :
+      windowBits = MAX_WBITS + 16;
+      break;
+    default :
+      windowBits = MAX_WBITS;
+  }
+
+  int result;
+  if (m_compress)
+    result = deflateInit2(&STREAM, m_level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+  else {
+    // Accept either wrapper, as plenty of servers send gzip when they say deflate
+    if (windowBits > 0)
+      windowBits = MAX_WBITS + 32;
+    result = inflateInit2(&STREAM, windowBits);
+  }
+
+  PTRACE_IF(1, result != Z_OK, "Could not initialise zlib: " << result);
+  return result == Z_OK;
+}
+
+
+bool PZLib::Process(const void * data, PINDEX length, PBYTEArray & output, PINDEX & outputLength, FlushMode flush)
+{
+  if (m_failed)
+    return false;
+
+  // Anything after the end, e.g. padding, is ignored
+  if (m_finished)
+    return true;
+
+  STREAM.next_in = (Bytef *)data;
+  STREAM.avail_in = length;
+
+  int zflush = Z_NO_FLUSH;
+  if (m_compress) {
+    switch (flush) {
+      case SyncFlush :
+        zflush = Z_SYNC_FLUSH;
+        break;
+      case Finish :
+        zflush = Z_FINISH;
+        break;
+      default :
+        break;
+    }
+  }
+
+  for (;;) {
+    // One byte past the limit is enough to know it has been exceeded
+    PUInt64 allowed = m_maxOutput > 0 ? m_maxOutput - STREAM.total_out + 1 : P_MAX_INDEX;
+
+    if (output.GetSize() - outputLength < 1024) {
+      PINDEX size = std::max(outputLength + std::max(length, (PINDEX)4096), output.GetSize()*2);
+      if ((PUInt64)(size - outputLength) > allowed)
+        size = std::max(output.GetSize(), outputLength + (PINDEX)allowed);
+      output.SetSize(size);
+    }
+
+    uInt available = output.GetSize() - outputLength;
+    if (available > allowed)
+      available = (uInt)allowed;
+
+    STREAM.next_out = output.GetPointer() + outputLength;
+    STREAM.avail_out = available;
+
+    int result = m_compress ? deflate(&STREAM, zflush) : inflate(&STREAM, Z_NO_FLUSH);
+    outputLength += available - STREAM.avail_out;
+
+    if (m_maxOutput > 0 && STREAM.total_out > m_maxOutput) {
+      PTRACE(2, "zlib output exceeds limit of " << m_maxOutput << " bytes");
+      m_exceededMaxOutput = true;
+      m_failed = true;
+      return false;
+    }
+
+    if (result == Z_STREAM_END) {
+      m_finished = true;
+      return true;
+    }
+
+    if (result == Z_OK || result == Z_BUF_ERROR) {
+      m_started = true;
+      // Stop when all input is used, and zlib did not fill the output, so has nothing more for us
+      if (STREAM.avail_in == 0 && STREAM.avail_out > 0 && (zflush != Z_FINISH || result == Z_BUF_ERROR))
+        return true;
+      continue;
+    }
+
+    // Some servers send raw deflate data for "deflate", which we find out at the very start
+    if (!m_compress && m_format == Deflate && !m_started && result == Z_DATA_ERROR) {
+      PTRACE(4, "Data is raw deflate, not zlib format");
+      inflateEnd(&STREAM);
+      m_format = RawDeflate;
+      if (Init())
+        return Process(data, length, output, outputLength, flush);
+    }
+
+    PTRACE(2, "zlib " << (m_compress ? "compression" : "decompression") << " failed: "
+           << result << ' ' << (STREAM.msg != NULL ? STREAM.msg : ""));
+    m_failed = true;
+    return false;
+  }
+}
+
+
+PUInt64 PZLib::GetTotalIn() const
+{
+  return STREAM.total_in;
+}
+
+
+PUInt64 PZLib::GetTotalOut() const
+{
+  return STREAM.total_out;
+}
+
+
+bool PZLib::Compress(const void * data, PINDEX length, PBYTEArray & output, Format format, int level)
+{
+  PZLib zlib(true, format, level);
+  PINDEX outputLength = 0;
+  output.SetSize(compressBound(length) + 32); // Allow for gzip header
+  if (!zlib.Process(data, length, output, outputLength, Finish))
+    return false;
+  output.SetSize(outputLength);
+  return true;
+}
+
+
+bool PZLib::Decompress(const void * data, PINDEX length, PBYTEArray & output, Format format, PUInt64 maxOutput)
+{
+  PZLib zlib(false, format);
+  zlib.SetMaxOutput(maxOutput);
+  PINDEX outputLength = 0;
+  output.SetSize(maxOutput > 0 ? (PINDEX)std::min((PUInt64)length*4, maxOutput+1) : length*4);
+  if (!zlib.Process(data, length, output, outputLength) || !zlib.IsFinished())
+    return false;
+  output.SetSize(outputLength);
+  return true;
+}
+
+
+PString PZLib::GetContentEncoding(Format format)
+{
+  switch (format) {
+    case GZip :
+      return "gzip";
+    case Deflate :
+      return "deflate";
+    default :
+      return PString::Empty();
+  }
+}
+
+
+bool PZLib::FromContentEncoding(const PString & encoding, Format & format)
+{
+  PCaselessString token = encoding.Trim();
+  if (token == "gzip" || token == "x-gzip")
+    format = GZip;
+  else if (token == "deflate")
+    format = Deflate;
+  else
+    return false;
+  return true;
+}
+
+
+bool PZLib::SelectContentEncoding(const PString & acceptEncoding, Format & format)
+{
+  // Quality, in thousandths, of gzip, deflate and "*", -1 if not mentioned
+  int quality[3] = { -1, -1, -1 };
+
+  PStringArray codings = acceptEncoding.Tokenise(',', false);
+  for (PINDEX i = 0; i < codings.GetSize(); ++i) {
+    PStringArray params = codings[i].Tokenise(';', false);
+    if (params.IsEmpty())
+      continue;
+
+    int q = 1000;
+    for (PINDEX p = 1; p < params.GetSize(); ++p) {
+      PString param = params[p].Trim();
+      if ((param.Left(2) *= "q="))
+        q = (int)(param.Mid(2).AsReal()*1000 + 0.5);
+    }
+
+    PCaselessString token = params[0].Trim();
+    Format coding;
+    if (token == "*")
+      quality[2] = q;
+    else if (FromContentEncoding(token, coding))
+      quality[coding == GZip ? 0 : 1] = q;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (quality[i] < 0)
+      quality[i] = std::max(quality[2], 0);
+  }
+
+  if (quality[0] > 0 && quality[0] >= quality[1])
+    format = GZip;
+  else if (quality[1] > 0)
+    format = Deflate;
+  else
+    return false;
+
+  return true;
+}
+
+
+const PString & PZLib::GetAcceptEncoding()
+{
+  static const PConstString s("gzip, deflate");
+  return s;
+}
+
+
+#endif // P_ZLIB
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -242,10 +242,10 @@ PString PRandom::String(PINDEX size)
   static PRandom rand;
 
   PString str;
-  str.SetSize(size + 1);
+  char * ptr = str.GetPointerAndSetLength(size);
 
   for (PINDEX i = 0; i < size; ++i)
-    str[i] = "0123456789abcdefghijklmnopqrstuvwxyz"[rand.Generate(0, 35)];
+    ptr[i] = "0123456789abcdefghijklmnopqrstuvwxyz"[rand.Generate(0, 35)];
 
   return str;
 }
@@ -154,6 +154,47 @@ bool PScriptLanguage::SetString(const PString & name, const char * value)
 }
 
 
+PScriptLanguage::Handle PScriptLanguage::CompileName(const PString & name)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  std::vector<PString>::iterator it = std::find(m_compiledNames.begin(), m_compiledNames.end(), name);
+  if (it != m_compiledNames.end())
+    return Handle(it - m_compiledNames.begin());
+
+  m_compiledNames.push_back(name);
+  return Handle(m_compiledNames.size() - 1);
+}
+
+
+PString PScriptLanguage::GetHandleName(const Handle & handle) const
+{
+  PWaitAndSignal lock(m_mutex);
+  return handle.GetIndex() < m_compiledNames.size() ? m_compiledNames[handle.GetIndex()] : PString::Empty();
+}
+
+
+bool PScriptLanguage::GetVar(const Handle & handle, PVarType & var)
+{
+  PString name = GetHandleName(handle);
+  return !name.IsEmpty() && GetVar(name, var);
+}
+
+
+bool PScriptLanguage::SetVar(const Handle & handle, const PVarType & var)
+{
+  PString name = GetHandleName(handle);
+  return !name.IsEmpty() && SetVar(name, var);
+}
+
+
+bool PScriptLanguage::Call(const Handle & handle, Signature & signature)
+{
+  PString name = GetHandleName(handle);
+  return !name.IsEmpty() && Call(name, signature);
+}
+
+
 void PScriptLanguage::OnError(int code, const PString & str)
 {
   m_mutex.Wait();
@@ -227,3 +268,138 @@ PStringArray PScriptLanguage::GetLanguages()
   }
   return names;
 }
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PScriptPool::PScriptPool(const PString & language,
+                         const PString & script,
+                         unsigned maxIdle,
+                         const InitialiseNotifier & initialise)
+  : m_language(language)
+  , m_script(script)
+  , m_maxIdle(maxIdle)
+  , m_initialise(initialise)
+{
+}
+
+
+PScriptPool::~PScriptPool()
+{
+  for (std::vector<PScriptLanguage *>::iterator it = m_idle.begin(); it != m_idle.end(); ++it)
+    delete *it;
+}
+
+
+bool PScriptPool::Preload(unsigned count)
+{
+  for (;;) {
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_idle.size() >= count)
+        return true;
+    }
+
+    PScriptLanguage * script = CreateInstance();
+    if (script == NULL)
+      return false;
+
+    PWaitAndSignal lock(m_mutex);
+    m_idle.push_back(script);
+  }
+}
+
+
+PScriptLanguage::Handle PScriptPool::CompileName(const PString & name)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  PINDEX index = m_compiledNames.GetValuesIndex(name);
+  if (index != P_MAX_INDEX)
+    return PScriptLanguage::Handle(index);
+
+  /* Every instance compiles the names in the same order, so the handle is
+     the same for all of them, those created later catch up when created. */
+  PScriptLanguage::Handle handle(m_compiledNames.GetSize());
+  for (std::vector<PScriptLanguage *>::iterator it = m_idle.begin(); it != m_idle.end(); ++it) {
+    if ((*it)->CompileName(name).GetIndex() != handle.GetIndex())
+      return PScriptLanguage::Handle();
+  }
+
+  m_compiledNames.AppendString(name);
+  return handle;
+}
+
+
+PScriptLanguage * PScriptPool::Acquire()
+{
+  {
+    PWaitAndSignal lock(m_mutex);
+    if (!m_idle.empty()) {
+      PScriptLanguage * script = m_idle.back();
+      m_idle.pop_back();
+      return script;
+    }
+  }
+
+  // Create outside the lock, so slow loads do not hold up other users
+  return CreateInstance();
+}
+
+
+void PScriptPool::Release(PScriptLanguage * script)
+{
+  if (script == NULL)
+    return;
+
+  PWaitAndSignal lock(m_mutex);
+
+  // A name may have been compiled while this was in use, names are only added at the end
+  PINDEX count = m_compiledNames.GetSize();
+  if (count > 0 && script->GetHandleName(PScriptLanguage::Handle(count-1)).IsEmpty()) {
+    for (PINDEX i = 0; i < count; ++i)
+      script->CompileName(m_compiledNames[i]);
+  }
+
+  if (m_idle.size() < m_maxIdle)
+    m_idle.push_back(script);
+  else
+    delete script;
+}
+
+
+PString PScriptPool::GetLastErrorText() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_lastErrorText;
+}
+
+
+PScriptLanguage * PScriptPool::CreateInstance()
+{
+  PScriptLanguage * script = PScriptLanguage::Create(m_language);
+  if (script == NULL) {
+    PWaitAndSignal lock(m_mutex);
+    m_lastErrorText = "Unsupported script language " + m_language;
+    PTRACE(2, "Script", m_lastErrorText);
+    return NULL;
+  }
+
+  if (!m_initialise.IsNULL())
+    m_initialise(*this, *script);
+
+  if (!script->Load(m_script) || !script->Run()) {
+    PWaitAndSignal lock(m_mutex);
+    m_lastErrorText = script->GetLastErrorText();
+    PTRACE(2, "Script", "Could not initialise " << m_language << " instance: " << m_lastErrorText);
+    delete script;
+    return NULL;
+  }
+
+  PWaitAndSignal lock(m_mutex);
+  for (PINDEX i = 0; i < m_compiledNames.GetSize(); ++i)
+    script->CompileName(m_compiledNames[i]);
+
+  PTRACE(4, "Script", "Created " << m_language << " instance " << script);
+  return script;
+}
@@ -33,6 +33,7 @@
 #ifdef P_HTTPSVC
 
 #include <ptclib/shttpsvc.h>
+#include <ptclib/http2.h>
 
 #ifdef P_SSL
 
@@ -173,8 +174,15 @@ bool PSecureHTTPServiceProcess::SetServerCredentials(const PString & cert, const
   if (m_sslContext == NULL)
     m_sslContext = new PSSLContext(PSSLContext::TLSv1_2);
 
-  if (m_sslContext->SetCredentials(ca, cert, key))
-      return true;
+  if (m_sslContext->SetCredentials(ca, cert, key)) {
+    if (IsHTTP2Enabled()) {
+      PStringArray protocols;
+      protocols.AppendString(PHTTP2Connection::ALPN);
+      protocols.AppendString("http/1.1");
+      m_sslContext->SetALPN(protocols);
+    }
+    return true;
+  }
 
   DisableSSL();
   return false;
@@ -38,6 +38,7 @@ PSpoolDirectory::PSpoolDirectory()
   , m_threadRunning(false)
   , m_timeoutIfNoDir(10000)
   , m_scanTimeout(10000)
+  , m_watcher(PCREATE_NOTIFIER2(OnDirectoryChanged, const PDirectoryWatcher::Event &))
 {
 }
 
@@ -47,14 +48,14 @@ bool PSpoolDirectory::Open(const PDirectory & dir, const PString & type)
 
   Close();
 
+  m_directory = dir;
+  m_fileType  = type;
+
   m_threadRunning = true;
 
   PTRACE(3, "PSpoolDirectory\tThread started " << m_threadRunning);
   m_thread = new PThreadObj<PSpoolDirectory>(*this, &PSpoolDirectory::ThreadMain);
 
-  m_directory = dir;
-  m_fileType  = type;
-
   return true;
 }
 
@@ -65,10 +66,13 @@ void PSpoolDirectory::Close()
 
   if (m_thread != NULL) {
     m_threadRunning = false;
+    m_wakeUp.Signal();
     m_thread->WaitForTermination();
     delete m_thread;
     m_thread = NULL;
   }
+
+  m_watcher.Close();
 }
 
 
@@ -85,6 +89,17 @@ void PSpoolDirectory::SetNotifier(const PNotifier & func)
 }
 
 
+void PSpoolDirectory::OnDirectoryChanged(PDirectoryWatcher &, const PDirectoryWatcher::Event & event)
+{
+  // Our own lock files coming and going must not cause another scan
+  if (event.m_path.Right(GetLockExtension().GetLength()) == GetLockExtension())
+    return;
+
+  PTRACE(4, "PSpoolDirectory\tChange to " << event.m_path << " (" << event.m_changes << ')');
+  m_wakeUp.Signal();
+}
+
+
 void PSpoolDirectory::ThreadMain()
 {
   PTRACE(3, "PSpoolDirectory\tThread started " << m_threadRunning);
@@ -99,14 +114,19 @@ void PSpoolDirectory::ThreadMain()
     // attempt to open the directory
     if (!m_scanner.Open()) {
       PTRACE(3, "PSpoolDirectory\tUnable to open directory '" << m_scanner << "' - sleeping for " << m_timeoutIfNoDir << " ms");
-      PThread::Sleep(m_timeoutIfNoDir);
+      m_wakeUp.Wait(m_timeoutIfNoDir);
     }
     else {
+      // Directory may not have existed when opened
+      if (PDirectoryWatcher::IsNative() && !m_watcher.IsWatched(m_scanner) && !m_watcher.Add(m_scanner)) {
+        PTRACE(2, "PSpoolDirectory\tUnable to watch directory '" << m_scanner << "', scanning every " << m_scanTimeout << " ms");
+      }
+
       do {
         ProcessEntry();
       } while (m_scanner.Next());
       PTRACE(3, "PSpoolDirectory\tFinished scan - sleeping for " << m_scanTimeout << " ms");
-      PThread::Sleep(m_scanTimeout);
+      m_wakeUp.Wait(m_scanTimeout);
     }
   }
 
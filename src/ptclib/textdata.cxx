@@ -30,6 +30,53 @@
 #include <ptclib/textdata.h>
 
 
+// Fields are delimited by finding the next of a few special characters, with
+// SSE2 that is done sixteen bytes at a time.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define P_TEXTDATA_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define P_TEXTDATA_SSE2 0
+#endif
+
+static const PINDEX ReadBlockSize = 1024*1024;
+static const PINDEX WriteBlockSize = 65536;
+
+
+static const char * FindAnyOf(const char * ptr, const char * end, char c1, char c2, char c3, char c4)
+{
+#if P_TEXTDATA_SSE2
+  __m128i m1 = _mm_set1_epi8(c1);
+  __m128i m2 = _mm_set1_epi8(c2);
+  __m128i m3 = _mm_set1_epi8(c3);
+  __m128i m4 = _mm_set1_epi8(c4);
+  while (end - ptr >= 16) {
+    __m128i data = _mm_loadu_si128((const __m128i *)ptr);
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(data, m1), _mm_cmpeq_epi8(data, m2)),
+                                                   _mm_or_si128(_mm_cmpeq_epi8(data, m3), _mm_cmpeq_epi8(data, m4))));
+    if (mask != 0) {
+#ifdef _MSC_VER
+      unsigned long bit;
+      _BitScanForward(&bit, mask);
+      return ptr + bit;
+#else
+      return ptr + __builtin_ctz(mask);
+#endif
+    }
+    ptr += 16;
+  }
+#endif
+
+  for (; ptr < end; ++ptr) {
+    char c = *ptr;
+    if (c == c1 || c == c2 || c == c3 || c == c4)
+      break;
+  }
+  return ptr;
+}
+
+
 PTextDataFormat::PTextDataFormat()
 {
 }
@@ -105,6 +152,51 @@ bool PTextDataFormat::ReadRecord(PChannel & channel, PVarData::Record & data)
 }
 
 
+int PTextDataFormat::ScanField(const char * &, const char *, std::string *, bool &)
+{
+  PAssertAlways(PUnimplementedFunction);
+  return -1;
+}
+
+
+bool PTextDataFormat::FormatField(ostream &, const PVarType &, bool)
+{
+  PAssertAlways(PUnimplementedFunction);
+  return false;
+}
+
+
+bool PTextDataFormat::FormatHeadings(ostream & strm)
+{
+  if (!PAssert(!m_headings.IsEmpty(), PInvalidParameter))
+    return false;
+
+  PINDEX last = m_headings.GetSize() - 1;
+  for (PINDEX i = 0; i <= last; ++i) {
+    if (!FormatField(strm, m_headings[i], i == last))
+      return false;
+  }
+
+  return true;
+}
+
+
+bool PTextDataFormat::FormatRecord(ostream & strm, const PVarData::Record & data)
+{
+  if (!PAssert(!m_headings.IsEmpty(), PInvalidParameter))
+    return false;
+
+  PINDEX last = m_headings.GetSize() - 1;
+  for (PINDEX i = 0; i <= last; ++i) {
+    PVarType * field = data.GetAt((m_headings[i]));
+    if (!FormatField(strm, field != NULL ? *field : PVarType(), i == last))
+      return false;
+  }
+
+  return true;
+}
+
+
 bool PTextDataFormat::WriteRecord(PChannel & channel, const PVarData::Record & data)
 {
   if (!PAssert(!m_headings.IsEmpty(), PInvalidParameter))
@@ -180,10 +272,70 @@ int PCommaSeparatedVariableFormat::ReadField(PChannel & channel, PVarType & fiel
 
 
 bool PCommaSeparatedVariableFormat::WriteField(PChannel & channel, const PVarType & field, bool endOfLine)
+{
+  if (!FormatField(channel, field, endOfLine))
+    return false;
+  if (endOfLine)
+    channel.flush();
+  return channel.good();
+}
+
+
+int PCommaSeparatedVariableFormat::ScanField(const char * & ptr, const char * end, std::string * text, bool & quoted)
+{
+  // Same rules as ReadField(), blanks are only skipped at the start, and quotes may start and end anywhere
+  const char * pos = ptr;
+  while (pos < end && isblank(*pos))
+    ++pos;
+
+  bool inQuote = false;
+  for (;;) {
+    if (inQuote) {
+      const char * found = FindAnyOf(pos, end, '"', '\\', '"', '\\');
+      if (found == end)
+        return -1;
+
+      if (text != NULL)
+        text->append(pos, found);
+
+      if (*found == '"') {
+        inQuote = false;
+        pos = found + 1;
+      }
+      else {
+        if (found + 1 >= end)
+          return -1;
+        if (text != NULL)
+          text->push_back(found[1]);
+        pos = found + 2;
+      }
+    }
+    else {
+      const char * found = FindAnyOf(pos, end, ',', '\r', '\n', '"');
+      if (found == end)
+        return -1;
+
+      if (text != NULL)
+        text->append(pos, found);
+
+      if (*found == '"') {
+        inQuote = quoted = true;
+        pos = found + 1;
+      }
+      else {
+        ptr = found + 1;
+        return *found == ',' ? 0 : 1;
+      }
+    }
+  }
+}
+
+
+bool PCommaSeparatedVariableFormat::FormatField(ostream & strm, const PVarType & field, bool endOfLine)
 {
   switch (field.GetType()) {
     default:
-      channel << field;
+      strm << field;
       break;
     case PVarType::VarStaticString:
     case PVarType::VarDynamicString:
@@ -191,15 +343,12 @@ bool PCommaSeparatedVariableFormat::WriteField(PChannel & channel, const PVarTyp
     case PVarType::VarDynamicBinary :
       PString str = field.AsString();
       if (!str.IsEmpty() && (str.FindOneOf(",\r\n") != P_MAX_INDEX || isspace(str[0]) || isspace(str[str.GetLength()-1])))
-        channel << str.ToLiteral();
+        strm << str.ToLiteral();
       else
-        channel << str;
+        strm << str;
   }
-  if (endOfLine)
-    channel << endl;
-  else
-    channel << ',';
-  return channel.good();
+  strm << (endOfLine ? '\n' : ',');
+  return strm.good();
 }
 
 
@@ -233,19 +382,42 @@ int PTabDelimitedFormat::ReadField(PChannel & channel, PVarType & field, bool au
 
 bool PTabDelimitedFormat::WriteField(PChannel & channel, const PVarType & field, bool endOfLine)
 {
-  channel << field;
+  if (!FormatField(channel, field, endOfLine))
+    return false;
   if (endOfLine)
-    channel << endl;
-  else
-    channel << '\t';
+    channel.flush();
   return channel.good();
 }
 
 
+int PTabDelimitedFormat::ScanField(const char * & ptr, const char * end, std::string * text, bool &)
+{
+  const char * found = FindAnyOf(ptr, end, '\t', '\r', '\n', '\t');
+  if (found == end)
+    return -1;
+
+  if (text != NULL)
+    text->append(ptr, found);
+
+  ptr = found + 1;
+  return *found == '\t' ? 0 : 1;
+}
+
+
+bool PTabDelimitedFormat::FormatField(ostream & strm, const PVarType & field, bool endOfLine)
+{
+  strm << field << (endOfLine ? '\n' : '\t');
+  return strm.good();
+}
+
+
 PTextDataFile::PTextDataFile(PTextDataFormatPtr format)
   : m_format(format)
   , m_formatting(false)
   , m_needToWriteHeadings(true)
+  , m_readPos(0)
+  , m_readEnd(0)
+  , m_readEOF(false)
 {
 }
 
@@ -253,11 +425,38 @@ PTextDataFile::PTextDataFile(PTextDataFormatPtr format)
 PTextDataFile::PTextDataFile(const PFilePath & name, OpenMode mode, OpenOptions opts, PTextDataFormatPtr format)
   : m_format(format)
   , m_formatting(false)
+  , m_needToWriteHeadings(true)
+  , m_readPos(0)
+  , m_readEnd(0)
+  , m_readEOF(false)
 {
   Open(name, mode, opts);
 }
 
 
+PTextDataFile::~PTextDataFile()
+{
+  Close();
+}
+
+
+PBoolean PTextDataFile::Close()
+{
+  if (!IsOpen())
+    return false;
+
+  // Write() only works while formatting, so allow the buffer to be flushed
+  {
+    PWaitAndSignal lock(m_writeMutex);
+    m_formatting = true;
+    flush();
+    m_formatting = false;
+  }
+
+  return PTextFile::Close();
+}
+
+
 bool PTextDataFile::SetFormat(const PTextDataFormatPtr & format)
 {
   if (IsOpen() || format.IsNULL())
@@ -275,6 +474,9 @@ bool PTextDataFile::ReadRecord(PVarData::Record & data)
 
   data.RemoveAll();
 
+  if (m_format->SupportsBlocks())
+    return ReadBufferedRecord(data);
+
   m_formatting = true;
   bool ok = m_format->ReadRecord(*this, data);
   m_formatting = false;
@@ -290,14 +492,19 @@ bool PTextDataFile::WriteRecord(const PVarData::Record & data)
   PWaitAndSignal lock(m_writeMutex);
 
   m_formatting = true;
+
+  bool ok = true;
   if (m_needToWriteHeadings) {
     if (m_format->GetHeadings().IsEmpty())
       m_format->SetHeadings(data.GetKeys());
-    if (!m_format->WriteHeadings(*this))
-      return false;
-    m_needToWriteHeadings = false;
+    ok = m_format->SupportsBlocks() ? m_format->FormatHeadings(*this) : m_format->WriteHeadings(*this);
+    m_needToWriteHeadings = !ok;
   }
-  bool ok = m_format->WriteRecord(*this, data);
+
+  // Buffered records are written when the buffer is full, or on Close()
+  if (ok)
+    ok = m_format->SupportsBlocks() ? m_format->FormatRecord(*this, data) : m_format->WriteRecord(*this, data);
+
   m_formatting = false;
   return ok;
 }
@@ -308,6 +515,9 @@ bool PTextDataFile::ReadObject(PVarData::Object & obj)
   if (CheckNotOpen())
     return false;
 
+  if (m_format->SupportsBlocks())
+    return ReadBufferedRecord(obj.GetMemberValues());
+
   m_formatting = true;
   bool ok = m_format->ReadRecord(*this, obj.GetMemberValues());
   m_formatting = false;
@@ -323,18 +533,269 @@ bool PTextDataFile::WriteObject(const PVarData::Object & obj)
   PWaitAndSignal lock(m_writeMutex);
 
   m_formatting = true;
+
+  bool ok = true;
   if (m_needToWriteHeadings) {
     m_format->SetHeadings(obj.GetMemberNames());
-    if (!m_format->WriteHeadings(*this))
-      return false;
-    m_needToWriteHeadings = false;
+    ok = m_format->SupportsBlocks() ? m_format->FormatHeadings(*this) : m_format->WriteHeadings(*this);
+    m_needToWriteHeadings = !ok;
   }
-  bool ok = m_format->WriteRecord(*this, obj.GetMemberValues());
+
+  if (ok)
+    ok = m_format->SupportsBlocks() ? m_format->FormatRecord(*this, obj.GetMemberValues())
+                                    : m_format->WriteRecord(*this, obj.GetMemberValues());
+
   m_formatting = false;
   return ok;
 }
 
 
+bool PTextDataFile::SetColumns(const Columns & columns)
+{
+  if (CheckNotOpen())
+    return false;
+
+  const PStringArray & headings = m_format->GetHeadings();
+  std::vector<int> columnMap(headings.GetSize(), -1);
+  for (size_t i = 0; i < columns.size(); ++i) {
+    PINDEX index = headings.GetValuesIndex(columns[i].m_heading);
+    if (index == P_MAX_INDEX) {
+      PTRACE(2, "TextData", "No column \"" << columns[i].m_heading << "\" in " << GetFilePath());
+      return false;
+    }
+    columnMap[index] = (int)i;
+  }
+
+  m_columns = columns;
+  m_columnMap = columnMap;
+  return true;
+}
+
+
+// Convert directly to the type, without going through PString where possible
+static void SetColumnValue(PVarType & value, PVarType::BasicType type, const char * text)
+{
+  switch (type) {
+    case PVarType::VarBoolean :
+      value = *text != '\0' && strchr("TtYy1", *text) != NULL;
+      break;
+    case PVarType::VarInt16 :
+      value = (int16_t)strtol(text, NULL, 10);
+      break;
+    case PVarType::VarInt32 :
+      value = (int32_t)strtol(text, NULL, 10);
+      break;
+    case PVarType::VarInt64 :
+      value = (int64_t)strtoll(text, NULL, 10);
+      break;
+    case PVarType::VarUInt8 :
+      value = (uint8_t)strtoul(text, NULL, 10);
+      break;
+    case PVarType::VarUInt16 :
+      value = (uint16_t)strtoul(text, NULL, 10);
+      break;
+    case PVarType::VarUInt32 :
+      value = (uint32_t)strtoul(text, NULL, 10);
+      break;
+    case PVarType::VarUInt64 :
+      value = (uint64_t)strtoull(text, NULL, 10);
+      break;
+    case PVarType::VarFloatSingle :
+      value = (float)strtod(text, NULL);
+      break;
+    case PVarType::VarFloatDouble :
+      value = strtod(text, NULL);
+      break;
+    case PVarType::VarDynamicString :
+      // Re-uses the existing memory if big enough
+      value.SetDynamicString(text);
+      break;
+    default :
+      if (value.GetType() != type)
+        value.SetType(type);
+      value.SetValue(text);
+  }
+}
+
+
+bool PTextDataFile::ReadColumns(std::vector<PVarType> & values)
+{
+  if (CheckNotOpen())
+    return false;
+
+  if (!PAssert(!m_columns.empty(), "No columns set"))
+    return false;
+
+  values.resize(m_columns.size());
+
+  if (!m_format->SupportsBlocks()) {
+    PVarData::Record data;
+    if (!ReadRecord(data))
+      return false;
+    for (size_t i = 0; i < m_columns.size(); ++i) {
+      PVarType * field = data.GetAt(m_columns[i].m_heading);
+      SetColumnValue(values[i], m_columns[i].m_type, field != NULL ? (const char *)field->AsString() : "");
+    }
+    return true;
+  }
+
+  if (!SkipLineEnds())
+    return false;
+
+  std::vector<bool> found(m_columns.size());
+  bool quoted;
+  int result;
+  size_t index = 0;
+  do {
+    int column = index < m_columnMap.size() ? m_columnMap[index] : -1;
+    result = ScanField(column >= 0 ? &m_fieldText : NULL, quoted);
+    if (result < 0)
+      return false;
+    if (column >= 0) {
+      SetColumnValue(values[column], m_columns[column].m_type, m_fieldText.c_str());
+      found[column] = true;
+    }
+    ++index;
+  } while (result == 0);
+
+  for (size_t i = 0; i < m_columns.size(); ++i) {
+    if (!found[i])
+      SetColumnValue(values[i], m_columns[i].m_type, "");
+  }
+
+  return true;
+}
+
+
+bool PTextDataFile::ReadBufferedHeadings()
+{
+  if (!SkipLineEnds())
+    return false;
+
+  PStringArray headings;
+  bool quoted;
+  int result;
+  do {
+    result = ScanField(&m_fieldText, quoted);
+    if (result < 0 || m_fieldText.empty())
+      return false;
+    headings.AppendString(m_fieldText.c_str());
+  } while (result == 0);
+
+  m_format->SetHeadings(headings);
+  return true;
+}
+
+
+bool PTextDataFile::ReadBufferedRecord(PVarData::Record & data)
+{
+  // Same semantics as PTextDataFormat::ReadRecord(), except blank lines are skipped
+  if (!SkipLineEnds())
+    return false;
+
+  const PStringArray & headings = m_format->GetHeadings();
+  bool quoted;
+  int result;
+  PINDEX index = 0;
+  do {
+    if (index >= headings.GetSize())
+      result = ScanField(NULL, quoted);
+    else {
+      result = ScanField(&m_fieldText, quoted);
+      if (result < 0)
+        break;
+
+      PString value(m_fieldText.c_str(), m_fieldText.length());
+      PVarType * field = data.GetAt(headings[index]);
+      if (field != NULL)
+        field->FromString(value, false);
+      else {
+        field = new PVarType;
+        if (quoted)
+          field->SetDynamicString(value);
+        else
+          field->FromString(value, true);
+        data.SetAt(headings[index], field);
+      }
+    }
+    ++index;
+  } while (result == 0);
+
+  return result > 0;
+}
+
+
+int PTextDataFile::ScanField(std::string * text, bool & quoted)
+{
+  for (;;) {
+    const char * start = (const char *)m_readBuffer + m_readPos;
+    const char * ptr = start;
+    if (text != NULL)
+      text->clear();
+    quoted = false;
+
+    int result = m_format->ScanField(ptr, (const char *)m_readBuffer + m_readEnd, text, quoted);
+    if (result >= 0) {
+      m_readPos += ptr - start;
+      return result;
+    }
+
+    // Field incomplete, get more and scan it again
+    if (!FillReadBuffer())
+      return -1;
+  }
+}
+
+
+bool PTextDataFile::SkipLineEnds()
+{
+  for (;;) {
+    while (m_readPos < m_readEnd) {
+      char c = m_readBuffer[m_readPos];
+      if (c != '\r' && c != '\n')
+        return true;
+      ++m_readPos;
+    }
+
+    if (!FillReadBuffer())
+      return false;
+  }
+}
+
+
+bool PTextDataFile::FillReadBuffer()
+{
+  if (m_readEOF)
+    return false;
+
+  // Keep what is left, the start of an incomplete field, growing if a field is enormous
+  PINDEX remaining = m_readEnd - m_readPos;
+  if (m_readBuffer.GetSize() < ReadBlockSize)
+    m_readBuffer.SetSize(ReadBlockSize + 1);
+  else if (remaining > m_readBuffer.GetSize()/2)
+    m_readBuffer.SetSize(m_readBuffer.GetSize()*2);
+
+  char * buffer = m_readBuffer.GetPointer();
+  memmove(buffer, buffer + m_readPos, remaining);
+  m_readPos = 0;
+  m_readEnd = remaining;
+
+  // One byte is always kept spare for the line end below
+  if (PTextFile::Read(buffer + m_readEnd, m_readBuffer.GetSize() - m_readEnd - 1) && GetLastReadCount() > 0) {
+    m_readEnd += GetLastReadCount();
+    return true;
+  }
+
+  // Make sure the last record is terminated
+  m_readEOF = true;
+  if (m_readEnd == 0 || buffer[m_readEnd-1] == '\n' || buffer[m_readEnd-1] == '\r')
+    return false;
+
+  buffer[m_readEnd++] = '\n';
+  return true;
+}
+
+
 bool PTextDataFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions)
 {
   if (!PAssert(mode != ReadWrite, PInvalidParameter))
@@ -352,8 +813,15 @@ bool PTextDataFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Per
   if (!PTextFile::InternalOpen(mode, opts, permissions))
     return false;
 
+  m_readPos = m_readEnd = 0;
+  m_readEOF = false;
+  m_columns.clear();
+  m_columnMap.clear();
+
   if (mode == WriteOnly) {
     m_needToWriteHeadings = true;
+    if (m_format->SupportsBlocks())
+      SetBufferSize(WriteBlockSize);
     return true;
   }
 
@@ -393,7 +861,7 @@ bool PTextDataFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Per
     ok = !m_format->GetHeadings().IsEmpty();
 
   if (!ok)
-    ok = m_format->ReadHeadings(*this);
+    ok = m_format->SupportsBlocks() ? ReadBufferedHeadings() : m_format->ReadHeadings(*this);
 
   m_formatting = false;
   return ok;
@@ -38,6 +38,21 @@
 #define new PNEW
 
 
+PThreadPoolBase::Metrics::Metrics()
+  : m_queued("ptlib_threadpool_queued", "Work units queued in all PQueuedThreadPool instances")
+  , m_work("ptlib_threadpool_work_total", "Work units completed by all PQueuedThreadPool instances")
+  , m_latency("ptlib_threadpool_queue_latency_seconds", "Time work units waited in a PQueuedThreadPool queue")
+{
+}
+
+
+PThreadPoolBase::Metrics & PThreadPoolBase::GetMetrics()
+{
+  static Metrics s_metrics;
+  return s_metrics;
+}
+
+
 PThreadPoolBase::PThreadPoolBase(unsigned int maxWorkerCount,
                                  unsigned int maxWorkUnitCount,
                                  const char * threadName,
@@ -405,30 +405,49 @@ void PURL::OutputVars(ostream & strm,
 
 
 PCaselessString PURL::ExtractScheme(const char * cstr)
+{
+  return ExtractScheme(PStringView(cstr));
+}
+
+
+PCaselessString PURL::ExtractScheme(const PStringView & str)
 {
   // Character set as per RFC2396
   //    scheme        = alpha *( alpha | digit | "+" | "-" | "." )
-  if (cstr == NULL)
-    return PString::Empty();
-
-  while (((*cstr & 0x80) == 0x00) && isspace(*cstr))
-    ++cstr;
+  PINDEX start = 0;
+  while (((str[start] & 0x80) == 0x00) && isspace(str[start]))
+    ++start;
 
-  if (!isalpha(*cstr))
+  if (!isalpha(str[start]))
     return PString::Empty();
 
-  const char * ptr = cstr+1;
-  while (isalnum(*ptr) || *ptr == '+' || *ptr == '-' || *ptr == '.')
-    ++ptr;
+  PINDEX end = start+1;
+  while (isalnum(str[end]) || str[end] == '+' || str[end] == '-' || str[end] == '.')
+    ++end;
 
-  if (*ptr != ':')
+  if (str[end] != ':')
     return PString::Empty();
 
-  return PString(cstr, ptr-cstr);
+  return str(start, end-1).AsString();
 }
 
 
 PBoolean PURL::InternalParse(const char * cstr, const char * defaultScheme)
+{
+  // What is left of a C string is still NUL terminated, for the scheme
+  PStringView str = ParseScheme(PStringView(cstr), defaultScheme);
+  return m_schemeInfo != NULL && m_schemeInfo->Parse(str.GetPointer(), *this) && !IsEmpty();
+}
+
+
+PBoolean PURL::Parse(const PStringView & str, const char * defaultScheme)
+{
+  PStringView rest = ParseScheme(str, defaultScheme);
+  return m_schemeInfo != NULL && m_schemeInfo->Parse(rest, *this) && !IsEmpty();
+}
+
+
+PStringView PURL::ParseScheme(const PStringView & str, const char * defaultScheme)
 {
   m_scheme.MakeEmpty();
   m_username.MakeEmpty();
@@ -447,23 +466,21 @@ PBoolean PURL::InternalParse(const char * cstr, const char * defaultScheme)
   // particular scheme
   m_schemeInfo = NULL;
 
-  if (cstr == NULL)
-    return false;
-
-  // copy the string so we can take bits off it
-  while (((*cstr & 0x80) == 0x00) && isspace(*cstr))
-    cstr++;
+  PINDEX start = 0;
+  while (((str[start] & 0x80) == 0x00) && isspace(str[start]))
+    start++;
 
   // if string is empty, return
-  if (*cstr == '\0')
-    return false;
+  PStringView rest = str.Mid(start);
+  if (rest.IsEmpty())
+    return rest;
 
-  m_scheme = ExtractScheme(cstr);
+  m_scheme = ExtractScheme(rest);
   if (!m_scheme.IsEmpty()) {
     // get the scheme information
     m_schemeInfo = PURLSchemeFactory::CreateInstance(m_scheme);
     if (m_schemeInfo != NULL)
-      cstr = strchr(cstr, ':')+1;
+      rest = rest.Mid(m_scheme.GetLength()+1);
   }
 
   // if we could not match a scheme, then use the specified default scheme
@@ -473,18 +490,19 @@ PBoolean PURL::InternalParse(const char * cstr, const char * defaultScheme)
     PAssert(m_schemeInfo != NULL, "Default scheme " + m_scheme + " not available");
   }
 
-  // if that still fails, then there is nowehere to go
-  if (m_schemeInfo == NULL)
-    return false;
-
-  // Now parse using the the scheme info.
-  return m_schemeInfo->Parse(cstr, *this) && !IsEmpty();
+  // What is left is parsed by the scheme, if we found one
+  return rest;
 }
 
 
 bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
 {
-  const PConstCaselessString str(cstr);
+  return LegacyParse(PStringView(cstr), schemeInfo);
+}
+
+
+bool PURL::LegacyParse(const PStringView & str, const PURLLegacyScheme & schemeInfo)
+{
   PINDEX start = 0;
   PINDEX end = P_MAX_INDEX;
   PINDEX pos;
@@ -499,15 +517,17 @@ bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
 
   // parse user/password/host/port
   if (!m_relativePath && schemeInfo.hasHostPort) {
-    PString endHostChars;
+    char endHostBuffer[4];
+    PINDEX endHostCount = 0;
     if (schemeInfo.hasPath)
-      endHostChars += '/';
+      endHostBuffer[endHostCount++] = '/';
     if (schemeInfo.hasQuery)
-      endHostChars += '?';
+      endHostBuffer[endHostCount++] = '?';
     if (schemeInfo.hasParameters)
-      endHostChars += ';';
+      endHostBuffer[endHostCount++] = ';';
     if (schemeInfo.hasFragments)
-      endHostChars += '#';
+      endHostBuffer[endHostCount++] = '#';
+    PStringView endHostChars(endHostBuffer, endHostCount);
 
     if (endHostChars.IsEmpty())
       pos = P_MAX_INDEX;
@@ -523,9 +543,9 @@ bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
     else
       pos = str.FindOneOf(endHostChars, start);
 
-    PString uphp;
+    PStringView uphp;
     if (pos > start) {
-      uphp = str(start, pos - 1);
+      uphp = str.Mid(start, pos - start);
       start = pos;
     }
 
@@ -537,42 +557,42 @@ bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
       if (schemeInfo.hasPassword)
         pos3 = uphp.Find(':');
       if (pos2 == 0)
-        uphp.Delete(0, 1);
+        uphp = uphp.Mid(1);
       else if (pos2 == P_MAX_INDEX) {
         if (schemeInfo.defaultToUserIfNoAt) {
           if (pos3 == P_MAX_INDEX)
-            m_username = UntranslateString(uphp, LoginTranslation);
+            m_username = UntranslateString(uphp.AsString(), LoginTranslation);
           else {
-            m_username = UntranslateString(uphp.Left(pos3), LoginTranslation);
-            m_password = UntranslateString(uphp.Mid(pos3+1), LoginTranslation);
+            m_username = UntranslateString(uphp.Left(pos3).AsString(), LoginTranslation);
+            m_password = UntranslateString(uphp.Mid(pos3+1).AsString(), LoginTranslation);
           }
-          uphp.MakeEmpty();
+          uphp = PStringView();
         }
       }
       else {
         if (pos3 > pos2)
-          m_username = UntranslateString(uphp.Left(pos2), LoginTranslation);
+          m_username = UntranslateString(uphp.Left(pos2).AsString(), LoginTranslation);
         else {
-          m_username = UntranslateString(uphp.Left(pos3), LoginTranslation);
-          m_password = UntranslateString(uphp(pos3+1, pos2-1), LoginTranslation);
+          m_username = UntranslateString(uphp.Left(pos3).AsString(), LoginTranslation);
+          m_password = UntranslateString(uphp(pos3+1, pos2-1).AsString(), LoginTranslation);
         }
-        uphp.Delete(0, pos2+1);
+        uphp = uphp.Mid(pos2+1);
       }
     }
 
     // if the URL does not have a port, then this is the hostname
     if (schemeInfo.defaultPort == 0)
-      m_hostname = UntranslateString(uphp, LoginTranslation);
+      m_hostname = UntranslateString(uphp.AsString(), LoginTranslation);
     else {
       // determine if the URL has a port number
       // Allow for [ipv6] form
       if (uphp[0] == '[' && (pos = uphp.Find(']')) != P_MAX_INDEX) {
-        m_hostname = uphp.Left(pos+1); // No translation if inside []
+        m_hostname = uphp.Left(pos+1).AsString(); // No translation if inside []
         pos = uphp.Find(':', pos);
       }
       else {
         pos = uphp.Find(':');
-        m_hostname = UntranslateString(uphp.Left(pos), LoginTranslation);
+        m_hostname = UntranslateString(uphp.Left(pos).AsString(), LoginTranslation);
       }
 
       if (pos != P_MAX_INDEX) {
@@ -587,19 +607,19 @@ bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
 
   // chop off any trailing query
   if (schemeInfo.hasQuery && (pos = str.Find('?', start)) < end) {
-    SplitQueryVars(str(pos+1, end), m_queryVars);
+    SplitQueryVars(str(pos+1, end).AsString(), m_queryVars);
     end = pos-1;
   }
 
   // chop off any trailing parameters
   if (schemeInfo.hasParameters && (pos = str.Find(';', start)) < end) {
-    SplitVars(str(pos+1, end), m_paramVars);
+    SplitVars(str(pos+1, end).AsString(), m_paramVars);
     end = pos-1;
   }
 
   // chop off any trailing fragment
   if (schemeInfo.hasFragments && (pos = str.Find('#', start)) < end) {
-    m_fragment = UntranslateString(str(pos+1, end), PathTranslation);
+    m_fragment = UntranslateString(str(pos+1, end).AsString(), PathTranslation);
     end = pos-1;
   }
 
@@ -614,11 +634,11 @@ bool PURL::LegacyParse(const char * cstr, const PURLLegacyScheme & schemeInfo)
   if (schemeInfo.hasPath) {
     if (str[start] == '/')
       ++start;
-    SetPathStr(str(start, end));   // the hierarchy is what is left
+    SetPathStr(str(start, end).AsString());   // the hierarchy is what is left
   }
   else {
     // if the rest of the URL isn't a path, then we are finished!
-    m_contents = UntranslateString(str(start, end), PathTranslation);
+    m_contents = UntranslateString(str(start, end).AsString(), PathTranslation);
     Recalculate();
   }
 
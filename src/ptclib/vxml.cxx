@@ -1139,6 +1139,10 @@ bool PVXMLRecordableFilename::OnStart(PVXMLChannel & outgoingChannel)
   if (file == NULL)
     return false;
 
+  PVXMLMediaPump * pump = outgoingChannel.GetSession().GetMediaPump();
+  if (pump != NULL && outgoingChannel.IsPumped())
+    file = pump->CreateAsyncWriter(file);
+
   PTRACE(3, "Recording to file \"" << m_fileName << "\","
          " duration=" << m_maxDuration << ", silence=" << m_finalSilence);
   outgoingChannel.SetWriteChannel(file, true);
@@ -1175,6 +1179,8 @@ static const PConstString KeyFileType(".key");
 
 PVXMLCache::PVXMLCache()
   : m_directory("cache")
+  , m_memoryLimit(64*1024*1024)
+  , m_memoryUsed(0)
 {
 }
 
@@ -1254,6 +1260,11 @@ bool PVXMLCache::StartCache(Params & params)
       }
       else {
         PTRACE(4, "Cache data found for \"" << params.m_key << '"');
+        params.m_date = date;
+        params.m_expires = expires;
+        PXMLElement * etag = root->GetElement("etag");
+        if (etag != NULL)
+          params.m_etag = etag->GetData();
         // Leave locked, if return true, Finish must be called.
         return true;
       }
@@ -1301,6 +1312,8 @@ bool PVXMLCache::FinishCache(Params & params, bool success)
       if (params.m_expires.IsValid())
         root->AddElement("expires")->SetData(params.m_expires.AsString(PTime::LongISO8601));
       root->AddElement("date")->SetData(params.m_date.AsString(PTime::LongISO8601));
+      if (!params.m_etag.IsEmpty())
+        root->AddElement("etag")->SetData(params.m_etag);
 
       if (!xml.SaveFile(keyFilePath)) {
         PTRACE(2, "Cannot write cache key file \"" << keyFilePath << '"');
@@ -1318,6 +1331,329 @@ bool PVXMLCache::FinishCache(Params & params, bool success)
   return success;
 }
 
+
+PVXMLCache::Statistics::Statistics()
+  : m_hits(0)
+  , m_misses(0)
+  , m_evictions(0)
+  , m_coalesced(0)
+  , m_entries(0)
+  , m_bytes(0)
+{
+}
+
+
+ostream & operator<<(ostream & strm, const PVXMLCache::Statistics & stats)
+{
+  return strm << "hits=" << stats.m_hits
+              << " misses=" << stats.m_misses
+              << " evictions=" << stats.m_evictions
+              << " coalesced=" << stats.m_coalesced
+              << " entries=" << stats.m_entries
+              << " bytes=" << stats.m_bytes;
+}
+
+
+void PVXMLCache::SetMemoryLimit(PINDEX bytes)
+{
+  PTRACE(3, "Cache memory limit set to " << bytes);
+
+  PWaitAndSignal lock(m_memoryMutex);
+  m_memoryLimit = bytes;
+
+  while (m_memoryUsed > m_memoryLimit && !m_memoryList.empty()) {
+    MemoryEntry & lru = m_memoryList.back();
+    m_memoryUsed -= lru.m_size;
+    m_memoryIndex.erase(lru.m_key);
+    m_memoryList.pop_back();
+    ++m_statistics.m_evictions;
+  }
+}
+
+
+PVXMLCache::Statistics PVXMLCache::GetStatistics() const
+{
+  PWaitAndSignal lock(m_memoryMutex);
+  Statistics stats = m_statistics;
+  stats.m_entries = m_memoryList.size();
+  stats.m_bytes = m_memoryUsed;
+  return stats;
+}
+
+
+PVXMLCache::MemoryEntry * PVXMLCache::FindMemoryEntry(const PString & key)
+{
+  // Assumes m_memoryMutex is locked
+  MemoryIndex::iterator it = m_memoryIndex.find(key);
+  if (it == m_memoryIndex.end())
+    return NULL;
+
+  // Move to front as most recently used, splice does not invalidate iterators
+  m_memoryList.splice(m_memoryList.begin(), m_memoryList, it->second);
+  return &*it->second;
+}
+
+
+PVXMLCache::MemoryEntry & PVXMLCache::AddMemoryEntry(const PString & key)
+{
+  // Assumes m_memoryMutex is locked
+  MemoryEntry * entry = FindMemoryEntry(key);
+  if (entry != NULL)
+    return *entry;
+
+  m_memoryList.push_front(MemoryEntry(key));
+  m_memoryIndex[key] = m_memoryList.begin();
+  return m_memoryList.front();
+}
+
+
+void PVXMLCache::AdjustMemoryUsage(MemoryEntry & entry, PINDEX newSize)
+{
+  // Assumes m_memoryMutex is locked, and entry is at front of list
+  m_memoryUsed = m_memoryUsed - entry.m_size + newSize;
+  entry.m_size = newSize;
+
+  // Never evict the entry just added, even if it alone is over budget
+  while (m_memoryUsed > m_memoryLimit && m_memoryList.size() > 1) {
+    MemoryEntry & lru = m_memoryList.back();
+    PTRACE(4, "Cache memory evicting \"" << lru.m_key.Left(100) << "\", size=" << lru.m_size);
+    m_memoryUsed -= lru.m_size;
+    m_memoryIndex.erase(lru.m_key);
+    m_memoryList.pop_back();
+    ++m_statistics.m_evictions;
+  }
+}
+
+
+bool PVXMLCache::WaitInFlight(const PString & key)
+{
+  // Assumes m_memoryMutex is locked, returns with it locked, but may unlock in between
+  for (;;) {
+    InFlightMap::iterator it = m_inFlight.find(key);
+    if (it == m_inFlight.end()) {
+      m_inFlight[key] = new InFlight;
+      return true; // Caller is now the fetcher
+    }
+
+    InFlight * inFlight = it->second;
+    ++inFlight->m_waiters;
+    ++m_statistics.m_coalesced;
+    PTRACE(4, "Cache waiting on concurrent fetch of \"" << key.Left(100) << '"');
+    m_memoryMutex.Signal();
+    inFlight->m_done.Wait();
+    m_memoryMutex.Wait();
+
+    bool success = inFlight->m_success;
+    if (--inFlight->m_waiters == 0)
+      delete inFlight;
+
+    if (success)
+      return false; // Other thread fetched it, caller gets result from entry
+
+    // Other thread failed, try and become the fetcher ourselves
+  }
+}
+
+
+void PVXMLCache::EndInFlight(const PString & key, bool success)
+{
+  // Assumes m_memoryMutex is locked
+  InFlightMap::iterator it = m_inFlight.find(key);
+  if (it == m_inFlight.end())
+    return;
+
+  InFlight * inFlight = it->second;
+  m_inFlight.erase(it);
+
+  if (inFlight->m_waiters == 0)
+    delete inFlight;
+  else {
+    // Last waiter to wake deletes it
+    inFlight->m_success = success;
+    for (unsigned i = 0; i < inFlight->m_waiters; ++i)
+      inFlight->m_done.Signal();
+  }
+}
+
+
+bool PVXMLCache::BeginMemoryFetch(const Params & params, PBYTEArray & data)
+{
+  PWaitAndSignal lock(m_memoryMutex);
+
+  if (m_memoryLimit == 0)
+    return false;
+
+  MemoryEntry * entry = FindMemoryEntry(params.m_key);
+  if (entry != NULL && !entry->m_data.IsEmpty()) {
+    PTime now;
+    if (params.m_maxAge >= 0 && entry->m_date.IsValid() && now > entry->m_date + params.m_maxAge) {
+      PTRACE(4, "Cache memory age reached for \"" << params.m_key << '"');
+    }
+    else if (params.m_maxStale >= 0 && entry->m_expires.IsValid() && now > entry->m_expires + params.m_maxStale) {
+      PTRACE(4, "Cache memory stale reached for \"" << params.m_key << '"');
+    }
+    else {
+      ++m_statistics.m_hits;
+      data = entry->m_data;
+      return true;
+    }
+    // Expired, but keep entry so parsed document may be reused if ETag unchanged
+  }
+
+  ++m_statistics.m_misses;
+  for (;;) {
+    if (WaitInFlight(params.m_key))
+      return false;
+
+    // Was fetched by someone else while we waited, unless evicted already
+    entry = FindMemoryEntry(params.m_key);
+    if (entry != NULL && !entry->m_data.IsEmpty()) {
+      data = entry->m_data;
+      return true;
+    }
+  }
+}
+
+
+void PVXMLCache::EndMemoryFetch(const Params & params, const PBYTEArray & data, bool success)
+{
+  PWaitAndSignal lock(m_memoryMutex);
+
+  if (success && !data.IsEmpty() && m_memoryLimit > 0) {
+    MemoryEntry & entry = AddMemoryEntry(params.m_key);
+    if (entry.m_validator != params.m_etag || params.m_etag.IsEmpty()) {
+      entry.m_validator = params.m_etag;
+      entry.m_document = PSharedPtr<PXML>();
+    }
+    entry.m_data = data;
+    entry.m_date = params.m_date;
+    entry.m_expires = params.m_expires;
+    AdjustMemoryUsage(entry, data.GetSize());
+  }
+
+  EndInFlight(params.m_key, success);
+}
+
+
+bool PVXMLCache::LoadDocument(const PString & url, const PString & text, PXML & xml)
+{
+  PSharedPtr<PXML> document;
+  PString key;
+
+  if (m_memoryLimit > 0) {
+    PWaitAndSignal lock(m_memoryMutex);
+
+    MemoryEntry * entry = FindMemoryEntry(url);
+    if (entry != NULL && !entry->m_validator.IsEmpty()) {
+      if (entry->m_document.get() != NULL) {
+        ++m_statistics.m_hits;
+        document = entry->m_document;
+      }
+      else
+        key = url;
+    }
+  }
+
+  if (document.get() == NULL && m_memoryLimit > 0) {
+    if (key.IsEmpty()) {
+      // No ETag, use digest of text
+      PMessageDigest5::Result digest;
+      PMessageDigest5::Encode(text, digest);
+      key = PSTRSTRM("doc_" << hex << digest);
+
+      PWaitAndSignal lock(m_memoryMutex);
+      MemoryEntry * entry = FindMemoryEntry(key);
+      if (entry != NULL && entry->m_document.get() != NULL) {
+        ++m_statistics.m_hits;
+        document = entry->m_document;
+      }
+      else
+        ++m_statistics.m_misses;
+    }
+    else {
+      PWaitAndSignal lock(m_memoryMutex);
+      ++m_statistics.m_misses;
+    }
+  }
+
+  if (document.get() == NULL) {
+    if (!xml.Load(text))
+      return false;
+
+    if (m_memoryLimit > 0 && !key.IsEmpty()) {
+      document.reset(new PXML(xml));
+
+      PWaitAndSignal lock(m_memoryMutex);
+      MemoryEntry & entry = AddMemoryEntry(key);
+      entry.m_document = document;
+      // Parsed tree is typically several times the size of the text
+      AdjustMemoryUsage(entry, entry.m_data.GetSize() + text.GetLength()*4);
+    }
+    return true;
+  }
+
+  // Private, modifiable, copy of the shared tree, no parse required
+  PXMLElement * root = document->GetRootElement();
+  if (root == NULL)
+    return false;
+
+  xml.SetRootElement(new PXMLRootElement(xml, *root));
+  return true;
+}
+
+
+bool PVXMLCache::GetMediaData(const PFilePath & fn, const PString & key, PChannel & decoder, PBYTEArray & data)
+{
+  if (m_memoryLimit == 0)
+    return false;
+
+  PFileInfo info;
+  if (!PFile::GetInfo(fn, info))
+    return false;
+
+  PString validator = PSTRSTRM(info.modified.GetTimestamp() << '/' << info.size);
+  PString memoryKey = PSTRSTRM("pcm_" << key << '_' << fn);
+
+  {
+    PWaitAndSignal lock(m_memoryMutex);
+    MemoryEntry * entry = FindMemoryEntry(memoryKey);
+    if (entry != NULL && entry->m_validator == validator) {
+      ++m_statistics.m_hits;
+      data = entry->m_data;
+      return true;
+    }
+    ++m_statistics.m_misses;
+  }
+
+  // Decode whole file, outside of lock
+  PBYTEArray pcm;
+  PINDEX length = 0;
+  for (;;) {
+    static PINDEX const ChunkSize = 16384;
+    if (!decoder.Read(pcm.GetPointer(length + ChunkSize) + length, ChunkSize))
+      break;
+    length += decoder.GetLastReadCount();
+    if (length > m_memoryLimit/4) {
+      PTRACE(4, "Cache memory not keeping \"" << fn << "\", too large");
+      return false;
+    }
+  }
+
+  if (length == 0)
+    return false;
+
+  pcm.SetSize(length);
+
+  PWaitAndSignal lock(m_memoryMutex);
+  MemoryEntry & entry = AddMemoryEntry(memoryKey);
+  entry.m_validator = validator;
+  entry.m_data = pcm;
+  AdjustMemoryUsage(entry, length);
+  data = pcm;
+  PTRACE(4, "Cache memory keeping " << length << " bytes of decoded \"" << fn << '"');
+  return true;
+}
+
 //////////////////////////////////////////////////////////
 
 PVXMLSession::PVXMLSession()
@@ -1329,6 +1665,13 @@ PVXMLSession::PVXMLSession()
   , m_vxmlThread(NULL)
   , m_closing(false)
   , m_abortVXML(false)
+  , m_mediaPump(NULL)
+  , m_dialogStep(e_DialogIdle)
+  , m_processChildren(false)
+  , m_awaitingEvent(false)
+  , m_pumping(false)
+  , m_dialogQueued(false)
+  , m_dialogThreadId(PNullThreadIdentifier)
   , m_currentNode(NULL)
   , m_speakNodeData(true)
   , m_bargeIn(true)
@@ -1519,6 +1862,7 @@ bool PVXMLSession::LoadActualResource(const PURL & url,
 
   cacheParams.m_date = replyMIME.GetVar(PHTTP::DateTag, PTime());
   cacheParams.m_expires = replyMIME.GetVar(PHTTP::ExpiresTag, PTime(0));
+  cacheParams.m_etag = replyMIME.GetString("ETag");
   PStringOptions cacheControl(replyMIME.GetString("Cache-Control"));
   if (!cacheControl.empty()) {
     static PConstCaselessString const nocache("no-cache");
@@ -1575,15 +1919,25 @@ bool PVXMLSession::LoadCachedResource(const PURL & url,
 
   CachePtr cache = m_resourceCache;
 
-  if (cache == NULL || !cache->StartCache(cacheParams))
+  if (cache == NULL)
     return LoadActualResource(url, timeout, data, cacheParams);
 
-  if (cacheParams.m_size > 0)
-    return cache->FinishCache(cacheParams, cacheParams.m_file.Read(data.GetPointer(cacheParams.m_size), cacheParams.m_size));
+  // Memory tier hit, or another session just fetched it for us
+  if (cache->BeginMemoryFetch(cacheParams, data))
+    return true;
+
+  bool success;
+  if (!cache->StartCache(cacheParams))
+    success = LoadActualResource(url, timeout, data, cacheParams);
+  else if (cacheParams.m_size > 0)
+    success = cache->FinishCache(cacheParams, cacheParams.m_file.Read(data.GetPointer(cacheParams.m_size), cacheParams.m_size));
+  else
+    success = cache->FinishCache(cacheParams,
+                                 LoadActualResource(url, timeout, data, cacheParams) &&
+                                 cacheParams.m_file.Write(data, data.GetSize()));
 
-  return cache->FinishCache(cacheParams,
-                            LoadActualResource(url, timeout, data, cacheParams) &&
-                            cacheParams.m_file.Write(data, data.GetSize()));
+  cache->EndMemoryFetch(cacheParams, data, success);
+  return success;
 }
 
 
@@ -1650,9 +2004,10 @@ bool PVXMLSession::InternalLoadVXML(const PURL & url, const PString & xmlText, c
 
   FlushInput();
 
-  // parse the XML
+  // parse the XML, or get a copy of an already parsed tree from cache
   PAutoPtr<PXML> xml(new PXML);
-  if (!xml->Load(xmlText)) {
+  CachePtr cache = m_resourceCache;
+  if (cache != NULL ? !cache->LoadDocument(url.AsString(), xmlText, *xml) : !xml->Load(xmlText)) {
     m_lastXMLError = PSTRSTRM(url.AsString().Left(100) <<
                               '(' << xml->GetErrorLine() <<
                               ':' << xml->GetErrorColumn() << ")"
@@ -1821,10 +2176,24 @@ bool PVXMLSession::Open(const PString & mediaFormat, unsigned sampleRate, unsign
     return false;
   }
 
+  if (m_mediaPump != NULL) {
+    if (!chan->IsMediaPCM()) {
+      PTRACE(1, "Cannot use media pump with format " << mediaFormat);
+      delete chan;
+      return false;
+    }
+    chan->SetPumped(true);
+  }
+
   // set the underlying channel
   if (!PIndirectChannel::Open(chan, chan))
     return false;
 
+  if (m_mediaPump != NULL && !m_mediaPump->InternalOpen(*this)) {
+    PIndirectChannel::Close();
+    return false;
+  }
+
   PTRACE(4, "VXML Session opened");
   InternalStartThread();
   return true;
@@ -1835,10 +2204,21 @@ void PVXMLSession::InternalStartThread()
 {
   PWaitAndSignal mutex(m_sessionMutex);
 
-  if (IsOpen() && m_promptMode != e_FinalProcessing && m_vxmlThread == NULL && m_newXML.get() != NULL)
-    m_vxmlThread = new PThreadObj<PVXMLSession>(*this, &PVXMLSession::InternalThreadMain, false, "VXML");
-  else
-    Trigger();
+  if (IsOpen() && m_promptMode != e_FinalProcessing && m_newXML.get() != NULL) {
+    if (m_mediaPump != NULL) {
+      if (m_dialogStep == e_DialogIdle) {
+        m_dialogStep = e_DialogStart;
+        m_mediaPump->QueueDialog(*this);
+        return;
+      }
+    }
+    else if (m_vxmlThread == NULL) {
+      m_vxmlThread = new PThreadObj<PVXMLSession>(*this, &PVXMLSession::InternalThreadMain, false, "VXML");
+      return;
+    }
+  }
+
+  Trigger();
 }
 
 
@@ -1852,7 +2232,17 @@ PBoolean PVXMLSession::Close()
   // Indicate closing and throw disconnect exception
   m_closing = true;
   Trigger();
-  PThread::WaitAndDelete(m_vxmlThread, 30000, &m_sessionMutex, false);
+
+  if (m_mediaPump == NULL)
+    PThread::WaitAndDelete(m_vxmlThread, 30000, &m_sessionMutex, false);
+  else {
+    // Dialog will run to the end on a pump worker thread, unless we are it
+    bool running = m_dialogStep != e_DialogIdle && m_dialogStep != e_DialogEnded;
+    m_sessionMutex.Signal();
+    if (running && m_dialogThreadId != PThread::GetCurrentThreadId() && !m_dialogEnded.Wait(30000))
+      PTRACE(2, "Timeout waiting for dialog to end");
+    m_mediaPump->InternalClose(*this);
+  }
 
 #if P_VXML_VIDEO
   m_videoReceiver.Close();
@@ -1911,16 +2301,9 @@ static bool CreateScriptVariable(PScriptLanguage & scriptContext, const PString
 }
 
 
-void PVXMLSession::InternalThreadMain()
+void PVXMLSession::InternalInitialiseDialog()
 {
-  if (m_newXML.get() == NULL) {
-    PTRACE(2, "Execution thread started unexpectedly, exiting.");
-    return;
-  }
-
-  PTRACE(4, "Execution thread started.");
-
-  m_sessionMutex.Wait();
+  // m_sessionMutex already locked
 
   static const char * Languages[] = { "JavaScript", "Lua" };
   PScriptLanguage * newScript = PScriptLanguage::CreateOne(PStringArray(PARRAYSIZE(Languages), Languages));
@@ -1951,6 +2334,21 @@ void PVXMLSession::InternalThreadMain()
   InternalSetVar(SessionScope, "timeEpoch", now.GetTimeInSeconds());
 
   InternalStartVXML();
+}
+
+
+void PVXMLSession::InternalThreadMain()
+{
+  if (m_newXML.get() == NULL) {
+    PTRACE(2, "Execution thread started unexpectedly, exiting.");
+    return;
+  }
+
+  PTRACE(4, "Execution thread started.");
+
+  m_sessionMutex.Wait();
+
+  InternalInitialiseDialog();
 
   while (!m_abortVXML) {
     // process current node in the VXML script
@@ -2008,6 +2406,94 @@ void PVXMLSession::InternalThreadMain()
 }
 
 
+void PVXMLSession::InternalDialogStep()
+{
+  /* This is InternalThreadMain() turned inside out, for a PVXMLMediaPump
+     worker thread. Rather than wait for an event, we return, and the pump
+     calls us again when Trigger() is called. */
+  m_sessionMutex.Wait();
+
+  for (;;) {
+    switch (m_dialogStep) {
+      case e_DialogIdle :
+      case e_DialogEnded :
+        m_sessionMutex.Signal();
+        return;
+
+      case e_DialogStart :
+        if (m_newXML.get() == NULL) {
+          PTRACE(2, "Dialog started unexpectedly.");
+          m_dialogStep = e_DialogIdle;
+          break;
+        }
+
+        PTRACE(4, "Dialog started.");
+        InternalInitialiseDialog();
+        m_dialogStep = e_DialogNode;
+        break;
+
+      case e_DialogNode :
+        if (m_abortVXML) {
+          m_dialogStep = e_DialogEnded;
+          m_sessionMutex.Signal();
+          OnEndSession();
+          PTRACE(4, "Dialog ended");
+          m_dialogEnded.Signal();
+          return;
+        }
+
+        m_processChildren = ProcessNode();
+        m_dialogStep = e_DialogEvents;
+        break;
+
+      case e_DialogEvents :
+        if (InternalPollEvents()) {
+          m_sessionMutex.Signal();
+          return;
+        }
+
+        if (NextNode(m_processChildren))
+          break;
+
+        if (m_closing) {
+          if (m_currentNode == NULL)
+            InternalPollEvents();
+        }
+        else if (m_newXML.get() != NULL)
+          InternalStartVXML();
+
+        if (m_currentNode != NULL) {
+          m_dialogStep = e_DialogNode;
+          break;
+        }
+
+        PTRACE(3, "End of VoiceXML elements.");
+        m_dialogStep = e_DialogEndEvents;
+
+        m_sessionMutex.Signal();
+        OnEndDialog();
+        m_sessionMutex.Wait();
+        break;
+
+      case e_DialogEndEvents :
+        if (InternalPollEvents()) {
+          m_sessionMutex.Signal();
+          return;
+        }
+
+        if (m_newXML.get() != NULL)
+          InternalStartVXML();
+
+        if (m_currentNode == NULL)
+          m_abortVXML = true;
+
+        m_dialogStep = e_DialogNode;
+        break;
+    }
+  }
+}
+
+
 void PVXMLSession::OnEndDialog()
 {
 }
@@ -2023,6 +2509,42 @@ bool PVXMLSession::ProcessEvents()
 {
   // m_sessionMutex already locked
 
+  if (!InternalIsAwaitingEvent())
+    return false;
+
+  m_sessionMutex.Signal();
+  m_waitForEvent.Wait();
+  m_sessionMutex.Wait();
+
+  return InternalEventOccurred();
+}
+
+
+bool PVXMLSession::InternalPollEvents()
+{
+  // As for "while (ProcessEvents());" but returns true instead of waiting
+
+  for (;;) {
+    if (!m_awaitingEvent) {
+      if (!InternalIsAwaitingEvent())
+        return false;
+      m_awaitingEvent = true;
+    }
+
+    if (!m_waitForEvent.Wait(0))
+      return true;
+
+    m_awaitingEvent = false;
+    if (!InternalEventOccurred())
+      return false;
+  }
+}
+
+
+bool PVXMLSession::InternalIsAwaitingEvent()
+{
+  // m_sessionMutex already locked
+
   if (m_abortVXML || m_promptMode == e_FinalProcessing || m_currentNode == NULL || !IsOpen())
     return false;
 
@@ -2101,9 +2623,13 @@ bool PVXMLSession::ProcessEvents()
     }
   }
 
-  m_sessionMutex.Signal();
-  m_waitForEvent.Wait();
-  m_sessionMutex.Wait();
+  return true;
+}
+
+
+bool PVXMLSession::InternalEventOccurred()
+{
+  // m_sessionMutex already locked
 
   if (m_closing || m_newXML.get() == NULL)
     return true;
@@ -3838,6 +4364,8 @@ void PVXMLSession::Trigger()
 {
   PTRACE(4, "Event triggered");
   m_waitForEvent.Signal();
+  if (m_mediaPump != NULL)
+    m_mediaPump->QueueDialog(*this);
 }
 
 
@@ -4626,6 +5154,7 @@ PVXMLChannel::PVXMLChannel(unsigned frameDelay, PINDEX frameSize)
   , m_vxmlSession(NULL)
   , m_closed(false)
   , m_paused(false)
+  , m_pumped(false)
   , m_totalData(0)
   , m_recordable(NULL)
   , m_currentPlayItem(NULL)
@@ -4753,8 +5282,18 @@ PChannel * PVXMLChannel::OpenMediaFile(const PFilePath & fn, bool recording)
         PTRACE(2, "WAV file has unsupported sample size " << wav->GetSampleSize());
       else if (wav->GetSampleRate() != GetSampleRate())
         PTRACE(2, "WAV file has unsupported sample rate " << wav->GetSampleRate());
-      else
-        return wav;
+      else {
+        // Share decoded audio between sessions via the memory tier of the cache
+        PVXMLSession::CachePtr cache = m_vxmlSession->m_resourceCache;
+        PBYTEArray pcm;
+        if (cache != NULL && cache->GetMediaData(fn, PSTRSTRM(GetAudioFormat() << '_' << GetSampleRate() << '_' << GetChannels()), *wav, pcm)) {
+          delete wav;
+          return new PMemoryFile(pcm);
+        }
+        if (wav->SetPosition(0))
+          return wav;
+        PTRACE(2, "Could not rewind WAV file \"" << wav->GetName() << "\" - " << wav->GetErrorText());
+      }
     }
     delete wav;
     return NULL;
@@ -4934,6 +5473,14 @@ double_break:
 }
 
 
+void PVXMLChannel::Wait(PINDEX count, PTimeInterval & nextTick)
+{
+  // A PVXMLMediaPump does the real time pacing for all of its channels at once
+  if (!m_pumped)
+    PDelayChannel::Wait(count, nextTick);
+}
+
+
 void PVXMLChannel::SetSilence(unsigned msecs)
 {
   PTRACE(3, "Playing silence for " << msecs << "ms");
@@ -5030,6 +5577,405 @@ void PVXMLChannel::FlushQueue()
 }
 
 
+///////////////////////////////////////////////////////////////
+
+/* Buffers recorded audio and hands it to the PVXMLMediaPump writer thread in
+   large blocks. Closing passes the ownership of the real channel to the
+   writer, which deletes it after the last block, so the WAV header etc. is
+   finalised there as well. */
+class PVXMLAsyncWriter : public PChannel
+{
+  PCLASSINFO(PVXMLAsyncWriter, PChannel);
+public:
+  enum { BlockSize = 65536 };
+
+  PVXMLAsyncWriter(PVXMLMediaPump & pump, PChannel * channel)
+    : m_pump(pump)
+    , m_channel(channel)
+    , m_name(channel->GetName())
+    , m_used(0)
+  {
+  }
+
+  ~PVXMLAsyncWriter()
+  {
+    Close();
+  }
+
+  virtual PString GetName() const
+  {
+    return m_name;
+  }
+
+  virtual PBoolean IsOpen() const
+  {
+    return m_channel != NULL;
+  }
+
+  virtual PBoolean Close()
+  {
+    if (m_channel == NULL)
+      return false;
+
+    Flush(true);
+    m_channel = NULL;
+    return true;
+  }
+
+  virtual PBoolean Write(const void * buf, PINDEX len)
+  {
+    SetLastWriteCount(0);
+    if (m_channel == NULL)
+      return SetErrorValues(NotOpen, EBADF, LastWriteError);
+
+    if (m_buffer.GetSize() < m_used + len)
+      m_buffer.SetSize(std::max((PINDEX)BlockSize, m_used + len));
+    memcpy(m_buffer.GetPointer() + m_used, buf, len);
+    m_used += len;
+
+    if (m_used >= BlockSize)
+      Flush(false);
+
+    SetLastWriteCount(len);
+    return true;
+  }
+
+protected:
+  void Flush(bool close)
+  {
+    m_buffer.SetSize(m_used);
+    m_pump.QueueWrite(m_channel, m_buffer, close);
+    m_buffer = PBYTEArray();
+    m_used = 0;
+  }
+
+  PVXMLMediaPump & m_pump;
+  PChannel       * m_channel;
+  PString          m_name;
+  PBYTEArray       m_buffer;
+  PINDEX           m_used;
+};
+
+
+PVXMLMediaPump::Statistics::Statistics()
+  : m_frames(0)
+  , m_lateFrames(0)
+  , m_dialogSteps(0)
+  , m_writtenBytes(0)
+  , m_threads(0)
+{
+}
+
+
+PVXMLMediaPump::PVXMLMediaPump(unsigned frameTime, unsigned pumpThreads, unsigned dialogThreads)
+  : m_dialogAvailable(0, INT_MAX)
+  , m_dialogSteps(0)
+  , m_writerThread(NULL)
+  , m_writtenBytes(0)
+  , m_frameTime(std::max(1U, frameTime))
+  , m_shutdown(false)
+{
+  if (pumpThreads == 0)
+    pumpThreads = PThread::GetNumProcessors();
+  if (dialogThreads == 0)
+    dialogThreads = PThread::GetNumProcessors()*2;
+
+  for (unsigned i = 0; i < pumpThreads; ++i)
+    m_batches.push_back(new Batch);
+
+  for (PINDEX i = 0; i < (PINDEX)m_batches.size(); ++i)
+    m_batches[i]->m_thread = new PThreadObj1Arg<PVXMLMediaPump, PINDEX>(*this, i, &PVXMLMediaPump::PumpMain,
+                                                                        false, "VXMLPump", PThread::HighestPriority);
+
+  for (unsigned i = 0; i < dialogThreads; ++i)
+    m_dialogThreads.push_back(new PThreadObj<PVXMLMediaPump>(*this, &PVXMLMediaPump::DialogMain, false, "VXMLDialog"));
+
+  m_writerThread = new PThreadObj<PVXMLMediaPump>(*this, &PVXMLMediaPump::WriterMain, false, "VXMLWriter");
+
+  PTRACE(3, "Media pump started: frame=" << m_frameTime << "ms, "
+            "pumps=" << pumpThreads << ", dialogs=" << dialogThreads);
+}
+
+
+PVXMLMediaPump::~PVXMLMediaPump()
+{
+  m_shutdown = true;
+
+  for (size_t i = 0; i < m_batches.size(); ++i) {
+    PTRACE_IF(2, m_batches[i]->m_entries.size() > 0, "Media pump destroyed with sessions still attached");
+    PThread::WaitAndDelete(m_batches[i]->m_thread);
+    delete m_batches[i];
+  }
+
+  for (size_t i = 0; i < m_dialogThreads.size(); ++i)
+    m_dialogAvailable.Signal();
+  for (size_t i = 0; i < m_dialogThreads.size(); ++i)
+    PThread::WaitAndDelete(m_dialogThreads[i]);
+
+  // Let the recordings be finished
+  m_writeQueue.Drain(false);
+  PThread::WaitAndDelete(m_writerThread, PMaxTimeInterval);
+
+  PTRACE(3, "Media pump stopped");
+}
+
+
+bool PVXMLMediaPump::Attach(PVXMLSession & session, const FrameNotifier & notifier)
+{
+  if (session.IsOpen()) {
+    PTRACE(2, "Cannot attach open session " << &session << " to media pump");
+    return false;
+  }
+
+  if (session.m_mediaPump != NULL && session.m_mediaPump != this) {
+    PTRACE(2, "Session " << &session << " already attached to another media pump");
+    return false;
+  }
+
+  session.m_mediaPump = this;
+  session.m_pumpNotifier = notifier;
+  return true;
+}
+
+
+PChannel * PVXMLMediaPump::CreateAsyncWriter(PChannel * channel)
+{
+  return channel != NULL ? new PVXMLAsyncWriter(*this, channel) : NULL;
+}
+
+
+PINDEX PVXMLMediaPump::GetSessionCount() const
+{
+  PINDEX count = 0;
+  for (size_t i = 0; i < m_batches.size(); ++i) {
+    PWaitAndSignal lock(m_batches[i]->m_mutex);
+    for (size_t j = 0; j < m_batches[i]->m_entries.size(); ++j) {
+      if (m_batches[i]->m_entries[j].m_session != NULL)
+        ++count;
+    }
+  }
+  return count;
+}
+
+
+void PVXMLMediaPump::GetStatistics(Statistics & stats) const
+{
+  stats = Statistics();
+  for (size_t i = 0; i < m_batches.size(); ++i) {
+    PWaitAndSignal lock(m_batches[i]->m_mutex);
+    stats.m_frames += m_batches[i]->m_frames;
+    stats.m_lateFrames += m_batches[i]->m_lateFrames;
+  }
+  stats.m_dialogSteps = m_dialogSteps;
+  stats.m_writtenBytes = m_writtenBytes;
+  stats.m_threads = m_batches.size() + m_dialogThreads.size() + 1;
+}
+
+
+bool PVXMLMediaPump::InternalOpen(PVXMLSession & session)
+{
+  if (m_shutdown)
+    return false;
+
+  PVXMLChannel * channel = session.GetVXMLChannel();
+  if (channel == NULL)
+    return false;
+
+  PINDEX frameSize = channel->GetSampleRate()*channel->GetChannels()*sizeof(short)*m_frameTime/1000;
+
+  // Put in the batch with the fewest sessions
+  Batch * best = NULL;
+  size_t bestCount = P_MAX_INDEX;
+  for (size_t i = 0; i < m_batches.size(); ++i) {
+    PWaitAndSignal lock(m_batches[i]->m_mutex);
+    if (m_batches[i]->m_entries.size() < bestCount) {
+      best = m_batches[i];
+      bestCount = best->m_entries.size();
+    }
+  }
+
+  m_dialogMutex.Wait();
+  session.m_pumping = true;
+  m_dialogMutex.Signal();
+
+  PWaitAndSignal lock(best->m_mutex);
+  best->m_entries.push_back(Entry(&session, frameSize));
+  PTRACE(4, "Session " << &session << " added to media pump, frame=" << frameSize << " bytes");
+  return true;
+}
+
+
+void PVXMLMediaPump::InternalClose(PVXMLSession & session)
+{
+  /* The entry is only marked, as this may be called from the notifier, in
+     the middle of the pump thread going through the batch. */
+  for (size_t i = 0; i < m_batches.size(); ++i) {
+    PWaitAndSignal lock(m_batches[i]->m_mutex);
+    for (size_t j = 0; j < m_batches[i]->m_entries.size(); ++j) {
+      if (m_batches[i]->m_entries[j].m_session == &session)
+        m_batches[i]->m_entries[j].m_session = NULL;
+    }
+  }
+
+  m_dialogMutex.Wait();
+
+  session.m_pumping = false;
+  if (session.m_dialogQueued) {
+    session.m_dialogQueued = false;
+    m_dialogQueue.remove(&session);
+  }
+
+  // Wait for any dialog step in progress on another thread, it is short
+  while (session.m_dialogThreadId != PNullThreadIdentifier && session.m_dialogThreadId != PThread::GetCurrentThreadId()) {
+    m_dialogMutex.Signal();
+    PThread::Sleep(5);
+    m_dialogMutex.Wait();
+  }
+
+  m_dialogMutex.Signal();
+
+  PTRACE(4, "Session " << &session << " removed from media pump");
+}
+
+
+void PVXMLMediaPump::QueueDialog(PVXMLSession & session)
+{
+  PWaitAndSignal lock(m_dialogMutex);
+
+  if (!session.m_pumping || session.m_dialogQueued)
+    return;
+
+  session.m_dialogQueued = true;
+
+  // If executing, the worker will queue it again when the step finishes
+  if (session.m_dialogThreadId == PNullThreadIdentifier) {
+    m_dialogQueue.push_back(&session);
+    m_dialogAvailable.Signal();
+  }
+}
+
+
+void PVXMLMediaPump::QueueWrite(PChannel * channel, const PBYTEArray & data, bool close)
+{
+  if (!m_writeQueue.Enqueue(WriteItem(channel, data, close))) {
+    PTRACE(2, "Media pump writer closed, discarding " << data.GetSize() << " bytes");
+    if (close)
+      delete channel;
+  }
+}
+
+
+void PVXMLMediaPump::PumpMain(PINDEX index)
+{
+  Batch & batch = *m_batches[index];
+
+  PTRACE(4, "Media pump thread " << index << " started");
+
+  PTimeInterval nextTick = PTimer::Tick();
+  while (!m_shutdown) {
+    batch.m_mutex.Wait();
+
+    // Indexed, as a notifier could add a session
+    bool closed = false;
+    for (size_t i = 0; i < batch.m_entries.size(); ++i) {
+      PVXMLSession * session = batch.m_entries[i].m_session;
+      if (session == NULL)
+        closed = true;
+      else {
+        PBYTEArray & frame = batch.m_entries[i].m_frame;
+        if (session->Read(frame.GetPointer(), frame.GetSize())) {
+          session->m_pumpNotifier(*session, frame);
+          ++batch.m_frames;
+        }
+      }
+    }
+
+    if (closed) {
+      std::vector<Entry>::iterator out = batch.m_entries.begin();
+      for (std::vector<Entry>::iterator it = batch.m_entries.begin(); it != batch.m_entries.end(); ++it) {
+        if (it->m_session != NULL)
+          *out++ = *it;
+      }
+      batch.m_entries.erase(out, batch.m_entries.end());
+    }
+
+    // Absolute schedule, so the time taken by the batch does not accumulate
+    nextTick += m_frameTime;
+    PTimeInterval delay = nextTick - PTimer::Tick();
+    if (delay < 0) {
+      ++batch.m_lateFrames;
+      if (delay < -PTimeInterval(m_frameTime*5)) {
+        PTRACE(3, "Media pump thread " << index << " fell behind by " << -delay << ", resynchronising");
+        nextTick = PTimer::Tick();
+      }
+    }
+
+    batch.m_mutex.Signal();
+
+    if (delay > 0)
+      PThread::Sleep(delay);
+  }
+
+  PTRACE(4, "Media pump thread " << index << " ended");
+}
+
+
+void PVXMLMediaPump::DialogMain()
+{
+  for (;;) {
+    m_dialogAvailable.Wait();
+
+    m_dialogMutex.Wait();
+    if (m_shutdown) {
+      m_dialogMutex.Signal();
+      return;
+    }
+
+    if (m_dialogQueue.empty()) {
+      m_dialogMutex.Signal();
+      continue;
+    }
+
+    PVXMLSession * session = m_dialogQueue.front();
+    m_dialogQueue.pop_front();
+    session->m_dialogQueued = false;
+    session->m_dialogThreadId = PThread::GetCurrentThreadId();
+    m_dialogMutex.Signal();
+
+    session->InternalDialogStep();
+    ++m_dialogSteps;
+
+    m_dialogMutex.Wait();
+    session->m_dialogThreadId = PNullThreadIdentifier;
+    if (session->m_dialogQueued) {
+      // Triggered while executing
+      m_dialogQueue.push_back(session);
+      m_dialogAvailable.Signal();
+    }
+    m_dialogMutex.Signal();
+  }
+}
+
+
+void PVXMLMediaPump::WriterMain()
+{
+  WriteItem item;
+  while (m_writeQueue.Dequeue(item)) {
+    if (!item.m_data.IsEmpty()) {
+      if (item.m_channel->Write(item.m_data, item.m_data.GetSize()))
+        m_writtenBytes += item.m_channel->GetLastWriteCount();
+      else
+        PTRACE(2, "Could not write recording \"" << item.m_channel->GetName() << "\" - " << item.m_channel->GetErrorText(PChannel::LastWriteError));
+    }
+
+    if (item.m_close) {
+      PTRACE(4, "Finished writing recording \"" << item.m_channel->GetName() << '"');
+      delete item.m_channel;
+    }
+  }
+}
+
+
 ///////////////////////////////////////////////////////////////
 
 PFACTORY_CREATE(PFactory<PVXMLChannel>, PVXMLChannelPCM, VXML_PCM16);
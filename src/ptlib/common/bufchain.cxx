@@ -0,0 +1,495 @@
+/*
+ * bufchain.cxx
+ *
+ * Reference counted chain of buffers, for I/O without copying.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifdef __GNUC__
+#pragma implementation "bufchain.h"
+#endif
+
+#include <ptlib.h>
+#include <ptlib/bufchain.h>
+#include <ptlib/metrics.h>
+
+static PMetricCounter s_copiedBytes     ("ptlib_bufchain_copied_bytes_total", "Bytes copied into or out of buffer chains");
+static PMetricCounter s_pooledBlocks    ("ptlib_bufchain_blocks_total",       "Blocks used by buffer chains", "source=\"pool\"");
+static PMetricCounter s_allocatedBlocks ("ptlib_bufchain_blocks_total",       "Blocks used by buffer chains", "source=\"heap\"");
+static PMetricCounter s_referencedArrays("ptlib_bufchain_referenced_arrays_total", "Arrays and strings added to buffer chains without copying");
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+struct PBufferChain::Block
+{
+  Block()
+    : m_references(1)
+    , m_data(new BYTE[BlockSize])
+    , m_size(BlockSize)
+    , m_used(0)
+    , m_pooled(true)
+  { }
+
+  Block(const PBYTEArray & data)
+    : m_references(1)
+    , m_data(const_cast<BYTE *>((const BYTE *)data))
+    , m_size(data.GetSize())
+    , m_used(m_size)
+    , m_pooled(false)
+    , m_array(data)
+  { }
+
+  Block(const PString & str)
+    : m_references(1)
+    , m_data((BYTE *)const_cast<char *>((const char *)str))
+    , m_size(str.GetLength())
+    , m_used(m_size)
+    , m_pooled(false)
+    , m_string(str)
+  { }
+
+  ~Block()
+  {
+    if (m_pooled)
+      delete [] m_data;
+  }
+
+  PINDEX GetFree() const { return m_size - m_used; }
+
+  atomic<unsigned> m_references;
+  BYTE           * m_data;
+  PINDEX           m_size;
+  PINDEX           m_used;
+  bool             m_pooled;
+  PBYTEArray       m_array;
+  PString          m_string;
+};
+
+
+/* Free blocks, taken by GetWritable() etc, and returned when the last chain
+   referencing them lets go. Allocating and freeing a 16k block on every read
+   is what we are trying to avoid. */
+class PBufferChainPool
+{
+  public:
+    ~PBufferChainPool()
+    {
+      for (size_t i = 0; i < m_free.size(); ++i)
+        delete m_free[i];
+    }
+
+    static PBufferChainPool & Get()
+    {
+      static PBufferChainPool pool;
+      return pool;
+    }
+
+    PBufferChain::Block * Take()
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_free.empty())
+        return NULL;
+      PBufferChain::Block * block = m_free.back();
+      m_free.pop_back();
+      return block;
+    }
+
+    bool Give(PBufferChain::Block * block)
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_free.size() >= PBufferChain::MaxPooledBlocks)
+        return false;
+      m_free.push_back(block);
+      return true;
+    }
+
+  protected:
+    PCriticalSection                   m_mutex;
+    std::vector<PBufferChain::Block *> m_free;
+};
+
+
+PBufferChain::Block * PBufferChain::TakeBlock()
+{
+  Block * block = PBufferChainPool::Get().Take();
+  if (block == NULL) {
+    ++s_allocatedBlocks;
+    return new Block;
+  }
+
+  ++s_pooledBlocks;
+  block->m_references = 1;
+  block->m_used = 0;
+  return block;
+}
+
+
+void PBufferChain::ReleaseBlock(Block * block)
+{
+  if (--block->m_references != 0)
+    return;
+
+  if (!block->m_pooled || !PBufferChainPool::Get().Give(block))
+    delete block;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PBufferChain::PBufferChain()
+  : m_length(0)
+{
+}
+
+
+PBufferChain::PBufferChain(const void * data, PINDEX length)
+  : m_length(0)
+{
+  Append(data, length);
+}
+
+
+PBufferChain::PBufferChain(const PBYTEArray & data)
+  : m_length(0)
+{
+  Append(data);
+}
+
+
+PBufferChain::PBufferChain(const PBufferChain & other)
+  : PObject(other)
+  , m_length(0)
+{
+  Append(other);
+}
+
+
+PBufferChain & PBufferChain::operator=(const PBufferChain & other)
+{
+  if (&other != this) {
+    Clear();
+    Append(other);
+  }
+  return *this;
+}
+
+
+PBufferChain::~PBufferChain()
+{
+  Clear();
+  for (size_t i = 0; i < m_spare.size(); ++i)
+    ReleaseBlock(m_spare[i]);
+}
+
+
+void PBufferChain::PrintOn(ostream & strm) const
+{
+  for (std::deque<Segment>::const_iterator it = m_segments.begin(); it != m_segments.end(); ++it)
+    strm.write((const char *)it->m_block->m_data + it->m_offset, it->m_length);
+}
+
+
+const BYTE * PBufferChain::GetSegment(PINDEX index, PINDEX & length) const
+{
+  if (!PAssert(index < (PINDEX)m_segments.size(), PInvalidParameter)) {
+    length = 0;
+    return NULL;
+  }
+
+  const Segment & segment = m_segments[index];
+  length = segment.m_length;
+  return segment.m_block->m_data + segment.m_offset;
+}
+
+
+BYTE PBufferChain::operator[](PINDEX offset) const
+{
+  for (std::deque<Segment>::const_iterator it = m_segments.begin(); it != m_segments.end(); ++it) {
+    if (offset < it->m_length)
+      return it->m_block->m_data[it->m_offset + offset];
+    offset -= it->m_length;
+  }
+
+  PAssertAlways(PInvalidArrayIndex);
+  return 0;
+}
+
+
+PINDEX PBufferChain::CopyTo(void * buffer, PINDEX length, PINDEX offset) const
+{
+  BYTE * ptr = (BYTE *)buffer;
+  PINDEX copied = 0;
+  for (std::deque<Segment>::const_iterator it = m_segments.begin(); it != m_segments.end() && copied < length; ++it) {
+    if (offset >= it->m_length) {
+      offset -= it->m_length;
+      continue;
+    }
+
+    PINDEX count = std::min(it->m_length - offset, length - copied);
+    memcpy(ptr + copied, it->m_block->m_data + it->m_offset + offset, count);
+    copied += count;
+    offset = 0;
+  }
+
+  s_copiedBytes += copied;
+  return copied;
+}
+
+
+PBYTEArray PBufferChain::AsBYTEArray() const
+{
+  if (m_segments.size() == 1) {
+    const Segment & segment = m_segments.front();
+    const PBYTEArray & array = segment.m_block->m_array;
+    if (segment.m_offset == 0 && segment.m_length == array.GetSize() && segment.m_length > 0)
+      return array;
+  }
+
+  PBYTEArray data(m_length);
+  CopyTo(data.GetPointer(), m_length);
+  return data;
+}
+
+
+PString PBufferChain::AsString() const
+{
+  if (m_segments.size() == 1) {
+    const Segment & segment = m_segments.front();
+    const PString & str = segment.m_block->m_string;
+    if (segment.m_offset == 0 && segment.m_length == str.GetLength() && segment.m_length > 0)
+      return str;
+  }
+
+  PString str;
+  CopyTo(str.GetPointerAndSetLength(m_length), m_length);
+  return str;
+}
+
+
+PINDEX PBufferChain::GetSlices(std::vector<PChannel::Slice> & slices, PINDEX offset, PINDEX maxSlices) const
+{
+  PINDEX count = 0;
+  for (std::deque<Segment>::const_iterator it = m_segments.begin(); it != m_segments.end() && count < maxSlices; ++it) {
+    if (offset >= it->m_length) {
+      offset -= it->m_length;
+      continue;
+    }
+
+    slices.push_back(PChannel::Slice(it->m_block->m_data + it->m_offset + offset, it->m_length - offset));
+    offset = 0;
+    ++count;
+  }
+  return count;
+}
+
+
+void PBufferChain::Append(const void * data, PINDEX length)
+{
+  const BYTE * ptr = (const BYTE *)data;
+  while (length > 0) {
+    PINDEX count = length;
+    BYTE * space = GetWritable(count);
+    memcpy(space, ptr, count);
+    Commit(count);
+    s_copiedBytes += count;
+    ptr += count;
+    length -= count;
+  }
+}
+
+
+void PBufferChain::Append(const PBYTEArray & data)
+{
+  if (data.IsEmpty())
+    return;
+
+  AddSegment(new Block(data), 0, data.GetSize());
+  ++s_referencedArrays;
+}
+
+
+void PBufferChain::Append(const PString & str)
+{
+  if (str.IsEmpty())
+    return;
+
+  AddSegment(new Block(str), 0, str.GetLength());
+  ++s_referencedArrays;
+}
+
+
+void PBufferChain::Append(const PBufferChain & chain)
+{
+  // Take a copy of the list first, in case we are appending ourself
+  std::deque<Segment> segments = chain.m_segments;
+  for (std::deque<Segment>::iterator it = segments.begin(); it != segments.end(); ++it) {
+    ++it->m_block->m_references;
+    AddSegment(it->m_block, it->m_offset, it->m_length);
+  }
+}
+
+
+void PBufferChain::AddSegment(Block * block, PINDEX offset, PINDEX length)
+{
+  m_segments.push_back(Segment(block, offset, length));
+  m_length += length;
+}
+
+
+PBufferChain::Block * PBufferChain::GetWritableTail() const
+{
+  if (m_segments.empty())
+    return NULL;
+
+  /* Only if no other chain can see the block, and nothing has been written
+     after our last segment, may the rest of it be written. */
+  const Segment & tail = m_segments.back();
+  Block * block = tail.m_block;
+  if (block->m_pooled && block->m_references == 1 && tail.m_offset + tail.m_length == block->m_used && block->GetFree() > 0)
+    return block;
+
+  return NULL;
+}
+
+
+BYTE * PBufferChain::GetWritable(PINDEX & length)
+{
+  Block * block = GetWritableTail();
+  if (block == NULL) {
+    if (m_spare.empty())
+      m_spare.push_back(TakeBlock());
+    block = m_spare.front();
+  }
+
+  length = std::max((PINDEX)1, std::min(length, block->GetFree()));
+  return block->m_data + block->m_used;
+}
+
+
+PINDEX PBufferChain::GetWritableSlices(PINDEX length, PChannel::Slice * slices, PINDEX maxSlices)
+{
+  PINDEX count = 0;
+  PINDEX total = 0;
+
+  Block * block = GetWritableTail();
+  if (block != NULL && count < maxSlices) {
+    PINDEX size = std::min(length, block->GetFree());
+    slices[count++] = PChannel::Slice(block->m_data + block->m_used, size);
+    total += size;
+  }
+
+  for (size_t i = 0; total < length && count < maxSlices; ++i) {
+    if (i >= m_spare.size())
+      m_spare.push_back(TakeBlock());
+    block = m_spare[i];
+    PINDEX size = std::min(length - total, block->m_size);
+    slices[count++] = PChannel::Slice(block->m_data, size);
+    total += size;
+  }
+
+  return count;
+}
+
+
+void PBufferChain::Commit(PINDEX length)
+{
+  Block * block = GetWritableTail();
+  if (block != NULL && length > 0) {
+    PINDEX count = std::min(length, block->GetFree());
+    block->m_used += count;
+    m_segments.back().m_length += count;
+    m_length += count;
+    length -= count;
+  }
+
+  while (length > 0) {
+    if (!PAssert(!m_spare.empty(), "Committed more than was writable"))
+      return;
+
+    block = m_spare.front();
+    m_spare.erase(m_spare.begin());
+    block->m_used = std::min(length, block->m_size);
+    AddSegment(block, 0, block->m_used);
+    length -= block->m_used;
+  }
+}
+
+
+PBufferChain PBufferChain::Split(PINDEX length)
+{
+  PBufferChain front;
+  while (length > 0 && !m_segments.empty()) {
+    Segment & segment = m_segments.front();
+    if (length < segment.m_length) {
+      ++segment.m_block->m_references;
+      front.AddSegment(segment.m_block, segment.m_offset, length);
+      segment.m_offset += length;
+      segment.m_length -= length;
+      m_length -= length;
+      break;
+    }
+
+    front.AddSegment(segment.m_block, segment.m_offset, segment.m_length);
+    length -= segment.m_length;
+    m_length -= segment.m_length;
+    m_segments.pop_front();
+  }
+  return front;
+}
+
+
+void PBufferChain::Discard(PINDEX length)
+{
+  while (length > 0 && !m_segments.empty()) {
+    Segment & segment = m_segments.front();
+    if (length < segment.m_length) {
+      segment.m_offset += length;
+      segment.m_length -= length;
+      m_length -= length;
+      break;
+    }
+
+    length -= segment.m_length;
+    m_length -= segment.m_length;
+    ReleaseBlock(segment.m_block);
+    m_segments.pop_front();
+  }
+}
+
+
+void PBufferChain::Clear()
+{
+  for (std::deque<Segment>::iterator it = m_segments.begin(); it != m_segments.end(); ++it)
+    ReleaseBlock(it->m_block);
+  m_segments.clear();
+  m_length = 0;
+}
+
+
+void PBufferChain::GetStatistics(Statistics & stats)
+{
+  stats.m_copiedBytes = s_copiedBytes.GetValue();
+  stats.m_pooledBlocks = s_pooledBlocks.GetValue();
+  stats.m_allocatedBlocks = s_allocatedBlocks.GetValue();
+  stats.m_referencedArrays = s_referencedArrays.GetValue();
+}
+
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -56,6 +56,7 @@ extern "C" int vsprintf(char *, const char *, va_list);
 
 
 PDEFINE_POOL_ALLOCATOR(PContainerReference);
+PDEFINE_POOL_ALLOCATOR(PInlineContainerReference);
 
 
 #define new PNEW
@@ -65,6 +66,23 @@ PDEFINE_POOL_ALLOCATOR(PContainerReference);
 
 ///////////////////////////////////////////////////////////////////////////////
 
+static PContainerReference * CloneReference(const PContainerReference & ref)
+{
+  if (ref.inlineStorage)
+    return new PInlineContainerReference(ref);
+  return new PContainerReference(ref);
+}
+
+
+static void DeleteReference(PContainerReference * ref)
+{
+  if (ref != NULL && ref->inlineStorage)
+    delete static_cast<PInlineContainerReference *>(ref);
+  else
+    delete ref;
+}
+
+
 PContainer::PContainer(PINDEX initialSize)
 {
   reference = new PContainerReference(initialSize);
@@ -80,7 +98,7 @@ PContainer::PContainer(int, const PContainer * cont)
   PAssert(cont != NULL, PInvalidParameter);
   PAssert2(cont->reference != NULL, cont->GetClass(), "Clone of deleted container");
 
-  reference = new PContainerReference(*cont->reference);
+  reference = CloneReference(*cont->reference);
   PAssert(reference != NULL, POutOfMemory);
 }
 
@@ -141,7 +159,7 @@ void PContainer::Destruct()
 
 void PContainer::DestroyReference()
 {
-  delete reference;
+  DeleteReference(reference);
   reference = NULL;
 }
 
@@ -165,7 +183,7 @@ PBoolean PContainer::MakeUnique()
     return true;
 
   PContainerReference * oldReference = reference;
-  reference = new PContainerReference(*reference);
+  reference = CloneReference(*reference);
   --oldReference->count;
 
   return false;
@@ -189,21 +207,30 @@ PBoolean PContainer::MakeUnique()
 #endif // PMEMORY_CHECK
 
 
+// Only arrays of bytes, e.g. PString, have storage in the reference for short contents
+static PContainerReference * NewArrayReference(PINDEX elementSize, PINDEX initialSize)
+{
+  if (elementSize == 1)
+    return new PInlineContainerReference(initialSize);
+  return new PContainerReference(initialSize);
+}
+
+
 PAbstractArray::PAbstractArray(PINDEX elementSizeInBytes, PINDEX initialSize)
-  : PContainer(initialSize)
+  : PContainer(*NewArrayReference(elementSizeInBytes, initialSize))
 {
   elementSize = elementSizeInBytes;
   PAssert(elementSize != 0, PInvalidParameter);
 
+  allocatedDynamically = true;
+
   if (GetSize() == 0)
     m_theArray = NULL;
   else {
-    m_theArray = PAbstractArrayAllocate(GetSize() * elementSize);
+    m_theArray = InternalAllocate(*reference, GetSize() * elementSize);
     if (PAssert(m_theArray != NULL, POutOfMemory))
       memset(m_theArray, 0, GetSize() * elementSize);
   }
-
-  allocatedDynamically = true;
 }
 
 
@@ -211,7 +238,7 @@ PAbstractArray::PAbstractArray(PINDEX elementSizeInBytes,
                                const void *buffer,
                                PINDEX bufferSizeInElements,
                                PBoolean dynamicAllocation)
-  : PContainer(bufferSizeInElements)
+  : PContainer(*NewArrayReference(elementSizeInBytes, bufferSizeInElements))
 {
   elementSize = elementSizeInBytes;
   PAssert(elementSize != 0, PInvalidParameter);
@@ -222,7 +249,7 @@ PAbstractArray::PAbstractArray(PINDEX elementSizeInBytes,
     m_theArray = NULL;
   else if (dynamicAllocation) {
     PINDEX sizebytes = elementSize*GetSize();
-    m_theArray = PAbstractArrayAllocate(sizebytes);
+    m_theArray = InternalAllocate(*reference, sizebytes);
     if (PAssert(m_theArray != NULL, POutOfMemory))
       memcpy(m_theArray, PAssertNULL(buffer), sizebytes);
   }
@@ -265,13 +292,25 @@ void PAbstractArray::CloneContents(const PAbstractArray * array)
 {
   elementSize = array->elementSize;
   PINDEX sizebytes = elementSize*GetSize();
-  char * newArray = PAbstractArrayAllocate(sizebytes);
+  char * newArray = InternalAllocate(*reference, sizebytes);
   if (newArray == NULL)
     reference->size = 0;
   else
     memcpy(newArray, array->m_theArray, sizebytes);
   m_theArray = newArray;
+}
+
+
+char * PAbstractArray::InternalAllocate(PContainerReference & ref, PINDEX sizeBytes)
+{
+  // Small enough to live in the reference, saving a heap allocation
+  if (ref.inlineStorage && sizeBytes > 0 && sizeBytes <= PInlineContainerReference::InlineSize) {
+    allocatedDynamically = false;
+    return static_cast<PInlineContainerReference &>(ref).inlineData.bytes;
+  }
+
   allocatedDynamically = true;
+  return PAbstractArrayAllocate(sizeBytes);
 }
 
 
@@ -361,20 +400,24 @@ PBoolean PAbstractArray::InternalSetSize(PINDEX newSize, PBoolean force)
 
   if (!IsUnique()) {
 
+    PContainerReference * newReference = NewArrayReference(elementSize, newSize);
+
     if (newsizebytes == 0)
       newArray = NULL;
     else {
-      if ((newArray = PAbstractArrayAllocate(newsizebytes)) == NULL)
+      bool oldDynamic = allocatedDynamically;
+      if ((newArray = InternalAllocate(*newReference, newsizebytes)) == NULL) {
+        allocatedDynamically = oldDynamic;
+        DeleteReference(newReference);
         return false;
-  
-      allocatedDynamically = true;
+      }
 
       if (m_theArray != NULL)
         memcpy(newArray, m_theArray, PMIN(oldsizebytes, newsizebytes));
     }
 
     --reference->count;
-    reference = new PContainerReference(newSize);
+    reference = newReference;
 
   } else {
 
@@ -384,17 +427,22 @@ PBoolean PAbstractArray::InternalSetSize(PINDEX newSize, PBoolean force)
           PAbstractArrayDeallocate(m_theArray);
         newArray = NULL;
       }
+      else if (IsInline() && newsizebytes <= PInlineContainerReference::InlineSize)
+        newArray = m_theArray; // Still fits, no need to move it
       else {
-        if ((newArray = PAbstractArrayAllocate(newsizebytes)) == NULL)
+        char * oldArray = m_theArray;
+        bool oldDynamic = allocatedDynamically;
+        if ((newArray = InternalAllocate(*reference, newsizebytes)) == NULL) {
+          allocatedDynamically = oldDynamic;
           return false;
-        memcpy(newArray, m_theArray, PMIN(newsizebytes, oldsizebytes));
-        if (allocatedDynamically)
-          PAbstractArrayDeallocate(m_theArray);
-        allocatedDynamically = true;
+        }
+        memcpy(newArray, oldArray, PMIN(newsizebytes, oldsizebytes));
+        if (oldDynamic)
+          PAbstractArrayDeallocate(oldArray);
       }
     }
     else if (newsizebytes != 0) {
-      if ((newArray = PAbstractArrayAllocate(newsizebytes)) == NULL)
+      if ((newArray = InternalAllocate(*reference, newsizebytes)) == NULL)
         return false;
     }
     else
@@ -436,7 +484,7 @@ PINDEX PAbstractArray::GetLength() const
 
 PBoolean PAbstractArray::Concatenate(const PAbstractArray & array)
 {
-  if (!allocatedDynamically || array.elementSize != elementSize)
+  if ((!allocatedDynamically && !IsInline()) || array.elementSize != elementSize)
     return false;
 
   PINDEX oldLen = GetSize();
@@ -1149,32 +1197,38 @@ PObject::Comparison PString::Compare(const PObject & obj) const
 }
 
 
-PINDEX PString::HashFunction() const
+static PINDEX HashCharacters(const char * theArray, PINDEX length)
 {
   /* Hash function from "Data Structures and Algorithm Analysis in C++" by
      Mark Allen Weiss, with limit of only executing over at most the first and
      last characters to increase speed when dealing with large strings. */
 
-  switch (GetLength()) { // Use virtual function so PStringStream recalculates length
+  switch (length) {
     case 0:
       return 0;
     case 1:
-      return tolower(at(0) & 0xff) % 127;
+      return tolower(theArray[0] & 0xff) % 127;
   }
 
   static const PINDEX MaxCount = 18; // Make sure big enough to cover whole PGloballyUniqueID::AsString()
-  PINDEX count = std::min(m_length / 2, MaxCount);
+  PINDEX count = std::min(length / 2, MaxCount);
   unsigned hash = 0;
   PINDEX i;
-  const char* theArray = c_str();
   for (i = 0; i < count; i++)
     hash = (hash << 5) ^ tolower(theArray[i] & 0xff) ^ hash;
-  for (i = m_length - count - 1; i < m_length; i++)
+  for (i = length - count - 1; i < length; i++)
     hash = (hash << 5) ^ tolower(theArray[i] & 0xff) ^ hash;
   return hash % 127;
 }
 
 
+PINDEX PString::HashFunction() const
+{
+  PINDEX length = GetLength(); // Use virtual function so PStringStream recalculates length
+  return HashCharacters(c_str(), length);
+}
+
+
 PBoolean PString::IsEmpty() const
 {
   return (GetPointer() == NULL) || (at(0) == '\0');
@@ -1445,6 +1499,13 @@ PString PString::Mid(PINDEX start, PINDEX len) const
     return operator()(start, start+len-1);
 }
 
+
+PStringView PString::View(PINDEX start, PINDEX len) const
+{
+  return PStringView(*this).Mid(start, len);
+}
+
+
 PString PString::Ellipsis(PINDEX maxLength, PINDEX fromEnd, bool ansi) const
 {
   if (GetLength() <= maxLength)
@@ -1512,6 +1573,24 @@ PObject::Comparison PString::NumCompare(const char * cstr, PINDEX count, PINDEX
 }
 
 
+PObject::Comparison PString::NumCompare(const PStringView & str, PINDEX count, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0 || count < 0)
+    return LessThan;
+#endif
+
+  return InternalCompare(std::min(offset, GetLength()), std::min(count, str.GetLength()), str.GetPointer());
+}
+
+
+bool PString::operator==(const PStringView & str) const
+{
+  PINDEX len = GetLength();
+  return len == str.GetLength() && InternalCompare(0, len, str.GetPointer()) == EqualTo;
+}
+
+
 PObject::Comparison PString::InternalCompare(PINDEX offset, PINDEX length, const char * cstr) const
 {
 #if PINDEX_SIGNED
@@ -1540,6 +1619,237 @@ int PString::internal_strncmp(const char * s1, const char *s2, size_t n) const
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Search kernels used by PString and PStringView. These avoid the per
+// character virtual InternalCompare() call, using memchr() (which the C
+// library already vectorises) or SSE2 where case folding is required. Case
+// insensitive matching uses ASCII folding, as does strncasecmp() in the C
+// locale, so PCaselessString semantics are unchanged.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define P_STRING_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define P_STRING_SSE2 0
+#endif
+
+namespace PStringSearch {
+
+  static __inline char ToLower(char c) { return c >= 'A' && c <= 'Z' ? (char)(c + ('a' - 'A')) : c; }
+  static __inline char ToUpper(char c) { return c >= 'a' && c <= 'z' ? (char)(c - ('a' - 'A')) : c; }
+
+#if P_STRING_SSE2
+  static __inline unsigned LowestBit(unsigned mask)
+  {
+  #ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return bit;
+  #else
+    return __builtin_ctz(mask);
+  #endif
+  }
+
+  static __inline __m128i Match(__m128i data, __m128i lower, __m128i upper)
+  {
+    return _mm_or_si128(_mm_cmpeq_epi8(data, lower), _mm_cmpeq_epi8(data, upper));
+  }
+#endif
+
+
+  static const char * FindChar(const char * ptr, size_t len, char ch, bool caseless)
+  {
+    char lower = ToLower(ch);
+    char upper = ToUpper(ch);
+    if (!caseless || lower == upper)
+      return (const char *)memchr(ptr, ch, len);
+
+#if P_STRING_SSE2
+    __m128i lowerMask = _mm_set1_epi8(lower);
+    __m128i upperMask = _mm_set1_epi8(upper);
+    while (len >= 16) {
+      unsigned mask = _mm_movemask_epi8(Match(_mm_loadu_si128((const __m128i *)ptr), lowerMask, upperMask));
+      if (mask != 0)
+        return ptr + LowestBit(mask);
+      ptr += 16;
+      len -= 16;
+    }
+#endif
+
+    for (; len > 0; ++ptr, --len) {
+      if (*ptr == lower || *ptr == upper)
+        return ptr;
+    }
+    return NULL;
+  }
+
+
+  static const char * FindLastChar(const char * ptr, size_t len, char ch, bool caseless)
+  {
+    char lower = caseless ? ToLower(ch) : ch;
+    char upper = caseless ? ToUpper(ch) : ch;
+    while (len > 0) {
+      char c = ptr[--len];
+      if (c == lower || c == upper)
+        return ptr + len;
+    }
+    return NULL;
+  }
+
+
+  static bool Equal(const char * s1, const char * s2, size_t len, bool caseless)
+  {
+    if (!caseless)
+      return memcmp(s1, s2, len) == 0;
+
+    while (len-- > 0) {
+      if (ToLower(*s1++) != ToLower(*s2++))
+        return false;
+    }
+    return true;
+  }
+
+
+  /* Substring search using a filter on the first and last characters of the
+     needle, then confirming the candidates. With SSE2 sixteen candidate
+     positions are filtered at once. */
+  static const char * FindString(const char * ptr, size_t len, const char * str, size_t slen, bool caseless)
+  {
+    if (slen == 0 || slen > len)
+      return NULL;
+
+    if (slen == 1)
+      return FindChar(ptr, len, *str, caseless);
+
+    size_t last = slen - 1;
+    char firstLower = caseless ? ToLower(str[0])    : str[0];
+    char firstUpper = caseless ? ToUpper(str[0])    : str[0];
+    char lastLower  = caseless ? ToLower(str[last]) : str[last];
+    char lastUpper  = caseless ? ToUpper(str[last]) : str[last];
+
+#if P_STRING_SSE2
+    __m128i firstLowerMask = _mm_set1_epi8(firstLower);
+    __m128i firstUpperMask = _mm_set1_epi8(firstUpper);
+    __m128i lastLowerMask  = _mm_set1_epi8(lastLower);
+    __m128i lastUpperMask  = _mm_set1_epi8(lastUpper);
+    while (len >= last + 16) {
+      unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+                  Match(_mm_loadu_si128((const __m128i *)ptr), firstLowerMask, firstUpperMask),
+                  Match(_mm_loadu_si128((const __m128i *)(ptr+last)), lastLowerMask, lastUpperMask)));
+      while (mask != 0) {
+        unsigned bit = LowestBit(mask);
+        if (Equal(ptr+bit+1, str+1, slen-2, caseless))
+          return ptr+bit;
+        mask &= mask - 1;
+      }
+      ptr += 16;
+      len -= 16;
+    }
+#endif
+
+    while (len >= slen) {
+      if ((*ptr == firstLower || *ptr == firstUpper) &&
+          (ptr[last] == lastLower || ptr[last] == lastUpper) &&
+          Equal(ptr+1, str+1, slen-2, caseless))
+        return ptr;
+      ++ptr;
+      --len;
+    }
+
+    return NULL;
+  }
+
+
+  /// Bit map of a set of characters
+  class CharSet
+  {
+    public:
+      CharSet(const char * set, size_t len, bool caseless)
+      {
+        memset(m_bits, 0, sizeof(m_bits));
+        while (len-- > 0) {
+          char c = *set++;
+          Add(c);
+          if (caseless) {
+            Add(ToLower(c));
+            Add(ToUpper(c));
+          }
+        }
+      }
+
+      bool Contains(char c) const
+      {
+        unsigned char u = (unsigned char)c;
+        return (m_bits[u >> 5] & (1U << (u & 31))) != 0;
+      }
+
+    protected:
+      void Add(char c)
+      {
+        unsigned char u = (unsigned char)c;
+        m_bits[u >> 5] |= 1U << (u & 31);
+      }
+
+      uint32_t m_bits[8];
+  };
+
+
+  /// Find first character that is (or is not) in the set
+  static const char * FindInSet(const char * ptr, size_t len, const char * set, size_t setLen, bool caseless, bool inSet)
+  {
+    if (inSet && setLen == 1)
+      return FindChar(ptr, len, *set, caseless);
+
+#if P_STRING_SSE2
+    /* Small sets, typical of delimiter searches, compare sixteen characters
+       against each member of the set at once. */
+    static const size_t MaxVectorSet = 8;
+    if (len >= 16 && setLen <= (caseless ? MaxVectorSet/2 : MaxVectorSet)) {
+      __m128i members[MaxVectorSet];
+      size_t count = 0;
+      for (size_t i = 0; i < setLen; ++i) {
+        members[count++] = _mm_set1_epi8(caseless ? ToLower(set[i]) : set[i]);
+        if (caseless && ToLower(set[i]) != ToUpper(set[i]))
+          members[count++] = _mm_set1_epi8(ToUpper(set[i]));
+      }
+
+      unsigned invert = inSet ? 0 : 0xffff;
+      do {
+        __m128i data = _mm_loadu_si128((const __m128i *)ptr);
+        __m128i match = _mm_cmpeq_epi8(data, members[0]);
+        for (size_t i = 1; i < count; ++i)
+          match = _mm_or_si128(match, _mm_cmpeq_epi8(data, members[i]));
+        unsigned mask = _mm_movemask_epi8(match) ^ invert;
+        if (mask != 0)
+          return ptr + LowestBit(mask);
+        ptr += 16;
+        len -= 16;
+      } while (len >= 16);
+    }
+#endif
+
+    CharSet charSet(set, setLen, caseless);
+    for (; len > 0; ++ptr, --len) {
+      if (charSet.Contains(*ptr) == inSet)
+        return ptr;
+    }
+    return NULL;
+  }
+
+
+  static __inline PINDEX Position(const char * base, const char * found)
+  {
+    return found != NULL ? (PINDEX)(found - base) : P_MAX_INDEX;
+  }
+}
+
+
+bool PString::InternalIsCaseless() const
+{
+  return false;
+}
+
+
 PINDEX PString::Find(char ch, PINDEX offset) const
 {
 #if PINDEX_SIGNED
@@ -1548,12 +1858,11 @@ PINDEX PString::Find(char ch, PINDEX offset) const
 #endif
 
   PINDEX len = GetLength();
-  while (offset < len) {
-    if (InternalCompare(offset, 1, &ch) == EqualTo)
-      return offset;
-    offset++;
-  }
-  return P_MAX_INDEX;
+  if (offset >= len)
+    return P_MAX_INDEX;
+
+  const char * theArray = GetPointer();
+  return PStringSearch::Position(theArray, PStringSearch::FindChar(theArray+offset, len-offset, ch, InternalIsCaseless()));
 }
 
 
@@ -1567,42 +1876,35 @@ PINDEX PString::Find(const char * cstr, PINDEX offset) const
   if (cstr == NULL || *cstr == '\0')
     return P_MAX_INDEX;
 
-  PINDEX len = GetLength();
-  PINDEX clen = strlen(cstr);
-  if (clen > len)
-    return P_MAX_INDEX;
+  return InternalFind(cstr, strlen(cstr), offset);
+}
 
-  if (offset > len - clen)
+
+PINDEX PString::Find(const PStringView & str, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0)
     return P_MAX_INDEX;
+#endif
 
-  if (len - clen < 10) {
-    while (offset+clen <= len) {
-      if (InternalCompare(offset, clen, cstr) == EqualTo)
-        return offset;
-      offset++;
-    }
+  if (str.IsEmpty())
     return P_MAX_INDEX;
-  }
 
-  const char* theArray = GetPointer();
+  return InternalFind(str.GetPointer(), str.GetLength(), offset);
+}
 
-  int strSum = 0;
-  int cstrSum = 0;
-  for (PINDEX i = 0; i < clen; i++) {
-    strSum += toupper(theArray[offset+i] & 0xff);
-    cstrSum += toupper(cstr[i] & 0xff);
-  }
 
-  // search for a matching substring
-  while (offset+clen <= len) {
-    if (strSum == cstrSum && InternalCompare(offset, clen, cstr) == EqualTo)
-      return offset;
-    strSum += toupper(theArray[offset+clen] & 0xff);
-    strSum -= toupper(theArray[offset] & 0xff);
-    offset++;
-  }
+PINDEX PString::InternalFind(const char * cstr, PINDEX clen, PINDEX offset) const
+{
+  PINDEX len = GetLength();
+  if (clen > len)
+    return P_MAX_INDEX;
 
-  return P_MAX_INDEX;
+  if (offset > len - clen)
+    return P_MAX_INDEX;
+
+  const char * theArray = GetPointer();
+  return PStringSearch::Position(theArray, PStringSearch::FindString(theArray+offset, len-offset, cstr, clen, InternalIsCaseless()));
 }
 
 
@@ -1620,13 +1922,8 @@ PINDEX PString::FindLast(char ch, PINDEX offset) const
   if (offset >= len)
     offset = len-1;
 
-  while (InternalCompare(offset, 1, &ch) != EqualTo) {
-    if (offset == 0)
-      return P_MAX_INDEX;
-    offset--;
-  }
-
-  return offset;
+  const char * theArray = GetPointer();
+  return PStringSearch::Position(theArray, PStringSearch::FindLastChar(theArray, offset+1, ch, InternalIsCaseless()));
 }
 
 
@@ -1681,16 +1978,12 @@ PINDEX PString::FindOneOf(const char * cset, PINDEX offset) const
     return P_MAX_INDEX;
 
   PINDEX len = GetLength();
-  while (offset < len) {
-    const char * p = cset;
-    while (*p != '\0') {
-      if (InternalCompare(offset, 1, p) == EqualTo)
-        return offset;
-      p++;
-    }
-    offset++;
-  }
-  return P_MAX_INDEX;
+  if (offset >= len)
+    return P_MAX_INDEX;
+
+  const char * theArray = GetPointer();
+  return PStringSearch::Position(theArray, PStringSearch::FindInSet(theArray+offset, len-offset,
+                                                                    cset, strlen(cset), InternalIsCaseless(), true));
 }
 
 
@@ -1705,15 +1998,12 @@ PINDEX PString::FindSpan(const char * cset, PINDEX offset) const
     return P_MAX_INDEX;
 
   PINDEX len = GetLength();
-  while (offset < len) {
-    const char * p = cset;
-    while (InternalCompare(offset, 1, p) != EqualTo) {
-      if (*++p == '\0')
-        return offset;
-    }
-    offset++;
-  }
-  return P_MAX_INDEX;
+  if (offset >= len)
+    return P_MAX_INDEX;
+
+  const char * theArray = GetPointer();
+  return PStringSearch::Position(theArray, PStringSearch::FindInSet(theArray+offset, len-offset,
+                                                                    cset, strlen(cset), InternalIsCaseless(), false));
 }
 
 
@@ -2473,6 +2763,263 @@ char * PString::GetPointerAndSetLength(PINDEX len)
 }
 
 
+PStringView::Tokens PString::TokeniseView(const PStringView & separators, bool onePerSeparator) const
+{
+  return PStringView(*this).Tokenise(separators, onePerSeparator);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PString PStringView::AsString() const
+{
+  return PString(m_ptr, m_length);
+}
+
+
+PStringView PStringView::operator()(PINDEX start, PINDEX end) const
+{
+#if PINDEX_SIGNED
+  if (end < 0 || start < 0)
+    return PStringView();
+#endif
+
+  if (end < start || start >= m_length)
+    return PStringView();
+
+  if (end >= m_length)
+    end = m_length-1;
+
+  return PStringView(m_ptr+start, end - start + 1);
+}
+
+
+PStringView PStringView::Left(PINDEX len) const
+{
+  if (len <= 0)
+    return PStringView();
+
+  if (len >= m_length)
+    return *this;
+
+  return PStringView(m_ptr, len);
+}
+
+
+PStringView PStringView::Right(PINDEX len) const
+{
+  if (len <= 0)
+    return PStringView();
+
+  if (len >= m_length)
+    return *this;
+
+  return PStringView(m_ptr+m_length-len, len);
+}
+
+
+PStringView PStringView::Mid(PINDEX start, PINDEX len) const
+{
+#if PINDEX_SIGNED
+  if (len <= 0 || start < 0)
+#else
+  if (len == 0)
+#endif
+    return PStringView();
+
+  if (start >= m_length)
+    return PStringView();
+
+  if (len > m_length - start)
+    len = m_length - start;
+
+  return PStringView(m_ptr+start, len);
+}
+
+
+PStringView PStringView::LeftTrim() const
+{
+  PINDEX pos = 0;
+  while (pos < m_length && isspace(m_ptr[pos] & 0xff))
+    ++pos;
+  return PStringView(m_ptr+pos, m_length-pos);
+}
+
+
+PStringView PStringView::RightTrim() const
+{
+  PINDEX len = m_length;
+  while (len > 0 && isspace(m_ptr[len-1] & 0xff))
+    --len;
+  return PStringView(m_ptr, len);
+}
+
+
+PStringView PStringView::Trim() const
+{
+  return LeftTrim().RightTrim();
+}
+
+
+PINDEX PStringView::Find(char ch, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0)
+    return P_MAX_INDEX;
+#endif
+
+  if (offset >= m_length)
+    return P_MAX_INDEX;
+
+  return PStringSearch::Position(m_ptr, PStringSearch::FindChar(m_ptr+offset, m_length-offset, ch, false));
+}
+
+
+PINDEX PStringView::Find(const PStringView & str, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0)
+    return P_MAX_INDEX;
+#endif
+
+  if (offset >= m_length)
+    return P_MAX_INDEX;
+
+  return PStringSearch::Position(m_ptr, PStringSearch::FindString(m_ptr+offset, m_length-offset, str.m_ptr, str.m_length, false));
+}
+
+
+PINDEX PStringView::FindLast(char ch, PINDEX offset) const
+{
+  if (m_length == 0)
+    return P_MAX_INDEX;
+
+  if (offset >= m_length)
+    offset = m_length-1;
+
+  return PStringSearch::Position(m_ptr, PStringSearch::FindLastChar(m_ptr, offset+1, ch, false));
+}
+
+
+PINDEX PStringView::FindOneOf(const PStringView & set, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0)
+    return P_MAX_INDEX;
+#endif
+
+  if (offset >= m_length || set.m_length == 0)
+    return P_MAX_INDEX;
+
+  return PStringSearch::Position(m_ptr, PStringSearch::FindInSet(m_ptr+offset, m_length-offset,
+                                                                set.m_ptr, set.m_length, false, true));
+}
+
+
+PINDEX PStringView::FindSpan(const PStringView & set, PINDEX offset) const
+{
+#if PINDEX_SIGNED
+  if (offset < 0)
+    return P_MAX_INDEX;
+#endif
+
+  if (offset >= m_length || set.m_length == 0)
+    return P_MAX_INDEX;
+
+  return PStringSearch::Position(m_ptr, PStringSearch::FindInSet(m_ptr+offset, m_length-offset,
+                                                                set.m_ptr, set.m_length, false, false));
+}
+
+
+PStringView::Tokens PStringView::Tokenise(const PStringView & separators, bool onePerSeparator) const
+{
+  Tokens tokens;
+
+  if (separators.IsEmpty() || IsEmpty())  // No tokens
+    return tokens;
+
+  PINDEX p1 = 0;
+  PINDEX p2 = FindOneOf(separators);
+
+  if (p2 == 0) {
+    if (onePerSeparator) { // first character is a token separator
+      tokens.push_back(PStringView());
+      p1 = 1;
+      p2 = FindOneOf(separators, 1);
+    }
+    else {
+      do {
+        p1 = p2 + 1;
+      } while ((p2 = FindOneOf(separators, p1)) == p1);
+    }
+  }
+
+  while (p2 != P_MAX_INDEX) {
+    tokens.push_back(PStringView(m_ptr+p1, p2-p1));
+
+    // Get next separator. If not one token per separator then continue
+    // around loop to skip over all the consecutive separators.
+    do {
+      p1 = p2 + 1;
+    } while ((p2 = FindOneOf(separators, p1)) == p1 && !onePerSeparator);
+  }
+
+  tokens.push_back(Mid(p1));
+
+  return tokens;
+}
+
+
+PObject::Comparison PStringView::Compare(const PStringView & other) const
+{
+  int result = memcmp(m_ptr, other.m_ptr, std::min(m_length, other.m_length));
+  if (result == 0)
+    return m_length < other.m_length ? PObject::LessThan : m_length > other.m_length ? PObject::GreaterThan : PObject::EqualTo;
+  return result < 0 ? PObject::LessThan : PObject::GreaterThan;
+}
+
+
+bool PStringView::operator*=(const PStringView & other) const
+{
+  return m_length == other.m_length && strncasecmp(m_ptr, other.m_ptr, m_length) == 0;
+}
+
+
+long PStringView::AsInteger(unsigned base) const
+{
+  CStr str(*this);
+  return strtol(str, NULL, base);
+}
+
+
+DWORD PStringView::AsUnsigned(unsigned base) const
+{
+  CStr str(*this);
+  return strtoul(str, NULL, base);
+}
+
+
+PINDEX PStringView::HashFunction() const
+{
+  return HashCharacters(m_ptr, m_length);
+}
+
+
+PStringView::CStr::CStr(const PStringView & view)
+  : m_ptr(view.m_length < (PINDEX)sizeof(m_buffer) ? m_buffer : new char[view.m_length+1])
+{
+  memcpy(m_ptr, view.m_ptr, view.m_length);
+  m_ptr[view.m_length] = '\0';
+}
+
+
+PStringView::CStr::~CStr()
+{
+  if (m_ptr != m_buffer)
+    delete [] m_ptr;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 PObject * PCaselessString::Clone() const
@@ -2481,6 +3028,12 @@ PObject * PCaselessString::Clone() const
 }
 
 
+bool PCaselessString::InternalIsCaseless() const
+{
+  return true;
+}
+
+
 int PCaselessString::internal_strcmp(const char * s1, const char *s2) const
 {
   return strcasecmp(s1, s2);
@@ -3270,6 +3823,24 @@ PString PStringOptions::GetString(const PCaselessString & key, const char * dflt
 }
 
 
+PString * PStringOptions::GetAt(const PStringView & key) const
+{
+  // Search the bucket directly, rather than make a PCaselessString of the key
+  for (PHashTableElement * element = hashTable->GetAt(key.HashFunction()).m_head; element != NULL; element = element->m_next) {
+    if (PStringView(*static_cast<const PString *>(element->m_key)) *= key)
+      return static_cast<PString *>(element->m_data);
+  }
+  return NULL;
+}
+
+
+PString PStringOptions::GetString(const PStringView & key, const char * dflt) const
+{
+  PString * str = GetAt(key);
+  return str != NULL ? *str : PString(dflt);
+}
+
+
 bool PStringOptions::GetBoolean(const PCaselessString & key, bool dflt) const
 {
   PString * str = PStringToString::GetAt(key);
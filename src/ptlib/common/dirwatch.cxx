@@ -0,0 +1,864 @@
+/*
+ * dirwatch.cxx
+ *
+ * File system change notification, and a file information cache.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifdef __GNUC__
+#pragma implementation "dirwatch.h"
+#endif
+
+#include <ptlib.h>
+#include <ptlib/dirwatch.h>
+#include <ptlib/pprocess.h>
+#include <ptlib/metrics.h>
+
+#if P_HAS_INOTIFY
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+#define PTraceModule() "DirWatch"
+
+static PMetricCounter s_watcherChanges      ("ptlib_dirwatch_changes_total",       "File system changes seen by directory watchers");
+static PMetricCounter s_watcherNotifications("ptlib_dirwatch_notifications_total", "Notifications made by directory watchers, after coalescing");
+static PMetricCounter s_watcherOverflows    ("ptlib_dirwatch_overflows_total",     "Times directory watchers lost changes");
+static PMetricCounter s_cacheHits           ("ptlib_fileinfo_cache_lookups_total", "File information lookups", "result=\"hit\"");
+static PMetricCounter s_cacheMisses         ("ptlib_fileinfo_cache_lookups_total", "File information lookups", "result=\"miss\"");
+static PMetricCounter s_cacheInvalidations  ("ptlib_fileinfo_cache_invalidations_total", "File information cache entries dropped due to changes");
+
+
+// Paths of directories in events and the cache do not have the trailing separator
+static PString WithoutSeparator(const PString & path)
+{
+  PINDEX len = path.GetLength();
+  return len > 1 && PDirectory::IsSeparator(path[len-1]) ? path.Left(len-1) : path;
+}
+
+
+static bool IsPrefixOf(const PString & prefix, const PString & path)
+{
+  return path.NumCompare(prefix, prefix.GetLength()) == PObject::EqualTo;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PDirectoryWatcher::PDirectoryWatcher(const Notifier & notifier, const PTimeInterval & coalesce, const PTimeInterval & pollInterval)
+  : m_notifier(notifier)
+  , m_coalesce(coalesce)
+  , m_pollInterval(pollInterval)
+  , m_thread(NULL)
+  , m_running(false)
+  , m_fd(-1)
+{
+  m_wakeUp[0] = m_wakeUp[1] = -1;
+}
+
+
+PDirectoryWatcher::~PDirectoryWatcher()
+{
+  Close();
+}
+
+
+bool PDirectoryWatcher::IsNative()
+{
+#if P_HAS_INOTIFY
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+void PDirectoryWatcher::SetNotifier(const Notifier & notifier)
+{
+  PWaitAndSignal lock(m_mutex);
+  m_notifier = notifier;
+}
+
+
+bool PDirectoryWatcher::Add(const PDirectory & dir, bool recursive)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (m_thread == NULL) {
+#if P_HAS_INOTIFY
+    if ((m_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) < 0) {
+      PTRACE(1, "Could not create inotify instance: " << strerror(errno));
+      return false;
+    }
+    if (pipe2(m_wakeUp, O_NONBLOCK|O_CLOEXEC) < 0) {
+      PTRACE(1, "Could not create wake up pipe: " << strerror(errno));
+      ::close(m_fd);
+      m_fd = -1;
+      return false;
+    }
+#endif
+    m_running = true;
+    m_thread = new PThreadObj<PDirectoryWatcher>(*this, &PDirectoryWatcher::ThreadMain, false, "DirWatch");
+  }
+
+  WatchMap::iterator it = m_roots.find(dir);
+  if (it != m_roots.end()) {
+    if (it->second.m_recursive == recursive)
+      return true;
+    if (it->second.m_recursive) {
+      // Stop watching the sub-directories, unless needed by another root
+      InternalRemove(dir);
+      m_roots.erase(it);
+      for (it = m_roots.begin(); it != m_roots.end(); ++it)
+        InternalAdd(it->first, it->second.m_recursive, false);
+    }
+  }
+
+  if (!InternalAdd(dir, recursive, false))
+    return false;
+
+  m_roots[dir] = Watch(m_watched[dir].m_handle, recursive);
+#if !P_HAS_INOTIFY
+  TakeSnapshot(dir, recursive, m_snapshots);
+#endif
+  PTRACE(4, "Watching " << dir << (recursive ? " recursively" : "") << ", " << m_watched.size() << " directories");
+  return true;
+}
+
+
+bool PDirectoryWatcher::InternalAdd(const PDirectory & dir, bool recursive, bool reportExisting)
+{
+  WatchMap::iterator it = m_watched.find(dir);
+  if (it == m_watched.end()) {
+#if P_HAS_INOTIFY
+    int handle = inotify_add_watch(m_fd, dir, IN_CREATE|IN_DELETE|IN_MODIFY|IN_CLOSE_WRITE|IN_ATTRIB|
+                                              IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR);
+    if (handle < 0) {
+      PTRACE(errno == ENOSPC ? 1 : 3, "Could not watch " << dir << ": " << strerror(errno));
+      return false;
+    }
+    m_handles[handle] = dir;
+#else
+    if (!dir.Exists())
+      return false;
+    int handle = 0;
+#endif
+    it = m_watched.insert(WatchMap::value_type(dir, Watch(handle, recursive))).first;
+  }
+
+  it->second.m_recursive = it->second.m_recursive || recursive;
+  if (!recursive && !reportExisting)
+    return true;
+
+  /* A new directory may have had things put in it before our watch was set
+     up, so report them, and watch any sub-directories */
+  PDirectory scan(dir);
+  if (scan.Open(PFileInfo::AllFiles)) {
+    do {
+      PFilePathString name = scan.GetEntryName();
+      bool isDir = scan.IsSubDir();
+      if (reportExisting)
+        AddChange(dir + name, Created, isDir);
+      if (recursive && isDir)
+        InternalAdd(dir + name + PDIR_SEPARATOR, true, reportExisting);
+    } while (scan.Next());
+  }
+
+  return true;
+}
+
+
+bool PDirectoryWatcher::Remove(const PDirectory & dir)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  WatchMap::iterator it = m_roots.find(dir);
+  if (it == m_roots.end())
+    return false;
+
+  m_roots.erase(it);
+  InternalRemove(dir);
+
+  // Put back anything still needed by other roots
+  for (it = m_roots.begin(); it != m_roots.end(); ++it)
+    InternalAdd(it->first, it->second.m_recursive, false);
+
+  PTRACE(4, "Stopped watching " << dir << ", " << m_watched.size() << " directories");
+  return true;
+}
+
+
+void PDirectoryWatcher::InternalRemove(const PString & dir)
+{
+  WatchMap::iterator it = m_watched.lower_bound(dir);
+  while (it != m_watched.end() && IsPrefixOf(dir, it->first)) {
+#if P_HAS_INOTIFY
+    inotify_rm_watch(m_fd, it->second.m_handle);
+#endif
+    m_handles.erase(it->second.m_handle);
+    m_watched.erase(it++);
+  }
+
+  Snapshots::iterator snap = m_snapshots.lower_bound(dir);
+  while (snap != m_snapshots.end() && IsPrefixOf(dir, snap->first))
+    m_snapshots.erase(snap++);
+}
+
+
+void PDirectoryWatcher::Close()
+{
+  PThread * thread;
+  {
+    PWaitAndSignal lock(m_mutex);
+    thread = m_thread;
+    m_thread = NULL;
+    m_running = false;
+  }
+
+  if (thread != NULL) {
+#if P_HAS_INOTIFY
+    PAssertOS(::write(m_wakeUp[1], "", 1) == 1);
+#else
+    m_wakeUpSync.Signal();
+#endif
+    PThread::WaitAndDelete(thread);
+  }
+
+  PWaitAndSignal lock(m_mutex);
+
+#if P_HAS_INOTIFY
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    ::close(m_wakeUp[0]);
+    ::close(m_wakeUp[1]);
+    m_fd = m_wakeUp[0] = m_wakeUp[1] = -1;
+  }
+#endif
+
+  m_roots.clear();
+  m_watched.clear();
+  m_handles.clear();
+  m_snapshots.clear();
+  m_pending.clear();
+}
+
+
+bool PDirectoryWatcher::IsWatched(const PString & dir) const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_watched.find(dir) != m_watched.end();
+}
+
+
+void PDirectoryWatcher::GetStatistics(Statistics & stats) const
+{
+  PWaitAndSignal lock(m_mutex);
+  stats = m_statistics;
+  stats.m_watches = m_watched.size();
+}
+
+
+void PDirectoryWatcher::ThreadMain()
+{
+  PTRACE(4, "Thread started");
+
+  while (m_running) {
+    PTimeInterval timeout;
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (!m_pending.empty())
+        timeout = std::max(PTimeInterval(0), m_coalesce - (PTime() - m_firstPending));
+      else if (IsNative())
+        timeout = PMaxTimeInterval;
+      else
+        timeout = std::max(PTimeInterval(0), m_pollInterval - (PTime() - m_lastScan));
+    }
+
+    ReadChanges(timeout);
+
+    PendingMap pending;
+    Notifier notifier;
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (m_pending.empty() || PTime() - m_firstPending < m_coalesce)
+        continue;
+      m_pending.swap(pending);
+      notifier = m_notifier;
+      m_statistics.m_notifications += pending.size();
+      s_watcherNotifications += pending.size();
+    }
+
+    if (!notifier.IsNULL()) {
+      for (PendingMap::iterator it = pending.begin(); it != pending.end(); ++it) {
+        PTRACE(5, "Changed " << it->second.m_path << ": " << it->second.m_changes);
+        notifier(*this, it->second);
+      }
+    }
+  }
+
+  PTRACE(4, "Thread ended");
+}
+
+
+void PDirectoryWatcher::AddChange(const PString & path, Changes changes, bool subDirectory)
+{
+  ++m_statistics.m_changes;
+  ++s_watcherChanges;
+
+  if (m_pending.empty())
+    m_firstPending.SetCurrentTime();
+
+  PendingMap::iterator it = m_pending.find(path);
+  if (it == m_pending.end()) {
+    it = m_pending.insert(PendingMap::value_type(path, Event())).first;
+    it->second.m_path = path;
+  }
+  it->second.m_changes |= changes;
+  it->second.m_subDirectory = subDirectory;
+}
+
+
+void PDirectoryWatcher::AddOverflow()
+{
+  PTRACE(2, "Changes lost, rescanning " << m_roots.size() << " directories");
+  ++m_statistics.m_overflows;
+  ++s_watcherOverflows;
+
+  for (WatchMap::iterator it = m_roots.begin(); it != m_roots.end(); ++it) {
+    AddChange(WithoutSeparator(it->first), Overflow, true);
+    // Pick up any directories we missed the creation of
+    if (it->second.m_recursive)
+      InternalAdd(it->first, true, false);
+  }
+}
+
+
+#if P_HAS_INOTIFY
+
+void PDirectoryWatcher::ReadChanges(const PTimeInterval & timeout)
+{
+  pollfd fds[2];
+  fds[0].fd = m_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wakeUp[0];
+  fds[1].events = POLLIN;
+  if (::poll(fds, 2, timeout == PMaxTimeInterval ? -1 : (int)timeout.GetMilliSeconds()) <= 0)
+    return;
+
+  if (fds[1].revents != 0) {
+    char dummy[16];
+    while (::read(m_wakeUp[0], dummy, sizeof(dummy)) > 0)
+      ;
+  }
+
+  if (fds[0].revents == 0)
+    return;
+
+  long buffer[4096]; // Aligned as inotify_event must be
+  ssize_t length;
+  while ((length = ::read(m_fd, buffer, sizeof(buffer))) > 0) {
+    PWaitAndSignal lock(m_mutex);
+
+    for (const char * ptr = (const char *)buffer; ptr < (const char *)buffer + length; ) {
+      const inotify_event & event = *(const inotify_event *)ptr;
+      ptr += sizeof(inotify_event) + event.len;
+
+      if (event.mask & IN_Q_OVERFLOW) {
+        AddOverflow();
+        continue;
+      }
+
+      std::map<int, PString>::iterator handle = m_handles.find(event.wd);
+      if (handle == m_handles.end())
+        continue;
+      PString dir = handle->second;
+
+      if (event.mask & IN_IGNORED) {
+        // Directory gone, or file system unmounted
+        m_watched.erase(dir);
+        m_handles.erase(handle);
+        continue;
+      }
+
+      bool isDir = (event.mask & IN_ISDIR) != 0;
+
+      if (event.len == 0 || event.name[0] == '\0') {
+        // Something happened to the watched directory itself
+        if (event.mask & (IN_DELETE_SELF|IN_MOVE_SELF)) {
+          AddChange(WithoutSeparator(dir), Removed, true);
+          InternalRemove(dir);
+        }
+        else if (event.mask & IN_ATTRIB)
+          AddChange(WithoutSeparator(dir), Attributes, true);
+        continue;
+      }
+
+      PString path = dir + event.name;
+      Changes changes;
+      if (event.mask & (IN_CREATE|IN_MOVED_TO))
+        changes |= Created;
+      if (event.mask & (IN_DELETE|IN_MOVED_FROM))
+        changes |= Removed;
+      if (event.mask & (IN_MODIFY|IN_CLOSE_WRITE))
+        changes |= Modified;
+      if (event.mask & IN_ATTRIB)
+        changes |= Attributes;
+      AddChange(path, changes, isDir);
+
+      if (isDir) {
+        PString subDir = path + PDIR_SEPARATOR;
+        if (event.mask & IN_MOVED_FROM)
+          InternalRemove(subDir); // Paths are now wrong, it will be watched again if moved to another watched place
+        else if ((event.mask & (IN_CREATE|IN_MOVED_TO)) != 0) {
+          WatchMap::iterator parent = m_watched.find(dir);
+          if (parent != m_watched.end() && parent->second.m_recursive)
+            InternalAdd(subDir, true, true);
+        }
+      }
+    }
+  }
+}
+
+#else // P_HAS_INOTIFY
+
+void PDirectoryWatcher::ReadChanges(const PTimeInterval & timeout)
+{
+  if (timeout > 0 && m_wakeUpSync.Wait(timeout))
+    return;
+
+  if (PTime() - m_lastScan < m_pollInterval)
+    return;
+
+  WatchMap roots;
+  {
+    PWaitAndSignal lock(m_mutex);
+    roots = m_roots;
+  }
+
+  // Scan without the lock, it can take a while
+  Snapshots snapshots;
+  for (WatchMap::iterator it = roots.begin(); it != roots.end(); ++it)
+    TakeSnapshot(it->first, it->second.m_recursive, snapshots);
+
+  PWaitAndSignal lock(m_mutex);
+  CompareSnapshots(snapshots);
+  m_lastScan.SetCurrentTime();
+}
+
+#endif // P_HAS_INOTIFY
+
+
+void PDirectoryWatcher::TakeSnapshot(const PDirectory & dir, bool recursive, Snapshots & snapshots)
+{
+  PDirectory scan(dir);
+  if (!scan.Open(PFileInfo::AllFiles))
+    return;
+
+  do {
+    PFileInfo info;
+    if (!scan.GetInfo(info))
+      continue;
+
+    PString path = dir + scan.GetEntryName();
+    Snapshot & snapshot = snapshots[path];
+    snapshot.m_type = info.type;
+    snapshot.m_size = info.size;
+    snapshot.m_modified = info.modified.GetTimeInSeconds();
+    snapshot.m_changed = info.created.GetTimeInSeconds();
+    snapshot.m_permissions = info.permissions;
+
+    if (recursive && info.type == PFileInfo::SubDirectory)
+      TakeSnapshot(path + PDIR_SEPARATOR, true, snapshots);
+  } while (scan.Next());
+}
+
+
+void PDirectoryWatcher::CompareSnapshots(const Snapshots & snapshots)
+{
+  Snapshots::const_iterator was = m_snapshots.begin();
+  Snapshots::const_iterator now = snapshots.begin();
+  while (was != m_snapshots.end() || now != snapshots.end()) {
+    if (now == snapshots.end() || (was != m_snapshots.end() && was->first < now->first)) {
+      AddChange(was->first, Removed, was->second.m_type == PFileInfo::SubDirectory);
+      ++was;
+    }
+    else if (was == m_snapshots.end() || now->first < was->first) {
+      AddChange(now->first, Created, now->second.m_type == PFileInfo::SubDirectory);
+      ++now;
+    }
+    else {
+      Changes changes;
+      if (was->second.m_type != now->second.m_type)
+        changes |= Removed|Created;
+      if (was->second.m_size != now->second.m_size || was->second.m_modified != now->second.m_modified)
+        changes |= Modified;
+      if (was->second.m_permissions != now->second.m_permissions || was->second.m_changed != now->second.m_changed)
+        changes |= Attributes;
+      if (changes != NoChanges)
+        AddChange(now->first, changes, now->second.m_type == PFileInfo::SubDirectory);
+      ++was;
+      ++now;
+    }
+  }
+
+  m_snapshots = snapshots;
+
+  // Keep the set of watched directories up to date, for IsWatched()
+  for (WatchMap::iterator it = m_watched.begin(); it != m_watched.end(); ) {
+    if (m_roots.find(it->first) == m_roots.end() && snapshots.find(WithoutSeparator(it->first)) == snapshots.end())
+      m_watched.erase(it++);
+    else
+      ++it;
+  }
+  for (Snapshots::const_iterator it = snapshots.begin(); it != snapshots.end(); ++it) {
+    if (it->second.m_type == PFileInfo::SubDirectory) {
+      PString dir = it->first + PDIR_SEPARATOR;
+      WatchMap::iterator root = m_roots.upper_bound(dir);
+      while (root != m_roots.begin()) {
+        --root;
+        if (IsPrefixOf(root->first, dir)) {
+          if (root->second.m_recursive)
+            m_watched[dir] = Watch(0, true);
+          break;
+        }
+      }
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+static atomic<bool> s_cacheActive(false);
+
+PFileInfoCache & PFileInfoCache::GetInstance()
+{
+  static PFileInfoCache instance;
+  return instance;
+}
+
+
+// The watcher thread must be stopped before the process exits
+class PFileInfoCacheShutdown : public PProcessStartup
+{
+    PCLASSINFO(PFileInfoCacheShutdown, PProcessStartup)
+  public:
+    virtual void OnShutdown()
+    {
+      if (s_cacheActive) {
+        s_cacheActive = false;
+        PFileInfoCache::GetInstance().Close();
+      }
+    }
+};
+
+PFACTORY_CREATE_SINGLETON(PProcessStartupFactory, PFileInfoCacheShutdown);
+
+
+static PUInt64 HashPath(const PString & path)
+{
+  // FNV-1a
+  PUInt64 hash = 14695981039346656037ULL;
+  for (const char * ptr = path; *ptr != '\0'; ++ptr)
+    hash = (hash ^ (BYTE)*ptr) * 1099511628211ULL;
+  return hash;
+}
+
+
+static PString GetParentPath(const PString & path)
+{
+  PINDEX slash = path.FindLast(PDIR_SEPARATOR);
+  if (slash == P_MAX_INDEX)
+    return PString::Empty();
+  return slash > 0 ? path.Left(slash) : path.Left(1);
+}
+
+
+PFileInfoCache::Entry::Entry(const PString & path, PUInt64 hash, const PFileInfo * info)
+  : m_next(NULL)
+  , m_hash(hash)
+  , m_path(path)
+  , m_exists(info != NULL)
+{
+  if (info != NULL)
+    m_info = *info;
+}
+
+
+PFileInfoCache::PFileInfoCache()
+  : m_watcher(PCREATE_NOTIFIER2(OnChange, const PDirectoryWatcher::Event &), 0)
+  , m_buckets(1024)
+  , m_entryCount(0)
+  , m_generation(0)
+  , m_maxEntries(DefaultMaxEntries)
+{
+}
+
+
+PFileInfoCache::~PFileInfoCache()
+{
+  Close();
+}
+
+
+void PFileInfoCache::Close()
+{
+  s_cacheActive = false;
+  m_watcher.Close();
+  Clear();
+}
+
+
+bool PFileInfoCache::Add(const PDirectory & dir, bool recursive)
+{
+  if (!PDirectoryWatcher::IsNative()) {
+    PTRACE(2, "Cannot cache file information without native directory watching");
+    return false;
+  }
+
+  if (!m_watcher.Add(dir, recursive))
+    return false;
+
+  s_cacheActive = true;
+  return true;
+}
+
+
+bool PFileInfoCache::Remove(const PDirectory & dir)
+{
+  if (!m_watcher.Remove(dir))
+    return false;
+
+  InternalInvalidate(WithoutSeparator(dir), true);
+  return true;
+}
+
+
+void PFileInfoCache::Clear()
+{
+  PWaitAndSignal lock(m_mutex);
+  ++m_generation;
+  s_cacheInvalidations += m_entryCount;
+  InternalClear();
+}
+
+
+void PFileInfoCache::InternalClear()
+{
+  for (std::vector<Entry *>::iterator it = m_buckets.begin(); it != m_buckets.end(); ++it) {
+    while (*it != NULL) {
+      Entry * entry = *it;
+      *it = entry->m_next;
+      delete entry;
+    }
+  }
+  m_entryCount = 0;
+  m_directories.clear();
+}
+
+
+PFileInfoCache::Entry ** PFileInfoCache::FindEntry(const PString & path, PUInt64 hash)
+{
+  Entry ** link = &m_buckets[(size_t)hash & (m_buckets.size()-1)];
+  while (*link != NULL && ((*link)->m_hash != hash || (*link)->m_path != path))
+    link = &(*link)->m_next;
+  return link;
+}
+
+
+void PFileInfoCache::EraseEntry(Entry ** link)
+{
+  Entry * entry = *link;
+  *link = entry->m_next;
+
+  std::map<PString, PINDEX>::iterator dir = m_directories.find(GetParentPath(entry->m_path));
+  if (dir != m_directories.end() && --dir->second == 0)
+    m_directories.erase(dir);
+
+  delete entry;
+  --m_entryCount;
+}
+
+
+void PFileInfoCache::SetMaxEntries(PINDEX max)
+{
+  PWaitAndSignal lock(m_mutex);
+  m_maxEntries = max;
+}
+
+
+bool PFileInfoCache::IsActive()
+{
+  return s_cacheActive;
+}
+
+
+PFileInfoCache::LookupResult PFileInfoCache::Lookup(const PString & path, PFileInfo & info, unsigned & generation)
+{
+  // With a trailing separator, a symbolic link is followed, so is not the same as without
+  if (!s_cacheActive || path.IsEmpty() || PDirectory::IsSeparator(path[path.GetLength()-1]))
+    return NotCached;
+
+  PUInt64 hash = HashPath(path);
+  PFileInfoCache & cache = GetInstance();
+  PWaitAndSignal lock(cache.m_mutex);
+
+  Entry * entry = *cache.FindEntry(path, hash);
+  if (entry == NULL) {
+    ++s_cacheMisses;
+    generation = cache.m_generation;
+    return NotCached;
+  }
+
+  ++s_cacheHits;
+  if (!entry->m_exists)
+    return NotFound;
+
+  info = entry->m_info;
+  return Found;
+}
+
+
+void PFileInfoCache::Store(const PString & path, const PFileInfo * info, unsigned generation)
+{
+  if (!s_cacheActive || path.IsEmpty() || PDirectory::IsSeparator(path[path.GetLength()-1]))
+    return;
+
+  // The target of a link may be anywhere, so could change without us knowing
+  if (info != NULL && info->type == PFileInfo::SymbolicLink)
+    return;
+
+  PString parent = GetParentPath(path);
+  if (parent.IsEmpty())
+    return;
+
+  // Only if we will be told of a change, note this is done before the lock, see Lookup()
+  PFileInfoCache & cache = GetInstance();
+  if (!cache.m_watcher.IsWatched(parent.GetLength() > 1 ? parent + PDIR_SEPARATOR : parent) &&
+      !cache.m_watcher.IsWatched(path + PDIR_SEPARATOR))
+    return;
+
+  PUInt64 hash = HashPath(path);
+  PWaitAndSignal lock(cache.m_mutex);
+
+  if (generation != cache.m_generation)
+    return; // Something changed since the lookup, the information may be stale
+
+  if (cache.m_entryCount >= cache.m_maxEntries) {
+    PTRACE(3, &cache, "Cache full at " << cache.m_entryCount << " entries, clearing");
+    s_cacheInvalidations += cache.m_entryCount;
+    cache.InternalClear();
+  }
+
+  Entry ** link = cache.FindEntry(path, hash);
+  if (*link != NULL)
+    return; // Another thread got there first
+
+  *link = new Entry(path, hash, info);
+  ++cache.m_directories[parent];
+
+  if (++cache.m_entryCount <= (PINDEX)cache.m_buckets.size())
+    return;
+
+  // Double the buckets, keeping the average chain length at one or less
+  std::vector<Entry *> buckets(cache.m_buckets.size()*2);
+  for (std::vector<Entry *>::iterator it = cache.m_buckets.begin(); it != cache.m_buckets.end(); ++it) {
+    while (*it != NULL) {
+      Entry * entry = *it;
+      *it = entry->m_next;
+      Entry * & bucket = buckets[(size_t)entry->m_hash & (buckets.size()-1)];
+      entry->m_next = bucket;
+      bucket = entry;
+    }
+  }
+  cache.m_buckets.swap(buckets);
+}
+
+
+void PFileInfoCache::Invalidate(const PString & path)
+{
+  if (s_cacheActive)
+    GetInstance().InternalInvalidate(WithoutSeparator(path), true);
+}
+
+
+void PFileInfoCache::OnChange(PDirectoryWatcher &, const PDirectoryWatcher::Event & event)
+{
+  if (event.m_changes & PDirectoryWatcher::Overflow)
+    Clear();
+  else
+    InternalInvalidate(event.m_path, event.m_subDirectory);
+}
+
+
+void PFileInfoCache::InternalInvalidate(const PString & path, bool subTree)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  ++m_generation;
+
+  PINDEX count = 0;
+  Entry ** link = FindEntry(path, HashPath(path));
+  if (*link != NULL) {
+    EraseEntry(link);
+    ++count;
+  }
+
+  // The directory containing it has changed too
+  PString parent = GetParentPath(path);
+  if (!parent.IsEmpty() && *(link = FindEntry(parent, HashPath(parent))) != NULL) {
+    EraseEntry(link);
+    ++count;
+  }
+
+  /* Only scan everything if there is something cached below the path, this
+     is rare, as it is only when a directory is removed or renamed. */
+  if (subTree && !m_directories.empty()) {
+    PString prefix = PDirectory::IsSeparator(path[path.GetLength()-1]) ? path : path + PDIR_SEPARATOR;
+    std::map<PString, PINDEX>::iterator dir = m_directories.lower_bound(prefix);
+    if (m_directories.find(path) != m_directories.end() || (dir != m_directories.end() && IsPrefixOf(prefix, dir->first))) {
+      for (std::vector<Entry *>::iterator it = m_buckets.begin(); it != m_buckets.end(); ++it) {
+        link = &*it;
+        while (*link != NULL) {
+          if (IsPrefixOf(prefix, (*link)->m_path)) {
+            EraseEntry(link);
+            ++count;
+          }
+          else
+            link = &(*link)->m_next;
+        }
+      }
+    }
+  }
+
+  s_cacheInvalidations += count;
+}
+
+
+void PFileInfoCache::GetStatistics(Statistics & stats) const
+{
+  stats.m_hits = s_cacheHits.GetValue();
+  stats.m_misses = s_cacheMisses.GetValue();
+  stats.m_invalidations = s_cacheInvalidations.GetValue();
+
+  PWaitAndSignal lock(m_mutex);
+  stats.m_entries = m_entryCount;
+}
+
+
+// End Of File ///////////////////////////////////////////////////////////////
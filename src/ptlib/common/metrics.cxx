@@ -0,0 +1,391 @@
+/*
+ * metrics.cxx
+ *
+ * Run time metrics, counters, gauges and histograms.
+ *
+ * Portable Tools Library
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Portable Tools Library.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifdef __GNUC__
+#pragma implementation "metrics.h"
+#endif
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE // For sched_getcpu()
+#endif
+
+#include <ptlib.h>
+#include <ptlib/metrics.h>
+
+#if defined(P_LINUX)
+  #include <sched.h>
+#endif
+
+#include <map>
+#include <iomanip>
+
+
+#define new PNEW
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+  /* Metrics are usually static objects, so the registry must be constructed
+     by the first one to register, and so will be destroyed after the last. */
+  struct Registry
+  {
+    PCriticalSection m_mutex;
+    typedef std::multimap<PString, PMetric *> Map;
+    Map m_metrics;
+  };
+
+  static Registry & GetRegistry()
+  {
+    static Registry s_registry;
+    return s_registry;
+  }
+}
+
+
+#if defined(_MSC_VER)
+  #define PMETRIC_THREAD_LOCAL __declspec(thread)
+#else
+  #define PMETRIC_THREAD_LOCAL __thread
+#endif
+
+static PMETRIC_THREAD_LOCAL unsigned t_shardIndex; // Plus one, zero is unassigned
+
+
+PMetric::PMetric(const char * name, const char * help, const char * labels)
+  : m_name(name)
+  , m_help(help)
+  , m_labels(labels)
+{
+  Registry & registry = GetRegistry();
+  PWaitAndSignal lock(registry.m_mutex);
+  registry.m_metrics.insert(Registry::Map::value_type(m_name, this));
+}
+
+
+PMetric::~PMetric()
+{
+  Registry & registry = GetRegistry();
+  PWaitAndSignal lock(registry.m_mutex);
+  for (Registry::Map::iterator it = registry.m_metrics.find(m_name); it != registry.m_metrics.end() && it->first == m_name; ++it) {
+    if (it->second == this) {
+      registry.m_metrics.erase(it);
+      break;
+    }
+  }
+}
+
+
+unsigned PMetric::GetShardIndex()
+{
+  unsigned index = t_shardIndex;
+  if (index > 0)
+    return index - 1;
+
+  /* Pick once per thread, rather than asking which CPU we are on for every
+     update, threads mostly stay put and it costs a system call on some
+     platforms. Starting from the current CPU spreads them out as well as the
+     scheduler has. */
+  static atomic<unsigned> s_nextIndex(0);
+#if defined(P_LINUX)
+  int cpu = sched_getcpu();
+  index = cpu >= 0 ? (unsigned)cpu : s_nextIndex++;
+#else
+  index = s_nextIndex++;
+#endif
+  index %= MaxShards;
+  t_shardIndex = index + 1;
+  return index;
+}
+
+
+const char * PMetric::GetTypeName(Types type)
+{
+  static const char * const Names[] = { "counter", "gauge", "histogram" };
+  return type < PARRAYSIZE(Names) ? Names[type] : "untyped";
+}
+
+
+void PMetric::OutputSampleName(ostream & strm, const char * suffix, const char * extraLabel) const
+{
+  strm << m_name;
+  if (suffix != NULL)
+    strm << suffix;
+
+  if (m_labels.IsEmpty() && extraLabel == NULL)
+    return;
+
+  strm << '{' << m_labels;
+  if (extraLabel != NULL) {
+    if (!m_labels.IsEmpty())
+      strm << ',';
+    strm << extraLabel;
+  }
+  strm << '}';
+}
+
+
+void PMetric::OutputAllPrometheus(ostream & strm)
+{
+  std::streamsize oldPrecision = strm.precision(12);
+
+  Registry & registry = GetRegistry();
+  PWaitAndSignal lock(registry.m_mutex);
+
+  PString lastName;
+  for (Registry::Map::const_iterator it = registry.m_metrics.begin(); it != registry.m_metrics.end(); ++it) {
+    const PMetric & metric = *it->second;
+    if (metric.m_name != lastName) {
+      lastName = metric.m_name;
+      strm << "# HELP " << metric.m_name << ' ' << metric.m_help << "\n"
+              "# TYPE " << metric.m_name << ' ' << GetTypeName(metric.GetType()) << '\n';
+    }
+    metric.OutputPrometheus(strm);
+  }
+
+  strm.precision(oldPrecision);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PMetricCounter::PMetricCounter(const char * name, const char * help, const char * labels)
+  : PMetric(name, help, labels)
+{
+}
+
+
+void PMetricCounter::Inc(PUInt64 amount)
+{
+  m_shards[GetShardIndex()].m_value += amount;
+}
+
+
+PUInt64 PMetricCounter::GetValue() const
+{
+  PUInt64 value = 0;
+  for (PINDEX i = 0; i < MaxShards; ++i)
+    value += m_shards[i].m_value.load();
+  return value;
+}
+
+
+PMetric::Types PMetricCounter::GetType() const
+{
+  return Counter;
+}
+
+
+void PMetricCounter::OutputPrometheus(ostream & strm) const
+{
+  OutputSampleName(strm);
+  strm << ' ' << GetValue() << '\n';
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PMetricGauge::PMetricGauge(const char * name, const char * help, const char * labels)
+  : PMetric(name, help, labels)
+  , m_value(0)
+{
+}
+
+
+PMetric::Types PMetricGauge::GetType() const
+{
+  return Gauge;
+}
+
+
+void PMetricGauge::OutputPrometheus(ostream & strm) const
+{
+  OutputSampleName(strm);
+  strm << ' ' << GetValue() << '\n';
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+PMetricHistogram::PMetricHistogram(const char * name,
+                                   const char * help,
+                                   const char * labels,
+                                   double outputScale,
+                                   unsigned firstExponent,
+                                   unsigned lastExponent)
+  : PMetric(name, help, labels)
+  , m_outputScale(outputScale)
+  , m_firstExponent(std::min(firstExponent, (unsigned)MaxExponent))
+  , m_lastExponent(std::min(std::max(firstExponent, lastExponent), (unsigned)MaxExponent))
+{
+}
+
+
+static __inline unsigned HighestBit(PUInt64 value)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  unsigned bit = 0;
+  while ((value >>= 1) != 0)
+    ++bit;
+  return bit;
+#endif
+}
+
+
+unsigned PMetricHistogram::GetBucketIndex(PUInt64 value)
+{
+  if (value < SubBuckets)
+    return (unsigned)value;
+
+  unsigned exponent = HighestBit(value);
+  if (exponent >= MaxExponent)
+    return NumBuckets - 1;
+
+  // The top bit is implied by the exponent, the next three pick the sub-bucket
+  return (exponent - SubBucketBits + 1)*SubBuckets + (unsigned)((value >> (exponent - SubBucketBits)) & (SubBuckets - 1));
+}
+
+
+PUInt64 PMetricHistogram::GetBucketLowest(unsigned index)
+{
+  if (index < SubBuckets)
+    return index;
+
+  unsigned exponent = index/SubBuckets + SubBucketBits - 1;
+  return (PUInt64)(SubBuckets + index%SubBuckets) << (exponent - SubBucketBits);
+}
+
+
+void PMetricHistogram::Record(PUInt64 value)
+{
+  Shard & shard = m_shards[GetShardIndex() % NumShards];
+  ++shard.m_buckets[GetBucketIndex(value)];
+  shard.m_sum += value;
+}
+
+
+void PMetricHistogram::Record(const PTimeInterval & duration)
+{
+  PInt64 ns = duration.GetNanoSeconds();
+  Record(ns > 0 ? (PUInt64)ns : 0);
+}
+
+
+void PMetricHistogram::GetBuckets(PUInt64 * buckets) const
+{
+  memset(buckets, 0, NumBuckets*sizeof(PUInt64));
+  for (PINDEX s = 0; s < NumShards; ++s) {
+    for (PINDEX i = 0; i < NumBuckets; ++i)
+      buckets[i] += m_shards[s].m_buckets[i].load();
+  }
+}
+
+
+PUInt64 PMetricHistogram::GetCount() const
+{
+  PUInt64 buckets[NumBuckets];
+  GetBuckets(buckets);
+
+  PUInt64 count = 0;
+  for (PINDEX i = 0; i < NumBuckets; ++i)
+    count += buckets[i];
+  return count;
+}
+
+
+PUInt64 PMetricHistogram::GetSum() const
+{
+  PUInt64 sum = 0;
+  for (PINDEX s = 0; s < NumShards; ++s)
+    sum += m_shards[s].m_sum.load();
+  return sum;
+}
+
+
+PUInt64 PMetricHistogram::GetPercentile(double fraction) const
+{
+  PUInt64 buckets[NumBuckets];
+  GetBuckets(buckets);
+
+  PUInt64 count = 0;
+  for (PINDEX i = 0; i < NumBuckets; ++i)
+    count += buckets[i];
+  if (count == 0)
+    return 0;
+
+  PUInt64 target = (PUInt64)(fraction*count + 0.5);
+  if (target < 1)
+    target = 1;
+
+  PUInt64 cumulative = 0;
+  for (unsigned i = 0; i < NumBuckets-1; ++i) {
+    cumulative += buckets[i];
+    if (cumulative >= target)
+      return GetBucketLowest(i+1) - 1;
+  }
+
+  return GetBucketLowest(NumBuckets-1);
+}
+
+
+PMetric::Types PMetricHistogram::GetType() const
+{
+  return Histogram;
+}
+
+
+void PMetricHistogram::OutputPrometheus(ostream & strm) const
+{
+  PUInt64 buckets[NumBuckets];
+  GetBuckets(buckets);
+
+  /* Values below 2^n are in buckets below the index of 2^n, as powers of two
+     always start a bucket, so a boundary never splits one. */
+  PUInt64 cumulative = 0;
+  unsigned index = 0;
+  for (unsigned exponent = m_firstExponent; exponent <= m_lastExponent; ++exponent) {
+    PUInt64 boundary = (PUInt64)1 << exponent;
+    unsigned limit = exponent < MaxExponent ? GetBucketIndex(boundary) : NumBuckets;
+    while (index < limit)
+      cumulative += buckets[index++];
+
+    OutputSampleName(strm, "_bucket", PSTRSTRM("le=\"" << std::setprecision(12) << boundary*m_outputScale << '"'));
+    strm << ' ' << cumulative << '\n';
+  }
+
+  while (index < NumBuckets)
+    cumulative += buckets[index++];
+
+  OutputSampleName(strm, "_bucket", "le=\"+Inf\"");
+  strm << ' ' << cumulative << '\n';
+
+  OutputSampleName(strm, "_sum");
+  strm << ' ' << GetSum()*m_outputScale << '\n';
+
+  OutputSampleName(strm, "_count");
+  strm << ' ' << cumulative << '\n';
+}
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -30,40 +30,128 @@
 
 #include <ptlib.h>
 #include <ptlib/notifier_ext.h>
-#include <ptlib/semaphor.h>
-#include <ptlib/id_generator.h>
+#include <ptlib/syncpoint.h>
 
-#include <set>
 #include <map>
-#include <queue>
 
 
 //////////////////////////////////////////////////////////////////////////////
 
-static PIdGenerator s_ValidatedTargets;
+/* Table of notifier targets by identifier. The table is split into shards,
+   selected by identifier, each with their own mutex, so looking up one
+   target does not contend with the creation, destruction or look up of most
+   other targets.
+ */
+template <class Value>
+class PNotifierTargetTable
+{
+  protected:
+    enum { NumShards = 64 };
+
+    struct Shard
+    {
+      PCriticalSection m_mutex;
+      typedef std::map<PNotifierIdentifer, Value> Map;
+      Map m_targets;
+    };
+
+    Shard                      m_shards[NumShards];
+    atomic<PNotifierIdentifer> m_nextId;
+    unsigned                   m_state; // 0 = pre-constructor, 1 = active, 2 = destroyed
+
+    Shard & GetShard(PNotifierIdentifer id) { return m_shards[id%NumShards]; }
+
+  public:
+    PNotifierTargetTable()
+      : m_nextId(0)
+      , m_state(1)
+    {
+    }
+
+
+    ~PNotifierTargetTable()
+    {
+      m_state = 2;
+    }
+
+
+    bool IsActive() const { return m_state == 1; }
+
+
+    PNotifierIdentifer Add(const Value & value)
+    {
+      if (m_state != 1)
+        return 0;
+
+      for (;;) {
+        PNotifierIdentifer id = ++m_nextId;
+        if (id != 0) {
+          Shard & shard = GetShard(id);
+          PWaitAndSignal mutex(shard.m_mutex);
+          if (shard.m_targets.insert(typename Shard::Map::value_type(id, value)).second)
+            return id;
+        }
+      }
+    }
+
+
+    bool Remove(PNotifierIdentifer id, Value * value = NULL)
+    {
+      if (m_state != 1 || id == 0)
+        return false;
+
+      Shard & shard = GetShard(id);
+      PWaitAndSignal mutex(shard.m_mutex);
+
+      typename Shard::Map::iterator it = shard.m_targets.find(id);
+      if (it == shard.m_targets.end())
+        return false;
+
+      if (value != NULL)
+        *value = it->second;
+      shard.m_targets.erase(it);
+      return true;
+    }
+
+
+    bool Contains(PNotifierIdentifer id)
+    {
+      if (m_state != 1 || id == 0)
+        return false;
+
+      Shard & shard = GetShard(id);
+      PWaitAndSignal mutex(shard.m_mutex);
+      return shard.m_targets.find(id) != shard.m_targets.end();
+    }
+};
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+static PNotifierTargetTable<bool> s_ValidatedTargets;
 
 
 PValidatedNotifierTarget::PValidatedNotifierTarget()
 {
-  m_validatedNotifierId = s_ValidatedTargets.Create();
+  m_validatedNotifierId = s_ValidatedTargets.Add(true);
 }
 
 
 PValidatedNotifierTarget::PValidatedNotifierTarget(const PValidatedNotifierTarget&)
 {
-  m_validatedNotifierId = s_ValidatedTargets.Create();
+  m_validatedNotifierId = s_ValidatedTargets.Add(true);
 }
 
 
 PValidatedNotifierTarget::~PValidatedNotifierTarget()
 {
-  s_ValidatedTargets.Release(m_validatedNotifierId);
+  s_ValidatedTargets.Remove(m_validatedNotifierId);
 }
 
 
 bool PValidatedNotifierTarget::Exists(PNotifierIdentifer id)
 {
-  if (s_ValidatedTargets.IsValid(id))
+  if (s_ValidatedTargets.Contains(id))
     return true;
 
   PTRACE(2, "Notify", "Target no longer valid, id=" << id);
@@ -73,144 +161,159 @@ bool PValidatedNotifierTarget::Exists(PNotifierIdentifer id)
 
 //////////////////////////////////////////////////////////////////////////////
 
-class PAsyncNotifierQueue : std::queue<PAsyncNotifierCallback *>
+/* The queue for a single target. Producers push onto a lock free stack,
+   which the consumer takes in one exchange and reverses to get the
+   callbacks in the order they were queued. Only the transition from empty
+   to not empty needs to wake the consumer.
+ */
+class PAsyncNotifierQueue
 {
-  PSemaphore             m_count;
-  PAsyncNotifierTarget * m_target;
+  atomic<PAsyncNotifierCallback *> m_incoming;
+  atomic<PAsyncNotifierTarget *>   m_target;
+  atomic<unsigned>                 m_producers;
+  PSyncPoint                       m_available;
+  PCriticalSection                 m_consumerMutex;
+  PAsyncNotifierCallback         * m_pending;
 
 public:
   PAsyncNotifierQueue(PAsyncNotifierTarget * target)
-    : m_count(0, INT_MAX)
+    : m_incoming(NULL)
     , m_target(target)
+    , m_producers(0)
+    , m_pending(NULL)
   {
   }
 
 
   ~PAsyncNotifierQueue()
   {
-    m_target = NULL;
+    DeleteList(m_incoming.exchange(NULL));
+    DeleteList(m_pending);
   }
 
 
-  void Queue(PAsyncNotifierCallback * callback)
+  static void DeleteList(PAsyncNotifierCallback * callback)
   {
-    push(callback);
-    m_count.Signal();
-    m_target->AsyncNotifierSignal();
+    while (callback != NULL) {
+      PAsyncNotifierCallback * next = callback->m_nextCallback;
+      delete callback;
+      callback = next;
+    }
   }
 
 
-  PAsyncNotifierCallback * GetCallback(PAsyncNotifierTarget * target, const PTimeInterval & wait)
+  // Must be called with the table shard locked, so Close() cannot miss us
+  void AddProducer()
   {
-    if (!PAssert(target == m_target, "PAsyncNotifier mismatch"))
-      return NULL;
+    ++m_producers;
+  }
 
-    if (!m_count.Wait(wait))
-      return NULL;
-    
-    if (!PAssert(!empty(), "PAsyncNotifier queue empty"))
-      return NULL;
 
-    PAsyncNotifierCallback * callback = front();
-    pop();
+  void Queue(PAsyncNotifierCallback * callback)
+  {
+    PAsyncNotifierTarget * target = m_target;
+    if (target == NULL)
+      delete callback;
+    else {
+      PAsyncNotifierCallback * head;
+      do {
+        head = m_incoming;
+        callback->m_nextCallback = head;
+      } while (!m_incoming.compare_exchange_strong(head, callback));
 
-    if (!PAssert(callback != NULL, "PAsyncNotifier callback NULL"))
-      return NULL;
+      if (head == NULL)
+        m_available.Signal();
 
-    return callback;
-  }
-};
+      target->AsyncNotifierSignal();
+    }
 
+    --m_producers;
+  }
 
-class PAsyncNotifierQueueMap : std::map<PNotifierIdentifer, PAsyncNotifierQueue>
-{
-  unsigned m_state; // 0 = pre-constructor, 1 = active, 2 = destroyed
-  unsigned m_nextId;
-  PDECLARE_MUTEX(m_mutex);
 
-public:
-  PAsyncNotifierQueueMap()
-    : m_state(1)
-    , m_nextId(1)
+  // Called after removal from table, waits for any producer still using us.
+  void Close()
   {
+    m_target = NULL;
+    while (m_producers != 0)
+      PThread::Yield();
   }
 
 
-  ~PAsyncNotifierQueueMap()
+  PAsyncNotifierCallback * GetCallback()
   {
-    m_state = 2;
+    PWaitAndSignal mutex(m_consumerMutex);
+
+    if (m_pending == NULL) {
+      PAsyncNotifierCallback * list = m_incoming.exchange(NULL);
+      while (list != NULL) {
+        PAsyncNotifierCallback * next = list->m_nextCallback;
+        list->m_nextCallback = m_pending;
+        m_pending = list;
+        list = next;
+      }
+
+      if (m_pending == NULL)
+        return NULL;
+    }
+
+    PAsyncNotifierCallback * callback = m_pending;
+    m_pending = callback->m_nextCallback;
+    return callback;
   }
 
 
-  PNotifierIdentifer Add(PAsyncNotifierTarget * target)
+  unsigned Execute(PAsyncNotifierTarget * target, unsigned maxCount, const PTimeInterval & wait)
   {
-    if (m_state != 1)
+    if (!PAssert(target == m_target, "PAsyncNotifier mismatch"))
       return 0;
 
-    PNotifierIdentifer id;
+    PTimeInterval timeout = wait;
+    PTimeInterval start = PTimer::Tick();
 
-    m_mutex.Wait();
+    unsigned count = 0;
+    for (;;) {
+      while (count < maxCount) {
+        PAsyncNotifierCallback * callback = GetCallback();
+        if (callback == NULL)
+          break;
 
-    do {
-      id = m_nextId++;
-    } while (!insert(value_type(id, target)).second);
+        callback->Call();
+        delete callback;
+        ++count;
+      }
 
-    m_mutex.Signal();
+      if (count > 0 || timeout <= 0 || !m_available.Wait(timeout))
+        return count;
 
-    return id;
-  }
-
-
-  void Remove(PNotifierIdentifer id)
-  {
-    if (m_state != 1)
-      return;
-
-    m_mutex.Wait();
-
-    erase(id);
-
-    m_mutex.Signal();
+      if (wait != PMaxTimeInterval)
+        timeout = wait - (PTimer::Tick() - start);
+    }
   }
+};
 
 
+class PAsyncNotifierQueueMap : public PNotifierTargetTable<PAsyncNotifierQueue *>
+{
+public:
   void Queue(PNotifierIdentifer id, PAsyncNotifierCallback * callback)
   {
-    if (m_state != 1)
-      return;
-
-    m_mutex.Wait();
-
-    iterator it = find(id);
-    if (it == end())
-      delete callback;
+    PAsyncNotifierQueue * queue = NULL;
+
+    if (m_state == 1) {
+      Shard & shard = GetShard(id);
+      PWaitAndSignal mutex(shard.m_mutex);
+      Shard::Map::iterator it = shard.m_targets.find(id);
+      if (it != shard.m_targets.end()) {
+        queue = it->second;
+        queue->AddProducer();
+      }
+    }
+
+    if (queue != NULL)
+      queue->Queue(callback);
     else
-      it->second.Queue(callback);
-
-    m_mutex.Signal();
-  }
-
-
-  bool Execute(PNotifierIdentifer id, PAsyncNotifierTarget * target, const PTimeInterval & wait)
-  {
-    if (m_state != 1)
-      return false;
-
-    PAsyncNotifierCallback * callback = NULL;
-
-    m_mutex.Wait();
-
-    iterator it = find(id);
-    if (PAssert(it != end(), "PAsyncNotifier missing"))
-      callback = it->second.GetCallback(target, wait);
-
-    m_mutex.Signal();
-
-    if (callback == NULL)
-      return false;
-
-    callback->Call();
-    return true;
+      delete callback;
   }
 };
 
@@ -218,14 +321,17 @@ static PAsyncNotifierQueueMap s_AsyncTargetQueues;
 
 
 PAsyncNotifierTarget::PAsyncNotifierTarget()
+  : m_asyncNotifierQueue(new PAsyncNotifierQueue(this))
 {
-  m_asyncNotifierId = s_AsyncTargetQueues.Add(this);
+  m_asyncNotifierId = s_AsyncTargetQueues.Add(m_asyncNotifierQueue);
 }
 
 
 PAsyncNotifierTarget::~PAsyncNotifierTarget()
 {
   s_AsyncTargetQueues.Remove(m_asyncNotifierId);
+  m_asyncNotifierQueue->Close();
+  delete m_asyncNotifierQueue;
 }
 
 
@@ -237,7 +343,13 @@ void PAsyncNotifierCallback::Queue(PNotifierIdentifer id, PAsyncNotifierCallback
 
 bool PAsyncNotifierTarget::AsyncNotifierExecute(const PTimeInterval & wait)
 {
-  return s_AsyncTargetQueues.Execute(m_asyncNotifierId, this, wait);
+  return m_asyncNotifierQueue->Execute(this, 1, wait) > 0;
+}
+
+
+unsigned PAsyncNotifierTarget::AsyncNotifierExecuteBatch(unsigned maxCount, const PTimeInterval & wait)
+{
+  return m_asyncNotifierQueue->Execute(this, maxCount, wait);
 }
 
 
@@ -1544,24 +1544,19 @@ namespace PProfiling
     e_SystemExit
   };
 
-  struct FunctionRawData : PNonCopyable
+  struct FunctionRawData
   {
-    PPROFILE_EXCLUDE(FunctionRawData(FunctionType type, void * function, void * caller));
-    PPROFILE_EXCLUDE(FunctionRawData(FunctionType type, const PDebugLocation * location));
-
-    PPROFILE_EXCLUDE(void Dump(ostream & out) const);
-
-    // Do not use memory check allocation
-    PPROFILE_EXCLUDE(void * operator new(size_t nSize));
-    PPROFILE_EXCLUDE(void operator delete(void * ptr));
+    PPROFILE_EXCLUDE(void Dump(ostream & out, PUniqueThreadIdentifier threadId) const);
+    PPROFILE_EXCLUDE(bool IsEntry() const);
+    PPROFILE_EXCLUDE(std::string GetName() const);
 
     union
     {
       // Note for correct operation m_pointer must overlay m_name
       struct
       {
-        void * m_pointer;
-        void * m_caller;
+        const void * m_pointer;
+        const void * m_caller;
       };
       struct
       {
@@ -1571,11 +1566,40 @@ namespace PProfiling
       };
     } m_function;
 
-    FunctionType            m_type;
-    PThreadIdentifier       m_threadIdentifier;
-    PUniqueThreadIdentifier m_threadUniqueId;
-    uint64_t                m_when;
-    FunctionRawData       * m_link;
+    FunctionType m_type;
+    uint64_t     m_when;
+  };
+
+
+  /* Events for one thread, which is the only writer, so no locking is
+     needed when recording. Readers should wait until profiling is disabled,
+     or some of the most recent events may be missed or half written.
+     Buffers are never freed while running, as the thread may still write,
+     but those of ended threads are re-used after a Reset().
+   */
+  struct ThreadBuffer : PNonCopyable
+  {
+    PPROFILE_EXCLUDE(ThreadBuffer(unsigned size));
+    PPROFILE_EXCLUDE(~ThreadBuffer());
+
+    PPROFILE_EXCLUDE(void Start(unsigned generation));
+    PPROFILE_EXCLUDE(void Add(FunctionType type, const void * function, const void * caller, unsigned line));
+    PPROFILE_EXCLUDE(uint64_t GetFirst() const);
+    PPROFILE_EXCLUDE(const FunctionRawData & GetEvent(uint64_t index) const) { return m_events[index & m_mask]; }
+
+    // Do not use memory check allocation
+    PPROFILE_EXCLUDE(void * operator new(size_t nSize));
+    PPROFILE_EXCLUDE(void operator delete(void * ptr));
+
+    PThreadIdentifier       m_threadId;
+    PUniqueThreadIdentifier m_uniqueId;
+    FunctionRawData       * m_events;
+    uint64_t                m_mask;
+    volatile uint64_t       m_count;       // Events added since Start(), including overflows
+    volatile uint64_t       m_overflows;
+    volatile unsigned       m_generation;
+    atomic<bool>            m_ended;
+    ThreadBuffer          * m_link;
   };
 
 
@@ -1606,62 +1630,172 @@ namespace PProfiling
     PPROFILE_EXCLUDE(Database());
     PPROFILE_EXCLUDE(~Database());
 
+    PPROFILE_EXCLUDE(ThreadBuffer * GetBuffer(ThreadBuffer * current));
+    PPROFILE_EXCLUDE(bool IsCurrent(const ThreadBuffer & buffer) const) { return buffer.m_generation == m_generation; }
+
     bool     m_enabled;
-    atomic<FunctionRawData *> m_functions;
+    volatile OverflowPolicy   m_overflowPolicy;
+    unsigned                  m_bufferSize;
+    volatile unsigned         m_generation;
+    atomic<ThreadBuffer *>    m_buffers;
     atomic<ThreadRawData *>   m_threads;
     uint64_t m_start;
+    PCriticalSection          m_mutex; // Reset() deletes m_threads from under the readers
   };
   static Database s_database;
 
 
+#if defined(_MSC_VER)
+  #define PPROFILE_THREAD_LOCAL __declspec(thread)
+#else
+  #define PPROFILE_THREAD_LOCAL __thread
+#endif
+
+  static PPROFILE_THREAD_LOCAL ThreadBuffer * t_buffer;
+  static PPROFILE_THREAD_LOCAL bool t_gettingBuffer;
+
+  PPROFILE_EXCLUDE(static void AddEvent(FunctionType type, const void * function, const void * caller = NULL, unsigned line = 0));
+
+  static void AddEvent(FunctionType type, const void * function, const void * caller, unsigned line)
+  {
+    ThreadBuffer * buffer = t_buffer;
+    if (buffer == NULL || !s_database.IsCurrent(*buffer)) {
+      // Getting a buffer may call instrumented functions, which would recurse
+      if (t_gettingBuffer)
+        return;
+      t_gettingBuffer = true;
+      t_buffer = buffer = s_database.GetBuffer(buffer);
+      t_gettingBuffer = false;
+    }
+
+    buffer->Add(type, function, caller, line);
+  }
+
+
   /////////////////////////////////////////////////////////////////////
 
-  FunctionRawData::FunctionRawData(FunctionType type, void * function, void * caller)
-    : m_type(type)
-    , m_threadIdentifier(PThread::GetCurrentThreadId())
-    , m_threadUniqueId(PThread::GetCurrentUniqueIdentifier())
-    , m_when(GetCycles())
+  ThreadBuffer::ThreadBuffer(unsigned size)
+    : m_threadId(PThread::GetCurrentThreadId())
+    , m_uniqueId(PThread::GetCurrentUniqueIdentifier())
+    , m_events((FunctionRawData *)runtime_malloc(size*sizeof(FunctionRawData)))
+    , m_mask(size-1)
+    , m_count(0)
+    , m_overflows(0)
+    , m_generation(0)
+    , m_ended(false)
+    , m_link(NULL)
   {
-    m_function.m_pointer = function;
-    m_function.m_caller = caller;
+  }
+
 
-    m_link = s_database.m_functions.exchange(this);
+  ThreadBuffer::~ThreadBuffer()
+  {
+    runtime_free(m_events);
   }
 
 
-  FunctionRawData::FunctionRawData(FunctionType type, const PDebugLocation * location)
-    : m_type(type)
-    , m_threadIdentifier(PThread::GetCurrentThreadId())
-    , m_threadUniqueId(PThread::GetCurrentUniqueIdentifier())
-    , m_when(GetCycles())
+  void ThreadBuffer::Start(unsigned generation)
   {
-    if (location) {
-      m_function.m_name = location->m_extra;
-      m_function.m_file = location->m_file;
-      m_function.m_line = location->m_line;
-    }
-    else {
-      m_function.m_name = NULL;
-      m_function.m_file = NULL;
-      m_function.m_line = 0;
+    m_count = 0;
+    m_overflows = 0;
+    m_generation = generation;
+  }
+
+
+  void ThreadBuffer::Add(FunctionType type, const void * function, const void * caller, unsigned line)
+  {
+    uint64_t count = m_count;
+    if (count > m_mask) {
+      ++m_overflows;
+      if (s_database.m_overflowPolicy == DiscardNewest)
+        return;
     }
 
-    m_link = s_database.m_functions.exchange(this);
+    FunctionRawData & data = m_events[count & m_mask];
+    data.m_function.m_pointer = function;
+    data.m_function.m_caller = caller;
+    data.m_function.m_line = line;
+    data.m_type = type;
+    data.m_when = GetCycles();
+
+    m_count = count + 1;
   }
 
 
-  void * FunctionRawData::operator new(size_t nSize)
+  uint64_t ThreadBuffer::GetFirst() const
   {
-    return runtime_malloc(nSize);
+    uint64_t count = m_count;
+    return count > m_mask ? count - m_mask - 1 : 0;
+  }
+
 
+  void * ThreadBuffer::operator new(size_t nSize)
+  {
+    return runtime_malloc(nSize);
   }
-  void FunctionRawData::operator delete(void * ptr)
+
+
+  void ThreadBuffer::operator delete(void * ptr)
   {
     runtime_free(ptr);
   }
 
 
-   void FunctionRawData::Dump(ostream & out) const
+  ThreadBuffer * Database::GetBuffer(ThreadBuffer * buffer)
+  {
+    if (buffer == NULL) {
+      // Use one from a thread that ended before the last Reset()
+      for (buffer = m_buffers; buffer != NULL; buffer = buffer->m_link) {
+        bool ended = true;
+        if (!IsCurrent(*buffer) && buffer->m_ended.compare_exchange_strong(ended, false)) {
+          buffer->m_threadId = PThread::GetCurrentThreadId();
+          buffer->m_uniqueId = PThread::GetCurrentUniqueIdentifier();
+          break;
+        }
+      }
+
+      if (buffer == NULL) {
+        buffer = new ThreadBuffer(m_bufferSize);
+        ThreadBuffer * head = m_buffers;
+        do {
+          buffer->m_link = head;
+        } while (!m_buffers.compare_exchange_strong(head, buffer));
+      }
+    }
+
+    buffer->Start(m_generation);
+    return buffer;
+  }
+
+
+  /////////////////////////////////////////////////////////////////////
+
+  bool FunctionRawData::IsEntry() const
+  {
+    return m_type == e_AutoEntry || m_type == e_ManualEntry || m_type == e_SystemEntry;
+  }
+
+
+  std::string FunctionRawData::GetName() const
+  {
+    switch (m_type) {
+      case e_ManualEntry:
+      case e_ManualExit:
+        return m_function.m_name != NULL ? m_function.m_name : "";
+
+      case e_SystemEntry:
+      case e_SystemExit:
+        return "System";
+
+      default:
+        stringstream strm;
+        strm << m_function.m_pointer;
+        return strm.str();
+    }
+  }
+
+
+  void FunctionRawData::Dump(ostream & out, PUniqueThreadIdentifier threadId) const
   {
     switch (m_type) {
       case e_AutoEntry:
@@ -1676,11 +1810,17 @@ namespace PProfiling
       case e_ManualExit:
         out << "ManualExit\t" << m_function.m_name << '\t';
         break;
+      case e_SystemEntry:
+        out << "SystemEnter\t\t";
+        break;
+      case e_SystemExit:
+        out << "SystemExit\t\t";
+        break;
       default :
         PAssertAlways(PLogicError);
     }
 
-    out << '\t' << m_threadUniqueId << '\t' << m_when << '\n';
+    out << '\t' << threadId << '\t' << m_when << '\n';
   }
 
 
@@ -1716,6 +1856,15 @@ namespace PProfiling
 
   void OnThreadEnded(const PThread & thread, const PTimeInterval & realTime, const PTimeInterval & systemCPU, const PTimeInterval & userCPU)
   {
+    // Allow the buffer to be re-used, once its events are no longer wanted
+    PUniqueThreadIdentifier uniqueId = thread.GetUniqueIdentifier();
+    for (ThreadBuffer * buffer = s_database.m_buffers; buffer != NULL; buffer = buffer->m_link) {
+      if (buffer->m_uniqueId == uniqueId && !buffer->m_ended) {
+        buffer->m_ended = true;
+        break;
+      }
+    }
+
     if (s_database.m_enabled) {
       ThreadRawData * info = new ThreadRawData(thread.GetThreadId(),
                                                thread.GetUniqueIdentifier(),
@@ -1734,31 +1883,52 @@ namespace PProfiling
     : m_location(location)
   {
     if (s_database.m_enabled)
-      new FunctionRawData(e_ManualEntry, &location);
+      AddEvent(e_ManualEntry, location.m_extra, location.m_file, location.m_line);
   }
 
 
   Block::~Block()
   {
     if (s_database.m_enabled)
-      new FunctionRawData(e_ManualExit, &m_location);
+      AddEvent(e_ManualExit, m_location.m_extra, m_location.m_file, m_location.m_line);
   }
 
 
   /////////////////////////////////////////////////////////////////////
 
+  PPROFILE_EXCLUDE(static unsigned RoundBufferSize(unsigned events));
+
+  static unsigned RoundBufferSize(unsigned events)
+  {
+    unsigned size = 16;
+    while (size < events && size < 0x80000000)
+      size <<= 1;
+    return size;
+  }
+
+
   Database::Database()
     : m_enabled(getenv("PTLIB_PROFILING_ENABLED") != NULL)
-    , m_functions(NULL)
+    , m_overflowPolicy(OverwriteOldest)
+    , m_bufferSize(65536)
+    , m_generation(1)
+    , m_buffers(NULL)
     , m_threads(NULL)
     , m_start(GetCycles())
   {
+    const char * env;
+    if ((env = getenv("PTLIB_PROFILING_BUFFER_SIZE")) != NULL)
+      m_bufferSize = RoundBufferSize(atoi(env));
+    if ((env = getenv("PTLIB_PROFILING_OVERFLOW")) != NULL && strcmp(env, "discard") == 0)
+      m_overflowPolicy = DiscardNewest;
   }
 
 
   Database::~Database()
   {
-    if (static_cast<FunctionRawData *>(m_functions) == NULL)
+    m_enabled = false;
+
+    if (static_cast<ThreadBuffer *>(m_buffers) == NULL)
       return;
 
     const char * filename;
@@ -1775,7 +1945,21 @@ namespace PProfiling
         Analyse(out, strstr(filename, ".html") != NULL);
     }
 
+    if ((filename = getenv("PTLIB_PROFILING_TRACE_FILENAME")) != NULL) {
+      ofstream out(filename, ios::out | ios::trunc | ios::binary);
+      if (out.is_open())
+        ExportTrace(out, strstr(filename, ".pftrace") != NULL || strstr(filename, ".perfetto-trace") != NULL
+                                                              ? PerfettoProtobuf : ChromeTraceJSON);
+    }
+
     Reset();
+
+    ThreadBuffer * buffer = m_buffers.exchange(NULL);
+    while (buffer != NULL) {
+      ThreadBuffer * del = buffer;
+      buffer = buffer->m_link;
+      delete del;
+    }
   }
 
 
@@ -1791,18 +1975,51 @@ namespace PProfiling
   }
 
 
-  void Reset()
+  void SetOverflowPolicy(OverflowPolicy policy)
   {
-    s_database.m_start = GetCycles();
-    ThreadRawData * thrd = s_database.m_threads.exchange(NULL);
-    FunctionRawData * func = s_database.m_functions.exchange(NULL);
+    s_database.m_overflowPolicy = policy;
+  }
 
-    while (func != NULL) {
-      FunctionRawData * del = func;
-      func = func->m_link;
-      delete del;
+
+  OverflowPolicy GetOverflowPolicy()
+  {
+    return s_database.m_overflowPolicy;
+  }
+
+
+  void SetBufferSize(unsigned events)
+  {
+    s_database.m_bufferSize = RoundBufferSize(events);
+  }
+
+
+  unsigned GetBufferSize()
+  {
+    return s_database.m_bufferSize;
+  }
+
+
+  void GetEventCounts(uint64_t & held, uint64_t & overflowed)
+  {
+    held = overflowed = 0;
+    for (ThreadBuffer * buffer = s_database.m_buffers; buffer != NULL; buffer = buffer->m_link) {
+      if (s_database.IsCurrent(*buffer)) {
+        held += buffer->m_count - buffer->GetFirst();
+        overflowed += buffer->m_overflows;
+      }
     }
+  }
 
+
+  void Reset()
+  {
+    /* Each thread restarts its own buffer when it sees the new generation,
+       so we do not touch a buffer that may be being written to. */
+    PWaitAndSignal lock(s_database.m_mutex);
+    s_database.m_start = GetCycles();
+    ++s_database.m_generation;
+
+    ThreadRawData * thrd = s_database.m_threads.exchange(NULL);
     while (thrd != NULL) {
       ThreadRawData * del = thrd;
       thrd = thrd->m_link;
@@ -1814,23 +2031,29 @@ namespace PProfiling
   void PreSystem()
   {
     if (s_database.m_enabled)
-      new FunctionRawData(e_SystemEntry, NULL);
+      AddEvent(e_SystemEntry, NULL);
   }
 
 
   void PostSystem()
   {
     if (s_database.m_enabled)
-      new FunctionRawData(e_SystemExit, NULL);
+      AddEvent(e_SystemExit, NULL);
   }
 
 
   void Dump(ostream & strm)
   {
+    PWaitAndSignal lock(s_database.m_mutex);
     for (ThreadRawData * info = s_database.m_threads; info != NULL; info = info->m_link)
       info->Dump(strm);
-    for (FunctionRawData * info = s_database.m_functions; info != NULL; info = info->m_link)
-      info->Dump(strm);
+    for (ThreadBuffer * buffer = s_database.m_buffers; buffer != NULL; buffer = buffer->m_link) {
+      if (s_database.IsCurrent(*buffer)) {
+        uint64_t count = buffer->m_count;
+        for (uint64_t i = buffer->GetFirst(); i < count; ++i)
+          buffer->GetEvent(i).Dump(strm, buffer->m_uniqueId);
+      }
+    }
   }
 
 
@@ -2066,8 +2289,15 @@ namespace PProfiling
     return threadByID.insert(make_pair(times.m_uniqueId, threadInfo)).first;
   }
 
+  struct ActiveFunction
+  {
+    const FunctionRawData * m_entry;
+    uint64_t                m_subFunctions;
+  };
+
   void Analyse(Analysis & analysis)
   {
+    PWaitAndSignal lock(s_database.m_mutex);
     analysis.m_durationCycles = GetCycles() - s_database.m_start;
 
     std::list<PThread::Times> times;
@@ -2078,70 +2308,58 @@ namespace PProfiling
     for (ThreadRawData * thrd = s_database.m_threads; thrd != NULL; thrd = thrd->m_link)
       analysis.m_threadByID.insert(make_pair(thrd->m_uniqueId, *thrd));
 
-    for (FunctionRawData * exit = s_database.m_functions; exit != NULL; exit = exit->m_link) {
-      std::string functionName;
-      switch (exit->m_type) {
-        default :
-          continue;
-
-        case e_ManualExit:
-          functionName = exit->m_function.m_name;
-          break;
-
-        case e_AutoExit:
-          stringstream strm;
-          strm << exit->m_function.m_pointer;
-          functionName = strm.str();
-          break;
-      }
+    std::vector<ActiveFunction> stack;
+    for (ThreadBuffer * buffer = s_database.m_buffers; buffer != NULL; buffer = buffer->m_link) {
+      if (!s_database.IsCurrent(*buffer))
+        continue;
 
-      uint64_t subFunctionAccumulator = 0;
+      ThreadByID::iterator thrd = analysis.m_threadByID.end();
+      stack.clear();
 
-      // Find the next entry in that thread
-      FunctionRawData * entry;
-      for (entry = exit->m_link; entry != NULL; entry = entry->m_link) {
-        if (entry->m_threadUniqueId != exit->m_threadUniqueId)
+      uint64_t count = buffer->m_count;
+      for (uint64_t i = buffer->GetFirst(); i < count; ++i) {
+        const FunctionRawData & event = buffer->GetEvent(i);
+        if (event.IsEntry()) {
+          ActiveFunction active = { &event, 0 };
+          stack.push_back(active);
           continue;
+        }
 
-        switch (entry->m_type) {
-          case e_ManualEntry :
-          case e_AutoEntry:
-          case e_SystemEntry :
-            if (entry->m_function.m_pointer == exit->m_function.m_pointer)
-              break;
-            continue; // Should not happen!
+        if (stack.empty())
+          continue; // Entry was overwritten
 
-          default :
-            // Have an exit, so look for matching entry
-            FunctionRawData * subEntry;
-            for (subEntry = entry->m_link; subEntry != NULL; subEntry = subEntry->m_link) {
-              if (subEntry->m_threadUniqueId == entry->m_threadUniqueId && subEntry->m_function.m_pointer == entry->m_function.m_pointer)
-                break;
-            }
-            if (subEntry == NULL)
-              continue; // Should not happen!
+        ActiveFunction active = stack.back();
+        stack.pop_back();
 
-            // Amount of time in sub-function, subtract it off later
-            subFunctionAccumulator += entry->m_when - subEntry->m_when;
-            entry = subEntry;
-            continue;
-        }
+        // Amount of time in sub-function, subtract it off the caller
+        uint64_t elapsed = event.m_when - active.m_entry->m_when;
+        if (!stack.empty())
+          stack.back().m_subFunctions += elapsed;
+
+        if (event.m_type == e_SystemExit)
+          continue;
 
-        ThreadByID::iterator thrd = analysis.m_threadByID.find(entry->m_threadUniqueId);
         if (thrd == analysis.m_threadByID.end()) {
-          PThread::Times threadTimes;
-          PThread::GetTimes(entry->m_threadIdentifier, threadTimes);
-          thrd = AddThreadByID(analysis.m_threadByID, threadTimes);
+          thrd = analysis.m_threadByID.find(buffer->m_uniqueId);
+          if (thrd == analysis.m_threadByID.end()) {
+            PThread::Times threadTimes;
+            if (!PThread::GetTimes(buffer->m_threadId, threadTimes)) {
+              threadTimes.m_threadId = buffer->m_threadId;
+              threadTimes.m_uniqueId = buffer->m_uniqueId;
+            }
+            thrd = AddThreadByID(analysis.m_threadByID, threadTimes);
+          }
         }
 
         FunctionMap & functions = thrd->second.m_functions;
+        std::string functionName = event.GetName();
         FunctionMap::iterator func = functions.find(functionName);
         if (func == functions.end()) {
           func = functions.insert(make_pair(functionName, Function())).first;
           ++analysis.m_functionCount;
         }
 
-        uint64_t diff = exit->m_when - entry->m_when - subFunctionAccumulator;
+        uint64_t diff = elapsed - active.m_subFunctions;
 
         if (func->second.m_minimum > diff)
           func->second.m_minimum = diff;
@@ -2150,7 +2368,6 @@ namespace PProfiling
 
         func->second.m_sum += diff;
         ++func->second.m_count;
-        break;
       }
     }
 
@@ -2170,6 +2387,341 @@ namespace PProfiling
       analysis.ToText(strm);
   }
 
+
+  /////////////////////////////////////////////////////////////////////
+
+  class TraceExporter
+  {
+    public:
+      TraceExporter(ostream & strm)
+        : m_strm(strm)
+        , m_processId(PProcess::GetCurrentProcessID())
+        , m_processName(PProcess::IsInitialised() ? (const char *)PProcess::Current().GetName() : "")
+      {
+      }
+      virtual ~TraceExporter() { }
+
+      virtual void OnStart() = 0;
+      virtual void OnThread(unsigned index, PUniqueThreadIdentifier threadId, const std::string & name) = 0;
+      virtual void OnEvent(const FunctionRawData & event, int64_t nanoseconds) = 0;
+      virtual void OnEnd() = 0;
+
+    protected:
+      ostream          & m_strm;
+      PProcessIdentifier m_processId;
+      std::string        m_processName;
+  };
+
+
+  // Escape a string for JSON
+  class EscapedJSON
+  {
+    private:
+      const char * m_str;
+
+    public:
+      EscapedJSON(const char * str)
+        : m_str(str)
+      {
+      }
+
+    friend ostream & operator<<(ostream & strm, const EscapedJSON & e)
+    {
+      strm << '"';
+      for (const char * ptr = e.m_str; *ptr != '\0'; ++ptr) {
+        switch (*ptr) {
+          case '"':
+          case '\\':
+            strm << '\\' << *ptr;
+            break;
+          default:
+            if ((unsigned char)*ptr >= ' ')
+              strm << *ptr;
+            else
+              strm << "\\u00" << hex << setfill('0') << setw(2) << (unsigned)*ptr << dec << setfill(' ');
+        }
+      }
+      return strm << '"';
+    }
+  };
+
+
+  class ChromeTraceExporter : public TraceExporter
+  {
+    public:
+      ChromeTraceExporter(ostream & strm)
+        : TraceExporter(strm)
+        , m_threadId(0)
+      {
+      }
+
+      virtual void OnStart()
+      {
+        m_strm << "{\"traceEvents\":[\n"
+                  "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << m_processId << ",\"tid\":0,"
+                  "\"args\":{\"name\":" << EscapedJSON(m_processName.c_str()) << "}}";
+      }
+
+      virtual void OnThread(unsigned, PUniqueThreadIdentifier threadId, const std::string & name)
+      {
+        m_threadId = threadId;
+        m_strm << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << m_processId << ",\"tid\":" << m_threadId << ","
+                  "\"args\":{\"name\":" << EscapedJSON(name.c_str()) << "}}";
+      }
+
+      virtual void OnEvent(const FunctionRawData & event, int64_t nanoseconds)
+      {
+        // Timestamps are in microseconds
+        m_strm << ",\n{\"ph\":\"" << (event.IsEntry() ? 'B' : 'E') << "\","
+                  "\"ts\":" << nanoseconds/1000 << '.' << setfill('0') << setw(3) << nanoseconds%1000 << setfill(' ') << ","
+                  "\"pid\":" << m_processId << ",\"tid\":" << m_threadId;
+        switch (event.m_type) {
+          case e_ManualEntry :
+            m_strm << ",\"name\":" << EscapedJSON(event.GetName().c_str()) << ",\"cat\":\"manual\"";
+            if (event.m_function.m_file != NULL)
+              m_strm << ",\"args\":{\"file\":" << EscapedJSON(event.m_function.m_file) << ",\"line\":" << event.m_function.m_line << '}';
+            break;
+          case e_AutoEntry :
+            m_strm << ",\"name\":" << EscapedJSON(event.GetName().c_str()) << ",\"cat\":\"auto\"";
+            break;
+          case e_SystemEntry :
+            m_strm << ",\"name\":\"System\",\"cat\":\"system\"";
+            break;
+          default :
+            break;
+        }
+        m_strm << '}';
+      }
+
+      virtual void OnEnd()
+      {
+        m_strm << "\n],\"displayTimeUnit\":\"ns\"}\n";
+      }
+
+    protected:
+      PUniqueThreadIdentifier m_threadId;
+  };
+
+
+  // Just enough of protobuf encoding for the Perfetto trace messages we use
+  class ProtobufMessage
+  {
+    public:
+      ProtobufMessage & Varint(unsigned field, uint64_t value)
+      {
+        AddVarint(field << 3);
+        AddVarint(value);
+        return *this;
+      }
+
+      ProtobufMessage & Bytes(unsigned field, const std::string & value)
+      {
+        AddVarint((field << 3) | 2);
+        AddVarint(value.length());
+        m_data += value;
+        return *this;
+      }
+
+      ProtobufMessage & Message(unsigned field, const ProtobufMessage & msg)
+      {
+        return Bytes(field, msg.m_data);
+      }
+
+      friend ostream & operator<<(ostream & strm, const ProtobufMessage & msg)
+      {
+        return strm.write(msg.m_data.data(), msg.m_data.length());
+      }
+
+    protected:
+      void AddVarint(uint64_t value)
+      {
+        while (value >= 0x80) {
+          m_data += (char)(value | 0x80);
+          value >>= 7;
+        }
+        m_data += (char)value;
+      }
+
+      std::string m_data;
+  };
+
+
+  class PerfettoTraceExporter : public TraceExporter
+  {
+    enum {
+      Trace_packet = 1,
+
+      TracePacket_timestamp = 8,
+      TracePacket_trusted_packet_sequence_id = 10,
+      TracePacket_track_event = 11,
+      TracePacket_sequence_flags = 13,
+      TracePacket_track_descriptor = 60,
+      SEQ_INCREMENTAL_STATE_CLEARED = 1,
+
+      TrackDescriptor_uuid = 1,
+      TrackDescriptor_process = 3,
+      TrackDescriptor_thread = 4,
+      TrackDescriptor_parent_uuid = 5,
+
+      ProcessDescriptor_pid = 1,
+      ProcessDescriptor_process_name = 6,
+
+      ThreadDescriptor_pid = 1,
+      ThreadDescriptor_tid = 2,
+      ThreadDescriptor_thread_name = 5,
+
+      TrackEvent_type = 9,
+      TrackEvent_track_uuid = 11,
+      TrackEvent_categories = 22,
+      TrackEvent_name = 23,
+      TYPE_SLICE_BEGIN = 1,
+      TYPE_SLICE_END = 2
+    };
+
+    public:
+      PerfettoTraceExporter(ostream & strm)
+        : TraceExporter(strm)
+        , m_sequenceId(0)
+        , m_trackId(0)
+      {
+      }
+
+      virtual void OnStart()
+      {
+        ProtobufMessage process;
+        process.Varint(ProcessDescriptor_pid, m_processId);
+        process.Bytes(ProcessDescriptor_process_name, m_processName);
+
+        ProtobufMessage track;
+        track.Varint(TrackDescriptor_uuid, ProcessTrackId());
+        track.Message(TrackDescriptor_process, process);
+
+        ProtobufMessage packet;
+        packet.Message(TracePacket_track_descriptor, track);
+        WritePacket(packet);
+      }
+
+      virtual void OnThread(unsigned index, PUniqueThreadIdentifier threadId, const std::string & name)
+      {
+        // Each thread is its own sequence, so timestamps on a sequence are in order
+        m_sequenceId = index+1;
+        m_trackId = ProcessTrackId() + index + 1;
+
+        ProtobufMessage thread;
+        thread.Varint(ThreadDescriptor_pid, m_processId);
+        thread.Varint(ThreadDescriptor_tid, threadId);
+        thread.Bytes(ThreadDescriptor_thread_name, name);
+
+        ProtobufMessage track;
+        track.Varint(TrackDescriptor_uuid, m_trackId);
+        track.Varint(TrackDescriptor_parent_uuid, ProcessTrackId());
+        track.Message(TrackDescriptor_thread, thread);
+
+        ProtobufMessage packet;
+        packet.Varint(TracePacket_trusted_packet_sequence_id, m_sequenceId);
+        packet.Varint(TracePacket_sequence_flags, SEQ_INCREMENTAL_STATE_CLEARED);
+        packet.Message(TracePacket_track_descriptor, track);
+        WritePacket(packet);
+      }
+
+      virtual void OnEvent(const FunctionRawData & event, int64_t nanoseconds)
+      {
+        ProtobufMessage trackEvent;
+        trackEvent.Varint(TrackEvent_track_uuid, m_trackId);
+        if (event.IsEntry()) {
+          trackEvent.Varint(TrackEvent_type, TYPE_SLICE_BEGIN);
+          trackEvent.Bytes(TrackEvent_name, event.GetName());
+          switch (event.m_type) {
+            case e_ManualEntry :
+              trackEvent.Bytes(TrackEvent_categories, "manual");
+              break;
+            case e_AutoEntry :
+              trackEvent.Bytes(TrackEvent_categories, "auto");
+              break;
+            default :
+              trackEvent.Bytes(TrackEvent_categories, "system");
+          }
+        }
+        else
+          trackEvent.Varint(TrackEvent_type, TYPE_SLICE_END);
+
+        ProtobufMessage packet;
+        packet.Varint(TracePacket_timestamp, nanoseconds);
+        packet.Varint(TracePacket_trusted_packet_sequence_id, m_sequenceId);
+        packet.Message(TracePacket_track_event, trackEvent);
+        WritePacket(packet);
+      }
+
+      virtual void OnEnd()
+      {
+      }
+
+    protected:
+      uint64_t ProcessTrackId() const { return (uint64_t)m_processId << 32; }
+
+      void WritePacket(const ProtobufMessage & packet)
+      {
+        // The trace is just a repeated packet field, so can be written as we go
+        ProtobufMessage trace;
+        trace.Message(Trace_packet, packet);
+        m_strm << trace;
+      }
+
+      unsigned m_sequenceId;
+      uint64_t m_trackId;
+  };
+
+
+  void ExportTrace(ostream & strm, TraceFormat format)
+  {
+    PWaitAndSignal lock(s_database.m_mutex);
+    std::map<PUniqueThreadIdentifier, std::string> names;
+    std::list<PThread::Times> times;
+    PThread::GetTimes(times);
+    for (std::list<PThread::Times>::iterator it = times.begin(); it != times.end(); ++it)
+      names[it->m_uniqueId] = it->m_name.GetPointer();
+    for (ThreadRawData * thrd = s_database.m_threads; thrd != NULL; thrd = thrd->m_link)
+      names.insert(make_pair(thrd->m_uniqueId, thrd->m_name));
+
+    ChromeTraceExporter chrome(strm);
+    PerfettoTraceExporter perfetto(strm);
+    TraceExporter & exporter = format == PerfettoProtobuf ? static_cast<TraceExporter &>(perfetto) : chrome;
+
+    exporter.OnStart();
+
+    unsigned index = 0;
+    for (ThreadBuffer * buffer = s_database.m_buffers; buffer != NULL; buffer = buffer->m_link) {
+      if (!s_database.IsCurrent(*buffer))
+        continue;
+
+      uint64_t count = buffer->m_count;
+      uint64_t first = buffer->GetFirst();
+      if (first >= count)
+        continue;
+
+      std::map<PUniqueThreadIdentifier, std::string>::iterator name = names.find(buffer->m_uniqueId);
+      exporter.OnThread(index++, buffer->m_uniqueId, name != names.end() ? name->second : PSTRSTRM("Thread " << buffer->m_uniqueId).GetPointer());
+
+      // Leave out exits with no entry, as it was overwritten
+      unsigned depth = 0;
+      for (uint64_t i = first; i < count; ++i) {
+        const FunctionRawData & event = buffer->GetEvent(i);
+        if (event.IsEntry())
+          ++depth;
+        else if (depth > 0)
+          --depth;
+        else
+          continue;
+
+        int64_t nanoseconds = CyclesToNanoseconds(event.m_when - s_database.m_start);
+        exporter.OnEvent(event, std::max(nanoseconds, (int64_t)0));
+      }
+    }
+
+    exporter.OnEnd();
+  }
+
+
 #endif // P_PROFILING
 
 #if PTRACING
@@ -2450,13 +3002,13 @@ extern "C"
   void __cyg_profile_func_enter(void * function, void * caller)
   {
     if (PProfiling::s_database.m_enabled)
-      new PProfiling::FunctionRawData(PProfiling::e_AutoEntry, function, caller);
+      PProfiling::AddEvent(PProfiling::e_AutoEntry, function, caller);
   }
 
   void __cyg_profile_func_exit(void * function, void * caller)
   {
     if (PProfiling::s_database.m_enabled)
-      new PProfiling::FunctionRawData(PProfiling::e_AutoExit, function, caller);
+      PProfiling::AddEvent(PProfiling::e_AutoExit, function, caller);
   }
 };
 #endif // __GNUC__
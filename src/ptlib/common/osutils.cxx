@@ -41,6 +41,7 @@
 #include <ptlib/svcproc.h>
 #include <ptlib/pluginmgr.h>
 #include <ptlib/syslog.h>
+#include <ptlib/dirwatch.h>
 #include <ptclib/random.h>
 #include "../../../version.h"
 #include "../../../revision.h"
@@ -1303,7 +1304,10 @@ bool PDirectory::Create(const PString & p, int perm, bool recurse)
 #else    
   if (mkdir(dir.Left(dir.GetLength()-1), perm) == 0)
 #endif
+  {
+    PFileInfoCache::Invalidate(dir);
     return true;
+  }
 
   return recurse && !dir.IsRoot() && dir.GetParent().Create(perm, true) && dir.Create(perm, false);
 }
@@ -1749,6 +1753,8 @@ bool PTimer::List::OnTimeout(PIdGenerator::Handle handle)
 }
 
 
+static PMetricHistogram s_timerLateness("ptlib_timer_lateness_seconds", "Time between a PTimer expiring and its work being queued");
+
 PTimeInterval PTimer::List::Process()
 {
   PTimeInterval now = PTimer::Tick();
@@ -1780,6 +1786,7 @@ PTimeInterval PTimer::List::Process()
         timer.m_callbackMutex.Signal();
 
         m_threadPool.AddWork(new Timeout(it->first));
+        s_timerLateness.Record(-delta);
         PTRACE(6, &timer, "Timer: " << timer << " work added, lateness=" << -delta);
       }
     }
@@ -28,6 +28,8 @@
  */
 
 #include <ptlib.h>
+#include <ptlib/bufchain.h>
+#include <ptlib/dirwatch.h>
 
 #include <ctype.h>
 
@@ -302,6 +304,92 @@ PBoolean PChannel::WriteChar(int c)
 }
 
 
+bool PChannel::Read(Slice * slices, size_t sliceCount)
+{
+  PINDEX total = 0;
+  for (size_t i = 0; i < sliceCount; ++i) {
+    if (slices[i].GetLength() == 0)
+      continue;
+
+    if (!Read(slices[i].GetBase(), slices[i].GetLength()))
+      break;
+
+    total += GetLastReadCount();
+    if (GetLastReadCount() < (PINDEX)slices[i].GetLength())
+      break;
+  }
+
+  return SetLastReadCount(total) > 0;
+}
+
+
+bool PChannel::Write(const Slice * slices, size_t sliceCount)
+{
+  PINDEX total = 0;
+  for (size_t i = 0; i < sliceCount; ++i) {
+    if (slices[i].GetLength() == 0)
+      continue;
+
+    if (!Write(slices[i].GetBase(), slices[i].GetLength())) {
+      SetLastWriteCount(total + GetLastWriteCount());
+      return false;
+    }
+
+    total += GetLastWriteCount();
+  }
+
+  return SetLastWriteCount(total) > 0;
+}
+
+
+bool PChannel::ReadChain(PBufferChain & chain, PINDEX len)
+{
+  Slice slices[64];
+  PINDEX count = chain.GetWritableSlices(len, slices, PARRAYSIZE(slices));
+  if (!Read(slices, count))
+    return false;
+
+  chain.Commit(GetLastReadCount());
+  return true;
+}
+
+
+bool PChannel::ReadBlock(PBufferChain & chain, PINDEX len)
+{
+  PINDEX numRead = 0;
+
+  while (numRead < len && ReadChain(chain, len - numRead))
+    numRead += GetLastReadCount();
+
+  SetLastReadCount(numRead);
+
+  return numRead == len;
+}
+
+
+bool PChannel::WriteChain(const PBufferChain & chain)
+{
+  static const PINDEX MaxSlices = 64; // Well under IOV_MAX on everything
+
+  std::vector<Slice> slices;
+  PINDEX written = 0;
+  while (written < chain.GetLength()) {
+    slices.clear();
+    chain.GetSlices(slices, written, MaxSlices);
+
+    if (!Write(&slices[0], slices.size())) {
+      SetLastWriteCount(written + GetLastWriteCount());
+      return false;
+    }
+
+    written += GetLastWriteCount();
+  }
+
+  SetLastWriteCount(written);
+  return true;
+}
+
+
 PBoolean PChannel::SetBufferSize(PINDEX newSize)
 {
   return ((PChannelStreamBuffer *)rdbuf())->SetBufferSize(newSize);
@@ -798,6 +886,51 @@ PBoolean PIndirectChannel::Write(const void * buf, PINDEX len)
 }
 
 
+bool PIndirectChannel::ReadSlicesDirect(Slice * slices, size_t sliceCount)
+{
+  PReadWaitAndSignal mutex(channelPointerMutex);
+
+  if (readChannel == NULL) {
+    SetErrorValues(NotOpen, EBADF, LastReadError);
+    return false;
+  }
+
+  readChannel->SetReadTimeout(readTimeout);
+  bool returnValue = readChannel->Read(slices, sliceCount);
+
+  SetErrorValues(readChannel->GetErrorCode(LastReadError),
+                 readChannel->GetErrorNumber(LastReadError),
+                 LastReadError);
+  SetLastReadCount(readChannel->GetLastReadCount());
+
+  return returnValue;
+}
+
+
+bool PIndirectChannel::WriteSlicesDirect(const Slice * slices, size_t sliceCount)
+{
+  flush();
+
+  PReadWaitAndSignal mutex(channelPointerMutex);
+
+  if (writeChannel == NULL) {
+    SetErrorValues(NotOpen, EBADF, LastWriteError);
+    return false;
+  }
+
+  writeChannel->SetWriteTimeout(writeTimeout);
+  bool returnValue = writeChannel->Write(slices, sliceCount);
+
+  SetErrorValues(writeChannel->GetErrorCode(LastWriteError),
+                 writeChannel->GetErrorNumber(LastWriteError),
+                 LastWriteError);
+
+  SetLastWriteCount(writeChannel->GetLastWriteCount());
+
+  return returnValue;
+}
+
+
 PBoolean PIndirectChannel::Shutdown(ShutdownValue value)
 {
   PReadWaitAndSignal mutex(channelPointerMutex);
@@ -1028,6 +1161,9 @@ PBoolean PFile::Close()
 
   os_handle = -1;
 
+  // Size and times will have changed if it was written
+  PFileInfoCache::Invalidate(m_path);
+
   if (m_removeOnClose)
     Remove();
 
@@ -1180,9 +1316,22 @@ bool PFile::Rename(const PFilePath & oldname, const PString & newname, bool forc
 }
 
 
+static bool RenameFile(const PFilePath & oldname, const PFilePath & newname)
+{
+  bool ok = rename(oldname, newname) == 0;
+  if (PFileInfoCache::IsActive()) {
+    int err = errno;
+    PFileInfoCache::Invalidate(oldname);
+    PFileInfoCache::Invalidate(newname);
+    errno = err;
+  }
+  return ok;
+}
+
+
 bool PFile::Move(const PFilePath & oldname, const PFilePath & newname, bool force, bool recurse)
 {
-  if (rename(oldname, newname) == 0)
+  if (RenameFile(oldname, newname))
     return true;
 
   if (errno == ENOENT) {
@@ -1192,14 +1341,14 @@ bool PFile::Move(const PFilePath & oldname, const PFilePath & newname, bool forc
     if (!newname.GetDirectory().Create(PFileInfo::DefaultDirPerms, true))
       return false;
 
-    return rename(oldname, newname) == 0;
+    return RenameFile(oldname, newname);
   }
 
   if (force && Exists(newname)) {
     if (!Remove(newname, true))
       return false;
 
-    if (rename(oldname, newname) == 0)
+    if (RenameFile(oldname, newname))
       return true;
   }
 
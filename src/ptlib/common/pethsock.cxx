@@ -343,18 +343,28 @@ PEthSocket::Frame::Frame(PINDEX maxSize)
   , m_fragmentProto(0)
   , m_fragmentProcessed(false)
 {
+  ResetLayers();
 }
 
 
 PEthSocket::Frame::Frame(const Frame & frame)
   : m_rawData(frame.m_rawData, frame.m_rawSize) // Make copy, not reference
   , m_rawSize(frame.m_rawSize)
+  , m_dataLinkType(frame.m_dataLinkType)
   , m_fragmentated(false)
   , m_fragmentProto(0)
   , m_fragmentProcessed(false)
   , m_timestamp(frame.m_timestamp)
 {
   m_rawData.SetMinSize(sizeof(PEthFrameHeader));
+  ResetLayers();
+}
+
+
+void PEthSocket::Frame::ResetLayers()
+{
+  m_dataLinkProto = NotDecoded;
+  m_ipProto = NotDecoded;
 }
 
 
@@ -365,6 +375,21 @@ void PEthSocket::Frame::PreRead()
     m_fragmentated = false;
   }
   m_fragmentProcessed = false;
+  ResetLayers();
+}
+
+
+bool PEthSocket::Frame::SetData(const void * data, PINDEX size, const PTime & timestamp)
+{
+  PreRead();
+
+  if (!m_rawData.SetMinSize(std::max(size, (PINDEX)sizeof(PEthFrameHeader))))
+    return false;
+
+  memcpy(m_rawData.GetPointer(), data, size);
+  m_rawSize = size;
+  m_timestamp = timestamp;
+  return true;
 }
 
 
@@ -403,6 +428,21 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload)
 
 
 int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address & dst)
+{
+  if (m_dataLinkProto == NotDecoded)
+    m_dataLinkProto = DecodeDataLink();
+
+  if (m_dataLinkProto >= 0) {
+    payload.Attach((const BYTE *)m_rawData + m_dataLinkOffset, m_dataLinkLength);
+    src = m_srcMAC;
+    dst = m_dstMAC;
+  }
+
+  return m_dataLinkProto;
+}
+
+
+int PEthSocket::Frame::DecodeDataLink()
 {
   if (m_dataLinkType == 113) {
     const PCookedFrameHeader & header = m_rawData.GetAs<PCookedFrameHeader>();
@@ -411,7 +451,9 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
       return -1;
     }
 
-    payload.Attach(&header.m_linkAddr[header.m_linkAddrLen+4], m_rawSize - sizeof(header)+header.m_linkAddrLen);
+    m_srcMAC = m_dstMAC = Address((const BYTE *)NULL);
+    m_dataLinkOffset = &header.m_linkAddr[header.m_linkAddrLen+4] - (const BYTE *)m_rawData;
+    m_dataLinkLength = m_rawSize - m_dataLinkOffset;
     return *(PUInt16b *)&header.m_linkAddr[header.m_linkAddrLen+2];
   }
 
@@ -422,15 +464,24 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
     return -1;
   }
 
-  src = header.src_addr;
-  dst = header.dst_addr;
+  m_srcMAC = header.src_addr;
+  m_dstMAC = header.dst_addr;
 
   PINDEX len_or_type = ntohs(header.snap.length);
 
+  // Skip any 802.1Q VLAN, or 802.1ad QinQ, tags
+  const BYTE * raw = m_rawData;
+  PINDEX typeOffset = sizeof(header.dst_addr)+sizeof(header.src_addr);
+  while ((len_or_type == 0x8100 || len_or_type == 0x88a8 || len_or_type == 0x9100) && m_rawSize >= typeOffset+6) {
+    typeOffset += 4;
+    len_or_type = (raw[typeOffset]<<8)|raw[typeOffset+1];
+  }
+
   // Ethernet II header
   if (len_or_type > 1500) {
     // Subtract off the Ethernet II header
-    payload.Attach(header.ether.payload, m_rawSize - (sizeof(header.dst_addr)+sizeof(header.src_addr)+sizeof(header.ether.type)));
+    m_dataLinkOffset = typeOffset + sizeof(header.ether.type);
+    m_dataLinkLength = m_rawSize - m_dataLinkOffset;
     return len_or_type;
   }
 
@@ -448,7 +499,8 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
       return -1;
     }
 
-    payload.Attach(header.snap.payload, len_or_type);
+    m_dataLinkOffset = header.snap.payload - &m_rawData[0];
+    m_dataLinkLength = len_or_type;
     return ntohs(header.snap.type);
   }
 
@@ -458,7 +510,8 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
       PTRACE(2, "Frame (802.3) truncated, size=" << m_rawSize);
       return -1;
     }
-    payload.Attach(&header.snap.dsap, len_or_type); // Whole thing is IPX payload
+    m_dataLinkOffset = &header.snap.dsap - &m_rawData[0]; // Whole thing is IPX payload
+    m_dataLinkLength = len_or_type;
     return 0x8137;
   }
 
@@ -474,7 +527,8 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
     return -1;
   }
 
-  payload.Attach(header.snap.oui, len_or_type);
+  m_dataLinkOffset = header.snap.oui - &m_rawData[0];
+  m_dataLinkLength = len_or_type;
 
   if (header.snap.dsap == 0xe0 && header.snap.ssap == 0xe0)
     return 0x8137;   // Special case for Novell netware's 802.2
@@ -485,6 +539,7 @@ int PEthSocket::Frame::GetDataLink(PBYTEArray & payload, Address & src, Address
 
 BYTE * PEthSocket::Frame::CreateDataLink(const Address & src, const Address & dst, unsigned proto, PINDEX length)
 {
+  ResetLayers();
   m_rawSize = length + 14;
   PEthFrameHeader & header = *(PEthFrameHeader *)m_rawData.GetPointer(sizeof(PEthFrameHeader));
   header.src_addr = src;
@@ -514,22 +569,37 @@ int PEthSocket::Frame::GetIP(PBYTEArray & payload, PIPSocket::Address & src, PIP
     return -1;
   }
 
+  // Already decoded this frame as a complete IP packet, or not IP at all
+  if (m_ipProto != NotDecoded) {
+    if (m_ipProto >= 0) {
+      payload.Attach((const BYTE *)m_rawData + m_ipOffset, m_ipLength);
+      src = m_srcIP;
+      dst = m_dstIP;
+    }
+    return m_ipProto;
+  }
+
   PBYTEArray ip;
   if (GetDataLink(ip) != 0x800) // IPv4
-    return -1;
+    return m_ipProto = -1;
+
+  if (ip.GetSize() < 20) {
+    PTRACE(2, "Truncated IP header, size=" << ip.GetSize());
+    return m_ipProto = -1;
+  }
 
   PINDEX totalLength = (ip[2]<<8)|ip[3]; // Total length of packet
   if (totalLength == 0)
     totalLength = ip.GetSize(); // presume to be part of TCP segmentation offload (TSO), whatever THAT is
   else if (totalLength > ip.GetSize()) {
     PTRACE(2, "Truncated IP packet, expected " << totalLength << ", got " << ip.GetSize());
-    return -1;
+    return m_ipProto = -1;
   }
 
   PINDEX headerLength = (ip[0]&0xf)*4; // low 4 bits in DWORDS, is this in bytes
   if (totalLength < headerLength) {
     PTRACE(2, "Malformed IP header, length " << totalLength << " smaller than header " << headerLength);
-    return -1;
+    return m_ipProto = -1;
   }
 
   payload.Attach(&ip[headerLength], totalLength-headerLength);
@@ -537,6 +607,12 @@ int PEthSocket::Frame::GetIP(PBYTEArray & payload, PIPSocket::Address & src, PIP
   src = PIPSocket::Address(4, ip+12);
   dst = PIPSocket::Address(4, ip+16);
 
+  // Remember where it was, for when it is not part of a fragmented packet
+  m_ipOffset = (const BYTE *)payload - (const BYTE *)m_rawData;
+  m_ipLength = payload.GetSize();
+  m_srcIP = src;
+  m_dstIP = dst;
+
   // Check for fragmentation
   bool isFragment = (ip[6] & 0x20) != 0;
   PINDEX fragmentOffset = (((ip[6]&0x1f)<<8)+ip[7])*8;
@@ -548,7 +624,7 @@ int PEthSocket::Frame::GetIP(PBYTEArray & payload, PIPSocket::Address & src, PIP
        of fragments for all IP pairs. But that is too hard for now.
     */
     if (m_fragmentSrcIP != src || m_fragmentDstIP != dst)
-      return ip[9]; // Next protocol layer
+      return m_ipProto = ip[9]; // Next protocol layer
 
     if (fragmentsSize > fragmentOffset) {
       PTRACE(5, "Repeated IP fragment at " << fragmentOffset << " on " << src << " -> " << dst);
@@ -563,7 +639,7 @@ int PEthSocket::Frame::GetIP(PBYTEArray & payload, PIPSocket::Address & src, PIP
   }
   else {
     if (!isFragment)
-      return ip[9]; // Next protocol layer
+      return m_ipProto = ip[9]; // Next protocol layer
 
     // New fragmented IP start
     m_fragmentProto = ip[9]; // Next protocol layer
@@ -794,6 +870,431 @@ PEthSocket::Address::operator PString() const
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+
+// See https://www.tcpdump.org/manpages/pcap-savefile.5.html and RFC 9913 drafts for pcapng
+static const DWORD PcapMagic     = 0xa1b2c3d4;
+static const DWORD PcapNanoMagic = 0xa1b23c4d;
+static const DWORD PcapHeaderSize = 24;
+static const DWORD PcapRecordSize = 16;
+
+static const DWORD PcapNGSectionHeader   = 0x0a0d0d0a;
+static const DWORD PcapNGInterface       = 1;
+static const DWORD PcapNGObsoletePacket  = 2;
+static const DWORD PcapNGSimplePacket    = 3;
+static const DWORD PcapNGEnhancedPacket  = 6;
+static const DWORD PcapNGByteOrderMagic  = 0x1a2b3c4d;
+static const WORD  PcapNGOptionTSResol   = 9;
+
+static const DWORD MaxCaptureBlock = 256*1024*1024; // Sanity check for corrupt files
+
+static __inline uint32_t SwapDWORD(uint32_t value)
+{
+  return (value >> 24) | ((value >> 8) & 0xff00) | ((value << 8) & 0xff0000) | (value << 24);
+}
+
+static __inline uint16_t SwapWORD(uint16_t value)
+{
+  return (uint16_t)((value >> 8) | (value << 8));
+}
+
+
+PEthCaptureFile::PEthCaptureFile(PINDEX bufferSize)
+  : m_format(FormatPcap)
+  , m_writing(false)
+  , m_swapped(false)
+  , m_buffer(std::max(bufferSize, (PINDEX)65536))
+  , m_position(0)
+  , m_available(0)
+  , m_frameCount(0)
+{
+}
+
+
+PEthCaptureFile::~PEthCaptureFile()
+{
+  Close();
+}
+
+
+bool PEthCaptureFile::Open(const PFilePath & filename, PFile::OpenMode mode, Formats format, unsigned dataLinkType, unsigned snapLength)
+{
+  Close();
+
+  m_writing = mode != PFile::ReadOnly;
+  m_swapped = false;
+  m_interfaces.clear();
+  m_position = m_available = 0;
+  m_frameCount = 0;
+
+  if (!m_file.Open(filename, m_writing ? PFile::WriteOnly : PFile::ReadOnly)) {
+    PTRACE(2, "Could not open capture file " << filename << ": " << m_file.GetErrorText());
+    return false;
+  }
+
+  if (m_writing) {
+    m_format = format;
+    if (WriteHeader(dataLinkType, snapLength))
+      return true;
+  }
+  else {
+    if (ReadHeader())
+      return true;
+  }
+
+  m_file.Close();
+  return false;
+}
+
+
+bool PEthCaptureFile::Close()
+{
+  if (!m_file.IsOpen())
+    return false;
+
+  bool ok = Flush();
+  return m_file.Close() && ok;
+}
+
+
+DWORD PEthCaptureFile::GetDWORD(PINDEX offset) const
+{
+  uint32_t value;
+  memcpy(&value, (const BYTE *)m_buffer + m_position + offset, sizeof(value));
+  return m_swapped ? SwapDWORD(value) : value;
+}
+
+
+WORD PEthCaptureFile::GetWORD(PINDEX offset) const
+{
+  uint16_t value;
+  memcpy(&value, (const BYTE *)m_buffer + m_position + offset, sizeof(value));
+  return m_swapped ? SwapWORD(value) : value;
+}
+
+
+bool PEthCaptureFile::Fill(PINDEX needed)
+{
+  PINDEX have = m_available - m_position;
+  if (have >= needed)
+    return true;
+
+  // Move what is left of the last block to the start, and read a whole block after it
+  BYTE * buffer = m_buffer.GetPointer();
+  if (m_position > 0) {
+    memmove(buffer, buffer + m_position, have);
+    m_position = 0;
+    m_available = have;
+  }
+
+  if (needed > m_buffer.GetSize()) {
+    if (!m_buffer.SetSize(needed))
+      return false;
+    buffer = m_buffer.GetPointer();
+  }
+
+  while (m_available < needed) {
+    if (!m_file.Read(buffer + m_available, m_buffer.GetSize() - m_available) || m_file.GetLastReadCount() == 0)
+      return false;
+    m_available += m_file.GetLastReadCount();
+  }
+
+  return true;
+}
+
+
+bool PEthCaptureFile::ReadHeader()
+{
+  if (!Fill(PcapHeaderSize)) {
+    PTRACE(2, "Capture file " << m_file.GetFilePath() << " too short");
+    return false;
+  }
+
+  DWORD magic = GetDWORD(0);
+  switch (magic) {
+    case PcapNGSectionHeader :
+      // Byte order and interfaces come from blocks as they are read
+      m_format = FormatPcapNG;
+      return true;
+
+    case PcapMagic :
+    case PcapNanoMagic :
+      break;
+
+    default :
+      m_swapped = true;
+      magic = GetDWORD(0);
+      if (magic != PcapMagic && magic != PcapNanoMagic) {
+        PTRACE(2, "Capture file " << m_file.GetFilePath() << " is not pcap or pcapng");
+        return false;
+      }
+  }
+
+  m_format = magic == PcapNanoMagic ? FormatPcapNano : FormatPcap;
+  // The top bits of the link type may hold FCS information
+  m_interfaces.push_back(Interface(GetDWORD(20) & 0xffff, m_format == FormatPcapNano ? 1000000000 : 1000000));
+
+  PTRACE(4, "Opened capture file " << m_file.GetFilePath() << ", " << (m_format == FormatPcapNano ? "pcap-ns" : "pcap")
+         << ", data link " << GetDataLinkType() << ", snap length " << GetDWORD(16) << (m_swapped ? ", swapped" : ""));
+  m_position += PcapHeaderSize;
+  return true;
+}
+
+
+bool PEthCaptureFile::ReadBlock(PEthSocket::Frame & frame, bool & gotFrame)
+{
+  gotFrame = false;
+
+  if (m_format != FormatPcapNG) {
+    if (!Fill(PcapRecordSize))
+      return false;
+
+    DWORD capturedLength = GetDWORD(8);
+    if (capturedLength > MaxCaptureBlock || !Fill(PcapRecordSize + capturedLength)) {
+      PTRACE(2, "Capture file " << m_file.GetFilePath() << " truncated or corrupt at frame " << m_frameCount);
+      return false;
+    }
+
+    DWORD seconds = GetDWORD(0);
+    DWORD fraction = GetDWORD(4);
+    frame.SetDataLinkType(m_interfaces[0].m_dataLinkType);
+    frame.SetData((const BYTE *)m_buffer + m_position + PcapRecordSize, capturedLength,
+                  PTime(seconds, m_format == FormatPcapNano ? fraction/1000 : fraction));
+    m_position += PcapRecordSize + capturedLength;
+    gotFrame = true;
+    return true;
+  }
+
+  if (!Fill(12))
+    return false;
+
+  DWORD blockType = GetDWORD(0);
+  if (blockType == PcapNGSectionHeader) {
+    // Each section sets its own byte order, and has its own interfaces
+    uint32_t magic;
+    memcpy(&magic, (const BYTE *)m_buffer + m_position + 8, sizeof(magic));
+    if (magic == PcapNGByteOrderMagic)
+      m_swapped = false;
+    else if (SwapDWORD(magic) == PcapNGByteOrderMagic)
+      m_swapped = true;
+    else {
+      PTRACE(2, "Capture file " << m_file.GetFilePath() << " has invalid pcapng section header");
+      return false;
+    }
+    m_interfaces.clear();
+  }
+
+  DWORD blockLength = GetDWORD(4);
+  if (blockLength < 12 || (blockLength & 3) != 0 || blockLength > MaxCaptureBlock || !Fill(blockLength)) {
+    PTRACE(2, "Capture file " << m_file.GetFilePath() << " truncated or corrupt at frame " << m_frameCount);
+    return false;
+  }
+
+  switch (blockType) {
+    case PcapNGInterface :
+      if (blockLength >= 20) {
+        Interface iface(GetWORD(8));
+        PINDEX option = 16;
+        while (option + 4 <= blockLength - 4) {
+          WORD code = GetWORD(option);
+          WORD length = GetWORD(option+2);
+          if (code == 0)
+            break;
+          if (code == PcapNGOptionTSResol && length >= 1) {
+            BYTE resolution = m_buffer[m_position + option + 4];
+            if (resolution & 0x80)
+              iface.m_unitsPerSecond = (PUInt64)1 << std::min(resolution & 0x7f, 63);
+            else {
+              iface.m_unitsPerSecond = 1;
+              for (BYTE i = 0; i < resolution && i < 19; ++i)
+                iface.m_unitsPerSecond *= 10;
+            }
+          }
+          option += 4 + ((length + 3) & ~3);
+        }
+        m_interfaces.push_back(iface);
+      }
+      break;
+
+    case PcapNGEnhancedPacket :
+    case PcapNGObsoletePacket :
+    case PcapNGSimplePacket :
+    {
+      unsigned interfaceId;
+      PUInt64 timestamp;
+      DWORD capturedLength;
+      PINDEX dataOffset;
+      if (blockType == PcapNGSimplePacket) {
+        interfaceId = 0;
+        timestamp = 0;
+        capturedLength = std::min(GetDWORD(8), blockLength - 16);
+        dataOffset = 12;
+      }
+      else {
+        interfaceId = blockType == PcapNGEnhancedPacket ? GetDWORD(8) : GetWORD(8);
+        timestamp = ((PUInt64)GetDWORD(12) << 32) | GetDWORD(16);
+        capturedLength = GetDWORD(20);
+        dataOffset = 28;
+      }
+
+      if (interfaceId >= m_interfaces.size() || dataOffset + capturedLength > blockLength - 4) {
+        PTRACE(2, "Capture file " << m_file.GetFilePath() << " has invalid packet block at frame " << m_frameCount);
+        return false;
+      }
+
+      const Interface & iface = m_interfaces[interfaceId];
+      PInt64 microseconds = iface.m_unitsPerSecond == 1000000 ? (PInt64)timestamp
+                              : (PInt64)((double)timestamp*1000000/iface.m_unitsPerSecond);
+      frame.SetDataLinkType(iface.m_dataLinkType);
+      frame.SetData((const BYTE *)m_buffer + m_position + dataOffset, capturedLength,
+                    PTime(microseconds/1000000, microseconds%1000000));
+      gotFrame = true;
+      break;
+    }
+
+    default :
+      break; // Statistics, name resolution etc, skip
+  }
+
+  m_position += blockLength;
+  return true;
+}
+
+
+bool PEthCaptureFile::ReadFrame(PEthSocket::Frame & frame)
+{
+  if (m_writing || !m_file.IsOpen())
+    return false;
+
+  bool gotFrame;
+  do {
+    if (!ReadBlock(frame, gotFrame))
+      return false;
+  } while (!gotFrame);
+
+  ++m_frameCount;
+  return true;
+}
+
+
+PINDEX PEthCaptureFile::ReadFrames(PEthSocket::Frame * frames, PINDEX count)
+{
+  PINDEX i = 0;
+  while (i < count && ReadFrame(frames[i]))
+    ++i;
+  return i;
+}
+
+
+bool PEthCaptureFile::Append(const void * data, PINDEX size)
+{
+  if (m_available + size > m_buffer.GetSize()) {
+    if (!Flush())
+      return false;
+    if (size > m_buffer.GetSize())
+      return m_file.Write(data, size);
+  }
+
+  memcpy(m_buffer.GetPointer() + m_available, data, size);
+  m_available += size;
+  return true;
+}
+
+
+bool PEthCaptureFile::Flush()
+{
+  if (!m_writing || m_available == 0)
+    return true;
+
+  PINDEX size = m_available;
+  m_available = 0;
+  if (m_file.Write(m_buffer, size))
+    return true;
+
+  PTRACE(2, "Could not write capture file " << m_file.GetFilePath() << ": " << m_file.GetErrorText(PChannel::LastWriteError));
+  return false;
+}
+
+
+bool PEthCaptureFile::WriteHeader(unsigned dataLinkType, unsigned snapLength)
+{
+  m_interfaces.push_back(Interface(dataLinkType, m_format == FormatPcapNano ? 1000000000 : 1000000));
+
+  if (m_format != FormatPcapNG) {
+    uint32_t header[6];
+    header[0] = m_format == FormatPcapNano ? PcapNanoMagic : PcapMagic;
+    header[1] = 2 | (4 << 16); // Version 2.4, as little endian WORDs
+    header[2] = 0;             // GMT to local correction
+    header[3] = 0;             // Accuracy of timestamps
+    header[4] = snapLength;
+    header[5] = dataLinkType;
+#if PBYTE_ORDER == PBIG_ENDIAN
+    header[1] = 4 | (2 << 16);
+#endif
+    return Append(header, sizeof(header)) && Flush();
+  }
+
+  uint32_t section[7];
+  section[0] = PcapNGSectionHeader;
+  section[1] = sizeof(section);
+  section[2] = PcapNGByteOrderMagic;
+#if PBYTE_ORDER == PBIG_ENDIAN
+  section[3] = 0x00010000;    // Version 1.0
+#else
+  section[3] = 0x00000001;
+#endif
+  section[4] = section[5] = 0xffffffff; // Section length not known
+  section[6] = sizeof(section);
+
+  uint32_t iface[5];
+  uint16_t linkAndReserved[2] = { (uint16_t)dataLinkType, 0 };
+  iface[0] = PcapNGInterface;
+  iface[1] = sizeof(iface);
+  memcpy(&iface[2], linkAndReserved, sizeof(linkAndReserved));
+  iface[3] = snapLength;
+  iface[4] = sizeof(iface);
+
+  return Append(section, sizeof(section)) && Append(iface, sizeof(iface)) && Flush();
+}
+
+
+bool PEthCaptureFile::WriteFrame(const PEthSocket::Frame & frame)
+{
+  if (!m_writing || !m_file.IsOpen())
+    return false;
+
+  PInt64 microseconds = frame.GetTimestamp().GetTimestamp();
+  uint32_t size = frame.GetSize();
+
+  if (m_format != FormatPcapNG) {
+    uint32_t record[4];
+    record[0] = (uint32_t)(microseconds/1000000);
+    record[1] = (uint32_t)(microseconds%1000000);
+    if (m_format == FormatPcapNano)
+      record[1] *= 1000;
+    record[2] = record[3] = size;
+    if (!Append(record, sizeof(record)) || !Append(frame.GetData(), size))
+      return false;
+  }
+  else {
+    static const BYTE Padding[4] = { 0 };
+    uint32_t padding = (4 - (size & 3)) & 3;
+    uint32_t block[7];
+    block[0] = PcapNGEnhancedPacket;
+    block[1] = sizeof(block) + size + padding + sizeof(uint32_t);
+    block[2] = 0; // Interface
+    block[3] = (uint32_t)((PUInt64)microseconds >> 32);
+    block[4] = (uint32_t)microseconds;
+    block[5] = block[6] = size;
+    if (!Append(block, sizeof(block)) || !Append(frame.GetData(), size) || !Append(Padding, padding) || !Append(&block[1], sizeof(uint32_t)))
+      return false;
+  }
+
+  ++m_frameCount;
+  return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 PEthSocketThread::PEthSocketThread(const FrameNotifier & notifier)
@@ -11,6 +11,10 @@
  * if not then check PWLIBPLUGINDIR is defined. 
  * If not use P_DEFAULT_PLUGIN_DIR (hard coded as DEFINE).
  *
+ * If the environment variable "PTLIBPLUGINCACHE" names a manifest file, the
+ * services each plugin provides are cached there, so plugins found in it are
+ * only loaded when one of their services is used.
+ *
  * Plugin must have suffixes:
  * #define PTPLUGIN_SUFFIX       "_ptplugin"
  * #define PWPLUGIN_SUFFIX       "_pwplugin"
@@ -51,6 +55,8 @@
 #define PTPLUGIN_SUFFIX       "_ptplugin"
 #define PWPLUGIN_SUFFIX       "_pwplugin"
 
+#define P_PLUGIN_MANIFEST_HEADER  "PTLib plugin manifest 1"
+
 const char PPluginServiceDescriptor::SeparatorChar = '\t';
 
 
@@ -107,9 +113,117 @@ bool PPluginDeviceDescriptor::GetDeviceCapabilities(const PString & /*deviceName
 }
 
 
+//////////////////////////////////////////////////////
+
+/* Stand ins for the service descriptors of a plugin that has been found in
+   the manifest, but not yet loaded. The plugin is loaded the first time
+   anything is asked of the descriptor that the manifest cannot answer.
+ */
+class PPluginDeferredLoader
+{
+  public:
+    PPluginDeferredLoader(PPluginManager & manager,
+                          const PFilePath & fileName,
+                          const PPluginManager::ManifestService & service)
+      : m_manager(manager)
+      , m_fileName(fileName)
+      , m_key(service.m_key)
+      , m_type(service.m_type)
+      , m_name(service.m_name)
+      , m_friendlyName(service.m_friendlyName)
+      , m_descriptor(NULL)
+    {
+    }
+
+    const PPluginServiceDescriptor * GetDescriptor() const
+    {
+      if (m_descriptor == NULL) {
+        m_manager.LoadDeferredPlugin(m_fileName);
+        m_descriptor = PPluginFactory::CreateInstance(m_key);
+        PTRACE_IF(2, m_descriptor == NULL, "PLUGIN", "Plugin " << m_fileName << " no longer provides \"" << m_key << '"');
+      }
+      return m_descriptor;
+    }
+
+    PPluginManager & m_manager;
+    PFilePath        m_fileName;
+    std::string      m_key;
+    PString          m_type;
+    PString          m_name;
+    PString          m_friendlyName;
+    mutable const PPluginServiceDescriptor * m_descriptor;
+};
+
+
+template <class Base>
+class PPluginDeferredDescriptor : public Base
+{
+  public:
+    PPluginDeferredDescriptor(const PPluginDeferredLoader & loader)
+      : m_loader(loader)
+    {
+    }
+
+    virtual const char * GetServiceType() const { return m_loader.m_type; }
+    virtual const char * GetServiceName() const { return m_loader.m_name; }
+    virtual const char * GetFriendlyName() const { return m_loader.m_friendlyName; }
+
+    virtual PObject * CreateInstance(P_INT_PTR userData) const
+    {
+      const PPluginServiceDescriptor * descriptor = m_loader.GetDescriptor();
+      return descriptor != NULL ? descriptor->CreateInstance(userData) : NULL;
+    }
+
+  protected:
+    PPluginDeferredLoader m_loader;
+};
+
+
+class PPluginDeferredDevice : public PPluginDeferredDescriptor<PPluginDeviceDescriptor>
+{
+  public:
+    PPluginDeferredDevice(const PPluginDeferredLoader & loader)
+      : PPluginDeferredDescriptor<PPluginDeviceDescriptor>(loader)
+    {
+    }
+
+    virtual bool ValidateServiceName(const PString & name, P_INT_PTR userData) const
+    {
+      const PPluginDeviceDescriptor * descriptor = GetDevice();
+      return descriptor != NULL && descriptor->ValidateServiceName(name, userData);
+    }
+
+    virtual PStringArray GetDeviceNames(P_INT_PTR userData) const
+    {
+      const PPluginDeviceDescriptor * descriptor = GetDevice();
+      return descriptor != NULL ? descriptor->GetDeviceNames(userData) : PStringArray();
+    }
+
+    virtual bool ValidateDeviceName(const PString & deviceName, P_INT_PTR userData) const
+    {
+      const PPluginDeviceDescriptor * descriptor = GetDevice();
+      return descriptor != NULL && descriptor->ValidateDeviceName(deviceName, userData);
+    }
+
+    virtual bool GetDeviceCapabilities(const PString & deviceName, void * capabilities) const
+    {
+      const PPluginDeviceDescriptor * descriptor = GetDevice();
+      return descriptor != NULL && descriptor->GetDeviceCapabilities(deviceName, capabilities);
+    }
+
+  protected:
+    const PPluginDeviceDescriptor * GetDevice() const
+    {
+      return dynamic_cast<const PPluginDeviceDescriptor *>(m_loader.GetDescriptor());
+    }
+};
+
+
 //////////////////////////////////////////////////////
 
 PPluginManager::PPluginManager()
+  : m_manifestFileSet(false)
+  , m_manifestDirty(false)
 {
   m_suffixes.AppendString(PTPLUGIN_SUFFIX);
   m_suffixes.AppendString(PWPLUGIN_SUFFIX);
@@ -149,8 +263,37 @@ void PPluginManager::AddDirectory(const PDirectory & dir)
 void PPluginManager::LoadDirectories()
 {
   PTRACE(4, "PLUGIN\tEnumerating plugin directories " << setfill(PPATH_SEPARATOR) << m_directories);
+
+  PTime startTime;
+  LoadManifest();
+
+  PINDEX loadedBefore = m_plugins.GetSize();
+  PINDEX deferredBefore = m_deferredPlugins.GetSize();
+
   for (PList<PDirectory>::iterator it = m_directories.begin(); it != m_directories.end(); ++it)
     LoadDirectory(*it);
+
+  if (!m_manifestFile.IsEmpty()) {
+    /* Forget about plugins that have gone away from the directories we just
+       searched, entries for other directories belong to other applications
+       sharing the manifest. */
+    Manifest::iterator it = m_manifest.begin();
+    while (it != m_manifest.end()) {
+      if (it->second.m_seen || !IsInDirectories(it->first))
+        ++it;
+      else {
+        m_manifest.erase(it++);
+        m_manifestDirty = true;
+      }
+    }
+
+    if (m_manifestDirty)
+      SaveManifest();
+  }
+
+  PTRACE(3, "PLUGIN", "Loaded " << (m_plugins.GetSize() - loadedBefore) << " plugins, "
+         << (m_deferredPlugins.GetSize() - deferredBefore) << " deferred via manifest, "
+            "in " << (PTime() - startTime) << " seconds");
 }
 
 
@@ -177,8 +320,10 @@ void PPluginManager::LoadDirectory(const PDirectory & directory)
       for (PStringList::iterator it = m_suffixes.begin(); it != m_suffixes.end(); ++it) {
         PString suffix = *it;
         PTRACE(5, "PLUGIN\tChecking " << fn << " against suffix " << suffix);
-        if ((fn.GetType() *= PDynaLink::GetExtension()) && (fn.GetTitle().Right(strlen(suffix)) *= suffix)) 
-          LoadPlugin(entry);
+        if ((fn.GetType() *= PDynaLink::GetExtension()) && (fn.GetTitle().Right(strlen(suffix)) *= suffix)) {
+          if (!LoadFromManifest(fn))
+            LoadPlugin(entry);
+        }
       }
     }
   } while (dir.Next());
@@ -187,6 +332,10 @@ void PPluginManager::LoadDirectory(const PDirectory & directory)
 
 PBoolean PPluginManager::LoadPlugin(const PString & fileName)
 {
+  PPluginFactory::KeyList_T previousKeys;
+  if (!m_manifestFile.IsEmpty())
+    previousKeys = PPluginFactory::GetKeyList();
+
   PDynaLink *dll = new PDynaLink(fileName);
   if (!dll->IsLoaded()) {
     PTRACE(4, "PLUGIN\tFailed to open " << fileName << " error: " << dll->GetLastError());
@@ -221,6 +370,9 @@ PBoolean PPluginManager::LoadPlugin(const PString & fileName)
           m_plugins.Append(dll);
           m_pluginsMutex.Signal();
 
+          if (!m_manifestFile.IsEmpty())
+            AddToManifest(fileName, previousKeys);
+
           // call the notifier
           CallNotifier(*dll, LoadingPlugIn);
           return true;
@@ -240,6 +392,231 @@ PBoolean PPluginManager::LoadPlugin(const PString & fileName)
 }
 
 
+bool PPluginManager::LoadManifest()
+{
+  m_manifest.clear();
+  m_manifestDirty = false;
+
+  if (m_manifestFile.IsEmpty())
+    return false;
+
+  PTextFile file;
+  if (!file.Open(m_manifestFile, PFile::ReadOnly)) {
+    PTRACE(4, "PLUGIN", "No plugin manifest at " << m_manifestFile);
+    m_manifestDirty = true;
+    return false;
+  }
+
+  PString line;
+  if (!file.ReadLine(line) || line != P_PLUGIN_MANIFEST_HEADER) {
+    PTRACE(2, "PLUGIN", "Ignoring invalid plugin manifest " << m_manifestFile);
+    m_manifestDirty = true;
+    return false;
+  }
+
+  ManifestEntry * entry = NULL;
+  while (file.ReadLine(line)) {
+    PStringArray fields = line.Tokenise(PPluginServiceDescriptor::SeparatorChar, true);
+    if (fields.GetSize() == 4 && fields[0] == "plugin") {
+      entry = &m_manifest[fields[1]];
+      entry->m_modified = (time_t)fields[2].AsInt64();
+      entry->m_size = fields[3].AsUnsigned64();
+    }
+    else if (fields.GetSize() == 6 && fields[0] == "service" && entry != NULL) {
+      ManifestService service;
+      service.m_key = (const char *)fields[1];
+      service.m_type = fields[2];
+      service.m_name = fields[3];
+      service.m_friendlyName = fields[4];
+      service.m_device = fields[5].AsUnsigned() != 0;
+      entry->m_services.push_back(service);
+    }
+    else {
+      PTRACE(2, "PLUGIN", "Invalid line in plugin manifest " << m_manifestFile << ": " << line);
+      m_manifest.clear();
+      m_manifestDirty = true;
+      return false;
+    }
+  }
+
+  PTRACE(4, "PLUGIN", "Read " << m_manifest.size() << " plugins from manifest " << m_manifestFile);
+  return true;
+}
+
+
+bool PPluginManager::SaveManifest()
+{
+  if (m_manifestFile.IsEmpty())
+    return false;
+
+  // Write to a temporary and rename, so concurrent processes never see a partial file
+  PFilePath tempFile = m_manifestFile + ".tmp";
+  {
+    PTextFile file;
+    if (!file.Open(tempFile, PFile::WriteOnly)) {
+      PTRACE(2, "PLUGIN", "Could not write plugin manifest " << tempFile << ": " << file.GetErrorText());
+      return false;
+    }
+
+    const char tab = PPluginServiceDescriptor::SeparatorChar;
+    file << P_PLUGIN_MANIFEST_HEADER "\n";
+    for (Manifest::const_iterator it = m_manifest.begin(); it != m_manifest.end(); ++it) {
+      file << "plugin" << tab << it->first << tab << (PInt64)it->second.m_modified << tab << it->second.m_size << '\n';
+      for (ManifestServices::const_iterator svc = it->second.m_services.begin(); svc != it->second.m_services.end(); ++svc)
+        file << "service" << tab << svc->m_key << tab << svc->m_type << tab << svc->m_name
+             << tab << svc->m_friendlyName << tab << svc->m_device << '\n';
+    }
+
+    if (!file.Close()) {
+      PTRACE(2, "PLUGIN", "Could not write plugin manifest " << tempFile << ": " << file.GetErrorText());
+      return false;
+    }
+  }
+
+  if (!PFile::Rename(tempFile, m_manifestFile.GetFileName(), true)) {
+    PTRACE(2, "PLUGIN", "Could not rename plugin manifest " << tempFile << " to " << m_manifestFile);
+    PFile::Remove(tempFile);
+    return false;
+  }
+
+  PTRACE(4, "PLUGIN", "Wrote " << m_manifest.size() << " plugins to manifest " << m_manifestFile);
+  m_manifestDirty = false;
+  return true;
+}
+
+
+bool PPluginManager::LoadFromManifest(const PFilePath & fileName)
+{
+  if (m_manifestFile.IsEmpty())
+    return false;
+
+  Manifest::iterator it = m_manifest.find(fileName);
+  if (it == m_manifest.end())
+    return false;
+
+  PFileInfo info;
+  if (!PFile::GetInfo(fileName, info) ||
+       info.modified.GetTimeInSeconds() != it->second.m_modified ||
+       info.size != it->second.m_size) {
+    PTRACE(4, "PLUGIN", "Plugin manifest out of date for " << fileName);
+    m_manifest.erase(it);
+    m_manifestDirty = true;
+    return false;
+  }
+
+  it->second.m_seen = true;
+
+  PWaitAndSignal mutex(m_servicesMutex);
+
+  bool deferred = false;
+  for (ManifestServices::const_iterator svc = it->second.m_services.begin(); svc != it->second.m_services.end(); ++svc) {
+    if (GetServiceDescriptor(svc->m_name, svc->m_type) != NULL) {
+      PTRACE(3, "PLUGIN\tDuplicate \"" << svc->m_key << "\" in " << fileName);
+      continue;
+    }
+
+    PPluginDeferredLoader loader(*this, fileName, *svc);
+    PPluginServiceDescriptor * descriptor;
+    if (svc->m_device)
+      descriptor = new PPluginDeferredDevice(loader);
+    else
+      descriptor = new PPluginDeferredDescriptor<PPluginServiceDescriptor>(loader);
+    m_deferredServices.push_back(descriptor);
+    m_services.insert(ServiceMap::value_type(descriptor->GetServiceType(), descriptor));
+    deferred = true;
+  }
+
+  if (deferred) {
+    PTRACE(4, "PLUGIN", "Deferred loading " << fileName);
+    m_deferredPlugins += fileName;
+  }
+
+  return true;
+}
+
+
+void PPluginManager::AddToManifest(const PFilePath & fileName, const PPluginFactory::KeyList_T & previousKeys)
+{
+  ManifestServices services;
+
+  PPluginFactory::KeyList_T keys = PPluginFactory::GetKeyList();
+  for (PPluginFactory::KeyList_T::iterator key = keys.begin(); key != keys.end(); ++key) {
+    if (std::find(previousKeys.begin(), previousKeys.end(), *key) != previousKeys.end())
+      continue;
+
+    const PPluginServiceDescriptor * descriptor = PPluginFactory::CreateInstance(*key);
+    if (descriptor == NULL)
+      continue;
+
+    ManifestService service;
+    service.m_key = *key;
+    service.m_type = descriptor->GetServiceType();
+    service.m_name = descriptor->GetServiceName();
+    service.m_friendlyName = descriptor->GetFriendlyName();
+    service.m_device = dynamic_cast<const PPluginDeviceDescriptor *>(descriptor) != NULL;
+    services.push_back(service);
+  }
+
+  // Plugins without services, e.g. codecs, always need to be loaded
+  if (services.empty()) {
+    if (m_manifest.erase(fileName) > 0)
+      m_manifestDirty = true;
+    return;
+  }
+
+  PFileInfo info;
+  if (!PFile::GetInfo(fileName, info))
+    return;
+
+  ManifestEntry & entry = m_manifest[fileName];
+  entry.m_modified = info.modified.GetTimeInSeconds();
+  entry.m_size = info.size;
+  entry.m_seen = true;
+  entry.m_services = services;
+  m_manifestDirty = true;
+}
+
+
+bool PPluginManager::IsInDirectories(const PFilePath & fileName) const
+{
+  for (PList<PDirectory>::const_iterator it = m_directories.begin(); it != m_directories.end(); ++it) {
+    if (fileName.NumCompare(*it) == EqualTo)
+      return true;
+  }
+  return false;
+}
+
+
+bool PPluginManager::LoadDeferredPlugin(const PFilePath & fileName)
+{
+  /* Only one deferred load at a time, so a second user of the same plugin
+     waits for it to be loaded rather than finding nothing in the factory,
+     but m_servicesMutex is not held while the plugin is loaded. */
+  PWaitAndSignal loading(m_loadingMutex);
+
+  {
+    PWaitAndSignal mutex(m_servicesMutex);
+    if (!m_deferredPlugins.Contains(fileName))
+      return true;
+    m_deferredPlugins -= fileName;
+  }
+
+  PTRACE(3, "PLUGIN", "Loading deferred plugin " << fileName);
+  return LoadPlugin(fileName);
+}
+
+
+PPluginManager::Descriptors PPluginManager::GetServiceDescriptors(const PString & serviceType) const
+{
+  PWaitAndSignal mutex(m_servicesMutex);
+
+  Descriptors descriptors;
+  for (ServiceMap::const_iterator it = m_services.find(serviceType); it != m_services.end() && it->first == serviceType; ++it)
+    descriptors.push_back(it->second);
+  return descriptors;
+}
+
+
 PStringArray PPluginManager::GetServiceTypes() const
 {
   PWaitAndSignal mutex(m_servicesMutex);
@@ -286,7 +663,7 @@ PObject * PPluginManager::CreatePlugin(const PString & serviceName,
                                        const PString & serviceType,
                                        P_INT_PTR userData) const
 {
-  PWaitAndSignal mutex(m_servicesMutex);
+  // Descriptors are called without m_servicesMutex, as they may load a deferred plugin
 
   {
     // If have tab character, then have explicit driver name in device
@@ -296,9 +673,10 @@ PObject * PPluginManager::CreatePlugin(const PString & serviceName,
       return descriptor->CreateInstance(userData);
   }
 
-  for (ServiceMap::const_iterator it = m_services.find(serviceType); it != m_services.end() && it->first == serviceType; ++it) {
-    if (it->second->ValidateServiceName(serviceName, userData))
-      return it->second->CreateInstance(userData);
+  Descriptors descriptors = GetServiceDescriptors(serviceType);
+  for (Descriptors::iterator it = descriptors.begin(); it != descriptors.end(); ++it) {
+    if ((*it)->ValidateServiceName(serviceName, userData))
+      return (*it)->CreateInstance(userData);
   }
 
   return NULL;
@@ -310,8 +688,6 @@ PStringArray PPluginManager::GetPluginDeviceNames(const PString & serviceName,
                                                   P_INT_PTR userData,
                                                   const char * const * prioritisedDrivers) const
 {
-  PWaitAndSignal mutex(m_servicesMutex);
-
   if (!serviceName.IsEmpty() && serviceName.Find('*') == P_MAX_INDEX) {
     const PPluginDeviceDescriptor * descriptor = dynamic_cast<const PPluginDeviceDescriptor *>(GetServiceDescriptor(serviceName, serviceType));
     return descriptor != NULL ? descriptor->GetDeviceNames(userData) : PStringArray();
@@ -322,8 +698,9 @@ PStringArray PPluginManager::GetPluginDeviceNames(const PString & serviceName,
 
   // First we run through all of the drivers and their lists of devices and
   // use the dictionary to assure all names are unique
-  for (ServiceMap::const_iterator it = m_services.find(serviceType); it != m_services.end() && it->first == serviceType; ++it) {
-    const PPluginDeviceDescriptor * descriptor = dynamic_cast<const PPluginDeviceDescriptor *>(it->second);
+  Descriptors descriptors = GetServiceDescriptors(serviceType);
+  for (Descriptors::iterator it = descriptors.begin(); it != descriptors.end(); ++it) {
+    const PPluginDeviceDescriptor * descriptor = dynamic_cast<const PPluginDeviceDescriptor *>(*it);
     if (descriptor != NULL) {
       PCaselessString driver = descriptor->GetServiceName();
       PStringArray devices = descriptor->GetDeviceNames(userData);
@@ -378,9 +755,9 @@ PBoolean PPluginManager::GetPluginsDeviceCapabilities(const PString & serviceTyp
     return false;
 
   if (serviceName.IsEmpty() || serviceName == "*") {
-    PWaitAndSignal mutex(m_servicesMutex);
-    for (ServiceMap::const_iterator it = m_services.find(serviceType); it != m_services.end() && it->first == serviceType; ++it) {
-      const PPluginDeviceDescriptor * desc = dynamic_cast<const PPluginDeviceDescriptor *>(it->second);
+    Descriptors descriptors = GetServiceDescriptors(serviceType);
+    for (Descriptors::iterator it = descriptors.begin(); it != descriptors.end(); ++it) {
+      const PPluginDeviceDescriptor * desc = dynamic_cast<const PPluginDeviceDescriptor *>(*it);
       if (desc != NULL && desc->ValidateDeviceName(deviceName, 0))
         return desc->GetDeviceCapabilities(deviceName,capabilities);
     }
@@ -431,6 +808,11 @@ void PPluginManager::OnShutdown()
 
   m_services.clear();
 
+  for (std::list<PPluginServiceDescriptor *>::iterator it = m_deferredServices.begin(); it != m_deferredServices.end(); ++it)
+    delete *it;
+  m_deferredServices.clear();
+  m_deferredPlugins.RemoveAll();
+
   m_plugins.RemoveAll();
 }
 
@@ -522,6 +904,12 @@ void PluginLoaderStartup::OnStartup()
     pluginMgr.SetDirectories(env);
   }
 
+  if (!pluginMgr.m_manifestFileSet) {
+    const char * env = ::getenv(P_PTLIB_PLUGIN_CACHE_ENV_VAR);
+    if (env != NULL)
+      pluginMgr.m_manifestFile = env;
+  }
+
   // load the plugin module managers
   PFactory<PPluginModuleManager>::KeyList_T keyList = PFactory<PPluginModuleManager>::GetKeyList();
   for (PFactory<PPluginModuleManager>::KeyList_T::const_iterator it = keyList.begin(); it != keyList.end(); ++it)
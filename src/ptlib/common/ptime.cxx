@@ -286,8 +286,7 @@ PTime::PTime(time_t tsecs, int64_t usecs)
 PTime::PTime(const PString & str)
   : m_microSecondsSinceEpoch(0)
 {
-  PStringStream s(str);
-  ReadFrom(s);
+  Parse(str);
 }
 
 
@@ -567,25 +566,98 @@ PString PTime::AsString(TimeFormat format, int zone) const
 }
 
 
-PString PTime::AsString(const char * format, int zone) const
-{
-  PAssert(format != NULL, PInvalidParameter);
-  PAssert(zone == Local || std::abs(zone) <= 13, PInvalidParameter);
+namespace {
+  /* Plain data, so it can be in __thread storage, which needs no lock or
+     lookup, unlike PThreadLocalStorage, and no clean up at thread exit.
+     Formats or results too long for the buffers are simply not cached. */
+  struct PTimeFormatCache
+  {
+    enum {
+      MaxFormat = 64,
+      MaxResult = 128,
+      MaxFractions = 4,
+      NumEntries = 4
+    };
+
+    struct Fraction
+    {
+      PINDEX m_offset;
+      PINDEX m_digits;
+    };
 
-  if (!IsValid())
-    return "<invalid>";
+    struct Fractions
+    {
+      Fraction m_list[MaxFractions];
+      PINDEX   m_count; // May be more than MaxFractions, then not cacheable
+    };
 
-  // the localtime call automatically adjusts for daylight savings time
-  // so take this into account when converting non-local times
-  if (zone == Local)
-    zone = GetTimeZone();  // includes daylight savings time
-  time_t realTime = m_microSecondsSinceEpoch.load()/Micro + zone*60;     // to correct timezone
-  struct tm ts;
-  struct tm * t = os_gmtime(&realTime, &ts);
-  if (t == NULL)
-    return "<error>";
+    struct Entry
+    {
+      char      m_format[MaxFormat];
+      int       m_zone;
+      time_t    m_seconds; // Zero initialised, so only valid if m_format is set
+      char      m_result[MaxResult];
+      PINDEX    m_length;
+      Fractions m_fractions;
+    };
+
+    Entry    m_entries[NumEntries];
+    unsigned m_nextEntry;
+
+    time_t   m_localZoneExpiry;
+    int      m_localZone;
+
+    /* Daylight savings transitions always occur on a quarter hour boundary,
+       so the local time zone offset need only be checked that often. */
+    int GetLocalZone()
+    {
+      time_t now = time(NULL);
+      if (now >= m_localZoneExpiry) {
+        m_localZone = PTime::GetTimeZone();
+        m_localZoneExpiry = (now/900+1)*900;
+      }
+      return m_localZone;
+    }
 
-  PStringStream str;
+    Entry * GetEntry(const char * format, int zone, time_t seconds, bool & found)
+    {
+      found = false;
+      if (*format == '\0' || strlen(format) >= MaxFormat)
+        return NULL;
+
+      for (unsigned i = 0; i < NumEntries; ++i) {
+        Entry & entry = m_entries[i];
+        if (entry.m_zone == zone && strcmp(entry.m_format, format) == 0) {
+          found = entry.m_seconds == seconds;
+          return &entry;
+        }
+      }
+
+      Entry & entry = m_entries[m_nextEntry];
+      m_nextEntry = (m_nextEntry+1)%NumEntries;
+      strcpy(entry.m_format, format);
+      entry.m_zone = zone;
+      return &entry;
+    }
+  };
+}
+
+#if defined(_MSC_VER)
+  #define PTIME_THREAD_LOCAL __declspec(thread)
+#else
+  #define PTIME_THREAD_LOCAL __thread
+#endif
+
+static PTIME_THREAD_LOCAL PTimeFormatCache t_timeFormatCache;
+
+
+static void FormatTime(ostream & str,
+                       const char * format,
+                       int zone,
+                       const struct tm * t,
+                       unsigned usecs,
+                       PTimeFormatCache::Fractions & fractions)
+{
   str.fill('0');
 
   bool is12hour = strchr(format, 'a') != NULL;
@@ -599,9 +671,9 @@ PString PTime::AsString(const char * format, int zone) const
     switch (formatLetter) {
       case 'a' :
         if (t->tm_hour < 12)
-          str << GetTimeAM();
+          str << PTime::GetTimeAM();
         else
-          str << GetTimePM();
+          str << PTime::GetTimePM();
         break;
 
       case 'h' :
@@ -618,7 +690,7 @@ PString PTime::AsString(const char * format, int zone) const
 
       case 'w' :
         if (repeatCount != 3 || *format != 'e')
-          str << GetDayName((Weekdays)t->tm_wday, repeatCount <= 3 ? Abbreviated : FullName);
+          str << PTime::GetDayName((PTime::Weekdays)t->tm_wday, repeatCount <= 3 ? PTime::Abbreviated : PTime::FullName);
         else {
           static const char * const EnglishDayName[] = {
             "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
@@ -632,8 +704,8 @@ PString PTime::AsString(const char * format, int zone) const
         if (repeatCount < 3)
           str << setw(repeatCount) << (t->tm_mon+1);
         else if (repeatCount > 3 || *format != 'E')
-          str << GetMonthName((Months)(t->tm_mon+1),
-                                    repeatCount == 3 ? Abbreviated : FullName);
+          str << PTime::GetMonthName((PTime::Months)(t->tm_mon+1),
+                                     repeatCount == 3 ? PTime::Abbreviated : PTime::FullName);
         else {
           static const char * const EnglishMonthName[] = {
             "Jan", "Feb", "Mar", "Apr", "May", "Jun",
@@ -673,7 +745,8 @@ PString PTime::AsString(const char * format, int zone) const
 
       case 'u':
       {
-        unsigned usecs = m_microSecondsSinceEpoch.load()%Micro;
+        PTimeFormatCache::Fraction fraction;
+        fraction.m_offset = (PINDEX)str.tellp();
         switch (repeatCount) {
           case 1:
             str << (usecs / 100000);
@@ -688,6 +761,10 @@ PString PTime::AsString(const char * format, int zone) const
             str << setw(6) << usecs;
             break;
         }
+        fraction.m_digits = (PINDEX)str.tellp() - fraction.m_offset;
+        if (fractions.m_count < PTimeFormatCache::MaxFractions)
+          fractions.m_list[fractions.m_count] = fraction;
+        ++fractions.m_count;
         break;
       }
 
@@ -698,7 +775,81 @@ PString PTime::AsString(const char * format, int zone) const
         str << formatLetter;
     }
   }
+}
+
 
+PString PTime::AsString(const char * format, int zone) const
+{
+  PAssert(format != NULL, PInvalidParameter);
+  PAssert(zone == Local || std::abs(zone) <= 13, PInvalidParameter);
+
+  if (!IsValid())
+    return "<invalid>";
+
+  PTimeFormatCache & cache = t_timeFormatCache;
+
+  // the localtime call automatically adjusts for daylight savings time
+  // so take this into account when converting non-local times
+  if (zone == Local)
+    zone = cache.GetLocalZone();  // includes daylight savings time
+
+  int64_t microSeconds = m_microSecondsSinceEpoch.load();
+  time_t seconds = microSeconds/Micro;
+  unsigned usecs = (unsigned)(microSeconds%Micro);
+
+  bool found;
+  PTimeFormatCache::Entry * entry = cache.GetEntry(format, zone, seconds, found);
+  if (!found) {
+    if (entry != NULL)
+      entry->m_seconds = -1;
+
+    time_t realTime = seconds + zone*60;     // to correct timezone
+    struct tm ts;
+    struct tm * t = os_gmtime(&realTime, &ts);
+    if (t == NULL)
+      return "<error>";
+
+    // Use std::ostringstream as need tellp() to locate fractional digits
+    std::ostringstream str;
+    PTimeFormatCache::Fractions fractions;
+    fractions.m_count = 0;
+    FormatTime(str, format, zone, t, usecs, fractions);
+    std::string result = str.str();
+
+    if (entry != NULL && result.length() < PTimeFormatCache::MaxResult && fractions.m_count <= PTimeFormatCache::MaxFractions) {
+      memcpy(entry->m_result, result.c_str(), result.length()+1);
+      entry->m_length = result.length();
+      entry->m_fractions = fractions;
+      entry->m_seconds = seconds;
+    }
+    return PString(result.c_str(), result.length());
+  }
+
+  PString str(entry->m_result, entry->m_length);
+  if (entry->m_fractions.m_count == 0)
+    return str;
+
+  // Same second as last time, so only the fractional digits change
+  char * ptr = str.GetPointerAndSetLength(entry->m_length);
+  for (PINDEX f = 0; f < entry->m_fractions.m_count; ++f) {
+    const PTimeFormatCache::Fraction * it = &entry->m_fractions.m_list[f];
+    unsigned value = usecs;
+    switch (it->m_digits) {
+      case 1 :
+        value /= 100000;
+        break;
+      case 2 :
+        value /= 10000;
+        break;
+      case 3 :
+        value /= 1000;
+        break;
+    }
+    for (PINDEX i = it->m_digits; i > 0; --i) {
+      ptr[it->m_offset+i-1] = (char)('0' + value%10);
+      value /= 10;
+    }
+  }
   return str;
 }
 
@@ -769,12 +920,189 @@ void PTime::ReadFrom(istream & strm)
 
 bool PTime::Parse(const PString & str)
 {
+  if (ParseStandardFormat(str))
+    return true;
+
   PStringStream strm(str);
   ReadFrom(strm);
   return IsValid();
 }
 
 
+static bool ParseNumber(const char * & ptr, unsigned minDigits, unsigned maxDigits, int & value)
+{
+  value = 0;
+  unsigned count = 0;
+  while (count < maxDigits && isdigit(*ptr & 0xff)) {
+    value = value*10 + *ptr++ - '0';
+    ++count;
+  }
+  return count >= minDigits;
+}
+
+
+static bool ParseFraction(const char * & ptr, int & usecs)
+{
+  usecs = 0;
+  if (*ptr != '.' && *ptr != ',')
+    return true;
+
+  ++ptr;
+  if (!isdigit(*ptr & 0xff))
+    return false;
+
+  int scale = 100000;
+  while (isdigit(*ptr & 0xff)) {
+    usecs += (*ptr++ - '0')*scale;
+    scale /= 10;
+  }
+  return true;
+}
+
+
+static bool ParseZone(const char * & ptr, bool allowNames, int & zone)
+{
+  while (*ptr == ' ')
+    ++ptr;
+
+  if (*ptr == 'Z') {
+    ++ptr;
+    zone = 0;
+    return true;
+  }
+
+  if (*ptr == '+' || *ptr == '-') {
+    bool negative = *ptr++ == '-';
+    int hours, minutes = 0;
+    if (!ParseNumber(ptr, 2, 2, hours))
+      return false;
+    if (*ptr == ':')
+      ++ptr;
+    if (isdigit(*ptr & 0xff) && !ParseNumber(ptr, 2, 2, minutes))
+      return false;
+    if (hours > 14 || minutes > 59)
+      return false;
+    zone = hours*60 + minutes;
+    if (negative)
+      zone = -zone;
+    return true;
+  }
+
+  if (allowNames) {
+    static const char * const UniversalNames[] = { "GMT", "UTC", "UT" };
+    for (PINDEX i = 0; i < PARRAYSIZE(UniversalNames); ++i) {
+      size_t len = strlen(UniversalNames[i]);
+      if (strncmp(ptr, UniversalNames[i], len) == 0) {
+        ptr += len;
+        zone = 0;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+bool PTime::ParseStandardFormat(const char * str)
+{
+  if (str == NULL)
+    return false;
+
+  const char * ptr = str;
+  while (isspace(*ptr & 0xff))
+    ++ptr;
+
+  int year, month, day, hour, minute, second = 0, usecs = 0, zone;
+
+  if (isdigit(ptr[0] & 0xff) && isdigit(ptr[1] & 0xff) && isdigit(ptr[2] & 0xff) && isdigit(ptr[3] & 0xff)) {
+    // ISO 8601, either extended yyyy-MM-ddThh:mm:ss or basic yyyyMMddThhmmss
+    ParseNumber(ptr, 4, 4, year);
+    bool extended = *ptr == '-';
+    if (extended)
+      ++ptr;
+    if (!ParseNumber(ptr, 2, 2, month))
+      return false;
+    if (extended && *ptr++ != '-')
+      return false;
+    if (!ParseNumber(ptr, 2, 2, day))
+      return false;
+    if (*ptr != 'T' && *ptr != 't' && !(extended && *ptr == ' '))
+      return false;
+    ++ptr;
+    if (!ParseNumber(ptr, 2, 2, hour))
+      return false;
+    if (extended && *ptr++ != ':')
+      return false;
+    if (!ParseNumber(ptr, 2, 2, minute))
+      return false;
+    if (extended ? *ptr == ':' : isdigit(*ptr & 0xff)) {
+      if (extended)
+        ++ptr;
+      if (!ParseNumber(ptr, 2, 2, second) || !ParseFraction(ptr, usecs))
+        return false;
+    }
+    if (!ParseZone(ptr, false, zone))
+      return false;
+  }
+  else {
+    // RFC 1123, [www, ]d MMM yyyy hh:mm:ss zone
+    if (isalpha(*ptr & 0xff)) {
+      while (isalpha(*ptr & 0xff))
+        ++ptr;
+      if (*ptr++ != ',')
+        return false;
+      while (*ptr == ' ')
+        ++ptr;
+    }
+
+    if (!ParseNumber(ptr, 1, 2, day) || *ptr++ != ' ')
+      return false;
+
+    static const char MonthNames[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    for (month = 1; month <= 12; ++month) {
+      if (strncasecmp(ptr, &MonthNames[(month-1)*3], 3) == 0)
+        break;
+    }
+    if (month > 12)
+      return false;
+    ptr += 3;
+
+    if (*ptr++ != ' ' || !ParseNumber(ptr, 4, 4, year) || *ptr++ != ' ')
+      return false;
+    if (!ParseNumber(ptr, 2, 2, hour) || *ptr++ != ':' || !ParseNumber(ptr, 2, 2, minute))
+      return false;
+    if (*ptr == ':') {
+      ++ptr;
+      if (!ParseNumber(ptr, 2, 2, second))
+        return false;
+    }
+    if (!ParseZone(ptr, true, zone))
+      return false;
+  }
+
+  while (isspace(*ptr & 0xff))
+    ++ptr;
+  if (*ptr != '\0')
+    return false;
+
+  if (year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+    return false;
+
+  // Days since the epoch for the civil date, see http://howardhinnant.github.io/date_algorithms.html
+  int y = month <= 2 ? year-1 : year;
+  int era = y/400;
+  int yearOfEra = y - era*400;
+  int dayOfYear = (153*(month > 2 ? month-3 : month+9) + 2)/5 + day-1;
+  int dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+  int64_t days = (int64_t)era*146097 + dayOfEra - 719468;
+
+  int64_t seconds = ((days*24 + hour)*60 + minute - zone)*60 + second;
+  m_microSecondsSinceEpoch.store(seconds*Micro + usecs);
+  return true;
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 // P_timeval
 
@@ -30,6 +30,7 @@
 
 #include <ptlib.h>
 #include <ptlib/safecoll.h>
+#include <ptlib/metrics.h>
 
 
 #define PTraceModule() "SafeColl"
@@ -264,6 +265,9 @@ void PSafeLockBase::Unlock()
 
 /////////////////////////////////////////////////////////////////////////////
 
+static PMetricGauge s_collectionObjects("ptlib_safe_collection_objects", "Objects held in all PSafeCollection instances");
+static PMetricGauge s_collectionPending("ptlib_safe_collection_pending_removal", "Objects removed from a PSafeCollection awaiting deletion");
+
 PSafeCollection::PSafeCollection(PCollection * coll)
   : m_collection(PAssertNULL(coll))
   , m_collectionMutex(PDebugLocation(__FILE__, __LINE__, "SafeCollection"))
@@ -299,6 +303,7 @@ PSafeCollection::~PSafeCollection()
       i->m_safelyBeingRemoved = false;
     }
   }
+  s_collectionPending.Dec(m_toBeRemoved.GetSize());
 
   delete m_collection;
 }
@@ -367,7 +372,11 @@ bool PSafeCollection::SafeAddObject(PSafeObject * obj, PSafeObject * old)
   if (obj == NULL)
     return false;
 
-  return PAssert(m_collection->GetObjectsIndex(obj) == P_MAX_INDEX, "Cannot insert safe object twice") && obj->SafeReference();
+  if (!PAssert(m_collection->GetObjectsIndex(obj) == P_MAX_INDEX, "Cannot insert safe object twice") || !obj->SafeReference())
+    return false;
+
+  s_collectionObjects.Inc();
+  return true;
 }
 
 
@@ -376,6 +385,8 @@ void PSafeCollection::SafeRemoveObject(PSafeObject * obj)
   if (obj == NULL)
     return;
 
+  s_collectionObjects.Dec();
+
   // Make sure SfeRemove() called before SafeDereference() to avoid race condition
   if (m_deleteObjects) {
     obj->SafeRemove();
@@ -383,6 +394,7 @@ void PSafeCollection::SafeRemoveObject(PSafeObject * obj)
     m_removalMutex.Wait();
     m_toBeRemoved.Append(obj);
     m_removalMutex.Signal();
+    s_collectionPending.Inc();
   }
 
   /* Even though we are marked as not to delete objects, we still need to obey
@@ -407,6 +419,7 @@ PBoolean PSafeCollection::DeleteObjectsToBeRemoved()
       if (it->GarbageCollection() && it->SafelyCanBeDeleted()) {
         PObject * obj = &*it;
         m_toBeRemoved.Remove(obj);
+        s_collectionPending.Dec();
 
         m_removalMutex.Signal();
         DeleteObject(obj);
@@ -470,8 +483,10 @@ void PSafeCollection::CopySafeCollection(PCollection * other)
 
   for (PINDEX i = 0; i < other->GetSize(); ++i) {
     PSafeObject * obj = dynamic_cast<PSafeObject *>(other->GetAt(i));
-    if (obj != NULL && obj->SafeReference())
+    if (obj != NULL && obj->SafeReference()) {
       m_collection->Append(obj);
+      s_collectionObjects.Inc();
+    }
   }
 }
 
@@ -482,8 +497,10 @@ void PSafeCollection::CopySafeDictionary(PAbstractDictionary * other)
 
   for (PINDEX i = 0; i < other->GetSize(); ++i) {
     PSafeObject * obj = dynamic_cast<PSafeObject *>(&other->AbstractGetDataAt(i));
-    if (obj != NULL && obj->SafeReference())
+    if (obj != NULL && obj->SafeReference()) {
       m_collection->Insert(other->AbstractGetKeyAt(i), obj);
+      s_collectionObjects.Inc();
+    }
   }
 }
 
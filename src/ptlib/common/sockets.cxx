@@ -1390,13 +1390,25 @@ bool PIPSocket::InternalListen(const Address & bindAddr,
     return false;
   }
 
-  int reuseAddr = reuse == CanReuseAddress ? 1 : 0;
+  int reuseAddr = reuse != AddressIsExclusive ? 1 : 0;
   if (!SetOption(SO_REUSEADDR, reuseAddr)) {
     PTRACE(4, "SetOption(SO_REUSEADDR," << reuseAddr << ") failed: " << GetErrorText());
     os_close();
     return false;
   }
 
+  if (reuse == CanReusePort) {
+#ifdef SO_REUSEPORT
+    if (!SetOption(SO_REUSEPORT, 1)) {
+      PTRACE(4, "SetOption(SO_REUSEPORT,1) failed: " << GetErrorText());
+      os_close();
+      return false;
+    }
+#else
+    PTRACE(3, "SO_REUSEPORT not supported, port " << m_port << " will not be shared");
+#endif
+  }
+
 #if P_HAS_IPV6 && defined(IPV6_V6ONLY)
   if (bindAddr.GetVersion() == 6) {
     if (!SetOption(IPV6_V6ONLY, reuseAddr, IPPROTO_IPV6)) {
@@ -269,12 +269,20 @@ PString PSoundChannel::GetDefaultDevice(Directions dir)
 
 PSoundChannel::PSoundChannel()
   : m_activeDirection(Closed)
+  , m_autoConvert(true)
+  , m_convertRate(0)
+  , m_convertPos(0)
+  , m_convertCount(0)
 {
 }
 
 
 PSoundChannel::PSoundChannel(const Params & params)
   : m_activeDirection(Closed)
+  , m_autoConvert(true)
+  , m_convertRate(0)
+  , m_convertPos(0)
+  , m_convertCount(0)
 {
   Open(params);
 }
@@ -286,6 +294,10 @@ PSoundChannel::PSoundChannel(const PString & device,
                              unsigned sampleRate,
                              unsigned bitsPerSample)
   : m_activeDirection(dir)
+  , m_autoConvert(true)
+  , m_convertRate(0)
+  , m_convertPos(0)
+  , m_convertCount(0)
 {
   Open(Params(dir, device, PString::Empty(), numChannels, sampleRate, bitsPerSample));
 }
@@ -302,11 +314,30 @@ PBoolean PSoundChannel::Open(const PString & devSpec,
 }
 
 
+static const unsigned DeviceSampleRates[] = { 48000, 44100, 32000, 16000, 8000 };
+
 bool PSoundChannel::Open(const Params & params)
 {
   channelPointerMutex.StartWrite();
   m_activeDirection = params.m_direction;
+  m_convertRate = 0;
   PIndirectChannel::Open(CreateOpenedChannel(params));
+
+  /* Almost every device does 48kHz, so if the rate was the problem, that
+     will work and we convert. Other rates are tried by SetFormat(). */
+  if (readChannel == NULL && m_autoConvert && params.m_bitsPerSample == 16 && params.m_sampleRate != DeviceSampleRates[0]) {
+    Params adjustedParams = params;
+    adjustedParams.m_sampleRate = DeviceSampleRates[0];
+    adjustedParams.m_bufferSize = (unsigned)(((PUInt64)params.m_bufferSize*DeviceSampleRates[0]/params.m_sampleRate + 1) & ~1);
+    if (StartConversion(params.m_channels, params.m_sampleRate, DeviceSampleRates[0])) {
+      PSoundChannel * channel = CreateOpenedChannel(adjustedParams);
+      if (channel != NULL)
+        PIndirectChannel::Open(channel);
+      else
+        m_convertRate = 0;
+    }
+  }
+
   channelPointerMutex.EndWrite();
 
   return readChannel != NULL;
@@ -322,8 +353,41 @@ PBoolean PSoundChannel::Abort()
 
 PBoolean PSoundChannel::SetFormat(unsigned numChannels, unsigned sampleRate, unsigned bitsPerSample)
 {
-  PReadWaitAndSignal mutex(channelPointerMutex);
-  return readChannel != NULL && GetSoundChannel()->SetFormat(numChannels, sampleRate, bitsPerSample);
+  PWriteWaitAndSignal mutex(channelPointerMutex);
+  if (readChannel == NULL)
+    return false;
+
+  m_convertRate = 0;
+  if (GetSoundChannel()->SetFormat(numChannels, sampleRate, bitsPerSample))
+    return true;
+
+  if (!m_autoConvert || bitsPerSample != 16)
+    return false;
+
+  for (PINDEX i = 0; i < PARRAYSIZE(DeviceSampleRates); ++i) {
+    if (DeviceSampleRates[i] != sampleRate &&
+        GetSoundChannel()->SetFormat(numChannels, DeviceSampleRates[i], bitsPerSample))
+      return StartConversion(numChannels, sampleRate, DeviceSampleRates[i]);
+  }
+
+  return false;
+}
+
+
+bool PSoundChannel::StartConversion(unsigned numChannels, unsigned sampleRate, unsigned deviceRate)
+{
+  bool ok = m_activeDirection == Recorder ? m_resampler.SetRates(deviceRate, sampleRate, numChannels)
+                                          : m_resampler.SetRates(sampleRate, deviceRate, numChannels);
+  if (!ok) {
+    PTRACE(2, "Cannot convert " << m_activeDirection << " sample rate " << sampleRate << " to " << deviceRate);
+    return false;
+  }
+
+  m_resampler.Reset();
+  m_convertRate = sampleRate;
+  m_convertPos = m_convertCount = 0;
+  PTRACE(3, m_activeDirection << " device does not support " << sampleRate << "Hz, converting from " << deviceRate << "Hz");
+  return true;
 }
 
 
@@ -335,6 +399,15 @@ unsigned PSoundChannel::GetChannels() const
 
 
 unsigned PSoundChannel::GetSampleRate() const
+{
+  PReadWaitAndSignal mutex(channelPointerMutex);
+  if (readChannel == NULL)
+    return 0;
+  return m_convertRate != 0 ? m_convertRate : GetSoundChannel()->GetSampleRate();
+}
+
+
+unsigned PSoundChannel::GetDeviceSampleRate() const
 {
   PReadWaitAndSignal mutex(channelPointerMutex);
   return readChannel == NULL ? 0 : GetSoundChannel()->GetSampleRate();
@@ -351,7 +424,14 @@ unsigned PSoundChannel::GetSampleSize() const
 PBoolean PSoundChannel::SetBuffers(PINDEX size, PINDEX count)
 {
   PReadWaitAndSignal mutex(channelPointerMutex);
-  return readChannel != NULL && GetSoundChannel()->SetBuffers(size, count);
+  if (readChannel == NULL)
+    return false;
+
+  // Keep the same duration per buffer at the device rate
+  if (m_convertRate != 0)
+    size = (PINDEX)(((PUInt64)size*GetSoundChannel()->GetSampleRate()/m_convertRate + 1) & ~1);
+
+  return GetSoundChannel()->SetBuffers(size, count);
 }
 
 
@@ -362,6 +442,69 @@ PBoolean PSoundChannel::GetBuffers(PINDEX & size, PINDEX & count)
 }
 
 
+PBoolean PSoundChannel::Read(void * buf, PINDEX len)
+{
+  if (m_convertRate == 0)
+    return PIndirectChannel::Read(buf, len);
+
+  short * dst = (short *)buf;
+  PINDEX dstCount = len/sizeof(short);
+  PINDEX produced = 0;
+  PINDEX channels = (PINDEX)m_resampler.GetChannels();
+  while (dstCount - produced >= channels) {
+    if (m_convertCount - m_convertPos < channels) {
+      /* Read what the device needs for the remainder, with a little extra to
+         cover the filter. A partial frame left from the last read is kept in
+         front, as the resampler only takes whole frames. */
+      PINDEX partial = m_convertCount - m_convertPos;
+      PINDEX frames = (PINDEX)((PUInt64)(dstCount - produced)/channels*m_resampler.GetSrcRate()/m_convertRate + 1);
+      PINDEX count = frames*channels;
+      if (!m_convertBuffer.SetMinSize(partial + count))
+        return false;
+      short * src = m_convertBuffer.GetPointer();
+      memmove(src, src + m_convertPos, partial*sizeof(short));
+      m_convertPos = 0;
+      m_convertCount = partial;
+      if (!PIndirectChannel::Read(src + partial, count*sizeof(short)))
+        return false;
+      PINDEX got = GetLastReadCount()/sizeof(short);
+      if (got == 0)
+        break;
+      m_convertCount += got;
+      continue;
+    }
+
+    PINDEX srcCount = m_convertCount - m_convertPos;
+    PINDEX output = m_resampler.Process(&m_convertBuffer[m_convertPos], srcCount, dst + produced, dstCount - produced);
+    if (output == 0 && srcCount == 0)
+      break;
+    produced += output;
+    m_convertPos += srcCount;
+  }
+
+  SetLastReadCount(produced*sizeof(short));
+  return produced > 0;
+}
+
+
+PBoolean PSoundChannel::Write(const void * buf, PINDEX len)
+{
+  if (m_convertRate == 0)
+    return PIndirectChannel::Write(buf, len);
+
+  PINDEX srcCount = len/sizeof(short);
+  if (!m_convertBuffer.SetMinSize(m_resampler.GetMaxOutput(srcCount)))
+    return false;
+
+  PINDEX count = m_resampler.Process((const short *)buf, srcCount, m_convertBuffer.GetPointer(), m_convertBuffer.GetSize());
+  if (count > 0 && !PIndirectChannel::Write(m_convertBuffer.GetPointer(), count*sizeof(short)))
+    return false;
+
+  SetLastWriteCount(len);
+  return true;
+}
+
+
 PBoolean PSoundChannel::SetVolume(unsigned volume)
 {
   PReadWaitAndSignal mutex(channelPointerMutex);
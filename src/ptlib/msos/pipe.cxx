@@ -334,6 +334,61 @@ PBoolean PPipeChannel::ReadStandardError(PString & errors, PBoolean wait)
 }
 
 
+PChannel::Errors PPipeChannel::Select(SelectList & output, const PTimeInterval & timeout)
+{
+  SelectList errors;
+  return Select(output, errors, timeout);
+}
+
+
+PChannel::Errors PPipeChannel::Select(SelectList & output, SelectList & errors, const PTimeInterval & timeout)
+{
+  SelectList * list[2] = { &output, &errors };
+
+  for (PINDEX i = 0; i < 2; ++i) {
+    for (SelectList::iterator it = list[i]->begin(); it != list[i]->end(); ++it) {
+      if (!(i == 0 ? it->m_hFromChild : it->m_hStandardError).IsValid())
+        return NotOpen;
+    }
+  }
+
+  if (output.IsEmpty() && errors.IsEmpty())
+    return NotOpen;
+
+  // Anonymous pipes cannot be waited on, so poll them
+  PSimpleTimer timer(timeout);
+  for (;;) {
+    bool any = false;
+    for (PINDEX i = 0; i < 2; ++i) {
+      for (SelectList::iterator it = list[i]->begin(); it != list[i]->end(); ++it) {
+        DWORD available = 0;
+        // Failure is a broken pipe, i.e. end of file, which the next Read() will report
+        if (!PeekNamedPipe(i == 0 ? it->m_hFromChild : it->m_hStandardError, NULL, 0, NULL, &available, NULL) || available > 0)
+          any = true;
+      }
+    }
+
+    if (any || timer.HasExpired())
+      break;
+
+    PThread::Sleep(10);
+  }
+
+  for (PINDEX i = 0; i < 2; ++i) {
+    SelectList::iterator it = list[i]->begin();
+    while (it != list[i]->end()) {
+      DWORD available = 0;
+      if (!PeekNamedPipe(i == 0 ? it->m_hFromChild : it->m_hStandardError, NULL, 0, NULL, &available, NULL) || available > 0)
+        ++it;
+      else
+        list[i]->erase(it++);
+    }
+  }
+
+  return NoError;
+}
+
+
 int PPipeChannel::Run(const PString & command, PString & output, bool includeStderr, const PTimeInterval & timeout)
 {
     PPipeChannel pipe;
@@ -593,6 +593,18 @@ bool PChannel::WriteAsync(AsyncContext & context)
 }
 
 
+bool PChannel::SetAsyncEngine(AsyncEngines engine)
+{
+  return engine != AsyncEngineIOURing;
+}
+
+
+PChannel::AsyncEngines PChannel::GetAsyncEngine()
+{
+  return AsyncEngineAIO;
+}
+
+
 PString PChannel::GetErrorText(Errors lastError, int osError)
 {
   if (osError == 0) {
@@ -31,6 +31,7 @@
 #pragma implementation "indchan.h"
 
 #include <ptlib.h>
+#include <ptlib/pprocess.h>
 #include <sys/ioctl.h>
 
 #if defined(P_SOLARIS)
@@ -220,6 +221,590 @@ PBoolean PChannel::Write(const void * buf, PINDEX len)
 
 #if defined _AIO_H
 
+static atomic<PChannel::AsyncEngines> s_asyncEngine(PChannel::AsyncEngineDefault);
+
+
+#if P_HAS_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <poll.h>
+
+/* Asynchronous I/O using io_uring. There is a ring for each of a small pool
+   of completion threads, a channel always uses the same one so its
+   completions are in the order they were started. Operations started from
+   within a completion callback, e.g. the next read, are batched and given
+   to the kernel by the same system call that waits for more completions.
+
+   Sockets and pipes are left in non-blocking mode, which the synchronous
+   functions rely on, and a poll is linked in front of the read or write so
+   it does not fail with EAGAIN.
+
+   The requests in flight for each fd are tracked, so closing a channel can
+   cancel them and wait for their completions, otherwise a completion could
+   arrive for a deleted channel, or for a new one that got the same fd.
+ */
+class PIOURing
+{
+  public:
+    PIOURing();
+    ~PIOURing();
+
+    bool Open(unsigned entries);
+    bool Submit(PChannel::AsyncContext & context, bool write, bool poll);
+    void CancelAndWait(int fd);
+
+  protected:
+    bool HasSpace(unsigned count);
+    struct io_uring_sqe & NextSQE();
+    bool Enter(unsigned toSubmit);
+    bool ProbeCancelByFd();
+    void SubmitCancel(int fd, __u64 userData);
+    void ThreadMain();
+    bool WaitForCompletions();
+    void OnComplete(PChannel::AsyncContext & context, int result);
+
+    enum { IgnoreUserData, StopUserData };
+    enum { PollUserDataFlag = 1 }; // Added to the context address for the linked poll
+
+    int                   m_fd;
+    char                * m_ring;
+    size_t                m_ringSize;
+    struct io_uring_sqe * m_sqes;
+    size_t                m_sqesSize;
+    unsigned            * m_sqHead;
+    unsigned            * m_sqTail;
+    unsigned              m_sqMask;
+    unsigned              m_sqEntries;
+    unsigned            * m_sqArray;
+    unsigned            * m_cqHead;
+    unsigned            * m_cqTail;
+    unsigned              m_cqMask;
+    struct io_uring_cqe * m_cqes;
+    bool                  m_cancelByFd; // Kernel 5.19 or later
+
+    PDECLARE_MUTEX(m_mutex);
+    unsigned          m_nextTail;
+    unsigned          m_pending;  // In the ring, but not yet given to the kernel
+    PThread         * m_thread;
+    PThreadIdentifier m_threadId;
+    bool              m_stopped;
+
+    struct InFlight
+    {
+      InFlight() : m_running(0), m_closing(false), m_drained(NULL) { }
+
+      std::set<PChannel::AsyncContext *> m_contexts; // Submitted, completion not yet delivered
+      unsigned                           m_running;  // Completion callbacks executing
+      bool                               m_closing;
+      PSyncPoint                       * m_drained;  // Signalled when nothing is in flight
+    };
+    typedef std::map<int, InFlight> InFlightMap;
+    InFlightMap m_inFlight;
+};
+
+
+PIOURing::PIOURing()
+  : m_fd(-1)
+  , m_ring(NULL)
+  , m_ringSize(0)
+  , m_sqes(NULL)
+  , m_sqesSize(0)
+  , m_sqHead(NULL)
+  , m_sqTail(NULL)
+  , m_sqMask(0)
+  , m_sqEntries(0)
+  , m_sqArray(NULL)
+  , m_cqHead(NULL)
+  , m_cqTail(NULL)
+  , m_cqMask(0)
+  , m_cqes(NULL)
+  , m_cancelByFd(false)
+  , m_nextTail(0)
+  , m_pending(0)
+  , m_thread(NULL)
+  , m_threadId(PNullThreadIdentifier)
+  , m_stopped(false)
+{
+}
+
+
+PIOURing::~PIOURing()
+{
+  if (m_thread != NULL) {
+    {
+      PWaitAndSignal lock(m_mutex);
+      if (HasSpace(1)) {
+        struct io_uring_sqe & sqe = NextSQE();
+        sqe.opcode = IORING_OP_NOP;
+        sqe.user_data = StopUserData;
+        Enter(m_pending);
+      }
+    }
+    PThread::WaitAndDelete(m_thread);
+  }
+
+  if (m_sqes != NULL)
+    munmap(m_sqes, m_sqesSize);
+  if (m_ring != NULL)
+    munmap(m_ring, m_ringSize);
+  if (m_fd >= 0)
+    ::close(m_fd);
+}
+
+
+bool PIOURing::Open(unsigned entries)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  m_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (m_fd < 0) {
+    PTRACE(3, "AsyncIO", "io_uring not available: " << strerror(errno));
+    return false;
+  }
+
+  // Poll linking needs FAST_POLL, which is also after READ/WRITE were added
+  static const unsigned RequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+  if ((params.features & RequiredFeatures) != RequiredFeatures) {
+    PTRACE(3, "AsyncIO", "io_uring too old, features=0x" << hex << params.features << dec);
+    return false;
+  }
+
+  m_ringSize = std::max(params.sq_off.array + params.sq_entries*sizeof(unsigned),
+                        params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe));
+  void * ring = mmap(NULL, m_ringSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (ring == MAP_FAILED) {
+    PTRACE(2, "AsyncIO", "io_uring ring mmap failed: " << strerror(errno));
+    return false;
+  }
+  m_ring = (char *)ring;
+
+  m_sqesSize = params.sq_entries*sizeof(struct io_uring_sqe);
+  void * sqes = mmap(NULL, m_sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    PTRACE(2, "AsyncIO", "io_uring SQE mmap failed: " << strerror(errno));
+    return false;
+  }
+  m_sqes = (struct io_uring_sqe *)sqes;
+
+  m_sqHead    = (unsigned *)(m_ring + params.sq_off.head);
+  m_sqTail    = (unsigned *)(m_ring + params.sq_off.tail);
+  m_sqMask    = *(unsigned *)(m_ring + params.sq_off.ring_mask);
+  m_sqEntries = params.sq_entries;
+  m_sqArray   = (unsigned *)(m_ring + params.sq_off.array);
+  m_cqHead    = (unsigned *)(m_ring + params.cq_off.head);
+  m_cqTail    = (unsigned *)(m_ring + params.cq_off.tail);
+  m_cqMask    = *(unsigned *)(m_ring + params.cq_off.ring_mask);
+  m_cqes      = (struct io_uring_cqe *)(m_ring + params.cq_off.cqes);
+  m_nextTail  = *m_sqTail;
+
+  m_cancelByFd = ProbeCancelByFd();
+
+  m_thread = new PThreadObj<PIOURing>(*this, &PIOURing::ThreadMain, false, "io_uring", PThread::HighPriority);
+  PTRACE(4, "AsyncIO", "io_uring opened: fd=" << m_fd << ", entries=" << m_sqEntries
+         << ", cancel " << (m_cancelByFd ? "by fd" : "each request"));
+  return true;
+}
+
+
+bool PIOURing::ProbeCancelByFd()
+{
+  /* Kernels before 5.19 reject any cancel flags with EINVAL, later ones
+     report that nothing matched, as nothing is using the ring's own fd. This
+     is done before the completion thread starts, so we reap it ourselves. */
+  struct io_uring_sqe & sqe = NextSQE();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = m_fd;
+  sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  sqe.user_data = IgnoreUserData;
+  __atomic_store_n(m_sqTail, m_nextTail, __ATOMIC_RELEASE);
+  m_pending = 0;
+
+  if (syscall(__NR_io_uring_enter, m_fd, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+    PTRACE(2, "AsyncIO", "io_uring cancel probe failed: " << strerror(errno));
+    return false;
+  }
+
+  unsigned head = *m_cqHead;
+  if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    return false;
+
+  int result = m_cqes[head & m_cqMask].res;
+  __atomic_store_n(m_cqHead, head+1, __ATOMIC_RELEASE);
+  return result != -EINVAL;
+}
+
+
+bool PIOURing::HasSpace(unsigned count)
+{
+  if (m_nextTail + count - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) <= m_sqEntries)
+    return true;
+
+  // Full, the kernel takes what is waiting, and if it cannot, we give up
+  Enter(m_pending);
+  return m_nextTail + count - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) <= m_sqEntries;
+}
+
+
+struct io_uring_sqe & PIOURing::NextSQE()
+{
+  unsigned index = m_nextTail++ & m_sqMask;
+  m_sqArray[index] = index;
+  ++m_pending;
+
+  struct io_uring_sqe & sqe = m_sqes[index];
+  memset(&sqe, 0, sizeof(sqe));
+  return sqe;
+}
+
+
+bool PIOURing::Enter(unsigned toSubmit)
+{
+  // Make the entries visible to the kernel, m_mutex must be held
+  __atomic_store_n(m_sqTail, m_nextTail, __ATOMIC_RELEASE);
+  if (toSubmit == 0)
+    return true;
+
+  int result = (int)syscall(__NR_io_uring_enter, m_fd, toSubmit, 0, 0, NULL, 0);
+  if (result < 0) {
+    PTRACE(2, "AsyncIO", "io_uring submit failed: " << strerror(errno));
+    return false;
+  }
+
+  m_pending -= std::min((unsigned)result, m_pending);
+  return true;
+}
+
+
+bool PIOURing::Submit(PChannel::AsyncContext & context, bool write, bool poll)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  InFlight & inFlight = m_inFlight[context.aio_fildes];
+  if (inFlight.m_closing) {
+    errno = ECANCELED;
+    return false;
+  }
+
+  if (!HasSpace(poll ? 2 : 1)) {
+    if (inFlight.m_contexts.empty() && inFlight.m_running == 0)
+      m_inFlight.erase(context.aio_fildes);
+    errno = EAGAIN;
+    return false;
+  }
+
+  if (poll) {
+    struct io_uring_sqe & sqe = NextSQE();
+    sqe.opcode = IORING_OP_POLL_ADD;
+    sqe.fd = context.aio_fildes;
+    sqe.poll32_events = write ? POLLOUT : POLLIN;
+    sqe.flags = IOSQE_IO_LINK;
+    sqe.user_data = (uintptr_t)&context | PollUserDataFlag;
+  }
+
+  struct io_uring_sqe & sqe = NextSQE();
+  sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe.fd = context.aio_fildes;
+  sqe.addr = (uintptr_t)context.aio_buf;
+  sqe.len = (unsigned)context.aio_nbytes;
+  sqe.off = poll ? (__u64)-1 : (__u64)context.aio_offset;
+  sqe.user_data = (uintptr_t)&context;
+
+  inFlight.m_contexts.insert(&context);
+
+  // The completion thread submits these on its next wait
+  if (PThread::GetCurrentThreadId() == m_threadId) {
+    __atomic_store_n(m_sqTail, m_nextTail, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  return Enter(m_pending);
+}
+
+
+void PIOURing::SubmitCancel(int fd, __u64 userData)
+{
+  // m_mutex must be held
+  if (!HasSpace(1)) {
+    PTRACE(2, "AsyncIO", "io_uring full, cannot cancel I/O on fd=" << fd);
+    return;
+  }
+
+  struct io_uring_sqe & sqe = NextSQE();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.user_data = IgnoreUserData;
+  if (m_cancelByFd) {
+    sqe.fd = fd;
+    sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  }
+  else {
+    sqe.fd = -1;
+    sqe.addr = userData;
+  }
+}
+
+
+void PIOURing::CancelAndWait(int fd)
+{
+  bool onCompletionThread = PThread::GetCurrentThreadId() == m_threadId;
+  PSyncPoint drained;
+
+  {
+    PWaitAndSignal lock(m_mutex);
+
+    InFlightMap::iterator it = m_inFlight.find(fd);
+    if (it == m_inFlight.end())
+      return; // Nothing ever submitted, or all of it completed
+
+    InFlight & inFlight = it->second;
+    inFlight.m_closing = true;
+    if (!onCompletionThread)
+      inFlight.m_drained = &drained;
+
+    if (m_cancelByFd) {
+      if (!inFlight.m_contexts.empty())
+        SubmitCancel(fd, 0);
+    }
+    else {
+      /* The read or write is not found while it waits behind its poll, so
+         cancel the poll too, which then cancels the linked request. */
+      for (std::set<PChannel::AsyncContext *>::iterator ctx = inFlight.m_contexts.begin(); ctx != inFlight.m_contexts.end(); ++ctx) {
+        SubmitCancel(fd, (uintptr_t)*ctx | PollUserDataFlag);
+        SubmitCancel(fd, (uintptr_t)*ctx);
+      }
+    }
+
+    // Always immediately, as the fd is about to be closed
+    Enter(m_pending);
+  }
+
+  for (;;) {
+    {
+      PWaitAndSignal lock(m_mutex);
+      InFlight & inFlight = m_inFlight[fd];
+      /* On the completion thread, any callback still running for this fd is
+         the one closing the channel, further up our own stack. */
+      if (inFlight.m_contexts.empty() && (onCompletionThread || inFlight.m_running == 0)) {
+        m_inFlight.erase(fd);
+        return;
+      }
+    }
+
+    if (!onCompletionThread)
+      drained.Wait();
+    else if (!WaitForCompletions()) {
+      PTRACE(2, "AsyncIO", "io_uring stopped while closing fd=" << fd);
+      return;
+    }
+  }
+}
+
+
+void PIOURing::ThreadMain()
+{
+  m_threadId = PThread::GetCurrentThreadId();
+
+  while (!m_stopped && WaitForCompletions())
+    ;
+}
+
+
+bool PIOURing::WaitForCompletions()
+{
+  unsigned toSubmit;
+  {
+    PWaitAndSignal lock(m_mutex);
+    toSubmit = m_pending;
+    m_pending = 0;
+  }
+
+  int result = (int)syscall(__NR_io_uring_enter, m_fd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+  if (result < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      PTRACE(1, "AsyncIO", "io_uring wait failed: " << strerror(errno));
+      return false;
+    }
+    result = 0;
+  }
+  if ((unsigned)result < toSubmit) {
+    PWaitAndSignal lock(m_mutex);
+    m_pending += toSubmit - result;
+  }
+
+  /* The head is read again for every entry, as a completion callback that
+     closes a channel can reap further entries from within CancelAndWait(). */
+  for (;;) {
+    unsigned head = *m_cqHead;
+    if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+      return true;
+
+    struct io_uring_cqe cqe = m_cqes[head & m_cqMask];
+    __atomic_store_n(m_cqHead, head+1, __ATOMIC_RELEASE);
+
+    if (cqe.user_data == StopUserData) {
+      m_stopped = true;
+      return false;
+    }
+    if (cqe.user_data != IgnoreUserData && (cqe.user_data & PollUserDataFlag) == 0)
+      OnComplete(*(PChannel::AsyncContext *)(uintptr_t)cqe.user_data, cqe.res);
+  }
+}
+
+
+void PIOURing::OnComplete(PChannel::AsyncContext & context, int result)
+{
+  bool write = context.m_onComplete == &PChannel::OnWriteComplete;
+  int fd = context.aio_fildes;
+
+  // Poll said ready, but someone else got the data first, so wait again
+  if (result == -EAGAIN) {
+    if (Submit(context, write, true))
+      return;
+    result = -errno;
+  }
+
+  {
+    PWaitAndSignal lock(m_mutex);
+    InFlight & inFlight = m_inFlight[fd];
+    inFlight.m_contexts.erase(&context);
+    ++inFlight.m_running;
+  }
+
+  // OnIOComplete() converts the error from errno
+  if (result >= 0) {
+    errno = 0;
+    context.OnIOComplete(result, 0);
+  }
+  else {
+    errno = -result;
+    context.OnIOComplete(-1, -result);
+  }
+
+  // The context may be gone now, only the fd is used
+  PWaitAndSignal lock(m_mutex);
+  InFlightMap::iterator it = m_inFlight.find(fd);
+  if (it != m_inFlight.end() && --it->second.m_running == 0 && it->second.m_contexts.empty()) {
+    if (it->second.m_drained != NULL)
+      it->second.m_drained->Signal();
+    else if (!it->second.m_closing)
+      m_inFlight.erase(it);
+  }
+}
+
+
+class PIOURingEngine : public PProcessStartup
+{
+    PCLASSINFO(PIOURingEngine, PProcessStartup)
+  public:
+    PIOURingEngine()
+      : m_state(Untried)
+    {
+      s_instance = this;
+    }
+
+    virtual void OnStartup()
+    {
+      const char * env = getenv("PTLIB_ASYNC_ENGINE");
+      if (env != NULL) {
+        if (strcasecmp(env, "aio") == 0)
+          s_asyncEngine = PChannel::AsyncEngineAIO;
+        else if (strcasecmp(env, "io_uring") == 0)
+          s_asyncEngine = PChannel::AsyncEngineIOURing;
+      }
+    }
+
+    virtual void OnShutdown()
+    {
+      // Not deleted under the lock, a completion callback may be closing a channel
+      std::vector<PIOURing *> rings;
+      {
+        PWaitAndSignal lock(m_mutex);
+        m_state = Failed;
+        rings.swap(m_rings);
+      }
+      for (size_t i = 0; i < rings.size(); ++i)
+        delete rings[i];
+    }
+
+    static bool IsAvailable()
+    {
+      return s_instance != NULL && s_instance->Open();
+    }
+
+    static PIOURing * GetRing(int fd)
+    {
+      if (s_asyncEngine == PChannel::AsyncEngineAIO || !IsAvailable())
+        return NULL;
+
+      // Shut down after the check above, use POSIX AIO instead
+      PWaitAndSignal lock(s_instance->m_mutex);
+      if (s_instance->m_rings.empty())
+        return NULL;
+      return s_instance->m_rings[fd % s_instance->m_rings.size()];
+    }
+
+    static void CancelAndWait(int fd)
+    {
+      // Only if async I/O has ever been done with io_uring
+      if (s_instance == NULL || s_instance->m_state != Opened)
+        return;
+
+      // Not waited for under the lock, other channels may be closing too
+      PIOURing * ring;
+      {
+        PWaitAndSignal lock(s_instance->m_mutex);
+        if (s_instance->m_rings.empty())
+          return;
+        ring = s_instance->m_rings[fd % s_instance->m_rings.size()];
+      }
+      ring->CancelAndWait(fd);
+    }
+
+  protected:
+    bool Open()
+    {
+      if (m_state != Untried)
+        return m_state == Opened;
+
+      PWaitAndSignal lock(m_mutex);
+      if (m_state != Untried)
+        return m_state == Opened;
+
+      unsigned count = std::min(4U, std::max(1U, PThread::GetNumProcessors()));
+      for (unsigned i = 0; i < count; ++i) {
+        PIOURing * ring = new PIOURing;
+        m_rings.push_back(ring);
+        if (!ring->Open(256)) {
+          for (size_t r = 0; r < m_rings.size(); ++r)
+            delete m_rings[r];
+          m_rings.clear();
+          PTRACE(3, "AsyncIO", "Using POSIX AIO");
+          m_state = Failed;
+          return false;
+        }
+      }
+
+      PTRACE(3, "AsyncIO", "Using io_uring with " << count << " completion threads");
+      m_state = Opened;
+      return true;
+    }
+
+    enum States { Untried, Opened, Failed };
+    atomic<States>          m_state;
+    PDECLARE_MUTEX(         m_mutex);
+    std::vector<PIOURing *> m_rings;
+
+    static PIOURingEngine * s_instance;
+};
+
+PIOURingEngine * PIOURingEngine::s_instance;
+
+PFACTORY_CREATE_SINGLETON(PProcessStartupFactory, PIOURingEngine);
+
+#endif // P_HAS_IO_URING
+
+
 static void StaticOnIOComplete(union sigval sig)
 {
   PChannel::AsyncContext * context = (PChannel::AsyncContext *)sig.sival_ptr;
@@ -247,29 +832,81 @@ bool PChannel::AsyncContext::Initialise(PChannel * channel, CompletionFunction o
   aio_sigevent.sigev_notify = SIGEV_THREAD;
   aio_sigevent.sigev_notify_function = StaticOnIOComplete;
   aio_sigevent.sigev_value.sival_ptr = this;
+  return true;
+}
+
+
+static bool StartAsync(PChannel & channel, PChannel::AsyncContext & context, bool write)
+{
+#if P_HAS_IO_URING
+  PIOURing * ring = PIOURingEngine::GetRing(context.aio_fildes);
+  if (ring != NULL)
+    return ring->Submit(context, write, dynamic_cast<PFile *>(&channel) == NULL);
+#endif
 
   // If doing async, need to be blocking mode, seems but there it is
   int cmd = 0;
-  ::ioctl(aio_fildes, FIONBIO, &cmd);
-  return true;
+  ::ioctl(context.aio_fildes, FIONBIO, &cmd);
+  return (write ? aio_write(&context) : aio_read(&context)) == 0;
 }
 
 
 PBoolean PChannel::ReadAsync(AsyncContext & context)
 {
   PTRACE(6, "Async\tStarting ReadAsync");
-  return PAssert(context.Initialise(this, &PChannel::OnReadComplete),
-                 "Multiple async read with same context!") &&
-         ConvertOSError(aio_read(&context), LastReadError);
+  if (CheckNotOpen())
+    return false;
+
+  if (!PAssert(context.Initialise(this, &PChannel::OnReadComplete), "Multiple async read with same context!"))
+    return false;
+
+  if (StartAsync(*this, context, false))
+    return ConvertOSError(0, LastReadError);
+
+  context.m_channel = NULL;
+  return ConvertOSError(-1, LastReadError);
 }
 
 
 PBoolean PChannel::WriteAsync(AsyncContext & context)
 {
   PTRACE(6, "Async\tStarting WriteAsync");
-  return PAssert(context.Initialise(this, &PChannel::OnWriteComplete),
-                 "Multiple async write with same context!") &&
-         ConvertOSError(aio_write(&context), LastWriteError);
+  if (CheckNotOpen())
+    return false;
+
+  if (!PAssert(context.Initialise(this, &PChannel::OnWriteComplete), "Multiple async write with same context!"))
+    return false;
+
+  if (StartAsync(*this, context, true))
+    return ConvertOSError(0, LastWriteError);
+
+  context.m_channel = NULL;
+  return ConvertOSError(-1, LastWriteError);
+}
+
+
+bool PChannel::SetAsyncEngine(AsyncEngines engine)
+{
+#if P_HAS_IO_URING
+  if (engine == AsyncEngineIOURing && !PIOURingEngine::IsAvailable())
+    return false;
+#else
+  if (engine == AsyncEngineIOURing)
+    return false;
+#endif
+
+  s_asyncEngine = engine;
+  return true;
+}
+
+
+PChannel::AsyncEngines PChannel::GetAsyncEngine()
+{
+#if P_HAS_IO_URING
+  if (s_asyncEngine != AsyncEngineAIO && PIOURingEngine::IsAvailable())
+    return AsyncEngineIOURing;
+#endif
+  return AsyncEngineAIO;
 }
 
 
@@ -298,6 +935,18 @@ PBoolean PChannel::WriteAsync(AsyncContext & context)
   return false;
 }
 
+
+bool PChannel::SetAsyncEngine(AsyncEngines engine)
+{
+  return engine == AsyncEngineDefault;
+}
+
+
+PChannel::AsyncEngines PChannel::GetAsyncEngine()
+{
+  return AsyncEngineDefault;
+}
+
 #endif // _AIO_H
 
 
@@ -342,6 +991,11 @@ int PChannel::PXClose()
   for (PINDEX i = 0; i < 3; ++i)
     AbortIO(px_selectThread[i], px_threadMutex);
 
+#if defined(_AIO_H) && P_HAS_IO_URING
+  // Outstanding ReadAsync()/WriteAsync() complete, often with ECANCELED, before the fd goes
+  PIOURingEngine::CancelAndWait(handle);
+#endif
+
   int stat;
   do {
     stat = ::close(handle);
@@ -33,6 +33,7 @@
 
 #include <ptlib.h>
 #include <ptlib/pprocess.h>
+#include <ptlib/dirwatch.h>
 
 #include "../common/pconfig.cxx"
 
@@ -67,12 +68,49 @@ class PConfig::Cached : public PDictionary<PCaselessString, PStringOptions>
     ~Cached();
 
     void SetDirty();
+    void Reload();
 
   protected:
+    void Load();
     void Flush();
     PDECLARE_NOTIFIER(PTimer, Cached, FlushTimeout);
 
+    // The file as last read or written, so our own writes are not reloaded
+    struct FileState
+    {
+      FileState() : m_exists(false), m_inode(0), m_size(0), m_modified(0), m_modifiedNano(0) { }
+
+      void Read(const PFilePath & path)
+      {
+        struct stat s;
+        if (::stat(path, &s) != 0) {
+          *this = FileState();
+          return;
+        }
+        m_exists = true;
+        m_inode = s.st_ino;
+        m_size = s.st_size;
+        m_modified = s.st_mtime;
+#if defined(P_LINUX)
+        m_modifiedNano = s.st_mtim.tv_nsec;
+#endif
+      }
+
+      bool operator==(const FileState & other) const
+      {
+        return m_exists == other.m_exists && m_inode == other.m_inode && m_size == other.m_size &&
+               m_modified == other.m_modified && m_modifiedNano == other.m_modifiedNano;
+      }
+
+      bool   m_exists;
+      ino_t  m_inode;
+      off_t  m_size;
+      time_t m_modified;
+      long   m_modifiedNano;
+    };
+
     PFilePath      m_filePath;
+    FileState      m_fileState;
     atomic<uint32_t> m_instanceCount;
     PDECLARE_MUTEX(m_mutex);
     atomic<bool>   m_dirty;
@@ -105,15 +143,22 @@ class PConfigCache : public PProcessStartup
     PConfig::Cached * GetEnvironmentCache();
     PConfig::Cached * GetFileCache(const PFilePath & filename);
     void Detach(PConfig::Cached * cache);
+    void Watch(const PDirectory & dir);
 
     PFACTORY_GET_SINGLETON(PProcessStartupFactory, PConfigCache);
 
   protected:
+    PDECLARE_DirectoryWatcherNotifier(PConfigCache, OnFileChanged);
+
     PDECLARE_MUTEX(m_mutex);
     PConfig::Cached  * m_environmentCache;
 
     typedef PDictionary<PFilePath, PConfig::Cached> CacheDict;
     CacheDict m_cache;
+
+    // So external edits to the files are seen
+    PDirectoryWatcher m_watcher;
+    atomic<bool>      m_watching;
 };
 
 PFACTORY_CREATE_SINGLETON(PProcessStartupFactory, PConfigCache);
@@ -135,6 +180,13 @@ PConfig::Cached::Cached(const PFilePath & path)
 
   m_flushTimer.SetNotifier(PCREATE_NOTIFIER(FlushTimeout));
 
+  Load();
+  m_fileState.Read(m_filePath);
+}
+
+
+void PConfig::Cached::Load()
+{
   // attempt to open file
   PTextFile file;
   if (!file.Open(m_filePath, PFile::ReadOnly))
@@ -192,6 +244,48 @@ void PConfig::Cached::SetDirty()
 }
 
 
+void PConfig::Cached::Reload()
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (m_dirty) {
+    PTRACE(2, "Config file " << m_filePath << " changed externally, keeping unsaved changes");
+    return;
+  }
+
+  FileState before;
+  before.Read(m_filePath);
+  if (before == m_fileState) {
+    PTRACE(4, "Config file " << m_filePath << " not changed, e.g. our own flush");
+    return;
+  }
+
+  // Replaced by rename, or being written, there is another event to come
+  if (!before.m_exists) {
+    PTRACE(3, "Config file " << m_filePath << " gone, keeping current values");
+    return;
+  }
+
+  /* Events are coalesced, so the writer may not have finished. If the file
+     changed while we were reading it, read it again a little later. */
+  for (unsigned attempt = 1; ; ++attempt) {
+    RemoveAll();
+    Load();
+
+    FileState after;
+    after.Read(m_filePath);
+    if (after == before || attempt >= 3) {
+      m_fileState = after;
+      return;
+    }
+
+    PTRACE(3, "Config file " << m_filePath << " changed while reading, reading again");
+    before = after;
+    PThread::Sleep(100);
+  }
+}
+
+
 void PConfig::Cached::FlushTimeout(PTimer&, INT)
 {
   Flush();
@@ -200,18 +294,22 @@ void PConfig::Cached::FlushTimeout(PTimer&, INT)
 
 void PConfig::Cached::Flush()
 {
+  // Lock first, so Reload() cannot happen between clearing the flag and writing
+  PWaitAndSignal lock(m_mutex);
+
   if (!m_dirty.exchange(false)) {
     PTRACE(4, "No flush required for config file: " << m_filePath);
     return;
   }
 
-  PWaitAndSignal lock(m_mutex);
-
   // make sure the directory that the file is to be written into exists
   PDirectory dir = m_filePath.GetDirectory();
-  if (!dir.Exists() && !dir.Create(PFileInfo::UserExecute|PFileInfo::UserWrite|PFileInfo::UserRead, true)) {
-    PTRACE(1, "Could not create directory: " << dir);
-    return;
+  if (!dir.Exists()) {
+    if (!dir.Create(PFileInfo::UserExecute|PFileInfo::UserWrite|PFileInfo::UserRead, true)) {
+      PTRACE(1, "Could not create directory: " << dir);
+      return;
+    }
+    PConfigCache::GetInstance().Watch(dir);
   }
 
   PTextFile file;
@@ -248,6 +346,7 @@ void PConfig::Cached::Flush()
     return;
   }
 
+  m_fileState.Read(m_filePath);
   PTRACE(3, "Flushed config file: " << m_filePath);
 }
 
@@ -275,6 +374,8 @@ PConfig::Cached::Cached(char **envp)
 
 PConfigCache::PConfigCache()
   : m_environmentCache(NULL)
+  , m_watcher(PCREATE_NOTIFIER2(OnFileChanged, const PDirectoryWatcher::Event &))
+  , m_watching(PDirectoryWatcher::IsNative())
 {
 }
 
@@ -287,10 +388,45 @@ PConfigCache::~PConfigCache()
 
 void PConfigCache::OnShutdown()
 {
+  m_watching = false;
+  m_watcher.Close();
   m_cache.RemoveAll(); // And flush them
 }
 
 
+void PConfigCache::Watch(const PDirectory & dir)
+{
+  if (m_watching && !m_watcher.IsWatched(dir) && !m_watcher.Add(dir)) {
+    PTRACE(3, "Could not watch " << dir << ", external changes to config files will not be seen");
+  }
+}
+
+
+void PConfigCache::OnFileChanged(PDirectoryWatcher &, const PDirectoryWatcher::Event & event)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (event.m_changes & PDirectoryWatcher::Overflow) {
+    // Could have missed anything in the directory
+    PDirectory dir = event.m_path;
+    for (CacheDict::iterator it = m_cache.begin(); it != m_cache.end(); ++it) {
+      if (it->first.GetDirectory() == dir)
+        it->second.Reload();
+    }
+    return;
+  }
+
+  if (!(event.m_changes & (PDirectoryWatcher::Created|PDirectoryWatcher::Modified)))
+    return;
+
+  PConfig::Cached * config = m_cache.GetAt(event.m_path);
+  if (config != NULL) {
+    PTRACE(3, "Config file " << event.m_path << " changed, reloading");
+    config->Reload();
+  }
+}
+
+
 PConfig::Cached * PConfigCache::GetEnvironmentCache()
 {
   m_mutex.Wait();
@@ -306,8 +442,11 @@ PConfig::Cached * PConfigCache::GetFileCache(const PFilePath & filename)
   m_mutex.Wait();
 
   PConfig::Cached * config = m_cache.GetAt(filename);
-  if (config == NULL)
+  if (config == NULL) {
     m_cache.SetAt(filename, config = new PConfig::Cached(filename));
+    if (PDirectory::Exists(filename.GetDirectory()))
+      Watch(filename.GetDirectory());
+  }
   ++config->m_instanceCount;
 
   m_mutex.Signal();
@@ -321,8 +460,18 @@ void PConfigCache::Detach(PConfig::Cached * config)
 
   if (config != m_environmentCache) {
     CacheDict::iterator it = m_cache.find(config->m_filePath);
-    if (it != m_cache.end() && --config->m_instanceCount == 0)
+    if (it != m_cache.end() && --config->m_instanceCount == 0) {
+      PDirectory dir = config->m_filePath.GetDirectory();
       m_cache.erase(it);
+
+      // Stop watching the directory if no other config files in it
+      for (it = m_cache.begin(); it != m_cache.end(); ++it) {
+        if (it->first.GetDirectory() == dir)
+          break;
+      }
+      if (it == m_cache.end())
+        m_watcher.Remove(dir);
+    }
   }
 
   m_mutex.Signal();
@@ -361,7 +510,7 @@ PConfig::~PConfig()
 PStringArray PConfig::GetSections() const
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringArray sections(m_config->GetSize());
 
@@ -376,7 +525,7 @@ PStringArray PConfig::GetSections() const
 PStringArray PConfig::GetKeys(const PString & theSection) const
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringArray keys;
 
@@ -395,7 +544,7 @@ PStringArray PConfig::GetKeys(const PString & theSection) const
 void PConfig::DeleteSection(const PString & theSection)
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PConfig::Cached::iterator it = m_config->find(theSection);
   if (it != m_config->end()) {
@@ -408,7 +557,7 @@ void PConfig::DeleteSection(const PString & theSection)
 void PConfig::DeleteKey(const PString & theSection, const PString & theKey)
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringOptions * section = m_config->GetAt(theSection);
   if (section != NULL) {
@@ -424,7 +573,7 @@ void PConfig::DeleteKey(const PString & theSection, const PString & theKey)
 PBoolean PConfig::HasKey(const PString & theSection, const PString & theKey) const
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringOptions * section = m_config->GetAt(theSection);
   return section != NULL && section->Contains(theKey);
@@ -434,7 +583,7 @@ PBoolean PConfig::HasKey(const PString & theSection, const PString & theKey) con
 PString PConfig::GetString(const PString & theSection, const PString & theKey, const PString & dflt) const
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringOptions * section = m_config->GetAt(theSection);
   return section != NULL ? section->GetString(theKey, dflt) : dflt;
@@ -446,7 +595,7 @@ void PConfig::SetString(const PString & theSection,
                         const PString & theValue)
 {
   PAssert(m_config != NULL, "config instance not set");
-  PWaitAndSignal(m_config->m_mutex);
+  PWaitAndSignal lock(m_config->m_mutex);
 
   PStringOptions * section = m_config->GetAt(theSection);
   if (section == NULL)
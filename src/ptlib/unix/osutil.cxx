@@ -53,6 +53,7 @@
 #endif
 
 #include <ptlib.h>
+#include <ptlib/dirwatch.h>
 
 
 #include <fcntl.h>
@@ -507,6 +508,14 @@ bool PDirectory::GetInfo(PFileInfo & info) const
 
 bool PDirectory::Exists(const PString & p)
 {
+  if (PFileInfoCache::IsActive()) {
+    PFileInfo info;
+    if (!PFile::GetInfo(p.GetLength() > 1 && IsSeparator(p[p.GetLength()-1]) ? p.Left(p.GetLength()-1) : p, info))
+      return false;
+    if (info.type != PFileInfo::SymbolicLink)
+      return info.type == PFileInfo::SubDirectory;
+  }
+
   struct stat sbuf;
   if (stat((const char *)p, &sbuf) != 0)
     return false;
@@ -515,11 +524,25 @@ bool PDirectory::Exists(const PString & p)
 }
 
 
+/* Drop what the cache has for a path that was just changed, only if the cache
+   is in use, and leaving errno as the change set it. */
+static void InvalidateFileInfo(const PString & path)
+{
+  if (PFileInfoCache::IsActive()) {
+    int err = errno;
+    PFileInfoCache::Invalidate(PFilePath(path));
+    errno = err;
+  }
+}
+
+
 bool PDirectory::Remove(const PString & p)
 {
   PAssert(!p.IsEmpty(), "attempt to remove dir with empty name");
   PString str = p.Left(p.GetLength()-1);
-  return rmdir(str) == 0;
+  bool ok = rmdir(str) == 0;
+  InvalidateFileInfo(str);
+  return ok;
 }
 
 PString PDirectory::GetVolume() const
@@ -781,6 +804,8 @@ bool PFile::InternalOpen(OpenMode mode, OpenOptions opt, PFileInfo::Permissions
     mode_t oldMask = umask(0);
     int h = ::open(m_path, oflags, permissions.AsBits());
     umask(oldMask);
+    if (mode != ReadOnly)
+      InvalidateFileInfo(m_path);
     if (!ConvertOSError(os_handle = PX_NewHandle(GetClass(), h)))
       return false;
   }
@@ -811,11 +836,34 @@ bool PFile::Exists(const PFilePath & name)
     file.Close();
   return exists;
 #else
+  if (PFileInfoCache::IsActive()) {
+    PFileInfo info;
+    if (!GetInfo(name, info))
+      return false;
+    if (info.type != PFileInfo::SymbolicLink)
+      return true;
+  }
   return access(name, 0) == 0; 
 #endif // P_VXWORKS
 }
 
 
+bool PFile::Remove(const PFilePath & name, bool)
+{
+  bool ok = unlink(name) == 0;
+  InvalidateFileInfo(name);
+  return ok;
+}
+
+
+bool PFile::Remove(const PString & name, bool)
+{
+  bool ok = unlink(name) == 0;
+  InvalidateFileInfo(name);
+  return ok;
+}
+
+
 bool PFile::Access(const PFilePath & name, OpenMode mode)
 {
 #ifdef P_VXWORKS
@@ -854,11 +902,42 @@ bool PFile::Touch(const PFilePath & name, const PTime & accessTime, const PTime
   P_timeval acc(accessTime.IsValid() ? accessTime : now);
   P_timeval mod(modTime.IsValid() ? modTime : now);
   timeval times[2] = { *acc, *mod };
-  return utimes(name, times) == 0;
+  bool ok = utimes(name, times) == 0;
+  InvalidateFileInfo(name);
+  return ok;
 }
 
 
+static bool InternalGetInfo(const PFilePath & name, PFileInfo & status);
+
 bool PFile::GetInfo(const PFilePath & name, PFileInfo & status)
+{
+  unsigned generation;
+  switch (PFileInfoCache::Lookup(name, status, generation)) {
+    case PFileInfoCache::Found :
+      return true;
+
+    case PFileInfoCache::NotFound :
+      status.type = PFileInfo::UnknownFileType;
+      errno = ENOENT;
+      return false;
+
+    default :
+      break;
+  }
+
+  if (InternalGetInfo(name, status)) {
+    PFileInfoCache::Store(name, &status, generation);
+    return true;
+  }
+
+  if (errno == ENOENT)
+    PFileInfoCache::Store(name, NULL, generation);
+  return false;
+}
+
+
+static bool InternalGetInfo(const PFilePath & name, PFileInfo & status)
 {
   status.type = PFileInfo::UnknownFileType;
 
@@ -945,7 +1024,9 @@ bool PFile::SetPermissions(const PFilePath & name, PFileInfo::Permissions permis
 
   return false;
 #else  
-  return chmod ((const char *)name, mode) == 0;
+  bool ok = chmod ((const char *)name, mode) == 0;
+  InvalidateFileInfo(name);
+  return ok;
 #endif // P_VXWORKS
 }
 
@@ -39,6 +39,11 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <poll.h>
+
+#if P_HAS_POSIX_SPAWN
+  #include <spawn.h>
+#endif
 
 #if defined(P_LINUX) || defined(P_SOLARIS)
 #include <termio.h>
@@ -79,6 +84,99 @@ PPipeChannel::PPipeChannel()
 }
 
 
+static bool MakePipe(int fds[2], const char * name)
+{
+  /* Close on exec, so children started concurrently by other threads do not
+     inherit this pipe, which would stop our child ever seeing end of file.
+     The child gets its end via dup2(), which clears the flag on the copy. */
+#if defined(P_LINUX) && defined(O_CLOEXEC)
+  if (::pipe2(fds, O_CLOEXEC) != 0)
+    return false;
+#else
+  if (::pipe(fds) != 0)
+    return false;
+  ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+  PX_NewHandle(name, PMAX(fds[0], fds[1]));
+  return true;
+}
+
+
+#if P_HAS_POSIX_SPAWN
+
+/* Start the child with posix_spawn(), which on Linux is clone(CLONE_VM|CLONE_VFORK)
+   with a private stack, so there is no copying of page tables however large
+   this process is, and nothing in the child touches our memory. */
+static int SpawnChild(const char * program,
+                      char ** argv,
+                      char ** envp,
+                      bool searchPath,
+                      PPipeChannel::OpenMode mode,
+                      bool stderrSeparate,
+                      const int toChildPipe[2],
+                      const int fromChildPipe[2],
+                      const int stderrChildPipe[2],
+                      pid_t & pid)
+{
+  posix_spawn_file_actions_t actions;
+  int err = posix_spawn_file_actions_init(&actions);
+  if (err != 0)
+    return err;
+
+  posix_spawnattr_t attr;
+  if ((err = posix_spawnattr_init(&attr)) != 0) {
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+  }
+
+  // Same redirections as the fork() version below
+  if (toChildPipe[0] != -1)
+    posix_spawn_file_actions_adddup2(&actions, toChildPipe[0], STDIN_FILENO);
+  else
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+  if (fromChildPipe[1] != -1) {
+    posix_spawn_file_actions_adddup2(&actions, fromChildPipe[1], STDOUT_FILENO);
+    if (!stderrSeparate)
+      posix_spawn_file_actions_adddup2(&actions, fromChildPipe[1], STDERR_FILENO);
+  }
+  else if (mode != PPipeChannel::ReadWriteStd) {
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    if (!stderrSeparate)
+      posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+  }
+
+  if (stderrSeparate)
+    posix_spawn_file_actions_adddup2(&actions, stderrChildPipe[1], STDERR_FILENO);
+
+  /* Our own process group, so we don't get signals from our parent's
+     terminal, and no signals blocked, whatever thread we are called from.
+     Caught signals revert to default on exec anyway. */
+  sigset_t noSignals;
+  sigemptyset(&noSignals);
+  posix_spawnattr_setsigmask(&attr, &noSignals);
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_USEVFORK
+  flags |= POSIX_SPAWN_USEVFORK; // Older glibc, newer ones always do
+#endif
+  posix_spawnattr_setflags(&attr, flags);
+
+  if (searchPath)
+    err = posix_spawnp(&pid, program, &actions, &attr, argv, envp);
+  else
+    err = posix_spawn(&pid, program, &actions, &attr, argv, envp);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  return err;
+}
+
+#endif // P_HAS_POSIX_SPAWN
+
+
 PBoolean PPipeChannel::PlatformOpen(const PString & subProgram,
                                 const PStringArray & argumentList,
                                 OpenMode mode,
@@ -94,26 +192,68 @@ PBoolean PPipeChannel::PlatformOpen(const PString & subProgram,
   // setup the pipe to the child
   if (mode == ReadOnly)
     m_toChildPipe[0] = m_toChildPipe[1] = -1;
-  else {
-    PAssert(pipe(m_toChildPipe) == 0, POperatingSystemError);
-    PX_NewHandle("PPipeChannel m_toChildPipe", PMAX(m_toChildPipe[0], m_toChildPipe[1]));
+  else if (!MakePipe(m_toChildPipe, "PPipeChannel m_toChildPipe")) {
+    ConvertOSError(-1);
+    return false;
   }
  
   // setup the pipe from the child
   if (mode == WriteOnly || mode == ReadWriteStd)
     m_fromChildPipe[0] = m_fromChildPipe[1] = -1;
-  else {
-    PAssert(pipe(m_fromChildPipe) == 0, POperatingSystemError);
-    PX_NewHandle("PPipeChannel m_fromChildPipe", PMAX(m_fromChildPipe[0], m_fromChildPipe[1]));
+  else if (!MakePipe(m_fromChildPipe, "PPipeChannel m_fromChildPipe")) {
+    ConvertOSError(-1);
+    Close();
+    return false;
   }
 
-  if (stderrSeparate)
-    PAssert(pipe(m_stderrChildPipe) == 0, POperatingSystemError);
-  else {
+  if (!stderrSeparate)
     m_stderrChildPipe[0] = m_stderrChildPipe[1] = -1;
-    PX_NewHandle("PPipeChannel m_stderrChildPipe", PMAX(m_stderrChildPipe[0], m_stderrChildPipe[1]));
+  else if (!MakePipe(m_stderrChildPipe, "PPipeChannel m_stderrChildPipe")) {
+    ConvertOSError(-1);
+    Close();
+    return false;
   }
 
+  /* Setup the arguments and environment before starting the child, as
+     after vfork() the child must not allocate memory. */
+  PCharArray argvStorage, envpStorage;
+  char ** argv;
+  if (argumentList.GetSize() > 0 && argumentList[0] == subProgram)
+    argv = argumentList.ToCharArray(&argvStorage);
+  else {
+    PStringArray withProgram(argumentList.GetSize()+1);
+    withProgram[0] = subProgram;
+    for (PINDEX i = 0; i < argumentList.GetSize(); ++i)
+      withProgram[i+1] = argumentList[i];
+    argv = withProgram.ToCharArray(&argvStorage);
+  }
+
+  char ** envp = environment != NULL ? environment->ToCharArray(true, &envpStorage) : environ;
+
+#if PTRACING
+  static const unsigned Level = 4;
+  if (PTrace::CanTrace(Level)) {
+    ostream & log = PTRACE_BEGIN(Level);
+    log << "PPipeChannel: prog=" << subProgram.ToLiteral();
+    for (int i = 0; argv[i] != NULL; ++i)
+      log << " arg[" << i << "]=\"" << argv[i] << '"';
+    log << PTrace::End;
+  }
+#endif
+
+#if P_HAS_POSIX_SPAWN
+  pid_t pid = -1;
+  int err = SpawnChild(subProgram, argv, envp, searchPath, mode, stderrSeparate,
+                       m_toChildPipe, m_fromChildPipe, m_stderrChildPipe, pid);
+  if (err != 0) {
+    PTRACE(1, "Could not spawn process \"" << subProgram << "\": " << strerror(err));
+    errno = err;
+    ConvertOSError(-1);
+    Close();
+    return false;
+  }
+  m_childPID = pid;
+#else
   // fork to allow us to execute the child
 #if defined(__BEOS__) || defined(P_IRIX)
   m_childPID = fork();
@@ -123,171 +263,147 @@ PBoolean PPipeChannel::PlatformOpen(const PString & subProgram,
 
   if (m_childPID < 0) {
     PTRACE(1, "Could not fork process: errno=" << errno);
+    ConvertOSError(-1);
+    Close();
     return false;
   }
 
-  if (m_childPID > 0) {
-#if PTRACING
-    static const int TraceLevel = 5;
-    if (PTrace::CanTrace(TraceLevel)) {
-      ostream & log = PTRACE_BEGIN(TraceLevel);
-      log << "Forked child process (pid=" << m_childPID << ") \"" << subProgram << '"';
-      for (PINDEX i = 0; i < argumentList.GetSize(); ++i)
-        log << " \"" << argumentList[i] << '"';
-      log << PTrace::End;
-    }
-#endif
+  if (m_childPID == 0) {
+    // the following code is in the child process
 
-    // setup the pipe to the child
+    // if we need to write to the child, make sure the child's stdin
+    // is redirected
     if (m_toChildPipe[0] != -1) {
+      ::close(STDIN_FILENO);
+      if (::dup(m_toChildPipe[0]) == -1)
+        _exit(errno);
       ::close(m_toChildPipe[0]);
-      m_toChildPipe[0] = -1;
+      ::close(m_toChildPipe[1]);  
     }
-
-    if (m_fromChildPipe[0] != -1) {
-      int cmd = 1;
-      PAssert(::ioctl(m_fromChildPipe[0], FIONBIO, &cmd) == 0, POperatingSystemError);
+    else {
+      int fd = open("/dev/null", O_RDONLY);
+      ::close(STDIN_FILENO);
+      if (::dup(fd) == -1)
+        _exit(errno);
+      ::close(fd);
     }
 
+    // if we need to read from the child, make sure the child's stdout
+    // and stderr is redirected
     if (m_fromChildPipe[1] != -1) {
+      ::close(STDOUT_FILENO);
+      if (::dup(m_fromChildPipe[1]) == -1)
+        _exit(errno);
+      ::close(STDERR_FILENO);
+      if (!stderrSeparate)
+        if (::dup(m_fromChildPipe[1]) == -1)
+          _exit(errno);
       ::close(m_fromChildPipe[1]);
-      m_fromChildPipe[1] = -1;
+      ::close(m_fromChildPipe[0]); 
     }
- 
-    if (m_stderrChildPipe[0] != -1) {
-      int cmd = 1;
-      PAssert(::ioctl(m_stderrChildPipe[0], FIONBIO, &cmd) == 0, POperatingSystemError);
+    else if (mode != ReadWriteStd) {
+      int fd = ::open("/dev/null", O_WRONLY);
+      ::close(STDOUT_FILENO);
+      if (::dup(fd) == -1)
+        _exit(errno);
+      ::close(STDERR_FILENO);
+      if (!stderrSeparate)
+        if (::dup(fd) == -1)
+          _exit(errno);
+      ::close(fd);
     }
 
-    if (m_stderrChildPipe[1] != -1) {
+    if (stderrSeparate) {
+      if (::dup(m_stderrChildPipe[1]) == -1)
+        _exit(errno);
       ::close(m_stderrChildPipe[1]);
-      m_stderrChildPipe[1] = -1;
+      ::close(m_stderrChildPipe[0]); 
+    }
+
+    // Restore signal handlers so the child process doesn't
+    // inherit them from the parent
+    PProcess::Current().RemoveRunTimeSignalHandlers();
+
+    // and set ourselves as out own process group so we don't get signals
+    // from our parent's terminal (hopefully!)
+    PSETPGRP();
+
+    // run the program, does not return
+    if (searchPath) {
+    #if __GLIBC__ >3 || __GLIBC__ == 2 && __GLIBC_MINOR__ >= 11
+      execvpe(subProgram, argv, envp);
+    #else
+      if (environment == NULL)
+        execvp(subProgram, argv);
+      else {
+        // Need to search path manually
+        const char * path = getenv("PATH");
+        if (path == NULL || *path == '\0')
+          path = ".:/bin:/usr/bin";
+        char progPath[PATH_MAX];
+        while (*path != '\0') {
+          const char * colon = strchr(path, ':');
+          size_t len = colon != NULL ? (size_t)(colon - path) : strlen(path);
+          if (len + subProgram.GetLength() + 2 <= sizeof(progPath)) {
+            memcpy(progPath, path, len);
+            progPath[len] = '/';
+            strcpy(progPath+len+1, subProgram);
+            execve(progPath, argv, envp);
+          }
+          path += len;
+          if (*path == ':')
+            ++path;
+        }
+      }
+    #endif
     }
+    execve(subProgram, argv, envp);
 
-    os_handle = 0;
-    m_returnCode = -2; // Indicate are running
-    return true;
+    // Returned! Error!
+    _exit(errno != 0 ? errno : 1);
   }
+#endif // P_HAS_POSIX_SPAWN
 
-  // the following code is in the child process
+#if PTRACING
+  static const int TraceLevel = 5;
+  if (PTrace::CanTrace(TraceLevel)) {
+    ostream & log = PTRACE_BEGIN(TraceLevel);
+    log << "Started child process (pid=" << m_childPID << ") \"" << subProgram << '"';
+    for (PINDEX i = 0; i < argumentList.GetSize(); ++i)
+      log << " \"" << argumentList[i] << '"';
+    log << PTrace::End;
+  }
+#endif
 
-  // if we need to write to the child, make sure the child's stdin
-  // is redirected
+  // setup the pipe to the child
   if (m_toChildPipe[0] != -1) {
-    ::close(STDIN_FILENO);
-    if (::dup(m_toChildPipe[0]) == -1)
-      return false;
     ::close(m_toChildPipe[0]);
-    ::close(m_toChildPipe[1]);  
+    m_toChildPipe[0] = -1;
   }
-  else {
-    int fd = open("/dev/null", O_RDONLY);
-    PAssertOS(fd >= 0);
-    ::close(STDIN_FILENO);
-    if (::dup(fd) == -1)
-      return false;
-    ::close(fd);
+
+  if (m_fromChildPipe[0] != -1) {
+    int cmd = 1;
+    PAssert(::ioctl(m_fromChildPipe[0], FIONBIO, &cmd) == 0, POperatingSystemError);
   }
 
-  // if we need to read from the child, make sure the child's stdout
-  // and stderr is redirected
   if (m_fromChildPipe[1] != -1) {
-    ::close(STDOUT_FILENO);
-    if (::dup(m_fromChildPipe[1]) == -1)
-      return false;
-    ::close(STDERR_FILENO);
-    if (!stderrSeparate)
-      if (::dup(m_fromChildPipe[1]) == -1)
-        return false;
     ::close(m_fromChildPipe[1]);
-    ::close(m_fromChildPipe[0]); 
-  }
-  else if (mode != ReadWriteStd) {
-    int fd = ::open("/dev/null", O_WRONLY);
-    PAssertOS(fd >= 0);
-    ::close(STDOUT_FILENO);
-    if (::dup(fd) == -1)
-      return false;
-    ::close(STDERR_FILENO);
-    if (!stderrSeparate)
-      if (::dup(fd) == -1)
-        return false;
-    ::close(fd);
-  }
-
-  if (stderrSeparate) {
-    if (::dup(m_stderrChildPipe[1]) == -1)
-      return false;
-    ::close(m_stderrChildPipe[1]);
-    ::close(m_stderrChildPipe[0]); 
-  }
-
-  // Restore signal handlers so the child process doesn't
-  // inherit them from the parent
-  PProcess::Current().RemoveRunTimeSignalHandlers();
-
-  // and set ourselves as out own process group so we don't get signals
-  // from our parent's terminal (hopefully!)
-  PSETPGRP();
-
-  // setup the arguments and environment, note as we are about to exec or
-  // exit, we don't care about memory leaks, they are not real!
-  char ** argv;
-  if (argumentList[0] == subProgram)
-    argv = argumentList.ToCharArray();
-  else {
-    PStringArray withProgram(argumentList.GetSize()+1);
-    withProgram[0] = subProgram;
-    for (PINDEX i = 0; i < argumentList.GetSize(); ++i)
-      withProgram[i+1] = argumentList[i];
-    argv = withProgram.ToCharArray();
+    m_fromChildPipe[1] = -1;
   }
-
-#if PTRACING
-  static const unsigned Level = 4;
-  if (PTrace::CanTrace(Level)) {
-    ostream & log = PTRACE_BEGIN(Level);
-    log << "PPipeChannel: prog=" << subProgram.ToLiteral();
-    for (int i = 0; argv[i] != NULL; ++i)
-      log << " arg[" << i << "]=\"" << argv[i] << '"';
-    log << PTrace::End;
+ 
+  if (m_stderrChildPipe[0] != -1) {
+    int cmd = 1;
+    PAssert(::ioctl(m_stderrChildPipe[0], FIONBIO, &cmd) == 0, POperatingSystemError);
   }
-#endif
 
-  // run the program, does not return
-  if (environment == NULL) {
-    if (searchPath)
-      execvp(subProgram, argv);
-    else
-      execv(subProgram, argv);
-  }
-  else {
-    char ** envp = environment != NULL ? environment->ToCharArray(true) : environ;
-    if (!searchPath)
-      execve(subProgram, argv, envp);
-    else {
-      #if __GLIBC__ >3 || __GLIBC__ == 2 && __GLIBC_MINOR__ >= 11
-        execvpe(subProgram, argv, envp);
-      #else
-        // Need to search path manually
-        PString path(getenv("PATH"));
-        if (path.IsEmpty())
-          path = ".:/bin:/usr/bin";
-        PStringArray dir = path.Tokenise(':', false);
-        for (PINDEX i = 0; i < dir.GetSize(); ++i) {
-          PString progPath = dir[i] + '/' + subProgram;
-          if (PFile::Exists(progPath)) {
-            execve(progPath, argv, envp);
-            break;
-          }
-        }
-        execve(subProgram, argv, envp);
-      #endif
-    }
+  if (m_stderrChildPipe[1] != -1) {
+    ::close(m_stderrChildPipe[1]);
+    m_stderrChildPipe[1] = -1;
   }
 
-  // Returned! Error!
-  _exit(errno != 0 ? errno : 1);
+  os_handle = 0;
+  m_returnCode = -2; // Indicate are running
+  return true;
 #endif // P_VXWORKS || P_RTEMS
 
   return false;
@@ -498,6 +614,63 @@ PBoolean PPipeChannel::ReadStandardError(PString & errors, PBoolean wait)
 }
 
 
+PChannel::Errors PPipeChannel::Select(SelectList & output, const PTimeInterval & timeout)
+{
+  SelectList errors;
+  return Select(output, errors, timeout);
+}
+
+
+PChannel::Errors PPipeChannel::Select(SelectList & output, SelectList & errors, const PTimeInterval & timeout)
+{
+  SelectList * list[2] = { &output, &errors };
+
+  std::vector<pollfd> pfd;
+  pfd.reserve(output.GetSize() + errors.GetSize());
+  for (PINDEX i = 0; i < 2; ++i) {
+    for (SelectList::iterator it = list[i]->begin(); it != list[i]->end(); ++it) {
+      pollfd entry;
+      entry.fd = i == 0 ? it->m_fromChildPipe[0] : it->m_stderrChildPipe[0];
+      entry.events = POLLIN;
+      entry.revents = 0;
+      if (entry.fd < 0)
+        return NotOpen;
+      pfd.push_back(entry);
+    }
+  }
+
+  if (pfd.empty())
+    return NotOpen;
+
+  int msecs = timeout == PMaxTimeInterval ? -1 : (int)std::min<PInt64>(timeout.GetInterval(), INT_MAX);
+  int result;
+  do {
+    PPROFILE_SYSTEM(
+      result = ::poll(&pfd[0], pfd.size(), msecs);
+    );
+  } while (result < 0 && errno == EINTR);
+
+  if (result < 0) {
+    PTRACE2(2, NULL, "Select on " << pfd.size() << " pipes failed: errno=" << errno);
+    return Miscellaneous;
+  }
+
+  // POLLHUP is end of file, which the next Read() will report
+  size_t index = 0;
+  for (PINDEX i = 0; i < 2; ++i) {
+    SelectList::iterator it = list[i]->begin();
+    while (it != list[i]->end()) {
+      if (pfd[index++].revents != 0)
+        ++it;
+      else
+        list[i]->erase(it++);
+    }
+  }
+
+  return NoError;
+}
+
+
 int PPipeChannel::Run(const PString & command, PString & output, bool includeStderr, const PTimeInterval & timeout)
 {
   output.MakeEmpty();
@@ -98,6 +98,7 @@
 #include <ptlib.h>
 
 #include <ptlib/sockets.h>
+#include <ptlib/metrics.h>
 
 #if defined(SIOCGENADDR)
 #define SIO_Get_MAC_Address SIOCGENADDR
@@ -131,6 +132,24 @@ extern "C" void inet_ntoa_b(struct in_addr inetAddress, char *pString);
 #define PTraceModule() "Socket"
 
 
+static PMetricCounter s_readBytes   ("ptlib_socket_bytes_total",   "Bytes transferred by sockets", "direction=\"read\"");
+static PMetricCounter s_writeBytes  ("ptlib_socket_bytes_total",   "Bytes transferred by sockets", "direction=\"write\"");
+static PMetricCounter s_readPackets ("ptlib_socket_packets_total", "Successful socket system calls, packets for datagram sockets", "direction=\"read\"");
+static PMetricCounter s_writePackets("ptlib_socket_packets_total", "Successful socket system calls, packets for datagram sockets", "direction=\"write\"");
+
+static __inline void CountRead(int bytes)
+{
+  s_readBytes.Inc(bytes);
+  s_readPackets.Inc();
+}
+
+static __inline void CountWrite(int bytes)
+{
+  s_writeBytes.Inc(bytes);
+  s_writePackets.Inc();
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 
 PSocket::~PSocket()
@@ -488,7 +507,7 @@ bool PSocket::os_vread(Slice * slices, size_t sliceCount, int flags, struct sock
     memset(&readData, 0, sizeof(readData));
 
     readData.msg_name       = addr;
-    readData.msg_namelen    = *addrlen;
+    readData.msg_namelen    = addrlen != NULL ? *addrlen : 0;
 
     readData.msg_iov        = slices;
     readData.msg_iovlen     = sliceCount;
@@ -499,6 +518,9 @@ bool PSocket::os_vread(Slice * slices, size_t sliceCount, int flags, struct sock
     );
     if (ConvertOSError(result, LastReadError)) {
       SetLastReadCount(result);
+      CountRead(result);
+      if (addrlen != NULL)
+        *addrlen = readData.msg_namelen;
       if ((readData.msg_flags&MSG_TRUNC) == 0)
         return GetLastReadCount() > 0;
 
@@ -545,6 +567,7 @@ bool PSocket::os_vwrite(const Slice * slices, size_t sliceCount, int flags, stru
       PTRACE_IF(s_NoBufsThrottle, noBufferRetry > 0, "PTLib",
                 "WARNING: No buffer space available for " << noBufferRetry << " retries of socket write" << s_NoBufsThrottle);
       SetLastWriteCount(result);
+      CountWrite(result);
       return true;
     }
 
@@ -659,6 +682,7 @@ PBoolean PTCPSocket::Read(void * buf, PINDEX maxLen)
   if (!ConvertOSError(r, LastReadError))
     return false;
 
+  CountRead(r);
   return SetLastReadCount(r) > 0;
 }
 
@@ -674,8 +698,10 @@ PBoolean PSocket::Read(void * buf, PINDEX len)
   PPROFILE_SYSTEM(
     int result = ::recv(os_handle, (char *)buf, len, 0);
   );
-  if (ConvertOSError(result))
+  if (ConvertOSError(result)) {
+    CountRead(result);
     return SetLastReadCount(result) > 0;
+  }
 
   SetLastReadCount(0);
   return false;